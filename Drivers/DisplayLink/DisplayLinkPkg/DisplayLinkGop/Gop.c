@@ -121,14 +121,6 @@ BuildBackBuffer (
 
   case EfiBltBufferToVideo:
   {
-    // Update the store of the area of the screen that is "dirty" - that we need to send in the next screen update.
-    if (DestinationY < UsbDisplayLinkDev->LastY1) {
-      UsbDisplayLinkDev->LastY1 = DestinationY;
-    }
-    if ((DestinationY + Height) > UsbDisplayLinkDev->LastY2) {
-      UsbDisplayLinkDev->LastY2 = DestinationY + Height;
-    }
-
     EFI_GRAPHICS_OUTPUT_BLT_PIXEL* Blt;
     EFI_GRAPHICS_OUTPUT_BLT_PIXEL* DstB;
     Blt = (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *)(((UINT8 *)BltBuffer) + (SourceY * BltBufferStride) + SourceX * sizeof *Blt);
@@ -175,6 +167,13 @@ BuildBackBuffer (
   break;
   default: break;
   }
+
+  // Update the store of the areas of the screen that are "dirty" - that we need to send in the next screen update.
+  if (BltOperation == EfiBltBufferToVideo
+    || BltOperation == EfiBltVideoToVideo
+    || BltOperation == EfiBltVideoFill) {
+    DlGopMarkDirty (UsbDisplayLinkDev, DestinationX, DestinationY, Width, Height);
+  }
 }
 
 /**
@@ -252,7 +251,175 @@ DlGopSendTestPattern (
 
 
 /**
- * Transfer the latest copy of the Blt buffer over USB to the DisplayLink device
+ * Area of the smallest rectangle containing both rectangles
+ * @param A
+ * @param B
+ * @return
+ */
+STATIC UINTN
+RectUnionArea (
+    IN CONST DISPLAYLINK_RECT* A,
+    IN CONST DISPLAYLINK_RECT* B
+    )
+{
+  return (MAX (A->X2, B->X2) - MIN (A->X1, B->X1)) * (MAX (A->Y2, B->Y2) - MIN (A->Y1, B->Y1));
+}
+
+/**
+ * Grow rectangle A to contain rectangle B
+ * @param A
+ * @param B
+ */
+STATIC VOID
+RectUnion (
+    IN OUT DISPLAYLINK_RECT* A,
+    IN CONST DISPLAYLINK_RECT* B
+    )
+{
+  A->X1 = MIN (A->X1, B->X1);
+  A->Y1 = MIN (A->Y1, B->Y1);
+  A->X2 = MAX (A->X2, B->X2);
+  A->Y2 = MAX (A->Y2, B->Y2);
+}
+
+/**
+ * Check if two rectangles overlap or are adjacent
+ * @param A
+ * @param B
+ * @return
+ */
+STATIC BOOLEAN
+RectTouches (
+    IN CONST DISPLAYLINK_RECT* A,
+    IN CONST DISPLAYLINK_RECT* B
+    )
+{
+  return (A->X1 <= B->X2) && (B->X1 <= A->X2) && (A->Y1 <= B->Y2) && (B->Y1 <= A->Y2);
+}
+
+/**
+ * Record that an area of the back buffer has changed and needs to be sent in the next screen update.
+ * Up to DISPLAYLINK_DIRTY_RECT_MAX separate areas are tracked; beyond that, the new area is merged
+ * into the tracked area that grows the least as a result.
+ * Must be called at TPL_NOTIFY, as the dirty areas are shared with DlGopSendScreenUpdate.
+ * @param UsbDisplayLinkDev
+ * @param X
+ * @param Y
+ * @param Width
+ * @param Height
+ */
+VOID
+DlGopMarkDirty (
+    IN USB_DISPLAYLINK_DEV* UsbDisplayLinkDev,
+    IN UINTN X,
+    IN UINTN Y,
+    IN UINTN Width,
+    IN UINTN Height
+    )
+{
+  DISPLAYLINK_RECT New;
+  DISPLAYLINK_RECT* Rects;
+  UINTN Index;
+  UINTN Best;
+  UINTN Growth;
+  UINTN BestGrowth;
+
+  if (Width == 0 || Height == 0) {
+    return;
+  }
+
+  New.X1 = X;
+  New.Y1 = Y;
+  New.X2 = X + Width;
+  New.Y2 = Y + Height;
+  Rects = UsbDisplayLinkDev->DirtyRect;
+
+  // Absorb any tracked areas that the new area overlaps. Growing the new area may make it overlap
+  // areas that were checked before, so start again after each merge.
+  Index = 0;
+  while (Index < UsbDisplayLinkDev->DirtyRectCount) {
+    if (RectTouches (&Rects[Index], &New)) {
+      RectUnion (&New, &Rects[Index]);
+      Rects[Index] = Rects[--UsbDisplayLinkDev->DirtyRectCount];
+      Index = 0;
+    } else {
+      Index++;
+    }
+  }
+
+  if (UsbDisplayLinkDev->DirtyRectCount < DISPLAYLINK_DIRTY_RECT_MAX) {
+    Rects[UsbDisplayLinkDev->DirtyRectCount++] = New;
+    return;
+  }
+
+  // Out of slots - merge into the area whose bounding box grows the least.
+  // Any overlap this leaves with the other areas just means some pixels get converted twice.
+  Best = 0;
+  BestGrowth = (UINTN)-1;
+  for (Index = 0; Index < UsbDisplayLinkDev->DirtyRectCount; Index++) {
+    Growth = RectUnionArea (&Rects[Index], &New) - (Rects[Index].X2 - Rects[Index].X1) * (Rects[Index].Y2 - Rects[Index].Y1);
+    if (Growth < BestGrowth) {
+      BestGrowth = Growth;
+      Best = Index;
+    }
+  }
+  RectUnion (&Rects[Best], &New);
+}
+
+/**
+ * Convert an area of the back buffer into the pixel format of the device, in the device frame
+ * @param UsbDisplayLinkDev
+ * @param Rect
+ */
+STATIC VOID
+ConvertRectToDeviceFrame (
+    IN USB_DISPLAYLINK_DEV* UsbDisplayLinkDev,
+    IN CONST DISPLAYLINK_RECT* Rect
+    )
+{
+  UINTN PixelsPerScanLine;
+  UINTN Width;
+  UINTN H;
+
+  PixelsPerScanLine = UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->PixelsPerScanLine;
+  Width = UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->HorizontalResolution;
+
+  for (H = Rect->Y1; H < Rect->Y2; H++) {
+    PixelConvertBltToRgb888 (
+      UsbDisplayLinkDev->DeviceFrame + (H * Width + Rect->X1) * DISPLAYLINK_BYTES_PER_PIXEL,
+      UsbDisplayLinkDev->Screen + H * PixelsPerScanLine + Rect->X1,
+      Rect->X2 - Rect->X1);
+  }
+}
+
+/**
+ * Terminate the frame being sent to the DisplayLink device
+ * @param UsbDisplayLinkDev
+ */
+STATIC VOID
+EndScreenUpdate (
+    IN USB_DISPLAYLINK_DEV* UsbDisplayLinkDev
+    )
+{
+  UINT32 USBStatus;
+
+  // Payload with length of 1 to terminate the frame
+  // We need to do this even if we had an error, to indicate to the DL device that it should now expect a new frame.
+  DlUsbBulkWrite (UsbDisplayLinkDev, UsbDisplayLinkDev->DeviceFrame, 1, &USBStatus);
+
+  UsbDisplayLinkDev->FrameInProgress = FALSE;
+  UsbDisplayLinkDev->FrameLinesSent = UsbDisplayLinkDev->FrameNextLine;
+  UsbDisplayLinkDev->FrameTransferTimeNs = GetTimeInNanoSecond (GetPerformanceCounter () - UsbDisplayLinkDev->FrameStartTicks);
+  DEBUG ((DEBUG_VERBOSE, "Screen update - %lu lines sent in %lu ns\n", (UINT64)UsbDisplayLinkDev->FrameLinesSent, UsbDisplayLinkDev->FrameTransferTimeNs));
+}
+
+/**
+ * Transfer the areas of the Blt buffer that have changed over USB to the DisplayLink device.
+ * The device has no way of addressing part of the screen - each frame is sent line by line from the top, one line
+ * per bulk transfer - so a frame ends after the last line that has changed. Only the changed pixels are converted to
+ * the device format; the unchanged lines above them are sent from the copy of the screen kept in DeviceFrame.
+ * Each call sends up to DISPLAYLINK_SCREEN_UPDATE_CHUNK_LINES lines, and FrameInProgress stays set until the frame
+ * is complete. Areas BLTted to in the meantime are added to the frame if it hasn't reached them yet.
  * @param UsbDisplayLinkDev
  * @return
  */
@@ -265,81 +432,98 @@ DlGopSendScreenUpdate (
   UINT32 USBStatus;
   Status = EFI_SUCCESS;
 
-  // If it has been a while since we sent an update, send a full screen.
-  // This allows us to update a hot-plugged monitor quickly.
-  if (UsbDisplayLinkDev->TimeSinceLastScreenUpdate > DISPLAYLINK_FULL_SCREEN_UPDATE_PERIOD) {
-    UsbDisplayLinkDev->LastY1 = 0;
-    UsbDisplayLinkDev->LastY2 = UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->HorizontalResolution - 1;
-  }
+  if (!UsbDisplayLinkDev->FrameInProgress) {
+    // If it has been a while since we sent an update, send a full screen.
+    // This allows us to update a hot-plugged monitor quickly.
+    if (UsbDisplayLinkDev->TimeSinceLastScreenUpdate > DISPLAYLINK_FULL_SCREEN_UPDATE_PERIOD) {
+      UsbDisplayLinkDev->DirtyRect[0].X1 = 0;
+      UsbDisplayLinkDev->DirtyRect[0].Y1 = 0;
+      UsbDisplayLinkDev->DirtyRect[0].X2 = UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->HorizontalResolution;
+      UsbDisplayLinkDev->DirtyRect[0].Y2 = UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->VerticalResolution;
+      UsbDisplayLinkDev->DirtyRectCount = 1;
+    }
 
-  // If there has been no BLT since the last update/poll, drop out quietly.
-  if (UsbDisplayLinkDev->LastY2 < UsbDisplayLinkDev->LastY1) {
-    UsbDisplayLinkDev->TimeSinceLastScreenUpdate += (DISPLAYLINK_SCREEN_UPDATE_TIMER_PERIOD / 1000);  // Convert us to ms
-    return EFI_SUCCESS;
+    // If there has been no BLT since the last update/poll, drop out quietly.
+    if (UsbDisplayLinkDev->DirtyRectCount == 0) {
+      UsbDisplayLinkDev->TimeSinceLastScreenUpdate += (DISPLAYLINK_SCREEN_UPDATE_TIMER_PERIOD / 1000);  // Convert us to ms
+      return EFI_SUCCESS;
+    }
+
+    UsbDisplayLinkDev->TimeSinceLastScreenUpdate = 0;
+    UsbDisplayLinkDev->FrameStartTicks = GetPerformanceCounter ();
+    UsbDisplayLinkDev->FrameNextLine = 0;
+    UsbDisplayLinkDev->FrameLastLine = 0;
+    UsbDisplayLinkDev->FrameInProgress = TRUE;
   }
 
-  UsbDisplayLinkDev->TimeSinceLastScreenUpdate = 0;
+  // Convert the areas BLTted to that the frame hasn't reached yet, and add them to it. Areas overlapping lines
+  // that have been sent already are left for the next frame.
+  // Hold off Blt() only while the changed pixels are converted, not for the USB transfer.
+  DISPLAYLINK_RECT* Rect;
+  UINTN Index;
 
   EFI_TPL OriginalTPL = gBS->RaiseTPL (TPL_NOTIFY);
 
+  Index = 0;
+  while (Index < UsbDisplayLinkDev->DirtyRectCount) {
+    Rect = &UsbDisplayLinkDev->DirtyRect[Index];
+    if (Rect->Y1 >= UsbDisplayLinkDev->FrameNextLine) {
+      ConvertRectToDeviceFrame (UsbDisplayLinkDev, Rect);
+      UsbDisplayLinkDev->FrameLastLine = MAX (UsbDisplayLinkDev->FrameLastLine, Rect->Y2);
+      *Rect = UsbDisplayLinkDev->DirtyRect[--UsbDisplayLinkDev->DirtyRectCount];
+    } else {
+      Index++;
+    }
+  }
+
+  gBS->RestoreTPL (OriginalTPL);
+
   UINTN DataLen;
-  UINTN Width;
-  UINTN Height;
-  EFI_GRAPHICS_OUTPUT_BLT_PIXEL* SrcPtr;
-  UINT8* DstPtr;
-  UINT8 DstBuffer[1920 * 3]; // Get rid of the magic numbers at some point
-                             // Could also use a buffer allocated at runtime to store the line, stored in the USB_DISPLAYLINK_DEV structure.
-  UINTN H;
+  UINT8* LinePtr;
+  UINTN LineCount;
 
-  DataLen = UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->HorizontalResolution * 3; // Send 1 line @ 24 bits per pixel
-  Width = UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->HorizontalResolution;
-  Height = UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->VerticalResolution;
-  SrcPtr = UsbDisplayLinkDev->Screen;
-  DstPtr = DstBuffer;
-
-  for (H = 0; H < Height; H++) {
-    DstPtr = DstBuffer;
-
-    UINTN W;
-    for (W = 0; W < Width; W++) {
-      // Need to swap round the RGB values
-      DstPtr[0] = ((UINT8 *)SrcPtr)[2];
-      DstPtr[1] = ((UINT8 *)SrcPtr)[1];
-      DstPtr[2] = ((UINT8 *)SrcPtr)[0];
-      SrcPtr++;
-      DstPtr += 3;
-    }
+  DataLen = UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->HorizontalResolution * DISPLAYLINK_BYTES_PER_PIXEL; // Send 1 line @ 24 bits per pixel
 
-    Status = DlUsbBulkWrite (UsbDisplayLinkDev, DstBuffer, DataLen, &USBStatus);
+  for (LineCount = 0;
+       LineCount < DISPLAYLINK_SCREEN_UPDATE_CHUNK_LINES && UsbDisplayLinkDev->FrameNextLine < UsbDisplayLinkDev->FrameLastLine;
+       LineCount++) {
+    LinePtr = UsbDisplayLinkDev->DeviceFrame + UsbDisplayLinkDev->FrameNextLine * DataLen;
+    Status = DlUsbBulkWrite (UsbDisplayLinkDev, LinePtr, DataLen, &USBStatus);
 
     // USBStatus values defined in usbio.h, e.g. EFI_USB_ERR_TIMEOUT 0x40
     if (EFI_ERROR (Status)) {
-      DEBUG ((DEBUG_ERROR, "Screen update - USB bulk transfer of pixel data failed. Line %d len %d, failure code %r USB status x%x\n", H, DataLen, Status, USBStatus));
+      DEBUG ((DEBUG_ERROR, "Screen update - USB bulk transfer of pixel data failed. Line %d len %d, failure code %r USB status x%x\n", UsbDisplayLinkDev->FrameNextLine, DataLen, Status, USBStatus));
       break;
     }
+    UsbDisplayLinkDev->DataSent += DataLen;
+
     // Need an extra DlUsbBulkWrite if the data length is divisible by USB MaxPacketSize. This spare data will just get written into the (invisible) stride area.
     // Note that the API doesn't let us do a bulk write of 0.
     if ((DataLen & (UsbDisplayLinkDev->BulkOutEndpointDescriptor.MaxPacketSize - 1)) == 0) {
-      Status = DlUsbBulkWrite (UsbDisplayLinkDev, DstBuffer, 2, &USBStatus);
+      Status = DlUsbBulkWrite (UsbDisplayLinkDev, LinePtr, 2, &USBStatus);
       if (EFI_ERROR (Status)) {
-        DEBUG ((DEBUG_ERROR, "Screen update - USB bulk transfer of pixel data failed. Line %d len %d, failure code %r USB status x%x\n", H, DataLen, Status, USBStatus));
+        DEBUG ((DEBUG_ERROR, "Screen update - USB bulk transfer of pixel data failed. Line %d len %d, failure code %r USB status x%x\n", UsbDisplayLinkDev->FrameNextLine, DataLen, Status, USBStatus));
         break;
       }
     }
+    UsbDisplayLinkDev->FrameNextLine++;
   }
 
-  if (!EFI_ERROR (Status)) {
-    // If we've successfully transmitted the frame, reset the values that store which area of the screen has been BLTted to.
-    // If we haven't succeeded, this will mean we'll try to resend it after the next poll period.
-    UsbDisplayLinkDev->LastY2 = 0;
-    UsbDisplayLinkDev->LastY1 = (UINTN)-1;
+  if (EFI_ERROR (Status)) {
+    // If we haven't succeeded, mark the lines the device hasn't received as dirty, so we'll try to resend them after the next poll period.
+    OriginalTPL = gBS->RaiseTPL (TPL_NOTIFY);
+    DlGopMarkDirty (
+      UsbDisplayLinkDev,
+      0,
+      UsbDisplayLinkDev->FrameNextLine,
+      UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info->HorizontalResolution,
+      UsbDisplayLinkDev->FrameLastLine - UsbDisplayLinkDev->FrameNextLine);
+    gBS->RestoreTPL (OriginalTPL);
   }
 
-  // Payload with length of 1 to terminate the frame
-  // We need to do this even if we had an error, to indicate to the DL device that it should now expect a new frame.
-  DlUsbBulkWrite (UsbDisplayLinkDev, DstBuffer, 1, &USBStatus);
-
-  gBS->RestoreTPL (OriginalTPL);
+  if (EFI_ERROR (Status) || UsbDisplayLinkDev->FrameNextLine >= UsbDisplayLinkDev->FrameLastLine) {
+    EndScreenUpdate (UsbDisplayLinkDev);
+  }
 
   return Status;
 }
@@ -454,6 +638,11 @@ DisplayLinkSetMode (
   // When the GOP driver is sideloaded, the TPL of this call is TPL_APPLICATION (4) and the timer can interrupt us.
   Gop->Mode->Mode = GRAPHICS_OUTPUT_INVALID_MODE_NUMBER;
 
+  // Drop the rest of any frame being sent in the old mode
+  if (UsbDisplayLinkDev->FrameInProgress) {
+    EndScreenUpdate (UsbDisplayLinkDev);
+  }
+
   // Get a video mode from the EDID
   Status = DlEdidGetSupportedVideoModeWithFallback (ModeNumber, UsbDisplayLinkDev->EdidActive.Edid, UsbDisplayLinkDev->EdidActive.SizeOfEdid, &VideoMode);
 
@@ -486,6 +675,21 @@ DisplayLinkSetMode (
     return EFI_OUT_OF_RESOURCES;
   }
 
+  if (UsbDisplayLinkDev->DeviceFrame != NULL) {
+    FreePool (UsbDisplayLinkDev->DeviceFrame);
+  }
+
+  UsbDisplayLinkDev->DeviceFrame = (UINT8*)AllocateZeroPool (
+    Gop->Mode->Info->HorizontalResolution *
+    Gop->Mode->Info->VerticalResolution *
+    DISPLAYLINK_BYTES_PER_PIXEL);
+
+  if (UsbDisplayLinkDev->DeviceFrame == NULL) {
+    FreePool (UsbDisplayLinkDev->Screen);
+    UsbDisplayLinkDev->Screen = NULL;
+    return EFI_OUT_OF_RESOURCES;
+  }
+
   DEBUG ((DEBUG_INFO, "Video mode %d selected by BIOS - %d x %d.\n", ModeNumber, VideoMode->HActive, VideoMode->VActive));
   // Wait until we are sure that we can set the video mode before we tell the firmware
   Status = DlUsbSendControlWriteMessage (UsbDisplayLinkDev, SET_VIDEO_MODE, 0, VideoMode, sizeof (struct VideoMode));
@@ -496,7 +700,11 @@ DisplayLinkSetMode (
     Gop->Mode->Mode = GRAPHICS_OUTPUT_INVALID_MODE_NUMBER;
     FreePool (UsbDisplayLinkDev->Screen);
     UsbDisplayLinkDev->Screen = NULL;
+    FreePool (UsbDisplayLinkDev->DeviceFrame);
+    UsbDisplayLinkDev->DeviceFrame = NULL;
   } else {
+    // Forget any areas BLTted to in the previous mode - the whole screen is marked dirty below
+    UsbDisplayLinkDev->DirtyRectCount = 0;
     BuildBackBuffer (
       UsbDisplayLinkDev,
       UsbDisplayLinkDev->Screen,
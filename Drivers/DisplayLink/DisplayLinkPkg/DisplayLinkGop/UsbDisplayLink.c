@@ -159,8 +159,7 @@ InitializeUsbDisplayLinkDevice (
   Gop->Mode->FrameBufferSize = 0;
 
   // Prevent DlGopSendScreenUpdate from running until we are sure that the video mode is set
-  UsbDisplayLinkDev->LastY2 = 0;
-  UsbDisplayLinkDev->LastY1 = (UINTN)-1;
+  UsbDisplayLinkDev->DirtyRectCount = 0;
 
   return EFI_SUCCESS;
 }
@@ -533,11 +532,13 @@ DisplayLinkPeriodicTimer (
 
     if (Count++ % 50 == 0) {
       DlGopPrintTextToScreen (&UsbDisplayLinkDev->GraphicsOutputProtocol, 32, 48, (CONST CHAR16*)L"  Bandwidth: %d MB/s    ", UsbDisplayLinkDev->DataSent * 10000000 / DISPLAYLINK_SCREEN_UPDATE_TIMER_PERIOD / 50 / 1024 / 1024);
+      DlGopPrintTextToScreen (&UsbDisplayLinkDev->GraphicsOutputProtocol, 32, 64, (CONST CHAR16*)L"  Last frame: %lu lines in %lu us    ", (UINT64)UsbDisplayLinkDev->FrameLinesSent, DivU64x32 (UsbDisplayLinkDev->FrameTransferTimeNs, 1000));
       UsbDisplayLinkDev->DataSent = 0;
     }
   }
 
-  if (UsbDisplayLinkDev->ShowTestPattern)
+  // Don't interleave a test pattern with a screen update that is partly sent
+  if (UsbDisplayLinkDev->ShowTestPattern && !UsbDisplayLinkDev->FrameInProgress)
   {
     if (UsbDisplayLinkDev->ShowTestPattern == 5) {
       DlGopSendTestPattern (UsbDisplayLinkDev, 0);
@@ -549,11 +550,15 @@ DisplayLinkPeriodicTimer (
 
   }
 
-  // Send the latest version of the frame buffer to the DL device over USB
+  // Send the next part of the latest version of the frame buffer to the DL device over USB
   DlGopSendScreenUpdate (UsbDisplayLinkDev);
 
-  // Restart the timer now we've finished
-  Status = gBS->SetTimer (UsbDisplayLinkDev->TimerEvent, TimerRelative, DISPLAYLINK_SCREEN_UPDATE_TIMER_PERIOD);
+  // Restart the timer now we've finished. If the frame isn't complete, come back soon for the next part of it;
+  // in between, the rest of the system gets to run (and Blt() to the back buffer).
+  Status = gBS->SetTimer (
+    UsbDisplayLinkDev->TimerEvent,
+    TimerRelative,
+    UsbDisplayLinkDev->FrameInProgress ? DISPLAYLINK_SCREEN_UPDATE_CHUNK_PERIOD : DISPLAYLINK_SCREEN_UPDATE_TIMER_PERIOD);
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "Failed to create timer.\n"));
   }
@@ -1065,6 +1070,11 @@ UsbDisplayLinkDriverBindingStop (
     UsbDisplayLinkDev->Screen = NULL;
   }
 
+  if (UsbDisplayLinkDev->DeviceFrame != NULL) {
+    FreePool (UsbDisplayLinkDev->DeviceFrame);
+    UsbDisplayLinkDev->DeviceFrame = NULL;
+  }
+
   if (UsbDisplayLinkDev->GraphicsOutputProtocol.Mode) {
     if (UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info) {
       FreePool (UsbDisplayLinkDev->GraphicsOutputProtocol.Mode->Info);
@@ -20,10 +20,13 @@
 #include <Protocol/GraphicsOutput.h>
 #include <Protocol/UsbIo.h>
 
+#include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/MemoryAllocationLib.h>
+#include <Library/PixelConvertLib.h>
 #include <Library/ReportStatusCodeLib.h>
+#include <Library/TimerLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiLib.h>
 
@@ -41,9 +44,14 @@
 
 #define DISPLAYLINK_SCREEN_UPDATE_TIMER_PERIOD  ((UINTN)1000000) // 0.1s in us
 #define DISPLAYLINK_FULL_SCREEN_UPDATE_PERIOD   ((UINTN)30000) // 3s in ticks
+#define DISPLAYLINK_SCREEN_UPDATE_CHUNK_PERIOD  ((UINTN)10000) // 1ms in 100ns units, between the parts of a frame
+#define DISPLAYLINK_SCREEN_UPDATE_CHUNK_LINES   ((UINTN)64)    // Lines sent in each timer tick
 
 #define DISPLAYLINK_FIXED_VERTICAL_REFRESH_RATE ((UINT16)60)
 
+#define DISPLAYLINK_BYTES_PER_PIXEL   3   // The device takes 24 bits per pixel, RGB order
+#define DISPLAYLINK_DIRTY_RECT_MAX    4   // Dirty areas tracked before they are merged together
+
 // Requests to read values from the firmware
 #define EDID_BLOCK_SIZE 128
 #define EDID_DETAILED_TIMING_INVALID_PIXEL_CLOCK ((UINT16)(0x64))
@@ -65,6 +73,16 @@ typedef struct {
 
 #define GRAPHICS_OUTPUT_INVALID_MODE_NUMBER 0xffff
 
+/**
+ *  An area of the screen, X2 and Y2 are exclusive.
+ */
+typedef struct {
+  UINTN X1;
+  UINTN Y1;
+  UINTN X2;
+  UINTN Y2;
+} DISPLAYLINK_RECT;
+
 /**
  *  Device instance of USB display.
  */
@@ -85,10 +103,16 @@ typedef struct {
   EFI_EVENT                     DriverExitBootServicesEvent;
   BOOLEAN                       ShowBandwidth;                 /** Debugging - show the bandwidth on the screen */
   BOOLEAN                       ShowTestPattern;               /** Show a colourbar pattern instead of the BLTd contents of the framebuffer */
-  UINTN                         LastY1;                        /** Used to track if we can do a partial screen update */
-  UINTN                         LastY2;
-  UINTN                         LastWidth;
+  DISPLAYLINK_RECT              DirtyRect[DISPLAYLINK_DIRTY_RECT_MAX]; /** Areas BLTted to since the last screen update */
+  UINTN                         DirtyRectCount;
+  UINT8                         *DeviceFrame;                  /** The screen in the pixel format of the device */
   UINTN                         TimeSinceLastScreenUpdate;     /** Do a full screen update every (x) seconds */
+  BOOLEAN                       FrameInProgress;               /** A frame is being sent, a chunk of lines per timer tick */
+  UINTN                         FrameNextLine;
+  UINTN                         FrameLastLine;
+  UINT64                        FrameStartTicks;
+  UINT64                        FrameTransferTimeNs;           /** Debug - time taken to send the last frame */
+  UINTN                         FrameLinesSent;                /** Debug - lines sent in the last frame */
 } USB_DISPLAYLINK_DEV;
 
 #define USB_DISPLAYLINK_DEV_SIGNATURE SIGNATURE_32 ('d', 'l', 'i', 'n')
@@ -224,6 +248,15 @@ DlGopSendScreenUpdate (
   USB_DISPLAYLINK_DEV* UsbDisplayLinkDev
 );
 
+VOID
+DlGopMarkDirty (
+  USB_DISPLAYLINK_DEV* UsbDisplayLinkDev,
+  UINTN X,
+  UINTN Y,
+  UINTN Width,
+  UINTN Height
+);
+
 
 /* ******************************************* */
 /* ********  USB interface functions  ******** */
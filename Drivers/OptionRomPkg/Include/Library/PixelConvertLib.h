@@ -0,0 +1,124 @@
+/** @file
+  Library for converting pixels between the UEFI Graphics Output Protocol
+  Blt pixel format and the formats of video devices.
+
+  The conversions work on runs of pixels, e.g. a line of a Blt buffer.
+
+  Copyright (c) 2023, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef __PIXEL_CONVERT_LIB__
+#define __PIXEL_CONVERT_LIB__
+
+#include <Protocol/GraphicsOutput.h>
+
+
+/**
+  Convert Blt pixels to packed 24 bit pixels, in red, green, blue byte order.
+
+  @param[out] Destination   Buffer to receive PixelCount * 3 bytes
+  @param[in]  Source        Pixels to convert
+  @param[in]  PixelCount    Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+PixelConvertBltToRgb888 (
+  OUT UINT8                                 *Destination,
+  IN  CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL   *Source,
+  IN  UINTN                                 PixelCount
+  );
+
+
+/**
+  Convert packed 24 bit pixels, in red, green, blue byte order, to Blt pixels.
+
+  @param[out] Destination   Buffer to receive the pixels
+  @param[in]  Source        PixelCount * 3 bytes to convert
+  @param[in]  PixelCount    Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+PixelConvertRgb888ToBlt (
+  OUT EFI_GRAPHICS_OUTPUT_BLT_PIXEL         *Destination,
+  IN  CONST UINT8                           *Source,
+  IN  UINTN                                 PixelCount
+  );
+
+
+/**
+  Convert Blt pixels to 16 bit pixels, with 5 bits of red in the most
+  significant bits, 6 bits of green, and 5 bits of blue.
+
+  @param[out] Destination   Buffer to receive the pixels
+  @param[in]  Source        Pixels to convert
+  @param[in]  PixelCount    Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+PixelConvertBltToRgb565 (
+  OUT UINT16                                *Destination,
+  IN  CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL   *Source,
+  IN  UINTN                                 PixelCount
+  );
+
+
+/**
+  Convert 16 bit pixels, with 5 bits of red in the most significant bits,
+  6 bits of green, and 5 bits of blue, to Blt pixels. The top bits of each
+  component are replicated into its low bits, so full intensity is 0xff.
+
+  @param[out] Destination   Buffer to receive the pixels
+  @param[in]  Source        Pixels to convert
+  @param[in]  PixelCount    Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+PixelConvertRgb565ToBlt (
+  OUT EFI_GRAPHICS_OUTPUT_BLT_PIXEL         *Destination,
+  IN  CONST UINT16                          *Source,
+  IN  UINTN                                 PixelCount
+  );
+
+
+/**
+  Convert Blt pixels to the PixelRedGreenBlueReserved8BitPerColor format.
+  The reserved byte is cleared.
+
+  @param[out] Destination   Buffer to receive the pixels
+  @param[in]  Source        Pixels to convert
+  @param[in]  PixelCount    Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+PixelConvertBltToRgba (
+  OUT UINT32                                *Destination,
+  IN  CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL   *Source,
+  IN  UINTN                                 PixelCount
+  );
+
+
+/**
+  Convert pixels in the PixelRedGreenBlueReserved8BitPerColor format to
+  Blt pixels. The reserved byte is cleared.
+
+  @param[out] Destination   Buffer to receive the pixels
+  @param[in]  Source        Pixels to convert
+  @param[in]  PixelCount    Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+PixelConvertRgbaToBlt (
+  OUT EFI_GRAPHICS_OUTPUT_BLT_PIXEL         *Destination,
+  IN  CONST UINT32                          *Source,
+  IN  UINTN                                 PixelCount
+  );
+
+#endif
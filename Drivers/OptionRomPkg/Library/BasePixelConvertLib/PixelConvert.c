@@ -0,0 +1,179 @@
+/** @file
+  BasePixelConvertLib - Library to convert pixels between the Blt pixel
+  format and the formats of video devices.
+
+  Copyright (c) 2023, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <Library/PixelConvertLib.h>
+
+//
+// Swap the red and blue bytes of a pixel, and clear the reserved byte.
+// This converts between the Blt pixel and the little endian value of a
+// PixelRedGreenBlueReserved8BitPerColor pixel, in both directions.
+//
+#define SWAP_RED_BLUE(Pixel) \
+  ((((Pixel) >> 16) & 0x0000ff) | ((Pixel) & 0x00ff00) | (((Pixel) & 0x0000ff) << 16))
+
+
+/**
+  Convert Blt pixels to packed 24 bit pixels, in red, green, blue byte order.
+
+  @param[out] Destination   Buffer to receive PixelCount * 3 bytes
+  @param[in]  Source        Pixels to convert
+  @param[in]  PixelCount    Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+PixelConvertBltToRgb888 (
+  OUT UINT8                                 *Destination,
+  IN  CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL   *Source,
+  IN  UINTN                                 PixelCount
+  )
+{
+  for (; PixelCount > 0; PixelCount--, Source++) {
+    *Destination++ = Source->Red;
+    *Destination++ = Source->Green;
+    *Destination++ = Source->Blue;
+  }
+}
+
+
+/**
+  Convert packed 24 bit pixels, in red, green, blue byte order, to Blt pixels.
+
+  @param[out] Destination   Buffer to receive the pixels
+  @param[in]  Source        PixelCount * 3 bytes to convert
+  @param[in]  PixelCount    Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+PixelConvertRgb888ToBlt (
+  OUT EFI_GRAPHICS_OUTPUT_BLT_PIXEL         *Destination,
+  IN  CONST UINT8                           *Source,
+  IN  UINTN                                 PixelCount
+  )
+{
+  for (; PixelCount > 0; PixelCount--, Destination++) {
+    Destination->Red      = *Source++;
+    Destination->Green    = *Source++;
+    Destination->Blue     = *Source++;
+    Destination->Reserved = 0;
+  }
+}
+
+
+/**
+  Convert Blt pixels to 16 bit pixels, with 5 bits of red in the most
+  significant bits, 6 bits of green, and 5 bits of blue.
+
+  @param[out] Destination   Buffer to receive the pixels
+  @param[in]  Source        Pixels to convert
+  @param[in]  PixelCount    Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+PixelConvertBltToRgb565 (
+  OUT UINT16                                *Destination,
+  IN  CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL   *Source,
+  IN  UINTN                                 PixelCount
+  )
+{
+  for (; PixelCount > 0; PixelCount--, Source++) {
+    *Destination++ = (UINT16) (
+                       ((Source->Red & 0xf8) << 8) |
+                       ((Source->Green & 0xfc) << 3) |
+                       (Source->Blue >> 3)
+                       );
+  }
+}
+
+
+/**
+  Convert 16 bit pixels, with 5 bits of red in the most significant bits,
+  6 bits of green, and 5 bits of blue, to Blt pixels. The top bits of each
+  component are replicated into its low bits, so full intensity is 0xff.
+
+  @param[out] Destination   Buffer to receive the pixels
+  @param[in]  Source        Pixels to convert
+  @param[in]  PixelCount    Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+PixelConvertRgb565ToBlt (
+  OUT EFI_GRAPHICS_OUTPUT_BLT_PIXEL         *Destination,
+  IN  CONST UINT16                          *Source,
+  IN  UINTN                                 PixelCount
+  )
+{
+  UINT16  Pixel;
+
+  for (; PixelCount > 0; PixelCount--, Destination++) {
+    Pixel = *Source++;
+    Destination->Red      = (UINT8) (((Pixel >> 8) & 0xf8) | ((Pixel >> 13) & 0x07));
+    Destination->Green    = (UINT8) (((Pixel >> 3) & 0xfc) | ((Pixel >> 9) & 0x03));
+    Destination->Blue     = (UINT8) ((Pixel << 3) | ((Pixel >> 2) & 0x07));
+    Destination->Reserved = 0;
+  }
+}
+
+
+/**
+  Convert Blt pixels to the PixelRedGreenBlueReserved8BitPerColor format.
+  The reserved byte is cleared.
+
+  @param[out] Destination   Buffer to receive the pixels
+  @param[in]  Source        Pixels to convert
+  @param[in]  PixelCount    Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+PixelConvertBltToRgba (
+  OUT UINT32                                *Destination,
+  IN  CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL   *Source,
+  IN  UINTN                                 PixelCount
+  )
+{
+  CONST UINT32  *Src;
+
+  Src = (CONST UINT32 *) Source;
+  for (; PixelCount > 0; PixelCount--) {
+    *Destination++ = SWAP_RED_BLUE (*Src);
+    Src++;
+  }
+}
+
+
+/**
+  Convert pixels in the PixelRedGreenBlueReserved8BitPerColor format to
+  Blt pixels. The reserved byte is cleared.
+
+  @param[out] Destination   Buffer to receive the pixels
+  @param[in]  Source        Pixels to convert
+  @param[in]  PixelCount    Number of pixels to convert
+
+**/
+VOID
+EFIAPI
+PixelConvertRgbaToBlt (
+  OUT EFI_GRAPHICS_OUTPUT_BLT_PIXEL         *Destination,
+  IN  CONST UINT32                          *Source,
+  IN  UINTN                                 PixelCount
+  )
+{
+  UINT32  *Dst;
+
+  Dst = (UINT32 *) Destination;
+  for (; PixelCount > 0; PixelCount--) {
+    *Dst++ = SWAP_RED_BLUE (*Source);
+    Source++;
+  }
+}
@@ -11,6 +11,7 @@
 #include <Library/BaseMemoryLib.h>
 #include <Library/BltLib.h>
 #include <Library/DebugLib.h>
+#include <Library/PixelConvertLib.h>
 
 #if 0
 #define VDEBUG DEBUG
@@ -29,6 +30,7 @@ UINT8                           mBltLibLineBuffer[MAX_LINE_BUFFER_SIZE];
 UINT8                           *mBltLibFrameBuffer;
 EFI_GRAPHICS_PIXEL_FORMAT       mPixelFormat;
 EFI_PIXEL_BITMASK               mPixelBitMasks;
+BOOLEAN                         mPixelFormatIsRgb565;
 INTN                            mPixelShl[4]; // R-G-B-Rsvd
 INTN                            mPixelShr[4]; // R-G-B-Rsvd
 
@@ -90,6 +92,8 @@ BltLibConfigure (
     { 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000 };
   STATIC EFI_PIXEL_BITMASK  BgrPixelMasks =
     { 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000 };
+  STATIC EFI_PIXEL_BITMASK  Rgb565PixelMasks =
+    { 0x0000f800, 0x000007e0, 0x0000001f, 0x00000000 };
 
   switch (FrameBufferInfo->PixelFormat) {
   case PixelRedGreenBlueReserved8BitPerColor:
@@ -109,6 +113,10 @@ BltLibConfigure (
     return EFI_INVALID_PARAMETER;
   }
   mPixelFormat = FrameBufferInfo->PixelFormat;
+  mPixelFormatIsRgb565 = (BOOLEAN) (
+                           (mPixelFormat == PixelBitMask) &&
+                           (CompareMem (&mPixelBitMasks, &Rgb565PixelMasks, sizeof (Rgb565PixelMasks)) == 0)
+                           );
 
   mBltLibFrameBuffer = (UINT8*) FrameBuffer;
   mBltLibWidthInPixels = (UINTN) FrameBufferInfo->HorizontalResolution;
@@ -477,7 +485,19 @@ BltLibVideoToBltBufferEx (
 
     CopyMem (BltMemDst, BltMemSrc, WidthInBytes);
 
-    if (mPixelFormat != PixelBlueGreenRedReserved8BitPerColor) {
+    if (mPixelFormat == PixelRedGreenBlueReserved8BitPerColor) {
+      PixelConvertRgbaToBlt (
+        (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *) ((UINT8 *) BltBuffer + (DstY * Delta) + DestinationX * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL)),
+        (UINT32 *) mBltLibLineBuffer,
+        Width
+        );
+    } else if (mPixelFormatIsRgb565) {
+      PixelConvertRgb565ToBlt (
+        (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *) ((UINT8 *) BltBuffer + (DstY * Delta) + DestinationX * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL)),
+        (UINT16 *) mBltLibLineBuffer,
+        Width
+        );
+    } else if (mPixelFormat != PixelBlueGreenRedReserved8BitPerColor) {
       for (X = 0; X < Width; X++) {
         Blt         = (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *) ((UINT8 *) BltBuffer + (DstY * Delta) + (DestinationX + X) * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL));
         Uint32 = *(UINT32*) (mBltLibLineBuffer + (X * mBltLibBytesPerPixel));
@@ -607,6 +627,20 @@ BltLibBufferToVideoEx (
 
     if (mPixelFormat == PixelBlueGreenRedReserved8BitPerColor) {
       BltMemSrc = (VOID *) ((UINT8 *) BltBuffer + (SrcY * Delta));
+    } else if (mPixelFormat == PixelRedGreenBlueReserved8BitPerColor) {
+      PixelConvertBltToRgba (
+        (UINT32 *) mBltLibLineBuffer,
+        (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *) ((UINT8 *) BltBuffer + (SrcY * Delta) + SourceX * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL)),
+        Width
+        );
+      BltMemSrc = (VOID *) mBltLibLineBuffer;
+    } else if (mPixelFormatIsRgb565) {
+      PixelConvertBltToRgb565 (
+        (UINT16 *) mBltLibLineBuffer,
+        (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *) ((UINT8 *) BltBuffer + (SrcY * Delta) + SourceX * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL)),
+        Width
+        );
+      BltMemSrc = (VOID *) mBltLibLineBuffer;
     } else {
       for (X = 0; X < Width; X++) {
         Blt =
@@ -0,0 +1,1200 @@
+/** @file
+  Block and inode allocation routines
+
+  Copyright (c) 2024 Pedro Falcato All rights reserved.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  Blocks and inodes are allocated through the bitmaps of the block groups,
+  whose changes, and those of the block group descriptors, are made in a
+  transaction. Groups with uninitialized bitmaps (EXT4_BG_BLOCK_UNINIT and
+  EXT4_BG_INODE_UNINIT) get them initialized the first time they're used.
+**/
+
+#include "Ext4Dxe.h"
+
+/**
+   Retrieves the first block of the block group descriptor table.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+
+   @return The block number.
+**/
+#define EXT4_GDT_START(Partition)  ((Partition)->BlockSize == 1024 ? 2 : 1)
+
+/**
+   Retrieves the first block of a block group.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      Group         Block group number.
+
+   @return The block number.
+**/
+STATIC
+EXT4_BLOCK_NR
+Ext4GroupFirstBlock (
+  IN EXT4_PARTITION  *Partition,
+  IN UINT32          Group
+  )
+{
+  return Partition->SuperBlock.s_first_data_block + MultU64x32 (Group, Partition->SuperBlock.s_blocks_per_group);
+}
+
+/**
+   Retrieves the number of blocks of a block group; the last group may be
+   shorter than the others.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      Group         Block group number.
+
+   @return The number of blocks.
+**/
+STATIC
+UINT32
+Ext4GroupNumberBlocks (
+  IN EXT4_PARTITION  *Partition,
+  IN UINT32          Group
+  )
+{
+  return (UINT32)MIN (
+                   Partition->SuperBlock.s_blocks_per_group,
+                   Partition->NumberBlocks - Ext4GroupFirstBlock (Partition, Group)
+                   );
+}
+
+/**
+   Checks if a number is a power of another.
+
+   @param[in]      Number        Number to check.
+   @param[in]      Base          Base of the power.
+
+   @return TRUE if Number is a power of Base, else FALSE.
+**/
+STATIC
+BOOLEAN
+Ext4IsPowerOf (
+  IN UINT32  Number,
+  IN UINT32  Base
+  )
+{
+  while ((Number % Base) == 0 && Number > 1) {
+    Number /= Base;
+  }
+
+  return Number == 1;
+}
+
+/**
+   Checks if a block group holds a backup of the superblock and of the block
+   group descriptor table.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      Group         Block group number.
+
+   @return TRUE if the group holds a backup, else FALSE.
+**/
+STATIC
+BOOLEAN
+Ext4GroupHasSuper (
+  IN EXT4_PARTITION  *Partition,
+  IN UINT32          Group
+  )
+{
+  if (Group == 0) {
+    return TRUE;
+  }
+
+  if (EXT4_HAS_COMPAT (Partition, EXT4_FEATURE_COMPAT_SPARSE_SUPER2)) {
+    return (Group == Partition->SuperBlock.s_backup_bgs[0]) || (Group == Partition->SuperBlock.s_backup_bgs[1]);
+  }
+
+  if ((Group == 1) || !EXT4_HAS_RO_COMPAT (Partition, EXT4_FEATURE_RO_COMPAT_SPARSE_SUPER)) {
+    return TRUE;
+  }
+
+  return Ext4IsPowerOf (Group, 3) || Ext4IsPowerOf (Group, 5) || Ext4IsPowerOf (Group, 7);
+}
+
+/**
+   Reads a field split between the low and high halves of a block group
+   descriptor; high halves only exist in 64-bit descriptors.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      Low           Low half.
+   @param[in]      High          High half.
+
+   @return The value of the field.
+**/
+#define EXT4_DESC_FIELD(Partition, Low, High)                                  \
+  ((UINT32)(Low) | (EXT4_IS_64_BIT (Partition) ? (UINT32)(High) << 16 : 0))
+
+/**
+   Writes a field split between the low and high halves of a block group
+   descriptor.
+
+   A function rather than a macro: Value is usually computed from the field
+   itself, and must not be evaluated again once the low half is written.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[out]     Low           Low half.
+   @param[out]     High          High half.
+   @param[in]      Value         Value of the field.
+**/
+STATIC
+VOID
+Ext4SetDescField (
+  IN  CONST EXT4_PARTITION  *Partition,
+  OUT UINT16                *Low,
+  OUT UINT16                *High,
+  IN  UINT32                Value
+  )
+{
+  *Low = (UINT16)Value;
+
+  if (EXT4_IS_64_BIT (Partition)) {
+    *High = (UINT16)(Value >> 16);
+  }
+}
+
+/**
+   Gets a block group descriptor, from the transaction if it holds its
+   block, else from the partition. The descriptor must not be modified.
+
+   @param[in]      Txn           Pointer to the transaction.
+   @param[in]      Group         Block group number.
+
+   @return Pointer to the descriptor.
+**/
+STATIC
+CONST EXT4_BLOCK_GROUP_DESC *
+Ext4PeekBlockGroupDesc (
+  IN EXT4_TRANSACTION  *Txn,
+  IN UINT32            Group
+  )
+{
+  EXT4_PARTITION  *Partition;
+  UINT64          Offset;
+  UINT8           *Data;
+
+  Partition = Txn->Partition;
+  Offset    = MultU64x32 (Group, Partition->DescSize);
+  Data      = Ext4TxnFindBlock (Txn, EXT4_GDT_START (Partition) + DivU64x32 (Offset, Partition->BlockSize));
+
+  if (Data == NULL) {
+    return Ext4GetBlockGroupDesc (Partition, Group);
+  }
+
+  return (EXT4_BLOCK_GROUP_DESC *)(Data + (UINTN)(Offset % Partition->BlockSize));
+}
+
+/**
+   Gets the transaction's copy of a block group descriptor.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      Group         Block group number.
+   @param[out]     Desc          Pointer to the descriptor.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4TxnGetBlockGroupDesc (
+  IN OUT EXT4_TRANSACTION       *Txn,
+  IN     UINT32                 Group,
+  OUT    EXT4_BLOCK_GROUP_DESC  **Desc
+  )
+{
+  EXT4_PARTITION  *Partition;
+  UINT64          Offset;
+  UINT8           *Data;
+  EFI_STATUS      Status;
+
+  Partition = Txn->Partition;
+  Offset    = MultU64x32 (Group, Partition->DescSize);
+
+  Status = Ext4TxnGetBlock (
+             Txn,
+             EXT4_GDT_START (Partition) + DivU64x32 (Offset, Partition->BlockSize),
+             FALSE,
+             &Data
+             );
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *Desc = (EXT4_BLOCK_GROUP_DESC *)(Data + (UINTN)(Offset % Partition->BlockSize));
+  return EFI_SUCCESS;
+}
+
+/**
+   Updates the checksum of a block group descriptor, if the filesystem has them.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in out]  Desc          Pointer to the descriptor.
+   @param[in]      Group         Block group number.
+**/
+STATIC
+VOID
+Ext4UpdateBlockGroupDescChecksum (
+  IN     EXT4_PARTITION         *Partition,
+  IN OUT EXT4_BLOCK_GROUP_DESC  *Desc,
+  IN     UINT32                 Group
+  )
+{
+  if (EXT4_HAS_METADATA_CSUM (Partition) || EXT4_HAS_GDT_CSUM (Partition)) {
+    Desc->bg_checksum = Ext4CalculateBlockGroupDescChecksum (Partition, Desc, Group);
+  }
+}
+
+/**
+   Updates the checksums of the bitmaps of a block group, if the filesystem has them.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in out]  Desc          Pointer to the descriptor.
+   @param[in]      BlockBitmap   Pointer to the block bitmap, or NULL if unchanged.
+   @param[in]      InodeBitmap   Pointer to the inode bitmap, or NULL if unchanged.
+**/
+STATIC
+VOID
+Ext4UpdateBitmapChecksums (
+  IN     EXT4_PARTITION         *Partition,
+  IN OUT EXT4_BLOCK_GROUP_DESC  *Desc,
+  IN     CONST UINT8            *BlockBitmap OPTIONAL,
+  IN     CONST UINT8            *InodeBitmap OPTIONAL
+  )
+{
+  UINT32  Csum;
+
+  if (!EXT4_HAS_METADATA_CSUM (Partition)) {
+    return;
+  }
+
+  if (BlockBitmap != NULL) {
+    Csum = Ext4CalculateChecksum (
+             Partition,
+             BlockBitmap,
+             Partition->SuperBlock.s_blocks_per_group / 8,
+             Partition->InitialSeed
+             );
+    Desc->bg_block_bitmap_csum_lo = (UINT16)Csum;
+
+    if (Partition->DescSize >= EXT4_BG_BLOCK_BITMAP_CSUM_HI_END) {
+      Desc->bg_block_bitmap_csum_hi = (UINT16)(Csum >> 16);
+    }
+  }
+
+  if (InodeBitmap != NULL) {
+    Csum = Ext4CalculateChecksum (
+             Partition,
+             InodeBitmap,
+             Partition->SuperBlock.s_inodes_per_group / 8,
+             Partition->InitialSeed
+             );
+    Desc->bg_inode_bitmap_csum_lo = (UINT16)Csum;
+
+    if (Partition->DescSize >= EXT4_BG_INODE_BITMAP_CSUM_HI_END) {
+      Desc->bg_inode_bitmap_csum_hi = (UINT16)(Csum >> 16);
+    }
+  }
+}
+
+/**
+   Checks if a bit of a bitmap is set.
+
+   @param[in]      Bitmap        Pointer to the bitmap.
+   @param[in]      Bit           Index of the bit.
+
+   @return TRUE if the bit is set, else FALSE.
+**/
+#define EXT4_BITMAP_TEST(Bitmap, Bit)  (((Bitmap)[(Bit) / 8] & (1 << ((Bit) % 8))) != 0)
+
+/**
+   Sets or clears a range of bits of a bitmap.
+
+   @param[in out]  Bitmap        Pointer to the bitmap.
+   @param[in]      Start         Index of the first bit.
+   @param[in]      Count         Number of bits.
+   @param[in]      Set           TRUE to set the bits, FALSE to clear them.
+**/
+STATIC
+VOID
+Ext4BitmapSetRange (
+  IN OUT UINT8    *Bitmap,
+  IN     UINT32   Start,
+  IN     UINT32   Count,
+  IN     BOOLEAN  Set
+  )
+{
+  UINT32  Bit;
+
+  for (Bit = Start; Bit < Start + Count; Bit++) {
+    if (Set) {
+      Bitmap[Bit / 8] |= (UINT8)(1 << (Bit % 8));
+    } else {
+      Bitmap[Bit / 8] &= (UINT8) ~(1 << (Bit % 8));
+    }
+  }
+}
+
+/**
+   Marks the blocks of a block group that a range of blocks covers as used,
+   in the group's block bitmap.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      Group         Block group number.
+   @param[in out]  Bitmap        Pointer to the group's block bitmap.
+   @param[in]      Start         First block of the range.
+   @param[in]      Count         Number of blocks of the range.
+**/
+STATIC
+VOID
+Ext4MarkGroupBlocks (
+  IN     EXT4_PARTITION  *Partition,
+  IN     UINT32          Group,
+  IN OUT UINT8           *Bitmap,
+  IN     EXT4_BLOCK_NR   Start,
+  IN     UINT64          Count
+  )
+{
+  EXT4_BLOCK_NR  First;
+  EXT4_BLOCK_NR  End;
+
+  First = Ext4GroupFirstBlock (Partition, Group);
+  End   = First + Ext4GroupNumberBlocks (Partition, Group);
+
+  if ((Start >= End) || (Start + Count <= First)) {
+    return;
+  }
+
+  Count = MIN (Start + Count, End) - MAX (Start, First);
+  Start = MAX (Start, First);
+
+  Ext4BitmapSetRange (Bitmap, (UINT32)(Start - First), (UINT32)Count, TRUE);
+}
+
+/**
+   Builds the block bitmap of a group that has EXT4_BG_BLOCK_UNINIT, in which
+   only the group's metadata is in use.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      Group         Block group number.
+   @param[in]      Desc          Pointer to the group's descriptor.
+   @param[out]     Bitmap        Pointer to the bitmap.
+
+   @retval EFI_SUCCESS           The bitmap was built.
+   @retval EFI_VOLUME_CORRUPTED  The bitmap doesn't match the group's free block count.
+**/
+STATIC
+EFI_STATUS
+Ext4InitBlockBitmap (
+  IN  EXT4_PARTITION               *Partition,
+  IN  UINT32                       Group,
+  IN  CONST EXT4_BLOCK_GROUP_DESC  *Desc,
+  OUT UINT8                        *Bitmap
+  )
+{
+  UINT32  NumberBlocks;
+  UINT32  GdtBlocks;
+  UINT32  ItableBlocks;
+  UINT32  Free;
+  UINT32  Bit;
+
+  NumberBlocks = Ext4GroupNumberBlocks (Partition, Group);
+  GdtBlocks    = (UINT32)DivU64x32 (
+                           MultU64x32 (Partition->NumberBlockGroups, Partition->DescSize) + Partition->BlockSize - 1,
+                           Partition->BlockSize
+                           );
+  ItableBlocks = (UINT32)DivU64x32 (
+                           MultU64x32 (Partition->SuperBlock.s_inodes_per_group, Partition->InodeSize) +
+                           Partition->BlockSize - 1,
+                           Partition->BlockSize
+                           );
+
+  ZeroMem (Bitmap, Partition->BlockSize);
+
+  // The superblock, the descriptors and the blocks reserved for them to grow
+  if (Ext4GroupHasSuper (Partition, Group)) {
+    Ext4BitmapSetRange (Bitmap, 0, MIN (1 + GdtBlocks + Partition->SuperBlock.unused, NumberBlocks), TRUE);
+  }
+
+  // With flex_bg, the group's own bitmaps and inode table may be elsewhere
+  Ext4MarkGroupBlocks (
+    Partition,
+    Group,
+    Bitmap,
+    EXT4_BLOCK_NR_FROM_HALFS (Partition, Desc->bg_block_bitmap_lo, Desc->bg_block_bitmap_hi),
+    1
+    );
+  Ext4MarkGroupBlocks (
+    Partition,
+    Group,
+    Bitmap,
+    EXT4_BLOCK_NR_FROM_HALFS (Partition, Desc->bg_inode_bitmap_lo, Desc->bg_inode_bitmap_hi),
+    1
+    );
+  Ext4MarkGroupBlocks (
+    Partition,
+    Group,
+    Bitmap,
+    EXT4_BLOCK_NR_FROM_HALFS (Partition, Desc->bg_inode_table_lo, Desc->bg_inode_table_hi),
+    ItableBlocks
+    );
+
+  Free = 0;
+
+  for (Bit = 0; Bit < NumberBlocks; Bit++) {
+    if (!EXT4_BITMAP_TEST (Bitmap, Bit)) {
+      Free++;
+    }
+  }
+
+  // Blocks past the end of the filesystem are never free
+  Ext4BitmapSetRange (Bitmap, NumberBlocks, Partition->BlockSize * 8 - NumberBlocks, TRUE);
+
+  if (Free != EXT4_DESC_FIELD (Partition, Desc->bg_free_blocks_count_lo, Desc->bg_free_blocks_count_hi)) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Uninitialized block group %u has %u free blocks, expected %u\n", Group, Free,
+            EXT4_DESC_FIELD (Partition, Desc->bg_free_blocks_count_lo, Desc->bg_free_blocks_count_hi)));
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Gets the transaction's copies of a block group's descriptor and block
+   bitmap, initializing the bitmap if the group has EXT4_BG_BLOCK_UNINIT.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      Group         Block group number.
+   @param[out]     Desc          Pointer to the descriptor.
+   @param[out]     Bitmap        Pointer to the bitmap.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4TxnGetBlockBitmap (
+  IN OUT EXT4_TRANSACTION       *Txn,
+  IN     UINT32                 Group,
+  OUT    EXT4_BLOCK_GROUP_DESC  **Desc,
+  OUT    UINT8                  **Bitmap
+  )
+{
+  EXT4_PARTITION  *Partition;
+  EFI_STATUS      Status;
+  BOOLEAN         Uninit;
+
+  Partition = Txn->Partition;
+
+  Status = Ext4TxnGetBlockGroupDesc (Txn, Group, Desc);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Uninit = ((*Desc)->bg_flags & EXT4_BG_BLOCK_UNINIT) != 0;
+
+  Status = Ext4TxnGetBlock (
+             Txn,
+             EXT4_BLOCK_NR_FROM_HALFS (Partition, (*Desc)->bg_block_bitmap_lo, (*Desc)->bg_block_bitmap_hi),
+             Uninit,
+             Bitmap
+             );
+
+  if (EFI_ERROR (Status) || !Uninit) {
+    return Status;
+  }
+
+  Status = Ext4InitBlockBitmap (Partition, Group, *Desc, *Bitmap);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  (*Desc)->bg_flags &= ~EXT4_BG_BLOCK_UNINIT;
+  Ext4UpdateBitmapChecksums (Partition, *Desc, *Bitmap, NULL);
+  Ext4UpdateBlockGroupDescChecksum (Partition, *Desc, Group);
+  return EFI_SUCCESS;
+}
+
+/**
+   Gets the transaction's copies of a block group's descriptor and inode
+   bitmap, initializing the bitmap if the group has EXT4_BG_INODE_UNINIT.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      Group         Block group number.
+   @param[out]     Desc          Pointer to the descriptor.
+   @param[out]     Bitmap        Pointer to the bitmap.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4TxnGetInodeBitmap (
+  IN OUT EXT4_TRANSACTION       *Txn,
+  IN     UINT32                 Group,
+  OUT    EXT4_BLOCK_GROUP_DESC  **Desc,
+  OUT    UINT8                  **Bitmap
+  )
+{
+  EXT4_PARTITION  *Partition;
+  EFI_STATUS      Status;
+  BOOLEAN         Uninit;
+  UINT32          InodesPerGroup;
+
+  Partition      = Txn->Partition;
+  InodesPerGroup = Partition->SuperBlock.s_inodes_per_group;
+
+  Status = Ext4TxnGetBlockGroupDesc (Txn, Group, Desc);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Uninit = ((*Desc)->bg_flags & EXT4_BG_INODE_UNINIT) != 0;
+
+  Status = Ext4TxnGetBlock (
+             Txn,
+             EXT4_BLOCK_NR_FROM_HALFS (Partition, (*Desc)->bg_inode_bitmap_lo, (*Desc)->bg_inode_bitmap_hi),
+             Uninit,
+             Bitmap
+             );
+
+  if (EFI_ERROR (Status) || !Uninit) {
+    return Status;
+  }
+
+  if (EXT4_DESC_FIELD (Partition, (*Desc)->bg_free_inodes_count_lo, (*Desc)->bg_free_inodes_count_hi) != InodesPerGroup) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  // Inodes past the end of the group are never free
+  Ext4BitmapSetRange (*Bitmap, InodesPerGroup, Partition->BlockSize * 8 - InodesPerGroup, TRUE);
+
+  (*Desc)->bg_flags &= ~EXT4_BG_INODE_UNINIT;
+  Ext4UpdateBitmapChecksums (Partition, *Desc, NULL, *Bitmap);
+  Ext4UpdateBlockGroupDescChecksum (Partition, *Desc, Group);
+  return EFI_SUCCESS;
+}
+
+/**
+   Checks if a block was freed by a transaction, which makes it unavailable
+   until the transaction commits.
+
+   @param[in]      Txn           Pointer to the transaction.
+   @param[in]      Block         Block number.
+
+   @return TRUE if the block was freed by the transaction, else FALSE.
+**/
+STATIC
+BOOLEAN
+Ext4TxnFreedBlock (
+  IN CONST EXT4_TRANSACTION  *Txn,
+  IN EXT4_BLOCK_NR           Block
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Txn->NumberFreed; Index++) {
+    if ((Block >= Txn->Freed[Index].Start) && (Block - Txn->Freed[Index].Start < Txn->Freed[Index].Count)) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+   Checks if a block of a group can be allocated.
+
+   @param[in]      Txn           Pointer to the transaction.
+   @param[in]      Bitmap        Pointer to the group's block bitmap.
+   @param[in]      First         First block of the group.
+   @param[in]      Bit           Index of the block in the group.
+
+   @return TRUE if the block is free, else FALSE.
+**/
+STATIC
+BOOLEAN
+Ext4BlockIsFree (
+  IN CONST EXT4_TRANSACTION  *Txn,
+  IN CONST UINT8             *Bitmap,
+  IN EXT4_BLOCK_NR           First,
+  IN UINT32                  Bit
+  )
+{
+  return !EXT4_BITMAP_TEST (Bitmap, Bit) && !Ext4TxnFreedBlock (Txn, First + Bit);
+}
+
+/**
+   Finds a run of free blocks in a block group. A run that starts at the goal
+   is preferred, so that files stay contiguous, then the first run that is
+   long enough, looking from the goal onwards, then the longest run.
+
+   @param[in]      Txn           Pointer to the transaction.
+   @param[in]      Bitmap        Pointer to the group's block bitmap.
+   @param[in]      First         First block of the group.
+   @param[in]      NumberBlocks  Number of blocks of the group.
+   @param[in]      Goal          Index of the goal block in the group.
+   @param[in]      Count         Wanted number of blocks.
+   @param[out]     RunStart      Index of the first block of the run.
+
+   @return Length of the run, 0 if the group has no free block.
+**/
+STATIC
+UINT32
+Ext4FindFreeRun (
+  IN  CONST EXT4_TRANSACTION  *Txn,
+  IN  CONST UINT8             *Bitmap,
+  IN  EXT4_BLOCK_NR           First,
+  IN  UINT32                  NumberBlocks,
+  IN  UINT32                  Goal,
+  IN  UINT32                  Count,
+  OUT UINT32                  *RunStart
+  )
+{
+  UINT32  Pass;
+  UINT32  Bit;
+  UINT32  End;
+  UINT32  Start;
+  UINT32  Length;
+  UINT32  BestLength;
+
+  BestLength = 0;
+
+  // Look from the goal to the end of the group, then from its start to the goal
+  for (Pass = 0; Pass < 2; Pass++) {
+    Bit = Pass == 0 ? Goal : 0;
+    End = Pass == 0 ? NumberBlocks : Goal;
+
+    while (Bit < End) {
+      // Whole bytes of used blocks are skipped at once
+      if (((Bit % 8) == 0) && (Bitmap[Bit / 8] == 0xFF)) {
+        Bit += 8;
+        continue;
+      }
+
+      if (!Ext4BlockIsFree (Txn, Bitmap, First, Bit)) {
+        Bit++;
+        continue;
+      }
+
+      Start  = Bit;
+      Length = 0;
+
+      while (Bit < NumberBlocks && Length < Count && Ext4BlockIsFree (Txn, Bitmap, First, Bit)) {
+        Bit++;
+        Length++;
+      }
+
+      if ((Start == Goal) || (Length == Count)) {
+        *RunStart = Start;
+        return Length;
+      }
+
+      if (Length > BestLength) {
+        BestLength = Length;
+        *RunStart  = Start;
+      }
+    }
+  }
+
+  return BestLength;
+}
+
+/**
+   Allocates a run of blocks, as close as possible to a goal block.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      Goal          Preferred first block.
+   @param[in]      Count         Wanted number of blocks.
+   @param[out]     Start         First allocated block.
+   @param[out]     Allocated     Number of allocated blocks, between 1 and Count.
+
+   @retval EFI_SUCCESS           Blocks were allocated.
+   @retval EFI_VOLUME_FULL       No block is free.
+   @retval EFI_OUT_OF_RESOURCES  The transaction is full.
+   @retval !EFI_SUCCESS          Failure.
+**/
+EFI_STATUS
+Ext4AllocateBlocks (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_BLOCK_NR     Goal,
+  IN     UINT32            Count,
+  OUT    EXT4_BLOCK_NR     *Start,
+  OUT    UINT32            *Allocated
+  )
+{
+  EXT4_PARTITION               *Partition;
+  CONST EXT4_BLOCK_GROUP_DESC  *Peek;
+  EXT4_BLOCK_GROUP_DESC        *Desc;
+  UINT8                        *Bitmap;
+  EFI_STATUS                   Status;
+  EXT4_BLOCK_NR                First;
+  UINT32                       GoalGroup;
+  UINT32                       Group;
+  UINT32                       Index;
+  UINT32                       RunStart;
+  UINT32                       Length;
+  UINT32                       FreeBlocks;
+
+  Partition = Txn->Partition;
+
+  if (Count == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if ((Goal < Partition->SuperBlock.s_first_data_block) || (Goal >= Partition->NumberBlocks)) {
+    Goal = Partition->SuperBlock.s_first_data_block;
+  }
+
+  GoalGroup = (UINT32)DivU64x32 (Goal - Partition->SuperBlock.s_first_data_block, Partition->SuperBlock.s_blocks_per_group);
+
+  for (Index = 0; Index < Partition->NumberBlockGroups; Index++) {
+    Group = (UINT32)((GoalGroup + Index) % Partition->NumberBlockGroups);
+    Peek  = Ext4PeekBlockGroupDesc (Txn, Group);
+
+    if (EXT4_DESC_FIELD (Partition, Peek->bg_free_blocks_count_lo, Peek->bg_free_blocks_count_hi) == 0) {
+      continue;
+    }
+
+    Status = Ext4TxnGetBlockBitmap (Txn, Group, &Desc, &Bitmap);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    First  = Ext4GroupFirstBlock (Partition, Group);
+    Length = Ext4FindFreeRun (
+               Txn,
+               Bitmap,
+               First,
+               Ext4GroupNumberBlocks (Partition, Group),
+               Group == GoalGroup ? (UINT32)(Goal - First) : 0,
+               Count,
+               &RunStart
+               );
+
+    // The group's free blocks may all have been freed by this transaction
+    if (Length == 0) {
+      continue;
+    }
+
+    FreeBlocks = EXT4_DESC_FIELD (Partition, Desc->bg_free_blocks_count_lo, Desc->bg_free_blocks_count_hi);
+
+    if (FreeBlocks < Length) {
+      DEBUG ((DEBUG_ERROR, "[ext4] Block group %u has more free blocks than it accounts for\n", Group));
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    Ext4BitmapSetRange (Bitmap, RunStart, Length, TRUE);
+    Ext4SetDescField (Partition, &Desc->bg_free_blocks_count_lo, &Desc->bg_free_blocks_count_hi, FreeBlocks - Length);
+    Ext4UpdateBitmapChecksums (Partition, Desc, Bitmap, NULL);
+    Ext4UpdateBlockGroupDescChecksum (Partition, Desc, Group);
+
+    Txn->FreeBlocksDelta -= Length;
+    *Start                = First + RunStart;
+    *Allocated            = Length;
+    return EFI_SUCCESS;
+  }
+
+  return EFI_VOLUME_FULL;
+}
+
+/**
+   Records a run of blocks freed by a transaction, which can't be allocated
+   again until the transaction commits.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      Start         First block.
+   @param[in]      Count         Number of blocks.
+
+   @retval EFI_SUCCESS           The run was recorded.
+   @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
+**/
+STATIC
+EFI_STATUS
+Ext4TxnRecordFreed (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_BLOCK_NR     Start,
+  IN     UINT64            Count
+  )
+{
+  EXT4_BLOCK_RANGE  *Freed;
+  UINTN             MaxFreed;
+
+  if (Txn->NumberFreed == Txn->MaxFreed) {
+    MaxFreed = Txn->MaxFreed == 0 ? 8 : Txn->MaxFreed * 2;
+    Freed    = ReallocatePool (
+                 Txn->MaxFreed * sizeof (EXT4_BLOCK_RANGE),
+                 MaxFreed * sizeof (EXT4_BLOCK_RANGE),
+                 Txn->Freed
+                 );
+
+    if (Freed == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    Txn->Freed    = Freed;
+    Txn->MaxFreed = MaxFreed;
+  }
+
+  Txn->Freed[Txn->NumberFreed].Start = Start;
+  Txn->Freed[Txn->NumberFreed].Count = Count;
+  Txn->NumberFreed++;
+  return EFI_SUCCESS;
+}
+
+/**
+   Frees a run of blocks.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      Start         First block.
+   @param[in]      Count         Number of blocks.
+
+   @retval EFI_SUCCESS           The blocks were freed.
+   @retval EFI_VOLUME_CORRUPTED  Some of the blocks are not in use.
+   @retval !EFI_SUCCESS          Failure.
+**/
+EFI_STATUS
+Ext4FreeBlocks (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_BLOCK_NR     Start,
+  IN     UINT64            Count
+  )
+{
+  EXT4_PARTITION         *Partition;
+  EXT4_BLOCK_GROUP_DESC  *Desc;
+  UINT8                  *Bitmap;
+  EFI_STATUS             Status;
+  EXT4_BLOCK_NR          Block;
+  UINT64                 Remaining;
+  UINT32                 Group;
+  UINT32                 Bit;
+  UINT32                 Run;
+  UINT32                 Index;
+
+  Partition = Txn->Partition;
+
+  if (  (Count == 0) || (Start < Partition->SuperBlock.s_first_data_block)
+     || (Start >= Partition->NumberBlocks) || (Count > Partition->NumberBlocks - Start))
+  {
+    DEBUG ((DEBUG_ERROR, "[ext4] Freeing invalid block range %lu+%lu\n", Start, Count));
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Block     = Start;
+  Remaining = Count;
+
+  while (Remaining != 0) {
+    Group = (UINT32)DivU64x32 (Block - Partition->SuperBlock.s_first_data_block, Partition->SuperBlock.s_blocks_per_group);
+    Bit   = (UINT32)(Block - Ext4GroupFirstBlock (Partition, Group));
+    Run   = (UINT32)MIN (Remaining, Ext4GroupNumberBlocks (Partition, Group) - Bit);
+
+    Status = Ext4TxnGetBlockBitmap (Txn, Group, &Desc, &Bitmap);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    for (Index = Bit; Index < Bit + Run; Index++) {
+      if (!EXT4_BITMAP_TEST (Bitmap, Index)) {
+        DEBUG ((DEBUG_ERROR, "[ext4] Freeing free block %lu\n", Block + Index - Bit));
+        return EFI_VOLUME_CORRUPTED;
+      }
+    }
+
+    Ext4BitmapSetRange (Bitmap, Bit, Run, FALSE);
+    Ext4SetDescField (
+      Partition,
+      &Desc->bg_free_blocks_count_lo,
+      &Desc->bg_free_blocks_count_hi,
+      EXT4_DESC_FIELD (Partition, Desc->bg_free_blocks_count_lo, Desc->bg_free_blocks_count_hi) + Run
+      );
+    Ext4UpdateBitmapChecksums (Partition, Desc, Bitmap, NULL);
+    Ext4UpdateBlockGroupDescChecksum (Partition, Desc, Group);
+
+    Block     += Run;
+    Remaining -= Run;
+  }
+
+  Status = Ext4TxnRecordFreed (Txn, Start, Count);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // Freed metadata blocks must not be written back by the transaction
+  Ext4TxnForgetBlocks (Txn, Start, Count);
+
+  Txn->FreeBlocksDelta += Count;
+  return EFI_SUCCESS;
+}
+
+/**
+   Picks the block that allocations for an inode without blocks start from.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      InodeNum      Inode number.
+
+   @return The first block of the inode's block group.
+**/
+EXT4_BLOCK_NR
+Ext4InodeGoalBlock (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_INO_NR     InodeNum
+  )
+{
+  return Ext4GroupFirstBlock (Partition, (UINT32)((InodeNum - 1) / Partition->SuperBlock.s_inodes_per_group));
+}
+
+/**
+   Retrieves the first inode number that isn't reserved.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+
+   @return The inode number.
+**/
+STATIC
+EXT4_INO_NR
+Ext4FirstInodeNr (
+  IN EXT4_PARTITION  *Partition
+  )
+{
+  if (Partition->SuperBlock.s_rev_level >= EXT4_DYNAMIC_REV) {
+    return Partition->SuperBlock.s_first_ino;
+  }
+
+  return EXT4_GOOD_OLD_FIRST_INODE_NR;
+}
+
+/**
+   Picks the block group where a new directory's inode goes: one with at least
+   an average number of free inodes and the most free blocks, which spreads
+   directories across the filesystem.
+
+   @param[in]      Txn           Pointer to the transaction.
+   @param[in]      ParentGroup   Block group of the parent directory.
+
+   @return The block group number.
+**/
+STATIC
+UINT32
+Ext4PickDirectoryGroup (
+  IN EXT4_TRANSACTION  *Txn,
+  IN UINT32            ParentGroup
+  )
+{
+  EXT4_PARTITION               *Partition;
+  CONST EXT4_BLOCK_GROUP_DESC  *Desc;
+  UINT32                       AverageFreeInodes;
+  UINT32                       FreeInodes;
+  UINT32                       FreeBlocks;
+  UINT32                       BestFreeBlocks;
+  UINT32                       BestGroup;
+  UINT32                       Group;
+
+  Partition         = Txn->Partition;
+  AverageFreeInodes = (UINT32)DivU64x32 (Partition->SuperBlock.s_free_inodes_count, Partition->NumberBlockGroups);
+  BestGroup         = ParentGroup;
+  BestFreeBlocks    = 0;
+
+  for (Group = 0; Group < Partition->NumberBlockGroups; Group++) {
+    Desc       = Ext4PeekBlockGroupDesc (Txn, Group);
+    FreeInodes = EXT4_DESC_FIELD (Partition, Desc->bg_free_inodes_count_lo, Desc->bg_free_inodes_count_hi);
+    FreeBlocks = EXT4_DESC_FIELD (Partition, Desc->bg_free_blocks_count_lo, Desc->bg_free_blocks_count_hi);
+
+    if ((FreeInodes != 0) && (FreeInodes >= AverageFreeInodes) && (FreeBlocks > BestFreeBlocks)) {
+      BestGroup      = Group;
+      BestFreeBlocks = FreeBlocks;
+    }
+  }
+
+  return BestGroup;
+}
+
+/**
+   Allocates an inode number.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      Parent        Inode number of the parent directory.
+   @param[in]      IsDir         TRUE if the inode is for a directory.
+   @param[out]     InodeNum      Allocated inode number.
+
+   @retval EFI_SUCCESS           The inode number was allocated.
+   @retval EFI_VOLUME_FULL       No inode is free.
+   @retval !EFI_SUCCESS          Failure.
+**/
+EFI_STATUS
+Ext4AllocateInodeNr (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_INO_NR       Parent,
+  IN     BOOLEAN           IsDir,
+  OUT    EXT4_INO_NR       *InodeNum
+  )
+{
+  EXT4_PARTITION               *Partition;
+  CONST EXT4_BLOCK_GROUP_DESC  *Peek;
+  EXT4_BLOCK_GROUP_DESC        *Desc;
+  UINT8                        *Bitmap;
+  UINT8                        *BlockBitmap;
+  EFI_STATUS                   Status;
+  UINT32                       InodesPerGroup;
+  UINT32                       StartGroup;
+  UINT32                       Group;
+  UINT32                       Index;
+  UINT32                       Bit;
+  UINT32                       Unused;
+
+  Partition      = Txn->Partition;
+  InodesPerGroup = Partition->SuperBlock.s_inodes_per_group;
+  StartGroup     = (UINT32)((Parent - 1) / InodesPerGroup);
+
+  if (IsDir) {
+    StartGroup = Ext4PickDirectoryGroup (Txn, StartGroup);
+  }
+
+  for (Index = 0; Index < Partition->NumberBlockGroups; Index++) {
+    Group = (UINT32)((StartGroup + Index) % Partition->NumberBlockGroups);
+    Peek  = Ext4PeekBlockGroupDesc (Txn, Group);
+
+    if (EXT4_DESC_FIELD (Partition, Peek->bg_free_inodes_count_lo, Peek->bg_free_inodes_count_hi) == 0) {
+      continue;
+    }
+
+    Status = Ext4TxnGetInodeBitmap (Txn, Group, &Desc, &Bitmap);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    // Like Linux, initialize the block bitmap of groups whose inodes get used
+    if ((Desc->bg_flags & EXT4_BG_BLOCK_UNINIT) != 0) {
+      Status = Ext4TxnGetBlockBitmap (Txn, Group, &Desc, &BlockBitmap);
+
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+    }
+
+    Bit = 0;
+
+    if (Group == 0) {
+      Bit = (UINT32)(Ext4FirstInodeNr (Partition) - 1);
+    }
+
+    while (Bit < InodesPerGroup && EXT4_BITMAP_TEST (Bitmap, Bit)) {
+      Bit++;
+    }
+
+    if (Bit == InodesPerGroup) {
+      DEBUG ((DEBUG_WARN, "[ext4] Block group %u has no free inode despite its free inode count\n", Group));
+      continue;
+    }
+
+    Ext4BitmapSetRange (Bitmap, Bit, 1, TRUE);
+    Ext4SetDescField (
+      Partition,
+      &Desc->bg_free_inodes_count_lo,
+      &Desc->bg_free_inodes_count_hi,
+      EXT4_DESC_FIELD (Partition, Desc->bg_free_inodes_count_lo, Desc->bg_free_inodes_count_hi) - 1
+      );
+
+    if (IsDir) {
+      Ext4SetDescField (
+        Partition,
+        &Desc->bg_used_dirs_count_lo,
+        &Desc->bg_used_dirs_count_hi,
+        EXT4_DESC_FIELD (Partition, Desc->bg_used_dirs_count_lo, Desc->bg_used_dirs_count_hi) + 1
+        );
+    }
+
+    // The inode table past the last used inode may have never been initialized
+    if (EXT4_HAS_METADATA_CSUM (Partition) || EXT4_HAS_GDT_CSUM (Partition)) {
+      Unused = EXT4_DESC_FIELD (Partition, Desc->bg_itable_unused_lo, Desc->bg_itable_unused_hi);
+
+      if (Bit >= InodesPerGroup - Unused) {
+        Ext4SetDescField (Partition, &Desc->bg_itable_unused_lo, &Desc->bg_itable_unused_hi, InodesPerGroup - Bit - 1);
+      }
+    }
+
+    Ext4UpdateBitmapChecksums (Partition, Desc, NULL, Bitmap);
+    Ext4UpdateBlockGroupDescChecksum (Partition, Desc, Group);
+
+    Txn->FreeInodesDelta--;
+    *InodeNum = (EXT4_INO_NR)Group * InodesPerGroup + Bit + 1;
+    return EFI_SUCCESS;
+  }
+
+  return EFI_VOLUME_FULL;
+}
+
+/**
+   Frees an inode number.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      InodeNum      Inode number.
+   @param[in]      IsDir         TRUE if the inode was a directory.
+
+   @retval EFI_SUCCESS           The inode number was freed.
+   @retval EFI_VOLUME_CORRUPTED  The inode is not in use.
+   @retval !EFI_SUCCESS          Failure.
+**/
+EFI_STATUS
+Ext4FreeInodeNr (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_INO_NR       InodeNum,
+  IN     BOOLEAN           IsDir
+  )
+{
+  EXT4_PARTITION         *Partition;
+  EXT4_BLOCK_GROUP_DESC  *Desc;
+  UINT8                  *Bitmap;
+  EFI_STATUS             Status;
+  UINT32                 Group;
+  UINT32                 Bit;
+
+  Partition = Txn->Partition;
+
+  if ((InodeNum < Ext4FirstInodeNr (Partition)) || (InodeNum > Partition->SuperBlock.s_inodes_count)) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Freeing invalid inode %u\n", InodeNum));
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Group = (UINT32)((InodeNum - 1) / Partition->SuperBlock.s_inodes_per_group);
+  Bit   = (UINT32)((InodeNum - 1) % Partition->SuperBlock.s_inodes_per_group);
+
+  Status = Ext4TxnGetInodeBitmap (Txn, Group, &Desc, &Bitmap);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (!EXT4_BITMAP_TEST (Bitmap, Bit)) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Freeing free inode %u\n", InodeNum));
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Ext4BitmapSetRange (Bitmap, Bit, 1, FALSE);
+  Ext4SetDescField (
+    Partition,
+    &Desc->bg_free_inodes_count_lo,
+    &Desc->bg_free_inodes_count_hi,
+    EXT4_DESC_FIELD (Partition, Desc->bg_free_inodes_count_lo, Desc->bg_free_inodes_count_hi) + 1
+    );
+
+  if (IsDir) {
+    Ext4SetDescField (
+      Partition,
+      &Desc->bg_used_dirs_count_lo,
+      &Desc->bg_used_dirs_count_hi,
+      EXT4_DESC_FIELD (Partition, Desc->bg_used_dirs_count_lo, Desc->bg_used_dirs_count_hi) - 1
+      );
+  }
+
+  Ext4UpdateBitmapChecksums (Partition, Desc, NULL, Bitmap);
+  Ext4UpdateBlockGroupDescChecksum (Partition, Desc, Group);
+
+  Txn->FreeInodesDelta++;
+  return EFI_SUCCESS;
+}
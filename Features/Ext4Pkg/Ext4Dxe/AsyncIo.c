@@ -0,0 +1,585 @@
+/** @file
+  Revision 2 (asynchronous) EFI_FILE_PROTOCOL functions
+
+  Copyright (c) 2024 Pedro Falcato All rights reserved.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  ReadEx() maps the whole request up front, zeroes its holes and queues a
+  DISK_IO2 read for each run of the file that's contiguous on the disk, so a
+  fragmented file has all of its extents in flight at once. The token is
+  signaled when the last of them completes. Disks without DISK_IO2, directories
+  and inline files are read synchronously, and so are opens and writes, which
+  go through the block cache and the journal.
+**/
+
+#include "Ext4Dxe.h"
+
+/**
+   A ReadEx() or FlushEx() request, which completes when all of its disk
+   requests have.
+**/
+typedef struct {
+  EFI_FILE_IO_TOKEN    *Token;
+  // Disk requests in flight, plus one while requests are being queued
+  UINTN                Pending;
+  // Status of the first disk request that failed
+  EFI_STATUS           Status;
+} EXT4_ASYNC_REQUEST;
+
+/**
+   A disk request of an EXT4_ASYNC_REQUEST.
+**/
+typedef struct {
+  EFI_DISK_IO2_TOKEN    DiskToken;
+  EXT4_ASYNC_REQUEST    *Request;
+} EXT4_ASYNC_DISK_REQUEST;
+
+/**
+   Completes a request of a revision 2 function synchronously.
+
+   @param[in out]  Token       A pointer to the token of the request.
+   @param[in]      Status      Status of the request.
+
+   @return Status to return to the caller.
+**/
+STATIC
+EFI_STATUS
+Ext4CompleteToken (
+  IN OUT EFI_FILE_IO_TOKEN  *Token,
+  IN     EFI_STATUS         Status
+  )
+{
+  Token->Status = Status;
+
+  // Failed non-blocking requests are only reported by the return value
+  if ((Token->Event != NULL) && !EFI_ERROR (Status)) {
+    gBS->SignalEvent (Token->Event);
+  }
+
+  return Status;
+}
+
+/**
+   Drops a reference to a request, and completes it once it has no disk
+   requests left.
+
+   Must be called at TPL_NOTIFY.
+
+   @param[in]      Request     Pointer to the request.
+**/
+STATIC
+VOID
+Ext4PutAsyncRequest (
+  IN EXT4_ASYNC_REQUEST  *Request
+  )
+{
+  ASSERT (Request->Pending != 0);
+
+  if (--Request->Pending != 0) {
+    return;
+  }
+
+  Request->Token->Status = Request->Status;
+
+  if (EFI_ERROR (Request->Status)) {
+    Request->Token->BufferSize = 0;
+  }
+
+  gBS->SignalEvent (Request->Token->Event);
+  FreePool (Request);
+}
+
+/**
+   Adds a reference to a request, for a disk request that's being queued.
+
+   Disk requests complete at TPL_NOTIFY, so the count is only changed there.
+
+   @param[in]      Request     Pointer to the request.
+**/
+STATIC
+VOID
+Ext4GetAsyncRequest (
+  IN EXT4_ASYNC_REQUEST  *Request
+  )
+{
+  EFI_TPL  OldTpl;
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  Request->Pending++;
+  gBS->RestoreTPL (OldTpl);
+}
+
+/**
+   Drops the reference of a disk request that failed to be queued, and frees it.
+
+   @param[in]      DiskRequest Pointer to the disk request.
+**/
+STATIC
+VOID
+Ext4DropDiskRequest (
+  IN EXT4_ASYNC_DISK_REQUEST  *DiskRequest
+  )
+{
+  EFI_TPL  OldTpl;
+
+  // Its event won't be signaled, and the queueing reference keeps the request alive
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  DiskRequest->Request->Pending--;
+  gBS->RestoreTPL (OldTpl);
+
+  gBS->CloseEvent (DiskRequest->DiskToken.Event);
+  FreePool (DiskRequest);
+}
+
+/**
+   Completes a disk request of an EXT4_ASYNC_REQUEST.
+
+   @param[in]      Event       Event of the disk request.
+   @param[in]      Context     Pointer to the EXT4_ASYNC_DISK_REQUEST.
+**/
+STATIC
+VOID
+EFIAPI
+Ext4OnDiskRequestDone (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  EXT4_ASYNC_DISK_REQUEST  *DiskRequest;
+  EXT4_ASYNC_REQUEST       *Request;
+
+  DiskRequest = Context;
+  Request     = DiskRequest->Request;
+
+  if (EFI_ERROR (DiskRequest->DiskToken.TransactionStatus) && !EFI_ERROR (Request->Status)) {
+    Request->Status = DiskRequest->DiskToken.TransactionStatus;
+  }
+
+  gBS->CloseEvent (Event);
+  FreePool (DiskRequest);
+
+  Ext4PutAsyncRequest (Request);
+}
+
+/**
+   Allocates a request for a token, which is completed once every disk
+   request that's queued for it completes.
+
+   @param[in]      Token       A pointer to the token of the request.
+
+   @return Pointer to the request, or NULL if out of memory.
+**/
+STATIC
+EXT4_ASYNC_REQUEST *
+Ext4AllocateAsyncRequest (
+  IN EFI_FILE_IO_TOKEN  *Token
+  )
+{
+  EXT4_ASYNC_REQUEST  *Request;
+
+  Request = AllocatePool (sizeof (*Request));
+
+  if (Request == NULL) {
+    return NULL;
+  }
+
+  Request->Token   = Token;
+  Request->Pending = 1;
+  Request->Status  = EFI_SUCCESS;
+  return Request;
+}
+
+/**
+   Allocates a disk request of a request, and the event that completes it.
+
+   @param[in]      Request     Pointer to the request.
+   @param[out]     DiskRequest Pointer to the disk request.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4AllocateDiskRequest (
+  IN  EXT4_ASYNC_REQUEST       *Request,
+  OUT EXT4_ASYNC_DISK_REQUEST  **DiskRequest
+  )
+{
+  EFI_STATUS  Status;
+
+  *DiskRequest = AllocateZeroPool (sizeof (EXT4_ASYNC_DISK_REQUEST));
+
+  if (*DiskRequest == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  (*DiskRequest)->Request = Request;
+
+  Status = gBS->CreateEvent (
+                  EVT_NOTIFY_SIGNAL,
+                  TPL_NOTIFY,
+                  Ext4OnDiskRequestDone,
+                  *DiskRequest,
+                  &(*DiskRequest)->DiskToken.Event
+                  );
+
+  if (EFI_ERROR (Status)) {
+    FreePool (*DiskRequest);
+  }
+
+  return Status;
+}
+
+/**
+   Stops queueing disk requests for a request, and completes it if they're
+   all done.
+
+   @param[in]      Request     Pointer to the request.
+   @param[in]      Status      Status of the queueing.
+
+   @retval EFI_SUCCESS         The token will be signaled.
+   @retval !EFI_SUCCESS        No disk request was queued, and the token won't be signaled.
+**/
+STATIC
+EFI_STATUS
+Ext4FinishQueueing (
+  IN EXT4_ASYNC_REQUEST  *Request,
+  IN EFI_STATUS          Status
+  )
+{
+  EFI_TPL  OldTpl;
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  if (EFI_ERROR (Status)) {
+    if (Request->Pending == 1) {
+      // Nothing is in flight, so fail the call instead of the token
+      gBS->RestoreTPL (OldTpl);
+      FreePool (Request);
+      return Status;
+    }
+
+    if (!EFI_ERROR (Request->Status)) {
+      Request->Status = Status;
+    }
+  }
+
+  Ext4PutAsyncRequest (Request);
+  gBS->RestoreTPL (OldTpl);
+  return EFI_SUCCESS;
+}
+
+/**
+   A run of a file that's either contiguous on the disk, or to be read as zeros.
+**/
+typedef struct {
+  UINT64     DiskOffset;
+  UINTN      BufferOffset;
+  UINTN      Length;
+  BOOLEAN    IsHole;
+} EXT4_READ_RUN;
+
+/**
+   Maps a read to the runs of the file it covers.
+
+   @param[in]      Partition   Pointer to the opened partition.
+   @param[in]      File        Pointer to the opened file.
+   @param[in]      Offset      Offset of the read.
+   @param[in]      Length      Length of the read.
+   @param[out]     Runs        Pointer to the runs, to be freed by the caller.
+   @param[out]     NumberRuns  Number of runs.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4MapRead (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *File,
+  IN  UINT64          Offset,
+  IN  UINTN           Length,
+  OUT EXT4_READ_RUN   **Runs,
+  OUT UINTN           *NumberRuns
+  )
+{
+  EXT4_READ_RUN  *NewRuns;
+  EFI_STATUS     Status;
+  UINTN          Capacity;
+  UINTN          Done;
+  UINT64         RunLength;
+
+  *Runs       = NULL;
+  *NumberRuns = 0;
+  Capacity    = 0;
+
+  for (Done = 0; Done < Length; Done += (*Runs)[*NumberRuns - 1].Length) {
+    if (*NumberRuns == Capacity) {
+      NewRuns = ReallocatePool (
+                  Capacity * sizeof (EXT4_READ_RUN),
+                  MAX (Capacity * 2, 8) * sizeof (EXT4_READ_RUN),
+                  *Runs
+                  );
+
+      if (NewRuns == NULL) {
+        Status = EFI_OUT_OF_RESOURCES;
+        goto Error;
+      }
+
+      *Runs    = NewRuns;
+      Capacity = MAX (Capacity * 2, 8);
+    }
+
+    Status = Ext4GetReadRun (
+               Partition,
+               File,
+               Offset + Done,
+               Length - Done,
+               &(*Runs)[*NumberRuns].IsHole,
+               &(*Runs)[*NumberRuns].DiskOffset,
+               &RunLength
+               );
+
+    if (EFI_ERROR (Status)) {
+      goto Error;
+    }
+
+    (*Runs)[*NumberRuns].BufferOffset = Done;
+    (*Runs)[*NumberRuns].Length       = (UINTN)MIN (RunLength, Length - Done);
+    (*NumberRuns)++;
+  }
+
+  return EFI_SUCCESS;
+
+Error:
+  if (*Runs != NULL) {
+    FreePool (*Runs);
+  }
+
+  return Status;
+}
+
+/**
+  Opens a new file relative to the source directory's location.
+
+  @param[in]      This       A pointer to the EFI_FILE_PROTOCOL instance that is
+                             the file handle to the source location.
+  @param[out]     NewHandle  A pointer to the location to return the opened
+                             handle for the new file.
+  @param[in]      FileName   The Null-terminated string of the name of the file
+                             to be opened.
+  @param[in]      OpenMode   The mode to open the file.
+  @param[in]      Attributes Only valid for EFI_FILE_MODE_CREATE, in which case
+                             these are the attribute bits for the newly created file.
+  @param[in out]  Token      A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS          The request was queued, or completed if Token->Event is NULL.
+  @retval !EFI_SUCCESS         The request failed, see Ext4Open().
+
+**/
+EFI_STATUS
+EFIAPI
+Ext4OpenEx (
+  IN EFI_FILE_PROTOCOL      *This,
+  OUT EFI_FILE_PROTOCOL     **NewHandle,
+  IN CHAR16                 *FileName,
+  IN UINT64                 OpenMode,
+  IN UINT64                 Attributes,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  )
+{
+  return Ext4CompleteToken (Token, Ext4Open (This, NewHandle, FileName, OpenMode, Attributes));
+}
+
+/**
+  Reads data from a file, asynchronously if the disk supports DISK_IO2.
+
+  @param[in]      This       A pointer to the EFI_FILE_PROTOCOL instance that is
+                             the file handle to read data from.
+  @param[in out]  Token      A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS          The request was queued, or completed if Token->Event is NULL.
+  @retval !EFI_SUCCESS         The request failed, see Ext4ReadFile().
+
+**/
+EFI_STATUS
+EFIAPI
+Ext4ReadEx (
+  IN EFI_FILE_PROTOCOL      *This,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  )
+{
+  EXT4_FILE                *File;
+  EXT4_PARTITION           *Partition;
+  EXT4_ASYNC_REQUEST       *Request;
+  EXT4_ASYNC_DISK_REQUEST  *DiskRequest;
+  EXT4_READ_RUN            *Runs;
+  EFI_STATUS               Status;
+  UINT64                   InodeSize;
+  UINTN                    NumberRuns;
+  UINTN                    Index;
+  UINTN                    Length;
+
+  File      = EXT4_FILE_FROM_THIS (This);
+  Partition = File->Partition;
+
+  if (  (Token->Event == NULL) || (EXT4_DISK_IO2 (Partition) == NULL)
+     || !Ext4FileIsReg (File) || EXT4_HAS_INLINE_DATA (File->Inode))
+  {
+    return Ext4CompleteToken (Token, Ext4ReadFile (This, &Token->BufferSize, Token->Buffer));
+  }
+
+  InodeSize = EXT4_INODE_SIZE (File->Inode);
+
+  if (File->Position > InodeSize) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  Length = (UINTN)MIN (Token->BufferSize, InodeSize - File->Position);
+
+  DEBUG ((DEBUG_FS, "[ext4] Ext4ReadEx(%s, Offset %lu, Length %lu)\n", File->Dentry->Name, File->Position, Length));
+
+  // The file is mapped before anything is queued, so that lookup errors fail the call
+  Status = Ext4MapRead (Partition, File, File->Position, Length, &Runs, &NumberRuns);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Request = Ext4AllocateAsyncRequest (Token);
+
+  if (Request == NULL) {
+    if (Runs != NULL) {
+      FreePool (Runs);
+    }
+
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Token->BufferSize = Length;
+
+  for (Index = 0; Index < NumberRuns; Index++) {
+    if (Runs[Index].IsHole) {
+      ZeroMem ((UINT8 *)Token->Buffer + Runs[Index].BufferOffset, Runs[Index].Length);
+      continue;
+    }
+
+    Status = Ext4AllocateDiskRequest (Request, &DiskRequest);
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    Ext4GetAsyncRequest (Request);
+
+    Status = EXT4_DISK_IO2 (Partition)->ReadDiskEx (
+                                          EXT4_DISK_IO2 (Partition),
+                                          EXT4_MEDIA_ID (Partition),
+                                          Runs[Index].DiskOffset,
+                                          &DiskRequest->DiskToken,
+                                          Runs[Index].Length,
+                                          (UINT8 *)Token->Buffer + Runs[Index].BufferOffset
+                                          );
+
+    if (EFI_ERROR (Status)) {
+      Ext4DropDiskRequest (DiskRequest);
+      DEBUG ((DEBUG_ERROR, "[ext4] Error %r queueing a read at %lu\n", Status, Runs[Index].DiskOffset));
+      break;
+    }
+  }
+
+  if (Runs != NULL) {
+    FreePool (Runs);
+  }
+
+  // The token's event may run before this returns, and see the new position
+  File->Position += Length;
+
+  Status = Ext4FinishQueueing (Request, Status);
+
+  if (EFI_ERROR (Status)) {
+    File->Position -= Length;
+  }
+
+  return Status;
+}
+
+/**
+  Writes data to a file.
+
+  @param[in]      This       A pointer to the EFI_FILE_PROTOCOL instance that is
+                             the file handle to write data to.
+  @param[in out]  Token      A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS          The request was queued, or completed if Token->Event is NULL.
+  @retval !EFI_SUCCESS         The request failed, see Ext4WriteFile().
+
+**/
+EFI_STATUS
+EFIAPI
+Ext4WriteEx (
+  IN EFI_FILE_PROTOCOL      *This,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  )
+{
+  return Ext4CompleteToken (Token, Ext4WriteFile (This, &Token->BufferSize, Token->Buffer));
+}
+
+/**
+  Flushes all modified data associated with a file to a device, asynchronously
+  if the disk supports DISK_IO2.
+
+  @param[in]      This       A pointer to the EFI_FILE_PROTOCOL instance that is
+                             the file handle to flush.
+  @param[in out]  Token      A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS          The request was queued, or completed if Token->Event is NULL.
+  @retval !EFI_SUCCESS         The request failed, see Ext4Flush().
+
+**/
+EFI_STATUS
+EFIAPI
+Ext4FlushEx (
+  IN EFI_FILE_PROTOCOL      *This,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  )
+{
+  EXT4_FILE                *File;
+  EXT4_PARTITION           *Partition;
+  EXT4_ASYNC_REQUEST       *Request;
+  EXT4_ASYNC_DISK_REQUEST  *DiskRequest;
+  EFI_STATUS               Status;
+
+  File      = EXT4_FILE_FROM_THIS (This);
+  Partition = File->Partition;
+
+  if ((Token->Event == NULL) || (EXT4_DISK_IO2 (Partition) == NULL)) {
+    return Ext4CompleteToken (Token, Ext4Flush (This));
+  }
+
+  if (Partition->ReadOnly) {
+    return EFI_WRITE_PROTECTED;
+  }
+
+  if (!(File->OpenMode & EFI_FILE_MODE_WRITE)) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  Request = Ext4AllocateAsyncRequest (Token);
+
+  if (Request == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = Ext4AllocateDiskRequest (Request, &DiskRequest);
+
+  if (!EFI_ERROR (Status)) {
+    Ext4GetAsyncRequest (Request);
+
+    Status = EXT4_DISK_IO2 (Partition)->FlushDiskEx (EXT4_DISK_IO2 (Partition), &DiskRequest->DiskToken);
+
+    if (EFI_ERROR (Status)) {
+      Ext4DropDiskRequest (DiskRequest);
+    }
+  }
+
+  return Ext4FinishQueueing (Request, Status);
+}
@@ -0,0 +1,638 @@
+/** @file
+  Partition block cache
+
+  Copyright (c) 2024 Pedro Falcato All rights reserved.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  Blocks read through the cache are kept in a hash table indexed by block number,
+  and on one LRU list per EXT4_BLOCK_CACHE_CLASS. Once a class reaches its budget,
+  its least recently used block is recycled for the next one that is read.
+  Every write of the driver goes through Ext4WriteDiskIoCached(), which updates
+  the cached copies of the blocks it writes, so cached blocks only become stale
+  when the media changes, which is detected through the media ID.
+**/
+
+#include "Ext4Dxe.h"
+
+typedef struct {
+  LIST_ENTRY                HashNode;
+  LIST_ENTRY                LruNode;
+  EXT4_BLOCK_NR             Block;
+  EXT4_BLOCK_CACHE_CLASS    Class;
+  // Followed by Partition->BlockSize bytes of block contents
+} EXT4_CACHED_BLOCK;
+
+#define EXT4_CACHED_BLOCK_DATA(Entry)  ((UINT8 *)((EXT4_CACHED_BLOCK *)(Entry) + 1))
+
+#define EXT4_CACHED_BLOCK_FROM_HASH_NODE(Node)  BASE_CR (Node, EXT4_CACHED_BLOCK, HashNode)
+#define EXT4_CACHED_BLOCK_FROM_LRU_NODE(Node)   BASE_CR (Node, EXT4_CACHED_BLOCK, LruNode)
+
+/**
+   Retrieves the hash bucket of a block.
+
+   @param[in]  Cache          Pointer to the block cache.
+   @param[in]  Block          Block number.
+
+   @return Pointer to the head of the bucket's list.
+**/
+STATIC
+LIST_ENTRY *
+Ext4BlockCacheBucket (
+  IN CONST EXT4_BLOCK_CACHE  *Cache,
+  IN EXT4_BLOCK_NR           Block
+  )
+{
+  return &Cache->Buckets[((UINTN)Block ^ (UINTN)RShiftU64 (Block, 32)) & Cache->BucketMask];
+}
+
+/**
+   Looks a block up in the cache.
+
+   @param[in]  Cache          Pointer to the block cache.
+   @param[in]  Block          Block number.
+
+   @return Pointer to the cached block, or NULL if it's not cached.
+**/
+STATIC
+EXT4_CACHED_BLOCK *
+Ext4BlockCacheLookup (
+  IN CONST EXT4_BLOCK_CACHE  *Cache,
+  IN EXT4_BLOCK_NR           Block
+  )
+{
+  LIST_ENTRY         *Bucket;
+  LIST_ENTRY         *Node;
+  EXT4_CACHED_BLOCK  *Entry;
+
+  Bucket = Ext4BlockCacheBucket (Cache, Block);
+
+  BASE_LIST_FOR_EACH (Node, Bucket) {
+    Entry = EXT4_CACHED_BLOCK_FROM_HASH_NODE (Node);
+
+    if (Entry->Block == Block) {
+      return Entry;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+   Gets an unused cache entry for a block of the given class.
+   If the class is at its budget, its least recently used block is evicted
+   and its entry is returned, else a new entry is allocated.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Class          Class of the block that will be cached.
+
+   @return Pointer to the entry, or NULL if it could not be allocated.
+**/
+STATIC
+EXT4_CACHED_BLOCK *
+Ext4BlockCacheGetEntry (
+  IN EXT4_PARTITION          *Partition,
+  IN EXT4_BLOCK_CACHE_CLASS  Class
+  )
+{
+  EXT4_BLOCK_CACHE_LRU  *Lru;
+  EXT4_CACHED_BLOCK     *Entry;
+
+  Lru = &Partition->BlockCache.Classes[Class];
+
+  if (Lru->Count < Lru->MaxCount) {
+    return AllocatePool (sizeof (EXT4_CACHED_BLOCK) + Partition->BlockSize);
+  }
+
+  Entry = EXT4_CACHED_BLOCK_FROM_LRU_NODE (GetPreviousNode (&Lru->Lru, &Lru->Lru));
+  RemoveEntryList (&Entry->HashNode);
+  RemoveEntryList (&Entry->LruNode);
+  Lru->Count--;
+
+  return Entry;
+}
+
+/**
+   Inserts an entry in the cache, as the most recently used block of its class.
+
+   @param[in]  Cache          Pointer to the block cache.
+   @param[in]  Entry          Entry returned by Ext4BlockCacheGetEntry().
+   @param[in]  Block          Block number.
+   @param[in]  Class          Class of the block.
+**/
+STATIC
+VOID
+Ext4BlockCacheInsert (
+  IN EXT4_BLOCK_CACHE        *Cache,
+  IN EXT4_CACHED_BLOCK       *Entry,
+  IN EXT4_BLOCK_NR           Block,
+  IN EXT4_BLOCK_CACHE_CLASS  Class
+  )
+{
+  Entry->Block = Block;
+  Entry->Class = Class;
+
+  InsertHeadList (Ext4BlockCacheBucket (Cache, Block), &Entry->HashNode);
+  InsertHeadList (&Cache->Classes[Class].Lru, &Entry->LruNode);
+  Cache->Classes[Class].Count++;
+}
+
+/**
+   Reads a run of uncached blocks from the disk and adds them to the cache.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Class          Class of the blocks.
+   @param[in]  Block          First block of the run.
+   @param[in]  NumberBlocks   Length of the run, in blocks.
+   @param[out] First          Pointer to the cache entry of the first block of the run.
+
+   @retval EFI_SUCCESS            At least the first block of the run was cached.
+   @retval EFI_OUT_OF_RESOURCES   There's no memory to cache the first block.
+   @return Other errors of the disk read.
+**/
+STATIC
+EFI_STATUS
+Ext4BlockCacheFill (
+  IN  EXT4_PARTITION          *Partition,
+  IN  EXT4_BLOCK_CACHE_CLASS  Class,
+  IN  EXT4_BLOCK_NR           Block,
+  IN  UINTN                   NumberBlocks,
+  OUT EXT4_CACHED_BLOCK       **First
+  )
+{
+  EXT4_CACHED_BLOCK  *Entry;
+  UINT8              *Buffer;
+  UINTN              Index;
+  EFI_STATUS         Status;
+
+  Buffer = NULL;
+
+  if (NumberBlocks > 1) {
+    Buffer = AllocatePool (NumberBlocks * Partition->BlockSize);
+
+    // Without a bounce buffer we can still cache the block that was asked for.
+    if (Buffer == NULL) {
+      NumberBlocks = 1;
+    }
+  }
+
+  Entry = Ext4BlockCacheGetEntry (Partition, Class);
+
+  if (Entry == NULL) {
+    if (Buffer != NULL) {
+      FreePool (Buffer);
+    }
+
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (Buffer == NULL) {
+    Status = Ext4ReadBlocks (Partition, EXT4_CACHED_BLOCK_DATA (Entry), 1, Block);
+  } else {
+    Status = Ext4ReadBlocks (Partition, Buffer, NumberBlocks, Block);
+  }
+
+  if (EFI_ERROR (Status)) {
+    FreePool (Entry);
+
+    if (Buffer != NULL) {
+      FreePool (Buffer);
+    }
+
+    return Status;
+  }
+
+  if (Buffer != NULL) {
+    CopyMem (EXT4_CACHED_BLOCK_DATA (Entry), Buffer, Partition->BlockSize);
+  }
+
+  Ext4BlockCacheInsert (&Partition->BlockCache, Entry, Block, Class);
+  *First = Entry;
+
+  // The rest of the run was read ahead. Caching it is best effort.
+  for (Index = 1; Index < NumberBlocks; Index++) {
+    Entry = Ext4BlockCacheGetEntry (Partition, Class);
+
+    if (Entry == NULL) {
+      break;
+    }
+
+    CopyMem (EXT4_CACHED_BLOCK_DATA (Entry), Buffer + Index * Partition->BlockSize, Partition->BlockSize);
+    Ext4BlockCacheInsert (&Partition->BlockCache, Entry, Block + Index, Class);
+  }
+
+  if (Buffer != NULL) {
+    FreePool (Buffer);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Initialises the block cache of the partition, sizing it after
+   PcdExt4MetadataCacheSize and PcdExt4DataCacheSize.
+   Partition->BlockSize must be valid.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @retval EFI_SUCCESS            The cache was initialised, or it is disabled.
+   @retval EFI_OUT_OF_RESOURCES   The hash table could not be allocated.
+**/
+EFI_STATUS
+Ext4InitBlockCache (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_BLOCK_CACHE  *Cache;
+  UINTN             Index;
+  UINTN             TotalCount;
+  UINTN             NumberBuckets;
+
+  Cache = &Partition->BlockCache;
+
+  Cache->Classes[Ext4BlockCacheMetadata].MaxCount = PcdGet32 (PcdExt4MetadataCacheSize) / Partition->BlockSize;
+  Cache->Classes[Ext4BlockCacheData].MaxCount     = PcdGet32 (PcdExt4DataCacheSize) / Partition->BlockSize;
+
+  TotalCount = 0;
+
+  for (Index = 0; Index < Ext4BlockCacheClassMax; Index++) {
+    InitializeListHead (&Cache->Classes[Index].Lru);
+    Cache->Classes[Index].Count  = 0;
+    Cache->Classes[Index].Hits   = 0;
+    Cache->Classes[Index].Misses = 0;
+    TotalCount                  += Cache->Classes[Index].MaxCount;
+  }
+
+  Cache->Buckets = NULL;
+
+  if (TotalCount == 0) {
+    return EFI_SUCCESS;
+  }
+
+  // Aim for a load factor of at most 1 when the cache is full
+  NumberBuckets = GetPowerOfTwo32 ((UINT32)TotalCount);
+  if (NumberBuckets < TotalCount) {
+    NumberBuckets <<= 1;
+  }
+
+  Cache->Buckets = AllocatePool (NumberBuckets * sizeof (LIST_ENTRY));
+
+  if (Cache->Buckets == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  for (Index = 0; Index < NumberBuckets; Index++) {
+    InitializeListHead (&Cache->Buckets[Index]);
+  }
+
+  Cache->BucketMask = NumberBuckets - 1;
+  Cache->MediaId    = EXT4_MEDIA_ID (Partition);
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Drops every block held by the partition's block cache.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+**/
+VOID
+Ext4InvalidateBlockCache (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_BLOCK_CACHE      *Cache;
+  EXT4_BLOCK_CACHE_LRU  *Lru;
+  EXT4_CACHED_BLOCK     *Entry;
+  UINTN                 Index;
+
+  Cache = &Partition->BlockCache;
+
+  if (Cache->Buckets == NULL) {
+    return;
+  }
+
+  for (Index = 0; Index < Ext4BlockCacheClassMax; Index++) {
+    Lru = &Cache->Classes[Index];
+
+    while (!IsListEmpty (&Lru->Lru)) {
+      Entry = EXT4_CACHED_BLOCK_FROM_LRU_NODE (GetFirstNode (&Lru->Lru));
+      RemoveEntryList (&Entry->HashNode);
+      RemoveEntryList (&Entry->LruNode);
+      FreePool (Entry);
+    }
+
+    Lru->Count = 0;
+  }
+}
+
+/**
+   Drops every block held by the partition's block cache and frees the cache.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+**/
+VOID
+Ext4FreeBlockCache (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_BLOCK_CACHE  *Cache;
+
+  Cache = &Partition->BlockCache;
+
+  if (Cache->Buckets == NULL) {
+    return;
+  }
+
+  DEBUG ((
+    DEBUG_FS,
+    "[ext4] Block cache: metadata %lu hits %lu misses, data %lu hits %lu misses\n",
+    Cache->Classes[Ext4BlockCacheMetadata].Hits,
+    Cache->Classes[Ext4BlockCacheMetadata].Misses,
+    Cache->Classes[Ext4BlockCacheData].Hits,
+    Cache->Classes[Ext4BlockCacheData].Misses
+    ));
+
+  Ext4InvalidateBlockCache (Partition);
+  FreePool (Cache->Buckets);
+  Cache->Buckets = NULL;
+}
+
+/**
+   Reads from the partition's disk through the block cache.
+   Blocks that are not cached are read from the disk, together with up to ReadAhead
+   bytes that follow the requested range, and are then added to the cache.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Class          Class of the blocks that are read.
+   @param[out] Buffer         Pointer to a destination buffer.
+   @param[in]  Length         Length of the destination buffer.
+   @param[in]  Offset         Offset, in bytes, of the location to read.
+   @param[in]  ReadAhead      Number of bytes past Offset + Length that may be
+                              read ahead and cached.
+
+   @return Success status of the read.
+**/
+EFI_STATUS
+Ext4ReadDiskIoCached (
+  IN EXT4_PARTITION          *Partition,
+  IN EXT4_BLOCK_CACHE_CLASS  Class,
+  OUT VOID                   *Buffer,
+  IN UINTN                   Length,
+  IN UINT64                  Offset,
+  IN UINTN                   ReadAhead
+  )
+{
+  EXT4_BLOCK_CACHE      *Cache;
+  EXT4_BLOCK_CACHE_LRU  *Lru;
+  EXT4_CACHED_BLOCK     *Entry;
+  EXT4_BLOCK_NR         Block;
+  EXT4_BLOCK_NR         LastBlock;
+  EXT4_BLOCK_NR         ReadAheadEnd;
+  UINT32                BlockOffset;
+  UINT32                BlockSize;
+  UINTN                 ToCopy;
+  UINTN                 RunLength;
+  UINTN                 MaxRunLength;
+  EFI_STATUS            Status;
+
+  Cache = &Partition->BlockCache;
+  Lru   = &Cache->Classes[Class];
+
+  if ((Cache->Buckets == NULL) || (Lru->MaxCount == 0)) {
+    return Ext4ReadDiskIo (Partition, Buffer, Length, Offset);
+  }
+
+  if (Length == 0) {
+    return EFI_SUCCESS;
+  }
+
+  if (Offset + Length < Offset) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (Cache->MediaId != EXT4_MEDIA_ID (Partition)) {
+    DEBUG ((DEBUG_FS, "[ext4] Media changed, invalidating the block cache\n"));
+    Ext4InvalidateBlockCache (Partition);
+    Cache->MediaId = EXT4_MEDIA_ID (Partition);
+  }
+
+  BlockSize = Partition->BlockSize;
+  Block     = DivU64x32Remainder (Offset, BlockSize, &BlockOffset);
+  LastBlock = DivU64x32 (Offset + Length - 1, BlockSize);
+
+  // Never read ahead past the end of the filesystem
+  ReadAheadEnd = LastBlock + ReadAhead / BlockSize;
+  if ((ReadAheadEnd >= Partition->NumberBlocks) || (ReadAheadEnd < LastBlock)) {
+    ReadAheadEnd = MAX (LastBlock, Partition->NumberBlocks - 1);
+  }
+
+  // Don't let a single run take over the whole class
+  MaxRunLength = MAX (Lru->MaxCount / 4, 1);
+
+  while (Length != 0) {
+    ToCopy = MIN (BlockSize - BlockOffset, Length);
+    Entry  = Ext4BlockCacheLookup (Cache, Block);
+
+    if (Entry != NULL) {
+      Lru->Hits++;
+      RemoveEntryList (&Entry->LruNode);
+      InsertHeadList (&Cache->Classes[Entry->Class].Lru, &Entry->LruNode);
+    } else {
+      Lru->Misses++;
+
+      // Extend the miss to a run of uncached blocks, so that it is read with a
+      // single request. Blocks past LastBlock are read ahead.
+      RunLength = 1;
+      while ((RunLength < MaxRunLength) && (Block + RunLength <= ReadAheadEnd) &&
+             (Ext4BlockCacheLookup (Cache, Block + RunLength) == NULL))
+      {
+        RunLength++;
+      }
+
+      Status = Ext4BlockCacheFill (Partition, Class, Block, RunLength, &Entry);
+
+      if (Status == EFI_OUT_OF_RESOURCES) {
+        // Not enough memory to cache anything, read the rest straight from the disk.
+        return Ext4ReadDiskIo (Partition, Buffer, Length, Offset);
+      }
+
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+    }
+
+    CopyMem (Buffer, EXT4_CACHED_BLOCK_DATA (Entry) + BlockOffset, ToCopy);
+
+    Buffer      = (CHAR8 *)Buffer + ToCopy;
+    Length     -= ToCopy;
+    Offset     += ToCopy;
+    BlockOffset = 0;
+    Block++;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Reads blocks from the partition's disk through the block cache.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Class          Class of the blocks that are read.
+   @param[out] Buffer         Pointer to a destination buffer.
+   @param[in]  NumberBlocks   Length of the read, in filesystem blocks.
+   @param[in]  BlockNumber    Starting block number.
+
+   @return Success status of the read.
+**/
+EFI_STATUS
+Ext4ReadBlocksCached (
+  IN EXT4_PARTITION          *Partition,
+  IN EXT4_BLOCK_CACHE_CLASS  Class,
+  OUT VOID                   *Buffer,
+  IN UINTN                   NumberBlocks,
+  IN EXT4_BLOCK_NR           BlockNumber
+  )
+{
+  UINT64  Offset;
+  UINTN   Length;
+
+  ASSERT (NumberBlocks != 0);
+  ASSERT (BlockNumber != EXT4_BLOCK_FILE_HOLE);
+
+  Offset = MultU64x32 (BlockNumber, Partition->BlockSize);
+  Length = NumberBlocks * Partition->BlockSize;
+
+  // Check for overflow on the block -> byte conversions.
+  // Partition->BlockSize is never 0, so we don't need to check for that.
+
+  if (DivU64x64Remainder (Offset, BlockNumber, NULL) != Partition->BlockSize) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (Length / NumberBlocks != Partition->BlockSize) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  return Ext4ReadDiskIoCached (Partition, Class, Buffer, Length, Offset, 0);
+}
+
+/**
+   Writes to the partition's disk, and updates the copies of the written
+   blocks held by the block cache and the inode table window.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Buffer         Pointer to a source buffer.
+   @param[in]  Length         Length of the source buffer.
+   @param[in]  Offset         Offset, in bytes, of the location to write.
+
+   @return Success status of the write.
+**/
+EFI_STATUS
+Ext4WriteDiskIoCached (
+  IN EXT4_PARTITION  *Partition,
+  IN CONST VOID      *Buffer,
+  IN UINTN           Length,
+  IN UINT64          Offset
+  )
+{
+  EXT4_BLOCK_CACHE   *Cache;
+  EXT4_CACHED_BLOCK  *Entry;
+  EXT4_BLOCK_NR      Block;
+  UINT32             BlockOffset;
+  UINTN              ToCopy;
+  EFI_STATUS         Status;
+
+  if (Length == 0) {
+    return EFI_SUCCESS;
+  }
+
+  if (Offset + Length < Offset) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = Ext4WriteDiskIo (Partition, Buffer, Length, Offset);
+
+  // Even a failed write may have reached some of the blocks, so drop what
+  // the cache knows about them.
+  Ext4UpdateInodeTableWindow (Partition, EFI_ERROR (Status) ? NULL : Buffer, Length, Offset);
+
+  if (!EFI_ERROR (Status)) {
+    Ext4UpdateBlockGroupDescs (Partition, Buffer, Length, Offset);
+  }
+
+  Cache = &Partition->BlockCache;
+
+  if (Cache->Buckets == NULL) {
+    return Status;
+  }
+
+  if (Cache->MediaId != EXT4_MEDIA_ID (Partition)) {
+    Ext4InvalidateBlockCache (Partition);
+    Cache->MediaId = EXT4_MEDIA_ID (Partition);
+    return Status;
+  }
+
+  Block = DivU64x32Remainder (Offset, Partition->BlockSize, &BlockOffset);
+
+  while (Length != 0) {
+    ToCopy = MIN (Partition->BlockSize - BlockOffset, Length);
+    Entry  = Ext4BlockCacheLookup (Cache, Block);
+
+    if (Entry != NULL) {
+      if (EFI_ERROR (Status)) {
+        RemoveEntryList (&Entry->HashNode);
+        RemoveEntryList (&Entry->LruNode);
+        Cache->Classes[Entry->Class].Count--;
+        FreePool (Entry);
+      } else {
+        CopyMem (EXT4_CACHED_BLOCK_DATA (Entry) + BlockOffset, Buffer, ToCopy);
+      }
+    }
+
+    Buffer      = (CONST UINT8 *)Buffer + ToCopy;
+    Length     -= ToCopy;
+    BlockOffset = 0;
+    Block++;
+  }
+
+  return Status;
+}
+
+/**
+   Writes blocks to the partition's disk, updating the block cache.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Buffer         Pointer to a source buffer.
+   @param[in]  NumberBlocks   Length of the write, in filesystem blocks.
+   @param[in]  BlockNumber    Starting block number.
+
+   @return Success status of the write.
+**/
+EFI_STATUS
+Ext4WriteBlocksCached (
+  IN EXT4_PARTITION  *Partition,
+  IN CONST VOID      *Buffer,
+  IN UINTN           NumberBlocks,
+  IN EXT4_BLOCK_NR   BlockNumber
+  )
+{
+  UINT64  Offset;
+  UINTN   Length;
+
+  ASSERT (NumberBlocks != 0);
+  ASSERT (BlockNumber != EXT4_BLOCK_FILE_HOLE);
+
+  Offset = MultU64x32 (BlockNumber, Partition->BlockSize);
+  Length = NumberBlocks * Partition->BlockSize;
+
+  if (DivU64x64Remainder (Offset, BlockNumber, NULL) != Partition->BlockSize) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (Length / NumberBlocks != Partition->BlockSize) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  return Ext4WriteDiskIoCached (Partition, Buffer, Length, Offset);
+}
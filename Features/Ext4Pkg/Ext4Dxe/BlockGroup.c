@@ -28,81 +28,409 @@ Ext4GetBlockGroupDesc (
 }
 
 /**
-   Reads an inode from disk.
+   Retrieves the first block of a block group's inode table.
 
-   @param[in]    Partition  Pointer to the opened partition.
-   @param[in]    InodeNum   Number of the desired Inode
-   @param[out]   OutIno     Pointer to where it will be stored a pointer to the read inode.
+   @param[in]    Partition         Pointer to the opened partition.
+   @param[in]    BlockGroupNumber  Block group number.
 
-   @return Status of the inode read.
+   @return Number of the first block of the inode table.
 **/
-EFI_STATUS
-Ext4ReadInode (
+STATIC
+EXT4_BLOCK_NR
+Ext4GetInodeTableStart (
   IN EXT4_PARTITION  *Partition,
-  IN EXT4_INO_NR     InodeNum,
-  OUT EXT4_INODE     **OutIno
+  IN UINT32          BlockGroupNumber
   )
 {
-  UINT64                 InodeOffset;
-  UINT32                 BlockGroupNumber;
-  EXT4_INODE             *Inode;
   EXT4_BLOCK_GROUP_DESC  *BlockGroup;
-  EXT4_BLOCK_NR          InodeTableStart;
-  EFI_STATUS             Status;
+
+  BlockGroup = Ext4GetBlockGroupDesc (Partition, BlockGroupNumber);
+
+  return EXT4_BLOCK_NR_FROM_HALFS (
+           Partition,
+           BlockGroup->bg_inode_table_lo,
+           BlockGroup->bg_inode_table_hi
+           );
+}
+
+/**
+   Locates an inode on the disk.
+
+   @param[in]    Partition         Pointer to the opened partition.
+   @param[in]    InodeNum          Number of the desired Inode
+   @param[out]   DiskOffset        Offset of the inode on the disk, in bytes.
+   @param[out]   BlockGroupNumber  Block group of the inode.
+
+   @retval EFI_SUCCESS           The inode was located.
+   @retval EFI_VOLUME_CORRUPTED  The inode number or its block group is invalid.
+**/
+EFI_STATUS
+Ext4GetInodeOffset (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_INO_NR     InodeNum,
+  OUT UINT64          *DiskOffset,
+  OUT UINT32          *BlockGroupNumber
+  )
+{
+  UINT64  InodeOffset;
+  UINT32  Group;
 
   if (!EXT4_IS_VALID_INODE_NR (Partition, InodeNum)) {
     DEBUG ((DEBUG_ERROR, "[ext4] Error reading inode: inode number %lu isn't valid\n", InodeNum));
     return EFI_VOLUME_CORRUPTED;
   }
 
-  BlockGroupNumber = (UINT32)DivU64x64Remainder (
-                               InodeNum - 1,
-                               Partition->SuperBlock.s_inodes_per_group,
-                               &InodeOffset
-                               );
+  Group = (UINT32)DivU64x64Remainder (
+                    InodeNum - 1,
+                    Partition->SuperBlock.s_inodes_per_group,
+                    &InodeOffset
+                    );
 
   // Check for the block group number's correctness
-  if (BlockGroupNumber >= Partition->NumberBlockGroups) {
+  if (Group >= Partition->NumberBlockGroups) {
     return EFI_VOLUME_CORRUPTED;
   }
 
-  Inode = Ext4AllocateInode (Partition);
+  // Inode tables of EXT4_BG_INODE_UNINIT groups may hold garbage, but no entry
+  // refers to their inodes until Ext4AllocateInodeNr initialises the group.
 
-  if (Inode == NULL) {
+  *DiskOffset = EXT4_BLOCK_TO_BYTES (Partition, Ext4GetInodeTableStart (Partition, Group)) +
+                MultU64x32 (InodeOffset, Partition->InodeSize);
+  *BlockGroupNumber = Group;
+  return EFI_SUCCESS;
+}
+
+/**
+   Sets up the inode table window of the partition, sizing it after
+   PcdExt4InodeTableWindowSize. Partition->BlockSize and Partition->InodeSize
+   must be valid.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @retval EFI_SUCCESS            The window was set up, or it is disabled.
+   @retval EFI_OUT_OF_RESOURCES   The window could not be allocated.
+**/
+EFI_STATUS
+Ext4InitInodeTableWindow (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_INODE_TABLE_WINDOW  *Window;
+  UINTN                    MaxLength;
+
+  Window = &Partition->InodeTableWindow;
+  ZeroMem (Window, sizeof (EXT4_INODE_TABLE_WINDOW));
+
+  if (PcdGet32 (PcdExt4InodeTableWindowSize) == 0) {
+    return EFI_SUCCESS;
+  }
+
+  // The window holds whole blocks, at least one
+  MaxLength = PcdGet32 (PcdExt4InodeTableWindowSize) - PcdGet32 (PcdExt4InodeTableWindowSize) % Partition->BlockSize;
+  MaxLength = MAX (MaxLength, Partition->BlockSize);
+
+  Window->Data     = AllocatePool (MaxLength);
+  Window->Verified = AllocateZeroPool ((MaxLength / Partition->InodeSize + 7) / 8);
+
+  if ((Window->Data == NULL) || (Window->Verified == NULL)) {
+    Ext4FreeInodeTableWindow (Partition);
     return EFI_OUT_OF_RESOURCES;
   }
 
-  BlockGroup = Ext4GetBlockGroupDesc (Partition, BlockGroupNumber);
+  Window->MaxLength = MaxLength;
+  Window->MediaId   = EXT4_MEDIA_ID (Partition);
 
-  // Note: We'll need to check INODE_UNINIT and friends when/if we add write support
+  return EFI_SUCCESS;
+}
 
-  InodeTableStart = EXT4_BLOCK_NR_FROM_HALFS (
-                      Partition,
-                      BlockGroup->bg_inode_table_lo,
-                      BlockGroup->bg_inode_table_hi
-                      );
+/**
+   Frees the inode table window of the partition.
 
-  Status = Ext4ReadDiskIo (
-             Partition,
-             Inode,
-             Partition->InodeSize,
-             EXT4_BLOCK_TO_BYTES (Partition, InodeTableStart) + MultU64x32 (InodeOffset, Partition->InodeSize)
-             );
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+**/
+VOID
+Ext4FreeInodeTableWindow (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_INODE_TABLE_WINDOW  *Window;
+
+  Window = &Partition->InodeTableWindow;
+
+  if (Window->Data != NULL) {
+    DEBUG ((DEBUG_FS, "[ext4] Inode table window: %lu hits %lu misses\n", Window->Hits, Window->Misses));
+    FreePool (Window->Data);
+    Window->Data = NULL;
+  }
+
+  if (Window->Verified != NULL) {
+    FreePool (Window->Verified);
+    Window->Verified = NULL;
+  }
+
+  Window->Length = 0;
+}
+
+/**
+   Updates the inode table window after a write to the disk.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      Buffer         Pointer to the data that was written, or NULL
+                                  if the write failed and its outcome is unknown.
+   @param[in]      Length         Length of the write, in bytes.
+   @param[in]      Offset         Offset of the write on the disk, in bytes.
+**/
+VOID
+Ext4UpdateInodeTableWindow (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN CONST VOID          *Buffer OPTIONAL,
+  IN UINTN               Length,
+  IN UINT64              Offset
+  )
+{
+  EXT4_INODE_TABLE_WINDOW  *Window;
+  UINT64                   Start;
+  UINT64                   End;
+  UINTN                    Slot;
+
+  Window = &Partition->InodeTableWindow;
+
+  if (  (Window->Data == NULL)
+     || (Window->Length == 0)
+     || (Offset >= Window->DiskOffset + Window->Length)
+     || (Offset + Length <= Window->DiskOffset))
+  {
+    return;
+  }
+
+  if (Buffer == NULL) {
+    Window->Length = 0;
+    return;
+  }
+
+  Start = MAX (Offset, Window->DiskOffset);
+  End   = MIN (Offset + Length, Window->DiskOffset + Window->Length);
+
+  CopyMem (
+    Window->Data + (Start - Window->DiskOffset),
+    (CONST UINT8 *)Buffer + (Start - Offset),
+    (UINTN)(End - Start)
+    );
+
+  // The new contents of the written slots need to be verified again
+  for (Slot = (UINTN)(Start - Window->DiskOffset) / Partition->InodeSize;
+       Slot * Partition->InodeSize < End - Window->DiskOffset;
+       Slot++)
+  {
+    Window->Verified[Slot / 8] &= (UINT8) ~(1 << (Slot % 8));
+  }
+}
+
+/**
+   Updates the in-memory block group descriptors after a write to the disk
+   that covered some of them.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      Buffer         Pointer to the data that was written.
+   @param[in]      Length         Length of the write, in bytes.
+   @param[in]      Offset         Offset of the write on the disk, in bytes.
+**/
+VOID
+Ext4UpdateBlockGroupDescs (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN CONST VOID          *Buffer,
+  IN UINTN               Length,
+  IN UINT64              Offset
+  )
+{
+  UINT64  TableStart;
+  UINT64  TableEnd;
+  UINT64  Start;
+  UINT64  End;
+
+  if (Partition->BlockGroups == NULL) {
+    return;
+  }
+
+  TableStart = EXT4_BLOCK_TO_BYTES (Partition, Partition->BlockSize == 1024 ? 2 : 1);
+  TableEnd   = TableStart + MultU64x32 (Partition->NumberBlockGroups, Partition->DescSize);
+
+  if ((Offset >= TableEnd) || (Offset + Length <= TableStart)) {
+    return;
+  }
+
+  Start = MAX (Offset, TableStart);
+  End   = MIN (Offset + Length, TableEnd);
+
+  CopyMem (
+    (UINT8 *)Partition->BlockGroups + (Start - TableStart),
+    (CONST UINT8 *)Buffer + (Start - Offset),
+    (UINTN)(End - Start)
+    );
+}
+
+/**
+   Reads the part of the inode tables around an inode into the window.
+
+   The window is aligned on its own size from the start of the group's inode
+   table. With flex_bg, the inode tables of a flex group's block groups are
+   laid out back to back, so the window keeps going into the tables of the
+   following groups as long as they are contiguous.
+
+   @param[in]    Partition         Pointer to the opened partition.
+   @param[in]    BlockGroupNumber  Block group of the inode.
+   @param[in]    DiskOffset        Offset of the inode on the disk, in bytes.
+
+   @return Status of the read.
+**/
+STATIC
+EFI_STATUS
+Ext4FillInodeTableWindow (
+  IN EXT4_PARTITION  *Partition,
+  IN UINT32          BlockGroupNumber,
+  IN UINT64          DiskOffset
+  )
+{
+  EXT4_INODE_TABLE_WINDOW  *Window;
+  EXT4_BLOCK_NR            TableStart;
+  EXT4_BLOCK_NR            TableBlocks;
+  EXT4_BLOCK_NR            InodeBlock;
+  EXT4_BLOCK_NR            Start;
+  EXT4_BLOCK_NR            End;
+  EXT4_BLOCK_NR            WindowBlocks;
+  UINT64                   Group;
+  EFI_STATUS               Status;
+
+  Window       = &Partition->InodeTableWindow;
+  WindowBlocks = Window->MaxLength / Partition->BlockSize;
+  TableStart   = Ext4GetInodeTableStart (Partition, BlockGroupNumber);
+  TableBlocks  = DivU64x32 (
+                   MultU64x32 (Partition->SuperBlock.s_inodes_per_group, Partition->InodeSize) + Partition->BlockSize - 1,
+                   Partition->BlockSize
+                   );
+  InodeBlock = DivU64x32 (DiskOffset, Partition->BlockSize);
+
+  Start = InodeBlock;
+  if (InodeBlock >= TableStart) {
+    Start -= ModU64x32 (InodeBlock - TableStart, (UINT32)WindowBlocks);
+  }
+
+  End = TableStart + TableBlocks;
+
+  if (EXT4_HAS_INCOMPAT (Partition, EXT4_FEATURE_INCOMPAT_FLEX_BG)) {
+    for (Group = BlockGroupNumber + 1; Group < Partition->NumberBlockGroups && End < Start + WindowBlocks; Group++) {
+      if (Ext4GetInodeTableStart (Partition, (UINT32)Group) != End) {
+        break;
+      }
+
+      End += TableBlocks;
+    }
+  }
+
+  End = MIN (End, Start + WindowBlocks);
+  End = MIN (End, Partition->NumberBlocks);
+
+  Window->Length = 0;
+
+  if (End <= InodeBlock) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Status = Ext4ReadBlocks (Partition, Window->Data, (UINTN)(End - Start), Start);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Window->DiskOffset = EXT4_BLOCK_TO_BYTES (Partition, Start);
+  Window->Length     = (UINTN)EXT4_BLOCK_TO_BYTES (Partition, End - Start);
+  ZeroMem (Window->Verified, (Window->MaxLength / Partition->InodeSize + 7) / 8);
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Reads an inode from its inode table, and verifies it.
+
+   Inodes are served from the inode table window, which is refilled when it
+   doesn't hold the inode. Inodes are only verified the first time they're
+   served from a given fill of the window.
+
+   @param[in]    Partition         Pointer to the opened partition.
+   @param[in]    InodeNum          Number of the desired Inode
+   @param[in]    BlockGroupNumber  Block group of the inode.
+   @param[in]    DiskOffset        Offset of the inode on the disk, in bytes.
+   @param[out]   Inode             Pointer to the inode buffer.
+
+   @return Status of the inode read.
+**/
+STATIC
+EFI_STATUS
+Ext4ReadInodeFromTable (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_INO_NR     InodeNum,
+  IN  UINT32          BlockGroupNumber,
+  IN  UINT64          DiskOffset,
+  OUT EXT4_INODE      *Inode
+  )
+{
+  EXT4_INODE_TABLE_WINDOW  *Window;
+  UINTN                    Slot;
+  BOOLEAN                  Verified;
+  EFI_STATUS               Status;
+
+  Window   = &Partition->InodeTableWindow;
+  Verified = FALSE;
+  Slot     = 0;
+
+  if (Window->Data != NULL) {
+    if (Window->MediaId != EXT4_MEDIA_ID (Partition)) {
+      Window->Length  = 0;
+      Window->MediaId = EXT4_MEDIA_ID (Partition);
+    }
+
+    if (  (Window->Length != 0)
+       && (DiskOffset >= Window->DiskOffset)
+       && (DiskOffset - Window->DiskOffset + Partition->InodeSize <= Window->Length))
+    {
+      Window->Hits++;
+      Status = EFI_SUCCESS;
+    } else {
+      Window->Misses++;
+      Status = Ext4FillInodeTableWindow (Partition, BlockGroupNumber, DiskOffset);
+    }
+
+    if (!EFI_ERROR (Status)) {
+      Slot     = (UINTN)(DiskOffset - Window->DiskOffset);
+      Verified = (Window->Verified[Slot / Partition->InodeSize / 8] & (1 << (Slot / Partition->InodeSize % 8))) != 0;
+      CopyMem (Inode, Window->Data + Slot, Partition->InodeSize);
+    }
+  } else {
+    Status = Ext4ReadDiskIoCached (
+               Partition,
+               Ext4BlockCacheMetadata,
+               Inode,
+               Partition->InodeSize,
+               DiskOffset,
+               0
+               );
+  }
 
   if (EFI_ERROR (Status)) {
     DEBUG ((
       DEBUG_ERROR,
-      "[ext4] Error reading inode: status %x; inode offset %lx"
-      " inode table start %lu block group %lu\n",
+      "[ext4] Error reading inode: status %x; inode %lu disk offset %lx\n",
       Status,
-      InodeOffset,
-      InodeTableStart,
-      BlockGroupNumber
+      InodeNum,
+      DiskOffset
       ));
-    FreePool (Inode);
     return Status;
   }
 
+  if (Verified) {
+    return EFI_SUCCESS;
+  }
+
   if (!Ext4CheckInodeChecksum (Partition, Inode, InodeNum)) {
     DEBUG ((
       DEBUG_ERROR,
@@ -110,14 +438,204 @@ Ext4ReadInode (
       InodeNum,
       Ext4CalculateInodeChecksum (Partition, Inode, InodeNum)
       ));
-    FreePool (Inode);
     return EFI_VOLUME_CORRUPTED;
   }
 
+  if (Window->Data != NULL) {
+    Window->Verified[Slot / Partition->InodeSize / 8] |= (UINT8)(1 << (Slot / Partition->InodeSize % 8));
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Reads an inode from disk.
+
+   @param[in]    Partition  Pointer to the opened partition.
+   @param[in]    InodeNum   Number of the desired Inode
+   @param[out]   OutIno     Pointer to where it will be stored a pointer to the read inode.
+
+   @return Status of the inode read.
+**/
+EFI_STATUS
+Ext4ReadInode (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_INO_NR     InodeNum,
+  OUT EXT4_INODE     **OutIno
+  )
+{
+  UINT64      DiskOffset;
+  UINT32      BlockGroupNumber;
+  EXT4_INODE  *Inode;
+  EFI_STATUS  Status;
+
+  Status = Ext4GetInodeOffset (Partition, InodeNum, &DiskOffset, &BlockGroupNumber);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Inode = Ext4AllocateInode (Partition);
+
+  if (Inode == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (Ext4InodeCacheLookup (Partition, InodeNum, Inode)) {
+    *OutIno = Inode;
+    return EFI_SUCCESS;
+  }
+
+  Status = Ext4ReadInodeFromTable (Partition, InodeNum, BlockGroupNumber, DiskOffset, Inode);
+
+  if (EFI_ERROR (Status)) {
+    FreePool (Inode);
+    return Status;
+  }
+
+  Ext4InodeCacheInsert (Partition, InodeNum, Inode);
+
   *OutIno = Inode;
   return EFI_SUCCESS;
 }
 
+//
+// Inode of a batch that needs to be read from the disk, see Ext4ReadInodes.
+//
+typedef struct {
+  UINT64        DiskOffset;
+  UINT32        BlockGroupNumber;
+  UINTN         Index;
+  EXT4_INODE    *Inode;
+} EXT4_INODE_FETCH;
+
+/**
+   Compares two inode fetches by their location on the disk, for QuickSort ().
+
+   @param[in]  Buffer1   The first fetch.
+   @param[in]  Buffer2   The second fetch.
+
+   @retval <0  Buffer1 comes before Buffer2 on the disk.
+   @retval 0   Buffer1 and Buffer2 are at the same location.
+   @retval >0  Buffer1 comes after Buffer2 on the disk.
+**/
+STATIC
+INTN
+EFIAPI
+Ext4CompareInodeFetches (
+  IN CONST VOID  *Buffer1,
+  IN CONST VOID  *Buffer2
+  )
+{
+  UINT64  Offset1;
+  UINT64  Offset2;
+
+  Offset1 = ((CONST EXT4_INODE_FETCH *)Buffer1)->DiskOffset;
+  Offset2 = ((CONST EXT4_INODE_FETCH *)Buffer2)->DiskOffset;
+
+  if (Offset1 < Offset2) {
+    return -1;
+  }
+
+  return Offset1 > Offset2 ? 1 : 0;
+}
+
+/**
+   Reads a batch of inodes from disk.
+   Inodes are fetched in the order of their location on the disk, so that each
+   block of the inode tables is only read once, whatever the order of InodeNums.
+
+   @param[in]    Partition  Pointer to the opened partition.
+   @param[in]    Count      Number of inodes to read.
+   @param[in]    InodeNums  Numbers of the desired inodes.
+   @param[out]   Inodes     Array of Count pointers that receive the read inodes.
+                            Inodes that could not be read are set to NULL;
+                            Ext4ReadInode() tells why.
+
+   @retval EFI_SUCCESS           The batch was processed.
+   @retval EFI_OUT_OF_RESOURCES  The batch could not be set up.
+**/
+EFI_STATUS
+Ext4ReadInodes (
+  IN  EXT4_PARTITION     *Partition,
+  IN  UINTN              Count,
+  IN  CONST EXT4_INO_NR  *InodeNums,
+  OUT EXT4_INODE         **Inodes
+  )
+{
+  EXT4_INODE_FETCH  *Fetches;
+  EXT4_INODE_FETCH  Swap;
+  EXT4_INODE_FETCH  *Fetch;
+  UINTN             NumberFetches;
+  UINTN             Index;
+  EXT4_INODE        *Inode;
+  EFI_STATUS        Status;
+
+  ZeroMem (Inodes, Count * sizeof (EXT4_INODE *));
+
+  if (Count == 0) {
+    return EFI_SUCCESS;
+  }
+
+  Fetches = AllocatePool (Count * sizeof (EXT4_INODE_FETCH));
+
+  if (Fetches == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  NumberFetches = 0;
+
+  for (Index = 0; Index < Count; Index++) {
+    Inode = Ext4AllocateInode (Partition);
+
+    if (Inode == NULL) {
+      continue;
+    }
+
+    if (Ext4InodeCacheLookup (Partition, InodeNums[Index], Inode)) {
+      Inodes[Index] = Inode;
+      continue;
+    }
+
+    Fetch  = &Fetches[NumberFetches];
+    Status = Ext4GetInodeOffset (Partition, InodeNums[Index], &Fetch->DiskOffset, &Fetch->BlockGroupNumber);
+
+    if (EFI_ERROR (Status)) {
+      FreePool (Inode);
+      continue;
+    }
+
+    Fetch->Index = Index;
+    Fetch->Inode = Inode;
+    NumberFetches++;
+  }
+
+  QuickSort (Fetches, NumberFetches, sizeof (EXT4_INODE_FETCH), Ext4CompareInodeFetches, &Swap);
+
+  // In disk order, the inode table window (or the block cache) reads each block once
+  for (Index = 0; Index < NumberFetches; Index++) {
+    Fetch  = &Fetches[Index];
+    Status = Ext4ReadInodeFromTable (
+               Partition,
+               InodeNums[Fetch->Index],
+               Fetch->BlockGroupNumber,
+               Fetch->DiskOffset,
+               Fetch->Inode
+               );
+
+    if (EFI_ERROR (Status)) {
+      FreePool (Fetch->Inode);
+      continue;
+    }
+
+    Ext4InodeCacheInsert (Partition, InodeNums[Fetch->Index], Fetch->Inode);
+    Inodes[Fetch->Index] = Fetch->Inode;
+  }
+
+  FreePool (Fetches);
+  return EFI_SUCCESS;
+}
+
 /**
    Calculates the checksum of the block group descriptor for METADATA_CSUM enabled filesystems.
    @param[in]      Partition       Pointer to the opened EXT4 partition.
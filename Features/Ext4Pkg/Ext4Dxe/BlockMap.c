@@ -264,7 +264,7 @@ Ext4GetBlocks (
       return EFI_NO_MAPPING;
     }
 
-    Status = Ext4ReadBlocks (Partition, Buffer, 1, Block);
+    Status = Ext4ReadBlocksCached (Partition, Ext4BlockCacheMetadata, Buffer, 1, Block);
 
     if (EFI_ERROR (Status)) {
       FreePool (Buffer);
@@ -0,0 +1,1295 @@
+/** @file
+  File creation and deletion routines
+
+  Copyright (c) 2024 Pedro Falcato All rights reserved.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  New entries go in the first directory block with room for them, or in the
+  leaf of the hash tree index that their name hashes to; full leaves aren't
+  split, so a name that doesn't fit in its leaf can't be created.
+**/
+
+#include "Ext4Dxe.h"
+
+#include <Library/BaseUcs2Utf8Lib.h>
+
+// Most links an inode can have; directories with DIR_NLINK count as 1 link past it
+#define EXT4_LINK_MAX  65000
+
+#define EXT4_INO_PERM_DEFAULT_FILE  0644
+#define EXT4_INO_PERM_DEFAULT_DIR   0755
+#define EXT4_INO_PERM_WRITE_ALL     0222
+
+/**
+   Retrieves the part of a directory block that holds directory entries,
+   which excludes the checksum tail.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Block       Pointer to the directory block.
+   @param[out]     HasTail     TRUE if the block ends with a checksum tail.
+
+   @return Length of the part of the block, in bytes.
+**/
+STATIC
+UINTN
+Ext4DirBlockEntriesLength (
+  IN  EXT4_PARTITION  *Partition,
+  IN  CONST UINT8     *Block,
+  OUT BOOLEAN         *HasTail
+  )
+{
+  CONST EXT4_DIR_ENTRY_TAIL  *Tail;
+
+  Tail     = (CONST EXT4_DIR_ENTRY_TAIL *)(Block + Partition->BlockSize - sizeof (EXT4_DIR_ENTRY_TAIL));
+  *HasTail = EXT4_HAS_METADATA_CSUM (Partition) &&
+             (Tail->det_reserved_zero1 == 0) &&
+             (Tail->det_rec_len == sizeof (EXT4_DIR_ENTRY_TAIL)) &&
+             (Tail->det_reserved_zero2 == 0) &&
+             (Tail->det_reserved_ft == EXT4_DIR_ENTRY_TAIL_FT);
+
+  return *HasTail ? Partition->BlockSize - sizeof (EXT4_DIR_ENTRY_TAIL) : Partition->BlockSize;
+}
+
+/**
+   Sets up the checksum tail of a directory block.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      InodeNum    Inode number of the directory.
+   @param[in]      Inode       Pointer to the directory's inode.
+   @param[in out]  Block       Pointer to the directory block.
+**/
+STATIC
+VOID
+Ext4SetDirBlockTail (
+  IN     EXT4_PARTITION    *Partition,
+  IN     EXT4_INO_NR       InodeNum,
+  IN     CONST EXT4_INODE  *Inode,
+  IN OUT UINT8             *Block
+  )
+{
+  EXT4_DIR_ENTRY_TAIL  *Tail;
+  UINT32               Csum;
+
+  if (!EXT4_HAS_METADATA_CSUM (Partition)) {
+    return;
+  }
+
+  Tail = (EXT4_DIR_ENTRY_TAIL *)(Block + Partition->BlockSize - sizeof (EXT4_DIR_ENTRY_TAIL));
+  ZeroMem (Tail, sizeof (*Tail));
+  Tail->det_rec_len     = sizeof (EXT4_DIR_ENTRY_TAIL);
+  Tail->det_reserved_ft = EXT4_DIR_ENTRY_TAIL_FT;
+
+  Csum = Ext4CalculateChecksum (Partition, &InodeNum, sizeof (InodeNum), Partition->InitialSeed);
+  Csum = Ext4CalculateChecksum (Partition, &Inode->i_generation, sizeof (Inode->i_generation), Csum);
+  Csum = Ext4CalculateChecksum (Partition, Block, Partition->BlockSize - sizeof (EXT4_DIR_ENTRY_TAIL), Csum);
+
+  Tail->det_checksum = Csum;
+}
+
+/**
+   Gets the directory entry at an offset of a directory block, and checks it.
+
+   @param[in]      Block       Pointer to the directory block.
+   @param[in]      Offset      Offset of the entry.
+   @param[in]      Length      Length of the part of the block that holds entries.
+
+   @return Pointer to the entry, or NULL if it's corrupted.
+**/
+STATIC
+EXT4_DIR_ENTRY *
+Ext4GetDirBlockEntry (
+  IN UINT8  *Block,
+  IN UINTN  Offset,
+  IN UINTN  Length
+  )
+{
+  EXT4_DIR_ENTRY  *Entry;
+
+  if (Length - Offset < EXT4_MIN_DIR_ENTRY_LEN) {
+    return NULL;
+  }
+
+  Entry = (EXT4_DIR_ENTRY *)(Block + Offset);
+
+  if (  (Entry->rec_len < Entry->name_len + EXT4_MIN_DIR_ENTRY_LEN)
+     || ((Entry->rec_len % 4) != 0)
+     || (Entry->rec_len > Length - Offset))
+  {
+    return NULL;
+  }
+
+  return Entry;
+}
+
+/**
+   Finds room for a new entry in a directory block.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Block       Pointer to the directory block.
+   @param[in]      Needed      Length of the new entry.
+   @param[out]     Offset      Offset of the entry whose room is used.
+
+   @retval EFI_SUCCESS            Room was found.
+   @retval EFI_NOT_FOUND          The block is full.
+   @retval EFI_VOLUME_CORRUPTED   The block is corrupted.
+**/
+STATIC
+EFI_STATUS
+Ext4FindDirSlot (
+  IN  EXT4_PARTITION  *Partition,
+  IN  UINT8           *Block,
+  IN  UINTN           Needed,
+  OUT UINTN           *Offset
+  )
+{
+  EXT4_DIR_ENTRY  *Entry;
+  UINTN           Length;
+  UINTN           Position;
+  UINTN           Used;
+  BOOLEAN         HasTail;
+
+  Length = Ext4DirBlockEntriesLength (Partition, Block, &HasTail);
+
+  // Blocks without room for a checksum can't be changed
+  if (EXT4_HAS_METADATA_CSUM (Partition) && !HasTail) {
+    return EFI_NOT_FOUND;
+  }
+
+  for (Position = 0; Position < Length; Position += Entry->rec_len) {
+    Entry = Ext4GetDirBlockEntry (Block, Position, Length);
+
+    if (Entry == NULL) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    Used = Entry->inode != 0 ? EXT4_DIR_ENTRY_LEN (Entry->name_len) : 0;
+
+    if (Entry->rec_len - Used >= Needed) {
+      *Offset = Position;
+      return EFI_SUCCESS;
+    }
+  }
+
+  return EFI_NOT_FOUND;
+}
+
+/**
+   Finds the entry of a file in a directory block.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Block       Pointer to the directory block.
+   @param[in]      Name        Pointer to the UTF-8 name of the entry.
+   @param[in]      NameLength  Length of the name.
+   @param[in]      InodeNum    Inode number of the entry.
+   @param[out]     Offset      Offset of the entry.
+   @param[out]     Previous    Offset of the entry before it, or MAX_UINTN.
+
+   @retval EFI_SUCCESS            The entry was found.
+   @retval EFI_NOT_FOUND          The block doesn't hold the entry.
+   @retval EFI_VOLUME_CORRUPTED   The block is corrupted.
+**/
+STATIC
+EFI_STATUS
+Ext4FindDirBlockEntry (
+  IN  EXT4_PARTITION  *Partition,
+  IN  UINT8           *Block,
+  IN  CONST CHAR8     *Name,
+  IN  UINTN           NameLength,
+  IN  EXT4_INO_NR     InodeNum,
+  OUT UINTN           *Offset,
+  OUT UINTN           *Previous
+  )
+{
+  EXT4_DIR_ENTRY  *Entry;
+  UINTN           Length;
+  UINTN           Position;
+  BOOLEAN         HasTail;
+
+  Length    = Ext4DirBlockEntriesLength (Partition, Block, &HasTail);
+  *Previous = MAX_UINTN;
+
+  for (Position = 0; Position < Length; Position += Entry->rec_len) {
+    Entry = Ext4GetDirBlockEntry (Block, Position, Length);
+
+    if (Entry == NULL) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    if (  (Entry->inode == InodeNum) && (Entry->name_len == NameLength)
+       && (CompareMem (Entry->name, Name, NameLength) == 0))
+    {
+      *Offset = Position;
+      return EFI_SUCCESS;
+    }
+
+    *Previous = Position;
+  }
+
+  return EFI_NOT_FOUND;
+}
+
+/**
+   Reads a block of a directory, and finds where it is on the disk.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Directory   Pointer to the opened directory.
+   @param[in]      Logical     Logical block of the directory.
+   @param[out]     Buffer      Pointer to a buffer of Partition->BlockSize bytes.
+   @param[out]     Block       Physical block.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4ReadDirBlock (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *Directory,
+  IN  UINT32          Logical,
+  OUT UINT8           *Buffer,
+  OUT EXT4_BLOCK_NR   *Block
+  )
+{
+  EXT4_EXTENT  Extent;
+  EFI_STATUS   Status;
+
+  Status = Ext4GetExtent (Partition, Directory, Logical, &Extent);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // Directories have no holes
+  if (EXT4_EXTENT_IS_UNINITIALIZED (&Extent)) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  *Block = (LShiftU64 (Extent.ee_start_hi, 32) | Extent.ee_start_lo) + Logical - Extent.ee_block;
+
+  return Ext4ReadBlocksCached (Partition, Ext4BlockCacheMetadata, Buffer, 1, *Block);
+}
+
+/**
+   Converts a name to UTF-8, and checks it can be a directory entry's.
+
+   @param[in]      Name        Pointer to the UCS-2 formatted filename.
+   @param[out]     Utf8Name    Pointer to the UTF-8 name, to be freed by the caller.
+   @param[out]     Length      Length of the UTF-8 name.
+
+   @retval EFI_SUCCESS             The name was converted.
+   @retval EFI_INVALID_PARAMETER   The name is not valid.
+   @retval !EFI_SUCCESS            Failure.
+**/
+STATIC
+EFI_STATUS
+Ext4GetUtf8Name (
+  IN  CONST CHAR16  *Name,
+  OUT CHAR8         **Utf8Name,
+  OUT UINTN         *Length
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = UCS2StrToUTF8 ((CHAR16 *)Name, Utf8Name);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *Length = AsciiStrLen (*Utf8Name);
+
+  if (  (*Length == 0) || (*Length > EXT4_NAME_MAX) || (AsciiStrStr (*Utf8Name, "/") != NULL)
+     || (AsciiStrCmp (*Utf8Name, ".") == 0) || (AsciiStrCmp (*Utf8Name, "..") == 0))
+  {
+    FreePool (*Utf8Name);
+    return EFI_INVALID_PARAMETER;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Appends an empty block to a directory.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Directory   Pointer to the opened directory.
+   @param[out]     Buffer      Pointer to a buffer of Partition->BlockSize
+                               bytes, which gets the new block.
+   @param[out]     Logical     Logical block of the new block.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4AppendDirBlock (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *Directory,
+  OUT UINT8           *Buffer,
+  OUT UINT32          *Logical
+  )
+{
+  EXT4_DIR_ENTRY  *Entry;
+  UINT64          Size;
+  UINTN           Length;
+  EFI_STATUS      Status;
+
+  Size = EXT4_INODE_SIZE (Directory->Inode);
+
+  ZeroMem (Buffer, Partition->BlockSize);
+  Entry          = (EXT4_DIR_ENTRY *)Buffer;
+  Entry->rec_len = (UINT16)Partition->BlockSize;
+
+  if (EXT4_HAS_METADATA_CSUM (Partition)) {
+    Entry->rec_len -= sizeof (EXT4_DIR_ENTRY_TAIL);
+  }
+
+  Ext4SetDirBlockTail (Partition, Directory->InodeNum, Directory->Inode, Buffer);
+
+  Length = Partition->BlockSize;
+  Status = Ext4Write (Partition, Directory, Buffer, Size, &Length);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *Logical = (UINT32)DivU64x32 (Size, Partition->BlockSize);
+  return EFI_SUCCESS;
+}
+
+/**
+   Finds a directory block with room for a new entry, appending one to
+   directories that have no room left.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Directory   Pointer to the opened directory.
+   @param[in]      Name        Pointer to the UTF-8 name of the entry.
+   @param[in]      NameLength  Length of the name.
+   @param[out]     Buffer      Pointer to a buffer of Partition->BlockSize bytes.
+   @param[out]     Block       Physical block with room for the entry.
+
+   @retval EFI_SUCCESS         A block was found.
+   @retval EFI_UNSUPPORTED     The entry's leaf of the hash tree index is full.
+   @retval !EFI_SUCCESS        Failure.
+**/
+STATIC
+EFI_STATUS
+Ext4FindDirBlockWithRoom (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *Directory,
+  IN  CONST CHAR8     *Name,
+  IN  UINTN           NameLength,
+  OUT UINT8           *Buffer,
+  OUT EXT4_BLOCK_NR   *Block
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      Logical;
+  UINT32      NumberBlocks;
+  UINTN       Offset;
+
+  if (EXT4_DIR_IS_INDEXED (Partition, Directory->Inode)) {
+    Status = Ext4HtreeFindLeaf (Directory, Partition, Name, NameLength, &Logical);
+
+    if (!EFI_ERROR (Status)) {
+      Status = Ext4ReadDirBlock (Partition, Directory, Logical, Buffer, Block);
+    }
+
+    if (!EFI_ERROR (Status)) {
+      Status = Ext4FindDirSlot (Partition, Buffer, EXT4_DIR_ENTRY_LEN (NameLength), &Offset);
+    }
+
+    if (Status == EFI_NOT_FOUND) {
+      DEBUG ((DEBUG_WARN, "[ext4] Leaf block %u of directory %u is full\n", Logical, Directory->InodeNum));
+      Status = EFI_UNSUPPORTED;
+    }
+
+    return Status;
+  }
+
+  NumberBlocks = (UINT32)DivU64x32 (EXT4_INODE_SIZE (Directory->Inode), Partition->BlockSize);
+
+  for (Logical = 0; Logical < NumberBlocks; Logical++) {
+    Status = Ext4ReadDirBlock (Partition, Directory, Logical, Buffer, Block);
+
+    if (!EFI_ERROR (Status)) {
+      Status = Ext4FindDirSlot (Partition, Buffer, EXT4_DIR_ENTRY_LEN (NameLength), &Offset);
+    }
+
+    if (Status != EFI_NOT_FOUND) {
+      return Status;
+    }
+  }
+
+  Status = Ext4AppendDirBlock (Partition, Directory, Buffer, &Logical);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return Ext4ReadDirBlock (Partition, Directory, Logical, Buffer, Block);
+}
+
+/**
+   Adds an entry to a directory block, which must have room for it.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in out]  Block       Pointer to the directory block.
+   @param[in]      InodeNum    Inode number of the entry.
+   @param[in]      Name        Pointer to the UTF-8 name of the entry.
+   @param[in]      NameLength  Length of the name.
+   @param[in]      FileType    EXT4_FT_* type of the entry.
+   @param[out]     Result      Copy of the new entry.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4AddDirBlockEntry (
+  IN     EXT4_PARTITION  *Partition,
+  IN OUT UINT8           *Block,
+  IN     EXT4_INO_NR     InodeNum,
+  IN     CONST CHAR8     *Name,
+  IN     UINTN           NameLength,
+  IN     UINT8           FileType,
+  OUT    EXT4_DIR_ENTRY  *Result
+  )
+{
+  EXT4_DIR_ENTRY  *Entry;
+  EXT4_DIR_ENTRY  *NewEntry;
+  EFI_STATUS      Status;
+  UINTN           Offset;
+  UINTN           Used;
+
+  Status = Ext4FindDirSlot (Partition, Block, EXT4_DIR_ENTRY_LEN (NameLength), &Offset);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Entry    = (EXT4_DIR_ENTRY *)(Block + Offset);
+  NewEntry = Entry;
+
+  if (Entry->inode != 0) {
+    // Split the room after the entry's name off
+    Used              = EXT4_DIR_ENTRY_LEN (Entry->name_len);
+    NewEntry          = (EXT4_DIR_ENTRY *)(Block + Offset + Used);
+    NewEntry->rec_len = (UINT16)(Entry->rec_len - Used);
+    Entry->rec_len    = (UINT16)Used;
+  }
+
+  NewEntry->inode     = InodeNum;
+  NewEntry->name_len  = (UINT8)NameLength;
+  NewEntry->file_type = EXT4_HAS_INCOMPAT (Partition, EXT4_FEATURE_INCOMPAT_FILETYPE) ? FileType : EXT4_FT_UNKNOWN;
+  ZeroMem (NewEntry->name, EXT4_DIR_ENTRY_LEN (NameLength) - EXT4_MIN_DIR_ENTRY_LEN);
+  CopyMem (NewEntry->name, Name, NameLength);
+
+  ZeroMem (Result, sizeof (*Result));
+  CopyMem (Result, NewEntry, EXT4_DIR_ENTRY_LEN (NameLength));
+  return EFI_SUCCESS;
+}
+
+/**
+   Sets up the first block of a new directory, with its "." and ".." entries.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      InodeNum    Inode number of the new directory.
+   @param[in]      Inode       Pointer to the new directory's inode.
+   @param[in]      Parent      Inode number of the parent directory.
+   @param[out]     Block       Pointer to the directory block.
+**/
+STATIC
+VOID
+Ext4InitDirBlock (
+  IN  EXT4_PARTITION    *Partition,
+  IN  EXT4_INO_NR       InodeNum,
+  IN  CONST EXT4_INODE  *Inode,
+  IN  EXT4_INO_NR       Parent,
+  OUT UINT8             *Block
+  )
+{
+  EXT4_DIR_ENTRY  *Entry;
+  UINT8           FileType;
+
+  FileType = EXT4_HAS_INCOMPAT (Partition, EXT4_FEATURE_INCOMPAT_FILETYPE) ? EXT4_FT_DIR : EXT4_FT_UNKNOWN;
+
+  ZeroMem (Block, Partition->BlockSize);
+
+  Entry            = (EXT4_DIR_ENTRY *)Block;
+  Entry->inode     = InodeNum;
+  Entry->rec_len   = EXT4_DIR_ENTRY_LEN (1);
+  Entry->name_len  = 1;
+  Entry->file_type = FileType;
+  Entry->name[0]   = '.';
+
+  Entry            = (EXT4_DIR_ENTRY *)(Block + EXT4_DIR_ENTRY_LEN (1));
+  Entry->inode     = Parent;
+  Entry->rec_len   = (UINT16)(Partition->BlockSize - EXT4_DIR_ENTRY_LEN (1));
+  Entry->name_len  = 2;
+  Entry->file_type = FileType;
+  Entry->name[0]   = '.';
+  Entry->name[1]   = '.';
+
+  if (EXT4_HAS_METADATA_CSUM (Partition)) {
+    Entry->rec_len -= sizeof (EXT4_DIR_ENTRY_TAIL);
+  }
+
+  Ext4SetDirBlockTail (Partition, InodeNum, Inode, Block);
+}
+
+/**
+   Sets up the inode of a new file.
+
+   @param[in out]  Txn         Pointer to the transaction.
+   @param[in]      InodeNum    Inode number of the new file.
+   @param[in]      Attributes  EFI_FILE_* attributes of the new file.
+   @param[out]     Inode       Pointer to the inode, Partition->InodeSize bytes long.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4InitInode (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_INO_NR       InodeNum,
+  IN     UINT64            Attributes,
+  OUT    EXT4_INODE        *Inode
+  )
+{
+  EXT4_PARTITION      *Partition;
+  EXT4_INODE          *Old;
+  EXT4_EXTENT_HEADER  *Header;
+  EFI_STATUS          Status;
+
+  Partition = Txn->Partition;
+
+  // The generation tells the new inode apart from the inode number's past users
+  Status = Ext4TxnGetInode (Txn, InodeNum, &Old);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ZeroMem (Inode, Partition->InodeSize);
+  Inode->i_generation = Old->i_generation + 1;
+
+  if ((Attributes & EFI_FILE_DIRECTORY) != 0) {
+    Inode->i_mode  = EXT4_INO_TYPE_DIR | EXT4_INO_PERM_DEFAULT_DIR;
+    Inode->i_links = 2;
+  } else {
+    Inode->i_mode  = EXT4_INO_TYPE_REGFILE | EXT4_INO_PERM_DEFAULT_FILE;
+    Inode->i_links = 1;
+  }
+
+  if ((Attributes & EFI_FILE_READ_ONLY) != 0) {
+    Inode->i_mode &= ~EXT4_INO_PERM_WRITE_ALL;
+  }
+
+  if (Partition->InodeSize > EXT4_GOOD_OLD_INODE_SIZE) {
+    Inode->i_extra_isize = (UINT16)MIN (
+                                     Partition->InodeSize - EXT4_GOOD_OLD_INODE_SIZE,
+                                     sizeof (EXT4_INODE) - EXT4_GOOD_OLD_INODE_SIZE
+                                     );
+  }
+
+  Ext4SetInodeTimes (Inode, EXT4_INODE_ATIME | EXT4_INODE_MTIME | EXT4_INODE_CTIME | EXT4_INODE_CRTIME, NULL);
+
+  Inode->i_flags   = EXT4_EXTENTS_FL;
+  Header           = (EXT4_EXTENT_HEADER *)Inode->i_data;
+  Header->eh_magic = EXT4_EXTENT_HEADER_MAGIC;
+  Header->eh_max   = (sizeof (Inode->i_data) - sizeof (EXT4_EXTENT_HEADER)) / sizeof (EXT4_EXTENT);
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Gives a new directory its first block.
+
+   @param[in out]  Txn         Pointer to the transaction.
+   @param[in]      InodeNum    Inode number of the new directory.
+   @param[in out]  Inode       Pointer to the new directory's inode.
+   @param[in]      Parent      Inode number of the parent directory.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4InitDirectory (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_INO_NR       InodeNum,
+  IN OUT EXT4_INODE        *Inode,
+  IN     EXT4_INO_NR       Parent
+  )
+{
+  EXT4_PARTITION      *Partition;
+  EXT4_EXTENT_HEADER  *Header;
+  EXT4_EXTENT         *Extent;
+  EXT4_BLOCK_NR       Block;
+  EFI_STATUS          Status;
+  UINT32              Allocated;
+  UINT8               *Data;
+
+  Partition = Txn->Partition;
+
+  Status = Ext4AllocateBlocks (Txn, Ext4InodeGoalBlock (Partition, InodeNum), 1, &Block, &Allocated);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // Directory blocks are metadata, and go through the journal
+  Status = Ext4TxnGetBlock (Txn, Block, TRUE, &Data);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Ext4InitDirBlock (Partition, InodeNum, Inode, Parent, Data);
+
+  Header              = (EXT4_EXTENT_HEADER *)Inode->i_data;
+  Header->eh_entries  = 1;
+  Extent              = (EXT4_EXTENT *)(Header + 1);
+  Extent->ee_block    = 0;
+  Extent->ee_len      = 1;
+  Extent->ee_start_lo = (UINT32)Block;
+  Extent->ee_start_hi = (UINT16)RShiftU64 (Block, 32);
+
+  Inode->i_size_lo = Partition->BlockSize;
+
+  return Ext4AddInodeBlocks (Partition, Inode, 1);
+}
+
+/**
+   Creates a file or a directory.
+
+   @param[in]      Directory     Pointer to the opened parent directory.
+   @param[in]      Name          Pointer to the UCS-2 formatted filename.
+   @param[in]      Attributes    EFI_FILE_* attributes of the new file.
+   @param[out]     Entry         Directory entry of the new file.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4CreateFile (
+  IN  EXT4_FILE       *Directory,
+  IN  CONST CHAR16    *Name,
+  IN  UINT64          Attributes,
+  OUT EXT4_DIR_ENTRY  *Entry
+  )
+{
+  EXT4_PARTITION    *Partition;
+  EXT4_TRANSACTION  Txn;
+  EXT4_INODE        *Inode;
+  EXT4_INODE        *ParentInode;
+  EXT4_INO_NR       InodeNum;
+  EXT4_BLOCK_NR     Block;
+  EFI_STATUS        Status;
+  CHAR8             *Utf8Name;
+  UINTN             NameLength;
+  UINT8             *Buffer;
+  UINT8             *Data;
+  BOOLEAN           IsDir;
+
+  Partition   = Directory->Partition;
+  IsDir       = (Attributes & EFI_FILE_DIRECTORY) != 0;
+  Inode       = NULL;
+  ParentInode = NULL;
+  Buffer      = NULL;
+
+  if (Partition->ReadOnly) {
+    return EFI_WRITE_PROTECTED;
+  }
+
+  if (  EXT4_HAS_INLINE_DATA (Directory->Inode)
+     || !EXT4_HAS_INCOMPAT (Partition, EXT4_FEATURE_INCOMPAT_EXTENTS))
+  {
+    return EFI_UNSUPPORTED;
+  }
+
+  // Without DIR_NLINK, a directory can't have more subdirectories than links
+  if (  IsDir && (Directory->Inode->i_links >= EXT4_LINK_MAX - 1)
+     && !EXT4_HAS_RO_COMPAT (Partition, EXT4_FEATURE_RO_COMPAT_DIR_NLINK))
+  {
+    return EFI_UNSUPPORTED;
+  }
+
+  Status = Ext4GetUtf8Name (Name, &Utf8Name, &NameLength);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Buffer      = AllocatePool (Partition->BlockSize);
+  Inode       = AllocatePool (Partition->InodeSize);
+  ParentInode = AllocatePool (Partition->InodeSize);
+
+  if ((Buffer == NULL) || (Inode == NULL) || (ParentInode == NULL)) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Out;
+  }
+
+  // This may append a block to the directory, in a transaction of its own
+  Status = Ext4FindDirBlockWithRoom (Partition, Directory, Utf8Name, NameLength, Buffer, &Block);
+
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  CopyMem (ParentInode, Directory->Inode, Partition->InodeSize);
+
+  Status = Ext4BeginTransaction (Partition, &Txn);
+
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  Status = Ext4AllocateInodeNr (&Txn, Directory->InodeNum, IsDir, &InodeNum);
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4InitInode (&Txn, InodeNum, Attributes, Inode);
+  }
+
+  if (!EFI_ERROR (Status) && IsDir) {
+    Status = Ext4InitDirectory (&Txn, InodeNum, Inode, Directory->InodeNum);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4TxnGetBlock (&Txn, Block, FALSE, &Data);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4AddDirBlockEntry (
+               Partition,
+               Data,
+               InodeNum,
+               Utf8Name,
+               NameLength,
+               IsDir ? EXT4_FT_DIR : EXT4_FT_REG_FILE,
+               Entry
+               );
+  }
+
+  if (EFI_ERROR (Status)) {
+    Ext4AbortTransaction (&Txn);
+    goto Out;
+  }
+
+  // Without the dir_index feature, a hash tree index can't be kept up to date
+  if (!EXT4_DIR_IS_INDEXED (Partition, ParentInode)) {
+    ParentInode->i_flags &= ~EXT4_INDEX_FL;
+  }
+
+  Ext4SetDirBlockTail (Partition, Directory->InodeNum, ParentInode, Data);
+
+  if (IsDir) {
+    // Directories with DIR_NLINK that overflowed their link count have 1 link
+    if (ParentInode->i_links >= EXT4_LINK_MAX - 1) {
+      ParentInode->i_links = 1;
+    } else if (ParentInode->i_links != 1) {
+      ParentInode->i_links++;
+    }
+  }
+
+  Ext4SetInodeTimes (ParentInode, EXT4_INODE_MTIME | EXT4_INODE_CTIME, NULL);
+
+  Status = Ext4TxnWriteInode (&Txn, Directory->InodeNum, ParentInode);
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4TxnWriteInode (&Txn, InodeNum, Inode);
+  }
+
+  if (EFI_ERROR (Status)) {
+    Ext4AbortTransaction (&Txn);
+    goto Out;
+  }
+
+  Status = Ext4CommitTransaction (&Txn);
+
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  Ext4RefreshOpenFiles (Partition, Directory->InodeNum, ParentInode);
+
+  // Lookups of the name may have been cached as not found
+  Ext4DentryCacheForgetDirectory (Partition, Directory->InodeNum);
+
+Out:
+  FreePool (Utf8Name);
+
+  if (Buffer != NULL) {
+    FreePool (Buffer);
+  }
+
+  if (Inode != NULL) {
+    FreePool (Inode);
+  }
+
+  if (ParentInode != NULL) {
+    FreePool (ParentInode);
+  }
+
+  return Status;
+}
+
+/**
+   Checks if a directory only has its "." and ".." entries.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Directory   Pointer to the opened directory.
+   @param[out]     Empty       TRUE if the directory is empty.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4DirIsEmpty (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *Directory,
+  OUT BOOLEAN         *Empty
+  )
+{
+  EXT4_DIR_ENTRY  *Entry;
+  EFI_STATUS      Status;
+  EXT4_BLOCK_NR   Block;
+  UINT32          Logical;
+  UINT32          NumberBlocks;
+  UINTN           Length;
+  UINTN           Position;
+  UINT8           *Buffer;
+  BOOLEAN         HasTail;
+
+  Buffer = AllocatePool (Partition->BlockSize);
+
+  if (Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  *Empty       = TRUE;
+  Status       = EFI_SUCCESS;
+  NumberBlocks = EXT4_HAS_INLINE_DATA (Directory->Inode) ? 1 :
+                 (UINT32)DivU64x32 (EXT4_INODE_SIZE (Directory->Inode), Partition->BlockSize);
+
+  for (Logical = 0; Logical < NumberBlocks && *Empty; Logical++) {
+    if (EXT4_HAS_INLINE_DATA (Directory->Inode)) {
+      Status = Ext4ReadInlineDirBlock (Partition, Directory, (CHAR8 *)Buffer);
+    } else {
+      Status = Ext4ReadDirBlock (Partition, Directory, Logical, Buffer, &Block);
+    }
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    Length = Ext4DirBlockEntriesLength (Partition, Buffer, &HasTail);
+
+    for (Position = 0; Position < Length; Position += Entry->rec_len) {
+      Entry = Ext4GetDirBlockEntry (Buffer, Position, Length);
+
+      if (Entry == NULL) {
+        Status = EFI_VOLUME_CORRUPTED;
+        break;
+      }
+
+      if (  (Entry->inode != 0)
+         && !((Entry->name_len == 1) && (Entry->name[0] == '.'))
+         && !((Entry->name_len == 2) && (Entry->name[0] == '.') && (Entry->name[1] == '.')))
+      {
+        *Empty = FALSE;
+        break;
+      }
+    }
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+  }
+
+  FreePool (Buffer);
+  return Status;
+}
+
+/**
+   Finds the directory entry of a file in its parent directory.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Parent      Pointer to the opened parent directory.
+   @param[in]      File        Pointer to the opened file.
+   @param[out]     Buffer      Pointer to a buffer of Partition->BlockSize bytes.
+   @param[out]     Block       Physical block that holds the entry.
+   @param[out]     Offset      Offset of the entry in the block.
+   @param[out]     Previous    Offset of the entry before it, or MAX_UINTN.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4FindFileEntry (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *Parent,
+  IN  EXT4_FILE       *File,
+  OUT UINT8           *Buffer,
+  OUT EXT4_BLOCK_NR   *Block,
+  OUT UINTN           *Offset,
+  OUT UINTN           *Previous
+  )
+{
+  EFI_STATUS  Status;
+  CHAR8       *Utf8Name;
+  UINTN       NameLength;
+  UINT32      Logical;
+  UINT32      NumberBlocks;
+
+  Status = Ext4GetUtf8Name (File->Dentry->Name, &Utf8Name, &NameLength);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // Look in the entry's leaf first, then everywhere
+  if (EXT4_DIR_IS_INDEXED (Partition, Parent->Inode)) {
+    Status = Ext4HtreeFindLeaf (Parent, Partition, Utf8Name, NameLength, &Logical);
+
+    if (!EFI_ERROR (Status)) {
+      Status = Ext4ReadDirBlock (Partition, Parent, Logical, Buffer, Block);
+    }
+
+    if (!EFI_ERROR (Status)) {
+      Status = Ext4FindDirBlockEntry (Partition, Buffer, Utf8Name, NameLength, File->InodeNum, Offset, Previous);
+    }
+
+    if (!EFI_ERROR (Status)) {
+      goto Out;
+    }
+  }
+
+  NumberBlocks = (UINT32)DivU64x32 (EXT4_INODE_SIZE (Parent->Inode), Partition->BlockSize);
+  Status       = EFI_NOT_FOUND;
+
+  for (Logical = 0; Logical < NumberBlocks; Logical++) {
+    Status = Ext4ReadDirBlock (Partition, Parent, Logical, Buffer, Block);
+
+    if (!EFI_ERROR (Status)) {
+      Status = Ext4FindDirBlockEntry (Partition, Buffer, Utf8Name, NameLength, File->InodeNum, Offset, Previous);
+    }
+
+    if (Status != EFI_NOT_FOUND) {
+      break;
+    }
+  }
+
+Out:
+  FreePool (Utf8Name);
+  return Status;
+}
+
+/**
+   Drops an inode's reference to its extended attribute block, and frees the
+   block once no inode refers to it.
+
+   @param[in out]  Txn         Pointer to the transaction.
+   @param[in out]  Inode       Pointer to the inode.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4ReleaseXattrBlock (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN OUT EXT4_INODE        *Inode
+  )
+{
+  EXT4_PARTITION           *Partition;
+  EXT4_XATTR_BLOCK_HEADER  *Header;
+  EXT4_BLOCK_NR            Block;
+  EFI_STATUS               Status;
+  UINT64                   LeBlock;
+  UINT32                   Zero;
+  UINT32                   Csum;
+  UINT8                    *Data;
+
+  Partition = Txn->Partition;
+  Block     = EXT4_BLOCK_NR_FROM_HALFS (Partition, Inode->i_file_acl, Inode->i_osd2.data_linux.l_i_file_acl_high);
+
+  if (Block == 0) {
+    return EFI_SUCCESS;
+  }
+
+  Status = Ext4TxnGetBlock (Txn, Block, FALSE, &Data);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Header = (EXT4_XATTR_BLOCK_HEADER *)Data;
+
+  if ((Header->h_magic != EXT4_XATTR_MAGIC) || (Header->h_refcount == 0)) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  if (Header->h_refcount == 1) {
+    Status = Ext4FreeBlocks (Txn, Block, 1);
+
+    if (!EFI_ERROR (Status)) {
+      Status = Ext4AddInodeBlocks (Partition, Inode, -1);
+    }
+  } else {
+    Header->h_refcount--;
+
+    // The checksum covers the block number, then the block with a zeroed checksum
+    if (EXT4_HAS_METADATA_CSUM (Partition)) {
+      LeBlock = Block;
+      Zero    = 0;
+      Csum    = Ext4CalculateChecksum (Partition, &LeBlock, sizeof (LeBlock), Partition->InitialSeed);
+      Csum    = Ext4CalculateChecksum (Partition, Data, OFFSET_OF (EXT4_XATTR_BLOCK_HEADER, h_checksum), Csum);
+      Csum    = Ext4CalculateChecksum (Partition, &Zero, sizeof (Zero), Csum);
+      Csum    = Ext4CalculateChecksum (
+                  Partition,
+                  Data + OFFSET_OF (EXT4_XATTR_BLOCK_HEADER, h_checksum) + sizeof (UINT32),
+                  Partition->BlockSize - OFFSET_OF (EXT4_XATTR_BLOCK_HEADER, h_checksum) - sizeof (UINT32),
+                  Csum
+                  );
+      Header->h_checksum = Csum;
+    }
+  }
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Inode->i_file_acl                          = 0;
+  Inode->i_osd2.data_linux.l_i_file_acl_high = 0;
+  return EFI_SUCCESS;
+}
+
+/**
+   Checks if a file is a symlink whose target is in i_data.
+
+   @param[in]      File        Pointer to the opened file.
+
+   @return TRUE if the file is a fast symlink, else FALSE.
+**/
+STATIC
+BOOLEAN
+Ext4IsFastSymlink (
+  IN EXT4_FILE  *File
+  )
+{
+  UINT32  XattrBlocks;
+
+  if (  !Ext4FileIsSymlink (File) || EXT4_HAS_INLINE_DATA (File->Inode)
+     || ((File->Inode->i_flags & EXT4_EXTENTS_FL) != 0))
+  {
+    return FALSE;
+  }
+
+  XattrBlocks = File->Inode->i_file_acl != 0 ? File->Partition->BlockSize >> 9 : 0;
+  return File->Inode->i_blocks == XattrBlocks;
+}
+
+/**
+   Removes the directory entry of a file, and frees the file once it has
+   no links left.
+
+   @param[in]      File          Pointer to the opened file, which must be
+                                 the file's only open handle.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4Unlink (
+  IN EXT4_FILE  *File
+  )
+{
+  EXT4_PARTITION    *Partition;
+  EXT4_TRANSACTION  Txn;
+  EXT4_FILE         *Parent;
+  EXT4_FILE         *Other;
+  EXT4_INODE        *Inode;
+  EXT4_INODE        *ParentInode;
+  EXT4_DIR_ENTRY    *Entry;
+  EXT4_DIR_ENTRY    *PreviousEntry;
+  EXT4_BLOCK_NR     Block;
+  LIST_ENTRY        *Node;
+  EFI_STATUS        Status;
+  UINTN             Offset;
+  UINTN             Previous;
+  UINT8             *Buffer;
+  UINT8             *Data;
+  BOOLEAN           IsDir;
+  BOOLEAN           Empty;
+
+  Partition   = File->Partition;
+  IsDir       = Ext4FileIsDir (File);
+  Parent      = NULL;
+  Inode       = NULL;
+  ParentInode = NULL;
+  Buffer      = NULL;
+
+  if (Partition->ReadOnly) {
+    return EFI_WRITE_PROTECTED;
+  }
+
+  if ((File->Dentry->Parent == NULL) || (File->InodeNum == EXT4_ROOT_INODE_NR)) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  BASE_LIST_FOR_EACH (Node, &Partition->OpenFiles) {
+    Other = EXT4_FILE_FROM_OPEN_FILES_NODE (Node);
+
+    if ((Other != File) && (Other->InodeNum == File->InodeNum)) {
+      return EFI_ACCESS_DENIED;
+    }
+  }
+
+  if (IsDir) {
+    Status = Ext4DirIsEmpty (Partition, File, &Empty);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    if (!Empty) {
+      return EFI_ACCESS_DENIED;
+    }
+  }
+
+  Status = Ext4OpenInode (Partition, File->Dentry->Parent->Inode, File->Dentry->Parent, &Parent);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (EXT4_HAS_INLINE_DATA (Parent->Inode)) {
+    Status = EFI_UNSUPPORTED;
+    goto Out;
+  }
+
+  Buffer      = AllocatePool (Partition->BlockSize);
+  Inode       = AllocatePool (Partition->InodeSize);
+  ParentInode = AllocatePool (Partition->InodeSize);
+
+  if ((Buffer == NULL) || (Inode == NULL) || (ParentInode == NULL)) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Out;
+  }
+
+  Status = Ext4FindFileEntry (Partition, Parent, File, Buffer, &Block, &Offset, &Previous);
+
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  // Large files take more than a transaction to free, and are emptied first
+  if (Ext4FileIsReg (File) && (File->Inode->i_links == 1) && !EXT4_HAS_INLINE_DATA (File->Inode)) {
+    Status = Ext4SetFileSize (File, 0);
+
+    if (EFI_ERROR (Status)) {
+      goto Out;
+    }
+  }
+
+  CopyMem (Inode, File->Inode, Partition->InodeSize);
+  CopyMem (ParentInode, Parent->Inode, Partition->InodeSize);
+
+  Status = Ext4BeginTransaction (Partition, &Txn);
+
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  Status = Ext4TxnGetBlock (&Txn, Block, FALSE, &Data);
+
+  if (EFI_ERROR (Status)) {
+    goto Abort;
+  }
+
+  // The entry's room goes to the entry before it
+  Entry = (EXT4_DIR_ENTRY *)(Data + Offset);
+
+  if (Previous != MAX_UINTN) {
+    PreviousEntry           = (EXT4_DIR_ENTRY *)(Data + Previous);
+    PreviousEntry->rec_len += Entry->rec_len;
+  } else {
+    Entry->inode = 0;
+  }
+
+  Ext4SetDirBlockTail (Partition, Parent->InodeNum, ParentInode, Data);
+
+  // A directory's own "." entry is its other link
+  Inode->i_links = IsDir ? 0 : Inode->i_links - 1;
+
+  if (Inode->i_links == 0) {
+    if (!Ext4IsFastSymlink (File)) {
+      Status = Ext4TxnFreeFileBlocks (&Txn, File, Inode);
+    }
+
+    if (!EFI_ERROR (Status)) {
+      Status = Ext4ReleaseXattrBlock (&Txn, Inode);
+    }
+
+    if (!EFI_ERROR (Status)) {
+      Status = Ext4FreeInodeNr (&Txn, File->InodeNum, IsDir);
+    }
+
+    if (EFI_ERROR (Status)) {
+      goto Abort;
+    }
+
+    Inode->i_size_lo = 0;
+    Inode->i_size_hi = 0;
+    Ext4SetInodeTimes (Inode, EXT4_INODE_CTIME | EXT4_INODE_DTIME, NULL);
+  } else {
+    Ext4SetInodeTimes (Inode, EXT4_INODE_CTIME, NULL);
+  }
+
+  // Directories whose link count overflowed keep 1 link
+  if (IsDir && (ParentInode->i_links > 2)) {
+    ParentInode->i_links--;
+  }
+
+  Ext4SetInodeTimes (ParentInode, EXT4_INODE_MTIME | EXT4_INODE_CTIME, NULL);
+
+  Status = Ext4TxnWriteInode (&Txn, File->InodeNum, Inode);
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4TxnWriteInode (&Txn, Parent->InodeNum, ParentInode);
+  }
+
+  if (EFI_ERROR (Status)) {
+    goto Abort;
+  }
+
+  Status = Ext4CommitTransaction (&Txn);
+
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  Ext4RefreshOpenFiles (Partition, Parent->InodeNum, ParentInode);
+  Ext4RefreshOpenFiles (Partition, File->InodeNum, Inode);
+  Ext4DentryCacheForgetDirectory (Partition, Parent->InodeNum);
+
+  if (IsDir) {
+    Ext4DentryCacheForgetDirectory (Partition, File->InodeNum);
+  }
+
+  goto Out;
+
+Abort:
+  Ext4AbortTransaction (&Txn);
+
+Out:
+  if (Buffer != NULL) {
+    FreePool (Buffer);
+  }
+
+  if (Inode != NULL) {
+    FreePool (Inode);
+  }
+
+  if (ParentInode != NULL) {
+    FreePool (ParentInode);
+  }
+
+  Ext4CloseInternal (Parent);
+  return Status;
+}
@@ -90,120 +90,263 @@ Ext4ValidDirent (
 }
 
 /**
-   Retrieves a directory entry.
+   Searches a directory block for an entry.
 
-   @param[in]      Directory   Pointer to the opened directory.
-   @param[in]      NameUnicode Pointer to the UCS-2 formatted filename.
    @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Block       Pointer to the directory block, Partition->BlockSize bytes long.
+   @param[in]      Name        Pointer to the UCS-2 formatted filename.
    @param[out]     Result      Pointer to the destination directory entry.
 
-   @return The result of the operation.
+   @retval EFI_SUCCESS            The entry was found and copied to Result.
+   @retval EFI_NOT_FOUND          The block does not hold the entry.
+   @retval EFI_VOLUME_CORRUPTED   The block is corrupted.
+   @retval !EFI_SUCCESS           Failure.
 **/
 EFI_STATUS
-Ext4RetrieveDirent (
-  IN EXT4_FILE        *Directory,
-  IN CONST CHAR16     *Name,
-  IN EXT4_PARTITION   *Partition,
+Ext4SearchDirBlock (
+  IN  EXT4_PARTITION  *Partition,
+  IN  CONST CHAR8     *Block,
+  IN  CONST CHAR16    *Name,
   OUT EXT4_DIR_ENTRY  *Result
   )
 {
   EFI_STATUS      Status;
-  CHAR8           *Buf;
-  UINT64          Off;
-  EXT4_INODE      *Inode;
-  UINT64          DirInoSize;
-  UINT32          BlockRemainder;
-  UINTN           Length;
   EXT4_DIR_ENTRY  *Entry;
   UINTN           RemainingBlock;
   CHAR16          DirentUcs2Name[EXT4_NAME_MAX + 1];
   UINTN           ToCopy;
   UINTN           BlockOffset;
 
-  Buf = AllocatePool (Partition->BlockSize);
+  for (BlockOffset = 0; BlockOffset < Partition->BlockSize; ) {
+    Entry          = (EXT4_DIR_ENTRY *)(Block + BlockOffset);
+    RemainingBlock = Partition->BlockSize - BlockOffset;
+    // Check if the minimum directory entry fits inside [BlockOffset, EndOfBlock]
+    if (RemainingBlock < EXT4_MIN_DIR_ENTRY_LEN) {
+      return EFI_VOLUME_CORRUPTED;
+    }
 
-  if (Buf == NULL) {
-    return EFI_OUT_OF_RESOURCES;
+    if (!Ext4ValidDirent (Entry)) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    if ((Entry->name_len > RemainingBlock) || (Entry->rec_len > RemainingBlock)) {
+      // Corrupted filesystem
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    // Unused entry
+    if (Entry->inode == 0) {
+      BlockOffset += Entry->rec_len;
+      continue;
+    }
+
+    Status = Ext4GetUcs2DirentName (Entry, DirentUcs2Name);
+
+    /* In theory, this should never fail.
+     * In reality, it's quite possible that it can fail, considering filenames in
+     * Linux (and probably other nixes) are just null-terminated bags of bytes, and don't
+     * need to form valid ASCII/UTF-8 sequences.
+     */
+    if (EFI_ERROR (Status)) {
+      if (Status == EFI_INVALID_PARAMETER) {
+        // If we error out due to a bad UTF-8 sequence (see Ext4GetUcs2DirentName), skip this entry.
+        // I'm not sure if this is correct behaviour, but I don't think there's a precedent here.
+        BlockOffset += Entry->rec_len;
+        continue;
+      }
+
+      // Other sorts of errors should just error out.
+      return Status;
+    }
+
+    if ((Entry->name_len == StrLen (Name)) &&
+        !Ext4StrCmpInsensitive (DirentUcs2Name, (CHAR16 *)Name))
+    {
+      ToCopy = MIN (Entry->rec_len, sizeof (EXT4_DIR_ENTRY));
+
+      CopyMem (Result, Entry, ToCopy);
+      return EFI_SUCCESS;
+    }
+
+    BlockOffset += Entry->rec_len;
   }
 
-  Off = 0;
+  return EFI_NOT_FOUND;
+}
+
+/**
+   Checks if a name can only match directory entries that have the exact same
+   bytes, in which case a failed hashed lookup needs no linear scan.
 
-  Inode      = Directory->Inode;
-  DirInoSize = EXT4_INODE_SIZE (Inode);
+   @param[in]      Name        Pointer to the UCS-2 formatted filename.
 
-  DivU64x32Remainder (DirInoSize, Partition->BlockSize, &BlockRemainder);
+   @return TRUE if Name has no character that case-insensitive matching could fold.
+**/
+STATIC
+BOOLEAN
+Ext4NameIsCaseInvariant (
+  IN CONST CHAR16  *Name
+  )
+{
+  for ( ; *Name != L'\0'; Name++) {
+    if ((*Name >= 0x80) || ((*Name >= L'a') && (*Name <= L'z')) || ((*Name >= L'A') && (*Name <= L'Z'))) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+   Gets the size of a directory, as seen by Ext4ReadDirectoryBlock().
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Directory   Pointer to the open directory.
+   @param[out]     Size        Size of the directory, a multiple of the block size.
+
+   @retval EFI_SUCCESS            Size was set.
+   @retval EFI_VOLUME_CORRUPTED   The directory's size isn't block aligned.
+**/
+STATIC
+EFI_STATUS
+Ext4GetDirectorySize (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *Directory,
+  OUT UINT64          *Size
+  )
+{
+  UINT32  BlockRemainder;
+
+  // Inline directories are presented as a single block
+  if (EXT4_HAS_INLINE_DATA (Directory->Inode)) {
+    *Size = Partition->BlockSize;
+    return EFI_SUCCESS;
+  }
+
+  *Size = EXT4_INODE_SIZE (Directory->Inode);
+
+  DivU64x32Remainder (*Size, Partition->BlockSize, &BlockRemainder);
   if (BlockRemainder != 0) {
     // Directory inodes need to have block aligned sizes
-    Status = EFI_VOLUME_CORRUPTED;
-    goto Out;
+    return EFI_VOLUME_CORRUPTED;
   }
 
-  while (Off < DirInoSize) {
-    Length = Partition->BlockSize;
+  return EFI_SUCCESS;
+}
 
-    Status = Ext4Read (Partition, Directory, Buf, Off, &Length);
+/**
+   Reads a block of a directory, whether it's stored in data blocks or inline.
 
-    if (Status != EFI_SUCCESS) {
-      goto Out;
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Directory   Pointer to the open directory.
+   @param[in]      Offset      Block aligned offset in the directory.
+   @param[out]     Block       Pointer to a buffer of Partition->BlockSize bytes.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4ReadDirectoryBlock (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *Directory,
+  IN  UINT64          Offset,
+  OUT CHAR8           *Block
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Length;
+
+  if (EXT4_HAS_INLINE_DATA (Directory->Inode)) {
+    return Ext4ReadInlineDirBlock (Partition, Directory, Block);
+  }
+
+  Length = Partition->BlockSize;
+  Status = Ext4Read (Partition, Directory, Block, Offset, &Length);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (Length != Partition->BlockSize) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Looks a directory entry up on the disk.
+
+   Indexed directories are looked up through their hash tree first. As the
+   index is keyed on the exact on-disk bytes of the name, names that only
+   match case-insensitively, directories with an unsupported or corrupted
+   index and the rest fall back to a linear scan of every block.
+
+   @param[in]      Directory   Pointer to the opened directory.
+   @param[in]      NameUnicode Pointer to the UCS-2 formatted filename.
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[out]     Result      Pointer to the destination directory entry.
+
+   @return The result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4LookupDirentOnDisk (
+  IN EXT4_FILE        *Directory,
+  IN CONST CHAR16     *Name,
+  IN EXT4_PARTITION   *Partition,
+  OUT EXT4_DIR_ENTRY  *Result
+  )
+{
+  EFI_STATUS  Status;
+  CHAR8       *Buf;
+  UINT64      Off;
+  EXT4_INODE  *Inode;
+  UINT64      DirInoSize;
+
+  Inode = Directory->Inode;
+
+  if (EXT4_DIR_IS_INDEXED (Partition, Inode)) {
+    Status = Ext4HtreeRetrieveDirent (Directory, Name, Partition, Result);
+
+    if ((Status == EFI_SUCCESS) || ((Status == EFI_NOT_FOUND) && Ext4NameIsCaseInvariant (Name))) {
+      return Status;
     }
 
-    for (BlockOffset = 0; BlockOffset < Partition->BlockSize; ) {
-      Entry          = (EXT4_DIR_ENTRY *)(Buf + BlockOffset);
-      RemainingBlock = Partition->BlockSize - BlockOffset;
-      // Check if the minimum directory entry fits inside [BlockOffset, EndOfBlock]
-      if (RemainingBlock < EXT4_MIN_DIR_ENTRY_LEN) {
-        Status = EFI_VOLUME_CORRUPTED;
-        goto Out;
-      }
+    if ((Status != EFI_NOT_FOUND) && (Status != EFI_VOLUME_CORRUPTED) && (Status != EFI_UNSUPPORTED)) {
+      return Status;
+    }
 
-      if (!Ext4ValidDirent (Entry)) {
-        Status = EFI_VOLUME_CORRUPTED;
-        goto Out;
-      }
+    if (Status != EFI_NOT_FOUND) {
+      DEBUG ((DEBUG_WARN, "[ext4] Hashed lookup of %s failed (%r), scanning the directory\n", Name, Status));
+    }
+  }
 
-      if ((Entry->name_len > RemainingBlock) || (Entry->rec_len > RemainingBlock)) {
-        // Corrupted filesystem
-        Status = EFI_VOLUME_CORRUPTED;
-        goto Out;
-      }
+  Buf = AllocatePool (Partition->BlockSize);
 
-      // Unused entry
-      if (Entry->inode == 0) {
-        BlockOffset += Entry->rec_len;
-        continue;
-      }
+  if (Buf == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
 
-      Status = Ext4GetUcs2DirentName (Entry, DirentUcs2Name);
-
-      /* In theory, this should never fail.
-       * In reality, it's quite possible that it can fail, considering filenames in
-       * Linux (and probably other nixes) are just null-terminated bags of bytes, and don't
-       * need to form valid ASCII/UTF-8 sequences.
-       */
-      if (EFI_ERROR (Status)) {
-        if (Status == EFI_INVALID_PARAMETER) {
-          // If we error out due to a bad UTF-8 sequence (see Ext4GetUcs2DirentName), skip this entry.
-          // I'm not sure if this is correct behaviour, but I don't think there's a precedent here.
-          BlockOffset += Entry->rec_len;
-          continue;
-        }
-
-        // Other sorts of errors should just error out.
-        FreePool (Buf);
-        return Status;
-      }
+  Off = 0;
 
-      if ((Entry->name_len == StrLen (Name)) &&
-          !Ext4StrCmpInsensitive (DirentUcs2Name, (CHAR16 *)Name))
-      {
-        ToCopy = MIN (Entry->rec_len, sizeof (EXT4_DIR_ENTRY));
+  Status = Ext4GetDirectorySize (Partition, Directory, &DirInoSize);
 
-        CopyMem (Result, Entry, ToCopy);
-        Status = EFI_SUCCESS;
-        goto Out;
-      }
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
 
-      BlockOffset += Entry->rec_len;
+  while (Off < DirInoSize) {
+    Status = Ext4ReadDirectoryBlock (Partition, Directory, Off, Buf);
+
+    if (Status != EFI_SUCCESS) {
+      goto Out;
+    }
+
+    Status = Ext4SearchDirBlock (Partition, Buf, Name, Result);
+
+    if (Status != EFI_NOT_FOUND) {
+      goto Out;
     }
 
     Off += Partition->BlockSize;
@@ -216,6 +359,47 @@ Out:
   return Status;
 }
 
+/**
+   Retrieves a directory entry.
+
+   Lookups go through the partition's dentry cache first; names that aren't
+   cached are looked up on the disk, and the outcome is cached, whether the
+   name exists or not.
+
+   @param[in]      Directory   Pointer to the opened directory.
+   @param[in]      NameUnicode Pointer to the UCS-2 formatted filename.
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[out]     Result      Pointer to the destination directory entry.
+
+   @return The result of the operation.
+**/
+EFI_STATUS
+Ext4RetrieveDirent (
+  IN EXT4_FILE        *Directory,
+  IN CONST CHAR16     *Name,
+  IN EXT4_PARTITION   *Partition,
+  OUT EXT4_DIR_ENTRY  *Result
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = Ext4DentryCacheLookup (Partition, Directory->InodeNum, Name, Result);
+
+  if (Status != EFI_NO_MAPPING) {
+    return Status;
+  }
+
+  Status = Ext4LookupDirentOnDisk (Directory, Name, Partition, Result);
+
+  if (Status == EFI_SUCCESS) {
+    Ext4DentryCacheInsert (Partition, Directory->InodeNum, Name, Result);
+  } else if (Status == EFI_NOT_FOUND) {
+    Ext4DentryCacheInsert (Partition, Directory->InodeNum, Name, NULL);
+  }
+
+  return Status;
+}
+
 /**
    Opens a file using a directory entry.
 
@@ -278,6 +462,8 @@ Ext4OpenDirent (
       Status = EFI_OUT_OF_RESOURCES;
       goto Error;
     }
+
+    File->Dentry->Inode = Entry->inode;
   }
 
   Status = Ext4InitExtentsMap (File);
@@ -428,138 +614,390 @@ Ext4OpenVolume (
 }
 
 /**
-   Reads a directory entry.
+   Opens a file by inode number, for the driver's own use.
 
    @param[in]      Partition   Pointer to the ext4 partition.
-   @param[in]      File        Pointer to the open directory.
-   @param[out]     Buffer      Pointer to the output buffer.
-   @param[in]      Offset      Initial directory position.
-   @param[in out] OutLength    Pointer to a UINTN that contains the length of the buffer,
-                               and the length of the actual EFI_FILE_INFO after the call.
+   @param[in]      InodeNum    Inode number of the file.
+   @param[in]      Dentry      Directory entry of the file, or NULL if the
+                               file has no name (e.g. the journal).
+   @param[out]     OutFile     Pointer to the opened file, which must be
+                               closed with Ext4CloseInternal().
 
    @return Result of the operation.
 **/
 EFI_STATUS
-Ext4ReadDir (
-  IN EXT4_PARTITION  *Partition,
-  IN EXT4_FILE       *File,
-  OUT VOID           *Buffer,
-  IN UINT64          Offset,
-  IN OUT UINTN       *OutLength
+Ext4OpenInode (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_INO_NR     InodeNum,
+  IN  EXT4_DENTRY     *Dentry OPTIONAL,
+  OUT EXT4_FILE       **OutFile
   )
 {
-  EXT4_INODE      *DirIno;
-  EFI_STATUS      Status;
-  UINT64          DirInoSize;
-  UINTN           Len;
-  UINT32          BlockRemainder;
-  EXT4_DIR_ENTRY  Entry;
-  EXT4_FILE       *TempFile;
-  BOOLEAN         ShouldSkip;
-  BOOLEAN         IsDotOrDotDot;
-  CHAR16          DirentUcs2Name[EXT4_NAME_MAX + 1];
+  EXT4_FILE   *File;
+  EFI_STATUS  Status;
 
-  DirIno     = File->Inode;
-  Status     = EFI_SUCCESS;
-  DirInoSize = EXT4_INODE_SIZE (DirIno);
+  File = AllocateZeroPool (sizeof (EXT4_FILE));
 
-  DivU64x32Remainder (DirInoSize, Partition->BlockSize, &BlockRemainder);
-  if (BlockRemainder != 0) {
-    // Directory inodes need to have block aligned sizes
-    return EFI_VOLUME_CORRUPTED;
+  if (File == NULL) {
+    return EFI_OUT_OF_RESOURCES;
   }
 
-  while (TRUE) {
-    TempFile = NULL;
+  Status = Ext4ReadInode (Partition, InodeNum, &File->Inode);
+
+  if (EFI_ERROR (Status)) {
+    FreePool (File);
+    return Status;
+  }
 
-    // We (try to) read the maximum size of a directory entry at a time
-    // Note that we don't need to read any padding that may exist after it.
-    Len    = sizeof (Entry);
-    Status = Ext4Read (Partition, File, &Entry, Offset, &Len);
+  File->InodeNum = InodeNum;
 
-    if (EFI_ERROR (Status)) {
-      goto Out;
+  if (Dentry != NULL) {
+    Ext4RefDentry (Dentry);
+  } else {
+    Dentry = Ext4CreateDentry (L"", NULL);
+
+    if (Dentry == NULL) {
+      FreePool (File->Inode);
+      FreePool (File);
+      return EFI_OUT_OF_RESOURCES;
     }
 
-    if (Len == 0) {
-      *OutLength = 0;
-      Status     = EFI_SUCCESS;
-      goto Out;
+    Dentry->Inode = InodeNum;
+  }
+
+  File->Dentry = Dentry;
+
+  Status = Ext4InitExtentsMap (File);
+
+  if (EFI_ERROR (Status)) {
+    Ext4UnrefDentry (File->Dentry);
+    FreePool (File->Inode);
+    FreePool (File);
+    return Status;
+  }
+
+  Ext4SetupFile (File, Partition);
+  InsertTailList (&Partition->OpenFiles, &File->OpenFilesListNode);
+
+  *OutFile = File;
+  return EFI_SUCCESS;
+}
+
+/**
+   Frees the inodes of a decoded directory block, and forgets the block.
+
+   @param[in out]  DirBlock    Pointer to the decoded directory block.
+**/
+STATIC
+VOID
+Ext4ResetReadDirBlock (
+  IN OUT EXT4_READDIR_BLOCK  *DirBlock
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < DirBlock->Count; Index++) {
+    if (DirBlock->Inodes[Index] != NULL) {
+      FreePool (DirBlock->Inodes[Index]);
     }
+  }
 
-    if (Len < EXT4_MIN_DIR_ENTRY_LEN) {
-      Status = EFI_VOLUME_CORRUPTED;
-      goto Out;
+  DirBlock->Count  = 0;
+  DirBlock->Offset = MAX_UINT64;
+}
+
+/**
+   Frees the directory block decoded by Ext4ReadDir, if any.
+
+   @param[in out]  File        Pointer to the open directory.
+**/
+VOID
+Ext4FreeReadDirBlock (
+  IN OUT EXT4_FILE  *File
+  )
+{
+  if (File->ReadDirBlock == NULL) {
+    return;
+  }
+
+  Ext4ResetReadDirBlock (File->ReadDirBlock);
+  FreePool (File->ReadDirBlock);
+  File->ReadDirBlock = NULL;
+}
+
+/**
+   Allocates the structure that holds the blocks decoded by Ext4ReadDir.
+   Everything is carved out of a single allocation, sized for the worst case
+   of a block full of minimal entries.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+
+   @return Pointer to the new structure, or NULL if out of memory.
+**/
+STATIC
+EXT4_READDIR_BLOCK *
+Ext4AllocateReadDirBlock (
+  IN EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_READDIR_BLOCK  *DirBlock;
+  UINTN               MaxEntries;
+  UINT8               *Buffer;
+
+  MaxEntries = Partition->BlockSize / EXT4_MIN_DIR_ENTRY_LEN;
+
+  // Names take at most one UCS-2 character per byte of the block, plus their terminators
+  DirBlock = AllocatePool (
+               sizeof (EXT4_READDIR_BLOCK) +
+               MaxEntries * (sizeof (EXT4_READDIR_ENTRY) + sizeof (EXT4_INODE *) + sizeof (EXT4_INO_NR)) +
+               (Partition->BlockSize + MaxEntries) * sizeof (CHAR16) +
+               Partition->BlockSize
+               );
+
+  if (DirBlock == NULL) {
+    return NULL;
+  }
+
+  // Carve the arrays in order of decreasing alignment
+  Buffer              = (UINT8 *)(DirBlock + 1);
+  DirBlock->Entries   = (EXT4_READDIR_ENTRY *)Buffer;
+  Buffer             += MaxEntries * sizeof (EXT4_READDIR_ENTRY);
+  DirBlock->Inodes    = (EXT4_INODE **)Buffer;
+  Buffer             += MaxEntries * sizeof (EXT4_INODE *);
+  DirBlock->InodeNums = (EXT4_INO_NR *)Buffer;
+  Buffer             += MaxEntries * sizeof (EXT4_INO_NR);
+  DirBlock->Names     = (CHAR16 *)Buffer;
+  Buffer             += (Partition->BlockSize + MaxEntries) * sizeof (CHAR16);
+  DirBlock->Data      = (CHAR8 *)Buffer;
+
+  DirBlock->Count  = 0;
+  DirBlock->Offset = MAX_UINT64;
+
+  return DirBlock;
+}
+
+/**
+   Reads and decodes a directory block for Ext4ReadDir.
+
+   Every entry of the block that ReadDir() reports is decoded at once, and the
+   inodes of those entries are read in a single batch, so that each block of
+   the inode tables is read once. The result is kept on the directory's handle
+   and reused by the following calls, until they move on to another block.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in out]  Directory   Pointer to the open directory.
+   @param[in]      Offset      Offset of the block in the directory.
+   @param[out]     OutBlock    Pointer to the decoded block.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4GetReadDirBlock (
+  IN     EXT4_PARTITION      *Partition,
+  IN OUT EXT4_FILE           *Directory,
+  IN     UINT64              Offset,
+  OUT    EXT4_READDIR_BLOCK  **OutBlock
+  )
+{
+  EXT4_READDIR_BLOCK  *DirBlock;
+  EXT4_READDIR_ENTRY  *ReadDirEntry;
+  EXT4_DIR_ENTRY      *Entry;
+  CHAR16              *Name;
+  CHAR16              DirentUcs2Name[EXT4_NAME_MAX + 1];
+  UINTN               BlockOffset;
+  UINTN               RemainingBlock;
+  UINTN               Length;
+  BOOLEAN             IsDotOrDotDot;
+  EFI_STATUS          Status;
+
+  DirBlock = Directory->ReadDirBlock;
+
+  if (  (DirBlock != NULL)
+     && (DirBlock->Offset == Offset)
+     && (DirBlock->MediaId == EXT4_MEDIA_ID (Partition)))
+  {
+    *OutBlock = DirBlock;
+    return EFI_SUCCESS;
+  }
+
+  if (DirBlock == NULL) {
+    DirBlock = Ext4AllocateReadDirBlock (Partition);
+
+    if (DirBlock == NULL) {
+      return EFI_OUT_OF_RESOURCES;
     }
 
-    // Invalid directory entry length
-    if (!Ext4ValidDirent (&Entry)) {
-      DEBUG ((DEBUG_ERROR, "[ext4] Invalid dirent at offset %lu\n", Offset));
+    Directory->ReadDirBlock = DirBlock;
+  } else {
+    Ext4ResetReadDirBlock (DirBlock);
+  }
+
+  Status = Ext4ReadDirectoryBlock (Partition, Directory, Offset, DirBlock->Data);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Name = DirBlock->Names;
+
+  for (BlockOffset = 0; BlockOffset < Partition->BlockSize; BlockOffset += Entry->rec_len) {
+    Entry          = (EXT4_DIR_ENTRY *)(DirBlock->Data + BlockOffset);
+    RemainingBlock = Partition->BlockSize - BlockOffset;
+
+    // Check if the minimum directory entry fits inside [BlockOffset, EndOfBlock]
+    if (RemainingBlock < EXT4_MIN_DIR_ENTRY_LEN) {
       Status = EFI_VOLUME_CORRUPTED;
-      goto Out;
+      goto Error;
     }
 
-    // Check if the entire dir entry length fits in Len
-    if (Len < (UINTN)(EXT4_MIN_DIR_ENTRY_LEN + Entry.name_len)) {
+    // Invalid directory entry length
+    if (!Ext4ValidDirent (Entry) || (Entry->rec_len > RemainingBlock)) {
+      DEBUG ((DEBUG_ERROR, "[ext4] Invalid dirent at offset %lu\n", Offset + BlockOffset));
       Status = EFI_VOLUME_CORRUPTED;
-      goto Out;
+      goto Error;
     }
 
     // We don't care about passing . or .. entries to the caller of ReadDir(),
     // since they're generally useless entries *and* may break things if too
     // many callers assume FAT32.
 
-    // Entry.name_len may be 0 if it's a nameless entry, like an unused entry
+    // Entry->name_len may be 0 if it's a nameless entry, like an unused entry
     // or a checksum at the end of the directory block.
     // memcmp (and CompareMem) return 0 when the passed length is 0.
 
     // We must bound name_len as > 0 and <= 2 to avoid any out-of-bounds accesses or bad detection of
     // "." and "..".
-    IsDotOrDotDot = Entry.name_len > 0 && Entry.name_len <= 2 &&
-                    CompareMem (Entry.name, "..", Entry.name_len) == 0;
+    IsDotOrDotDot = Entry->name_len > 0 && Entry->name_len <= 2 &&
+                    CompareMem (Entry->name, "..", Entry->name_len) == 0;
 
     // When inode = 0, it's unused. When name_len == 0, it's a nameless entry
     // (which we should not expose to ReadDir).
-    ShouldSkip = Entry.inode == 0 || Entry.name_len == 0 || IsDotOrDotDot;
-
-    if (ShouldSkip) {
-      Offset += Entry.rec_len;
+    if ((Entry->inode == 0) || (Entry->name_len == 0) || IsDotOrDotDot) {
       continue;
     }
 
-    // Test if the dirent is valid utf-8. This is already done inside Ext4OpenDirent but EFI_INVALID_PARAMETER
-    // has the danger of its meaning being overloaded in many places, so we can't skip according to that.
-    // So test outside of it, explicitly.
-    Status = Ext4GetUcs2DirentName (&Entry, DirentUcs2Name);
+    Status = Ext4GetUcs2DirentName (Entry, DirentUcs2Name);
 
     if (EFI_ERROR (Status)) {
       if (Status == EFI_INVALID_PARAMETER) {
         // Bad UTF-8, skip.
-        Offset += Entry.rec_len;
         continue;
       }
 
-      goto Out;
+      goto Error;
     }
 
-    Status = Ext4OpenDirent (Partition, EFI_FILE_MODE_READ, &TempFile, &Entry, File);
+    ReadDirEntry             = &DirBlock->Entries[DirBlock->Count];
+    ReadDirEntry->Offset     = Offset + BlockOffset;
+    ReadDirEntry->NextOffset = ReadDirEntry->Offset + Entry->rec_len;
+    ReadDirEntry->Name       = Name;
+
+    Length = StrLen (DirentUcs2Name) + 1;
+    CopyMem (Name, DirentUcs2Name, Length * sizeof (CHAR16));
+    Name += Length;
+
+    DirBlock->InodeNums[DirBlock->Count] = Entry->inode;
+    DirBlock->Count++;
+  }
+
+  // Reading ahead is an optimisation; inodes it couldn't get are read on demand.
+  Ext4ReadInodes (Partition, DirBlock->Count, DirBlock->InodeNums, DirBlock->Inodes);
+
+  DirBlock->Offset  = Offset;
+  DirBlock->MediaId = EXT4_MEDIA_ID (Partition);
+
+  *OutBlock = DirBlock;
+  return EFI_SUCCESS;
+
+Error:
+  // No inode was read yet, forget the entries decoded so far
+  DirBlock->Count = 0;
+  return Status;
+}
+
+/**
+   Reads a directory entry.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      File        Pointer to the open directory.
+   @param[out]     Buffer      Pointer to the output buffer.
+   @param[in]      Offset      Initial directory position.
+   @param[in out] OutLength    Pointer to a UINTN that contains the length of the buffer,
+                               and the length of the actual EFI_FILE_INFO after the call.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4ReadDir (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_FILE       *File,
+  OUT VOID           *Buffer,
+  IN UINT64          Offset,
+  IN OUT UINTN       *OutLength
+  )
+{
+  EFI_STATUS          Status;
+  UINT64              DirInoSize;
+  UINT64              BlockStart;
+  UINT32              BlockRemainder;
+  UINTN               Index;
+  EXT4_READDIR_BLOCK  *DirBlock;
+  EXT4_FILE           Child;
+
+  Status = Ext4GetDirectorySize (Partition, File, &DirInoSize);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  while (TRUE) {
+    DivU64x32Remainder (Offset, Partition->BlockSize, &BlockRemainder);
+    BlockStart = Offset - BlockRemainder;
+
+    if (BlockStart >= DirInoSize) {
+      *OutLength = 0;
+      return EFI_SUCCESS;
+    }
+
+    Status = Ext4GetReadDirBlock (Partition, File, BlockStart, &DirBlock);
 
     if (EFI_ERROR (Status)) {
-      goto Out;
+      return Status;
+    }
+
+    for (Index = 0; Index < DirBlock->Count; Index++) {
+      if (DirBlock->Entries[Index].Offset >= Offset) {
+        break;
+      }
     }
 
-    Status = Ext4GetFileInfo (TempFile, Buffer, OutLength);
-    if (!EFI_ERROR (Status)) {
-      File->Position = Offset + Entry.rec_len;
+    if (Index < DirBlock->Count) {
+      break;
     }
 
-    Ext4CloseInternal (TempFile);
+    Offset = BlockStart + Partition->BlockSize;
+  }
+
+  if (DirBlock->Inodes[Index] == NULL) {
+    Status = Ext4ReadInode (Partition, DirBlock->InodeNums[Index], &DirBlock->Inodes[Index]);
 
-    goto Out;
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  // Describing an entry only takes its inode, there's no need to open it.
+  ZeroMem (&Child, sizeof (Child));
+  Child.Inode     = DirBlock->Inodes[Index];
+  Child.InodeNum  = DirBlock->InodeNums[Index];
+  Child.Partition = Partition;
+
+  Status = Ext4GetFileInfoWithName (&Child, DirBlock->Entries[Index].Name, Buffer, OutLength);
+  if (!EFI_ERROR (Status)) {
+    File->Position = DirBlock->Entries[Index].NextOffset;
   }
 
-  Status = EFI_SUCCESS;
-Out:
   return Status;
 }
 
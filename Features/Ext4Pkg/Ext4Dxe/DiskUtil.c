@@ -121,3 +121,45 @@ Ext4AllocAndReadBlocks (
 
   return Buf;
 }
+
+/**
+   Writes to the partition's disk using the DISK_IO protocol.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Buffer         Pointer to a source buffer.
+   @param[in]  Length         Length of the source buffer.
+   @param[in]  Offset         Offset, in bytes, of the location to write.
+
+   @return Success status of the disk write.
+**/
+EFI_STATUS
+Ext4WriteDiskIo (
+  IN EXT4_PARTITION  *Partition,
+  IN CONST VOID      *Buffer,
+  IN UINTN           Length,
+  IN UINT64          Offset
+  )
+{
+  return EXT4_DISK_IO (Partition)->WriteDisk (
+                                     EXT4_DISK_IO (Partition),
+                                     EXT4_MEDIA_ID (Partition),
+                                     Offset,
+                                     Length,
+                                     (VOID *)Buffer
+                                     );
+}
+
+/**
+   Flushes the writes of the partition to the media.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+
+   @return Success status of the flush.
+**/
+EFI_STATUS
+Ext4FlushDisk (
+  IN EXT4_PARTITION  *Partition
+  )
+{
+  return EXT4_BLOCK_IO (Partition)->FlushBlocks (EXT4_BLOCK_IO (Partition));
+}
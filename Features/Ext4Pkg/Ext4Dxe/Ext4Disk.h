@@ -68,12 +68,16 @@
           mostly-list of EXT4_DIR_ENTRY.
        2) Hash tree directories: These are used for larger directories, with
           hundreds of entries, and are designed in a backwards compatible way.
-          These are not yet implemented in the Ext4Dxe driver.
+          Ext4Dxe uses the index to look names up, see Htree.c.
 
   7) Journal
      Ext3/4 filesystems have a journal to help protect the filesystem against
-     system crashes. This is not yet implemented in Ext4Dxe but is described
-     in detail in the Linux kernel's documentation.
+     system crashes. The journal is a JBD2 circular log, usually stored in
+     inode 8, to which metadata blocks are written before they're written to
+     their home location. Unlike the rest of the filesystem, its structures
+     are big endian. Ext4Dxe writes its transactions through the journal
+     (see Journal.c), but doesn't replay it; filesystems that need recovery
+     are mounted read-only.
 **/
 
 #ifndef EXT4_DISK_H_
@@ -110,6 +114,10 @@
 #define EXT4_FEATURE_COMPAT_EXT_ATTR       0x08
 #define EXT4_FEATURE_COMPAT_RESIZE_INO     0x10
 #define EXT4_FEATURE_COMPAT_DIR_INDEX      0x20
+#define EXT4_FEATURE_COMPAT_SPARSE_SUPER2  0x200
+#define EXT4_FEATURE_COMPAT_FAST_COMMIT    0x400
+#define EXT4_FEATURE_COMPAT_STABLE_INODES  0x800
+#define EXT4_FEATURE_COMPAT_ORPHAN_FILE    0x1000
 
 #define EXT4_FEATURE_INCOMPAT_COMPRESSION  0x00001
 #define EXT4_FEATURE_INCOMPAT_FILETYPE     0x00002
@@ -144,6 +152,8 @@
 // We explicitly don't recognise this, so we get read only.
 #define EXT4_FEATURE_RO_COMPAT_READONLY  0x1000
 #define EXT4_FEATURE_RO_COMPAT_PROJECT   0x2000
+// The orphan file has entries; Linux must process them before writes
+#define EXT4_FEATURE_RO_COMPAT_ORPHAN_PRESENT  0x10000
 
 /* Important notes about the features
  * Absolutely needed features:
@@ -172,8 +182,9 @@
 #define EXT4_COMPRBLK_FL      0x00000200
 #define EXT4_NOCOMPR_FL       0x00000400
 #define EXT4_ENCRYPT_FL       0x00000800
-#define EXT4_BTREE_FL         0x00001000
-#define EXT4_INDEX_FL         0x00002000
+// Hash-indexed directory; ext2 called this BTREE_FL
+#define EXT4_INDEX_FL         0x00001000
+#define EXT4_IMAGIC_FL        0x00002000
 #define EXT4_JOURNAL_DATA_FL  0x00004000
 #define EXT4_NOTAIL_FL        0x00008000
 #define EXT4_DIRSYNC_FL       0x00010000
@@ -182,6 +193,7 @@
 #define EXT4_EXTENTS_FL       0x00080000
 #define EXT4_VERITY_FL        0x00100000
 #define EXT4_EA_INODE_FL      0x00200000
+#define EXT4_INLINE_DATA_FL   0x10000000
 #define EXT4_RESERVED_FL      0x80000000
 
 /* File type flags that are stored in the directory entries */
@@ -327,6 +339,18 @@ typedef struct {
 #define EXT4_OLD_BLOCK_DESC_SIZE    32
 #define EXT4_64BIT_BLOCK_DESC_SIZE  64
 
+/* Block group flags (bg_flags) */
+// The inode bitmap and table are not initialized
+#define EXT4_BG_INODE_UNINIT  0x0001
+// The block bitmap is not initialized
+#define EXT4_BG_BLOCK_UNINIT  0x0002
+// The inode table is zeroed
+#define EXT4_BG_INODE_ZEROED  0x0004
+
+// The high halves of the bitmap checksums only exist in descriptors at least this large
+#define EXT4_BG_BLOCK_BITMAP_CSUM_HI_END  (OFFSET_OF (EXT4_BLOCK_GROUP_DESC, bg_block_bitmap_csum_hi) + sizeof (UINT16))
+#define EXT4_BG_INODE_BITMAP_CSUM_HI_END  (OFFSET_OF (EXT4_BLOCK_GROUP_DESC, bg_inode_bitmap_csum_hi) + sizeof (UINT16))
+
 STATIC_ASSERT (
   sizeof (EXT4_BLOCK_GROUP_DESC) == EXT4_64BIT_BLOCK_DESC_SIZE,
   "ext4 block group descriptor struct has incorrect size"
@@ -424,6 +448,94 @@ typedef struct {
 
 #define EXT4_MIN_DIR_ENTRY_LEN  8
 
+// Length of a directory entry whose name is NameLen bytes long
+#define EXT4_DIR_ENTRY_LEN(NameLen)  (((NameLen) + EXT4_MIN_DIR_ENTRY_LEN + 3) & ~3U)
+
+// With metadata_csum, every directory block (except the htree index blocks)
+// ends with this fake entry, whose inode is 0 so that older drivers skip it.
+typedef struct {
+  UINT32    det_reserved_zero1;
+  // Length of this structure, 12
+  UINT16    det_rec_len;
+  UINT8     det_reserved_zero2;
+  // EXT4_DIR_ENTRY_TAIL_FT
+  UINT8     det_reserved_ft;
+  // CRC32C of UUID + inode number + igeneration + the rest of the block
+  UINT32    det_checksum;
+} EXT4_DIR_ENTRY_TAIL;
+
+#define EXT4_DIR_ENTRY_TAIL_FT  0xDE
+
+// Hash tree (htree) directories
+// Logical block 0 of an indexed directory (EXT4_INDEX_FL) is the dx_root block.
+// It starts with the "." and ".." entries, where ".." spans the rest of the
+// block so that the index is invisible to linear readers, followed by an
+// EXT4_DX_ROOT_INFO and the index entries. Interior index blocks (dx_node)
+// start with an empty directory entry spanning the whole block, followed by
+// the index entries. Every index block holds a sorted array of EXT4_DX_ENTRY,
+// whose first entry holds an EXT4_DX_COUNT_LIMIT instead of a hash.
+typedef struct {
+  UINT32    reserved_zero;
+  // Hash algorithm used by this directory, one of EXT4_DX_HASH_*
+  UINT8     hash_version;
+  // Length of this structure, 8
+  UINT8     info_length;
+  // Depth of the index, not counting the leaves
+  UINT8     indirect_levels;
+  UINT8     unused_flags;
+} EXT4_DX_ROOT_INFO;
+
+typedef struct {
+  // Lowest hash of the names stored in the blocks pointed to by this entry.
+  // Bit 0 is set when the block continues a run of colliding hashes.
+  UINT32    hash;
+  // Logical block of the directory
+  UINT32    block;
+} EXT4_DX_ENTRY;
+
+typedef struct {
+  // Maximum number of entries in this index block
+  UINT16    limit;
+  // Number of entries in this index block, including this one
+  UINT16    count;
+  // Logical block for hashes lower than the second entry's
+  UINT32    block;
+} EXT4_DX_COUNT_LIMIT;
+
+// With metadata_csum, this follows the last possible index entry
+typedef struct {
+  UINT32    dt_reserved;
+  UINT32    dt_checksum;
+} EXT4_DX_TAIL;
+
+// "." (8 bytes + a 4 byte name) followed by ".." (8 bytes + a 4 byte name)
+#define EXT4_DX_ROOT_INFO_OFFSET     24
+#define EXT4_DX_NODE_ENTRIES_OFFSET  8
+
+// The top 4 bits of EXT4_DX_ENTRY.block are reserved
+#define EXT4_DX_BLOCK_MASK  0x0FFFFFFF
+
+// Maximum number of index levels, including the root. Directories may only
+// use the third level if the filesystem has the LARGEDIR feature.
+#define EXT4_HTREE_LEVEL_COMPAT  2
+#define EXT4_HTREE_LEVEL         3
+
+#define EXT4_DX_HASH_LEGACY             0
+#define EXT4_DX_HASH_HALF_MD4           1
+#define EXT4_DX_HASH_TEA                2
+#define EXT4_DX_HASH_LEGACY_UNSIGNED    3
+#define EXT4_DX_HASH_HALF_MD4_UNSIGNED  4
+#define EXT4_DX_HASH_TEA_UNSIGNED       5
+#define EXT4_DX_HASH_SIPHASH            6
+
+// Hashes are 31-bit, this one is reserved as an end of directory marker
+#define EXT4_HTREE_EOF_32BIT  0x7FFFFFFF
+
+/* Superblock flags (s_flags) */
+#define EXT4_FLAGS_SIGNED_HASH    0x0001
+#define EXT4_FLAGS_UNSIGNED_HASH  0x0002
+#define EXT4_FLAGS_TEST_FILESYS   0x0004
+
 // This on-disk structure is present at the bottom of the extent tree
 typedef struct {
   // First logical block
@@ -471,6 +583,10 @@ typedef struct {
   UINT32    eb_checksum;
 } EXT4_EXTENT_TAIL;
 
+// Offset of the EXT4_EXTENT_TAIL of an extent tree block, right after its last possible entry
+#define EXT4_EXTENT_TAIL_OFFSET(Header)  \
+  (sizeof (EXT4_EXTENT_HEADER) + sizeof (EXT4_EXTENT) * (Header)->eh_max)
+
 /**
  * EXT4 has this feature called uninitialized extents:
  * An extent has a maximum of 32768 blocks (2^15 or 1 << 15).
@@ -480,6 +596,154 @@ typedef struct {
  */
 #define EXT4_EXTENT_MAX_INITIALIZED  (1 << 15)
 
+// Extended attributes stored in the inode, after i_extra_isize, start with
+// this header and are followed by a list of EXT4_XATTR_ENTRY terminated by 4
+// zero bytes. Value offsets are relative to the first entry.
+#define EXT4_XATTR_MAGIC  0xEA020000
+
+typedef struct _Ext4XattrEntry {
+  UINT8     e_name_len;
+  UINT8     e_name_index;
+  UINT16    e_value_offs;
+  UINT32    e_value_inum;
+  UINT32    e_value_size;
+  UINT32    e_hash;
+  // Followed by e_name[e_name_len], not null-terminated
+} EXT4_XATTR_ENTRY;
+
+#define EXT4_XATTR_ROUND  3
+#define EXT4_XATTR_ENTRY_LEN(NameLen)  \
+  (((NameLen) + sizeof (EXT4_XATTR_ENTRY) + EXT4_XATTR_ROUND) & ~EXT4_XATTR_ROUND)
+
+#define EXT4_XATTR_INDEX_SYSTEM  7
+
+// Extended attributes that don't fit in the inode are stored in a block
+// (i_file_acl), which starts with this header and may be shared by inodes.
+typedef struct {
+  // EXT4_XATTR_MAGIC
+  UINT32    h_magic;
+  // Number of inodes that refer to the block
+  UINT32    h_refcount;
+  UINT32    h_blocks;
+  UINT32    h_hash;
+  // CRC32C of UUID + block number + the block, with this field zeroed
+  UINT32    h_checksum;
+  UINT32    h_reserved[3];
+} EXT4_XATTR_BLOCK_HEADER;
+
+// Inline data (EXT4_INLINE_DATA_FL) is stored in i_data and continues in the
+// "system.data" extended attribute. Inline directories begin with the inode
+// number of the parent directory and have no "." or ".." entries.
+#define EXT4_INLINE_DATA_XATTR_NAME  "data"
+#define EXT4_MIN_INLINE_DATA_SIZE    (EXT4_NR_BLOCKS * sizeof (UINT32))
+#define EXT4_INLINE_DOTDOT_SIZE      4
+
+// JBD2 journal. Every structure in this section is big endian.
+#define JBD2_MAGIC_NUMBER  0xC03B3998U
+
+#define JBD2_DESCRIPTOR_BLOCK  1
+#define JBD2_COMMIT_BLOCK      2
+#define JBD2_SUPERBLOCK_V1     3
+#define JBD2_SUPERBLOCK_V2     4
+#define JBD2_REVOKE_BLOCK      5
+
+typedef struct {
+  UINT32    h_magic;
+  UINT32    h_blocktype;
+  UINT32    h_sequence;
+} JBD2_HEADER;
+
+#define JBD2_FEATURE_COMPAT_CHECKSUM  0x00000001
+
+#define JBD2_FEATURE_INCOMPAT_REVOKE        0x00000001
+#define JBD2_FEATURE_INCOMPAT_64BIT         0x00000002
+#define JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT  0x00000004
+#define JBD2_FEATURE_INCOMPAT_CSUM_V2       0x00000008
+#define JBD2_FEATURE_INCOMPAT_CSUM_V3       0x00000010
+#define JBD2_FEATURE_INCOMPAT_FAST_COMMIT   0x00000020
+
+#define JBD2_CRC32C_CHKSUM  4
+
+// Size of the fast commit area if s_num_fc_blks is 0
+#define JBD2_DEFAULT_FAST_COMMIT_BLOCKS  256
+
+typedef struct {
+  JBD2_HEADER    s_header;
+  // Static information about the journal
+  UINT32         s_blocksize;
+  UINT32         s_maxlen;
+  UINT32         s_first;
+  // Dynamic information: the first transaction that needs to be replayed, and
+  // where it starts. s_start is 0 if the journal is clean.
+  UINT32         s_sequence;
+  UINT32         s_start;
+  UINT32         s_errno;
+  // Only valid in JBD2_SUPERBLOCK_V2 superblocks
+  UINT32         s_feature_compat;
+  UINT32         s_feature_incompat;
+  UINT32         s_feature_ro_compat;
+  UINT8          s_uuid[16];
+  UINT32         s_nr_users;
+  UINT32         s_dynsuper;
+  UINT32         s_max_transaction;
+  UINT32         s_max_trans_data;
+  UINT8          s_checksum_type;
+  UINT8          s_padding2[3];
+  UINT32         s_num_fc_blks;
+  UINT32         s_head;
+  UINT32         s_padding[40];
+  // CRC32C of the superblock, with this field zeroed
+  UINT32         s_checksum;
+  UINT8          s_users[16 * 48];
+} JBD2_SUPERBLOCK;
+
+STATIC_ASSERT (
+  sizeof (JBD2_SUPERBLOCK) == 1024,
+  "jbd2 superblock struct has incorrect size"
+  );
+
+// Descriptor blocks are followed by the blocks they describe, one tag each.
+// The first tag is followed by the 16 byte UUID of the journal, unless it has
+// JBD2_FLAG_SAME_UUID.
+#define JBD2_FLAG_ESCAPE     0x1
+#define JBD2_FLAG_SAME_UUID  0x2
+#define JBD2_FLAG_DELETED    0x4
+#define JBD2_FLAG_LAST_TAG   0x8
+
+// Tags of journals without JBD2_FEATURE_INCOMPAT_CSUM_V3; t_blocknr_high
+// only exists with JBD2_FEATURE_INCOMPAT_64BIT.
+typedef struct {
+  UINT32    t_blocknr;
+  UINT16    t_checksum;
+  UINT16    t_flags;
+  UINT32    t_blocknr_high;
+} JBD2_BLOCK_TAG;
+
+// Tags of journals with JBD2_FEATURE_INCOMPAT_CSUM_V3
+typedef struct {
+  UINT32    t_blocknr;
+  UINT32    t_flags;
+  UINT32    t_blocknr_high;
+  // CRC32C of the sequence number and the block
+  UINT32    t_checksum;
+} JBD2_BLOCK_TAG3;
+
+// Ends descriptor blocks of checksummed journals
+typedef struct {
+  UINT32    t_checksum;
+} JBD2_BLOCK_TAIL;
+
+typedef struct {
+  JBD2_HEADER    h_header;
+  UINT8          h_chksum_type;
+  UINT8          h_chksum_size;
+  UINT8          h_padding[2];
+  // With JBD2_FEATURE_INCOMPAT_CSUM_V3, h_chksum[0] is the CRC32C of the block
+  UINT32         h_chksum[8];
+  UINT64         h_commit_sec;
+  UINT32         h_commit_nsec;
+} JBD2_COMMIT_HEADER;
+
 typedef UINT64  EXT4_BLOCK_NR;
 typedef UINT32  EXT2_BLOCK_NR;
 typedef UINT32  EXT4_INO_NR;
@@ -20,6 +20,7 @@
 
 #include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
+#include <Library/Crc32cLib.h>
 #include <Library/DebugLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/OrderedCollectionLib.h>
@@ -77,6 +78,92 @@ Ext4OpenPartition (
 typedef struct _Ext4File     EXT4_FILE;
 typedef struct _Ext4_Dentry  EXT4_DENTRY;
 
+//
+// Classes of blocks kept by the partition block cache. Each class has its own
+// LRU list and memory budget, so that streaming file data through the cache
+// never evicts the metadata needed to find that data.
+//
+typedef enum {
+  // Inode tables, extent tree nodes, block maps and directory blocks
+  Ext4BlockCacheMetadata,
+  // Regular file contents
+  Ext4BlockCacheData,
+  Ext4BlockCacheClassMax
+} EXT4_BLOCK_CACHE_CLASS;
+
+typedef struct {
+  LIST_ENTRY    Lru;
+  UINTN         Count;
+  UINTN         MaxCount;
+  UINT64        Hits;
+  UINT64        Misses;
+} EXT4_BLOCK_CACHE_LRU;
+
+typedef struct {
+  // Hash table of cached blocks, indexed by block number; NULL if the cache is disabled.
+  LIST_ENTRY              *Buckets;
+  UINTN                   BucketMask;
+  // Media ID the cached blocks were read from.
+  UINT32                  MediaId;
+  EXT4_BLOCK_CACHE_LRU    Classes[Ext4BlockCacheClassMax];
+} EXT4_BLOCK_CACHE;
+
+//
+// Bounded cache of the results of name or inode lookups, see LookupCache.c.
+//
+typedef struct {
+  // Hash table of cached entries; NULL if the cache is disabled.
+  LIST_ENTRY    *Buckets;
+  UINTN         BucketMask;
+  LIST_ENTRY    Lru;
+  UINTN         Count;
+  UINTN         MaxCount;
+  // Media ID the cached entries were read from.
+  UINT32        MediaId;
+  UINT64        Hits;
+  UINT64        Misses;
+} EXT4_LOOKUP_CACHE;
+
+//
+// Window over the inode tables, see Ext4ReadInode. It holds a run of inode
+// table blocks, which with flex_bg may span the tables of several groups.
+//
+typedef struct {
+  // Window contents; NULL if the window is disabled.
+  UINT8     *Data;
+  UINTN     MaxLength;
+  // Location of the window on the disk, in bytes; Length is 0 if it's empty.
+  UINT64    DiskOffset;
+  UINTN     Length;
+  // One bit per inode slot of the window, set once the inode's checksum was verified.
+  UINT8     *Verified;
+  // Media ID the window was read from.
+  UINT32    MediaId;
+  UINT64    Hits;
+  UINT64    Misses;
+} EXT4_INODE_TABLE_WINDOW;
+
+//
+// JBD2 journal of the partition, through which metadata is written, see Journal.c.
+//
+typedef struct {
+  // Open journal inode; NULL if the journal can't be used, in which case the
+  // partition is read-only.
+  EXT4_FILE          *File;
+  JBD2_SUPERBLOCK    Sb;
+  // Location and length of the log, in journal blocks
+  UINT32             First;
+  UINT32             MaxLength;
+  // Sequence number of the next transaction
+  UINT32             Sequence;
+  UINT32             TagSize;
+  UINT32             TagsPerDescriptor;
+  UINT32             ChecksumSeed;
+  BOOLEAN            CsumV3;
+  // Most metadata blocks a transaction may hold
+  UINTN              MaxTransactionBlocks;
+} EXT4_JOURNAL;
+
 typedef struct _Ext4_PARTITION {
   EFI_SIMPLE_FILE_SYSTEM_PROTOCOL    Interface;
   EFI_DISK_IO_PROTOCOL               *DiskIo;
@@ -104,6 +191,14 @@ typedef struct _Ext4_PARTITION {
   LIST_ENTRY                         OpenFiles;
 
   EXT4_DENTRY                        *RootDentry;
+
+  EXT4_BLOCK_CACHE                   BlockCache;
+  // (directory inode, name) -> directory entry, including names that don't exist
+  EXT4_LOOKUP_CACHE                  DentryCache;
+  // Inode number -> verified on-disk inode
+  EXT4_LOOKUP_CACHE                  InodeCache;
+  EXT4_INODE_TABLE_WINDOW            InodeTableWindow;
+  EXT4_JOURNAL                       Journal;
 } EXT4_PARTITION;
 
 /**
@@ -264,6 +359,273 @@ Ext4AllocAndReadBlocks (
   IN EXT4_BLOCK_NR   BlockNumber
   );
 
+/**
+   Writes to the partition's disk using the DISK_IO protocol.
+   Most callers want Ext4WriteDiskIoCached(), which keeps the caches coherent.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Buffer         Pointer to a source buffer.
+   @param[in]  Length         Length of the source buffer.
+   @param[in]  Offset         Offset, in bytes, of the location to write.
+
+   @return Success status of the disk write.
+**/
+EFI_STATUS
+Ext4WriteDiskIo (
+  IN EXT4_PARTITION  *Partition,
+  IN CONST VOID      *Buffer,
+  IN UINTN           Length,
+  IN UINT64          Offset
+  );
+
+/**
+   Flushes the writes of the partition to the media.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+
+   @return Success status of the flush.
+**/
+EFI_STATUS
+Ext4FlushDisk (
+  IN EXT4_PARTITION  *Partition
+  );
+
+/**
+   Initialises the block cache of the partition, sizing it after
+   PcdExt4MetadataCacheSize and PcdExt4DataCacheSize.
+   Partition->BlockSize must be valid.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @retval EFI_SUCCESS            The cache was initialised, or it is disabled.
+   @retval EFI_OUT_OF_RESOURCES   The hash table could not be allocated.
+**/
+EFI_STATUS
+Ext4InitBlockCache (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Drops every block held by the partition's block cache.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+**/
+VOID
+Ext4InvalidateBlockCache (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Drops every block held by the partition's block cache and frees the cache.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+**/
+VOID
+Ext4FreeBlockCache (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Reads from the partition's disk through the block cache.
+   Blocks that are not cached are read from the disk, together with up to ReadAhead
+   bytes that follow the requested range, and are then added to the cache.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Class          Class of the blocks that are read.
+   @param[out] Buffer         Pointer to a destination buffer.
+   @param[in]  Length         Length of the destination buffer.
+   @param[in]  Offset         Offset, in bytes, of the location to read.
+   @param[in]  ReadAhead      Number of bytes past Offset + Length that may be
+                              read ahead and cached.
+
+   @return Success status of the read.
+**/
+EFI_STATUS
+Ext4ReadDiskIoCached (
+  IN EXT4_PARTITION          *Partition,
+  IN EXT4_BLOCK_CACHE_CLASS  Class,
+  OUT VOID                   *Buffer,
+  IN UINTN                   Length,
+  IN UINT64                  Offset,
+  IN UINTN                   ReadAhead
+  );
+
+/**
+   Reads blocks from the partition's disk through the block cache.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Class          Class of the blocks that are read.
+   @param[out] Buffer         Pointer to a destination buffer.
+   @param[in]  NumberBlocks   Length of the read, in filesystem blocks.
+   @param[in]  BlockNumber    Starting block number.
+
+   @return Success status of the read.
+**/
+EFI_STATUS
+Ext4ReadBlocksCached (
+  IN EXT4_PARTITION          *Partition,
+  IN EXT4_BLOCK_CACHE_CLASS  Class,
+  OUT VOID                   *Buffer,
+  IN UINTN                   NumberBlocks,
+  IN EXT4_BLOCK_NR           BlockNumber
+  );
+
+/**
+   Writes to the partition's disk, and updates the copies of the written
+   blocks held by the block cache, the inode table window and the in-memory
+   block group descriptors.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Buffer         Pointer to a source buffer.
+   @param[in]  Length         Length of the source buffer.
+   @param[in]  Offset         Offset, in bytes, of the location to write.
+
+   @return Success status of the write.
+**/
+EFI_STATUS
+Ext4WriteDiskIoCached (
+  IN EXT4_PARTITION  *Partition,
+  IN CONST VOID      *Buffer,
+  IN UINTN           Length,
+  IN UINT64          Offset
+  );
+
+/**
+   Writes blocks to the partition's disk, updating the block cache.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Buffer         Pointer to a source buffer.
+   @param[in]  NumberBlocks   Length of the write, in filesystem blocks.
+   @param[in]  BlockNumber    Starting block number.
+
+   @return Success status of the write.
+**/
+EFI_STATUS
+Ext4WriteBlocksCached (
+  IN EXT4_PARTITION  *Partition,
+  IN CONST VOID      *Buffer,
+  IN UINTN           NumberBlocks,
+  IN EXT4_BLOCK_NR   BlockNumber
+  );
+
+/**
+   Initialises the dentry and inode caches of the partition, sizing them after
+   PcdExt4DentryCacheEntries and PcdExt4InodeCacheEntries.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @retval EFI_SUCCESS            The caches were initialised, or are disabled.
+   @retval EFI_OUT_OF_RESOURCES   A hash table could not be allocated.
+**/
+EFI_STATUS
+Ext4InitLookupCaches (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Drops every entry held by the dentry and inode caches and frees the caches.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+**/
+VOID
+Ext4FreeLookupCaches (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Looks the result of a name lookup up in the dentry cache.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Directory      Inode number of the directory.
+   @param[in]  Name           Name that was looked up.
+   @param[out] Result         Pointer to the destination directory entry.
+
+   @retval EFI_SUCCESS        The name is cached and exists; Result was filled.
+   @retval EFI_NOT_FOUND      The name is cached as not existing.
+   @retval EFI_NO_MAPPING     The name is not cached.
+**/
+EFI_STATUS
+Ext4DentryCacheLookup (
+  IN EXT4_PARTITION   *Partition,
+  IN EXT4_INO_NR      Directory,
+  IN CONST CHAR16     *Name,
+  OUT EXT4_DIR_ENTRY  *Result
+  );
+
+/**
+   Caches the result of a name lookup that missed the dentry cache.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Directory      Inode number of the directory.
+   @param[in]  Name           Name that was looked up.
+   @param[in]  Entry          Directory entry the name resolved to, or NULL
+                              if the name doesn't exist.
+**/
+VOID
+Ext4DentryCacheInsert (
+  IN EXT4_PARTITION        *Partition,
+  IN EXT4_INO_NR           Directory,
+  IN CONST CHAR16          *Name,
+  IN CONST EXT4_DIR_ENTRY  *Entry OPTIONAL
+  );
+
+/**
+   Looks an inode up in the inode cache.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  InodeNum       Inode number.
+   @param[out] Inode          Pointer to a buffer of at least Partition->InodeSize
+                              bytes that receives the inode.
+
+   @return TRUE if the inode was cached and copied to Inode, else FALSE.
+**/
+BOOLEAN
+Ext4InodeCacheLookup (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_INO_NR     InodeNum,
+  OUT EXT4_INODE     *Inode
+  );
+
+/**
+   Caches an inode. The inode must have been verified already; inodes that
+   are cached already are left alone.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  InodeNum       Inode number.
+   @param[in]  Inode          Pointer to the inode.
+**/
+VOID
+Ext4InodeCacheInsert (
+  IN EXT4_PARTITION    *Partition,
+  IN EXT4_INO_NR       InodeNum,
+  IN CONST EXT4_INODE  *Inode
+  );
+
+/**
+   Drops every cached lookup of a directory, after entries were added to it or
+   removed from it.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Directory      Inode number of the directory.
+**/
+VOID
+Ext4DentryCacheForgetDirectory (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_INO_NR     Directory
+  );
+
+/**
+   Drops an inode from the inode cache, after it was modified.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  InodeNum       Inode number.
+**/
+VOID
+Ext4InodeCacheForget (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_INO_NR     InodeNum
+  );
+
 /**
    Checks if the opened partition has the 64-bit feature (see
 EXT4_FEATURE_INCOMPAT_64BIT).
@@ -328,6 +690,107 @@ Ext4ReadInode (
   OUT EXT4_INODE     **OutIno
   );
 
+/**
+   Sets up the inode table window of the partition, sizing it after
+   PcdExt4InodeTableWindowSize. Partition->BlockSize and Partition->InodeSize
+   must be valid.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @retval EFI_SUCCESS            The window was set up, or it is disabled.
+   @retval EFI_OUT_OF_RESOURCES   The window could not be allocated.
+**/
+EFI_STATUS
+Ext4InitInodeTableWindow (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Frees the inode table window of the partition.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+**/
+VOID
+Ext4FreeInodeTableWindow (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Locates an inode on the disk.
+
+   @param[in]    Partition         Pointer to the opened partition.
+   @param[in]    InodeNum          Number of the desired Inode
+   @param[out]   DiskOffset        Offset of the inode on the disk, in bytes.
+   @param[out]   BlockGroupNumber  Block group of the inode.
+
+   @retval EFI_SUCCESS           The inode was located.
+   @retval EFI_VOLUME_CORRUPTED  The inode number or its block group is invalid.
+**/
+EFI_STATUS
+Ext4GetInodeOffset (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_INO_NR     InodeNum,
+  OUT UINT64          *DiskOffset,
+  OUT UINT32          *BlockGroupNumber
+  );
+
+/**
+   Updates the inode table window after a write to the disk.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      Buffer         Pointer to the data that was written, or NULL
+                                  if the write failed and its outcome is unknown.
+   @param[in]      Length         Length of the write, in bytes.
+   @param[in]      Offset         Offset of the write on the disk, in bytes.
+**/
+VOID
+Ext4UpdateInodeTableWindow (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN CONST VOID          *Buffer OPTIONAL,
+  IN UINTN               Length,
+  IN UINT64              Offset
+  );
+
+/**
+   Updates the in-memory block group descriptors after a write to the disk
+   that covered some of them.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+   @param[in]      Buffer         Pointer to the data that was written.
+   @param[in]      Length         Length of the write, in bytes.
+   @param[in]      Offset         Offset of the write on the disk, in bytes.
+**/
+VOID
+Ext4UpdateBlockGroupDescs (
+  IN OUT EXT4_PARTITION  *Partition,
+  IN CONST VOID          *Buffer,
+  IN UINTN               Length,
+  IN UINT64              Offset
+  );
+
+/**
+   Reads a batch of inodes from disk.
+   Inodes are fetched in the order of their location on the disk, so that each
+   block of the inode tables is only read once, whatever the order of InodeNums.
+
+   @param[in]    Partition  Pointer to the opened partition.
+   @param[in]    Count      Number of inodes to read.
+   @param[in]    InodeNums  Numbers of the desired inodes.
+   @param[out]   Inodes     Array of Count pointers that receive the read inodes.
+                            Inodes that could not be read are set to NULL;
+                            Ext4ReadInode() tells why.
+
+   @retval EFI_SUCCESS           The batch was processed.
+   @retval EFI_OUT_OF_RESOURCES  The batch could not be set up.
+**/
+EFI_STATUS
+Ext4ReadInodes (
+  IN  EXT4_PARTITION     *Partition,
+  IN  UINTN              Count,
+  IN  CONST EXT4_INO_NR  *InodeNums,
+  OUT EXT4_INODE         **Inodes
+  );
+
 /**
    Converts blocks to bytes.
 
@@ -360,6 +823,33 @@ Ext4Read (
   IN OUT UINTN           *Length
   );
 
+/**
+   Plans the next I/O of a read, by merging the extents that map the file from Offset
+   onwards into a run that is either contiguous on the disk, or only made of holes
+   and uninitialized extents.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      Offset        Offset in the file.
+   @param[in]      Length        Number of bytes left to read.
+   @param[out]     IsHole        TRUE if the run must be read as zeros.
+   @param[out]     DiskOffset    Offset of the run on the disk, if it's not a hole.
+   @param[out]     RunLength     Length of the run, in bytes. It may be larger than Length,
+                                 up to the end of the last extent that was merged.
+
+   @return Status of the extent lookups.
+**/
+EFI_STATUS
+Ext4GetReadRun (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *File,
+  IN  UINT64          Offset,
+  IN  UINTN           Length,
+  OUT BOOLEAN         *IsHole,
+  OUT UINT64          *DiskOffset,
+  OUT UINT64          *RunLength
+  );
+
 /**
    Retrieves the size of the inode.
 
@@ -379,6 +869,8 @@ cover.
    @param[out]     Extent        Pointer to the output buffer, where the extent
 will be copied to.
 
+   File holes are returned as uninitialized extents with no physical blocks.
+
    @retval EFI_SUCCESS        Retrieval was successful.
    @retval EFI_NO_MAPPING     Block has no mapping.
 **/
@@ -390,6 +882,32 @@ Ext4GetExtent (
   OUT EXT4_EXTENT    *Extent
   );
 
+//
+// Directory block decoded by Ext4ReadDir. It's kept on the directory's handle
+// so that successive Read() calls return its entries without reading it, or
+// the inodes of its entries, again.
+//
+typedef struct {
+  // Offset of the record in the directory, and of the record that follows it
+  UINT64    Offset;
+  UINT64    NextOffset;
+  CHAR16    *Name;
+} EXT4_READDIR_ENTRY;
+
+typedef struct {
+  // Offset of the block in the directory; MAX_UINT64 if no block is decoded.
+  UINT64                Offset;
+  UINT32                MediaId;
+  // Entries that ReadDir() reports, in on-disk order
+  UINTN                 Count;
+  EXT4_READDIR_ENTRY    *Entries;
+  EXT4_INO_NR           *InodeNums;
+  // Inodes of the entries; NULL for those that could not be read ahead
+  EXT4_INODE            **Inodes;
+  CHAR16                *Names;
+  CHAR8                 *Data;
+} EXT4_READDIR_BLOCK;
+
 struct _Ext4File {
   EFI_FILE_PROTOCOL     Protocol;
   EXT4_INODE            *Inode;
@@ -407,6 +925,13 @@ struct _Ext4File {
 
   // Owning reference to this file's directory entry.
   EXT4_DENTRY           *Dentry;
+
+  // Sequential access detection for read-ahead, see Ext4Read.
+  UINT64                ReadAheadNext;
+  UINT32                ReadAheadWindow;
+
+  // Last block decoded by Ext4ReadDir, or NULL.
+  EXT4_READDIR_BLOCK    *ReadDirBlock;
 };
 
 #define EXT4_FILE_FROM_THIS(This)  BASE_CR ((This), EXT4_FILE, Protocol)
@@ -432,6 +957,138 @@ Ext4RetrieveDirent (
   OUT EXT4_DIR_ENTRY  *Result
   );
 
+/**
+   Searches a directory block for an entry.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Block       Pointer to the directory block, Partition->BlockSize bytes long.
+   @param[in]      Name        Pointer to the UCS-2 formatted filename.
+   @param[out]     Result      Pointer to the destination directory entry.
+
+   @retval EFI_SUCCESS            The entry was found and copied to Result.
+   @retval EFI_NOT_FOUND          The block does not hold the entry.
+   @retval EFI_VOLUME_CORRUPTED   The block is corrupted.
+   @retval !EFI_SUCCESS           Failure.
+**/
+EFI_STATUS
+Ext4SearchDirBlock (
+  IN  EXT4_PARTITION  *Partition,
+  IN  CONST CHAR8     *Block,
+  IN  CONST CHAR16    *Name,
+  OUT EXT4_DIR_ENTRY  *Result
+  );
+
+/**
+   Checks if an inode stores its data inline, in i_data and in the
+   "system.data" extended attribute, instead of in data blocks.
+
+   @param[in]      Inode       Pointer to the inode.
+
+   @return TRUE if the inode has inline data, else FALSE.
+**/
+#define EXT4_HAS_INLINE_DATA(Inode)  (((Inode)->i_flags & EXT4_INLINE_DATA_FL) != 0)
+
+/**
+   Reads from a file whose data is stored inline.
+
+   @param[in]      Partition     Pointer to the ext4 partition.
+   @param[in]      File          Pointer to the open file.
+   @param[out]     Buffer        Pointer to the buffer.
+   @param[in]      Offset        Offset of the read.
+   @param[in out]  Length        Pointer to the length of the buffer, in bytes.
+                                 After a successful read, it's updated to the
+                                 number of read bytes.
+
+   @return Status of the read operation.
+**/
+EFI_STATUS
+Ext4ReadInlineData (
+  IN     EXT4_PARTITION  *Partition,
+  IN     EXT4_FILE       *File,
+  OUT    VOID            *Buffer,
+  IN     UINT64          Offset,
+  IN OUT UINTN           *Length
+  );
+
+/**
+   Builds a directory block out of an inline directory, with "." and ".."
+   entries followed by the directory's entries.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Directory   Pointer to the open directory, which must have
+                               inline data.
+   @param[out]     Block       Pointer to a buffer of Partition->BlockSize bytes.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4ReadInlineDirBlock (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *Directory,
+  OUT CHAR8           *Block
+  );
+
+/**
+   Checks if a directory has a hash tree index that can be used for lookups.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Inode       Pointer to the directory's inode.
+
+   @return TRUE if the directory is indexed, else FALSE.
+**/
+#define EXT4_DIR_IS_INDEXED(Partition, Inode)                                  \
+  (EXT4_HAS_COMPAT (Partition, EXT4_FEATURE_COMPAT_DIR_INDEX) &&               \
+   (((Inode)->i_flags & EXT4_INDEX_FL) != 0))
+
+/**
+   Retrieves a directory entry using the directory's hash tree index.
+
+   Only the leaf blocks whose hash range covers the exact name are searched,
+   so entries that only match Name case-insensitively may not be found.
+
+   @param[in]      Directory   Pointer to the opened, indexed directory.
+   @param[in]      Name        Pointer to the UCS-2 formatted filename.
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[out]     Result      Pointer to the destination directory entry.
+
+   @retval EFI_SUCCESS            The entry was found and copied to Result.
+   @retval EFI_NOT_FOUND          The index has no entry with this name.
+   @retval EFI_UNSUPPORTED        The index uses an unsupported hash or depth.
+   @retval EFI_VOLUME_CORRUPTED   The index is corrupted.
+   @retval !EFI_SUCCESS           Failure.
+**/
+EFI_STATUS
+Ext4HtreeRetrieveDirent (
+  IN EXT4_FILE        *Directory,
+  IN CONST CHAR16     *Name,
+  IN EXT4_PARTITION   *Partition,
+  OUT EXT4_DIR_ENTRY  *Result
+  );
+
+/**
+   Finds the leaf block of a directory's hash tree index where an entry with
+   the given name belongs.
+
+   @param[in]      Directory   Pointer to the opened, indexed directory.
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Name        Pointer to the UTF-8 name.
+   @param[in]      NameLength  Length of the name, in bytes.
+   @param[out]     Block       Logical block of the leaf in the directory.
+
+   @retval EFI_SUCCESS            The leaf was found.
+   @retval EFI_UNSUPPORTED        The index uses an unsupported hash or depth.
+   @retval EFI_VOLUME_CORRUPTED   The index is corrupted.
+   @retval !EFI_SUCCESS           Failure.
+**/
+EFI_STATUS
+Ext4HtreeFindLeaf (
+  IN  EXT4_FILE       *Directory,
+  IN  EXT4_PARTITION  *Partition,
+  IN  CONST CHAR8     *Name,
+  IN  UINTN           NameLength,
+  OUT UINT32          *Block
+  );
+
 /**
    Opens a file.
 
@@ -472,6 +1129,26 @@ Ext4OpenDirent (
   IN EXT4_FILE       *Directory
   );
 
+/**
+   Opens a file by inode number, for the driver's own use.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      InodeNum    Inode number of the file.
+   @param[in]      Dentry      Directory entry of the file, or NULL if the
+                               file has no name (e.g. the journal).
+   @param[out]     OutFile     Pointer to the opened file, which must be
+                               closed with Ext4CloseInternal().
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4OpenInode (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_INO_NR     InodeNum,
+  IN  EXT4_DENTRY     *Dentry OPTIONAL,
+  OUT EXT4_FILE       **OutFile
+  );
+
 /**
    Allocates a zeroed inode structure.
    @param[in]      Partition     Pointer to the opened EXT4 partition.
@@ -825,11 +1502,116 @@ indicated by InformationType.
 **/
 EFI_STATUS
 EFIAPI
-Ext4SetInfo (
-  IN EFI_FILE_PROTOCOL  *This,
-  IN EFI_GUID           *InformationType,
-  IN UINTN              BufferSize,
-  IN VOID               *Buffer
+Ext4SetInfo (
+  IN EFI_FILE_PROTOCOL  *This,
+  IN EFI_GUID           *InformationType,
+  IN UINTN              BufferSize,
+  IN VOID               *Buffer
+  );
+
+/**
+  Flushes all modified data associated with a file to a device.
+
+  @param[in]  This            A pointer to the EFI_FILE_PROTOCOL instance that
+is the file handle to flush.
+
+  @retval EFI_SUCCESS          The data was flushed.
+  @retval EFI_NO_MEDIA         The device has no medium.
+  @retval EFI_DEVICE_ERROR     The device reported an error.
+  @retval EFI_VOLUME_CORRUPTED The file system structures are corrupted.
+  @retval EFI_WRITE_PROTECTED  The file or medium is write-protected.
+  @retval EFI_ACCESS_DENIED    The file was opened read-only.
+  @retval EFI_VOLUME_FULL      The volume is full.
+
+**/
+EFI_STATUS
+EFIAPI
+Ext4Flush (
+  IN EFI_FILE_PROTOCOL  *This
+  );
+
+/**
+  Opens a new file relative to the source directory's location.
+
+  @param[in]      This       A pointer to the EFI_FILE_PROTOCOL instance that is
+                             the file handle to the source location.
+  @param[out]     NewHandle  A pointer to the location to return the opened
+                             handle for the new file.
+  @param[in]      FileName   The Null-terminated string of the name of the file
+                             to be opened.
+  @param[in]      OpenMode   The mode to open the file.
+  @param[in]      Attributes Only valid for EFI_FILE_MODE_CREATE, in which case
+                             these are the attribute bits for the newly created file.
+  @param[in out]  Token      A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS          The request was queued, or completed if Token->Event is NULL.
+  @retval !EFI_SUCCESS         The request failed, see Ext4Open().
+
+**/
+EFI_STATUS
+EFIAPI
+Ext4OpenEx (
+  IN EFI_FILE_PROTOCOL      *This,
+  OUT EFI_FILE_PROTOCOL     **NewHandle,
+  IN CHAR16                 *FileName,
+  IN UINT64                 OpenMode,
+  IN UINT64                 Attributes,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  );
+
+/**
+  Reads data from a file, asynchronously if the disk supports DISK_IO2.
+
+  @param[in]      This       A pointer to the EFI_FILE_PROTOCOL instance that is
+                             the file handle to read data from.
+  @param[in out]  Token      A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS          The request was queued, or completed if Token->Event is NULL.
+  @retval !EFI_SUCCESS         The request failed, see Ext4ReadFile().
+
+**/
+EFI_STATUS
+EFIAPI
+Ext4ReadEx (
+  IN EFI_FILE_PROTOCOL      *This,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  );
+
+/**
+  Writes data to a file.
+
+  @param[in]      This       A pointer to the EFI_FILE_PROTOCOL instance that is
+                             the file handle to write data to.
+  @param[in out]  Token      A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS          The request was queued, or completed if Token->Event is NULL.
+  @retval !EFI_SUCCESS         The request failed, see Ext4WriteFile().
+
+**/
+EFI_STATUS
+EFIAPI
+Ext4WriteEx (
+  IN EFI_FILE_PROTOCOL      *This,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
+  );
+
+/**
+  Flushes all modified data associated with a file to a device, asynchronously
+  if the disk supports DISK_IO2.
+
+  @param[in]      This       A pointer to the EFI_FILE_PROTOCOL instance that is
+                             the file handle to flush.
+  @param[in out]  Token      A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS          The request was queued, or completed if Token->Event is NULL.
+  @retval !EFI_SUCCESS         The request failed, see Ext4Flush().
+
+**/
+EFI_STATUS
+EFIAPI
+Ext4FlushEx (
+  IN EFI_FILE_PROTOCOL      *This,
+  IN OUT EFI_FILE_IO_TOKEN  *Token
   );
 
 // EFI_FILE_PROTOCOL implementation ends here.
@@ -932,6 +1714,27 @@ Ext4FileCreateTime (
   OUT EFI_TIME  *Time
   );
 
+// Timestamps of an inode, for Ext4SetInodeTimes()
+#define EXT4_INODE_ATIME   BIT0
+#define EXT4_INODE_MTIME   BIT1
+#define EXT4_INODE_CTIME   BIT2
+#define EXT4_INODE_CRTIME  BIT3
+#define EXT4_INODE_DTIME   BIT4
+
+/**
+   Sets timestamps of an inode.
+
+   @param[in out]  Inode         Pointer to the inode.
+   @param[in]      Which         EXT4_INODE_*TIME flags of the timestamps to set.
+   @param[in]      Time          Time to set, or NULL to set the current time.
+**/
+VOID
+Ext4SetInodeTimes (
+  IN OUT EXT4_INODE      *Inode,
+  IN     UINT32          Which,
+  IN     CONST EFI_TIME  *Time OPTIONAL
+  );
+
 /**
    Initialises Unicode collation, which is needed for case-insensitive string
 comparisons within the driver (a good example of an application of this is
@@ -997,6 +1800,26 @@ Ext4GetFileInfo (
   IN OUT UINTN       *BufferSize
   );
 
+/**
+   Retrieves information about a file under the given name and stores it in
+   the EFI_FILE_INFO format. Only the Inode and Partition fields of File are
+   used, so the file doesn't need to be opened.
+
+   @param[in]      File           Pointer to the file.
+   @param[in]      FileName       Name of the file.
+   @param[out]     Info           Pointer to a EFI_FILE_INFO.
+   @param[in out]  BufferSize     Pointer to the buffer size
+
+   @return Status of the file information request.
+**/
+EFI_STATUS
+Ext4GetFileInfoWithName (
+  IN EXT4_FILE       *File,
+  IN CONST CHAR16    *FileName,
+  OUT EFI_FILE_INFO  *Info,
+  IN OUT UINTN       *BufferSize
+  );
+
 /**
    Reads a directory entry.
 
@@ -1018,6 +1841,16 @@ Ext4ReadDir (
   IN OUT UINTN       *OutLength
   );
 
+/**
+   Frees the directory block decoded by Ext4ReadDir, if any.
+
+   @param[in out]  File        Pointer to the open directory.
+**/
+VOID
+Ext4FreeReadDirBlock (
+  IN OUT EXT4_FILE  *File
+  );
+
 /**
    Initialises the (empty) extents map, that will work as a cache of extents.
 
@@ -1040,6 +1873,56 @@ Ext4FreeExtentsMap (
   IN EXT4_FILE  *File
   );
 
+/**
+   Empties the extents map, deleting every extent stored, after the file's
+   extents were modified.
+
+   @param[in]      File        Pointer to the open file.
+**/
+VOID
+Ext4ResetExtentsMap (
+  IN EXT4_FILE  *File
+  );
+
+/**
+   Checks if an extent header is valid.
+   @param[in]      Header         Pointer to the EXT4_EXTENT_HEADER structure.
+   @param[in]      MaxEntries     Maximum number of entries possible for this tree node.
+
+   @return TRUE if valid, FALSE if not.
+**/
+BOOLEAN
+Ext4ExtentHeaderValid (
+  IN CONST EXT4_EXTENT_HEADER  *Header,
+  IN UINT16                    MaxEntries
+  );
+
+/**
+   Checks if the checksum of the extent data block is correct.
+   @param[in]      ExtHeader     Pointer to the EXT4_EXTENT_HEADER.
+   @param[in]      File          Pointer to the file.
+
+   @return TRUE if the checksum is correct, FALSE if there is corruption.
+**/
+BOOLEAN
+Ext4CheckExtentChecksum (
+  IN CONST EXT4_EXTENT_HEADER  *ExtHeader,
+  IN CONST EXT4_FILE           *File
+  );
+
+/**
+   Calculates the checksum of the extent data block.
+   @param[in]      ExtHeader     Pointer to the EXT4_EXTENT_HEADER.
+   @param[in]      File          Pointer to the file.
+
+   @return The checksum.
+**/
+UINT32
+Ext4CalculateExtentChecksum (
+  IN CONST EXT4_EXTENT_HEADER  *ExtHeader,
+  IN CONST EXT4_FILE           *File
+  );
+
 /**
    Calculates the checksum of the given buffer.
    @param[in]      Partition     Pointer to the opened EXT4 partition.
@@ -1211,6 +2094,18 @@ Ext4SuperblockCheckMagic (
   IN EFI_BLOCK_IO_PROTOCOL  *BlockIo
   );
 
+/**
+   Writes the in-memory superblock back to the disk, updating its checksum.
+
+   @param[in out]  Partition     Pointer to the opened EXT4 partition.
+
+   @return Status of the write.
+**/
+EFI_STATUS
+Ext4WriteSuperblock (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
 /**
    Check if the extent is uninitialized
 
@@ -1252,4 +2147,417 @@ Ext4GetBlocks (
   OUT EXT4_EXTENT     *Extent
   );
 
+//
+// Metadata changes are made in transactions, which hold copies of the
+// metadata blocks they modify until they're committed through the journal.
+// File data doesn't go through the journal: it's written to its blocks before
+// the transaction that makes them part of the file commits.
+//
+
+// Most metadata blocks held by a transaction, journal permitting
+#define EXT4_TXN_MAX_BLOCKS  256
+// Journals that can't hold transactions of this many blocks are not used
+#define EXT4_TXN_MIN_BLOCKS  64
+// Room that operations on a file keep for rewriting its extent tree and inode
+#define EXT4_TXN_RESERVED_BLOCKS  24
+
+typedef struct {
+  EXT4_BLOCK_NR    Start;
+  UINT64           Count;
+} EXT4_BLOCK_RANGE;
+
+typedef struct {
+  EXT4_PARTITION      *Partition;
+  // Blocks held by the transaction, see Ext4TxnGetBlock()
+  LIST_ENTRY          Blocks;
+  UINTN               NumberBlocks;
+  // Changes to the free block and inode counts of the superblock
+  INT64               FreeBlocksDelta;
+  INT64               FreeInodesDelta;
+  // Blocks freed by the transaction, which can't be reused before it commits
+  EXT4_BLOCK_RANGE    *Freed;
+  UINTN               NumberFreed;
+  UINTN               MaxFreed;
+  // Inodes written by the transaction, dropped from the inode cache when it
+  // is checkpointed
+  EXT4_INO_NR         *Inodes;
+  UINTN               NumberInodes;
+  UINTN               MaxInodes;
+} EXT4_TRANSACTION;
+
+/**
+   Opens the journal of the partition. If the journal can't be written safely,
+   the partition is made read-only instead.
+
+   @param[in out]  Partition     Pointer to the opened EXT4 partition.
+
+   @retval EFI_SUCCESS           The journal was opened, or the partition was made read-only.
+   @retval EFI_VOLUME_CORRUPTED  The journal is corrupted.
+   @retval !EFI_SUCCESS          Failure.
+**/
+EFI_STATUS
+Ext4OpenJournal (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Closes the journal of the partition.
+
+   @param[in out]  Partition     Pointer to the opened EXT4 partition.
+**/
+VOID
+Ext4CloseJournal (
+  IN OUT EXT4_PARTITION  *Partition
+  );
+
+/**
+   Starts a transaction.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[out]     Txn           Pointer to the transaction.
+
+   @retval EFI_SUCCESS           The transaction was started.
+   @retval EFI_WRITE_PROTECTED   The partition is read-only.
+**/
+EFI_STATUS
+Ext4BeginTransaction (
+  IN  EXT4_PARTITION    *Partition,
+  OUT EXT4_TRANSACTION  *Txn
+  );
+
+/**
+   Gets the transaction's copy of a metadata block, which is modified in place
+   and written by Ext4CommitTransaction().
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      Block         Block number.
+   @param[in]      Zero          If TRUE, a block that isn't held by the
+                                 transaction yet starts zeroed instead of being read.
+   @param[out]     Data          Pointer to the copy, Partition->BlockSize bytes long.
+
+   @retval EFI_SUCCESS           The copy was returned.
+   @retval EFI_OUT_OF_RESOURCES  The transaction is full, or out of memory.
+   @retval !EFI_SUCCESS          The block could not be read.
+**/
+EFI_STATUS
+Ext4TxnGetBlock (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_BLOCK_NR     Block,
+  IN     BOOLEAN           Zero,
+  OUT    UINT8             **Data
+  );
+
+/**
+   Finds the transaction's copy of a metadata block.
+
+   @param[in]      Txn           Pointer to the transaction.
+   @param[in]      Block         Block number.
+
+   @return Pointer to the copy, or NULL if the transaction doesn't hold the block.
+**/
+UINT8 *
+Ext4TxnFindBlock (
+  IN CONST EXT4_TRANSACTION  *Txn,
+  IN EXT4_BLOCK_NR           Block
+  );
+
+/**
+   Drops the transaction's copies of blocks that were freed.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      Start         First block.
+   @param[in]      Count         Number of blocks.
+**/
+VOID
+Ext4TxnForgetBlocks (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_BLOCK_NR     Start,
+  IN     UINT64            Count
+  );
+
+/**
+   Checks if a transaction may hold more blocks.
+
+   @param[in]      Txn           Pointer to the transaction.
+   @param[in]      NumberBlocks  Number of blocks that would be added.
+
+   @return TRUE if the blocks fit, else FALSE.
+**/
+BOOLEAN
+Ext4TxnHasRoom (
+  IN CONST EXT4_TRANSACTION  *Txn,
+  IN UINTN                   NumberBlocks
+  );
+
+/**
+   Commits a transaction through the journal, then writes its blocks to their
+   home locations. The transaction is freed, whatever the outcome.
+
+   @param[in out]  Txn           Pointer to the transaction.
+
+   @retval EFI_SUCCESS           The transaction is committed.
+   @retval !EFI_SUCCESS          The transaction could not be committed. If
+                                 it might be partially applied, the partition
+                                 is made read-only, and the transaction is
+                                 left for the journal recovery of the next
+                                 mount by Linux.
+**/
+EFI_STATUS
+Ext4CommitTransaction (
+  IN OUT EXT4_TRANSACTION  *Txn
+  );
+
+/**
+   Drops a transaction without writing anything.
+
+   @param[in out]  Txn           Pointer to the transaction.
+**/
+VOID
+Ext4AbortTransaction (
+  IN OUT EXT4_TRANSACTION  *Txn
+  );
+
+/**
+   Allocates a run of blocks, as close as possible to a goal block.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      Goal          Preferred first block.
+   @param[in]      Count         Wanted number of blocks.
+   @param[out]     Start         First allocated block.
+   @param[out]     Allocated     Number of allocated blocks, between 1 and Count.
+
+   @retval EFI_SUCCESS           Blocks were allocated.
+   @retval EFI_VOLUME_FULL       No block is free.
+   @retval EFI_OUT_OF_RESOURCES  The transaction is full.
+   @retval !EFI_SUCCESS          Failure.
+**/
+EFI_STATUS
+Ext4AllocateBlocks (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_BLOCK_NR     Goal,
+  IN     UINT32            Count,
+  OUT    EXT4_BLOCK_NR     *Start,
+  OUT    UINT32            *Allocated
+  );
+
+/**
+   Frees a run of blocks.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      Start         First block.
+   @param[in]      Count         Number of blocks.
+
+   @retval EFI_SUCCESS           The blocks were freed.
+   @retval EFI_VOLUME_CORRUPTED  Some of the blocks are not in use.
+   @retval !EFI_SUCCESS          Failure.
+**/
+EFI_STATUS
+Ext4FreeBlocks (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_BLOCK_NR     Start,
+  IN     UINT64            Count
+  );
+
+/**
+   Picks the block that allocations for an inode without blocks start from.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      InodeNum      Inode number.
+
+   @return The first block of the inode's block group.
+**/
+EXT4_BLOCK_NR
+Ext4InodeGoalBlock (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_INO_NR     InodeNum
+  );
+
+/**
+   Allocates an inode number.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      Parent        Inode number of the parent directory.
+   @param[in]      IsDir         TRUE if the inode is for a directory.
+   @param[out]     InodeNum      Allocated inode number.
+
+   @retval EFI_SUCCESS           The inode number was allocated.
+   @retval EFI_VOLUME_FULL       No inode is free.
+   @retval !EFI_SUCCESS          Failure.
+**/
+EFI_STATUS
+Ext4AllocateInodeNr (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_INO_NR       Parent,
+  IN     BOOLEAN           IsDir,
+  OUT    EXT4_INO_NR       *InodeNum
+  );
+
+/**
+   Frees an inode number.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      InodeNum      Inode number.
+   @param[in]      IsDir         TRUE if the inode was a directory.
+
+   @retval EFI_SUCCESS           The inode number was freed.
+   @retval EFI_VOLUME_CORRUPTED  The inode is not in use.
+   @retval !EFI_SUCCESS          Failure.
+**/
+EFI_STATUS
+Ext4FreeInodeNr (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_INO_NR       InodeNum,
+  IN     BOOLEAN           IsDir
+  );
+
+/**
+   Gets the transaction's copy of an inode, in its inode table block.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      InodeNum      Inode number.
+   @param[out]     Inode         Pointer to the copy of the inode.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4TxnGetInode (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_INO_NR       InodeNum,
+  OUT    EXT4_INODE        **Inode
+  );
+
+/**
+   Stores an inode in a transaction, updating its checksum.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      InodeNum      Inode number.
+   @param[in out]  Inode         Pointer to the inode, Partition->InodeSize bytes long.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4TxnWriteInode (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_INO_NR       InodeNum,
+  IN OUT EXT4_INODE        *Inode
+  );
+
+/**
+   Updates the open files of an inode after the inode was modified.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      InodeNum      Inode number.
+   @param[in]      Inode         Pointer to the new inode.
+**/
+VOID
+Ext4RefreshOpenFiles (
+  IN EXT4_PARTITION    *Partition,
+  IN EXT4_INO_NR       InodeNum,
+  IN CONST EXT4_INODE  *Inode
+  );
+
+/**
+   Adds blocks to, or removes blocks from, the block count of an inode.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in out]  Inode         Pointer to the inode.
+   @param[in]      Delta         Number of filesystem blocks to add.
+
+   @retval EFI_SUCCESS           The count was updated.
+   @retval EFI_UNSUPPORTED       The count doesn't fit in the inode.
+**/
+EFI_STATUS
+Ext4AddInodeBlocks (
+  IN     EXT4_PARTITION  *Partition,
+  IN OUT EXT4_INODE      *Inode,
+  IN     INT64           Delta
+  );
+
+/**
+   Writes to a file, allocating the blocks it needs.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      Buffer        Pointer to the buffer.
+   @param[in]      Offset        Offset of the write.
+   @param[in out]  Length        Pointer to the length of the buffer, in bytes.
+                                 It's updated to the number of written bytes,
+                                 which may be short of it if the volume is full.
+
+   @return Status of the write operation.
+**/
+EFI_STATUS
+Ext4Write (
+  IN     EXT4_PARTITION  *Partition,
+  IN     EXT4_FILE       *File,
+  IN     CONST VOID      *Buffer,
+  IN     UINT64          Offset,
+  IN OUT UINTN           *Length
+  );
+
+/**
+   Changes the size of a file. Files grow sparsely, and the blocks past the end
+   of shrunk files are freed.
+
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      NewSize       New size of the file, in bytes.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4SetFileSize (
+  IN EXT4_FILE  *File,
+  IN UINT64     NewSize
+  );
+
+/**
+   Frees every block of a file, including its extent tree, in one transaction.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      File          Pointer to the opened file.
+   @param[in out]  Inode         Pointer to the transaction's working copy of the inode.
+
+   @retval EFI_SUCCESS           The blocks were freed.
+   @retval EFI_OUT_OF_RESOURCES  The file has too many extents for the transaction.
+   @retval !EFI_SUCCESS          Failure.
+**/
+EFI_STATUS
+Ext4TxnFreeFileBlocks (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_FILE         *File,
+  IN OUT EXT4_INODE        *Inode
+  );
+
+/**
+   Creates a file or a directory.
+
+   @param[in]      Directory     Pointer to the opened parent directory.
+   @param[in]      Name          Pointer to the UCS-2 formatted filename.
+   @param[in]      Attributes    EFI_FILE_* attributes of the new file.
+   @param[out]     Entry         Directory entry of the new file.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4CreateFile (
+  IN  EXT4_FILE       *Directory,
+  IN  CONST CHAR16    *Name,
+  IN  UINT64          Attributes,
+  OUT EXT4_DIR_ENTRY  *Entry
+  );
+
+/**
+   Removes the directory entry of a file, and frees the file once it has
+   no links left.
+
+   @param[in]      File          Pointer to the opened file, which must be
+                                 the file's only open handle.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4Unlink (
+  IN EXT4_FILE  *File
+  );
+
 #endif
@@ -7,32 +7,6 @@
 
 #include "Ext4Dxe.h"
 
-/**
-   Checks if the checksum of the extent data block is correct.
-   @param[in]      ExtHeader     Pointer to the EXT4_EXTENT_HEADER.
-   @param[in]      File          Pointer to the file.
-
-   @return TRUE if the checksum is correct, FALSE if there is corruption.
-**/
-BOOLEAN
-Ext4CheckExtentChecksum (
-  IN CONST EXT4_EXTENT_HEADER  *ExtHeader,
-  IN CONST EXT4_FILE           *File
-  );
-
-/**
-   Calculates the checksum of the extent data block.
-   @param[in]      ExtHeader     Pointer to the EXT4_EXTENT_HEADER.
-   @param[in]      File          Pointer to the file.
-
-   @return The checksum.
-**/
-UINT32
-Ext4CalculateExtentChecksum (
-  IN CONST EXT4_EXTENT_HEADER  *ExtHeader,
-  IN CONST EXT4_FILE           *File
-  );
-
 /**
    Caches a range of extents, by allocating pool memory for each extent and adding it to the tree.
 
@@ -84,7 +58,6 @@ Ext4GetInoExtentHeader (
 
    @return TRUE if valid, FALSE if not.
 **/
-STATIC
 BOOLEAN
 Ext4ExtentHeaderValid (
   IN CONST EXT4_EXTENT_HEADER  *Header,
@@ -229,6 +202,120 @@ Ext4ExtentIdxLeafBlock (
 // Results of sizeof(i_data) / sizeof(extent) - 1 = 4
 #define EXT4_NR_INLINE_EXTENTS  4
 
+/**
+   Describes the file hole around a logical block that no extent of a leaf covers,
+   as an uninitialized extent with no physical blocks, like Ext4GetBlocks does.
+
+   @param[in]      Header         Pointer to the leaf's EXT4_EXTENT_HEADER.
+   @param[in]      Ext            Extent returned by Ext4BinsearchExtentExt, or NULL.
+   @param[in]      LogicalBlock   Block inside the hole.
+   @param[in]      LowerBound     First logical block the leaf may map.
+   @param[in]      UpperBound     First logical block past the ones the leaf may map.
+   @param[out]     Hole           Pointer to the hole extent.
+
+   @return TRUE if the hole starts exactly at Hole->ee_block and can be cached,
+           FALSE if Hole only describes the hole from LogicalBlock onwards.
+**/
+STATIC
+BOOLEAN
+Ext4GetHoleExtent (
+  IN  EXT4_EXTENT_HEADER  *Header,
+  IN  EXT4_EXTENT         *Ext OPTIONAL,
+  IN  UINT32              LogicalBlock,
+  IN  UINT64              LowerBound,
+  IN  UINT64              UpperBound,
+  OUT EXT4_EXTENT         *Hole
+  )
+{
+  EXT4_EXTENT  *First;
+  EXT4_EXTENT  *Next;
+  UINT64       HoleStart;
+  UINT64       HoleEnd;
+  BOOLEAN      Exact;
+
+  First = (EXT4_EXTENT *)(Header + 1);
+  Exact = TRUE;
+
+  if ((Ext != NULL) && (Ext->ee_block <= LogicalBlock)) {
+    HoleStart = (UINT64)Ext->ee_block + Ext4GetExtentLength (Ext);
+    Next      = Ext + 1;
+  } else {
+    // Either the leaf is empty or the block comes before its first extent
+    HoleStart = LowerBound;
+    Next      = First;
+  }
+
+  if (HoleStart > LogicalBlock) {
+    // Only possible on a corrupted tree
+    HoleStart = LogicalBlock;
+    Exact     = FALSE;
+  }
+
+  HoleEnd = (Next < First + Header->eh_entries) ? Next->ee_block : UpperBound;
+
+  if (HoleEnd <= LogicalBlock) {
+    HoleEnd = (UINT64)LogicalBlock + 1;
+    Exact   = FALSE;
+  }
+
+  // Holes are split in chunks of the largest uninitialized extent, aligned to
+  // the start of the hole so that cached chunks never overlap.
+  if (HoleEnd - HoleStart > EXT4_EXTENT_MAX_INITIALIZED - 1) {
+    HoleStart += MultU64x32 (
+                   DivU64x32 (LogicalBlock - HoleStart, EXT4_EXTENT_MAX_INITIALIZED - 1),
+                   EXT4_EXTENT_MAX_INITIALIZED - 1
+                   );
+    HoleEnd = MIN (HoleEnd, HoleStart + EXT4_EXTENT_MAX_INITIALIZED - 1);
+  }
+
+  Hole->ee_block    = (UINT32)HoleStart;
+  Hole->ee_len      = (UINT16)(EXT4_EXTENT_MAX_INITIALIZED + (HoleEnd - HoleStart));
+  Hole->ee_start_hi = 0;
+  Hole->ee_start_lo = 0;
+
+  return Exact;
+}
+
+/**
+   Caches the file holes between the extents of a leaf, as uninitialized extents
+   with no physical blocks. Holes larger than an uninitialized extent are left
+   to Ext4GetHoleExtent.
+
+   @param[in]      File          Pointer to the open file.
+   @param[in]      Header        Pointer to the leaf's EXT4_EXTENT_HEADER.
+**/
+STATIC
+VOID
+Ext4CacheLeafHoles (
+  IN EXT4_FILE           *File,
+  IN EXT4_EXTENT_HEADER  *Header
+  )
+{
+  EXT4_EXTENT  *Extents;
+  EXT4_EXTENT  Hole;
+  UINT64       HoleStart;
+  UINT16       Index;
+
+  Extents = (EXT4_EXTENT *)(Header + 1);
+
+  for (Index = 1; Index < Header->eh_entries; Index++) {
+    HoleStart = (UINT64)Extents[Index - 1].ee_block + Ext4GetExtentLength (&Extents[Index - 1]);
+
+    if ((HoleStart >= Extents[Index].ee_block) ||
+        (Extents[Index].ee_block - HoleStart > EXT4_EXTENT_MAX_INITIALIZED - 1))
+    {
+      continue;
+    }
+
+    Hole.ee_block    = (UINT32)HoleStart;
+    Hole.ee_len      = (UINT16)(EXT4_EXTENT_MAX_INITIALIZED + (Extents[Index].ee_block - HoleStart));
+    Hole.ee_start_hi = 0;
+    Hole.ee_start_lo = 0;
+
+    Ext4CacheExtents (File, &Hole, 1);
+  }
+}
+
 /**
    Retrieves an extent from an EXT4 inode.
    @param[in]      Partition     Pointer to the opened EXT4 partition.
@@ -236,6 +323,8 @@ Ext4ExtentIdxLeafBlock (
    @param[in]      LogicalBlock  Block number which the returned extent must cover.
    @param[out]     Extent        Pointer to the output buffer, where the extent will be copied to.
 
+   File holes are returned as uninitialized extents with no physical blocks.
+
    @retval EFI_SUCCESS        Retrieval was successful.
    @retval EFI_NO_MAPPING     Block has no mapping.
 **/
@@ -256,11 +345,18 @@ Ext4GetExtent (
   EFI_STATUS          Status;
   UINT32              MaxExtentsPerNode;
   EXT4_BLOCK_NR       BlockNumber;
+  UINT64              LowerBound;
+  UINT64              UpperBound;
+  EXT4_EXTENT         Hole;
 
   Inode  = File->Inode;
   Ext    = NULL;
   Buffer = NULL;
 
+  // Range of logical blocks that the current tree node maps
+  LowerBound = 0;
+  UpperBound = BIT32;
+
   DEBUG ((DEBUG_FS, "[ext4] Looking up extent for block %lu\n", LogicalBlock));
 
   // ext4 does not have support for logical block numbers bigger than UINT32_MAX
@@ -268,8 +364,7 @@ Ext4GetExtent (
     return EFI_NO_MAPPING;
   }
 
-  // Note: Right now, holes are the single biggest reason for cache misses
-  // We should find a way to get (or cache) holes
+  // Note: Holes are cached too, as uninitialized extents with no physical blocks
   if ((Ext = Ext4GetExtentFromMap (File, (UINT32)LogicalBlock)) != NULL) {
     *Extent = *Ext;
 
@@ -315,6 +410,16 @@ Ext4GetExtent (
     Index       = Ext4BinsearchExtentIndex (ExtHeader, LogicalBlock);
     BlockNumber = Ext4ExtentIdxLeafBlock (Index);
 
+    if (Index->ei_block > LowerBound) {
+      LowerBound = Index->ei_block;
+    }
+
+    if ((Index + 1 < (EXT4_EXTENT_INDEX *)(ExtHeader + 1) + ExtHeader->eh_entries) &&
+        ((Index + 1)->ei_block < UpperBound))
+    {
+      UpperBound = (Index + 1)->ei_block;
+    }
+
     // Check that block isn't file hole
     if (BlockNumber == EXT4_BLOCK_FILE_HOLE) {
       if (Buffer != NULL) {
@@ -333,7 +438,7 @@ Ext4GetExtent (
 
     // Read the leaf block onto the previously-allocated buffer.
 
-    Status = Ext4ReadBlocks (Partition, Buffer, 1, BlockNumber);
+    Status = Ext4ReadBlocksCached (Partition, Ext4BlockCacheMetadata, Buffer, 1, BlockNumber);
     if (EFI_ERROR (Status)) {
       FreePool (Buffer);
       return Status;
@@ -364,24 +469,26 @@ Ext4GetExtent (
    * Therefore, we shouldn't have any memory issues.
   **/
   Ext4CacheExtents (File, (EXT4_EXTENT *)(ExtHeader + 1), ExtHeader->eh_entries);
+  Ext4CacheLeafHoles (File, ExtHeader);
 
   Ext = Ext4BinsearchExtentExt (ExtHeader, LogicalBlock);
 
-  if (!Ext) {
-    if (Buffer != NULL) {
-      FreePool (Buffer);
+  if ((Ext == NULL) ||
+      !((LogicalBlock >= Ext->ee_block) && (Ext->ee_block + Ext4GetExtentLength (Ext) > LogicalBlock)))
+  {
+    // No extent covers the block, so it's part of a file hole. Describe the whole hole,
+    // and cache it so that reads of sparse files don't walk the tree for every block.
+    if (Ext4GetHoleExtent (ExtHeader, Ext, (UINT32)LogicalBlock, LowerBound, UpperBound, &Hole)) {
+      Ext4CacheExtents (File, &Hole, 1);
     }
 
-    return EFI_NO_MAPPING;
-  }
+    *Extent = Hole;
 
-  if (!((LogicalBlock >= Ext->ee_block) && (Ext->ee_block + Ext4GetExtentLength (Ext) > LogicalBlock))) {
-    // This extent does not cover the block
     if (Buffer != NULL) {
       FreePool (Buffer);
     }
 
-    return EFI_NO_MAPPING;
+    return EFI_SUCCESS;
   }
 
   *Extent = *Ext;
@@ -485,12 +592,13 @@ Ext4InitExtentsMap (
 }
 
 /**
-   Frees the extents map, deleting every extent stored.
+   Empties the extents map, deleting every extent stored, after the file's
+   extents were modified.
 
    @param[in]      File        Pointer to the open file.
 **/
 VOID
-Ext4FreeExtentsMap (
+Ext4ResetExtentsMap (
   IN EXT4_FILE  *File
   )
 {
@@ -508,6 +616,19 @@ Ext4FreeExtentsMap (
   }
 
   ASSERT (OrderedCollectionIsEmpty (File->ExtentsMap));
+}
+
+/**
+   Frees the extents map, deleting every extent stored.
+
+   @param[in]      File        Pointer to the open file.
+**/
+VOID
+Ext4FreeExtentsMap (
+  IN EXT4_FILE  *File
+  )
+{
+  Ext4ResetExtentsMap (File);
 
   OrderedCollectionUninit (File->ExtentsMap);
   File->ExtentsMap = NULL;
@@ -605,7 +726,7 @@ Ext4CalculateExtentChecksum (
 
   Csum = Ext4CalculateChecksum (Partition, &File->InodeNum, sizeof (EXT4_INO_NR), Partition->InitialSeed);
   Csum = Ext4CalculateChecksum (Partition, &Inode->i_generation, sizeof (Inode->i_generation), Csum);
-  Csum = Ext4CalculateChecksum (Partition, ExtHeader, Partition->BlockSize - sizeof (EXT4_EXTENT_TAIL), Csum);
+  Csum = Ext4CalculateChecksum (Partition, ExtHeader, EXT4_EXTENT_TAIL_OFFSET (ExtHeader), Csum);
 
   return Csum;
 }
@@ -632,7 +753,9 @@ Ext4CheckExtentChecksum (
     return TRUE;
   }
 
-  Tail = (EXT4_EXTENT_TAIL *)((CONST CHAR8 *)ExtHeader + (Partition->BlockSize - 4));
+  // The tail follows the last possible entry of the node, which isn't always at the
+  // end of the block (e.g. with 2KiB blocks, where a node only takes 2040 bytes)
+  Tail = (EXT4_EXTENT_TAIL *)((CONST CHAR8 *)ExtHeader + EXT4_EXTENT_TAIL_OFFSET (ExtHeader));
 
   return Tail->eb_checksum == Ext4CalculateExtentChecksum (ExtHeader, File);
 }
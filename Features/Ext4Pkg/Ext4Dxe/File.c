@@ -98,6 +98,7 @@ Ext4IsLastPathSegment (
 #define EXT4_INO_PERM_READ_OWNER   0400
 #define EXT4_INO_PERM_WRITE_OWNER  0200
 #define EXT4_INO_PERM_EXEC_OWNER   0100
+#define EXT4_INO_PERM_WRITE_ALL    0222
 
 /**
    Detects if we have permissions to open the file on the desired mode.
@@ -154,6 +155,46 @@ Ext4DirCanLookup (
   return (File->Inode->i_mode & EXT4_INO_PERM_EXEC_OWNER) == EXT4_INO_PERM_EXEC_OWNER;
 }
 
+/**
+   Creates a file in a directory, and opens it.
+
+   @param[in]      Directory   Pointer to the open directory.
+   @param[in]      Name        Pointer to the UCS-2 formatted filename.
+   @param[in]      Attributes  EFI_FILE_* attributes of the new file.
+   @param[out]     OutFile     Pointer to the opened file.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4CreateInPath (
+  IN  EXT4_FILE     *Directory,
+  IN  CONST CHAR16  *Name,
+  IN  UINT64        Attributes,
+  OUT EXT4_FILE     **OutFile
+  )
+{
+  EXT4_DIR_ENTRY  Entry;
+  EFI_STATUS      Status;
+
+  if (Directory->Partition->ReadOnly) {
+    return EFI_WRITE_PROTECTED;
+  }
+
+  // Adding entries to a directory takes permission to write to it and to search it
+  if (!Ext4DirCanLookup (Directory) || ((Directory->Inode->i_mode & EXT4_INO_PERM_WRITE_OWNER) == 0)) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  Status = Ext4CreateFile (Directory, Name, Attributes, &Entry);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return Ext4OpenDirent (Directory->Partition, EFI_FILE_MODE_READ, OutFile, &Entry, Directory);
+}
+
 /**
   Opens a new file relative to the source file's location.
 
@@ -201,10 +242,12 @@ Ext4OpenInternal (
   EXT4_FILE       *File;
   CHAR16          *Symlink;
   EFI_STATUS      Status;
+  BOOLEAN         Created;
 
   Current   = Source;
   Partition = Current->Partition;
   Level     = 0;
+  Created   = FALSE;
 
   DEBUG ((DEBUG_FS, "[ext4] Ext4OpenInternal %s\n", FileName));
 
@@ -259,11 +302,12 @@ Ext4OpenInternal (
 
     Status = Ext4OpenFile (Current, PathSegment, Partition, EFI_FILE_MODE_READ, &File);
 
-    if (EFI_ERROR (Status) && (Status != EFI_NOT_FOUND)) {
-      return Status;
-    } else if (Status == EFI_NOT_FOUND) {
-      // We explicitly ignore the EFI_FILE_MODE_CREATE flag, since we don't have write support
-      /// If/ we add write support, this should be changed.
+    if ((Status == EFI_NOT_FOUND) && ((OpenMode & EFI_FILE_MODE_CREATE) != 0) && Ext4IsLastPathSegment (FileName)) {
+      Status = Ext4CreateInPath (Current, PathSegment, Attributes, &File);
+      Created = !EFI_ERROR (Status);
+    }
+
+    if (EFI_ERROR (Status)) {
       return Status;
     }
 
@@ -325,7 +369,15 @@ Ext4OpenInternal (
     }
   }
 
-  if (!Ext4ApplyPermissions (Current, OpenMode)) {
+  if (((OpenMode & EFI_FILE_MODE_WRITE) != 0) && Partition->ReadOnly) {
+    Ext4CloseInternal (Current);
+    return EFI_WRITE_PROTECTED;
+  }
+
+  // Files created read-only may still be written through the handle that created them
+  if (Created) {
+    Current->OpenMode = OpenMode;
+  } else if (!Ext4ApplyPermissions (Current, OpenMode)) {
     Ext4CloseInternal (Current);
     return EFI_ACCESS_DENIED;
   }
@@ -437,6 +489,7 @@ Ext4CloseInternal (
   RemoveEntryList (&File->OpenFilesListNode);
   FreePool (File->Inode);
   Ext4FreeExtentsMap (File);
+  Ext4FreeReadDirBlock (File);
   Ext4UnrefDentry (File->Dentry);
   FreePool (File);
   return EFI_SUCCESS;
@@ -458,9 +511,22 @@ Ext4Delete (
   IN EFI_FILE_PROTOCOL  *This
   )
 {
-  // We do a regular close here since we don't have write support.
-  Ext4Close (This);
-  return EFI_WARN_DELETE_FAILURE;
+  EXT4_FILE   *File;
+  EFI_STATUS  Status;
+
+  File   = EXT4_FILE_FROM_THIS (This);
+  Status = EFI_ACCESS_DENIED;
+
+  if ((File->OpenMode & EFI_FILE_MODE_WRITE) != 0) {
+    Status = Ext4Unlink (File);
+  }
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_FS, "[ext4] Failed to delete inode %u: %r\n", File->InodeNum, Status));
+  }
+
+  Ext4CloseInternal (File);
+  return EFI_ERROR (Status) ? EFI_WARN_DELETE_FAILURE : EFI_SUCCESS;
 }
 
 /**
@@ -544,15 +610,28 @@ Ext4WriteFile (
   IN VOID               *Buffer
   )
 {
-  EXT4_FILE  *File;
+  EXT4_FILE   *File;
+  EFI_STATUS  Status;
 
   File = EXT4_FILE_FROM_THIS (This);
 
+  if (File->Partition->ReadOnly) {
+    return EFI_WRITE_PROTECTED;
+  }
+
   if (!(File->OpenMode & EFI_FILE_MODE_WRITE)) {
     return EFI_ACCESS_DENIED;
   }
 
-  return EFI_WRITE_PROTECTED;
+  if (!Ext4FileIsReg (File)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  // Short writes (e.g. when the volume fills up) still move the position
+  Status          = Ext4Write (File->Partition, File, Buffer, File->Position, BufferSize);
+  File->Position += *BufferSize;
+
+  return Status;
 }
 
 /**
@@ -627,32 +706,28 @@ Ext4SetPosition (
 }
 
 /**
-   Retrieves information about the file and stores it in the EFI_FILE_INFO format.
+   Retrieves information about a file under the given name and stores it in
+   the EFI_FILE_INFO format. Only the Inode and Partition fields of File are
+   used, so the file doesn't need to be opened.
 
-   @param[in]      File           Pointer to an opened file.
+   @param[in]      File           Pointer to the file.
+   @param[in]      FileName       Name of the file.
    @param[out]     Info           Pointer to a EFI_FILE_INFO.
    @param[in out]  BufferSize     Pointer to the buffer size
 
    @return Status of the file information request.
 **/
 EFI_STATUS
-Ext4GetFileInfo (
+Ext4GetFileInfoWithName (
   IN EXT4_FILE       *File,
+  IN CONST CHAR16    *FileName,
   OUT EFI_FILE_INFO  *Info,
   IN OUT UINTN       *BufferSize
   )
 {
-  UINTN         FileNameLen;
-  UINTN         FileNameSize;
-  UINTN         NeededLength;
-  CONST CHAR16  *FileName;
-
-  if (File->InodeNum == EXT4_ROOT_INODE_NR) {
-    // Root inode gets a filename of "", regardless of how it was opened.
-    FileName = L"";
-  } else {
-    FileName = File->Dentry->Name;
-  }
+  UINTN  FileNameLen;
+  UINTN  FileNameSize;
+  UINTN  NeededLength;
 
   FileNameLen  = StrLen (FileName);
   FileNameSize = StrSize (FileName);
@@ -676,11 +751,43 @@ Ext4GetFileInfo (
     Info->Attribute |= EFI_FILE_DIRECTORY;
   }
 
+  if ((File->Inode->i_mode & EXT4_INO_PERM_WRITE_OWNER) == 0) {
+    Info->Attribute |= EFI_FILE_READ_ONLY;
+  }
+
   *BufferSize = NeededLength;
 
   return StrCpyS (Info->FileName, FileNameLen + 1, FileName);
 }
 
+/**
+   Retrieves information about the file and stores it in the EFI_FILE_INFO format.
+
+   @param[in]      File           Pointer to an opened file.
+   @param[out]     Info           Pointer to a EFI_FILE_INFO.
+   @param[in out]  BufferSize     Pointer to the buffer size
+
+   @return Status of the file information request.
+**/
+EFI_STATUS
+Ext4GetFileInfo (
+  IN EXT4_FILE       *File,
+  OUT EFI_FILE_INFO  *Info,
+  IN OUT UINTN       *BufferSize
+  )
+{
+  CONST CHAR16  *FileName;
+
+  if (File->InodeNum == EXT4_ROOT_INODE_NR) {
+    // Root inode gets a filename of "", regardless of how it was opened.
+    FileName = L"";
+  } else {
+    FileName = File->Dentry->Name;
+  }
+
+  return Ext4GetFileInfoWithName (File, FileName, Info, BufferSize);
+}
+
 /**
    Retrieves the volume name.
 
@@ -954,6 +1061,135 @@ Ext4DuplicateFile (
   return File;
 }
 
+/**
+   Checks if an EFI_TIME holds a time to set, rather than zeroes.
+
+   @param[in]      Time        Pointer to the time.
+
+   @return TRUE if the time is to be set, else FALSE.
+**/
+STATIC
+BOOLEAN
+Ext4TimeIsSet (
+  IN CONST EFI_TIME  *Time
+  )
+{
+  return !IsZeroBuffer (Time, sizeof (*Time));
+}
+
+/**
+   Changes the size, the attributes and the timestamps of a file.
+
+   @param[in]      File           Pointer to an opened file.
+   @param[in]      Info           Pointer to the new EFI_FILE_INFO.
+   @param[in]      BufferSize     Size of the buffer Info points to.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4SetFileInfo (
+  IN EXT4_FILE            *File,
+  IN CONST EFI_FILE_INFO  *Info,
+  IN UINTN                BufferSize
+  )
+{
+  EXT4_PARTITION    *Partition;
+  EXT4_TRANSACTION  Txn;
+  EXT4_INODE        *Inode;
+  CONST CHAR16      *Name;
+  EFI_STATUS        Status;
+  BOOLEAN           IsDir;
+
+  Partition = File->Partition;
+  IsDir     = Ext4FileIsDir (File);
+
+  if (  (BufferSize < SIZE_OF_EFI_FILE_INFO + sizeof (CHAR16)) || (Info->Size > BufferSize)
+     || (Info->Size < SIZE_OF_EFI_FILE_INFO + sizeof (CHAR16)))
+  {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  if ((Info->Attribute & ~EFI_FILE_VALID_ATTR) != 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (IsDir != ((Info->Attribute & EFI_FILE_DIRECTORY) != 0)) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  Name = File->InodeNum == EXT4_ROOT_INODE_NR ? L"" : File->Dentry->Name;
+
+  if (StrCmp (Info->FileName, Name) != 0) {
+    // Renames aren't supported
+    return EFI_UNSUPPORTED;
+  }
+
+  if (Info->FileSize != EXT4_INODE_SIZE (File->Inode)) {
+    if (IsDir || !Ext4FileIsReg (File)) {
+      return EFI_ACCESS_DENIED;
+    }
+
+    if (!(File->OpenMode & EFI_FILE_MODE_WRITE)) {
+      return EFI_ACCESS_DENIED;
+    }
+
+    Status = Ext4SetFileSize (File, Info->FileSize);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  Inode = AllocateCopyPool (Partition->InodeSize, File->Inode);
+
+  if (Inode == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if ((Info->Attribute & EFI_FILE_READ_ONLY) != 0) {
+    Inode->i_mode &= ~EXT4_INO_PERM_WRITE_ALL;
+  } else if ((Inode->i_mode & EXT4_INO_PERM_WRITE_OWNER) == 0) {
+    Inode->i_mode |= EXT4_INO_PERM_WRITE_OWNER;
+  }
+
+  if (Ext4TimeIsSet (&Info->LastAccessTime)) {
+    Ext4SetInodeTimes (Inode, EXT4_INODE_ATIME, &Info->LastAccessTime);
+  }
+
+  if (Ext4TimeIsSet (&Info->ModificationTime)) {
+    Ext4SetInodeTimes (Inode, EXT4_INODE_MTIME, &Info->ModificationTime);
+  }
+
+  if (Ext4TimeIsSet (&Info->CreateTime)) {
+    Ext4SetInodeTimes (Inode, EXT4_INODE_CRTIME, &Info->CreateTime);
+  }
+
+  Ext4SetInodeTimes (Inode, EXT4_INODE_CTIME, NULL);
+
+  Status = Ext4BeginTransaction (Partition, &Txn);
+
+  if (EFI_ERROR (Status)) {
+    FreePool (Inode);
+    return Status;
+  }
+
+  Status = Ext4TxnWriteInode (&Txn, File->InodeNum, Inode);
+
+  if (EFI_ERROR (Status)) {
+    Ext4AbortTransaction (&Txn);
+  } else {
+    Status = Ext4CommitTransaction (&Txn);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Ext4RefreshOpenFiles (Partition, File->InodeNum, Inode);
+  }
+
+  FreePool (Inode);
+  return Status;
+}
+
 /**
   Sets information about a file.
 
@@ -1007,6 +1243,47 @@ Ext4SetInfo (
     return EFI_WRITE_PROTECTED;
   }
 
-  // There's no write support just yet.
+  if (CompareGuid (InformationType, &gEfiFileInfoGuid)) {
+    return Ext4SetFileInfo (File, Buffer, BufferSize);
+  }
+
+  // Volume labels can't be changed
   return EFI_UNSUPPORTED;
 }
+
+/**
+  Flushes all modified data associated with a file to a device.
+
+  @param[in]  This            A pointer to the EFI_FILE_PROTOCOL instance that is the file
+                              handle to flush.
+
+  @retval EFI_SUCCESS          The data was flushed.
+  @retval EFI_NO_MEDIA         The device has no medium.
+  @retval EFI_DEVICE_ERROR     The device reported an error.
+  @retval EFI_VOLUME_CORRUPTED The file system structures are corrupted.
+  @retval EFI_WRITE_PROTECTED  The file or medium is write-protected.
+  @retval EFI_ACCESS_DENIED    The file was opened read-only.
+  @retval EFI_VOLUME_FULL      The volume is full.
+
+**/
+EFI_STATUS
+EFIAPI
+Ext4Flush (
+  IN EFI_FILE_PROTOCOL  *This
+  )
+{
+  EXT4_FILE  *File;
+
+  File = EXT4_FILE_FROM_THIS (This);
+
+  if (File->Partition->ReadOnly) {
+    return EFI_WRITE_PROTECTED;
+  }
+
+  if (!(File->OpenMode & EFI_FILE_MODE_WRITE)) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  // Metadata is committed as it changes, so only the disk's caches are left
+  return Ext4FlushDisk (File->Partition);
+}
@@ -0,0 +1,691 @@
+/** @file
+  Hash tree (htree) directory lookup
+
+  Copyright (c) 2024 Pedro Falcato All rights reserved.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  Indexed directories keep their entries in leaf blocks sorted by the hash of
+  the name, and an index of at most EXT4_HTREE_LEVEL levels (two without the
+  LARGEDIR feature) maps hash ranges to leaf blocks. A lookup hashes the name
+  with the directory's algorithm and the filesystem's seed, walks the index
+  down to one leaf, and only searches that leaf (and the next ones, if the hash
+  collides across blocks).
+
+  The hash functions are the ones from the Linux kernel's fs/ext4/hash.c.
+**/
+
+#include "Ext4Dxe.h"
+
+#include <Library/BaseUcs2Utf8Lib.h>
+
+#define EXT4_TEA_DELTA  0x9E3779B9U
+
+#define EXT4_HALF_MD4_K1  0U
+#define EXT4_HALF_MD4_K2  013240474631U
+#define EXT4_HALF_MD4_K3  015666365641U
+
+// MD4 basic functions: selection, majority and parity
+#define EXT4_MD4_F(x, y, z)  ((z) ^ ((x) & ((y) ^ (z))))
+#define EXT4_MD4_G(x, y, z)  (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define EXT4_MD4_H(x, y, z)  ((x) ^ (y) ^ (z))
+
+#define EXT4_MD4_ROUND(f, a, b, c, d, x, s)                                    \
+  (a) = LRotU32 ((a) + f ((b), (c), (d)) + (x), (s))
+
+/**
+   One round of the TEA block cipher, used as a hash.
+
+   @param[in out]  Buf   Hash state.
+   @param[in]      In    Four words of input.
+**/
+STATIC
+VOID
+Ext4TeaTransform (
+  IN OUT UINT32    Buf[4],
+  IN CONST UINT32  In[4]
+  )
+{
+  UINT32  Sum;
+  UINT32  B0;
+  UINT32  B1;
+  UINTN   Round;
+
+  Sum = 0;
+  B0  = Buf[0];
+  B1  = Buf[1];
+
+  for (Round = 0; Round < 16; Round++) {
+    Sum += EXT4_TEA_DELTA;
+    B0  += ((B1 << 4) + In[0]) ^ (B1 + Sum) ^ ((B1 >> 5) + In[1]);
+    B1  += ((B0 << 4) + In[2]) ^ (B0 + Sum) ^ ((B0 >> 5) + In[3]);
+  }
+
+  Buf[0] += B0;
+  Buf[1] += B1;
+}
+
+/**
+   A cut-down version of the MD4 transform, with three rounds of eight steps.
+
+   @param[in out]  Buf   Hash state.
+   @param[in]      In    Eight words of input.
+**/
+STATIC
+VOID
+Ext4HalfMd4Transform (
+  IN OUT UINT32    Buf[4],
+  IN CONST UINT32  In[8]
+  )
+{
+  UINT32  A;
+  UINT32  B;
+  UINT32  C;
+  UINT32  D;
+
+  A = Buf[0];
+  B = Buf[1];
+  C = Buf[2];
+  D = Buf[3];
+
+  EXT4_MD4_ROUND (EXT4_MD4_F, A, B, C, D, In[0] + EXT4_HALF_MD4_K1, 3);
+  EXT4_MD4_ROUND (EXT4_MD4_F, D, A, B, C, In[1] + EXT4_HALF_MD4_K1, 7);
+  EXT4_MD4_ROUND (EXT4_MD4_F, C, D, A, B, In[2] + EXT4_HALF_MD4_K1, 11);
+  EXT4_MD4_ROUND (EXT4_MD4_F, B, C, D, A, In[3] + EXT4_HALF_MD4_K1, 19);
+  EXT4_MD4_ROUND (EXT4_MD4_F, A, B, C, D, In[4] + EXT4_HALF_MD4_K1, 3);
+  EXT4_MD4_ROUND (EXT4_MD4_F, D, A, B, C, In[5] + EXT4_HALF_MD4_K1, 7);
+  EXT4_MD4_ROUND (EXT4_MD4_F, C, D, A, B, In[6] + EXT4_HALF_MD4_K1, 11);
+  EXT4_MD4_ROUND (EXT4_MD4_F, B, C, D, A, In[7] + EXT4_HALF_MD4_K1, 19);
+
+  EXT4_MD4_ROUND (EXT4_MD4_G, A, B, C, D, In[1] + EXT4_HALF_MD4_K2, 3);
+  EXT4_MD4_ROUND (EXT4_MD4_G, D, A, B, C, In[3] + EXT4_HALF_MD4_K2, 5);
+  EXT4_MD4_ROUND (EXT4_MD4_G, C, D, A, B, In[5] + EXT4_HALF_MD4_K2, 9);
+  EXT4_MD4_ROUND (EXT4_MD4_G, B, C, D, A, In[7] + EXT4_HALF_MD4_K2, 13);
+  EXT4_MD4_ROUND (EXT4_MD4_G, A, B, C, D, In[0] + EXT4_HALF_MD4_K2, 3);
+  EXT4_MD4_ROUND (EXT4_MD4_G, D, A, B, C, In[2] + EXT4_HALF_MD4_K2, 5);
+  EXT4_MD4_ROUND (EXT4_MD4_G, C, D, A, B, In[4] + EXT4_HALF_MD4_K2, 9);
+  EXT4_MD4_ROUND (EXT4_MD4_G, B, C, D, A, In[6] + EXT4_HALF_MD4_K2, 13);
+
+  EXT4_MD4_ROUND (EXT4_MD4_H, A, B, C, D, In[3] + EXT4_HALF_MD4_K3, 3);
+  EXT4_MD4_ROUND (EXT4_MD4_H, D, A, B, C, In[7] + EXT4_HALF_MD4_K3, 9);
+  EXT4_MD4_ROUND (EXT4_MD4_H, C, D, A, B, In[2] + EXT4_HALF_MD4_K3, 11);
+  EXT4_MD4_ROUND (EXT4_MD4_H, B, C, D, A, In[6] + EXT4_HALF_MD4_K3, 15);
+  EXT4_MD4_ROUND (EXT4_MD4_H, A, B, C, D, In[1] + EXT4_HALF_MD4_K3, 3);
+  EXT4_MD4_ROUND (EXT4_MD4_H, D, A, B, C, In[5] + EXT4_HALF_MD4_K3, 9);
+  EXT4_MD4_ROUND (EXT4_MD4_H, C, D, A, B, In[0] + EXT4_HALF_MD4_K3, 11);
+  EXT4_MD4_ROUND (EXT4_MD4_H, B, C, D, A, In[4] + EXT4_HALF_MD4_K3, 15);
+
+  Buf[0] += A;
+  Buf[1] += B;
+  Buf[2] += C;
+  Buf[3] += D;
+}
+
+/**
+   Reads a name character the way the hash algorithm expects it.
+
+   The original hashes sign-extended the characters, since char is signed on
+   x86. Filesystems created on platforms with unsigned chars use the
+   _UNSIGNED variants of the algorithms.
+
+   @param[in]      Char       The character.
+   @param[in]      Unsigned   TRUE to zero-extend the character.
+
+   @return The character as a 32-bit word.
+**/
+STATIC
+UINT32
+Ext4HashChar (
+  IN CHAR8    Char,
+  IN BOOLEAN  Unsigned
+  )
+{
+  return Unsigned ? (UINT32)(UINT8)Char : (UINT32)(INT32)(INT8)Char;
+}
+
+/**
+   The legacy ext3 directory hash.
+
+   @param[in]      Name       Pointer to the name.
+   @param[in]      Length     Length of the name, in bytes.
+   @param[in]      Unsigned   TRUE for the unsigned variant.
+
+   @return The hash.
+**/
+STATIC
+UINT32
+Ext4LegacyHash (
+  IN CONST CHAR8  *Name,
+  IN UINTN        Length,
+  IN BOOLEAN      Unsigned
+  )
+{
+  UINT32  Hash;
+  UINT32  Hash0;
+  UINT32  Hash1;
+
+  Hash0 = 0x12A3FE2D;
+  Hash1 = 0x37ABE8F9;
+
+  while (Length-- > 0) {
+    Hash = Hash1 + (Hash0 ^ (Ext4HashChar (*Name++, Unsigned) * 7152373U));
+
+    if ((Hash & BIT31) != 0) {
+      Hash -= 0x7FFFFFFF;
+    }
+
+    Hash1 = Hash0;
+    Hash0 = Hash;
+  }
+
+  return Hash0 << 1;
+}
+
+/**
+   Packs a piece of the name into the input words of a transform, padding it
+   with its length.
+
+   @param[in]      Name       Pointer to the remaining part of the name.
+   @param[in]      Length     Length of the remaining part of the name, in bytes.
+   @param[out]     Buf        Input words.
+   @param[in]      Num        Number of input words.
+   @param[in]      Unsigned   TRUE for the unsigned variant.
+**/
+STATIC
+VOID
+Ext4StrToHashBuf (
+  IN CONST CHAR8  *Name,
+  IN UINTN        Length,
+  OUT UINT32      *Buf,
+  IN UINTN        Num,
+  IN BOOLEAN      Unsigned
+  )
+{
+  UINT32  Pad;
+  UINT32  Val;
+  UINTN   Index;
+
+  Pad  = (UINT32)Length | ((UINT32)Length << 8);
+  Pad |= Pad << 16;
+
+  Val    = Pad;
+  Length = MIN (Length, Num * 4);
+
+  for (Index = 0; Index < Length; Index++) {
+    Val = Ext4HashChar (Name[Index], Unsigned) + (Val << 8);
+
+    if ((Index % 4) == 3) {
+      *Buf++ = Val;
+      Val    = Pad;
+      Num--;
+    }
+  }
+
+  if (Num > 0) {
+    *Buf++ = Val;
+    Num--;
+  }
+
+  while (Num-- > 0) {
+    *Buf++ = Pad;
+  }
+}
+
+/**
+   Hashes a name the way an indexed directory does.
+
+   @param[in]      Partition     Pointer to the ext4 partition.
+   @param[in]      HashVersion   Hash algorithm, one of EXT4_DX_HASH_*.
+   @param[in]      Name          Pointer to the name.
+   @param[in]      Length        Length of the name, in bytes.
+   @param[out]     Hash          The major hash of the name.
+
+   @retval EFI_SUCCESS      The name was hashed.
+   @retval EFI_UNSUPPORTED  The hash algorithm is not supported.
+**/
+STATIC
+EFI_STATUS
+Ext4HtreeHash (
+  IN  EXT4_PARTITION  *Partition,
+  IN  UINT8           HashVersion,
+  IN  CONST CHAR8     *Name,
+  IN  UINTN           Length,
+  OUT UINT32          *Hash
+  )
+{
+  UINT32   Buf[4];
+  UINT32   In[8];
+  BOOLEAN  Unsigned;
+  UINTN    Index;
+
+  Buf[0] = 0x67452301;
+  Buf[1] = 0xEFCDAB89;
+  Buf[2] = 0x98BADCFE;
+  Buf[3] = 0x10325476;
+
+  // An all-zero seed means the filesystem has no seed
+  for (Index = 0; Index < ARRAY_SIZE (Partition->SuperBlock.s_hash_seed); Index++) {
+    if (Partition->SuperBlock.s_hash_seed[Index] != 0) {
+      CopyMem (Buf, Partition->SuperBlock.s_hash_seed, sizeof (Buf));
+      break;
+    }
+  }
+
+  Unsigned = HashVersion >= EXT4_DX_HASH_LEGACY_UNSIGNED;
+
+  switch (HashVersion) {
+    case EXT4_DX_HASH_LEGACY:
+    case EXT4_DX_HASH_LEGACY_UNSIGNED:
+      *Hash = Ext4LegacyHash (Name, Length, Unsigned);
+      break;
+
+    case EXT4_DX_HASH_HALF_MD4:
+    case EXT4_DX_HASH_HALF_MD4_UNSIGNED:
+      // Length is unsigned, so the loop condition is different from Linux's
+      for (Index = 0; Index < Length; Index += 32) {
+        Ext4StrToHashBuf (Name + Index, Length - Index, In, 8, Unsigned);
+        Ext4HalfMd4Transform (Buf, In);
+      }
+
+      *Hash = Buf[1];
+      break;
+
+    case EXT4_DX_HASH_TEA:
+    case EXT4_DX_HASH_TEA_UNSIGNED:
+      for (Index = 0; Index < Length; Index += 16) {
+        Ext4StrToHashBuf (Name + Index, Length - Index, In, 4, Unsigned);
+        Ext4TeaTransform (Buf, In);
+      }
+
+      *Hash = Buf[0];
+      break;
+
+    default:
+      // EXT4_DX_HASH_SIPHASH is only used by casefolded, encrypted directories
+      return EFI_UNSUPPORTED;
+  }
+
+  *Hash &= ~1U;
+  if (*Hash == (EXT4_HTREE_EOF_32BIT << 1)) {
+    *Hash = (EXT4_HTREE_EOF_32BIT - 1) << 1;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Reads a block of a directory.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Directory   Pointer to the opened directory.
+   @param[in]      Block       Logical block number.
+   @param[out]     Buffer      Pointer to a Partition->BlockSize bytes buffer.
+
+   @return Status of the read.
+**/
+STATIC
+EFI_STATUS
+Ext4HtreeReadBlock (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *Directory,
+  IN  UINT32          Block,
+  OUT CHAR8           *Buffer
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Length;
+
+  Length = Partition->BlockSize;
+  Status = Ext4Read (Partition, Directory, Buffer, EXT4_BLOCK_TO_BYTES (Partition, Block), &Length);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // Index blocks must lie inside the directory
+  if (Length != Partition->BlockSize) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   A level of the walk down the index.
+**/
+typedef struct {
+  CHAR8            *Block;
+  EXT4_DX_ENTRY    *Entries;
+  EXT4_DX_ENTRY    *At;
+  UINT16           Count;
+} EXT4_DX_FRAME;
+
+/**
+   Validates the entries of an index block and finds the one covering a hash.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in out]  Frame       The level, with Block and Entries set.
+   @param[in]      Hash        The hash to look for.
+
+   @retval EFI_SUCCESS            Frame->Count and Frame->At are set.
+   @retval EFI_VOLUME_CORRUPTED   The index block is corrupted.
+**/
+STATIC
+EFI_STATUS
+Ext4HtreeSearchIndex (
+  IN     EXT4_PARTITION  *Partition,
+  IN OUT EXT4_DX_FRAME   *Frame,
+  IN     UINT32          Hash
+  )
+{
+  EXT4_DX_COUNT_LIMIT  *CountLimit;
+  EXT4_DX_ENTRY        *Low;
+  EXT4_DX_ENTRY        *High;
+  EXT4_DX_ENTRY        *Middle;
+  UINTN                MaxEntries;
+
+  CountLimit = (EXT4_DX_COUNT_LIMIT *)Frame->Entries;
+  MaxEntries = (Partition->BlockSize - ((CHAR8 *)Frame->Entries - Frame->Block)) / sizeof (EXT4_DX_ENTRY);
+
+  if ((CountLimit->count == 0) || (CountLimit->count > CountLimit->limit) || (CountLimit->limit > MaxEntries)) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Frame->Count = CountLimit->count;
+
+  // Find the last entry whose hash is <= Hash. Entry 0 covers everything
+  // below entry 1's hash.
+  Low  = Frame->Entries + 1;
+  High = Frame->Entries + Frame->Count - 1;
+
+  while (Low <= High) {
+    Middle = Low + (High - Low) / 2;
+
+    if (Middle->hash > Hash) {
+      High = Middle - 1;
+    } else {
+      Low = Middle + 1;
+    }
+  }
+
+  Frame->At = Low - 1;
+  return EFI_SUCCESS;
+}
+
+/**
+   Hashes a name and walks the hash tree index of a directory down to the
+   index entry of the first leaf that may hold the name.
+
+   @param[in]      Directory   Pointer to the opened, indexed directory.
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Name        Pointer to the UTF-8 name.
+   @param[in]      NameLength  Length of the name, in bytes.
+   @param[in]      Buf         Buffer of EXT4_HTREE_LEVEL blocks for the index blocks.
+   @param[out]     Frames      The levels of the walk, EXT4_HTREE_LEVEL long.
+   @param[out]     Levels      Number of levels of the index.
+   @param[out]     Hash        Hash of the name.
+
+   @retval EFI_SUCCESS            Frames[*Levels - 1].At is the leaf's index entry.
+   @retval EFI_UNSUPPORTED        The index uses an unsupported hash or depth.
+   @retval EFI_VOLUME_CORRUPTED   The index is corrupted.
+   @retval !EFI_SUCCESS           Failure.
+**/
+STATIC
+EFI_STATUS
+Ext4HtreeWalk (
+  IN  EXT4_FILE       *Directory,
+  IN  EXT4_PARTITION  *Partition,
+  IN  CONST CHAR8     *Name,
+  IN  UINTN           NameLength,
+  IN  CHAR8           *Buf,
+  OUT EXT4_DX_FRAME   *Frames,
+  OUT UINTN           *Levels,
+  OUT UINT32          *Hash
+  )
+{
+  EFI_STATUS         Status;
+  EXT4_DX_ROOT_INFO  *RootInfo;
+  UINTN              Level;
+  UINT8              HashVersion;
+
+  Frames[0].Block = Buf;
+  Status          = Ext4HtreeReadBlock (Partition, Directory, 0, Frames[0].Block);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  RootInfo = (EXT4_DX_ROOT_INFO *)(Frames[0].Block + EXT4_DX_ROOT_INFO_OFFSET);
+
+  if ((RootInfo->reserved_zero != 0) || (RootInfo->info_length < sizeof (EXT4_DX_ROOT_INFO)) ||
+      (EXT4_DX_ROOT_INFO_OFFSET + RootInfo->info_length + sizeof (EXT4_DX_COUNT_LIMIT) > Partition->BlockSize))
+  {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  *Levels = RootInfo->indirect_levels + 1;
+
+  // Three level trees are only valid on LARGEDIR filesystems
+  if (*Levels > (EXT4_HAS_INCOMPAT (Partition, EXT4_FEATURE_INCOMPAT_LARGEDIR) ?
+                 EXT4_HTREE_LEVEL : EXT4_HTREE_LEVEL_COMPAT))
+  {
+    return EFI_UNSUPPORTED;
+  }
+
+  HashVersion = RootInfo->hash_version;
+
+  if ((HashVersion <= EXT4_DX_HASH_TEA) &&
+      ((Partition->SuperBlock.s_flags & EXT4_FLAGS_UNSIGNED_HASH) != 0))
+  {
+    HashVersion += EXT4_DX_HASH_LEGACY_UNSIGNED;
+  }
+
+  Status = Ext4HtreeHash (Partition, HashVersion, Name, NameLength, Hash);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Frames[0].Entries = (EXT4_DX_ENTRY *)(Frames[0].Block + EXT4_DX_ROOT_INFO_OFFSET + RootInfo->info_length);
+
+  // Walk down the index
+  for (Level = 0; ; Level++) {
+    Status = Ext4HtreeSearchIndex (Partition, &Frames[Level], *Hash);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    if (Level + 1 == *Levels) {
+      return EFI_SUCCESS;
+    }
+
+    Frames[Level + 1].Block   = Buf + Partition->BlockSize * (Level + 1);
+    Frames[Level + 1].Entries = (EXT4_DX_ENTRY *)(Frames[Level + 1].Block + EXT4_DX_NODE_ENTRIES_OFFSET);
+
+    Status = Ext4HtreeReadBlock (
+               Partition,
+               Directory,
+               Frames[Level].At->block & EXT4_DX_BLOCK_MASK,
+               Frames[Level + 1].Block
+               );
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+}
+
+/**
+   Retrieves a directory entry using the directory's hash tree index.
+
+   Only the leaf blocks whose hash range covers the exact name are searched,
+   so entries that only match Name case-insensitively may not be found.
+
+   @param[in]      Directory   Pointer to the opened, indexed directory.
+   @param[in]      Name        Pointer to the UCS-2 formatted filename.
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[out]     Result      Pointer to the destination directory entry.
+
+   @retval EFI_SUCCESS            The entry was found and copied to Result.
+   @retval EFI_NOT_FOUND          The index has no entry with this name.
+   @retval EFI_UNSUPPORTED        The index uses an unsupported hash or depth.
+   @retval EFI_VOLUME_CORRUPTED   The index is corrupted.
+   @retval !EFI_SUCCESS           Failure.
+**/
+EFI_STATUS
+Ext4HtreeRetrieveDirent (
+  IN EXT4_FILE        *Directory,
+  IN CONST CHAR16     *Name,
+  IN EXT4_PARTITION   *Partition,
+  OUT EXT4_DIR_ENTRY  *Result
+  )
+{
+  EFI_STATUS     Status;
+  CHAR8          *Utf8Name;
+  UINTN          Utf8Length;
+  CHAR8          *Buf;
+  CHAR8          *Leaf;
+  EXT4_DX_FRAME  Frames[EXT4_HTREE_LEVEL];
+  UINTN          Levels;
+  UINTN          Level;
+  UINT32         Hash;
+  UINT32         Block;
+
+  Buf      = NULL;
+  Utf8Name = NULL;
+
+  Status = UCS2StrToUTF8 ((CHAR16 *)Name, &Utf8Name);
+
+  if (EFI_ERROR (Status)) {
+    // Names that can't be converted can't be on disk either
+    return (Status == EFI_OUT_OF_RESOURCES) ? Status : EFI_NOT_FOUND;
+  }
+
+  Utf8Length = AsciiStrLen (Utf8Name);
+
+  if ((Utf8Length == 0) || (Utf8Length > EXT4_NAME_MAX)) {
+    Status = EFI_NOT_FOUND;
+    goto Out;
+  }
+
+  // One buffer per index level, plus one for the leaf
+  Buf = AllocatePool (Partition->BlockSize * (EXT4_HTREE_LEVEL + 1));
+
+  if (Buf == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Out;
+  }
+
+  Leaf = Buf + Partition->BlockSize * EXT4_HTREE_LEVEL;
+
+  Status = Ext4HtreeWalk (Directory, Partition, Utf8Name, Utf8Length, Buf, Frames, &Levels, &Hash);
+
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  while (TRUE) {
+    Block  = Frames[Levels - 1].At->block & EXT4_DX_BLOCK_MASK;
+    Status = Ext4HtreeReadBlock (Partition, Directory, Block, Leaf);
+
+    if (EFI_ERROR (Status)) {
+      goto Out;
+    }
+
+    Status = Ext4SearchDirBlock (Partition, Leaf, Name, Result);
+
+    if (Status != EFI_NOT_FOUND) {
+      goto Out;
+    }
+
+    // Names with the same hash may spill into the next leaf, whose index
+    // entry then holds that hash with bit 0 set. Find the next index entry,
+    // going up as many levels as needed...
+    for (Level = Levels; Level > 0; Level--) {
+      if (++Frames[Level - 1].At < Frames[Level - 1].Entries + Frames[Level - 1].Count) {
+        break;
+      }
+    }
+
+    if ((Level == 0) || ((Frames[Level - 1].At->hash & ~1U) != Hash)) {
+      break;
+    }
+
+    // ...and back down to the first entry of each lower level.
+    for ( ; Level < Levels; Level++) {
+      Status = Ext4HtreeReadBlock (
+                 Partition,
+                 Directory,
+                 Frames[Level - 1].At->block & EXT4_DX_BLOCK_MASK,
+                 Frames[Level].Block
+                 );
+
+      if (EFI_ERROR (Status)) {
+        goto Out;
+      }
+
+      Status = Ext4HtreeSearchIndex (Partition, &Frames[Level], 0);
+
+      if (EFI_ERROR (Status)) {
+        goto Out;
+      }
+    }
+  }
+
+  Status = EFI_NOT_FOUND;
+
+Out:
+  if (Buf != NULL) {
+    FreePool (Buf);
+  }
+
+  FreePool (Utf8Name);
+  return Status;
+}
+
+/**
+   Finds the leaf block of a directory's hash tree index where an entry with
+   the given name belongs.
+
+   @param[in]      Directory   Pointer to the opened, indexed directory.
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Name        Pointer to the UTF-8 name.
+   @param[in]      NameLength  Length of the name, in bytes.
+   @param[out]     Block       Logical block of the leaf in the directory.
+
+   @retval EFI_SUCCESS            The leaf was found.
+   @retval EFI_UNSUPPORTED        The index uses an unsupported hash or depth.
+   @retval EFI_VOLUME_CORRUPTED   The index is corrupted.
+   @retval !EFI_SUCCESS           Failure.
+**/
+EFI_STATUS
+Ext4HtreeFindLeaf (
+  IN  EXT4_FILE       *Directory,
+  IN  EXT4_PARTITION  *Partition,
+  IN  CONST CHAR8     *Name,
+  IN  UINTN           NameLength,
+  OUT UINT32          *Block
+  )
+{
+  EFI_STATUS     Status;
+  CHAR8          *Buf;
+  EXT4_DX_FRAME  Frames[EXT4_HTREE_LEVEL];
+  UINTN          Levels;
+  UINT32         Hash;
+
+  Buf = AllocatePool (Partition->BlockSize * EXT4_HTREE_LEVEL);
+
+  if (Buf == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = Ext4HtreeWalk (Directory, Partition, Name, NameLength, Buf, Frames, &Levels, &Hash);
+
+  if (!EFI_ERROR (Status)) {
+    *Block = Frames[Levels - 1].At->block & EXT4_DX_BLOCK_MASK;
+  }
+
+  FreePool (Buf);
+  return Status;
+}
@@ -0,0 +1,248 @@
+/** @file
+  Inline data routines
+
+  Copyright (c) 2024 Pedro Falcato All rights reserved.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  Filesystems with the inline_data feature keep small files and directories
+  inside the inode, instead of allocating blocks for them. The first
+  EXT4_MIN_INLINE_DATA_SIZE bytes are stored in i_data, and the rest, if any,
+  in the value of the "system.data" extended attribute, which lives in the
+  extra space of the inode.
+
+  Inline directories don't store "." and "..": the first 4 bytes of i_data
+  hold the parent's inode number, and each of the two parts holds its own
+  chain of directory entries. To keep the rest of the driver oblivious of all
+  this, an inline directory is presented as a single directory block.
+**/
+
+#include "Ext4Dxe.h"
+
+// Length of the "." and ".." entries, whose names are padded to 4 bytes
+#define EXT4_INLINE_DOT_ENTRY_LEN  (EXT4_MIN_DIR_ENTRY_LEN + 4)
+
+/**
+   Locates the value of an inode's "system.data" extended attribute.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Inode       Pointer to the inode, Partition->InodeSize bytes long.
+   @param[out]     Value       Pointer to the value, inside the inode.
+   @param[out]     ValueSize   Size of the value, 0 if the attribute doesn't exist.
+
+   @retval EFI_SUCCESS            The attribute was located, or doesn't exist.
+   @retval EFI_VOLUME_CORRUPTED   The in-inode extended attributes are corrupted.
+   @retval EFI_UNSUPPORTED        The value is stored in a separate inode.
+**/
+STATIC
+EFI_STATUS
+Ext4GetInlineDataXattr (
+  IN  EXT4_PARTITION    *Partition,
+  IN  CONST EXT4_INODE  *Inode,
+  OUT CONST UINT8       **Value,
+  OUT UINTN             *ValueSize
+  )
+{
+  CONST UINT8             *Base;
+  CONST EXT4_XATTR_ENTRY  *Entry;
+  UINTN                   First;
+  UINTN                   Offset;
+  UINTN                   EntryLength;
+
+  *Value     = NULL;
+  *ValueSize = 0;
+
+  Base  = (CONST UINT8 *)Inode;
+  First = EXT4_GOOD_OLD_INODE_SIZE + Inode->i_extra_isize + sizeof (UINT32);
+
+  if (  (Partition->InodeSize <= EXT4_GOOD_OLD_INODE_SIZE)
+     || (First > Partition->InodeSize)
+     || (ReadUnaligned32 ((CONST UINT32 *)(Base + First - sizeof (UINT32))) != EXT4_XATTR_MAGIC))
+  {
+    // No extended attributes in the inode
+    return EFI_SUCCESS;
+  }
+
+  for (Offset = First;
+       Offset + sizeof (UINT32) <= Partition->InodeSize;
+       Offset += EntryLength)
+  {
+    // The list ends with 4 zero bytes
+    if (ReadUnaligned32 ((CONST UINT32 *)(Base + Offset)) == 0) {
+      break;
+    }
+
+    Entry       = (CONST EXT4_XATTR_ENTRY *)(Base + Offset);
+    EntryLength = EXT4_XATTR_ENTRY_LEN (Entry->e_name_len);
+
+    if (Offset + EntryLength > Partition->InodeSize) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    if (  (Entry->e_name_index != EXT4_XATTR_INDEX_SYSTEM)
+       || (Entry->e_name_len != sizeof (EXT4_INLINE_DATA_XATTR_NAME) - 1)
+       || (CompareMem (Entry + 1, EXT4_INLINE_DATA_XATTR_NAME, Entry->e_name_len) != 0))
+    {
+      continue;
+    }
+
+    if (Entry->e_value_inum != 0) {
+      return EFI_UNSUPPORTED;
+    }
+
+    if ((UINT64)First + Entry->e_value_offs + Entry->e_value_size > Partition->InodeSize) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    *Value     = Base + First + Entry->e_value_offs;
+    *ValueSize = Entry->e_value_size;
+    return EFI_SUCCESS;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Reads from a file whose data is stored inline.
+
+   @param[in]      Partition     Pointer to the ext4 partition.
+   @param[in]      File          Pointer to the open file.
+   @param[out]     Buffer        Pointer to the buffer.
+   @param[in]      Offset        Offset of the read.
+   @param[in out]  Length        Pointer to the length of the buffer, in bytes.
+                                 After a successful read, it's updated to the
+                                 number of read bytes.
+
+   @return Status of the read operation.
+**/
+EFI_STATUS
+Ext4ReadInlineData (
+  IN     EXT4_PARTITION  *Partition,
+  IN     EXT4_FILE       *File,
+  OUT    VOID            *Buffer,
+  IN     UINT64          Offset,
+  IN OUT UINTN           *Length
+  )
+{
+  EFI_STATUS   Status;
+  UINT64       InodeSize;
+  CONST UINT8  *Value;
+  UINTN        ValueSize;
+  UINTN        RemainingRead;
+  UINTN        ToCopy;
+  UINT8        *Dest;
+
+  InodeSize = EXT4_INODE_SIZE (File->Inode);
+
+  if (Offset > InodeSize) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  Status = Ext4GetInlineDataXattr (Partition, File->Inode, &Value, &ValueSize);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (InodeSize > EXT4_MIN_INLINE_DATA_SIZE + ValueSize) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Inline file size %lu exceeds its inline data\n", InodeSize));
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  RemainingRead = (UINTN)MIN (*Length, InodeSize - Offset);
+  *Length       = RemainingRead;
+  Dest          = Buffer;
+
+  if (Offset < EXT4_MIN_INLINE_DATA_SIZE) {
+    ToCopy = MIN (RemainingRead, EXT4_MIN_INLINE_DATA_SIZE - (UINTN)Offset);
+    CopyMem (Dest, (CONST UINT8 *)File->Inode->i_data + Offset, ToCopy);
+    Dest          += ToCopy;
+    Offset        += ToCopy;
+    RemainingRead -= ToCopy;
+  }
+
+  if (RemainingRead != 0) {
+    CopyMem (Dest, Value + (Offset - EXT4_MIN_INLINE_DATA_SIZE), RemainingRead);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Builds a directory block out of an inline directory.
+
+   The block starts with "." and ".." entries, followed by the entries stored
+   in i_data and in the "system.data" extended attribute, and an unused entry
+   that covers the rest of the block.
+
+   @param[in]      Partition   Pointer to the ext4 partition.
+   @param[in]      Directory   Pointer to the open directory, which must have
+                               inline data.
+   @param[out]     Block       Pointer to a buffer of Partition->BlockSize bytes.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4ReadInlineDirBlock (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *Directory,
+  OUT CHAR8           *Block
+  )
+{
+  EFI_STATUS      Status;
+  CONST UINT8     *Value;
+  UINTN           ValueSize;
+  UINTN           Offset;
+  EXT4_DIR_ENTRY  *Entry;
+
+  Status = Ext4GetInlineDataXattr (Partition, Directory->Inode, &Value, &ValueSize);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // Every part of the directory is a chain of 4 byte aligned entries, and
+  // there must be room left for the trailing unused entry
+  if (  ((ValueSize % 4) != 0)
+     || (2 * EXT4_INLINE_DOT_ENTRY_LEN + EXT4_MIN_INLINE_DATA_SIZE - EXT4_INLINE_DOTDOT_SIZE + ValueSize
+         + EXT4_MIN_DIR_ENTRY_LEN > Partition->BlockSize))
+  {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  ZeroMem (Block, Partition->BlockSize);
+
+  Entry            = (EXT4_DIR_ENTRY *)Block;
+  Entry->inode     = Directory->InodeNum;
+  Entry->rec_len   = (UINT16)EXT4_INLINE_DOT_ENTRY_LEN;
+  Entry->name_len  = 1;
+  Entry->file_type = EXT4_FT_DIR;
+  Entry->name[0]   = '.';
+
+  Entry            = (EXT4_DIR_ENTRY *)(Block + EXT4_INLINE_DOT_ENTRY_LEN);
+  Entry->inode     = Directory->Inode->i_data[0];
+  Entry->rec_len   = (UINT16)EXT4_INLINE_DOT_ENTRY_LEN;
+  Entry->name_len  = 2;
+  Entry->file_type = EXT4_FT_DIR;
+  Entry->name[0]   = '.';
+  Entry->name[1]   = '.';
+
+  Offset = 2 * EXT4_INLINE_DOT_ENTRY_LEN;
+
+  CopyMem (
+    Block + Offset,
+    (CONST UINT8 *)Directory->Inode->i_data + EXT4_INLINE_DOTDOT_SIZE,
+    EXT4_MIN_INLINE_DATA_SIZE - EXT4_INLINE_DOTDOT_SIZE
+    );
+  Offset += EXT4_MIN_INLINE_DATA_SIZE - EXT4_INLINE_DOTDOT_SIZE;
+
+  if (ValueSize != 0) {
+    CopyMem (Block + Offset, Value, ValueSize);
+    Offset += ValueSize;
+  }
+
+  Entry          = (EXT4_DIR_ENTRY *)(Block + Offset);
+  Entry->rec_len = (UINT16)(Partition->BlockSize - Offset);
+
+  return EFI_SUCCESS;
+}
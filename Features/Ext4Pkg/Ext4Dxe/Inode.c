@@ -4,7 +4,7 @@
   Copyright (c) 2021 - 2022 Pedro Falcato All rights reserved.
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
-  EpochToEfiTime copied from EmbeddedPkg/Library/TimeBaseLib.c
+  EpochToEfiTime and EfiTimeToEpoch copied from EmbeddedPkg/Library/TimeBaseLib.c
   Copyright (c) 2016, Hisilicon Limited. All rights reserved.
   Copyright (c) 2016-2019, Linaro Limited. All rights reserved.
   Copyright (c) 2021, Ampere Computing LLC. All rights reserved.
@@ -12,6 +12,9 @@
 
 #include "Ext4Dxe.h"
 
+// Read-ahead window of a file that was just detected to be read sequentially
+#define EXT4_READ_AHEAD_INITIAL_BLOCKS  4
+
 /**
    Calculates the checksum of the given inode.
    @param[in]      Partition     Pointer to the opened EXT4 partition.
@@ -69,6 +72,121 @@ Ext4CalculateInodeChecksum (
   return Crc;
 }
 
+/**
+   Describes the part of a file, starting at Offset, that a single extent maps.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      Offset        Offset in the file.
+   @param[out]     IsHole        TRUE if the piece is a file hole or an uninitialized extent.
+   @param[out]     DiskOffset    Offset of the piece on the disk, if it's not a hole.
+   @param[out]     PieceLength   Length of the piece, in bytes, up to the end of the extent.
+
+   @return Status of the extent lookup.
+**/
+STATIC
+EFI_STATUS
+Ext4GetReadPiece (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *File,
+  IN  UINT64          Offset,
+  OUT BOOLEAN         *IsHole,
+  OUT UINT64          *DiskOffset,
+  OUT UINT64          *PieceLength
+  )
+{
+  EXT4_EXTENT    Extent;
+  EXT4_BLOCK_NR  LogicalBlock;
+  EXT4_BLOCK_NR  ExtentBlockOffset;
+  UINT32         BlockOff;
+  EFI_STATUS     Status;
+
+  LogicalBlock = DivU64x32Remainder (Offset, Partition->BlockSize, &BlockOff);
+
+  Status = Ext4GetExtent (Partition, File, LogicalBlock, &Extent);
+
+  if (Status == EFI_NO_MAPPING) {
+    *IsHole      = TRUE;
+    *DiskOffset  = 0;
+    *PieceLength = Partition->BlockSize - BlockOff;
+    return EFI_SUCCESS;
+  }
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // Extents returned by Ext4GetExtent always cover LogicalBlock, but may start before it
+  ExtentBlockOffset = LogicalBlock - Extent.ee_block;
+
+  // Uninitialized extents behave exactly the same as file holes, except they have
+  // blocks already allocated to them.
+  *IsHole      = EXT4_EXTENT_IS_UNINITIALIZED (&Extent);
+  *PieceLength = MultU64x32 (Ext4GetExtentLength (&Extent) - ExtentBlockOffset, Partition->BlockSize) - BlockOff;
+  *DiskOffset  = MultU64x32 (
+                   (LShiftU64 (Extent.ee_start_hi, 32) | Extent.ee_start_lo) + ExtentBlockOffset,
+                   Partition->BlockSize
+                   ) + BlockOff;
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Plans the next I/O of a read, by merging the extents that map the file from Offset
+   onwards into a run that is either contiguous on the disk, or only made of holes
+   and uninitialized extents.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      Offset        Offset in the file.
+   @param[in]      Length        Number of bytes left to read.
+   @param[out]     IsHole        TRUE if the run must be read as zeros.
+   @param[out]     DiskOffset    Offset of the run on the disk, if it's not a hole.
+   @param[out]     RunLength     Length of the run, in bytes. It may be larger than Length,
+                                 up to the end of the last extent that was merged.
+
+   @return Status of the extent lookups.
+**/
+EFI_STATUS
+Ext4GetReadRun (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *File,
+  IN  UINT64          Offset,
+  IN  UINTN           Length,
+  OUT BOOLEAN         *IsHole,
+  OUT UINT64          *DiskOffset,
+  OUT UINT64          *RunLength
+  )
+{
+  EFI_STATUS  Status;
+  BOOLEAN     NextIsHole;
+  UINT64      NextDiskOffset;
+  UINT64      NextLength;
+
+  Status = Ext4GetReadPiece (Partition, File, Offset, IsHole, DiskOffset, RunLength);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  while (*RunLength < Length) {
+    Status = Ext4GetReadPiece (Partition, File, Offset + *RunLength, &NextIsHole, &NextDiskOffset, &NextLength);
+
+    // Errors past the first piece are left for the next run to report
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    if ((NextIsHole != *IsHole) || (!NextIsHole && (NextDiskOffset != *DiskOffset + *RunLength))) {
+      break;
+    }
+
+    *RunLength += NextLength;
+  }
+
+  return EFI_SUCCESS;
+}
+
 /**
    Reads from an EXT4 inode.
    @param[in]      Partition     Pointer to the opened EXT4 partition.
@@ -89,25 +207,18 @@ Ext4Read (
   IN OUT UINTN           *Length
   )
 {
-  EXT4_INODE   *Inode;
-  UINT64       InodeSize;
-  UINT64       CurrentSeek;
-  UINTN        RemainingRead;
-  UINTN        BeenRead;
-  UINTN        WasRead;
-  EXT4_EXTENT  Extent;
-  UINT32       BlockOff;
-  EFI_STATUS   Status;
-  BOOLEAN      HasBackingExtent;
-  UINT32       HoleOff;
-  UINT64       HoleLen;
-  UINT64       ExtentStartBytes;
-  UINT64       ExtentLengthBytes;
-  UINT64       ExtentLogicalBytes;
-
-  // Our extent offset is the difference between CurrentSeek and ExtentLogicalBytes
-  UINT64  ExtentOffset;
-  UINTN   ExtentMayRead;
+  EXT4_INODE              *Inode;
+  UINT64                  InodeSize;
+  UINT64                  CurrentSeek;
+  UINTN                   RemainingRead;
+  UINTN                   BeenRead;
+  UINTN                   WasRead;
+  EFI_STATUS              Status;
+  BOOLEAN                 IsHole;
+  UINT64                  DiskOffset;
+  UINT64                  RunLength;
+  EXT4_BLOCK_CACHE_CLASS  CacheClass;
+  UINT32                  ReadAheadMax;
 
   Inode         = File->Inode;
   InodeSize     = EXT4_INODE_SIZE (Inode);
@@ -117,6 +228,10 @@ Ext4Read (
 
   DEBUG ((DEBUG_FS, "[ext4] Ext4Read(%s, Offset %lu, Length %lu)\n", File->Dentry->Name, Offset, *Length));
 
+  if (EXT4_HAS_INLINE_DATA (Inode)) {
+    return Ext4ReadInlineData (Partition, File, Buffer, Offset, Length);
+  }
+
   if (Offset > InodeSize) {
     return EFI_DEVICE_ERROR;
   }
@@ -125,62 +240,58 @@ Ext4Read (
     RemainingRead = (UINTN)(InodeSize - Offset);
   }
 
-  while (RemainingRead != 0) {
-    WasRead = 0;
+  // Directory blocks are metadata, and are kept in the cache alongside inodes and extents
+  CacheClass   = Ext4FileIsDir (File) ? Ext4BlockCacheMetadata : Ext4BlockCacheData;
+  ReadAheadMax = PcdGet32 (PcdExt4ReadAheadMaxSize);
 
-    // The algorithm here is to get the extent corresponding to the current block
-    // and then read as much as we can from the current extent.
+  // A read that starts where the last one ended is sequential, and doubles the
+  // read-ahead window up to ReadAheadMax. Any other read turns read-ahead off.
+  if ((Offset == File->ReadAheadNext) && (ReadAheadMax != 0)) {
+    if (File->ReadAheadWindow == 0) {
+      File->ReadAheadWindow = MIN (EXT4_READ_AHEAD_INITIAL_BLOCKS * Partition->BlockSize, ReadAheadMax);
+    } else {
+      File->ReadAheadWindow = (UINT32)MIN ((UINT64)File->ReadAheadWindow * 2, ReadAheadMax);
+    }
+  } else {
+    File->ReadAheadWindow = 0;
+  }
 
-    Status = Ext4GetExtent (
-               Partition,
-               File,
-               DivU64x32Remainder (CurrentSeek, Partition->BlockSize, &BlockOff),
-               &Extent
-               );
+  while (RemainingRead != 0) {
+    // Extents that follow each other on the disk are read with a single request,
+    // and consecutive holes are zeroed at once.
+    Status = Ext4GetReadRun (Partition, File, CurrentSeek, RemainingRead, &IsHole, &DiskOffset, &RunLength);
 
-    if ((Status != EFI_SUCCESS) && (Status != EFI_NO_MAPPING)) {
+    if (EFI_ERROR (Status)) {
       return Status;
     }
 
-    HasBackingExtent = Status != EFI_NO_MAPPING;
+    WasRead = (UINTN)MIN (RunLength, RemainingRead);
 
-    if (!HasBackingExtent || EXT4_EXTENT_IS_UNINITIALIZED (&Extent)) {
-      HoleOff = BlockOff;
-
-      if (!HasBackingExtent) {
-        HoleLen = Partition->BlockSize - HoleOff;
-      } else {
-        // Uninitialized extents behave exactly the same as file holes, except they have
-        // blocks already allocated to them.
-        HoleLen = MultU64x32 (Ext4GetExtentLength (&Extent), Partition->BlockSize) - HoleOff;
-      }
-
-      WasRead = HoleLen > RemainingRead ? RemainingRead : (UINTN)HoleLen;
-      // Potential improvement: In the future, we could get the file hole's total
-      // size and memset all that
+    if (IsHole) {
       ZeroMem (Buffer, WasRead);
     } else {
-      ExtentStartBytes = MultU64x32 (
-                           LShiftU64 (Extent.ee_start_hi, 32) |
-                           Extent.ee_start_lo,
-                           Partition->BlockSize
-                           );
-      ExtentLengthBytes  = Extent.ee_len * Partition->BlockSize;
-      ExtentLogicalBytes = MultU64x32 ((UINT64)Extent.ee_block, Partition->BlockSize);
-      ExtentOffset       = CurrentSeek - ExtentLogicalBytes;
-      ExtentMayRead      = (UINTN)(ExtentLengthBytes - ExtentOffset);
-
-      WasRead = ExtentMayRead > RemainingRead ? RemainingRead : ExtentMayRead;
-
-      Status = Ext4ReadDiskIo (Partition, Buffer, WasRead, ExtentStartBytes + ExtentOffset);
+      if ((CacheClass == Ext4BlockCacheData) && (WasRead >= ReadAheadMax)) {
+        // Large reads gain nothing from the cache, and would only evict what's in it
+        Status = Ext4ReadDiskIo (Partition, Buffer, WasRead, DiskOffset);
+      } else {
+        // Only read ahead inside the run, which is contiguous on the disk
+        Status = Ext4ReadDiskIoCached (
+                   Partition,
+                   CacheClass,
+                   Buffer,
+                   WasRead,
+                   DiskOffset,
+                   (UINTN)MIN (File->ReadAheadWindow, RunLength - WasRead)
+                   );
+      }
 
       if (EFI_ERROR (Status)) {
         DEBUG ((
           DEBUG_ERROR,
           "[ext4] Error %r reading [%lu, %lu]\n",
           Status,
-          ExtentStartBytes + ExtentOffset,
-          ExtentStartBytes + ExtentOffset + WasRead - 1
+          DiskOffset,
+          DiskOffset + WasRead - 1
           ));
         return Status;
       }
@@ -192,7 +303,8 @@ Ext4Read (
     CurrentSeek   += WasRead;
   }
 
-  *Length = BeenRead;
+  *Length             = BeenRead;
+  File->ReadAheadNext = Offset + BeenRead;
 
   return EFI_SUCCESS;
 }
@@ -453,6 +565,122 @@ Ext4FileCreateTime (
   Ext4FileCrTime (File, Time);
 }
 
+/**
+  Converts EFI_TIME to Epoch seconds (elapsed since 1970 JANUARY 01, 00:00:00 UTC).
+
+  @param[in]   Time           The time in UEFI format.
+
+  @return The Epoch seconds.
+**/
+STATIC
+UINT64
+EfiTimeToEpoch (
+  IN CONST EFI_TIME  *Time
+  )
+{
+  UINT64  a;
+  UINT64  y;
+  UINT64  m;
+  UINT64  JulianDate;
+
+  a = (14 - Time->Month) / 12;
+  y = Time->Year + 4800 - a;
+  m = Time->Month + (12 * a) - 3;
+
+  JulianDate = Time->Day + ((153 * m + 2) / 5) + (365 * y) + (y / 4) - (y / 100) + (y / 400) - 32045;
+
+  // 2440588 is the Julian date of the Epoch
+  return MultU64x32 (JulianDate - 2440588, 86400) + Time->Hour * 3600 + Time->Minute * 60 + Time->Second;
+}
+
+/**
+   Encodes a timestamp in the ext4 format: the low 32 bits of the seconds,
+   and an extra field with the epoch bits and the nanoseconds.
+
+   @param[in]      Time          Time to encode.
+   @param[out]     Seconds       Value of the timestamp field.
+   @param[out]     Extra         Value of the timestamp's _extra field.
+**/
+STATIC
+VOID
+Ext4EncodeTime (
+  IN  CONST EFI_TIME  *Time,
+  OUT UINT32          *Seconds,
+  OUT UINT32          *Extra
+  )
+{
+  UINT64  Epoch;
+
+  Epoch    = EfiTimeToEpoch (Time);
+  *Seconds = (UINT32)Epoch;
+
+  // Like Linux, the seconds field is signed and the epoch bits extend it
+  *Extra = ((UINT32)RShiftU64 (Epoch - (UINT64)(INT64)(INT32)(UINT32)Epoch, 32) & EXT4_EXTRA_TIMESTAMP_MASK) |
+           (Time->Nanosecond << 2);
+}
+
+/**
+   Sets timestamps of an inode.
+
+   @param[in out]  Inode         Pointer to the inode.
+   @param[in]      Which         EXT4_INODE_*TIME flags of the timestamps to set.
+   @param[in]      Time          Time to set, or NULL to set the current time.
+**/
+VOID
+Ext4SetInodeTimes (
+  IN OUT EXT4_INODE      *Inode,
+  IN     UINT32          Which,
+  IN     CONST EFI_TIME  *Time OPTIONAL
+  )
+{
+  EFI_TIME  Now;
+  UINT32    Seconds;
+  UINT32    Extra;
+
+  if (Time == NULL) {
+    // Timestamps are best effort; leave them alone if there's no clock
+    if (EFI_ERROR (gRT->GetTime (&Now, NULL))) {
+      return;
+    }
+
+    Time = &Now;
+  }
+
+  Ext4EncodeTime (Time, &Seconds, &Extra);
+
+  if ((Which & EXT4_INODE_ATIME) != 0) {
+    Inode->i_atime = Seconds;
+    if (EXT4_INODE_HAS_FIELD (Inode, i_atime_extra)) {
+      Inode->i_atime_extra = Extra;
+    }
+  }
+
+  if ((Which & EXT4_INODE_MTIME) != 0) {
+    Inode->i_mtime = Seconds;
+    if (EXT4_INODE_HAS_FIELD (Inode, i_mtime_extra)) {
+      Inode->i_mtime_extra = Extra;
+    }
+  }
+
+  if ((Which & EXT4_INODE_CTIME) != 0) {
+    Inode->i_ctime = Seconds;
+    if (EXT4_INODE_HAS_FIELD (Inode, i_ctime_extra)) {
+      Inode->i_ctime_extra = Extra;
+    }
+  }
+
+  if (((Which & EXT4_INODE_CRTIME) != 0) && EXT4_INODE_HAS_FIELD (Inode, i_crtime)) {
+    Inode->i_crtime = Seconds;
+    if (EXT4_INODE_HAS_FIELD (Inode, i_crtime_extra)) {
+      Inode->i_crtime_extra = Extra;
+    }
+  }
+
+  if ((Which & EXT4_INODE_DTIME) != 0) {
+    Inode->i_dtime = Seconds;
+  }
+}
+
 /**
    Checks if the checksum of the inode is correct.
    @param[in]      Partition     Pointer to the opened EXT4 partition.
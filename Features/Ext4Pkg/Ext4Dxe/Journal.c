@@ -0,0 +1,967 @@
+/** @file
+  Journal and transaction routines
+
+  Copyright (c) 2024 Pedro Falcato All rights reserved.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  Metadata changes are gathered in transactions (EXT4_TRANSACTION), which hold
+  copies of the blocks they modify. A transaction is committed by writing those
+  copies to the JBD2 journal, followed by a commit block, and is then
+  checkpointed by writing the copies to their home locations. The journal is
+  emptied after every transaction, so it only holds a transaction if we were
+  interrupted in the middle of one, which Linux replays on its next mount.
+  Ext4Dxe never replays the journal itself: partitions whose journal isn't
+  empty are mounted read-only.
+
+  A transaction goes through these steps, each of them flushed to the media
+  before the next one starts:
+   1) The superblock is marked as needing recovery, and the journal superblock,
+      descriptor blocks and block copies are written.
+   2) The commit block is written. From now on, the transaction is durable.
+   3) The block copies are written to their home locations.
+   4) The journal is marked empty and the recovery flag is cleared.
+
+  Linux wipes journals of filesystems that aren't marked as needing recovery,
+  which is why the flag must reach the media before the commit block does.
+**/
+
+#include "Ext4Dxe.h"
+
+//
+// Copy of a block held by a transaction
+//
+typedef struct {
+  LIST_ENTRY       Link;
+  EXT4_BLOCK_NR    Block;
+  // Followed by the contents of the block
+} EXT4_TXN_BLOCK;
+
+#define EXT4_TXN_BLOCK_FROM_LINK(Node)  BASE_CR (Node, EXT4_TXN_BLOCK, Link)
+#define EXT4_TXN_BLOCK_DATA(TxnBlock)   ((UINT8 *)((TxnBlock) + 1))
+
+// Journal features whose transactions we know how to write
+#define EXT4_JOURNAL_SUPPORTED_INCOMPAT                                        \
+  (JBD2_FEATURE_INCOMPAT_REVOKE | JBD2_FEATURE_INCOMPAT_64BIT |                \
+   JBD2_FEATURE_INCOMPAT_CSUM_V3 | JBD2_FEATURE_INCOMPAT_FAST_COMMIT)
+
+/**
+   Maps a block of the journal to a block of the filesystem.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      LogicalBlock  Block of the journal.
+   @param[out]     Block         Block of the filesystem.
+   @param[out]     Count         Number of blocks of the journal, starting at
+                                 LogicalBlock, that are contiguous on the disk.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4JournalMapBlock (
+  IN  EXT4_PARTITION  *Partition,
+  IN  UINT32          LogicalBlock,
+  OUT EXT4_BLOCK_NR   *Block,
+  OUT UINT32          *Count
+  )
+{
+  EXT4_EXTENT  Extent;
+  EFI_STATUS   Status;
+  UINT32       Offset;
+
+  Status = Ext4GetExtent (Partition, Partition->Journal.File, LogicalBlock, &Extent);
+
+  if (Status == EFI_NO_MAPPING) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // The journal can't have holes, which are reported as uninitialized extents
+  if (EXT4_EXTENT_IS_UNINITIALIZED (&Extent)) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Offset = LogicalBlock - Extent.ee_block;
+  *Block = (LShiftU64 (Extent.ee_start_hi, 32) | Extent.ee_start_lo) + Offset;
+  *Count = Extent.ee_len - Offset;
+
+  if ((*Block == 0) || (*Block + *Count > Partition->NumberBlocks)) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Writes blocks to the journal.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      LogicalBlock  First block of the journal.
+   @param[in]      Buffer        Pointer to the blocks.
+   @param[in]      NumberBlocks  Number of blocks.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4JournalWrite (
+  IN EXT4_PARTITION  *Partition,
+  IN UINT32          LogicalBlock,
+  IN CONST UINT8     *Buffer,
+  IN UINTN           NumberBlocks
+  )
+{
+  EFI_STATUS     Status;
+  EXT4_BLOCK_NR  Block;
+  UINT32         Count;
+
+  while (NumberBlocks != 0) {
+    Status = Ext4JournalMapBlock (Partition, LogicalBlock, &Block, &Count);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Count = (UINT32)MIN (Count, NumberBlocks);
+
+    // The journal is never read through the block cache
+    Status = Ext4WriteDiskIo (
+               Partition,
+               Buffer,
+               Count * Partition->BlockSize,
+               EXT4_BLOCK_TO_BYTES (Partition, Block)
+               );
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    LogicalBlock += Count;
+    Buffer       += Count * Partition->BlockSize;
+    NumberBlocks -= Count;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Writes the journal superblock, updating its checksum.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4JournalWriteSuperblock (
+  IN EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_JOURNAL   *Journal;
+  EFI_STATUS     Status;
+  EXT4_BLOCK_NR  Block;
+  UINT32         Count;
+
+  Journal = &Partition->Journal;
+
+  if (Journal->CsumV3) {
+    Journal->Sb.s_checksum = 0;
+    Journal->Sb.s_checksum = SwapBytes32 (Crc32cUpdate (~0U, &Journal->Sb, sizeof (JBD2_SUPERBLOCK)));
+  }
+
+  Status = Ext4JournalMapBlock (Partition, 0, &Block, &Count);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return Ext4WriteDiskIo (Partition, &Journal->Sb, sizeof (JBD2_SUPERBLOCK), EXT4_BLOCK_TO_BYTES (Partition, Block));
+}
+
+/**
+   Checks if the journal superblock describes a journal we can write
+   transactions to, and sets up the journal to do so.
+
+   @param[in out]  Partition     Pointer to the opened EXT4 partition.
+   @param[out]     Usable        Set to TRUE if the journal is usable.
+
+   @retval EFI_SUCCESS           The journal was checked.
+   @retval EFI_VOLUME_CORRUPTED  The journal superblock is corrupted.
+**/
+STATIC
+EFI_STATUS
+Ext4CheckJournal (
+  IN OUT EXT4_PARTITION  *Partition,
+  OUT    BOOLEAN         *Usable
+  )
+{
+  EXT4_JOURNAL     *Journal;
+  JBD2_SUPERBLOCK  *Sb;
+  UINT32           Incompat;
+  UINT32           Length;
+  UINT32           FastCommitBlocks;
+  UINTN            Capacity;
+  UINT32           Checksum;
+
+  Journal = &Partition->Journal;
+  Sb      = &Journal->Sb;
+  *Usable = FALSE;
+
+  if (SwapBytes32 (Sb->s_header.h_magic) != JBD2_MAGIC_NUMBER) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Bad journal magic %x\n", SwapBytes32 (Sb->s_header.h_magic)));
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  if (SwapBytes32 (Sb->s_header.h_blocktype) != JBD2_SUPERBLOCK_V2) {
+    DEBUG ((DEBUG_WARN, "[ext4] Journal superblock type %u is unsupported\n", SwapBytes32 (Sb->s_header.h_blocktype)));
+    return EFI_SUCCESS;
+  }
+
+  if (SwapBytes32 (Sb->s_blocksize) != Partition->BlockSize) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Journal->First     = SwapBytes32 (Sb->s_first);
+  Journal->MaxLength = SwapBytes32 (Sb->s_maxlen);
+
+  if (  (Journal->First == 0)
+     || (Journal->First >= Journal->MaxLength)
+     || (EXT4_BLOCK_TO_BYTES (Partition, Journal->MaxLength) > EXT4_INODE_SIZE (Journal->File->Inode)))
+  {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Incompat        = SwapBytes32 (Sb->s_feature_incompat);
+  Journal->CsumV3 = (Incompat & JBD2_FEATURE_INCOMPAT_CSUM_V3) != 0;
+
+  if (Journal->CsumV3) {
+    if (Sb->s_checksum_type != JBD2_CRC32C_CHKSUM) {
+      return EFI_SUCCESS;
+    }
+
+    Checksum       = Sb->s_checksum;
+    Sb->s_checksum = 0;
+
+    if (SwapBytes32 (Crc32cUpdate (~0U, Sb, sizeof (JBD2_SUPERBLOCK))) != Checksum) {
+      DEBUG ((DEBUG_ERROR, "[ext4] Bad journal superblock checksum\n"));
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    Sb->s_checksum = Checksum;
+  }
+
+  if (  ((SwapBytes32 (Sb->s_feature_compat) & JBD2_FEATURE_COMPAT_CHECKSUM) != 0)
+     || ((Incompat & ~EXT4_JOURNAL_SUPPORTED_INCOMPAT) != 0))
+  {
+    DEBUG ((DEBUG_WARN, "[ext4] Unsupported journal features %x\n", Incompat & ~EXT4_JOURNAL_SUPPORTED_INCOMPAT));
+    return EFI_SUCCESS;
+  }
+
+  if ((Sb->s_start != 0) || (Sb->s_errno != 0)) {
+    DEBUG ((DEBUG_WARN, "[ext4] Journal needs recovery or has errors\n"));
+    return EFI_SUCCESS;
+  }
+
+  if ((Partition->NumberBlocks > MAX_UINT32) && ((Incompat & JBD2_FEATURE_INCOMPAT_64BIT) == 0)) {
+    return EFI_SUCCESS;
+  }
+
+  if (Journal->CsumV3) {
+    Journal->TagSize = sizeof (JBD2_BLOCK_TAG3);
+  } else if ((Incompat & JBD2_FEATURE_INCOMPAT_64BIT) != 0) {
+    Journal->TagSize = sizeof (JBD2_BLOCK_TAG);
+  } else {
+    Journal->TagSize = OFFSET_OF (JBD2_BLOCK_TAG, t_blocknr_high);
+  }
+
+  // Room is kept for the UUID that follows the first tag
+  Journal->TagsPerDescriptor = (Partition->BlockSize - sizeof (JBD2_HEADER) - sizeof (Sb->s_uuid) -
+                                (Journal->CsumV3 ? sizeof (JBD2_BLOCK_TAIL) : 0)) / Journal->TagSize;
+
+  // The fast commit area at the end of the journal belongs to Linux. It is
+  // reserved whenever the filesystem has fast_commit, as Linux only sets the
+  // journal feature once it mounts the filesystem.
+  FastCommitBlocks = 0;
+  if (  EXT4_HAS_COMPAT (Partition, EXT4_FEATURE_COMPAT_FAST_COMMIT)
+     || ((Incompat & JBD2_FEATURE_INCOMPAT_FAST_COMMIT) != 0))
+  {
+    FastCommitBlocks = SwapBytes32 (Sb->s_num_fc_blks);
+    if (FastCommitBlocks == 0) {
+      FastCommitBlocks = JBD2_DEFAULT_FAST_COMMIT_BLOCKS;
+    }
+  }
+
+  if (FastCommitBlocks >= Journal->MaxLength - Journal->First) {
+    DEBUG ((DEBUG_WARN, "[ext4] Journal is too small\n"));
+    return EFI_SUCCESS;
+  }
+
+  // Transactions are always written at the start of the log, and take one
+  // descriptor block per TagsPerDescriptor blocks, and a commit block.
+  Length   = Journal->MaxLength - Journal->First - FastCommitBlocks;
+  Capacity = MIN (EXT4_TXN_MAX_BLOCKS, Length);
+
+  while (  (Capacity != 0)
+        && (Capacity + (Capacity + Journal->TagsPerDescriptor - 1) / Journal->TagsPerDescriptor + 1 > Length))
+  {
+    Capacity--;
+  }
+
+  if (Capacity < EXT4_TXN_MIN_BLOCKS) {
+    DEBUG ((DEBUG_WARN, "[ext4] Journal is too small\n"));
+    return EFI_SUCCESS;
+  }
+
+  Journal->MaxTransactionBlocks = Capacity;
+  Journal->Sequence             = SwapBytes32 (Sb->s_sequence);
+  Journal->ChecksumSeed         = Crc32cUpdate (~0U, Sb->s_uuid, sizeof (Sb->s_uuid));
+
+  *Usable = TRUE;
+  return EFI_SUCCESS;
+}
+
+/**
+   Opens the journal of the partition. If the journal can't be written safely,
+   the partition is made read-only instead.
+
+   @param[in out]  Partition     Pointer to the opened EXT4 partition.
+
+   @retval EFI_SUCCESS           The journal was opened, or the partition was made read-only.
+   @retval EFI_VOLUME_CORRUPTED  The journal is corrupted.
+   @retval !EFI_SUCCESS          Failure.
+**/
+EFI_STATUS
+Ext4OpenJournal (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_JOURNAL   *Journal;
+  EFI_STATUS     Status;
+  EXT4_BLOCK_NR  Block;
+  UINT32         Count;
+  BOOLEAN        Usable;
+
+  Journal = &Partition->Journal;
+  Usable  = FALSE;
+
+  // Without a journal, an interrupted write could leave the filesystem inconsistent
+  if (  !EXT4_HAS_COMPAT (Partition, EXT3_FEATURE_COMPAT_HAS_JOURNAL)
+     || (Partition->SuperBlock.s_journal_inum == 0))
+  {
+    DEBUG ((DEBUG_WARN, "[ext4] No journal, mounting read-only\n"));
+    Partition->ReadOnly = TRUE;
+    return EFI_SUCCESS;
+  }
+
+  Status = Ext4OpenInode (Partition, Partition->SuperBlock.s_journal_inum, NULL, &Journal->File);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = Ext4JournalMapBlock (Partition, 0, &Block, &Count);
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4ReadDiskIo (Partition, &Journal->Sb, sizeof (JBD2_SUPERBLOCK), EXT4_BLOCK_TO_BYTES (Partition, Block));
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4CheckJournal (Partition, &Usable);
+  }
+
+  if (EFI_ERROR (Status) || !Usable) {
+    Ext4CloseJournal (Partition);
+    Partition->ReadOnly = TRUE;
+    return Status;
+  }
+
+  DEBUG ((
+    DEBUG_FS,
+    "[ext4] Journal of %u blocks, transactions of up to %u blocks\n",
+    Journal->MaxLength,
+    Journal->MaxTransactionBlocks
+    ));
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Closes the journal of the partition.
+
+   @param[in out]  Partition     Pointer to the opened EXT4 partition.
+**/
+VOID
+Ext4CloseJournal (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  if (Partition->Journal.File != NULL) {
+    Ext4CloseInternal (Partition->Journal.File);
+    Partition->Journal.File = NULL;
+  }
+}
+
+/**
+   Starts a transaction.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[out]     Txn           Pointer to the transaction.
+
+   @retval EFI_SUCCESS           The transaction was started.
+   @retval EFI_WRITE_PROTECTED   The partition is read-only.
+**/
+EFI_STATUS
+Ext4BeginTransaction (
+  IN  EXT4_PARTITION    *Partition,
+  OUT EXT4_TRANSACTION  *Txn
+  )
+{
+  ZeroMem (Txn, sizeof (*Txn));
+  InitializeListHead (&Txn->Blocks);
+  Txn->Partition = Partition;
+
+  if (Partition->ReadOnly || (Partition->Journal.File == NULL)) {
+    return EFI_WRITE_PROTECTED;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Finds the transaction's copy of a metadata block.
+
+   @param[in]      Txn           Pointer to the transaction.
+   @param[in]      Block         Block number.
+
+   @return Pointer to the copy, or NULL if the transaction doesn't hold the block.
+**/
+UINT8 *
+Ext4TxnFindBlock (
+  IN CONST EXT4_TRANSACTION  *Txn,
+  IN EXT4_BLOCK_NR           Block
+  )
+{
+  LIST_ENTRY      *Node;
+  EXT4_TXN_BLOCK  *TxnBlock;
+
+  BASE_LIST_FOR_EACH (Node, &Txn->Blocks) {
+    TxnBlock = EXT4_TXN_BLOCK_FROM_LINK (Node);
+
+    if (TxnBlock->Block == Block) {
+      return EXT4_TXN_BLOCK_DATA (TxnBlock);
+    }
+  }
+
+  return NULL;
+}
+
+/**
+   Checks if a transaction may hold more blocks.
+
+   @param[in]      Txn           Pointer to the transaction.
+   @param[in]      NumberBlocks  Number of blocks that would be added.
+
+   @return TRUE if the blocks fit, else FALSE.
+**/
+BOOLEAN
+Ext4TxnHasRoom (
+  IN CONST EXT4_TRANSACTION  *Txn,
+  IN UINTN                   NumberBlocks
+  )
+{
+  return Txn->NumberBlocks + NumberBlocks <= Txn->Partition->Journal.MaxTransactionBlocks;
+}
+
+/**
+   Gets the transaction's copy of a metadata block, which is modified in place
+   and written by Ext4CommitTransaction().
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      Block         Block number.
+   @param[in]      Zero          If TRUE, a block that isn't held by the
+                                 transaction yet starts zeroed instead of being read.
+   @param[out]     Data          Pointer to the copy, Partition->BlockSize bytes long.
+
+   @retval EFI_SUCCESS           The copy was returned.
+   @retval EFI_OUT_OF_RESOURCES  The transaction is full, or out of memory.
+   @retval !EFI_SUCCESS          The block could not be read.
+**/
+EFI_STATUS
+Ext4TxnGetBlock (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_BLOCK_NR     Block,
+  IN     BOOLEAN           Zero,
+  OUT    UINT8             **Data
+  )
+{
+  EXT4_PARTITION  *Partition;
+  EXT4_TXN_BLOCK  *TxnBlock;
+  EFI_STATUS      Status;
+
+  Partition = Txn->Partition;
+
+  *Data = Ext4TxnFindBlock (Txn, Block);
+
+  if (*Data != NULL) {
+    if (Zero) {
+      ZeroMem (*Data, Partition->BlockSize);
+    }
+
+    return EFI_SUCCESS;
+  }
+
+  // Block 0 holds the superblock (or the boot sector), which isn't journaled
+  if ((Block == 0) || (Block >= Partition->NumberBlocks)) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  if (!Ext4TxnHasRoom (Txn, 1)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  TxnBlock = AllocatePool (sizeof (EXT4_TXN_BLOCK) + Partition->BlockSize);
+
+  if (TxnBlock == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  TxnBlock->Block = Block;
+
+  if (Zero) {
+    ZeroMem (EXT4_TXN_BLOCK_DATA (TxnBlock), Partition->BlockSize);
+  } else {
+    Status = Ext4ReadBlocksCached (Partition, Ext4BlockCacheMetadata, EXT4_TXN_BLOCK_DATA (TxnBlock), 1, Block);
+
+    if (EFI_ERROR (Status)) {
+      FreePool (TxnBlock);
+      return Status;
+    }
+  }
+
+  InsertTailList (&Txn->Blocks, &TxnBlock->Link);
+  Txn->NumberBlocks++;
+
+  *Data = EXT4_TXN_BLOCK_DATA (TxnBlock);
+  return EFI_SUCCESS;
+}
+
+/**
+   Drops the transaction's copies of blocks that were freed.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      Start         First block.
+   @param[in]      Count         Number of blocks.
+**/
+VOID
+Ext4TxnForgetBlocks (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_BLOCK_NR     Start,
+  IN     UINT64            Count
+  )
+{
+  LIST_ENTRY      *Node;
+  LIST_ENTRY      *Next;
+  EXT4_TXN_BLOCK  *TxnBlock;
+
+  BASE_LIST_FOR_EACH_SAFE (Node, Next, &Txn->Blocks) {
+    TxnBlock = EXT4_TXN_BLOCK_FROM_LINK (Node);
+
+    if ((TxnBlock->Block >= Start) && (TxnBlock->Block - Start < Count)) {
+      RemoveEntryList (&TxnBlock->Link);
+      FreePool (TxnBlock);
+      Txn->NumberBlocks--;
+    }
+  }
+}
+
+/**
+   Drops a transaction without writing anything.
+
+   @param[in out]  Txn           Pointer to the transaction.
+**/
+VOID
+Ext4AbortTransaction (
+  IN OUT EXT4_TRANSACTION  *Txn
+  )
+{
+  LIST_ENTRY      *Node;
+  LIST_ENTRY      *Next;
+  EXT4_TXN_BLOCK  *TxnBlock;
+
+  BASE_LIST_FOR_EACH_SAFE (Node, Next, &Txn->Blocks) {
+    TxnBlock = EXT4_TXN_BLOCK_FROM_LINK (Node);
+    RemoveEntryList (&TxnBlock->Link);
+    FreePool (TxnBlock);
+  }
+
+  if (Txn->Freed != NULL) {
+    FreePool (Txn->Freed);
+  }
+
+  if (Txn->Inodes != NULL) {
+    FreePool (Txn->Inodes);
+  }
+
+  Txn->Freed        = NULL;
+  Txn->NumberFreed  = 0;
+  Txn->MaxFreed     = 0;
+  Txn->Inodes       = NULL;
+  Txn->NumberInodes = 0;
+  Txn->MaxInodes    = 0;
+  Txn->NumberBlocks = 0;
+}
+
+/**
+   Fills a descriptor tag.
+
+   @param[in]      Journal       Pointer to the journal.
+   @param[out]     Tag           Pointer to the tag.
+   @param[in]      Block         Home location of the block.
+   @param[in]      Flags         JBD2_FLAG_* flags of the tag.
+   @param[in]      Copy          Pointer to the copy of the block in the journal.
+   @param[in]      BlockSize     Size of the block.
+**/
+STATIC
+VOID
+Ext4JournalFillTag (
+  IN  EXT4_JOURNAL   *Journal,
+  OUT UINT8          *Tag,
+  IN  EXT4_BLOCK_NR  Block,
+  IN  UINT32         Flags,
+  IN  CONST UINT8    *Copy,
+  IN  UINT32         BlockSize
+  )
+{
+  JBD2_BLOCK_TAG3  *Tag3;
+  JBD2_BLOCK_TAG   *Tag2;
+  UINT32           Sequence;
+  UINT32           Csum;
+
+  if (Journal->CsumV3) {
+    Tag3                 = (JBD2_BLOCK_TAG3 *)Tag;
+    Tag3->t_blocknr      = SwapBytes32 ((UINT32)Block);
+    Tag3->t_blocknr_high = SwapBytes32 ((UINT32)RShiftU64 (Block, 32));
+    Tag3->t_flags        = SwapBytes32 (Flags);
+
+    // The checksum covers the block as it's stored in the journal, escaped
+    Sequence        = SwapBytes32 (Journal->Sequence);
+    Csum            = Crc32cUpdate (Journal->ChecksumSeed, &Sequence, sizeof (Sequence));
+    Csum            = Crc32cUpdate (Csum, Copy, BlockSize);
+    Tag3->t_checksum = SwapBytes32 (Csum);
+    return;
+  }
+
+  Tag2             = (JBD2_BLOCK_TAG *)Tag;
+  Tag2->t_blocknr  = SwapBytes32 ((UINT32)Block);
+  Tag2->t_checksum = 0;
+  Tag2->t_flags    = SwapBytes16 ((UINT16)Flags);
+
+  if (Journal->TagSize == sizeof (JBD2_BLOCK_TAG)) {
+    Tag2->t_blocknr_high = SwapBytes32 ((UINT32)RShiftU64 (Block, 32));
+  }
+}
+
+/**
+   Lays out the log of a transaction: descriptor blocks, each followed by the
+   copies of the blocks it describes, and the commit block.
+
+   @param[in]      Txn           Pointer to the transaction.
+   @param[out]     Log           Pointer to a buffer large enough for the log.
+
+   @return Number of blocks of the log, including the commit block.
+**/
+STATIC
+UINTN
+Ext4BuildTransactionLog (
+  IN  EXT4_TRANSACTION  *Txn,
+  OUT UINT8             *Log
+  )
+{
+  EXT4_PARTITION      *Partition;
+  EXT4_JOURNAL        *Journal;
+  UINT32              BlockSize;
+  LIST_ENTRY          *Node;
+  EXT4_TXN_BLOCK      *TxnBlock;
+  UINT8               *Descriptor;
+  UINT8               *Copy;
+  JBD2_HEADER         *Header;
+  JBD2_BLOCK_TAIL     *Tail;
+  JBD2_COMMIT_HEADER  *Commit;
+  UINTN               Index;
+  UINTN               TagOffset;
+  UINT32              Tag;
+  UINT32              Flags;
+
+  Partition = Txn->Partition;
+  Journal   = &Partition->Journal;
+  BlockSize = Partition->BlockSize;
+  Index     = 0;
+  Node      = GetFirstNode (&Txn->Blocks);
+
+  while (!IsNull (&Txn->Blocks, Node)) {
+    Descriptor = Log + Index++ * BlockSize;
+    ZeroMem (Descriptor, BlockSize);
+
+    Header              = (JBD2_HEADER *)Descriptor;
+    Header->h_magic     = SwapBytes32 (JBD2_MAGIC_NUMBER);
+    Header->h_blocktype = SwapBytes32 (JBD2_DESCRIPTOR_BLOCK);
+    Header->h_sequence  = SwapBytes32 (Journal->Sequence);
+    TagOffset           = sizeof (JBD2_HEADER);
+
+    for (Tag = 0; Tag < Journal->TagsPerDescriptor && !IsNull (&Txn->Blocks, Node); Tag++) {
+      TxnBlock = EXT4_TXN_BLOCK_FROM_LINK (Node);
+      Node     = GetNextNode (&Txn->Blocks, Node);
+      Copy     = Log + Index++ * BlockSize;
+      Flags    = 0;
+
+      CopyMem (Copy, EXT4_TXN_BLOCK_DATA (TxnBlock), BlockSize);
+
+      // Blocks that could be mistaken for journal blocks are escaped
+      if (ReadUnaligned32 ((UINT32 *)Copy) == SwapBytes32 (JBD2_MAGIC_NUMBER)) {
+        WriteUnaligned32 ((UINT32 *)Copy, 0);
+        Flags |= JBD2_FLAG_ESCAPE;
+      }
+
+      if (Tag != 0) {
+        Flags |= JBD2_FLAG_SAME_UUID;
+      }
+
+      if ((Tag == Journal->TagsPerDescriptor - 1) || IsNull (&Txn->Blocks, Node)) {
+        Flags |= JBD2_FLAG_LAST_TAG;
+      }
+
+      Ext4JournalFillTag (Journal, Descriptor + TagOffset, TxnBlock->Block, Flags, Copy, BlockSize);
+      TagOffset += Journal->TagSize;
+
+      if (Tag == 0) {
+        CopyMem (Descriptor + TagOffset, Journal->Sb.s_uuid, sizeof (Journal->Sb.s_uuid));
+        TagOffset += sizeof (Journal->Sb.s_uuid);
+      }
+    }
+
+    if (Journal->CsumV3) {
+      Tail              = (JBD2_BLOCK_TAIL *)(Descriptor + BlockSize - sizeof (JBD2_BLOCK_TAIL));
+      Tail->t_checksum = SwapBytes32 (Crc32cUpdate (Journal->ChecksumSeed, Descriptor, BlockSize));
+    }
+  }
+
+  Commit = (JBD2_COMMIT_HEADER *)(Log + Index++ * BlockSize);
+  ZeroMem (Commit, BlockSize);
+
+  Commit->h_header.h_magic     = SwapBytes32 (JBD2_MAGIC_NUMBER);
+  Commit->h_header.h_blocktype = SwapBytes32 (JBD2_COMMIT_BLOCK);
+  Commit->h_header.h_sequence  = SwapBytes32 (Journal->Sequence);
+
+  if (Journal->CsumV3) {
+    Commit->h_chksum[0] = SwapBytes32 (Crc32cUpdate (Journal->ChecksumSeed, Commit, BlockSize));
+  }
+
+  return Index;
+}
+
+/**
+   Applies the changes of a transaction to the free counts of the superblock.
+
+   @param[in]      Txn           Pointer to the transaction.
+**/
+STATIC
+VOID
+Ext4ApplyFreeCounts (
+  IN EXT4_TRANSACTION  *Txn
+  )
+{
+  EXT4_PARTITION   *Partition;
+  EXT4_SUPERBLOCK  *Sb;
+  UINT64           FreeBlocks;
+
+  Partition = Txn->Partition;
+  Sb        = &Partition->SuperBlock;
+
+  FreeBlocks = EXT4_BLOCK_NR_FROM_HALFS (Partition, Sb->s_free_blocks_count, Sb->s_free_blocks_count_hi);
+  FreeBlocks = (UINT64)((INT64)FreeBlocks + Txn->FreeBlocksDelta);
+
+  Sb->s_free_blocks_count = (UINT32)FreeBlocks;
+
+  if (EXT4_IS_64_BIT (Partition)) {
+    Sb->s_free_blocks_count_hi = (UINT32)RShiftU64 (FreeBlocks, 32);
+  }
+
+  Sb->s_free_inodes_count = (UINT32)((INT64)Sb->s_free_inodes_count + Txn->FreeInodesDelta);
+}
+
+/**
+   Marks the journal as empty, and the filesystem as not needing recovery.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      Sequence      Sequence number of the next transaction.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4EmptyJournal (
+  IN EXT4_PARTITION  *Partition,
+  IN UINT32          Sequence
+  )
+{
+  EFI_STATUS  Status;
+
+  Partition->Journal.Sb.s_start    = 0;
+  Partition->Journal.Sb.s_sequence = SwapBytes32 (Sequence);
+
+  Status = Ext4JournalWriteSuperblock (Partition);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Partition->SuperBlock.s_feature_incompat &= ~EXT4_FEATURE_INCOMPAT_RECOVER;
+
+  Status = Ext4WriteSuperblock (Partition);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return Ext4FlushDisk (Partition);
+}
+
+/**
+   Commits a transaction through the journal, then writes its blocks to their
+   home locations. The transaction is freed, whatever the outcome.
+
+   @param[in out]  Txn           Pointer to the transaction.
+
+   @retval EFI_SUCCESS           The transaction is committed.
+   @retval !EFI_SUCCESS          The transaction could not be committed. If
+                                 it might be partially applied, the partition
+                                 is made read-only, and the transaction is
+                                 left for the journal recovery of the next
+                                 mount by Linux.
+**/
+EFI_STATUS
+Ext4CommitTransaction (
+  IN OUT EXT4_TRANSACTION  *Txn
+  )
+{
+  EXT4_PARTITION  *Partition;
+  EXT4_JOURNAL    *Journal;
+  EFI_STATUS      Status;
+  UINT8           *Log;
+  UINTN           LogLength;
+  UINTN           MaxDescriptors;
+  LIST_ENTRY      *Node;
+  EXT4_TXN_BLOCK  *TxnBlock;
+  UINTN           Index;
+
+  Partition = Txn->Partition;
+  Journal   = &Partition->Journal;
+
+  if (Txn->NumberBlocks == 0) {
+    Ext4AbortTransaction (Txn);
+    return EFI_SUCCESS;
+  }
+
+  if (Partition->ReadOnly) {
+    Ext4AbortTransaction (Txn);
+    return EFI_WRITE_PROTECTED;
+  }
+
+  ASSERT (Txn->NumberBlocks <= Journal->MaxTransactionBlocks);
+
+  MaxDescriptors = (Txn->NumberBlocks + Journal->TagsPerDescriptor - 1) / Journal->TagsPerDescriptor;
+  Log            = AllocatePool ((Txn->NumberBlocks + MaxDescriptors + 1) * Partition->BlockSize);
+
+  if (Log == NULL) {
+    Ext4AbortTransaction (Txn);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  LogLength = Ext4BuildTransactionLog (Txn, Log);
+
+  // 1) Mark the filesystem as needing recovery, and write the log but its commit block
+  Partition->SuperBlock.s_feature_incompat |= EXT4_FEATURE_INCOMPAT_RECOVER;
+  Journal->Sb.s_sequence                    = SwapBytes32 (Journal->Sequence);
+  Journal->Sb.s_start                       = SwapBytes32 (Journal->First);
+
+  Status = Ext4WriteSuperblock (Partition);
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4JournalWriteSuperblock (Partition);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4JournalWrite (Partition, Journal->First, Log, LogLength - 1);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4FlushDisk (Partition);
+  }
+
+  if (EFI_ERROR (Status)) {
+    // Nothing was committed; try to leave the filesystem as we found it
+    DEBUG ((DEBUG_ERROR, "[ext4] Failed to write transaction %u: %r\n", Journal->Sequence, Status));
+
+    if (EFI_ERROR (Ext4EmptyJournal (Partition, Journal->Sequence))) {
+      Partition->ReadOnly = TRUE;
+    }
+
+    goto Out;
+  }
+
+  // 2) Commit
+  Status = Ext4JournalWrite (
+             Partition,
+             Journal->First + (UINT32)LogLength - 1,
+             Log + (LogLength - 1) * Partition->BlockSize,
+             1
+             );
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4FlushDisk (Partition);
+  }
+
+  // 3) Checkpoint
+  if (!EFI_ERROR (Status)) {
+    BASE_LIST_FOR_EACH (Node, &Txn->Blocks) {
+      TxnBlock = EXT4_TXN_BLOCK_FROM_LINK (Node);
+      Status   = Ext4WriteBlocksCached (Partition, EXT4_TXN_BLOCK_DATA (TxnBlock), 1, TxnBlock->Block);
+
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+    }
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4FlushDisk (Partition);
+  }
+
+  // The home locations of the inodes may have been written, even on failure;
+  // until now, the cache and the disk agreed on the old copies
+  for (Index = 0; Index < Txn->NumberInodes; Index++) {
+    Ext4InodeCacheForget (Partition, Txn->Inodes[Index]);
+  }
+
+  // 4) Empty the journal
+  if (!EFI_ERROR (Status)) {
+    Ext4ApplyFreeCounts (Txn);
+    Status = Ext4EmptyJournal (Partition, Journal->Sequence + 1);
+  }
+
+  if (EFI_ERROR (Status)) {
+    // The transaction may be committed, and the journal has to be replayed
+    // before anything else is written
+    DEBUG ((DEBUG_ERROR, "[ext4] Failed to commit transaction %u: %r, now read-only\n", Journal->Sequence, Status));
+    Partition->ReadOnly = TRUE;
+  }
+
+  Journal->Sequence++;
+
+Out:
+  FreePool (Log);
+  Ext4AbortTransaction (Txn);
+  return Status;
+}
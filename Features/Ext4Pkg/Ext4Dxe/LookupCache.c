@@ -0,0 +1,637 @@
+/** @file
+  Dentry and inode caches
+
+  Copyright (c) 2024 Pedro Falcato All rights reserved.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  The dentry cache remembers what a (directory inode, name) pair resolved to,
+  including names that don't exist, so that repeatedly probing the same paths
+  doesn't search the same directories over and over. The inode cache keeps
+  copies of inodes that were read and verified, keyed by inode number.
+
+  Unlike EXT4_DENTRY, which only lives as long as the files that reference it,
+  entries of these caches survive across opens. Both caches are bounded and
+  recycle their least recently used entry once they're full. The driver drops
+  the entries of the directories and inodes it modifies, so entries otherwise
+  only become stale if the media changes, which is detected through the media ID.
+**/
+
+#include "Ext4Dxe.h"
+
+typedef struct {
+  LIST_ENTRY    HashNode;
+  LIST_ENTRY    LruNode;
+  UINT32        Hash;
+} EXT4_LOOKUP_CACHE_ENTRY;
+
+typedef struct {
+  EXT4_LOOKUP_CACHE_ENTRY    Header;
+  EXT4_INO_NR                Directory;
+  // Directory entry the name resolved to; its inode is 0 if the name doesn't exist.
+  EXT4_DIR_ENTRY             Entry;
+  // Followed by the NUL-terminated name that was looked up
+} EXT4_CACHED_DENTRY;
+
+typedef struct {
+  EXT4_LOOKUP_CACHE_ENTRY    Header;
+  EXT4_INO_NR                InodeNum;
+  // Followed by Partition->InodeSize bytes of the on-disk inode
+} EXT4_CACHED_INODE;
+
+#define EXT4_CACHED_DENTRY_NAME(Dentry)  ((CHAR16 *)((EXT4_CACHED_DENTRY *)(Dentry) + 1))
+#define EXT4_CACHED_INODE_DATA(Inode)    ((EXT4_INODE *)((EXT4_CACHED_INODE *)(Inode) + 1))
+
+#define EXT4_LOOKUP_CACHE_ENTRY_FROM_HASH_NODE(Node)  BASE_CR (Node, EXT4_LOOKUP_CACHE_ENTRY, HashNode)
+#define EXT4_LOOKUP_CACHE_ENTRY_FROM_LRU_NODE(Node)   BASE_CR (Node, EXT4_LOOKUP_CACHE_ENTRY, LruNode)
+
+/**
+   Initialises a lookup cache.
+
+   @param[in out]  Cache          Pointer to the cache.
+   @param[in]      MaxCount       Maximum number of entries; 0 disables the cache.
+   @param[in]      MediaId        Media ID of the partition's disk.
+
+   @retval EFI_SUCCESS            The cache was initialised, or it is disabled.
+   @retval EFI_OUT_OF_RESOURCES   The hash table could not be allocated.
+**/
+STATIC
+EFI_STATUS
+Ext4LookupCacheInit (
+  IN OUT EXT4_LOOKUP_CACHE  *Cache,
+  IN     UINTN              MaxCount,
+  IN     UINT32             MediaId
+  )
+{
+  UINTN  NumberBuckets;
+  UINTN  Index;
+
+  InitializeListHead (&Cache->Lru);
+  Cache->Buckets  = NULL;
+  Cache->Count    = 0;
+  Cache->MaxCount = MaxCount;
+  Cache->MediaId  = MediaId;
+  Cache->Hits     = 0;
+  Cache->Misses   = 0;
+
+  if (MaxCount == 0) {
+    return EFI_SUCCESS;
+  }
+
+  // Aim for a load factor of at most 1 when the cache is full
+  NumberBuckets = GetPowerOfTwo32 ((UINT32)MaxCount);
+  if (NumberBuckets < MaxCount) {
+    NumberBuckets <<= 1;
+  }
+
+  Cache->Buckets = AllocatePool (NumberBuckets * sizeof (LIST_ENTRY));
+
+  if (Cache->Buckets == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  for (Index = 0; Index < NumberBuckets; Index++) {
+    InitializeListHead (&Cache->Buckets[Index]);
+  }
+
+  Cache->BucketMask = NumberBuckets - 1;
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Drops every entry held by a lookup cache.
+
+   @param[in out]  Cache          Pointer to the cache.
+**/
+STATIC
+VOID
+Ext4LookupCacheInvalidate (
+  IN OUT EXT4_LOOKUP_CACHE  *Cache
+  )
+{
+  EXT4_LOOKUP_CACHE_ENTRY  *Entry;
+
+  while (!IsListEmpty (&Cache->Lru)) {
+    Entry = EXT4_LOOKUP_CACHE_ENTRY_FROM_LRU_NODE (GetFirstNode (&Cache->Lru));
+    RemoveEntryList (&Entry->HashNode);
+    RemoveEntryList (&Entry->LruNode);
+    FreePool (Entry);
+  }
+
+  Cache->Count = 0;
+}
+
+/**
+   Drops every entry held by a lookup cache and frees the cache.
+
+   @param[in out]  Cache          Pointer to the cache.
+   @param[in]      Name           Name of the cache, for statistics.
+**/
+STATIC
+VOID
+Ext4LookupCacheFree (
+  IN OUT EXT4_LOOKUP_CACHE  *Cache,
+  IN     CONST CHAR8        *Name
+  )
+{
+  UINT64  Lookups;
+
+  if (Cache->Buckets == NULL) {
+    return;
+  }
+
+  Lookups = Cache->Hits + Cache->Misses;
+
+  DEBUG ((
+    DEBUG_FS,
+    "[ext4] %a cache: %lu hits %lu misses (%lu%% hit rate)\n",
+    Name,
+    Cache->Hits,
+    Cache->Misses,
+    Lookups == 0 ? 0 : DivU64x64Remainder (MultU64x32 (Cache->Hits, 100), Lookups, NULL)
+    ));
+
+  Ext4LookupCacheInvalidate (Cache);
+  FreePool (Cache->Buckets);
+  Cache->Buckets = NULL;
+}
+
+/**
+   Checks whether a lookup cache can be used, dropping its entries if the
+   media changed since they were cached.
+
+   @param[in]      Partition      Pointer to the opened ext4 partition.
+   @param[in out]  Cache          Pointer to the cache.
+
+   @return TRUE if the cache is enabled, else FALSE.
+**/
+STATIC
+BOOLEAN
+Ext4LookupCacheUsable (
+  IN     EXT4_PARTITION     *Partition,
+  IN OUT EXT4_LOOKUP_CACHE  *Cache
+  )
+{
+  if (Cache->Buckets == NULL) {
+    return FALSE;
+  }
+
+  if (Cache->MediaId != EXT4_MEDIA_ID (Partition)) {
+    DEBUG ((DEBUG_FS, "[ext4] Media changed, invalidating the lookup caches\n"));
+    Ext4LookupCacheInvalidate (&Partition->DentryCache);
+    Ext4LookupCacheInvalidate (&Partition->InodeCache);
+    Partition->DentryCache.MediaId = EXT4_MEDIA_ID (Partition);
+    Partition->InodeCache.MediaId  = EXT4_MEDIA_ID (Partition);
+  }
+
+  return TRUE;
+}
+
+/**
+   Retrieves the hash bucket of an entry.
+
+   @param[in]  Cache          Pointer to the cache.
+   @param[in]  Hash           Hash of the entry's key.
+
+   @return Pointer to the head of the bucket's list.
+**/
+STATIC
+LIST_ENTRY *
+Ext4LookupCacheBucket (
+  IN CONST EXT4_LOOKUP_CACHE  *Cache,
+  IN UINT32                   Hash
+  )
+{
+  return &Cache->Buckets[Hash & Cache->BucketMask];
+}
+
+/**
+   Marks an entry that was found in the cache as the most recently used one.
+
+   @param[in out]  Cache          Pointer to the cache.
+   @param[in]      Entry          Pointer to the entry.
+**/
+STATIC
+VOID
+Ext4LookupCacheHit (
+  IN OUT EXT4_LOOKUP_CACHE        *Cache,
+  IN     EXT4_LOOKUP_CACHE_ENTRY  *Entry
+  )
+{
+  RemoveEntryList (&Entry->LruNode);
+  InsertHeadList (&Cache->Lru, &Entry->LruNode);
+  Cache->Hits++;
+}
+
+/**
+   Removes an entry from the cache and frees it.
+
+   @param[in out]  Cache          Pointer to the cache.
+   @param[in]      Entry          Pointer to the entry.
+**/
+STATIC
+VOID
+Ext4LookupCacheRemove (
+  IN OUT EXT4_LOOKUP_CACHE        *Cache,
+  IN     EXT4_LOOKUP_CACHE_ENTRY  *Entry
+  )
+{
+  RemoveEntryList (&Entry->HashNode);
+  RemoveEntryList (&Entry->LruNode);
+  FreePool (Entry);
+  Cache->Count--;
+}
+
+/**
+   Inserts an entry in the cache, as the most recently used one.
+   If the cache is full, its least recently used entry is evicted.
+
+   @param[in out]  Cache          Pointer to the cache.
+   @param[in]      Entry          Pointer to the entry, allocated from pool.
+   @param[in]      Hash           Hash of the entry's key.
+**/
+STATIC
+VOID
+Ext4LookupCacheInsert (
+  IN OUT EXT4_LOOKUP_CACHE        *Cache,
+  IN     EXT4_LOOKUP_CACHE_ENTRY  *Entry,
+  IN     UINT32                   Hash
+  )
+{
+  EXT4_LOOKUP_CACHE_ENTRY  *Victim;
+
+  if (Cache->Count >= Cache->MaxCount) {
+    Victim = EXT4_LOOKUP_CACHE_ENTRY_FROM_LRU_NODE (GetPreviousNode (&Cache->Lru, &Cache->Lru));
+    Ext4LookupCacheRemove (Cache, Victim);
+  }
+
+  Entry->Hash = Hash;
+  InsertHeadList (Ext4LookupCacheBucket (Cache, Hash), &Entry->HashNode);
+  InsertHeadList (&Cache->Lru, &Entry->LruNode);
+  Cache->Count++;
+}
+
+/**
+   Hashes the key of a dentry cache entry.
+
+   @param[in]  Directory      Inode number of the directory.
+   @param[in]  Name           Name that was looked up.
+
+   @return The hash of the key.
+**/
+STATIC
+UINT32
+Ext4HashDentry (
+  IN EXT4_INO_NR   Directory,
+  IN CONST CHAR16  *Name
+  )
+{
+  UINT32  Hash;
+
+  // FNV-1a
+  Hash = 2166136261U ^ Directory;
+
+  while (*Name != L'\0') {
+    Hash = (Hash ^ *Name++) * 16777619U;
+  }
+
+  return Hash;
+}
+
+/**
+   Hashes the key of an inode cache entry.
+
+   @param[in]  InodeNum       Inode number.
+
+   @return The hash of the key.
+**/
+STATIC
+UINT32
+Ext4HashInode (
+  IN EXT4_INO_NR  InodeNum
+  )
+{
+  // Fibonacci hashing; inode numbers that are close together spread over the buckets
+  return (InodeNum * 2654435769U) ^ (InodeNum >> 16);
+}
+
+/**
+   Initialises the dentry and inode caches of the partition, sizing them after
+   PcdExt4DentryCacheEntries and PcdExt4InodeCacheEntries.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+
+   @retval EFI_SUCCESS            The caches were initialised, or are disabled.
+   @retval EFI_OUT_OF_RESOURCES   A hash table could not be allocated.
+**/
+EFI_STATUS
+Ext4InitLookupCaches (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = Ext4LookupCacheInit (
+             &Partition->DentryCache,
+             PcdGet32 (PcdExt4DentryCacheEntries),
+             EXT4_MEDIA_ID (Partition)
+             );
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = Ext4LookupCacheInit (
+             &Partition->InodeCache,
+             PcdGet32 (PcdExt4InodeCacheEntries),
+             EXT4_MEDIA_ID (Partition)
+             );
+
+  if (EFI_ERROR (Status)) {
+    Ext4LookupCacheFree (&Partition->DentryCache, "Dentry");
+  }
+
+  return Status;
+}
+
+/**
+   Drops every entry held by the dentry and inode caches and frees the caches.
+
+   @param[in out]  Partition      Pointer to the opened ext4 partition.
+**/
+VOID
+Ext4FreeLookupCaches (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  Ext4LookupCacheFree (&Partition->DentryCache, "Dentry");
+  Ext4LookupCacheFree (&Partition->InodeCache, "Inode");
+}
+
+/**
+   Looks the result of a name lookup up in the dentry cache.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Directory      Inode number of the directory.
+   @param[in]  Name           Name that was looked up.
+   @param[out] Result         Pointer to the destination directory entry.
+
+   @retval EFI_SUCCESS        The name is cached and exists; Result was filled.
+   @retval EFI_NOT_FOUND      The name is cached as not existing.
+   @retval EFI_NO_MAPPING     The name is not cached.
+**/
+EFI_STATUS
+Ext4DentryCacheLookup (
+  IN EXT4_PARTITION   *Partition,
+  IN EXT4_INO_NR      Directory,
+  IN CONST CHAR16     *Name,
+  OUT EXT4_DIR_ENTRY  *Result
+  )
+{
+  EXT4_LOOKUP_CACHE   *Cache;
+  EXT4_CACHED_DENTRY  *Dentry;
+  LIST_ENTRY          *Node;
+  UINT32              Hash;
+
+  Cache = &Partition->DentryCache;
+
+  if (!Ext4LookupCacheUsable (Partition, Cache)) {
+    return EFI_NO_MAPPING;
+  }
+
+  Hash = Ext4HashDentry (Directory, Name);
+
+  BASE_LIST_FOR_EACH (Node, Ext4LookupCacheBucket (Cache, Hash)) {
+    Dentry = (EXT4_CACHED_DENTRY *)EXT4_LOOKUP_CACHE_ENTRY_FROM_HASH_NODE (Node);
+
+    if (  (Dentry->Header.Hash != Hash)
+       || (Dentry->Directory != Directory)
+       || (StrCmp (EXT4_CACHED_DENTRY_NAME (Dentry), Name) != 0))
+    {
+      continue;
+    }
+
+    Ext4LookupCacheHit (Cache, &Dentry->Header);
+
+    if (Dentry->Entry.inode == 0) {
+      return EFI_NOT_FOUND;
+    }
+
+    CopyMem (Result, &Dentry->Entry, sizeof (EXT4_DIR_ENTRY));
+    return EFI_SUCCESS;
+  }
+
+  Cache->Misses++;
+  return EFI_NO_MAPPING;
+}
+
+/**
+   Caches the result of a name lookup that missed the dentry cache.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Directory      Inode number of the directory.
+   @param[in]  Name           Name that was looked up.
+   @param[in]  Entry          Directory entry the name resolved to, or NULL
+                              if the name doesn't exist.
+**/
+VOID
+Ext4DentryCacheInsert (
+  IN EXT4_PARTITION        *Partition,
+  IN EXT4_INO_NR           Directory,
+  IN CONST CHAR16          *Name,
+  IN CONST EXT4_DIR_ENTRY  *Entry OPTIONAL
+  )
+{
+  EXT4_LOOKUP_CACHE   *Cache;
+  EXT4_CACHED_DENTRY  *Dentry;
+  UINTN               NameSize;
+
+  Cache = &Partition->DentryCache;
+
+  if (!Ext4LookupCacheUsable (Partition, Cache)) {
+    return;
+  }
+
+  NameSize = StrSize (Name);
+  Dentry   = AllocatePool (sizeof (EXT4_CACHED_DENTRY) + NameSize);
+
+  // Caching is best effort
+  if (Dentry == NULL) {
+    return;
+  }
+
+  Dentry->Directory = Directory;
+
+  if (Entry != NULL) {
+    CopyMem (&Dentry->Entry, Entry, sizeof (EXT4_DIR_ENTRY));
+  } else {
+    ZeroMem (&Dentry->Entry, sizeof (EXT4_DIR_ENTRY));
+  }
+
+  CopyMem (EXT4_CACHED_DENTRY_NAME (Dentry), Name, NameSize);
+
+  Ext4LookupCacheInsert (Cache, &Dentry->Header, Ext4HashDentry (Directory, Name));
+}
+
+/**
+   Looks an inode up in the inode cache.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  InodeNum       Inode number.
+   @param[out] Inode          Pointer to a buffer of at least Partition->InodeSize
+                              bytes that receives the inode.
+
+   @return TRUE if the inode was cached and copied to Inode, else FALSE.
+**/
+BOOLEAN
+Ext4InodeCacheLookup (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_INO_NR     InodeNum,
+  OUT EXT4_INODE     *Inode
+  )
+{
+  EXT4_LOOKUP_CACHE  *Cache;
+  EXT4_CACHED_INODE  *Cached;
+  LIST_ENTRY         *Node;
+  UINT32             Hash;
+
+  Cache = &Partition->InodeCache;
+
+  if (!Ext4LookupCacheUsable (Partition, Cache)) {
+    return FALSE;
+  }
+
+  Hash = Ext4HashInode (InodeNum);
+
+  BASE_LIST_FOR_EACH (Node, Ext4LookupCacheBucket (Cache, Hash)) {
+    Cached = (EXT4_CACHED_INODE *)EXT4_LOOKUP_CACHE_ENTRY_FROM_HASH_NODE (Node);
+
+    if (Cached->InodeNum == InodeNum) {
+      Ext4LookupCacheHit (Cache, &Cached->Header);
+      CopyMem (Inode, EXT4_CACHED_INODE_DATA (Cached), Partition->InodeSize);
+      return TRUE;
+    }
+  }
+
+  Cache->Misses++;
+  return FALSE;
+}
+
+/**
+   Caches an inode. The inode must have been verified already; inodes that
+   are cached already are left alone.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  InodeNum       Inode number.
+   @param[in]  Inode          Pointer to the inode.
+**/
+VOID
+Ext4InodeCacheInsert (
+  IN EXT4_PARTITION    *Partition,
+  IN EXT4_INO_NR       InodeNum,
+  IN CONST EXT4_INODE  *Inode
+  )
+{
+  EXT4_LOOKUP_CACHE  *Cache;
+  EXT4_CACHED_INODE  *Cached;
+  LIST_ENTRY         *Node;
+  UINT32             Hash;
+
+  Cache = &Partition->InodeCache;
+
+  if (!Ext4LookupCacheUsable (Partition, Cache)) {
+    return;
+  }
+
+  Hash = Ext4HashInode (InodeNum);
+
+  // Hard links may bring the same inode in more than once in a batch
+  BASE_LIST_FOR_EACH (Node, Ext4LookupCacheBucket (Cache, Hash)) {
+    if (((EXT4_CACHED_INODE *)EXT4_LOOKUP_CACHE_ENTRY_FROM_HASH_NODE (Node))->InodeNum == InodeNum) {
+      return;
+    }
+  }
+
+  Cached = AllocatePool (sizeof (EXT4_CACHED_INODE) + Partition->InodeSize);
+
+  // Caching is best effort
+  if (Cached == NULL) {
+    return;
+  }
+
+  Cached->InodeNum = InodeNum;
+  CopyMem (EXT4_CACHED_INODE_DATA (Cached), Inode, Partition->InodeSize);
+
+  Ext4LookupCacheInsert (Cache, &Cached->Header, Hash);
+}
+
+/**
+   Drops every cached lookup of a directory, after entries were added to it or
+   removed from it.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  Directory      Inode number of the directory.
+**/
+VOID
+Ext4DentryCacheForgetDirectory (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_INO_NR     Directory
+  )
+{
+  EXT4_LOOKUP_CACHE   *Cache;
+  LIST_ENTRY          *Node;
+  LIST_ENTRY          *Next;
+  EXT4_CACHED_DENTRY  *Dentry;
+
+  Cache = &Partition->DentryCache;
+
+  if (!Ext4LookupCacheUsable (Partition, Cache)) {
+    return;
+  }
+
+  // Names are matched exactly by the cache but case-insensitively on the disk,
+  // so every name cached for the directory may be affected.
+  BASE_LIST_FOR_EACH_SAFE (Node, Next, &Cache->Lru) {
+    Dentry = (EXT4_CACHED_DENTRY *)EXT4_LOOKUP_CACHE_ENTRY_FROM_LRU_NODE (Node);
+
+    if (Dentry->Directory == Directory) {
+      Ext4LookupCacheRemove (Cache, &Dentry->Header);
+    }
+  }
+}
+
+/**
+   Drops an inode from the inode cache, after it was modified.
+
+   @param[in]  Partition      Pointer to the opened ext4 partition.
+   @param[in]  InodeNum       Inode number.
+**/
+VOID
+Ext4InodeCacheForget (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_INO_NR     InodeNum
+  )
+{
+  EXT4_LOOKUP_CACHE  *Cache;
+  EXT4_CACHED_INODE  *Cached;
+  LIST_ENTRY         *Node;
+  UINT32             Hash;
+
+  Cache = &Partition->InodeCache;
+
+  if (!Ext4LookupCacheUsable (Partition, Cache)) {
+    return;
+  }
+
+  Hash = Ext4HashInode (InodeNum);
+
+  BASE_LIST_FOR_EACH (Node, Ext4LookupCacheBucket (Cache, Hash)) {
+    Cached = (EXT4_CACHED_INODE *)EXT4_LOOKUP_CACHE_ENTRY_FROM_HASH_NODE (Node);
+
+    if (Cached->InodeNum == InodeNum) {
+      Ext4LookupCacheRemove (Cache, &Cached->Header);
+      return;
+    }
+  }
+}
@@ -48,6 +48,34 @@ Ext4OpenPartition (
     return Status;
   }
 
+  Status = Ext4InitBlockCache (Part);
+
+  // The block cache is only an optimisation, keep going without it
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "[ext4] Failed to set up the block cache: %r\n", Status));
+  }
+
+  Status = Ext4InitLookupCaches (Part);
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "[ext4] Failed to set up the dentry and inode caches: %r\n", Status));
+  }
+
+  Status = Ext4InitInodeTableWindow (Part);
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "[ext4] Failed to set up the inode table window: %r\n", Status));
+  }
+
+  if (!Part->ReadOnly) {
+    Status = Ext4OpenJournal (Part);
+
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_WARN, "[ext4] Failed to open the journal, mounting read-only: %r\n", Status));
+      Part->ReadOnly = TRUE;
+    }
+  }
+
   Part->Interface.Revision   = EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_REVISION;
   Part->Interface.OpenVolume = Ext4OpenVolume;
   Status                     = gBS->InstallMultipleProtocolInterfaces (
@@ -58,6 +86,10 @@ Ext4OpenPartition (
                                       );
 
   if (EFI_ERROR (Status)) {
+    Ext4CloseJournal (Part);
+    Ext4FreeInodeTableWindow (Part);
+    Ext4FreeLookupCaches (Part);
+    Ext4FreeBlockCache (Part);
     FreePool (Part);
     return Status;
   }
@@ -77,9 +109,8 @@ Ext4SetupFile (
   IN EXT4_PARTITION  *Partition
   )
 {
-  // Note: We don't yet support revision 2 of the file protocol
-  // (needs DISK_IO2 + asynchronous IO)
-  File->Protocol.Revision    = EFI_FILE_PROTOCOL_REVISION;
+  // The Ex functions complete synchronously on disks without DISK_IO2
+  File->Protocol.Revision    = EFI_FILE_PROTOCOL_REVISION2;
   File->Protocol.Open        = Ext4Open;
   File->Protocol.Close       = Ext4Close;
   File->Protocol.Delete      = Ext4Delete;
@@ -89,6 +120,11 @@ Ext4SetupFile (
   File->Protocol.GetPosition = Ext4GetPosition;
   File->Protocol.GetInfo     = Ext4GetInfo;
   File->Protocol.SetInfo     = Ext4SetInfo;
+  File->Protocol.Flush       = Ext4Flush;
+  File->Protocol.OpenEx      = Ext4OpenEx;
+  File->Protocol.ReadEx      = Ext4ReadEx;
+  File->Protocol.WriteEx     = Ext4WriteEx;
+  File->Protocol.FlushEx     = Ext4FlushEx;
 
   File->Partition = Partition;
 }
@@ -111,6 +147,7 @@ Ext4UnmountAndFreePartition (
   BOOLEAN     DeletedRootDentry;
 
   Partition->Unmounting = TRUE;
+  Ext4CloseJournal (Partition);
   Ext4CloseInternal (Partition->Root);
 
   BASE_LIST_FOR_EACH_SAFE (Entry, NextEntry, &Partition->OpenFiles) {
@@ -125,6 +162,9 @@ Ext4UnmountAndFreePartition (
     DEBUG ((DEBUG_ERROR, "[ext4] Failed to delete root dentry - resource leak present.\n"));
   }
 
+  Ext4FreeInodeTableWindow (Partition);
+  Ext4FreeLookupCaches (Partition);
+  Ext4FreeBlockCache (Partition);
   FreePool (Partition->BlockGroups);
   FreePool (Partition);
 
@@ -9,6 +9,28 @@
 
 STATIC CONST UINT32  gSupportedCompatFeat = EXT4_FEATURE_COMPAT_EXT_ATTR;
 
+// Compat features that writes keep consistent. Filesystems with other compat
+// features are mounted read-only. Notes on the newer ones, which mkfs.ext4
+// enables by default since e2fsprogs 1.47:
+// - orphan_file: Writes never create orphans, so the orphan file is left
+//   alone. Pending orphans set the ORPHAN_PRESENT ro compat feature, which
+//   makes us read-only.
+// - fast_commit: Transactions stay out of the fast commit area at the end
+//   of the journal (see Journal.c).
+// - sparse_super2: Only the groups in s_backup_bgs hold backups (see Alloc.c).
+// - stable_inodes: Inodes are never renumbered.
+STATIC CONST UINT32  gWritableCompatFeat =
+  EXT4_FEATURE_COMPAT_DIR_PREALLOC | EXT4_FEATURE_COMPAT_IMAGIC_INODES |
+  EXT3_FEATURE_COMPAT_HAS_JOURNAL | EXT4_FEATURE_COMPAT_EXT_ATTR |
+  EXT4_FEATURE_COMPAT_RESIZE_INO | EXT4_FEATURE_COMPAT_DIR_INDEX |
+  EXT4_FEATURE_COMPAT_SPARSE_SUPER2 | EXT4_FEATURE_COMPAT_FAST_COMMIT |
+  EXT4_FEATURE_COMPAT_STABLE_INODES | EXT4_FEATURE_COMPAT_ORPHAN_FILE;
+
+// Incompat features we can read but not write. MMP would require us to take part
+// in the multiple mount protection protocol.
+STATIC CONST UINT32  gReadOnlyIncompatFeat =
+  EXT4_FEATURE_INCOMPAT_DIRDATA | EXT4_FEATURE_INCOMPAT_MMP;
+
 STATIC CONST UINT32  gSupportedRoCompatFeat =
   EXT4_FEATURE_RO_COMPAT_DIR_NLINK | EXT4_FEATURE_RO_COMPAT_EXTRA_ISIZE |
   EXT4_FEATURE_RO_COMPAT_HUGE_FILE | EXT4_FEATURE_RO_COMPAT_LARGE_FILE |
@@ -18,10 +40,12 @@ STATIC CONST UINT32  gSupportedIncompatFeat =
   EXT4_FEATURE_INCOMPAT_64BIT | EXT4_FEATURE_INCOMPAT_DIRDATA |
   EXT4_FEATURE_INCOMPAT_FLEX_BG | EXT4_FEATURE_INCOMPAT_FILETYPE |
   EXT4_FEATURE_INCOMPAT_EXTENTS | EXT4_FEATURE_INCOMPAT_LARGEDIR |
-  EXT4_FEATURE_INCOMPAT_MMP | EXT4_FEATURE_INCOMPAT_RECOVER | EXT4_FEATURE_INCOMPAT_CSUM_SEED;
+  EXT4_FEATURE_INCOMPAT_MMP | EXT4_FEATURE_INCOMPAT_RECOVER | EXT4_FEATURE_INCOMPAT_CSUM_SEED |
+  EXT4_FEATURE_INCOMPAT_INLINE_DATA;
 
 // Future features that may be nice additions in the future:
-// 1) Btree support: Required for write support and would speed up lookups in large directories.
+// 1) Btree support: Lookups already use the index (see Htree.c), and entries are added
+//    to leaves that have room, but full leaves aren't split yet.
 // 2) meta_bg: Required to mount meta_bg-enabled partitions.
 
 // Note: We ignore MMP because it's impossible that it's mapped elsewhere,
@@ -29,10 +53,10 @@ STATIC CONST UINT32  gSupportedIncompatFeat =
 
 // Note on corruption signaling:
 // We (Ext4Dxe) could signal corruption by setting s_state to |= EXT4_FS_STATE_ERRORS_DETECTED.
-// I've decided against that, because right now the driver is read-only, and
-// that would mean we would need to writeback the superblock. If something like
-// this is desired, it's fairly trivial to look for EFI_VOLUME_CORRUPTED
-// references and add some Ext4SignalCorruption function + function call.
+// We don't, as corruption is usually found while reading, and writing back the
+// superblock from read paths isn't worth it. If something like this is desired,
+// it's fairly trivial to look for EFI_VOLUME_CORRUPTED references and add some
+// Ext4SignalCorruption function + function call, on top of Ext4WriteSuperblock().
 
 /**
    Checks the superblock's magic value.
@@ -241,6 +265,29 @@ Ext4OpenSuperblock (
   // The line below avoids unused variable warnings.
   (VOID)gSupportedCompatFeat;
 
+  if (  ((Partition->FeaturesCompat & ~gWritableCompatFeat) != 0)
+     || ((Partition->FeaturesIncompat & gReadOnlyIncompatFeat) != 0))
+  {
+    DEBUG ((DEBUG_WARN, "[ext4] Features can't be kept consistent by writes, mounting read-only\n"));
+    Partition->ReadOnly = TRUE;
+  }
+
+  if ((Sb->s_state & EXT4_FS_STATE_ERRORS_DETECTED) != 0) {
+    DEBUG ((DEBUG_WARN, "[ext4] Filesystem has errors, mounting read-only\n"));
+    Partition->ReadOnly = TRUE;
+  }
+
+  // Inodes on the orphan list are truncated or freed by the next Linux mount,
+  // possibly after we reused them.
+  if (Sb->s_last_orphan != 0) {
+    DEBUG ((DEBUG_WARN, "[ext4] Filesystem has orphan inodes, mounting read-only\n"));
+    Partition->ReadOnly = TRUE;
+  }
+
+  if (EXT4_BLOCK_IO (Partition)->Media->ReadOnly) {
+    Partition->ReadOnly = TRUE;
+  }
+
   DEBUG ((DEBUG_FS, "Read only = %u\n", Partition->ReadOnly));
 
   if (Sb->s_inodes_per_group == 0) {
@@ -260,8 +307,17 @@ Ext4OpenSuperblock (
     return EFI_UNSUPPORTED;
   }
 
-  Partition->NumberBlocks      = EXT4_BLOCK_NR_FROM_HALFS (Partition, Sb->s_blocks_count, Sb->s_blocks_count_hi);
-  Partition->NumberBlockGroups = DivU64x32 (Partition->NumberBlocks, Sb->s_blocks_per_group);
+  Partition->NumberBlocks = EXT4_BLOCK_NR_FROM_HALFS (Partition, Sb->s_blocks_count, Sb->s_blocks_count_hi);
+
+  if (Partition->NumberBlocks <= Sb->s_first_data_block) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  // The last block group may be shorter than the others
+  Partition->NumberBlockGroups = DivU64x32 (
+                                   Partition->NumberBlocks - Sb->s_first_data_block + Sb->s_blocks_per_group - 1,
+                                   Sb->s_blocks_per_group
+                                   );
 
   DEBUG ((
     DEBUG_FS,
@@ -320,6 +376,8 @@ Ext4OpenSuperblock (
     return EFI_OUT_OF_RESOURCES;
   }
 
+  Partition->RootDentry->Inode = EXT4_ROOT_INODE_NR;
+
   // Note that the cast below is completely safe, because EXT4_FILE is a specialization of EFI_FILE_PROTOCOL
   Status = Ext4OpenVolume (&Partition->Interface, (EFI_FILE_PROTOCOL **)&Partition->Root);
 
@@ -331,6 +389,29 @@ Ext4OpenSuperblock (
   return Status;
 }
 
+/**
+   Writes the in-memory superblock back to the disk, updating its checksum.
+
+   @param[in out]  Partition     Pointer to the opened EXT4 partition.
+
+   @return Status of the write.
+**/
+EFI_STATUS
+Ext4WriteSuperblock (
+  IN OUT EXT4_PARTITION  *Partition
+  )
+{
+  EXT4_SUPERBLOCK  *Sb;
+
+  Sb = &Partition->SuperBlock;
+
+  if (EXT4_HAS_METADATA_CSUM (Partition)) {
+    Sb->s_checksum = Ext4CalculateSuperblockChecksum (Partition, Sb);
+  }
+
+  return Ext4WriteDiskIoCached (Partition, Sb, sizeof (EXT4_SUPERBLOCK), EXT4_SUPERBLOCK_OFFSET);
+}
+
 /**
    Calculates the checksum of the given buffer.
    @param[in]      Partition     Pointer to the opened EXT4 partition.
@@ -355,7 +436,7 @@ Ext4CalculateChecksum (
   switch (Partition->SuperBlock.s_checksum_type) {
     case EXT4_CHECKSUM_CRC32C:
       // For some reason, EXT4 really likes non-inverted CRC32C checksums, so we stick to that here.
-      return ~CalculateCrc32c(Buffer, Length, ~InitialValue);
+      return Crc32cUpdate (InitialValue, Buffer, Length);
     default:
       ASSERT (FALSE);
       return 0;
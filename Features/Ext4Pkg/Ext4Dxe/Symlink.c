@@ -32,6 +32,11 @@ Ext4SymlinkIsFastSymlink (
   UINT32  FileAcl;
   UINT32  ExtAttrBlocks;
 
+  // Inline symlinks may continue past i_data, so they're read like slow symlinks
+  if (EXT4_HAS_INLINE_DATA (File->Inode)) {
+    return FALSE;
+  }
+
   if ((File->Inode->i_flags & EXT4_EA_INODE_FL) == 0) {
     FileAcl = File->Inode->i_file_acl;
     if (EXT4_IS_64_BIT (File->Partition)) {
@@ -0,0 +1,1546 @@
+/** @file
+  File write routines
+
+  Copyright (c) 2024 Pedro Falcato All rights reserved.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  Writes are split in chunks that each commit in their own transaction. A chunk
+  loads the extents of the file in a flat list, writes the file data straight to
+  its blocks while allocating the blocks that are missing, and then stores the
+  list back as an extent tree. Blocks are allocated in runs as long as the
+  chunk's holes, starting where the previous extent ends, so that files written
+  sequentially end up with few, long extents.
+
+  The extent trees that get written have a depth of at most 1, which is enough
+  for 4 leaves of (BlockSize - 12) / 12 extents.
+**/
+
+#include "Ext4Dxe.h"
+
+// Results of sizeof(i_data) / sizeof(extent) - 1 = 4, like EXT4_NR_INLINE_EXTENTS
+#define EXT4_INODE_EXTENTS  4
+
+// Largest number of blocks an uninitialized extent can have
+#define EXT4_EXTENT_MAX_UNINITIALIZED  (EXT4_EXTENT_MAX_INITIALIZED - 1)
+
+typedef struct {
+  // Extents of the file, sorted by logical block
+  EXT4_EXTENT      *Extents;
+  UINTN            Count;
+  UINTN            Capacity;
+  // Blocks of the extent tree's nodes, below the inode
+  EXT4_BLOCK_NR    *Nodes;
+  UINTN            NumberNodes;
+  UINTN            MaxNodes;
+  // TRUE once the extents were changed and need to be stored back
+  BOOLEAN          Dirty;
+} EXT4_EXTENT_LIST;
+
+/**
+   Retrieves the first physical block of an extent.
+
+   @param[in]      Extent        Pointer to the extent.
+
+   @return The block number.
+**/
+STATIC
+EXT4_BLOCK_NR
+Ext4ExtentStart (
+  IN CONST EXT4_EXTENT  *Extent
+  )
+{
+  return LShiftU64 (Extent->ee_start_hi, 32) | Extent->ee_start_lo;
+}
+
+/**
+   Sets the first physical block of an extent.
+
+   @param[out]     Extent        Pointer to the extent.
+   @param[in]      Block         Block number.
+**/
+STATIC
+VOID
+Ext4SetExtentStart (
+  OUT EXT4_EXTENT    *Extent,
+  IN  EXT4_BLOCK_NR  Block
+  )
+{
+  Extent->ee_start_lo = (UINT32)Block;
+  Extent->ee_start_hi = (UINT16)RShiftU64 (Block, 32);
+}
+
+/**
+   Makes room in an array for more elements.
+
+   @param[in out]  Array         Pointer to the array.
+   @param[in out]  Capacity      Number of elements the array can hold.
+   @param[in]      Needed        Number of elements the array needs to hold.
+   @param[in]      ElementSize   Size of an element.
+
+   @retval EFI_SUCCESS           The array can hold Needed elements.
+   @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
+**/
+STATIC
+EFI_STATUS
+Ext4GrowArray (
+  IN OUT VOID   **Array,
+  IN OUT UINTN  *Capacity,
+  IN     UINTN  Needed,
+  IN     UINTN  ElementSize
+  )
+{
+  VOID   *NewArray;
+  UINTN  NewCapacity;
+
+  if (Needed <= *Capacity) {
+    return EFI_SUCCESS;
+  }
+
+  NewCapacity = MAX (Needed, *Capacity == 0 ? 8 : *Capacity * 2);
+  NewArray    = ReallocatePool (*Capacity * ElementSize, NewCapacity * ElementSize, *Array);
+
+  if (NewArray == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  *Array    = NewArray;
+  *Capacity = NewCapacity;
+  return EFI_SUCCESS;
+}
+
+/**
+   Frees the memory of an extent list.
+
+   @param[in out]  List          Pointer to the list.
+**/
+STATIC
+VOID
+Ext4FreeExtentList (
+  IN OUT EXT4_EXTENT_LIST  *List
+  )
+{
+  if (List->Extents != NULL) {
+    FreePool (List->Extents);
+  }
+
+  if (List->Nodes != NULL) {
+    FreePool (List->Nodes);
+  }
+
+  ZeroMem (List, sizeof (*List));
+}
+
+/**
+   Loads the extents of an extent tree node, and of the nodes below it.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      Header        Pointer to the node's header.
+   @param[in]      Depth         Expected depth of the node.
+   @param[in]      MaxEntries    Maximum number of entries of the node.
+   @param[in out]  List          Pointer to the list.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4LoadExtentNode (
+  IN     EXT4_PARTITION            *Partition,
+  IN     EXT4_FILE                 *File,
+  IN     CONST EXT4_EXTENT_HEADER  *Header,
+  IN     UINT16                    Depth,
+  IN     UINT16                    MaxEntries,
+  IN OUT EXT4_EXTENT_LIST          *List
+  )
+{
+  CONST EXT4_EXTENT        *Extent;
+  CONST EXT4_EXTENT_INDEX  *Index;
+  EXT4_EXTENT              *Last;
+  EXT4_EXTENT_HEADER       *Child;
+  EXT4_BLOCK_NR            Block;
+  EFI_STATUS               Status;
+  UINT16                   Entry;
+  UINT16                   MaxChildEntries;
+
+  if (!Ext4ExtentHeaderValid (Header, MaxEntries) || (Header->eh_depth != Depth)) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  if (Depth == 0) {
+    Extent = (CONST EXT4_EXTENT *)(Header + 1);
+
+    Status = Ext4GrowArray (
+               (VOID **)&List->Extents,
+               &List->Capacity,
+               List->Count + Header->eh_entries,
+               sizeof (EXT4_EXTENT)
+               );
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    for (Entry = 0; Entry < Header->eh_entries; Entry++, Extent++) {
+      Block = Ext4ExtentStart (Extent);
+
+      if (  (Ext4GetExtentLength (Extent) == 0) || (Block < Partition->SuperBlock.s_first_data_block)
+         || (Block + Ext4GetExtentLength (Extent) > Partition->NumberBlocks))
+      {
+        return EFI_VOLUME_CORRUPTED;
+      }
+
+      // Extents must be sorted and must not overlap
+      if (List->Count != 0) {
+        Last = &List->Extents[List->Count - 1];
+
+        if ((UINT64)Last->ee_block + Ext4GetExtentLength (Last) > Extent->ee_block) {
+          return EFI_VOLUME_CORRUPTED;
+        }
+      }
+
+      List->Extents[List->Count++] = *Extent;
+    }
+
+    return EFI_SUCCESS;
+  }
+
+  Child = AllocatePool (Partition->BlockSize);
+
+  if (Child == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  // A node takes one block, see Ext4GetExtent()
+  MaxChildEntries = (UINT16)(Partition->BlockSize / sizeof (EXT4_EXTENT) - 1);
+  Index           = (CONST EXT4_EXTENT_INDEX *)(Header + 1);
+  Status          = EFI_SUCCESS;
+
+  for (Entry = 0; Entry < Header->eh_entries; Entry++, Index++) {
+    Block = LShiftU64 (Index->ei_leaf_hi, 32) | Index->ei_leaf_lo;
+
+    if ((Block < Partition->SuperBlock.s_first_data_block) || (Block >= Partition->NumberBlocks)) {
+      Status = EFI_VOLUME_CORRUPTED;
+      break;
+    }
+
+    Status = Ext4GrowArray ((VOID **)&List->Nodes, &List->MaxNodes, List->NumberNodes + 1, sizeof (EXT4_BLOCK_NR));
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    List->Nodes[List->NumberNodes++] = Block;
+
+    Status = Ext4ReadBlocksCached (Partition, Ext4BlockCacheMetadata, Child, 1, Block);
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    // The header must be valid before the checksum at its end can be checked
+    if (  !Ext4ExtentHeaderValid (Child, MaxChildEntries)
+       || !Ext4CheckExtentChecksum (Child, File))
+    {
+      DEBUG ((DEBUG_ERROR, "[ext4] Invalid extent tree node %lu\n", Block));
+      Status = EFI_VOLUME_CORRUPTED;
+      break;
+    }
+
+    Status = Ext4LoadExtentNode (Partition, File, Child, Depth - 1, MaxChildEntries, List);
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+  }
+
+  FreePool (Child);
+  return Status;
+}
+
+/**
+   Loads the extents of a file in a list.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      Inode         Pointer to the inode.
+   @param[out]     List          Pointer to the list.
+
+   @retval EFI_SUCCESS           The extents were loaded.
+   @retval EFI_UNSUPPORTED       The file's data is inline or in a block map.
+   @retval !EFI_SUCCESS          Failure.
+**/
+STATIC
+EFI_STATUS
+Ext4LoadExtents (
+  IN  EXT4_PARTITION    *Partition,
+  IN  EXT4_FILE         *File,
+  IN  CONST EXT4_INODE  *Inode,
+  OUT EXT4_EXTENT_LIST  *List
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Index;
+
+  ZeroMem (List, sizeof (*List));
+
+  if (EXT4_HAS_INLINE_DATA (Inode)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if ((Inode->i_flags & EXT4_EXTENTS_FL) == 0) {
+    // A block map without any block is as good as no extents, and gets
+    // converted to an extent tree when the file gets blocks
+    for (Index = 0; Index < EXT4_NR_BLOCKS; Index++) {
+      if (Inode->i_data[Index] != 0) {
+        return EFI_UNSUPPORTED;
+      }
+    }
+
+    return EFI_SUCCESS;
+  }
+
+  Status = Ext4LoadExtentNode (
+             Partition,
+             File,
+             (CONST EXT4_EXTENT_HEADER *)Inode->i_data,
+             ((CONST EXT4_EXTENT_HEADER *)Inode->i_data)->eh_depth,
+             EXT4_INODE_EXTENTS,
+             List
+             );
+
+  if (EFI_ERROR (Status)) {
+    Ext4FreeExtentList (List);
+  }
+
+  return Status;
+}
+
+/**
+   Finds the extent of a list that covers a logical block.
+
+   @param[in]      List          Pointer to the list.
+   @param[in]      LogicalBlock  Logical block.
+   @param[out]     Index         Index of the extent that covers the block, or
+                                 of the first extent after it if there's none.
+
+   @return TRUE if an extent covers the block, else FALSE.
+**/
+STATIC
+BOOLEAN
+Ext4FindListExtent (
+  IN  CONST EXT4_EXTENT_LIST  *List,
+  IN  UINT32                  LogicalBlock,
+  OUT UINTN                   *Index
+  )
+{
+  UINTN  Low;
+  UINTN  High;
+  UINTN  Middle;
+
+  // Look for the first extent that ends after the block
+  Low  = 0;
+  High = List->Count;
+
+  while (Low < High) {
+    Middle = Low + (High - Low) / 2;
+
+    if ((UINT64)List->Extents[Middle].ee_block + Ext4GetExtentLength (&List->Extents[Middle]) <= LogicalBlock) {
+      Low = Middle + 1;
+    } else {
+      High = Middle;
+    }
+  }
+
+  *Index = Low;
+  return Low < List->Count && List->Extents[Low].ee_block <= LogicalBlock;
+}
+
+/**
+   Inserts an extent in a list, which must have room for it.
+
+   @param[in out]  List          Pointer to the list.
+   @param[in]      Index         Index of the new extent.
+   @param[in]      Extent        Pointer to the extent.
+**/
+STATIC
+VOID
+Ext4InsertListExtent (
+  IN OUT EXT4_EXTENT_LIST   *List,
+  IN     UINTN              Index,
+  IN     CONST EXT4_EXTENT  *Extent
+  )
+{
+  ASSERT (List->Count < List->Capacity);
+
+  CopyMem (&List->Extents[Index + 1], &List->Extents[Index], (List->Count - Index) * sizeof (EXT4_EXTENT));
+  List->Extents[Index] = *Extent;
+  List->Count++;
+  List->Dirty = TRUE;
+}
+
+/**
+   Marks a run of blocks of an uninitialized extent as initialized, splitting
+   the extent in up to 3 extents. The list must have room for 2 more extents.
+
+   @param[in out]  List          Pointer to the list.
+   @param[in]      Index         Index of the extent.
+   @param[in]      LogicalBlock  First block of the run.
+   @param[in]      Count         Number of blocks of the run.
+**/
+STATIC
+VOID
+Ext4MarkListExtentInitialized (
+  IN OUT EXT4_EXTENT_LIST  *List,
+  IN     UINTN             Index,
+  IN     UINT32            LogicalBlock,
+  IN     UINT32            Count
+  )
+{
+  EXT4_EXTENT    Extent;
+  EXT4_EXTENT    Piece;
+  EXT4_BLOCK_NR  Start;
+  UINT32         Length;
+  UINT32         Before;
+  UINT32         After;
+
+  Extent = List->Extents[Index];
+  Start  = Ext4ExtentStart (&Extent);
+  Length = (UINT32)Ext4GetExtentLength (&Extent);
+  Before = LogicalBlock - Extent.ee_block;
+  After  = Length - Before - Count;
+
+  Piece.ee_block = LogicalBlock;
+  Piece.ee_len   = (UINT16)Count;
+  Ext4SetExtentStart (&Piece, Start + Before);
+  List->Extents[Index] = Piece;
+  List->Dirty          = TRUE;
+
+  if (Before != 0) {
+    Piece.ee_block = Extent.ee_block;
+    Piece.ee_len   = (UINT16)(EXT4_EXTENT_MAX_INITIALIZED + Before);
+    Ext4SetExtentStart (&Piece, Start);
+    Ext4InsertListExtent (List, Index, &Piece);
+    Index++;
+  }
+
+  if (After != 0) {
+    Piece.ee_block = LogicalBlock + Count;
+    Piece.ee_len   = (UINT16)(EXT4_EXTENT_MAX_INITIALIZED + After);
+    Ext4SetExtentStart (&Piece, Start + Before + Count);
+    Ext4InsertListExtent (List, Index + 1, &Piece);
+  }
+}
+
+/**
+   Merges the extents of a list that follow each other, both logically and
+   on the disk.
+
+   @param[in out]  List          Pointer to the list.
+**/
+STATIC
+VOID
+Ext4MergeListExtents (
+  IN OUT EXT4_EXTENT_LIST  *List
+  )
+{
+  EXT4_EXTENT  *Last;
+  EXT4_EXTENT  *Extent;
+  UINTN        Index;
+  UINTN        Count;
+  UINT64       LastLength;
+  UINT64       Length;
+  BOOLEAN      Uninit;
+
+  if (List->Count == 0) {
+    return;
+  }
+
+  Count = 1;
+
+  for (Index = 1; Index < List->Count; Index++) {
+    Last       = &List->Extents[Count - 1];
+    Extent     = &List->Extents[Index];
+    LastLength = Ext4GetExtentLength (Last);
+    Length     = Ext4GetExtentLength (Extent);
+    Uninit     = EXT4_EXTENT_IS_UNINITIALIZED (Last);
+
+    if (  (Uninit == EXT4_EXTENT_IS_UNINITIALIZED (Extent))
+       && ((UINT64)Last->ee_block + LastLength == Extent->ee_block)
+       && (Ext4ExtentStart (Last) + LastLength == Ext4ExtentStart (Extent))
+       && (LastLength + Length <= (Uninit ? EXT4_EXTENT_MAX_UNINITIALIZED : EXT4_EXTENT_MAX_INITIALIZED)))
+    {
+      Last->ee_len = (UINT16)(Last->ee_len + Length);
+      continue;
+    }
+
+    List->Extents[Count++] = *Extent;
+  }
+
+  List->Count = Count;
+}
+
+/**
+   Stores a list of extents as the extent tree of a file, allocating or
+   freeing the tree's nodes as needed.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      File          Pointer to the opened file.
+   @param[in out]  Inode         Pointer to the working copy of the inode.
+   @param[in out]  List          Pointer to the list.
+
+   @retval EFI_SUCCESS           The extents were stored.
+   @retval EFI_UNSUPPORTED       The file has too many extents.
+   @retval !EFI_SUCCESS          Failure.
+**/
+STATIC
+EFI_STATUS
+Ext4StoreExtents (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_FILE         *File,
+  IN OUT EXT4_INODE        *Inode,
+  IN OUT EXT4_EXTENT_LIST  *List
+  )
+{
+  EXT4_PARTITION      *Partition;
+  EXT4_EXTENT_HEADER  *Root;
+  EXT4_EXTENT_HEADER  *Header;
+  EXT4_EXTENT_INDEX   *Index;
+  EXT4_EXTENT_TAIL    *Tail;
+  EXT4_BLOCK_NR       Block;
+  EFI_STATUS          Status;
+  UINT32              Allocated;
+  UINTN               PerNode;
+  UINTN               PerLeaf;
+  UINTN               NumberLeaves;
+  UINTN               Leaf;
+  UINTN               First;
+  UINTN               Count;
+
+  Partition = Txn->Partition;
+
+  Ext4MergeListExtents (List);
+
+  if (((Inode->i_flags & EXT4_EXTENTS_FL) == 0) && (List->Count == 0)) {
+    return EFI_SUCCESS;
+  }
+
+  if (!EXT4_HAS_INCOMPAT (Partition, EXT4_FEATURE_INCOMPAT_EXTENTS)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  PerNode      = (Partition->BlockSize - sizeof (EXT4_EXTENT_HEADER)) / sizeof (EXT4_EXTENT);
+  NumberLeaves = 0;
+
+  if (List->Count > EXT4_INODE_EXTENTS) {
+    NumberLeaves = (List->Count + PerNode - 1) / PerNode;
+  }
+
+  if (NumberLeaves > EXT4_INODE_EXTENTS) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Too many extents (%lu) to write inode %u\n", List->Count, File->InodeNum));
+    return EFI_UNSUPPORTED;
+  }
+
+  Status = Ext4GrowArray ((VOID **)&List->Nodes, &List->MaxNodes, NumberLeaves, sizeof (EXT4_BLOCK_NR));
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  while (List->NumberNodes < NumberLeaves) {
+    Status = Ext4AllocateBlocks (Txn, Ext4InodeGoalBlock (Partition, File->InodeNum), 1, &Block, &Allocated);
+
+    if (!EFI_ERROR (Status)) {
+      List->Nodes[List->NumberNodes++] = Block;
+      Status                           = Ext4AddInodeBlocks (Partition, Inode, 1);
+    }
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  while (List->NumberNodes > NumberLeaves) {
+    Status = Ext4FreeBlocks (Txn, List->Nodes[List->NumberNodes - 1], 1);
+
+    if (!EFI_ERROR (Status)) {
+      List->NumberNodes--;
+      Status = Ext4AddInodeBlocks (Partition, Inode, -1);
+    }
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  ZeroMem (Inode->i_data, sizeof (Inode->i_data));
+  Root           = (EXT4_EXTENT_HEADER *)Inode->i_data;
+  Root->eh_magic = EXT4_EXTENT_HEADER_MAGIC;
+  Root->eh_max   = EXT4_INODE_EXTENTS;
+
+  if (NumberLeaves == 0) {
+    Root->eh_entries = (UINT16)List->Count;
+    Root->eh_depth   = 0;
+    CopyMem (Root + 1, List->Extents, List->Count * sizeof (EXT4_EXTENT));
+  } else {
+    Root->eh_entries = (UINT16)NumberLeaves;
+    Root->eh_depth   = 1;
+
+    // Extents are spread evenly, which leaves every leaf some room to grow
+    PerLeaf = (List->Count + NumberLeaves - 1) / NumberLeaves;
+    Index   = (EXT4_EXTENT_INDEX *)(Root + 1);
+
+    for (Leaf = 0; Leaf < NumberLeaves; Leaf++, Index++) {
+      First = Leaf * PerLeaf;
+      Count = MIN (PerLeaf, List->Count - First);
+
+      Status = Ext4TxnGetBlock (Txn, List->Nodes[Leaf], TRUE, (UINT8 **)&Header);
+
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+
+      Header->eh_magic   = EXT4_EXTENT_HEADER_MAGIC;
+      Header->eh_entries = (UINT16)Count;
+      Header->eh_max     = (UINT16)PerNode;
+      Header->eh_depth   = 0;
+      CopyMem (Header + 1, &List->Extents[First], Count * sizeof (EXT4_EXTENT));
+
+      if (EXT4_HAS_METADATA_CSUM (Partition)) {
+        Tail              = (EXT4_EXTENT_TAIL *)((CHAR8 *)Header + EXT4_EXTENT_TAIL_OFFSET (Header));
+        Tail->eb_checksum = Ext4CalculateExtentChecksum (Header, File);
+      }
+
+      Index->ei_block   = List->Extents[First].ee_block;
+      Index->ei_leaf_lo = (UINT32)List->Nodes[Leaf];
+      Index->ei_leaf_hi = (UINT16)RShiftU64 (List->Nodes[Leaf], 32);
+    }
+  }
+
+  Inode->i_flags |= EXT4_EXTENTS_FL;
+  List->Dirty     = FALSE;
+  return EFI_SUCCESS;
+}
+
+/**
+   Retrieves the largest size a file can have.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+
+   @return The size, in bytes.
+**/
+STATIC
+UINT64
+Ext4MaxFileSize (
+  IN EXT4_PARTITION  *Partition
+  )
+{
+  if (!EXT4_HAS_RO_COMPAT (Partition, EXT4_FEATURE_RO_COMPAT_LARGE_FILE)) {
+    return MAX_INT32;
+  }
+
+  // Logical block numbers are 32-bit
+  return MultU64x32 (MAX_UINT32, Partition->BlockSize);
+}
+
+/**
+   Zeroes the end of the block of a file that holds its last byte, so that
+   the bytes past the end of the file read as zeroes once the file grows.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      List          Pointer to the file's extents.
+   @param[in]      Size          Size of the file.
+   @param[in]      Limit         Offset in the file up to which to zero.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4ZeroBlockTail (
+  IN EXT4_PARTITION          *Partition,
+  IN CONST EXT4_EXTENT_LIST  *List,
+  IN UINT64                  Size,
+  IN UINT64                  Limit
+  )
+{
+  CONST EXT4_EXTENT  *Extent;
+  VOID               *Zero;
+  EFI_STATUS         Status;
+  UINT32             LogicalBlock;
+  UINT32             InBlock;
+  UINTN              Index;
+  UINTN              Length;
+
+  InBlock = (UINT32)(Size % Partition->BlockSize);
+
+  if ((InBlock == 0) || (Limit <= Size)) {
+    return EFI_SUCCESS;
+  }
+
+  LogicalBlock = (UINT32)DivU64x32 (Size, Partition->BlockSize);
+
+  if (!Ext4FindListExtent (List, LogicalBlock, &Index)) {
+    return EFI_SUCCESS;
+  }
+
+  Extent = &List->Extents[Index];
+
+  if (EXT4_EXTENT_IS_UNINITIALIZED (Extent)) {
+    return EFI_SUCCESS;
+  }
+
+  Length = (UINTN)MIN (Partition->BlockSize - InBlock, Limit - Size);
+  Zero   = AllocateZeroPool (Length);
+
+  if (Zero == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = Ext4WriteDiskIoCached (
+             Partition,
+             Zero,
+             Length,
+             MultU64x32 (Ext4ExtentStart (Extent) + LogicalBlock - Extent->ee_block, Partition->BlockSize) + InBlock
+             );
+
+  FreePool (Zero);
+  return Status;
+}
+
+/**
+   Writes data to blocks that held no file data, zeroing the parts of the
+   blocks that the data doesn't cover.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      Block         First block.
+   @param[in]      NumberBlocks  Number of blocks.
+   @param[in]      InBlock       Offset of the data in the first block.
+   @param[in]      Buffer        Pointer to the data.
+   @param[in]      Length        Length of the data.
+   @param[in]      Zero          Pointer to a zeroed buffer of a block.
+
+   @return Result of the operation.
+**/
+STATIC
+EFI_STATUS
+Ext4WriteNewBlocks (
+  IN EXT4_PARTITION  *Partition,
+  IN EXT4_BLOCK_NR   Block,
+  IN UINT32          NumberBlocks,
+  IN UINT32          InBlock,
+  IN CONST UINT8     *Buffer,
+  IN UINTN           Length,
+  IN CONST VOID      *Zero
+  )
+{
+  EFI_STATUS  Status;
+  UINT64      DiskOffset;
+  UINTN       Padding;
+
+  DiskOffset = MultU64x32 (Block, Partition->BlockSize);
+  Padding    = (UINTN)(MultU64x32 (NumberBlocks, Partition->BlockSize) - InBlock - Length);
+
+  if (InBlock != 0) {
+    Status = Ext4WriteDiskIoCached (Partition, Zero, InBlock, DiskOffset);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  Status = Ext4WriteDiskIoCached (Partition, Buffer, Length, DiskOffset + InBlock);
+
+  if (EFI_ERROR (Status) || (Padding == 0)) {
+    return Status;
+  }
+
+  return Ext4WriteDiskIoCached (Partition, Zero, Padding, DiskOffset + InBlock + Length);
+}
+
+/**
+   Writes a chunk of a write to a file, in a single transaction.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      Buffer        Pointer to the buffer.
+   @param[in]      Offset        Offset of the write.
+   @param[in]      Length        Length of the buffer.
+   @param[out]     Written       Number of bytes that were written.
+
+   @retval EFI_SUCCESS           The chunk was written. It may be shorter than
+                                 Length if the transaction is full.
+   @retval EFI_VOLUME_FULL       The volume is full; Written bytes were written.
+   @retval !EFI_SUCCESS          Failure.
+**/
+STATIC
+EFI_STATUS
+Ext4WriteChunk (
+  IN  EXT4_PARTITION  *Partition,
+  IN  EXT4_FILE       *File,
+  IN  CONST UINT8     *Buffer,
+  IN  UINT64          Offset,
+  IN  UINTN           Length,
+  OUT UINTN           *Written
+  )
+{
+  EXT4_TRANSACTION  Txn;
+  EXT4_INODE        *Inode;
+  EXT4_EXTENT_LIST  List;
+  EXT4_EXTENT       *Extent;
+  EXT4_EXTENT       NewExtent;
+  VOID              *Zero;
+  EFI_STATUS        Status;
+  EFI_STATUS        WriteStatus;
+  EXT4_BLOCK_NR     Goal;
+  EXT4_BLOCK_NR     Block;
+  UINT64            OldSize;
+  UINT64            Position;
+  UINT64            Wanted;
+  UINT64            ExtentEnd;
+  UINT64            HoleEnd;
+  UINTN             Done;
+  UINTN             Run;
+  UINTN             Index;
+  UINT32            LogicalBlock;
+  UINT32            InBlock;
+  UINT32            Count;
+  BOOLEAN           Covered;
+
+  *Written = 0;
+  Done     = 0;
+  Inode    = NULL;
+  Zero     = NULL;
+  ZeroMem (&List, sizeof (List));
+
+  Status = Ext4BeginTransaction (Partition, &Txn);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Inode = AllocateCopyPool (Partition->InodeSize, File->Inode);
+  Zero  = AllocateZeroPool (Partition->BlockSize);
+
+  if ((Inode == NULL) || (Zero == NULL)) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Out;
+  }
+
+  Status = Ext4LoadExtents (Partition, File, Inode, &List);
+
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  OldSize = EXT4_INODE_SIZE (Inode);
+
+  Status = Ext4ZeroBlockTail (Partition, &List, OldSize, Offset);
+
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  WriteStatus = EFI_SUCCESS;
+
+  while (Done < Length) {
+    // Keep room for the extent tree and the inode
+    if (!Ext4TxnHasRoom (&Txn, EXT4_TXN_RESERVED_BLOCKS + 2)) {
+      break;
+    }
+
+    // Splitting an extent makes up to 2 more
+    WriteStatus = Ext4GrowArray ((VOID **)&List.Extents, &List.Capacity, List.Count + 2, sizeof (EXT4_EXTENT));
+
+    if (EFI_ERROR (WriteStatus)) {
+      break;
+    }
+
+    Position     = Offset + Done;
+    LogicalBlock = (UINT32)DivU64x32 (Position, Partition->BlockSize);
+    InBlock      = (UINT32)(Position % Partition->BlockSize);
+    Wanted       = DivU64x32 (InBlock + (UINT64)(Length - Done) + Partition->BlockSize - 1, Partition->BlockSize);
+    Covered      = Ext4FindListExtent (&List, LogicalBlock, &Index);
+    Extent       = &List.Extents[Index];
+
+    if (Covered) {
+      ExtentEnd = (UINT64)Extent->ee_block + Ext4GetExtentLength (Extent);
+      Count     = (UINT32)MIN (Wanted, ExtentEnd - LogicalBlock);
+      Block     = Ext4ExtentStart (Extent) + LogicalBlock - Extent->ee_block;
+      Run       = (UINTN)MIN (MultU64x32 (Count, Partition->BlockSize) - InBlock, Length - Done);
+
+      if (!EXT4_EXTENT_IS_UNINITIALIZED (Extent)) {
+        WriteStatus = Ext4WriteDiskIoCached (
+                        Partition,
+                        Buffer + Done,
+                        Run,
+                        MultU64x32 (Block, Partition->BlockSize) + InBlock
+                        );
+      } else {
+        // The blocks are allocated, but their contents aren't part of the file yet
+        WriteStatus = Ext4WriteNewBlocks (Partition, Block, Count, InBlock, Buffer + Done, Run, Zero);
+
+        if (!EFI_ERROR (WriteStatus)) {
+          Ext4MarkListExtentInitialized (&List, Index, LogicalBlock, Count);
+        }
+      }
+
+      if (EFI_ERROR (WriteStatus)) {
+        break;
+      }
+
+      Done += Run;
+      continue;
+    }
+
+    // Fill the hole with a run of new blocks, preferably right after the
+    // blocks of the previous extent
+    HoleEnd = Index < List.Count ? Extent->ee_block : BIT32;
+    Count   = (UINT32)MIN (MIN (Wanted, HoleEnd - LogicalBlock), EXT4_EXTENT_MAX_INITIALIZED);
+
+    if (Index != 0) {
+      Goal = Ext4ExtentStart (&List.Extents[Index - 1]) + LogicalBlock - List.Extents[Index - 1].ee_block;
+    } else {
+      Goal = Ext4InodeGoalBlock (Partition, File->InodeNum);
+    }
+
+    WriteStatus = Ext4AllocateBlocks (&Txn, Goal, Count, &Block, &Count);
+
+    if (EFI_ERROR (WriteStatus)) {
+      break;
+    }
+
+    Run         = (UINTN)MIN (MultU64x32 (Count, Partition->BlockSize) - InBlock, Length - Done);
+    WriteStatus = Ext4WriteNewBlocks (Partition, Block, Count, InBlock, Buffer + Done, Run, Zero);
+
+    if (!EFI_ERROR (WriteStatus)) {
+      WriteStatus = Ext4AddInodeBlocks (Partition, Inode, Count);
+    }
+
+    if (EFI_ERROR (WriteStatus)) {
+      Status = Ext4FreeBlocks (&Txn, Block, Count);
+
+      if (EFI_ERROR (Status)) {
+        goto Out;
+      }
+
+      break;
+    }
+
+    NewExtent.ee_block = LogicalBlock;
+    NewExtent.ee_len   = (UINT16)Count;
+    Ext4SetExtentStart (&NewExtent, Block);
+    Ext4InsertListExtent (&List, Index, &NewExtent);
+
+    Done += Run;
+  }
+
+  // Whatever was written is committed, even if the write stopped short
+  if (Done == 0) {
+    Status = EFI_ERROR (WriteStatus) ? WriteStatus : EFI_OUT_OF_RESOURCES;
+    goto Out;
+  }
+
+  if (Offset + Done > OldSize) {
+    Inode->i_size_lo = (UINT32)(Offset + Done);
+    Inode->i_size_hi = (UINT32)RShiftU64 (Offset + Done, 32);
+  }
+
+  Ext4SetInodeTimes (Inode, EXT4_INODE_MTIME | EXT4_INODE_CTIME, NULL);
+
+  if (List.Dirty) {
+    Status = Ext4StoreExtents (&Txn, File, Inode, &List);
+
+    if (EFI_ERROR (Status)) {
+      goto Out;
+    }
+  }
+
+  Status = Ext4TxnWriteInode (&Txn, File->InodeNum, Inode);
+
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  Status = Ext4CommitTransaction (&Txn);
+
+  if (EFI_ERROR (Status)) {
+    goto Out;
+  }
+
+  Ext4RefreshOpenFiles (Partition, File->InodeNum, Inode);
+
+  *Written = Done;
+  Status   = WriteStatus;
+
+Out:
+  if (EFI_ERROR (Status) && (*Written == 0)) {
+    Ext4AbortTransaction (&Txn);
+  }
+
+  Ext4FreeExtentList (&List);
+
+  if (Inode != NULL) {
+    FreePool (Inode);
+  }
+
+  if (Zero != NULL) {
+    FreePool (Zero);
+  }
+
+  return Status;
+}
+
+/**
+   Writes to a file, allocating the blocks it needs.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      Buffer        Pointer to the buffer.
+   @param[in]      Offset        Offset of the write.
+   @param[in out]  Length        Pointer to the length of the buffer, in bytes.
+                                 It's updated to the number of written bytes,
+                                 which may be short of it if the volume is full.
+
+   @return Status of the write operation.
+**/
+EFI_STATUS
+Ext4Write (
+  IN     EXT4_PARTITION  *Partition,
+  IN     EXT4_FILE       *File,
+  IN     CONST VOID      *Buffer,
+  IN     UINT64          Offset,
+  IN OUT UINTN           *Length
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Done;
+  UINTN       Chunk;
+
+  DEBUG ((DEBUG_FS, "[ext4] Ext4Write(%s, Offset %lu, Length %lu)\n", File->Dentry->Name, Offset, *Length));
+
+  if ((Offset > Ext4MaxFileSize (Partition)) || (*Length > Ext4MaxFileSize (Partition) - Offset)) {
+    DEBUG ((DEBUG_ERROR, "[ext4] Write past the largest file size\n"));
+    *Length = 0;
+    return EFI_UNSUPPORTED;
+  }
+
+  Done   = 0;
+  Status = EFI_SUCCESS;
+
+  while (Done < *Length) {
+    Status = Ext4WriteChunk (
+               Partition,
+               File,
+               (CONST UINT8 *)Buffer + Done,
+               Offset + Done,
+               *Length - Done,
+               &Chunk
+               );
+
+    Done += Chunk;
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+  }
+
+  *Length = Done;
+  return Status;
+}
+
+/**
+   Frees the blocks of a file past a logical block, from the end of the file.
+   At most one run of blocks, in a single block group, is freed per call, so
+   that a transaction can tell whether it has room for more.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in out]  Inode         Pointer to the working copy of the inode.
+   @param[in out]  List          Pointer to the file's extents.
+   @param[in]      FirstBlock    First logical block to free.
+
+   @retval EFI_SUCCESS           Blocks were freed.
+   @retval EFI_NOT_FOUND         The file has no block past FirstBlock.
+   @retval !EFI_SUCCESS          Failure.
+**/
+STATIC
+EFI_STATUS
+Ext4FreeLastBlocks (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN OUT EXT4_INODE        *Inode,
+  IN OUT EXT4_EXTENT_LIST  *List,
+  IN     UINT32            FirstBlock
+  )
+{
+  EXT4_PARTITION  *Partition;
+  EXT4_EXTENT     *Extent;
+  EXT4_BLOCK_NR   Start;
+  EXT4_BLOCK_NR   Last;
+  EXT4_BLOCK_NR   GroupStart;
+  EFI_STATUS      Status;
+  UINT64          Length;
+  UINT64          Cut;
+
+  Partition = Txn->Partition;
+
+  if (List->Count == 0) {
+    return EFI_NOT_FOUND;
+  }
+
+  Extent = &List->Extents[List->Count - 1];
+  Length = Ext4GetExtentLength (Extent);
+
+  if ((UINT64)Extent->ee_block + Length <= FirstBlock) {
+    return EFI_NOT_FOUND;
+  }
+
+  // Free from the cut, or from the start of the block group of the last block
+  Start      = Ext4ExtentStart (Extent);
+  Last       = Start + Length - 1;
+  GroupStart = Partition->SuperBlock.s_first_data_block +
+               MultU64x32 (
+                 (UINT32)DivU64x32 (Last - Partition->SuperBlock.s_first_data_block, Partition->SuperBlock.s_blocks_per_group),
+                 Partition->SuperBlock.s_blocks_per_group
+                 );
+  Cut = MAX (FirstBlock, Extent->ee_block) - Extent->ee_block;
+  Cut = MAX (Cut, (GroupStart > Start) ? GroupStart - Start : 0);
+
+  Status = Ext4FreeBlocks (Txn, Start + Cut, Length - Cut);
+
+  if (!EFI_ERROR (Status)) {
+    Status = Ext4AddInodeBlocks (Partition, Inode, -(INT64)(Length - Cut));
+  }
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (Cut == 0) {
+    List->Count--;
+  } else {
+    Extent->ee_len = (UINT16)(Extent->ee_len - (Length - Cut));
+  }
+
+  List->Dirty = TRUE;
+  return EFI_SUCCESS;
+}
+
+/**
+   Changes the size of a file. Files grow sparsely, and the blocks past the end
+   of shrunk files are freed.
+
+   @param[in]      File          Pointer to the opened file.
+   @param[in]      NewSize       New size of the file, in bytes.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4SetFileSize (
+  IN EXT4_FILE  *File,
+  IN UINT64     NewSize
+  )
+{
+  EXT4_PARTITION    *Partition;
+  EXT4_TRANSACTION  Txn;
+  EXT4_INODE        *Inode;
+  EXT4_EXTENT_LIST  List;
+  EXT4_EXTENT       *Last;
+  EFI_STATUS        Status;
+  UINT64            OldSize;
+  UINT64            Size;
+  UINT32            FirstBlock;
+  BOOLEAN           Done;
+
+  Partition = File->Partition;
+
+  if (NewSize > Ext4MaxFileSize (Partition)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  FirstBlock = (UINT32)DivU64x32 (NewSize + Partition->BlockSize - 1, Partition->BlockSize);
+
+  // Shrinking a large file takes several transactions, each of which leaves
+  // the file consistent
+  do {
+    Status = Ext4BeginTransaction (Partition, &Txn);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Inode = AllocateCopyPool (Partition->InodeSize, File->Inode);
+
+    if (Inode == NULL) {
+      Ext4AbortTransaction (&Txn);
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    Status = Ext4LoadExtents (Partition, File, Inode, &List);
+
+    if (EFI_ERROR (Status)) {
+      goto Error;
+    }
+
+    OldSize = EXT4_INODE_SIZE (Inode);
+    Done    = TRUE;
+    Size    = NewSize;
+
+    if (NewSize >= OldSize) {
+      Status = Ext4ZeroBlockTail (Partition, &List, OldSize, NewSize);
+    } else {
+      while (Ext4TxnHasRoom (&Txn, EXT4_TXN_RESERVED_BLOCKS + 2)) {
+        Status = Ext4FreeLastBlocks (&Txn, Inode, &List, FirstBlock);
+
+        if (EFI_ERROR (Status)) {
+          break;
+        }
+      }
+
+      if (!EFI_ERROR (Status) && (List.Count != 0)) {
+        // The transaction is full, and the size must cover the blocks that are left
+        Last = &List.Extents[List.Count - 1];
+        Size = MultU64x32 (Last->ee_block + Ext4GetExtentLength (Last), Partition->BlockSize);
+
+        if (Size > NewSize) {
+          Done = FALSE;
+          Size = MIN (Size, OldSize);
+        } else {
+          Size = NewSize;
+        }
+      }
+
+      if (Done && ((Status == EFI_NOT_FOUND) || !EFI_ERROR (Status))) {
+        Status = Ext4ZeroBlockTail (Partition, &List, NewSize, OldSize);
+      }
+    }
+
+    if (EFI_ERROR (Status)) {
+      goto Error;
+    }
+
+    Inode->i_size_lo = (UINT32)Size;
+    Inode->i_size_hi = (UINT32)RShiftU64 (Size, 32);
+    Ext4SetInodeTimes (Inode, EXT4_INODE_MTIME | EXT4_INODE_CTIME, NULL);
+
+    if (List.Dirty) {
+      Status = Ext4StoreExtents (&Txn, File, Inode, &List);
+
+      if (EFI_ERROR (Status)) {
+        goto Error;
+      }
+    }
+
+    Status = Ext4TxnWriteInode (&Txn, File->InodeNum, Inode);
+
+    if (EFI_ERROR (Status)) {
+      goto Error;
+    }
+
+    Status = Ext4CommitTransaction (&Txn);
+
+    if (!EFI_ERROR (Status)) {
+      Ext4RefreshOpenFiles (Partition, File->InodeNum, Inode);
+    }
+
+    Ext4FreeExtentList (&List);
+    FreePool (Inode);
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  } while (!Done);
+
+  return EFI_SUCCESS;
+
+Error:
+  Ext4AbortTransaction (&Txn);
+  Ext4FreeExtentList (&List);
+  FreePool (Inode);
+  return Status;
+}
+
+/**
+   Frees every block of a file, including its extent tree, in one transaction.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      File          Pointer to the opened file.
+   @param[in out]  Inode         Pointer to the transaction's working copy of the inode.
+
+   @retval EFI_SUCCESS           The blocks were freed.
+   @retval EFI_OUT_OF_RESOURCES  The file has too many extents for the transaction.
+   @retval !EFI_SUCCESS          Failure.
+**/
+EFI_STATUS
+Ext4TxnFreeFileBlocks (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_FILE         *File,
+  IN OUT EXT4_INODE        *Inode
+  )
+{
+  EXT4_PARTITION      *Partition;
+  EXT4_EXTENT_LIST    List;
+  EXT4_EXTENT_HEADER  *Root;
+  EFI_STATUS          Status;
+  UINTN               Index;
+  UINT64              Length;
+
+  Partition = Txn->Partition;
+
+  // Inline data goes away with the inode
+  if (EXT4_HAS_INLINE_DATA (Inode)) {
+    return EFI_SUCCESS;
+  }
+
+  Status = Ext4LoadExtents (Partition, File, Inode, &List);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  for (Index = 0; Index < List.Count && !EFI_ERROR (Status); Index++) {
+    Length = Ext4GetExtentLength (&List.Extents[Index]);
+    Status = Ext4FreeBlocks (Txn, Ext4ExtentStart (&List.Extents[Index]), Length);
+
+    if (!EFI_ERROR (Status)) {
+      Status = Ext4AddInodeBlocks (Partition, Inode, -(INT64)Length);
+    }
+  }
+
+  for (Index = 0; Index < List.NumberNodes && !EFI_ERROR (Status); Index++) {
+    Status = Ext4FreeBlocks (Txn, List.Nodes[Index], 1);
+
+    if (!EFI_ERROR (Status)) {
+      Status = Ext4AddInodeBlocks (Partition, Inode, -1);
+    }
+  }
+
+  Ext4FreeExtentList (&List);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if ((Inode->i_flags & EXT4_EXTENTS_FL) != 0) {
+    ZeroMem (Inode->i_data, sizeof (Inode->i_data));
+    Root           = (EXT4_EXTENT_HEADER *)Inode->i_data;
+    Root->eh_magic = EXT4_EXTENT_HEADER_MAGIC;
+    Root->eh_max   = EXT4_INODE_EXTENTS;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Adds blocks to, or removes blocks from, the block count of an inode.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in out]  Inode         Pointer to the inode.
+   @param[in]      Delta         Number of filesystem blocks to add.
+
+   @retval EFI_SUCCESS           The count was updated.
+   @retval EFI_UNSUPPORTED       The count doesn't fit in the inode.
+**/
+EFI_STATUS
+Ext4AddInodeBlocks (
+  IN     EXT4_PARTITION  *Partition,
+  IN OUT EXT4_INODE      *Inode,
+  IN     INT64           Delta
+  )
+{
+  BOOLEAN  HugeFile;
+  UINT64   Blocks;
+  UINT64   Units;
+  UINT64   Max;
+
+  HugeFile = EXT4_HAS_RO_COMPAT (Partition, EXT4_FEATURE_RO_COMPAT_HUGE_FILE);
+  Blocks   = Inode->i_blocks;
+  Max      = MAX_UINT32;
+
+  if (HugeFile) {
+    Blocks |= LShiftU64 (Inode->i_osd2.data_linux.l_i_blocks_high, 32);
+    Max     = LShiftU64 (1, 48) - 1;
+  }
+
+  // See Ext4FilePhysicalSpace() for the units of i_blocks
+  if (HugeFile && ((Inode->i_flags & EXT4_HUGE_FILE_FL) != 0)) {
+    Units = (UINT64)(Delta < 0 ? -Delta : Delta);
+  } else {
+    Units = MultU64x32 ((UINT64)(Delta < 0 ? -Delta : Delta), Partition->BlockSize / 512);
+  }
+
+  if (Delta < 0) {
+    if (Units > Blocks) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    Blocks -= Units;
+  } else {
+    if (Units > Max - Blocks) {
+      return EFI_UNSUPPORTED;
+    }
+
+    Blocks += Units;
+  }
+
+  Inode->i_blocks = (UINT32)Blocks;
+
+  if (HugeFile) {
+    Inode->i_osd2.data_linux.l_i_blocks_high = (UINT16)RShiftU64 (Blocks, 32);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+   Gets the transaction's copy of an inode, in its inode table block.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      InodeNum      Inode number.
+   @param[out]     Inode         Pointer to the copy of the inode.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4TxnGetInode (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_INO_NR       InodeNum,
+  OUT    EXT4_INODE        **Inode
+  )
+{
+  EXT4_PARTITION  *Partition;
+  EFI_STATUS      Status;
+  UINT64          DiskOffset;
+  UINT32          BlockGroup;
+  UINT8           *Data;
+
+  Partition = Txn->Partition;
+
+  Status = Ext4GetInodeOffset (Partition, InodeNum, &DiskOffset, &BlockGroup);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = Ext4TxnGetBlock (Txn, DivU64x32 (DiskOffset, Partition->BlockSize), FALSE, &Data);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *Inode = (EXT4_INODE *)(Data + (UINTN)(DiskOffset % Partition->BlockSize));
+  return EFI_SUCCESS;
+}
+
+/**
+   Records an inode written by a transaction, so that it's dropped from the
+   inode cache when the transaction is checkpointed.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      InodeNum      Inode number.
+
+   @retval EFI_SUCCESS           The inode was recorded.
+   @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
+**/
+STATIC
+EFI_STATUS
+Ext4TxnRecordInode (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_INO_NR       InodeNum
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Index;
+
+  for (Index = 0; Index < Txn->NumberInodes; Index++) {
+    if (Txn->Inodes[Index] == InodeNum) {
+      return EFI_SUCCESS;
+    }
+  }
+
+  Status = Ext4GrowArray ((VOID **)&Txn->Inodes, &Txn->MaxInodes, Txn->NumberInodes + 1, sizeof (EXT4_INO_NR));
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Txn->Inodes[Txn->NumberInodes] = InodeNum;
+  Txn->NumberInodes++;
+  return EFI_SUCCESS;
+}
+
+/**
+   Stores an inode in a transaction, updating its checksum.
+
+   @param[in out]  Txn           Pointer to the transaction.
+   @param[in]      InodeNum      Inode number.
+   @param[in out]  Inode         Pointer to the inode, Partition->InodeSize bytes long.
+
+   @return Result of the operation.
+**/
+EFI_STATUS
+Ext4TxnWriteInode (
+  IN OUT EXT4_TRANSACTION  *Txn,
+  IN     EXT4_INO_NR       InodeNum,
+  IN OUT EXT4_INODE        *Inode
+  )
+{
+  EXT4_PARTITION  *Partition;
+  EXT4_INODE      *Copy;
+  EFI_STATUS      Status;
+  UINT32          Csum;
+
+  Partition = Txn->Partition;
+
+  if (EXT4_HAS_METADATA_CSUM (Partition)) {
+    Csum                                     = Ext4CalculateInodeChecksum (Partition, Inode, InodeNum);
+    Inode->i_osd2.data_linux.l_i_checksum_lo = (UINT16)Csum;
+
+    if (EXT4_INODE_HAS_FIELD (Inode, i_checksum_hi)) {
+      Inode->i_checksum_hi = (UINT16)(Csum >> 16);
+    }
+  }
+
+  Status = Ext4TxnRecordInode (Txn, InodeNum);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = Ext4TxnGetInode (Txn, InodeNum, &Copy);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  // The cached copy stays valid until the transaction is checkpointed
+  CopyMem (Copy, Inode, Partition->InodeSize);
+  return EFI_SUCCESS;
+}
+
+/**
+   Updates the open files of an inode after the inode was modified.
+
+   @param[in]      Partition     Pointer to the opened EXT4 partition.
+   @param[in]      InodeNum      Inode number.
+   @param[in]      Inode         Pointer to the new inode.
+**/
+VOID
+Ext4RefreshOpenFiles (
+  IN EXT4_PARTITION    *Partition,
+  IN EXT4_INO_NR       InodeNum,
+  IN CONST EXT4_INODE  *Inode
+  )
+{
+  LIST_ENTRY  *Entry;
+  EXT4_FILE   *File;
+
+  BASE_LIST_FOR_EACH (Entry, &Partition->OpenFiles) {
+    File = EXT4_FILE_FROM_OPEN_FILES_NODE (Entry);
+
+    if (File->InodeNum == InodeNum) {
+      CopyMem (File->Inode, Inode, Partition->InodeSize);
+      Ext4ResetExtentsMap (File);
+    }
+
+    // Directory listings in progress may have been changed
+    Ext4FreeReadDirBlock (File);
+  }
+}
@@ -0,0 +1,50 @@
+/** @file
+  CRC32C (Castagnoli) checksum library
+
+  Copyright (c) 2024 Pedro Falcato All rights reserved.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef CRC32C_LIB_H_
+#define CRC32C_LIB_H_
+
+/**
+   Updates a CRC32C with a buffer, without inverting the CRC before or after.
+
+   This is the raw form of the checksum, in which the caller controls the
+   initial value and the final inversion. ext4, for instance, seeds metadata
+   checksums with the checksum of the filesystem UUID and never inverts them.
+
+   @param[in]      Crc         CRC32C of the data that precedes Buffer.
+   @param[in]      Buffer      Pointer to the buffer.
+   @param[in]      Length      Length of the buffer, in bytes.
+
+   @return The CRC32C of the data that precedes Buffer, followed by Buffer.
+**/
+UINT32
+EFIAPI
+Crc32cUpdate (
+  IN UINT32      Crc,
+  IN CONST VOID  *Buffer,
+  IN UINTN       Length
+  );
+
+/**
+   Calculates the CRC32C of a buffer. The CRC is inverted before and after
+   the update, like CalculateCrc32c() of BaseLib.
+
+   @param[in]      Buffer        Pointer to the buffer.
+   @param[in]      Length        Length of the buffer, in bytes.
+   @param[in]      InitialValue  Initial value of the CRC.
+
+   @return The CRC32C of the buffer.
+**/
+UINT32
+EFIAPI
+Crc32cCalculate (
+  IN CONST VOID  *Buffer,
+  IN UINTN       Length,
+  IN UINT32      InitialValue
+  );
+
+#endif
@@ -0,0 +1,57 @@
+/** @file
+  Internal definitions of BaseCrc32cLib
+
+  Copyright (c) 2024 Pedro Falcato All rights reserved.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef BASE_CRC32C_LIB_INTERNALS_H_
+#define BASE_CRC32C_LIB_INTERNALS_H_
+
+#include <Base.h>
+
+#include <Library/BaseLib.h>
+#include <Library/Crc32cLib.h>
+#include <Library/DebugLib.h>
+
+//
+// Buffers shorter than this are checksummed in software even when the CPU
+// has CRC32C instructions, as they aren't worth the call.
+//
+#define CRC32C_HW_MIN_LENGTH  16
+
+extern CONST UINT32  mCrc32cTables[8][256];
+
+/**
+   Checks if the CPU can compute CRC32C in hardware, through
+   InternalCrc32cHw().
+
+   @return TRUE if InternalCrc32cHw() may be used, else FALSE.
+**/
+BOOLEAN
+EFIAPI
+InternalCrc32cHwSupported (
+  VOID
+  );
+
+/**
+   Updates a CRC32C with a buffer, using the CPU's CRC32C instructions
+   (SSE4.2 on X64, the CRC32 extension on AArch64).
+
+   May only be called if InternalCrc32cHwSupported() returned TRUE.
+
+   @param[in]      Crc         CRC32C of the data that precedes Buffer.
+   @param[in]      Buffer      Pointer to the buffer.
+   @param[in]      Length      Length of the buffer, in bytes.
+
+   @return The updated CRC32C, not inverted.
+**/
+UINT32
+EFIAPI
+InternalCrc32cHw (
+  IN UINT32      Crc,
+  IN CONST VOID  *Buffer,
+  IN UINTN       Length
+  );
+
+#endif
@@ -0,0 +1,137 @@
+/** @file
+  CRC32C (Castagnoli) checksum library
+
+  Copyright (c) 2024 Pedro Falcato All rights reserved.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+  Buffers are checksummed with the CPU's CRC32C instructions when it has them
+  (SSE4.2 on X64, the CRC32 extension on AArch64), which is checked once, by
+  the library's constructor. Other CPUs use a portable slicing-by-8
+  implementation, which consumes 8 bytes per step instead of one.
+**/
+
+#include "BaseCrc32cLibInternals.h"
+
+STATIC BOOLEAN  mCrc32cHwSupported;
+
+/**
+   Updates a CRC32C with a buffer, in software.
+
+   Every CPU that UEFI supports is little endian, which is what the main
+   loop's 32-bit loads rely on.
+
+   @param[in]      Crc         CRC32C of the data that precedes Data.
+   @param[in]      Data        Pointer to the buffer.
+   @param[in]      Length      Length of the buffer, in bytes.
+
+   @return The updated CRC32C, not inverted.
+**/
+STATIC
+UINT32
+InternalCrc32cSoftware (
+  IN UINT32       Crc,
+  IN CONST UINT8  *Data,
+  IN UINTN        Length
+  )
+{
+  UINT32  Low;
+  UINT32  High;
+
+  // Bring Data to an 8 byte boundary, so that the main loop does aligned loads
+  while ((Length != 0) && (((UINTN)Data & 7) != 0)) {
+    Crc = mCrc32cTables[0][(Crc ^ *Data) & 0xFF] ^ (Crc >> 8);
+    Data++;
+    Length--;
+  }
+
+  while (Length >= 8) {
+    Low  = *(CONST UINT32 *)Data ^ Crc;
+    High = *(CONST UINT32 *)(Data + 4);
+
+    Crc = mCrc32cTables[7][Low & 0xFF] ^
+          mCrc32cTables[6][(Low >> 8) & 0xFF] ^
+          mCrc32cTables[5][(Low >> 16) & 0xFF] ^
+          mCrc32cTables[4][Low >> 24] ^
+          mCrc32cTables[3][High & 0xFF] ^
+          mCrc32cTables[2][(High >> 8) & 0xFF] ^
+          mCrc32cTables[1][(High >> 16) & 0xFF] ^
+          mCrc32cTables[0][High >> 24];
+
+    Data   += 8;
+    Length -= 8;
+  }
+
+  while (Length != 0) {
+    Crc = mCrc32cTables[0][(Crc ^ *Data) & 0xFF] ^ (Crc >> 8);
+    Data++;
+    Length--;
+  }
+
+  return Crc;
+}
+
+/**
+   Updates a CRC32C with a buffer, without inverting the CRC before or after.
+
+   This is the raw form of the checksum, in which the caller controls the
+   initial value and the final inversion. ext4, for instance, seeds metadata
+   checksums with the checksum of the filesystem UUID and never inverts them.
+
+   @param[in]      Crc         CRC32C of the data that precedes Buffer.
+   @param[in]      Buffer      Pointer to the buffer.
+   @param[in]      Length      Length of the buffer, in bytes.
+
+   @return The CRC32C of the data that precedes Buffer, followed by Buffer.
+**/
+UINT32
+EFIAPI
+Crc32cUpdate (
+  IN UINT32      Crc,
+  IN CONST VOID  *Buffer,
+  IN UINTN       Length
+  )
+{
+  ASSERT (Buffer != NULL || Length == 0);
+
+  if (mCrc32cHwSupported && (Length >= CRC32C_HW_MIN_LENGTH)) {
+    return InternalCrc32cHw (Crc, Buffer, Length);
+  }
+
+  return InternalCrc32cSoftware (Crc, Buffer, Length);
+}
+
+/**
+   Calculates the CRC32C of a buffer. The CRC is inverted before and after
+   the update, like CalculateCrc32c() of BaseLib.
+
+   @param[in]      Buffer        Pointer to the buffer.
+   @param[in]      Length        Length of the buffer, in bytes.
+   @param[in]      InitialValue  Initial value of the CRC.
+
+   @return The CRC32C of the buffer.
+**/
+UINT32
+EFIAPI
+Crc32cCalculate (
+  IN CONST VOID  *Buffer,
+  IN UINTN       Length,
+  IN UINT32      InitialValue
+  )
+{
+  return ~Crc32cUpdate (~InitialValue, Buffer, Length);
+}
+
+/**
+   Checks whether the CPU can compute CRC32C in hardware.
+
+   @retval RETURN_SUCCESS   The library was initialized.
+**/
+RETURN_STATUS
+EFIAPI
+BaseCrc32cLibConstructor (
+  VOID
+  )
+{
+  mCrc32cHwSupported = InternalCrc32cHwSupported ();
+  return RETURN_SUCCESS;
+}
@@ -0,0 +1,46 @@
+/** @file
+  CRC32C hardware support for CPUs without CRC32C instructions
+
+  Copyright (c) 2024 Pedro Falcato All rights reserved.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include "BaseCrc32cLibInternals.h"
+
+/**
+   Checks if the CPU can compute CRC32C in hardware, through
+   InternalCrc32cHw().
+
+   @return FALSE, always.
+**/
+BOOLEAN
+EFIAPI
+InternalCrc32cHwSupported (
+  VOID
+  )
+{
+  return FALSE;
+}
+
+/**
+   Updates a CRC32C with a buffer, using the CPU's CRC32C instructions.
+
+   Never called, as InternalCrc32cHwSupported() returns FALSE.
+
+   @param[in]      Crc         CRC32C of the data that precedes Buffer.
+   @param[in]      Buffer      Pointer to the buffer.
+   @param[in]      Length      Length of the buffer, in bytes.
+
+   @return Crc, unchanged.
+**/
+UINT32
+EFIAPI
+InternalCrc32cHw (
+  IN UINT32      Crc,
+  IN CONST VOID  *Buffer,
+  IN UINTN       Length
+  )
+{
+  ASSERT (FALSE);
+  return Crc;
+}
@@ -0,0 +1,36 @@
+/** @file
+  CRC32C hardware support detection for X64
+
+  Copyright (c) 2024 Pedro Falcato All rights reserved.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include "BaseCrc32cLibInternals.h"
+
+#include <Register/Intel/Cpuid.h>
+
+/**
+   Checks if the CPU can compute CRC32C in hardware, through
+   InternalCrc32cHw(), which needs SSE4.2.
+
+   @return TRUE if InternalCrc32cHw() may be used, else FALSE.
+**/
+BOOLEAN
+EFIAPI
+InternalCrc32cHwSupported (
+  VOID
+  )
+{
+  UINT32                  MaxLeaf;
+  CPUID_VERSION_INFO_ECX  Ecx;
+
+  AsmCpuid (CPUID_SIGNATURE, &MaxLeaf, NULL, NULL, NULL);
+
+  if (MaxLeaf < CPUID_VERSION_INFO) {
+    return FALSE;
+  }
+
+  AsmCpuid (CPUID_VERSION_INFO, NULL, NULL, &Ecx.Uint32, NULL);
+
+  return Ecx.Bits.SSE4_2 == 1;
+}
@@ -0,0 +1,44 @@
+/** @file
+  GUID HOB of the responses of IPMI commands cached by IPMI PEIM, which
+  IPMI DXE driver continues with.
+
+  Copyright (C) 2023 Advanced Micro Devices, Inc. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef MANAGEABILITY_IPMI_RESPONSE_CACHE_HOB_H_
+#define MANAGEABILITY_IPMI_RESPONSE_CACHE_HOB_H_
+
+#define MANAGEABILITY_IPMI_RESPONSE_CACHE_HOB_GUID \
+  { \
+    0xB96DB37B, 0x89AF, 0x4D11, { 0xA9, 0xC8, 0xAB, 0x21, 0x8B, 0xA6, 0x8E, 0xC8 } \
+  }
+
+#define IPMI_RESPONSE_CACHE_ENTRIES            16
+#define IPMI_RESPONSE_CACHE_MAX_REQUEST_SIZE   4
+#define IPMI_RESPONSE_CACHE_MAX_RESPONSE_SIZE  32
+
+///
+/// The response of an IPMI command, which is keyed by the command
+/// and its request data.
+///
+typedef struct {
+  UINT8    NetFunction;
+  UINT8    Command;
+  UINT8    RequestDataSize;
+  UINT8    ResponseDataSize;
+  UINT8    RequestData[IPMI_RESPONSE_CACHE_MAX_REQUEST_SIZE];
+  UINT8    ResponseData[IPMI_RESPONSE_CACHE_MAX_RESPONSE_SIZE];
+} IPMI_RESPONSE_CACHE_ENTRY;
+
+///
+/// The cached responses. Entry[0] to Entry[Count - 1] are valid.
+///
+typedef struct {
+  UINT32                       Count;
+  IPMI_RESPONSE_CACHE_ENTRY    Entry[IPMI_RESPONSE_CACHE_ENTRIES];
+} IPMI_RESPONSE_CACHE;
+
+extern EFI_GUID  gManageabilityIpmiResponseCacheHobGuid;
+
+#endif // MANAGEABILITY_IPMI_RESPONSE_CACHE_HOB_H_
@@ -539,6 +539,21 @@ IpmiPartialAddSelEntry (
   OUT IPMI_PARTIAL_ADD_SEL_ENTRY_RESPONSE  *PartialAddSelEntryResponse
   );
 
+/**
+  This function reserves the SEL for the operations that require
+  a reservation ID, like clearing the SEL.
+
+  @param [out]  ReserveSelResponse  Pointer to receive IPMI_RESERVE_SEL_RESPONSE.
+
+  @retval EFI_STATUS   See the return values of IpmiSubmitCommand () function.
+
+**/
+EFI_STATUS
+EFIAPI
+IpmiReserveSel (
+  OUT IPMI_RESERVE_SEL_RESPONSE  *ReserveSelResponse
+  );
+
 /**
   This function erases all contents of the System Event Log.
 
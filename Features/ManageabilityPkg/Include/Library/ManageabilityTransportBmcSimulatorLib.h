@@ -0,0 +1,102 @@
+/** @file
+
+  This file defines the functions to script the BMC model of the
+  BMC simulator instance of Manageability Transport Library.
+
+  Copyright (C) 2023 Advanced Micro Devices, Inc. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef MANAGEABILITY_TRANSPORT_BMC_SIMULATOR_LIB_H_
+#define MANAGEABILITY_TRANSPORT_BMC_SIMULATOR_LIB_H_
+
+///
+/// Maximum size of a response the BMC model returns, including
+/// the completion code.
+///
+#define BMC_SIMULATOR_RESPONSE_MAX  128
+
+///
+/// Kinds of the messages the BMC model answers.
+///
+typedef enum {
+  BmcSimulatorIpmi,        ///< Group is the IPMI NetFn.
+  BmcSimulatorMctpControl, ///< Group is ignored.
+  BmcSimulatorPldm,        ///< Group is the PLDM type.
+  BmcSimulatorMessageKindMax
+} BMC_SIMULATOR_MESSAGE_KIND;
+
+///
+/// Statistics of the requests the BMC model answered.
+///
+typedef struct {
+  UINT64    IpmiRequests;         ///< IPMI requests answered.
+  UINT64    MctpPackets;          ///< MCTP packets received from the host.
+  UINT64    MctpControlRequests;  ///< MCTP control messages answered.
+  UINT64    PldmRequests;         ///< PLDM messages answered.
+  UINT64    ScriptedResponses;    ///< Requests answered with a scripted response.
+  UINT64    UnsupportedRequests;  ///< Requests answered with an unsupported command error.
+  UINT64    DroppedPackets;       ///< MCTP packets dropped as malformed or unexpected.
+} BMC_SIMULATOR_STATISTICS;
+
+/**
+  This function scripts the response of a command, which then overrides
+  the response of the BMC model.
+
+  @param[in]  Kind          Kind of the message.
+  @param[in]  Group         IPMI NetFn or PLDM type of the command, see
+                            BMC_SIMULATOR_MESSAGE_KIND.
+  @param[in]  Command       Command code.
+  @param[in]  Response      Response starting with the completion code, without
+                            the IPMI, MCTP control or PLDM message header.
+                            NULL removes the scripted response of the command.
+  @param[in]  ResponseSize  Size of Response in byte.
+
+  @retval  EFI_SUCCESS            The response is scripted or removed.
+  @retval  EFI_INVALID_PARAMETER  Kind is invalid, or ResponseSize is 0 or larger
+                                  than BMC_SIMULATOR_RESPONSE_MAX.
+  @retval  EFI_OUT_OF_RESOURCES   Too many responses are scripted.
+  @retval  EFI_NOT_FOUND          Response is NULL and the command has no
+                                  scripted response.
+**/
+EFI_STATUS
+BmcSimulatorSetResponse (
+  IN BMC_SIMULATOR_MESSAGE_KIND  Kind,
+  IN UINT8                       Group,
+  IN UINT8                       Command,
+  IN CONST UINT8                 *Response OPTIONAL,
+  IN UINT32                      ResponseSize
+  );
+
+/**
+  This function sets the time the BMC model takes to answer a request.
+
+  @param[in]  LatencyInMicrosecond  Latency of each request in microseconds.
+**/
+VOID
+BmcSimulatorSetLatency (
+  IN UINT32  LatencyInMicrosecond
+  );
+
+/**
+  This function returns the statistics of the requests the BMC model
+  answered since it was reset.
+
+  @param[out]  Statistics  Pointer to receive the statistics.
+**/
+VOID
+BmcSimulatorGetStatistics (
+  OUT BMC_SIMULATOR_STATISTICS  *Statistics
+  );
+
+/**
+  This function resets the BMC model to its power on state. The scripted
+  responses, the statistics and the MCTP packets not read yet are
+  discarded and the latency is set back to PcdBmcSimulatorLatency.
+**/
+VOID
+BmcSimulatorReset (
+  VOID
+  );
+
+#endif
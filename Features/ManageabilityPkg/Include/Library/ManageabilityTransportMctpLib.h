@@ -47,7 +47,7 @@ typedef struct {
 #define MCTP_MESSAGE_TAG  0x1
 
 #define MCTP_MESSAGE_TAG_OWNER_REQUEST   0x01
-#define MCTP_MESSAGE_TAG_OWNER_RESPONSE  0x01
+#define MCTP_MESSAGE_TAG_OWNER_RESPONSE  0x00
 
 #define MCTP_PACKET_SEQUENCE_MASK  0x3
 
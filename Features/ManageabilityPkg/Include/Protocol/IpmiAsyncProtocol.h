@@ -0,0 +1,133 @@
+/** @file
+  Protocol of EDKII IPMI Asynchronous Protocol.
+
+  Copyright (C) 2023 Advanced Micro Devices, Inc. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef EDKII_IPMI_ASYNC_PROTOCOL_H_
+#define EDKII_IPMI_ASYNC_PROTOCOL_H_
+
+typedef struct  _EDKII_IPMI_ASYNC_PROTOCOL EDKII_IPMI_ASYNC_PROTOCOL;
+
+#define EDKII_IPMI_ASYNC_PROTOCOL_GUID \
+  { \
+    0x2B4D8A6F, 0x0E57, 0x4C1A, 0x9B, 0x83, 0x5D, 0x1F, 0x47, 0xC2, 0x6E, 0x90 \
+  }
+
+#define EDKII_IPMI_ASYNC_PROTOCOL_VERSION_MAJOR  1
+#define EDKII_IPMI_ASYNC_PROTOCOL_VERSION_MINOR  0
+#define EDKII_IPMI_ASYNC_PROTOCOL_VERSION        ((EDKII_IPMI_ASYNC_PROTOCOL_VERSION_MAJOR << 8) |\
+                                                  EDKII_IPMI_ASYNC_PROTOCOL_VERSION_MINOR)
+
+///
+/// The token to receive the result of an IPMI command submitted
+/// asynchronously. The token must stay valid until the command is
+/// completed or cancelled.
+///
+typedef struct {
+  EFI_EVENT     Event;            ///< Event signaled when the command is completed,
+                                  ///< can be NULL.
+  EFI_STATUS    Status;           ///< EFI_NOT_READY while the command is queued.
+                                  ///< Once completed, the status of the command, or
+                                  ///< EFI_TIMEOUT if it waited in the queue longer
+                                  ///< than its timeout, or EFI_ABORTED if cancelled.
+  UINT8         *ResponseData;    ///< Buffer to receive the response, can be NULL.
+                                  ///< The completion code is the first byte.
+  UINT32        ResponseDataSize; ///< When submitted, size of ResponseData. When
+                                  ///< completed, size of the response received.
+} EDKII_IPMI_ASYNC_TOKEN;
+
+/**
+  This service queues an IPMI command and returns without waiting for it.
+  The queued commands are submitted to BMC in order in the background.
+  The request data is copied, so the caller may free it on return.
+
+  @param[in]  This                  EDKII_IPMI_ASYNC_PROTOCOL instance.
+  @param[in]  NetFunction           Net function of the command.
+  @param[in]  Command               IPMI Command.
+  @param[in]  RequestData           Command Request Data.
+  @param[in]  RequestDataSize       Size of Command Request Data.
+  @param[in]  TimeoutInMillisecond  The time the command can wait in the queue,
+                                    after which it is dropped without being sent.
+                                    MANAGEABILITY_TRANSPORT_NO_TIMEOUT means no timeout value.
+  @param[in]  Token                 Token to receive the result of the command.
+                                    NULL to discard the result.
+
+  @retval EFI_SUCCESS            The command is queued.
+  @retval EFI_OUT_OF_RESOURCES   The queue is full or the request data can't be copied.
+  @retval EFI_INVALID_PARAMETER  RequestData is NULL but RequestDataSize is not 0.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *IPMI_ASYNC_SUBMIT_COMMAND)(
+  IN     EDKII_IPMI_ASYNC_PROTOCOL  *This,
+  IN     UINT8                      NetFunction,
+  IN     UINT8                      Command,
+  IN     UINT8                      *RequestData OPTIONAL,
+  IN     UINT32                     RequestDataSize,
+  IN     UINT32                     TimeoutInMillisecond,
+  IN     EDKII_IPMI_ASYNC_TOKEN     *Token OPTIONAL
+  );
+
+/**
+  This service removes a command from the queue before it is submitted.
+  The Status of the token is set to EFI_ABORTED and its Event is signaled.
+
+  @param[in]  This    EDKII_IPMI_ASYNC_PROTOCOL instance.
+  @param[in]  Token   Token of the command.
+
+  @retval EFI_SUCCESS     The command is cancelled.
+  @retval EFI_NOT_FOUND   The command is not in the queue, it is completed
+                          already or in progress.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *IPMI_ASYNC_CANCEL)(
+  IN     EDKII_IPMI_ASYNC_PROTOCOL  *This,
+  IN     EDKII_IPMI_ASYNC_TOKEN     *Token
+  );
+
+/**
+  This service submits all the queued commands and waits for them,
+  for the callers that need the queue drained, e.g. before handing
+  the BMC over to OS.
+
+  @param[in]  This    EDKII_IPMI_ASYNC_PROTOCOL instance.
+
+  @retval EFI_SUCCESS     The queue is empty.
+  @retval EFI_NOT_READY   The queue is being drained by an interrupted caller.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *IPMI_ASYNC_FLUSH)(
+  IN     EDKII_IPMI_ASYNC_PROTOCOL  *This
+  );
+
+//
+// EDKII_IPMI_ASYNC_PROTOCOL Version 1.0
+//
+typedef struct {
+  IPMI_ASYNC_SUBMIT_COMMAND    IpmiAsyncSubmitCommand;
+  IPMI_ASYNC_CANCEL            IpmiAsyncCancel;
+  IPMI_ASYNC_FLUSH             IpmiAsyncFlush;
+} EDKII_IPMI_ASYNC_PROTOCOL_V1_0;
+
+///
+/// Definitions of EDKII_IPMI_ASYNC_PROTOCOL.
+/// The new function must be added base on the last version of
+/// EDKII_IPMI_ASYNC_PROTOCOL to keep the backward compatibility.
+///
+typedef union {
+  EDKII_IPMI_ASYNC_PROTOCOL_V1_0    *Version1_0;
+} EDKII_IPMI_ASYNC_PROTOCOL_FUNCTION;
+
+struct _EDKII_IPMI_ASYNC_PROTOCOL {
+  UINT16                                ProtocolVersion;
+  EDKII_IPMI_ASYNC_PROTOCOL_FUNCTION    Functions;
+};
+
+extern EFI_GUID  gEdkiiIpmiAsyncProtocolGuid;
+
+#endif // EDKII_IPMI_ASYNC_PROTOCOL_H_
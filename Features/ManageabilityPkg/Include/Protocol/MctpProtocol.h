@@ -19,7 +19,7 @@ typedef struct  _EDKII_MCTP_PROTOCOL EDKII_MCTP_PROTOCOL;
   }
 
 #define EDKII_MCTP_PROTOCOL_VERSION_MAJOR  1
-#define EDKII_MCTP_PROTOCOL_VERSION_MINOR  0
+#define EDKII_MCTP_PROTOCOL_VERSION_MINOR  1
 #define EDKII_MCTP_PROTOCOL_VERSION        ((EDKII_MCTP_PROTOCOL_VERSION_MAJOR << 8) |\
                                        EDKII_MCTP_PROTOCOL_VERSION_MINOR)
 
@@ -70,6 +70,76 @@ EFI_STATUS
   OUT    MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS *AdditionalTransferError
   );
 
+/**
+  This service sends a request via EDKII MCTP protocol without waiting
+  for its response, so that requests to the endpoint can overlap. The
+  request stays outstanding until its response is received by
+  MCTP_RECEIVE_RESPONSE, with the message tag returned here.
+
+  @param[in]         This                       EDKII_MCTP_PROTOCOL instance.
+  @param[in]         MctpType                   MCTP message type.
+  @param[in]         MctpSourceEndpointId       MCTP source endpoint ID.
+  @param[in]         MctpDestinationEndpointId  MCTP source endpoint ID.
+  @param[in]         RequestDataIntegrityCheck  Indicates whether MCTP message has
+                                                integrity check byte.
+  @param[in]         RequestData                Message Data.
+  @param[in]         RequestDataSize            Size of message Data.
+  @param[in]         RequestTimeout             Timeout value in milliseconds.
+                                                MANAGEABILITY_TRANSPORT_NO_TIMEOUT means no timeout value.
+  @param[out]        MessageTag                 Message tag to receive the response with.
+  @param[out]        AdditionalTransferError    MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS.
+
+  @retval EFI_SUCCESS            The message was successfully sent to transport interface.
+  @retval EFI_OUT_OF_RESOURCES   All the message tags are used by outstanding requests.
+  @retval EFI_UNSUPPORTED        The message was not successfully sent to the transport interface.
+  @retval Others                 The message was not sent.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *MCTP_SEND_REQUEST)(
+  IN     EDKII_MCTP_PROTOCOL  *This,
+  IN     UINT8                MctpType,
+  IN     UINT8                MctpSourceEndpointId,
+  IN     UINT8                MctpDestinationEndpointId,
+  IN     BOOLEAN              RequestDataIntegrityCheck,
+  IN     UINT8                *RequestData,
+  IN     UINT32               RequestDataSize,
+  IN     UINT32               RequestTimeout,
+  OUT    UINT8                *MessageTag,
+  OUT    MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS *AdditionalTransferError
+  );
+
+/**
+  This service receives the response of a request sent by MCTP_SEND_REQUEST.
+  The packets of the other outstanding requests received meanwhile are
+  reassembled for them.
+
+  @param[in]         This                       EDKII_MCTP_PROTOCOL instance.
+  @param[in]         MessageTag                 Message tag returned by MCTP_SEND_REQUEST.
+  @param[out]        ResponseData               Message Response Data. The completion code is the first byte of response data.
+  @param[in, out]    ResponseDataSize           Size of Message Response Data.
+  @param[in]         ResponseTimeout            Timeout value in milliseconds.
+                                                MANAGEABILITY_TRANSPORT_NO_TIMEOUT means no timeout value.
+  @param[out]        AdditionalTransferError    MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS.
+
+  @retval EFI_SUCCESS            The response was received.
+  @retval EFI_INVALID_PARAMETER  No request is outstanding with MessageTag.
+  @retval EFI_BUFFER_TOO_SMALL   The response is larger than ResponseData, which
+                                 received its first ResponseDataSize bytes.
+  @retval EFI_PROTOCOL_ERROR     Packets of the response were lost.
+  @retval Others                 The response was not received.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *MCTP_RECEIVE_RESPONSE)(
+  IN     EDKII_MCTP_PROTOCOL  *This,
+  IN     UINT8                MessageTag,
+  OUT    UINT8                *ResponseData,
+  IN OUT UINT32               *ResponseDataSize,
+  IN     UINT32               ResponseTimeout,
+  OUT    MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS *AdditionalTransferError
+  );
+
 //
 // EDKII_MCTP_PROTOCOL Version 1.0
 //
@@ -77,6 +147,15 @@ typedef struct {
   MCTP_SUBMIT_COMMAND    MctpSubmitCommand;
 } EDKII_MCTP_PROTOCOL_V1_0;
 
+//
+// EDKII_MCTP_PROTOCOL Version 1.1
+//
+typedef struct {
+  MCTP_SUBMIT_COMMAND      MctpSubmitCommand;
+  MCTP_SEND_REQUEST        MctpSendRequest;
+  MCTP_RECEIVE_RESPONSE    MctpReceiveResponse;
+} EDKII_MCTP_PROTOCOL_V1_1;
+
 ///
 /// Definitions of EDKII_MCTP_PROTOCOL.
 /// This is a union that can accommodate the new functionalities defined
@@ -90,6 +169,7 @@ typedef struct {
 ///
 typedef union {
   EDKII_MCTP_PROTOCOL_V1_0    *Version1_0;
+  EDKII_MCTP_PROTOCOL_V1_1    *Version1_1;
 } EDKII_MCTP_PROTOCOL_FUNCTION;
 
 struct _EDKII_MCTP_PROTOCOL {
@@ -0,0 +1,443 @@
+/** @file
+
+  IPMI commands of the BMC model of the BMC simulator
+  Manageability Transport Library.
+
+  Copyright (C) 2023 Advanced Micro Devices, Inc. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/Ipmi.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/ManageabilityTransportHelperLib.h>
+
+#include "ManageabilityTransportBmcSimulator.h"
+
+///
+/// Response data of Get Device ID, after the completion code.
+///
+GLOBAL_REMOVE_IF_UNREFERENCED CONST UINT8  mBmcSimulatorDeviceId[] = {
+  0x20,             // Device ID
+  0x81,             // Provides device SDRs, device revision 1
+  0x01,             // Firmware revision 1,
+  0x00,             // 00
+  0x02,             // IPMI version 2.0
+  0xBF,             // All additional device supports
+  0x00, 0x00, 0x00, // No manufacturer ID
+  0x00, 0x00,       // Product ID
+  0x00, 0x00, 0x00, 0x00
+};
+
+///
+/// Response data of Get System GUID and Get Device GUID.
+///
+GLOBAL_REMOVE_IF_UNREFERENCED CONST UINT8  mBmcSimulatorGuid[] = {
+  0x7F, 0x5A, 0x4B, 0x2D, 0x9C, 0x61, 0x4E, 0x0B,
+  0xA3, 0x58, 0x2E, 0x6A, 0x35, 0xC4, 0x91, 0x07
+};
+
+/**
+  This function resets the IPMI state of the BMC model.
+**/
+VOID
+BmcSimulatorIpmiReset (
+  VOID
+  )
+{
+  mBmcSimulator.WatchdogInitialized      = FALSE;
+  mBmcSimulator.WatchdogTimerUse         = 0;
+  mBmcSimulator.WatchdogTimerActions     = 0;
+  mBmcSimulator.WatchdogExpirationFlags  = 0;
+  mBmcSimulator.WatchdogInitialCountdown = 0;
+  mBmcSimulator.WatchdogPresentCountdown = 0;
+  mBmcSimulator.SelReservationId         = 0;
+
+  //
+  // A FRU with an empty common header: format version 1,
+  // no areas and its checksum.
+  //
+  if (mBmcSimulator.Fru[0] == 0) {
+    SetMem (mBmcSimulator.Fru, sizeof (mBmcSimulator.Fru), 0xFF);
+    ZeroMem (mBmcSimulator.Fru, 8);
+    mBmcSimulator.Fru[0] = 0x01;
+    mBmcSimulator.Fru[7] = 0xFF;
+  }
+}
+
+/**
+  This function answers a watchdog timer command.
+
+  @param[in]   Command      Command of the request.
+  @param[in]   Request      Request data.
+  @param[in]   RequestSize  Size of request data in byte.
+  @param[out]  Response     Buffer to receive the response.
+
+  @retval  Size of the response.
+**/
+STATIC
+UINT32
+BmcSimulatorWatchdog (
+  IN  UINT8   Command,
+  IN  UINT8   *Request,
+  IN  UINT32  RequestSize,
+  OUT UINT8   *Response
+  )
+{
+  Response[0] = IPMI_COMP_CODE_NORMAL;
+  switch (Command) {
+    case IPMI_APP_SET_WATCHDOG_TIMER:
+      if (RequestSize != 6) {
+        Response[0] = IPMI_COMP_CODE_INVALID_REQUEST_DATA_LENGTH;
+        return 1;
+      }
+
+      mBmcSimulator.WatchdogInitialized         = TRUE;
+      mBmcSimulator.WatchdogTimerUse            = Request[0];
+      mBmcSimulator.WatchdogTimerActions        = Request[1];
+      mBmcSimulator.WatchdogPreTimeoutInterval  = Request[2];
+      mBmcSimulator.WatchdogExpirationFlags    &= ~Request[3];
+      mBmcSimulator.WatchdogInitialCountdown    = (UINT16)(Request[4] | (Request[5] << 8));
+      mBmcSimulator.WatchdogPresentCountdown    = mBmcSimulator.WatchdogInitialCountdown;
+      return 1;
+
+    case IPMI_APP_GET_WATCHDOG_TIMER:
+      Response[1] = mBmcSimulator.WatchdogTimerUse;
+      Response[2] = mBmcSimulator.WatchdogTimerActions;
+      Response[3] = mBmcSimulator.WatchdogPreTimeoutInterval;
+      Response[4] = mBmcSimulator.WatchdogExpirationFlags;
+      Response[5] = (UINT8)mBmcSimulator.WatchdogInitialCountdown;
+      Response[6] = (UINT8)(mBmcSimulator.WatchdogInitialCountdown >> 8);
+      Response[7] = (UINT8)mBmcSimulator.WatchdogPresentCountdown;
+      Response[8] = (UINT8)(mBmcSimulator.WatchdogPresentCountdown >> 8);
+      return 9;
+
+    default:
+      //
+      // Reset Watchdog Timer starts the timer. The timer doesn't count
+      // down, as the BMC model has no clock. Completion code 0x80 means
+      // the timer isn't set yet.
+      //
+      if (!mBmcSimulator.WatchdogInitialized) {
+        Response[0] = 0x80;
+        return 1;
+      }
+
+      mBmcSimulator.WatchdogTimerUse        |= BIT6;
+      mBmcSimulator.WatchdogPresentCountdown = mBmcSimulator.WatchdogInitialCountdown;
+      return 1;
+  }
+}
+
+/**
+  This function answers a SEL command.
+
+  @param[in]   Command      Command of the request.
+  @param[in]   Request      Request data.
+  @param[in]   RequestSize  Size of request data in byte.
+  @param[out]  Response     Buffer to receive the response.
+
+  @retval  Size of the response.
+**/
+STATIC
+UINT32
+BmcSimulatorSel (
+  IN  UINT8   Command,
+  IN  UINT8   *Request,
+  IN  UINT32  RequestSize,
+  OUT UINT8   *Response
+  )
+{
+  UINT16  RecordId;
+  UINT16  FreeSpace;
+  UINT8   Offset;
+  UINT8   Count;
+
+  Response[0] = IPMI_COMP_CODE_NORMAL;
+  switch (Command) {
+    case IPMI_STORAGE_GET_SEL_INFO:
+      FreeSpace    = (BMC_SIMULATOR_SEL_ENTRIES - mBmcSimulator.SelEntryCount) * BMC_SIMULATOR_SEL_ENTRY_SIZE;
+      Response[1]  = 0x51;
+      Response[2]  = (UINT8)mBmcSimulator.SelEntryCount;
+      Response[3]  = (UINT8)(mBmcSimulator.SelEntryCount >> 8);
+      Response[4]  = (UINT8)FreeSpace;
+      Response[5]  = (UINT8)(FreeSpace >> 8);
+      CopyMem (&Response[6], &mBmcSimulator.SelAddTimestamp, sizeof (UINT32));
+      CopyMem (&Response[10], &mBmcSimulator.SelEraseTimestamp, sizeof (UINT32));
+      Response[14] = BIT1; // Reserve SEL supported
+      return 15;
+
+    case IPMI_STORAGE_RESERVE_SEL:
+      mBmcSimulator.SelReservationId++;
+      if (mBmcSimulator.SelReservationId == 0) {
+        mBmcSimulator.SelReservationId++;
+      }
+
+      Response[1] = (UINT8)mBmcSimulator.SelReservationId;
+      Response[2] = (UINT8)(mBmcSimulator.SelReservationId >> 8);
+      return 3;
+
+    case IPMI_STORAGE_GET_SEL_ENTRY:
+      if (RequestSize != 6) {
+        Response[0] = IPMI_COMP_CODE_INVALID_REQUEST_DATA_LENGTH;
+        return 1;
+      }
+
+      //
+      // The record ID is the index of the entry plus one.
+      //
+      RecordId = (UINT16)(Request[2] | (Request[3] << 8));
+      Offset   = Request[4];
+      Count    = Request[5];
+      if (RecordId == 0x0000) {
+        RecordId = 1;
+      } else if (RecordId == 0xFFFF) {
+        RecordId = mBmcSimulator.SelEntryCount;
+      }
+
+      if ((RecordId == 0) || (RecordId > mBmcSimulator.SelEntryCount)) {
+        Response[0] = IPMI_COMP_CODE_NOT_PRESENT;
+        return 1;
+      }
+
+      if ((Offset != 0) &&
+          ((Request[0] | (Request[1] << 8)) != mBmcSimulator.SelReservationId))
+      {
+        Response[0] = IPMI_COMP_CODE_RESERVATION_CANCELED_OR_INVALID;
+        return 1;
+      }
+
+      if (Offset >= BMC_SIMULATOR_SEL_ENTRY_SIZE) {
+        Response[0] = IPMI_COMP_CODE_OUT_OF_RANGE;
+        return 1;
+      }
+
+      if ((Count == 0xFF) || (Offset + Count > BMC_SIMULATOR_SEL_ENTRY_SIZE)) {
+        Count = BMC_SIMULATOR_SEL_ENTRY_SIZE - Offset;
+      }
+
+      if (RecordId == mBmcSimulator.SelEntryCount) {
+        Response[1] = 0xFF;
+        Response[2] = 0xFF;
+      } else {
+        Response[1] = (UINT8)(RecordId + 1);
+        Response[2] = (UINT8)((RecordId + 1) >> 8);
+      }
+
+      CopyMem (&Response[3], &mBmcSimulator.Sel[RecordId - 1][Offset], Count);
+      return 3 + Count;
+
+    case IPMI_STORAGE_ADD_SEL_ENTRY:
+      if (RequestSize != BMC_SIMULATOR_SEL_ENTRY_SIZE) {
+        Response[0] = IPMI_COMP_CODE_INVALID_REQUEST_DATA_LENGTH;
+        return 1;
+      }
+
+      if (mBmcSimulator.SelEntryCount == BMC_SIMULATOR_SEL_ENTRIES) {
+        Response[0] = IPMI_COMP_CODE_OUT_OF_SPACE;
+        return 1;
+      }
+
+      //
+      // The BMC sets the record ID, and the time stamp of system events.
+      //
+      mBmcSimulator.SelTimestamp++;
+      mBmcSimulator.SelAddTimestamp = mBmcSimulator.SelTimestamp;
+      RecordId                      = ++mBmcSimulator.SelEntryCount;
+      CopyMem (mBmcSimulator.Sel[RecordId - 1], Request, BMC_SIMULATOR_SEL_ENTRY_SIZE);
+      mBmcSimulator.Sel[RecordId - 1][0] = (UINT8)RecordId;
+      mBmcSimulator.Sel[RecordId - 1][1] = (UINT8)(RecordId >> 8);
+      if (mBmcSimulator.Sel[RecordId - 1][2] == 0x02) {
+        CopyMem (&mBmcSimulator.Sel[RecordId - 1][3], &mBmcSimulator.SelTimestamp, sizeof (UINT32));
+      }
+
+      Response[1] = (UINT8)RecordId;
+      Response[2] = (UINT8)(RecordId >> 8);
+      return 3;
+
+    default:
+      //
+      // Clear SEL completes at once, so getting the erasure
+      // status always reports it completed.
+      //
+      if (RequestSize != 6) {
+        Response[0] = IPMI_COMP_CODE_INVALID_REQUEST_DATA_LENGTH;
+        return 1;
+      }
+
+      if ((Request[0] | (Request[1] << 8)) != mBmcSimulator.SelReservationId) {
+        Response[0] = IPMI_COMP_CODE_RESERVATION_CANCELED_OR_INVALID;
+        return 1;
+      }
+
+      if ((Request[2] != 'C') || (Request[3] != 'L') || (Request[4] != 'R') ||
+          ((Request[5] != 0xAA) && (Request[5] != 0x00)))
+      {
+        Response[0] = IPMI_COMP_CODE_INVALID_DATA_FIELD;
+        return 1;
+      }
+
+      if (Request[5] == 0xAA) {
+        mBmcSimulator.SelTimestamp++;
+        mBmcSimulator.SelEraseTimestamp = mBmcSimulator.SelTimestamp;
+        mBmcSimulator.SelEntryCount     = 0;
+      }
+
+      Response[1] = 0x01;
+      return 2;
+  }
+}
+
+/**
+  This function answers a FRU command of FRU device 0.
+
+  @param[in]   Command      Command of the request.
+  @param[in]   Request      Request data.
+  @param[in]   RequestSize  Size of request data in byte.
+  @param[out]  Response     Buffer to receive the response.
+
+  @retval  Size of the response.
+**/
+STATIC
+UINT32
+BmcSimulatorFru (
+  IN  UINT8   Command,
+  IN  UINT8   *Request,
+  IN  UINT32  RequestSize,
+  OUT UINT8   *Response
+  )
+{
+  UINT32  Offset;
+  UINT32  Count;
+
+  Response[0] = IPMI_COMP_CODE_NORMAL;
+  if ((RequestSize < 1) || (Request[0] != 0)) {
+    Response[0] = IPMI_COMP_CODE_NOT_PRESENT;
+    return 1;
+  }
+
+  if (Command == IPMI_STORAGE_GET_FRU_INVENTORY_AREAINFO) {
+    Response[1] = (UINT8)BMC_SIMULATOR_FRU_SIZE;
+    Response[2] = (UINT8)(BMC_SIMULATOR_FRU_SIZE >> 8);
+    Response[3] = 0x00; // Accessed by bytes
+    return 4;
+  }
+
+  if (RequestSize < 3) {
+    Response[0] = IPMI_COMP_CODE_INVALID_REQUEST_DATA_LENGTH;
+    return 1;
+  }
+
+  Offset = Request[1] | (Request[2] << 8);
+  if (Offset >= BMC_SIMULATOR_FRU_SIZE) {
+    Response[0] = IPMI_COMP_CODE_OUT_OF_RANGE;
+    return 1;
+  }
+
+  if (Command == IPMI_STORAGE_READ_FRU_DATA) {
+    if (RequestSize != 4) {
+      Response[0] = IPMI_COMP_CODE_INVALID_REQUEST_DATA_LENGTH;
+      return 1;
+    }
+
+    Count = MIN (Request[3], BMC_SIMULATOR_FRU_SIZE - Offset);
+    Count = MIN (Count, BMC_SIMULATOR_RESPONSE_MAX - 2);
+    CopyMem (&Response[2], &mBmcSimulator.Fru[Offset], Count);
+  } else {
+    Count = MIN (RequestSize - 3, BMC_SIMULATOR_FRU_SIZE - Offset);
+    CopyMem (&mBmcSimulator.Fru[Offset], &Request[3], Count);
+  }
+
+  Response[1] = (UINT8)Count;
+  return (Command == IPMI_STORAGE_READ_FRU_DATA) ? 2 + Count : 2;
+}
+
+/**
+  This function answers an IPMI request.
+
+  @param[in]   NetFn        NetFn of the request.
+  @param[in]   Command      Command of the request.
+  @param[in]   Request      Request data.
+  @param[in]   RequestSize  Size of request data in byte.
+  @param[out]  Response     Buffer of BMC_SIMULATOR_RESPONSE_MAX bytes to receive
+                            the completion code and the response data.
+
+  @retval  Size of the response.
+**/
+UINT32
+BmcSimulatorIpmiRequest (
+  IN  UINT8   NetFn,
+  IN  UINT8   Command,
+  IN  UINT8   *Request OPTIONAL,
+  IN  UINT32  RequestSize,
+  OUT UINT8   *Response
+  )
+{
+  UINT32  ResponseSize;
+
+  if (Request == NULL) {
+    RequestSize = 0;
+  }
+
+  mBmcSimulator.Statistics.IpmiRequests++;
+  ResponseSize = BmcSimulatorScriptedResponse (BmcSimulatorIpmi, NetFn, Command, Response);
+  if (ResponseSize != 0) {
+    return ResponseSize;
+  }
+
+  Response[0] = IPMI_COMP_CODE_NORMAL;
+  if (NetFn == IPMI_NETFN_APP) {
+    switch (Command) {
+      case IPMI_APP_GET_DEVICE_ID:
+        CopyMem (&Response[1], mBmcSimulatorDeviceId, sizeof (mBmcSimulatorDeviceId));
+        return 1 + sizeof (mBmcSimulatorDeviceId);
+
+      case IPMI_APP_COLD_RESET:
+      case IPMI_APP_WARM_RESET:
+        BmcSimulatorIpmiReset ();
+        return 1;
+
+      case IPMI_APP_GET_SELFTEST_RESULTS:
+        Response[1] = IPMI_APP_SELFTEST_NO_ERROR;
+        Response[2] = 0x00;
+        return 3;
+
+      case IPMI_APP_GET_DEVICE_GUID:
+      case IPMI_APP_GET_SYSTEM_GUID:
+        CopyMem (&Response[1], mBmcSimulatorGuid, sizeof (mBmcSimulatorGuid));
+        return 1 + sizeof (mBmcSimulatorGuid);
+
+      case IPMI_APP_RESET_WATCHDOG_TIMER:
+      case IPMI_APP_SET_WATCHDOG_TIMER:
+      case IPMI_APP_GET_WATCHDOG_TIMER:
+        return BmcSimulatorWatchdog (Command, Request, RequestSize, Response);
+
+      default:
+        break;
+    }
+  } else if (NetFn == IPMI_NETFN_STORAGE) {
+    switch (Command) {
+      case IPMI_STORAGE_GET_FRU_INVENTORY_AREAINFO:
+      case IPMI_STORAGE_READ_FRU_DATA:
+      case IPMI_STORAGE_WRITE_FRU_DATA:
+        return BmcSimulatorFru (Command, Request, RequestSize, Response);
+
+      case IPMI_STORAGE_GET_SEL_INFO:
+      case IPMI_STORAGE_RESERVE_SEL:
+      case IPMI_STORAGE_GET_SEL_ENTRY:
+      case IPMI_STORAGE_ADD_SEL_ENTRY:
+      case IPMI_STORAGE_CLEAR_SEL:
+        return BmcSimulatorSel (Command, Request, RequestSize, Response);
+
+      default:
+        break;
+    }
+  }
+
+  DEBUG ((DEBUG_MANAGEABILITY_INFO, "%a: Unsupported IPMI NetFn 0x%x Command 0x%x.\n", __func__, NetFn, Command));
+  mBmcSimulator.Statistics.UnsupportedRequests++;
+  Response[0] = IPMI_COMP_CODE_INVALID_COMMAND;
+  return 1;
+}
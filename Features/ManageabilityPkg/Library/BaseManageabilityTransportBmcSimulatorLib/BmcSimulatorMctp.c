@@ -0,0 +1,684 @@
+/** @file
+
+  MCTP endpoint and PLDM terminus of the BMC model of the BMC
+  simulator Manageability Transport Library.
+
+  Copyright (C) 2023 Advanced Micro Devices, Inc. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/Mctp.h>
+#include <IndustryStandard/Pldm.h>
+#include <IndustryStandard/PldmSmbiosTransfer.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
+#include <Library/ManageabilityTransportHelperLib.h>
+#include <Library/ManageabilityTransportMctpLib.h>
+
+#include "ManageabilityTransportBmcSimulator.h"
+
+///
+/// UUID of the MCTP endpoint.
+///
+GLOBAL_REMOVE_IF_UNREFERENCED CONST UINT8  mBmcSimulatorEndpointUuid[] = {
+  0x3E, 0x81, 0x0C, 0x64, 0x27, 0xD5, 0x4A, 0x9F,
+  0xB1, 0x40, 0x6D, 0x92, 0xE8, 0x15, 0x5B, 0xC3
+};
+
+/**
+  This function resets the MCTP and PLDM state of the BMC model.
+**/
+VOID
+BmcSimulatorMctpReset (
+  VOID
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < BMC_SIMULATOR_MCTP_MESSAGE_TAGS; Index++) {
+    if (mBmcSimulator.MctpRequests[Index].Message != NULL) {
+      FreePool (mBmcSimulator.MctpRequests[Index].Message);
+    }
+  }
+
+  if (mBmcSimulator.SmbiosTable != NULL) {
+    FreePool (mBmcSimulator.SmbiosTable);
+  }
+
+  ZeroMem (mBmcSimulator.MctpRequests, sizeof (mBmcSimulator.MctpRequests));
+  mBmcSimulator.MctpResponseHead         = 0;
+  mBmcSimulator.MctpResponseCount        = 0;
+  mBmcSimulator.EndpointId               = FixedPcdGet8 (PcdMctpDestinationEndpointId);
+  mBmcSimulator.Tid                      = 0;
+  mBmcSimulator.SmbiosTable              = NULL;
+  mBmcSimulator.SmbiosTableSize          = 0;
+  mBmcSimulator.SmbiosTableBufferSize    = 0;
+  mBmcSimulator.SmbiosTransferInProgress = FALSE;
+  mBmcSimulator.SmbiosNextTransferHandle = 0;
+  ZeroMem (&mBmcSimulator.SmbiosMetadata, sizeof (mBmcSimulator.SmbiosMetadata));
+}
+
+/**
+  This function answers an MCTP control request.
+
+  @param[in]   Request       MCTP control message.
+  @param[in]   RequestSize   Size of the message in byte.
+  @param[out]  Response      Buffer of BMC_SIMULATOR_RESPONSE_MAX bytes to receive
+                             the response.
+
+  @retval  0       The message is not a request, and isn't answered.
+  @retval  Others  Size of the response.
+**/
+STATIC
+UINT32
+BmcSimulatorMctpControlRequest (
+  IN  UINT8   *Request,
+  IN  UINT32  RequestSize,
+  OUT UINT8   *Response
+  )
+{
+  UINT8   Command;
+  UINT8   *Data;
+  UINT32  DataSize;
+  UINT32  ResponseSize;
+
+  if ((RequestSize < 2) || ((Request[0] & BMC_SIMULATOR_MCTP_CONTROL_REQUEST) == 0)) {
+    return 0;
+  }
+
+  mBmcSimulator.Statistics.MctpControlRequests++;
+  Command     = Request[1];
+  Data        = &Request[2];
+  DataSize    = RequestSize - 2;
+  Response[0] = Request[0] & BMC_SIMULATOR_MCTP_CONTROL_INSTANCE_MASK;
+  Response[1] = Command;
+
+  ResponseSize = BmcSimulatorScriptedResponse (BmcSimulatorMctpControl, 0, Command, &Response[2]);
+  if (ResponseSize != 0) {
+    return 2 + MIN (ResponseSize, BMC_SIMULATOR_RESPONSE_MAX - 2);
+  }
+
+  Response[2] = BMC_SIMULATOR_MCTP_CC_SUCCESS;
+  switch (Command) {
+    case BMC_SIMULATOR_MCTP_SET_ENDPOINT_ID:
+      if (DataSize != 2) {
+        Response[2] = BMC_SIMULATOR_MCTP_CC_ERROR_INVALID_LENGTH;
+        return 3;
+      }
+
+      if ((Data[1] == BMC_SIMULATOR_MCTP_NULL_ENDPOINT_ID) || (Data[1] == BMC_SIMULATOR_MCTP_BROADCAST_ENDPOINT_ID)) {
+        Response[2] = BMC_SIMULATOR_MCTP_CC_ERROR_INVALID_DATA;
+        return 3;
+      }
+
+      mBmcSimulator.EndpointId = Data[1];
+      Response[3]              = 0x00; // EID assignment accepted, no EID pool
+      Response[4]              = mBmcSimulator.EndpointId;
+      Response[5]              = 0x00;
+      return 6;
+
+    case BMC_SIMULATOR_MCTP_GET_ENDPOINT_ID:
+      Response[3] = mBmcSimulator.EndpointId;
+      Response[4] = 0x00; // Simple endpoint, dynamic EID
+      Response[5] = 0x00;
+      return 6;
+
+    case BMC_SIMULATOR_MCTP_GET_ENDPOINT_UUID:
+      CopyMem (&Response[3], mBmcSimulatorEndpointUuid, sizeof (mBmcSimulatorEndpointUuid));
+      return 3 + sizeof (mBmcSimulatorEndpointUuid);
+
+    case BMC_SIMULATOR_MCTP_GET_VERSION_SUPPORT:
+      if (DataSize != 1) {
+        Response[2] = BMC_SIMULATOR_MCTP_CC_ERROR_INVALID_LENGTH;
+        return 3;
+      }
+
+      //
+      // MCTP base specification 1.3.1 and message types 1.0.0.
+      //
+      Response[3] = 1;
+      if (Data[0] == 0xFF) {
+        Response[4] = 0xF1;
+        Response[5] = 0xF3;
+        Response[6] = 0xF1;
+        Response[7] = 0x00;
+      } else if ((Data[0] == BMC_SIMULATOR_MCTP_TYPE_CONTROL) || (Data[0] == MCTP_MESSAGE_TYPE_PLDM)) {
+        Response[4] = 0xF1;
+        Response[5] = 0xF0;
+        Response[6] = 0xF0;
+        Response[7] = 0x00;
+      } else {
+        Response[2] = BMC_SIMULATOR_MCTP_CC_TYPE_NOT_SUPPORTED;
+        return 3;
+      }
+
+      return 8;
+
+    case BMC_SIMULATOR_MCTP_GET_MESSAGE_TYPE:
+      Response[3] = 2;
+      Response[4] = BMC_SIMULATOR_MCTP_TYPE_CONTROL;
+      Response[5] = MCTP_MESSAGE_TYPE_PLDM;
+      return 6;
+
+    default:
+      DEBUG ((DEBUG_MANAGEABILITY_INFO, "%a: Unsupported MCTP control command 0x%x.\n", __func__, Command));
+      mBmcSimulator.Statistics.UnsupportedRequests++;
+      Response[2] = BMC_SIMULATOR_MCTP_CC_ERROR_UNSUPPORTED;
+      return 3;
+  }
+}
+
+/**
+  This function answers a PLDM messaging control and discovery command.
+
+  @param[in]   Command      PLDM command code.
+  @param[in]   Data         Request data, after the PLDM header.
+  @param[in]   DataSize     Size of the request data in byte.
+  @param[out]  Response     Buffer to receive the completion code and the
+                            response data.
+
+  @retval  Size of the response.
+**/
+STATIC
+UINT32
+BmcSimulatorPldmControl (
+  IN  UINT8   Command,
+  IN  UINT8   *Data,
+  IN  UINT32  DataSize,
+  OUT UINT8   *Response
+  )
+{
+  UINT32  Version;
+  UINT32  Crc32;
+
+  Response[0] = BMC_SIMULATOR_PLDM_CC_SUCCESS;
+  switch (Command) {
+    case BMC_SIMULATOR_PLDM_SET_TID:
+      if (DataSize != 1) {
+        Response[0] = BMC_SIMULATOR_PLDM_CC_ERROR_INVALID_LENGTH;
+        return 1;
+      }
+
+      mBmcSimulator.Tid = Data[0];
+      return 1;
+
+    case BMC_SIMULATOR_PLDM_GET_TID:
+      Response[1] = mBmcSimulator.Tid;
+      return 2;
+
+    case BMC_SIMULATOR_PLDM_GET_VERSION:
+      if (DataSize != 6) {
+        Response[0] = BMC_SIMULATOR_PLDM_CC_ERROR_INVALID_LENGTH;
+        return 1;
+      }
+
+      //
+      // Version 1.1.0 of messaging control and discovery, 1.0.0 of
+      // SMBIOS transfer, sent in one part with the CRC32 of the versions.
+      //
+      if (Data[5] == BMC_SIMULATOR_PLDM_TYPE_CONTROL) {
+        Version = 0xF1F1F000;
+      } else if (Data[5] == PLDM_TYPE_SMBIOS) {
+        Version = 0xF1F0F000;
+      } else {
+        Response[0] = BMC_SIMULATOR_PLDM_CC_INVALID_TYPE_IN_DATA;
+        return 1;
+      }
+
+      Crc32 = CalculateCrc32 (&Version, sizeof (Version));
+      ZeroMem (&Response[1], sizeof (UINT32));
+      Response[5] = PLDM_TRANSFER_FLAG_START_AND_END;
+      CopyMem (&Response[6], &Version, sizeof (Version));
+      CopyMem (&Response[10], &Crc32, sizeof (Crc32));
+      return 14;
+
+    case BMC_SIMULATOR_PLDM_GET_TYPES:
+      ZeroMem (&Response[1], 8);
+      Response[1] = (UINT8)(BIT0 | (1 << PLDM_TYPE_SMBIOS));
+      return 9;
+
+    case BMC_SIMULATOR_PLDM_GET_COMMANDS:
+      if (DataSize != 5) {
+        Response[0] = BMC_SIMULATOR_PLDM_CC_ERROR_INVALID_LENGTH;
+        return 1;
+      }
+
+      ZeroMem (&Response[1], 32);
+      if (Data[0] == BMC_SIMULATOR_PLDM_TYPE_CONTROL) {
+        Response[1] = BIT1 | BIT2 | BIT3 | BIT4 | BIT5;
+      } else if (Data[0] == PLDM_TYPE_SMBIOS) {
+        Response[1] = (UINT8)((1 << PLDM_GET_SMBIOS_STRUCTURE_TABLE_METADATA_COMMAND_CODE) |
+                              (1 << PLDM_SET_SMBIOS_STRUCTURE_TABLE_METADATA_COMMAND_CODE) |
+                              (1 << PLDM_SET_SMBIOS_STRUCTURE_TABLE_COMMAND_CODE));
+      } else {
+        Response[0] = BMC_SIMULATOR_PLDM_CC_INVALID_TYPE_IN_DATA;
+        return 1;
+      }
+
+      return 33;
+
+    default:
+      DEBUG ((DEBUG_MANAGEABILITY_INFO, "%a: Unsupported PLDM command 0x%x.\n", __func__, Command));
+      mBmcSimulator.Statistics.UnsupportedRequests++;
+      Response[0] = BMC_SIMULATOR_PLDM_CC_ERROR_UNSUPPORTED_CMD;
+      return 1;
+  }
+}
+
+/**
+  This function answers a PLDM SMBIOS transfer command.
+
+  @param[in]   Command      PLDM command code.
+  @param[in]   Data         Request data, after the PLDM header.
+  @param[in]   DataSize     Size of the request data in byte.
+  @param[out]  Response     Buffer to receive the completion code and the
+                            response data.
+
+  @retval  Size of the response.
+**/
+STATIC
+UINT32
+BmcSimulatorPldmSmbios (
+  IN  UINT8   Command,
+  IN  UINT8   *Data,
+  IN  UINT32  DataSize,
+  OUT UINT8   *Response
+  )
+{
+  UINT32  TransferHandle;
+  UINT8   TransferFlag;
+  UINT32  NewBufferSize;
+  UINT8   *NewBuffer;
+
+  Response[0] = BMC_SIMULATOR_PLDM_CC_SUCCESS;
+  switch (Command) {
+    case PLDM_GET_SMBIOS_STRUCTURE_TABLE_METADATA_COMMAND_CODE:
+      CopyMem (&Response[1], &mBmcSimulator.SmbiosMetadata, sizeof (mBmcSimulator.SmbiosMetadata));
+      return 1 + sizeof (mBmcSimulator.SmbiosMetadata);
+
+    case PLDM_SET_SMBIOS_STRUCTURE_TABLE_METADATA_COMMAND_CODE:
+      if (DataSize != sizeof (mBmcSimulator.SmbiosMetadata)) {
+        Response[0] = BMC_SIMULATOR_PLDM_CC_ERROR_INVALID_LENGTH;
+        return 1;
+      }
+
+      CopyMem (&mBmcSimulator.SmbiosMetadata, Data, sizeof (mBmcSimulator.SmbiosMetadata));
+      return 1;
+
+    case PLDM_SET_SMBIOS_STRUCTURE_TABLE_COMMAND_CODE:
+      if (DataSize < sizeof (UINT32) + 1) {
+        Response[0] = BMC_SIMULATOR_PLDM_CC_ERROR_INVALID_LENGTH;
+        return 1;
+      }
+
+      CopyMem (&TransferHandle, Data, sizeof (UINT32));
+      TransferFlag = Data[sizeof (UINT32)];
+      Data        += sizeof (UINT32) + 1;
+      DataSize    -= sizeof (UINT32) + 1;
+
+      //
+      // The first part restarts the transfer. The following parts must
+      // come with the transfer handle returned for the previous part.
+      //
+      if ((TransferFlag == PLDM_TRANSFER_FLAG_START) || (TransferFlag == PLDM_TRANSFER_FLAG_START_AND_END)) {
+        mBmcSimulator.SmbiosTableSize          = 0;
+        mBmcSimulator.SmbiosTransferInProgress = TRUE;
+      } else if ((TransferFlag != PLDM_TRANSFER_FLAG_MIDDLE) && (TransferFlag != PLDM_TRANSFER_FLAG_END)) {
+        Response[0] = BMC_SIMULATOR_PLDM_CC_INVALID_TRANSFER_FLAG;
+        return 1;
+      } else if (!mBmcSimulator.SmbiosTransferInProgress) {
+        Response[0] = BMC_SIMULATOR_PLDM_CC_INVALID_TRANSFER_FLAG;
+        return 1;
+      } else if (TransferHandle != mBmcSimulator.SmbiosNextTransferHandle) {
+        Response[0] = BMC_SIMULATOR_PLDM_CC_INVALID_TRANSFER_HANDLE;
+        return 1;
+      }
+
+      if (mBmcSimulator.SmbiosTableSize + DataSize > mBmcSimulator.SmbiosTableBufferSize) {
+        NewBufferSize = MAX (mBmcSimulator.SmbiosTableBufferSize * 2, mBmcSimulator.SmbiosTableSize + DataSize);
+        NewBuffer     = ReallocatePool (mBmcSimulator.SmbiosTableBufferSize, NewBufferSize, mBmcSimulator.SmbiosTable);
+        if (NewBuffer == NULL) {
+          mBmcSimulator.SmbiosTransferInProgress = FALSE;
+          Response[0]                            = BMC_SIMULATOR_PLDM_CC_ERROR;
+          return 1;
+        }
+
+        mBmcSimulator.SmbiosTable           = NewBuffer;
+        mBmcSimulator.SmbiosTableBufferSize = NewBufferSize;
+      }
+
+      CopyMem (mBmcSimulator.SmbiosTable + mBmcSimulator.SmbiosTableSize, Data, DataSize);
+      mBmcSimulator.SmbiosTableSize += DataSize;
+
+      //
+      // The transfer handle of the next part is where it goes in the table.
+      //
+      if ((TransferFlag == PLDM_TRANSFER_FLAG_END) || (TransferFlag == PLDM_TRANSFER_FLAG_START_AND_END)) {
+        mBmcSimulator.SmbiosTransferInProgress = FALSE;
+        mBmcSimulator.SmbiosNextTransferHandle = 0;
+      } else {
+        mBmcSimulator.SmbiosNextTransferHandle = mBmcSimulator.SmbiosTableSize;
+      }
+
+      CopyMem (&Response[1], &mBmcSimulator.SmbiosNextTransferHandle, sizeof (UINT32));
+      return 1 + sizeof (UINT32);
+
+    default:
+      DEBUG ((DEBUG_MANAGEABILITY_INFO, "%a: Unsupported PLDM SMBIOS command 0x%x.\n", __func__, Command));
+      mBmcSimulator.Statistics.UnsupportedRequests++;
+      Response[0] = BMC_SIMULATOR_PLDM_CC_ERROR_UNSUPPORTED_CMD;
+      return 1;
+  }
+}
+
+/**
+  This function answers a PLDM request.
+
+  @param[in]   Request       PLDM message with its PLDM header.
+  @param[in]   RequestSize   Size of the message in byte.
+  @param[out]  Response      Buffer of BMC_SIMULATOR_RESPONSE_MAX bytes to receive
+                             the PLDM response with its PLDM header.
+
+  @retval  0       The message is not a PLDM request, and isn't answered.
+  @retval  Others  Size of the response.
+**/
+UINT32
+BmcSimulatorPldmRequest (
+  IN  UINT8   *Request,
+  IN  UINT32  RequestSize,
+  OUT UINT8   *Response
+  )
+{
+  PLDM_REQUEST_HEADER   *RequestHeader;
+  PLDM_RESPONSE_HEADER  *ResponseHeader;
+  UINT8                 *Data;
+  UINT32                DataSize;
+  UINT32                ResponseSize;
+
+  RequestHeader = (PLDM_REQUEST_HEADER *)Request;
+  if ((RequestSize < sizeof (PLDM_REQUEST_HEADER)) || (RequestHeader->RequestBit != PLDM_MESSAGE_HEADER_IS_REQUEST)) {
+    return 0;
+  }
+
+  mBmcSimulator.Statistics.PldmRequests++;
+  ResponseHeader = (PLDM_RESPONSE_HEADER *)Response;
+  CopyMem (&ResponseHeader->PldmHeader, RequestHeader, sizeof (PLDM_REQUEST_HEADER));
+  ResponseHeader->PldmHeader.RequestBit  = 0;
+  ResponseHeader->PldmHeader.DatagramBit = 0;
+
+  Data     = Request + sizeof (PLDM_REQUEST_HEADER);
+  DataSize = RequestSize - sizeof (PLDM_REQUEST_HEADER);
+
+  ResponseSize = BmcSimulatorScriptedResponse (
+                   BmcSimulatorPldm,
+                   RequestHeader->PldmType,
+                   RequestHeader->PldmTypeCommandCode,
+                   &ResponseHeader->PldmCompletionCode
+                   );
+  if (ResponseSize != 0) {
+    return sizeof (PLDM_REQUEST_HEADER) + MIN (ResponseSize, BMC_SIMULATOR_RESPONSE_MAX - sizeof (PLDM_REQUEST_HEADER));
+  }
+
+  if (RequestHeader->PldmType == BMC_SIMULATOR_PLDM_TYPE_CONTROL) {
+    ResponseSize = BmcSimulatorPldmControl (RequestHeader->PldmTypeCommandCode, Data, DataSize, &ResponseHeader->PldmCompletionCode);
+  } else if (RequestHeader->PldmType == PLDM_TYPE_SMBIOS) {
+    ResponseSize = BmcSimulatorPldmSmbios (RequestHeader->PldmTypeCommandCode, Data, DataSize, &ResponseHeader->PldmCompletionCode);
+  } else {
+    DEBUG ((DEBUG_MANAGEABILITY_INFO, "%a: Unsupported PLDM type 0x%x.\n", __func__, RequestHeader->PldmType));
+    mBmcSimulator.Statistics.UnsupportedRequests++;
+    ResponseHeader->PldmCompletionCode = BMC_SIMULATOR_PLDM_CC_ERROR_INVALID_TYPE;
+    ResponseSize                       = 1;
+  }
+
+  return sizeof (PLDM_REQUEST_HEADER) + ResponseSize;
+}
+
+/**
+  This function answers a complete MCTP request message, and queues
+  the response to be read by the host.
+
+  @param[in]  MessageTag  Message tag of the request.
+  @param[in]  Request     The request.
+**/
+STATIC
+VOID
+BmcSimulatorMctpAnswer (
+  IN UINT8                       MessageTag,
+  IN BMC_SIMULATOR_MCTP_REQUEST  *Request
+  )
+{
+  UINTN                        Index;
+  BMC_SIMULATOR_MCTP_RESPONSE  *Response;
+
+  if (mBmcSimulator.MctpResponseCount == BMC_SIMULATOR_MCTP_MESSAGE_TAGS) {
+    DEBUG ((DEBUG_ERROR, "%a: Drop MCTP request of tag %d, too many responses not read.\n", __func__, MessageTag));
+    mBmcSimulator.Statistics.DroppedPackets++;
+    return;
+  }
+
+  Index    = (mBmcSimulator.MctpResponseHead + mBmcSimulator.MctpResponseCount) % BMC_SIMULATOR_MCTP_MESSAGE_TAGS;
+  Response = &mBmcSimulator.MctpResponses[Index];
+  if (Request->MessageType == BMC_SIMULATOR_MCTP_TYPE_CONTROL) {
+    Response->MessageSize = BmcSimulatorMctpControlRequest (Request->Message, Request->MessageSize, Response->Message);
+  } else if (Request->MessageType == MCTP_MESSAGE_TYPE_PLDM) {
+    Response->MessageSize = BmcSimulatorPldmRequest (Request->Message, Request->MessageSize, Response->Message);
+  } else {
+    Response->MessageSize = 0;
+  }
+
+  //
+  // Messages of unsupported types aren't answered.
+  //
+  if (Response->MessageSize == 0) {
+    DEBUG ((DEBUG_MANAGEABILITY_INFO, "%a: No response to MCTP message type 0x%x.\n", __func__, Request->MessageType));
+    mBmcSimulator.Statistics.UnsupportedRequests++;
+    return;
+  }
+
+  Response->SourceEndpointId      = Request->DestinationEndpointId;
+  Response->DestinationEndpointId = Request->SourceEndpointId;
+  Response->MessageTag            = MessageTag;
+  Response->MessageType           = Request->MessageType;
+  Response->PacketSequence        = 0;
+  Response->Offset                = 0;
+  mBmcSimulator.MctpResponseCount++;
+}
+
+/**
+  This function receives an MCTP over KCS packet from the host.
+  The responses of complete request messages are queued to be
+  read by BmcSimulatorMctpReadPacket.
+
+  @param[in]  Packet      The packet, with its KCS header and PEC.
+  @param[in]  PacketSize  Size of the packet in byte.
+**/
+VOID
+BmcSimulatorMctpWritePacket (
+  IN UINT8   *Packet,
+  IN UINT32  PacketSize
+  )
+{
+  BMC_SIMULATOR_MCTP_PACKET_HEADER  *Header;
+  BMC_SIMULATOR_MCTP_REQUEST        *Request;
+  UINT8                             *Payload;
+  UINT32                            PayloadSize;
+  UINT8                             DestinationEndpointId;
+  UINT8                             MessageTag;
+  UINT8                             PacketSequence;
+  UINT32                            NewBufferSize;
+  UINT8                             *NewBuffer;
+
+  mBmcSimulator.Statistics.MctpPackets++;
+  Header = (BMC_SIMULATOR_MCTP_PACKET_HEADER *)Packet;
+  if ((PacketSize < sizeof (MANAGEABILITY_MCTP_KCS_HEADER) + sizeof (MCTP_TRANSPORT_HEADER) + 1) ||
+      (Header->KcsHeader.NetFunc != MCTP_KCS_NETFN_LUN) ||
+      (Header->KcsHeader.DefiningBody != DEFINING_BODY_DMTF_PRE_OS_WORKING_GROUP) ||
+      (Header->KcsHeader.ByteCount != PacketSize - sizeof (MANAGEABILITY_MCTP_KCS_HEADER) - 1) ||
+      (HelperManageabilityGenerateCrc8 (
+         MCTP_KCS_PACKET_ERROR_CODE_POLY,
+         0,
+         (UINT8 *)&Header->TransportHeader,
+         Header->KcsHeader.ByteCount
+         ) != Packet[PacketSize - 1]))
+  {
+    DEBUG ((DEBUG_ERROR, "%a: Drop malformed MCTP packet of size 0x%x.\n", __func__, PacketSize));
+    mBmcSimulator.Statistics.DroppedPackets++;
+    return;
+  }
+
+  DestinationEndpointId = (UINT8)Header->TransportHeader.Bits.DestinationEndpointId;
+  if ((Header->TransportHeader.Bits.TagOwner != MCTP_MESSAGE_TAG_OWNER_REQUEST) ||
+      ((DestinationEndpointId != mBmcSimulator.EndpointId) &&
+       (DestinationEndpointId != BMC_SIMULATOR_MCTP_NULL_ENDPOINT_ID) &&
+       (DestinationEndpointId != BMC_SIMULATOR_MCTP_BROADCAST_ENDPOINT_ID)))
+  {
+    DEBUG ((DEBUG_ERROR, "%a: Drop MCTP packet not requested to EID %d.\n", __func__, mBmcSimulator.EndpointId));
+    mBmcSimulator.Statistics.DroppedPackets++;
+    return;
+  }
+
+  MessageTag     = (UINT8)Header->TransportHeader.Bits.MessageTag;
+  PacketSequence = (UINT8)Header->TransportHeader.Bits.PacketSequence;
+  Request        = &mBmcSimulator.MctpRequests[MessageTag];
+  Payload        = (UINT8 *)(&Header->TransportHeader + 1);
+  PayloadSize    = Header->KcsHeader.ByteCount - sizeof (MCTP_TRANSPORT_HEADER);
+
+  if (Header->TransportHeader.Bits.StartOfMessage != 0) {
+    if (PayloadSize < sizeof (MCTP_MESSAGE_HEADER)) {
+      DEBUG ((DEBUG_ERROR, "%a: Drop MCTP packet without message header.\n", __func__));
+      mBmcSimulator.Statistics.DroppedPackets++;
+      return;
+    }
+
+    Request->InUse                 = TRUE;
+    Request->SourceEndpointId      = (UINT8)Header->TransportHeader.Bits.SourceEndpointIdId;
+    Request->DestinationEndpointId = DestinationEndpointId;
+    Request->MessageType           = (UINT8)Header->MessageHeader.Bits.MessageType;
+    Request->NextPacketSequence    = PacketSequence;
+    Request->MessageSize           = 0;
+    Payload                       += sizeof (MCTP_MESSAGE_HEADER);
+    PayloadSize                   -= sizeof (MCTP_MESSAGE_HEADER);
+  } else if (!Request->InUse) {
+    DEBUG ((DEBUG_ERROR, "%a: Drop MCTP packet before the start of message, tag %d.\n", __func__, MessageTag));
+    mBmcSimulator.Statistics.DroppedPackets++;
+    return;
+  }
+
+  if (PacketSequence != Request->NextPacketSequence) {
+    DEBUG ((DEBUG_ERROR, "%a: Drop MCTP message of tag %d, packets lost.\n", __func__, MessageTag));
+    mBmcSimulator.Statistics.DroppedPackets++;
+    Request->InUse = FALSE;
+    return;
+  }
+
+  Request->NextPacketSequence = (PacketSequence + 1) & MCTP_PACKET_SEQUENCE_MASK;
+  if (Request->MessageSize + PayloadSize > Request->MessageBufferSize) {
+    NewBufferSize = MAX (Request->MessageBufferSize * 2, Request->MessageSize + PayloadSize);
+    NewBuffer     = ReallocatePool (Request->MessageBufferSize, NewBufferSize, Request->Message);
+    if (NewBuffer == NULL) {
+      DEBUG ((DEBUG_ERROR, "%a: Not enough resource to reassemble MCTP message.\n", __func__));
+      Request->InUse = FALSE;
+      return;
+    }
+
+    Request->Message           = NewBuffer;
+    Request->MessageBufferSize = NewBufferSize;
+  }
+
+  CopyMem (Request->Message + Request->MessageSize, Payload, PayloadSize);
+  Request->MessageSize += PayloadSize;
+
+  if (Header->TransportHeader.Bits.EndOfMessage != 0) {
+    Request->InUse = FALSE;
+    BmcSimulatorMctpAnswer (MessageTag, Request);
+  }
+}
+
+/**
+  This function returns the next MCTP over KCS packet of the
+  queued responses.
+
+  @param[out]     Packet      Buffer to receive the packet.
+  @param[in,out]  PacketSize  Size of the buffer in byte, and the size of
+                              the packet on return.
+
+  @retval  EFI_SUCCESS           The packet is returned.
+  @retval  EFI_TIMEOUT           There is no response to read.
+  @retval  EFI_BUFFER_TOO_SMALL  The packet doesn't fit in the buffer.
+**/
+EFI_STATUS
+BmcSimulatorMctpReadPacket (
+  OUT    UINT8   *Packet,
+  IN OUT UINT32  *PacketSize
+  )
+{
+  BMC_SIMULATOR_MCTP_RESPONSE       *Response;
+  BMC_SIMULATOR_MCTP_PACKET_HEADER  *Header;
+  UINT32                            MctpHeaderSize;
+  UINT32                            FragmentSize;
+  BOOLEAN                           StartOfMessage;
+  BOOLEAN                           EndOfMessage;
+
+  if (mBmcSimulator.MctpResponseCount == 0) {
+    return EFI_TIMEOUT;
+  }
+
+  Response       = &mBmcSimulator.MctpResponses[mBmcSimulator.MctpResponseHead];
+  StartOfMessage = (BOOLEAN)(Response->Offset == 0);
+  FragmentSize   = MIN (Response->MessageSize - Response->Offset, BMC_SIMULATOR_MCTP_PACKET_PAYLOAD);
+  EndOfMessage   = (BOOLEAN)(Response->Offset + FragmentSize == Response->MessageSize);
+  MctpHeaderSize = sizeof (MCTP_TRANSPORT_HEADER);
+  if (StartOfMessage) {
+    MctpHeaderSize += sizeof (MCTP_MESSAGE_HEADER);
+  }
+
+  if (*PacketSize < sizeof (MANAGEABILITY_MCTP_KCS_HEADER) + MctpHeaderSize + FragmentSize + 1) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  Header = (BMC_SIMULATOR_MCTP_PACKET_HEADER *)Packet;
+  ZeroMem (Header, sizeof (MANAGEABILITY_MCTP_KCS_HEADER) + MctpHeaderSize);
+  Header->KcsHeader.NetFunc      = BMC_SIMULATOR_MCTP_KCS_NETFN_LUN_RESPONSE;
+  Header->KcsHeader.DefiningBody = DEFINING_BODY_DMTF_PRE_OS_WORKING_GROUP;
+  Header->KcsHeader.ByteCount    = (UINT8)(MctpHeaderSize + FragmentSize);
+
+  Header->TransportHeader.Bits.HeaderVersion         = MCTP_KCS_HEADER_VERSION;
+  Header->TransportHeader.Bits.DestinationEndpointId = Response->DestinationEndpointId;
+  Header->TransportHeader.Bits.SourceEndpointIdId    = Response->SourceEndpointId;
+  Header->TransportHeader.Bits.MessageTag            = Response->MessageTag;
+  Header->TransportHeader.Bits.TagOwner              = MCTP_MESSAGE_TAG_OWNER_RESPONSE;
+  Header->TransportHeader.Bits.PacketSequence        = Response->PacketSequence;
+  Header->TransportHeader.Bits.StartOfMessage        = StartOfMessage ? 1 : 0;
+  Header->TransportHeader.Bits.EndOfMessage          = EndOfMessage ? 1 : 0;
+  if (StartOfMessage) {
+    Header->MessageHeader.Bits.MessageType = Response->MessageType;
+  }
+
+  CopyMem ((UINT8 *)&Header->TransportHeader + MctpHeaderSize, Response->Message + Response->Offset, FragmentSize);
+
+  //
+  // PEC over the MCTP headers and the fragment, follow SMBUS 2.0 specification.
+  //
+  *PacketSize         = sizeof (MANAGEABILITY_MCTP_KCS_HEADER) + MctpHeaderSize + FragmentSize;
+  Packet[*PacketSize] = HelperManageabilityGenerateCrc8 (
+                          MCTP_KCS_PACKET_ERROR_CODE_POLY,
+                          0,
+                          (UINT8 *)&Header->TransportHeader,
+                          MctpHeaderSize + FragmentSize
+                          );
+  *PacketSize += 1;
+
+  Response->Offset        += FragmentSize;
+  Response->PacketSequence = (Response->PacketSequence + 1) & MCTP_PACKET_SEQUENCE_MASK;
+  if (EndOfMessage) {
+    mBmcSimulator.MctpResponseHead = (mBmcSimulator.MctpResponseHead + 1) % BMC_SIMULATOR_MCTP_MESSAGE_TAGS;
+    mBmcSimulator.MctpResponseCount--;
+  }
+
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,722 @@
+/** @file
+
+  BMC simulator instance of Manageability Transport Library
+
+  The transport is answered by an in-memory BMC model instead of a BMC,
+  so the IPMI, MCTP and PLDM stacks can run without the hardware. It
+  presents itself as the KCS transport to the IPMI and MCTP stacks and as
+  the MCTP transport to the PLDM stack. Each module linked with this
+  library has its own BMC model.
+
+  Copyright (C) 2023 Advanced Micro Devices, Inc. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
+#include <Library/TimerLib.h>
+#include <Library/ManageabilityTransportLib.h>
+#include <Library/ManageabilityTransportIpmiLib.h>
+#include <Library/ManageabilityTransportHelperLib.h>
+
+#include "ManageabilityTransportBmcSimulator.h"
+
+EFI_GUID  *SupportedManageabilityProtocol[] = {
+  &gManageabilityProtocolIpmiGuid,
+  &gManageabilityProtocolMctpGuid,
+  &gManageabilityProtocolPldmGuid
+};
+
+UINT8  NumberOfSupportedProtocol = (sizeof (SupportedManageabilityProtocol)/sizeof (EFI_GUID *));
+
+BMC_SIMULATOR  mBmcSimulator;
+
+/**
+  This function makes sure the BMC model is initialized.
+**/
+VOID
+BmcSimulatorInitialize (
+  VOID
+  )
+{
+  if (!mBmcSimulator.Initialized) {
+    BmcSimulatorReset ();
+  }
+}
+
+/**
+  This function looks up the scripted response of a command.
+
+  @param[in]   Kind          Kind of the message.
+  @param[in]   Group         IPMI NetFn or PLDM type of the command.
+  @param[in]   Command       Command code.
+  @param[out]  Response      Buffer of BMC_SIMULATOR_RESPONSE_MAX bytes to receive
+                             the response.
+
+  @retval  0       The command has no scripted response.
+  @retval  Others  Size of the response.
+**/
+UINT32
+BmcSimulatorScriptedResponse (
+  IN  BMC_SIMULATOR_MESSAGE_KIND  Kind,
+  IN  UINT8                       Group,
+  IN  UINT8                       Command,
+  OUT UINT8                       *Response
+  )
+{
+  UINTN                            Index;
+  BMC_SIMULATOR_SCRIPTED_RESPONSE  *Scripted;
+
+  for (Index = 0; Index < BMC_SIMULATOR_SCRIPTED_ENTRIES; Index++) {
+    Scripted = &mBmcSimulator.Scripted[Index];
+    if (Scripted->InUse && (Scripted->Kind == Kind) &&
+        (Scripted->Group == Group) && (Scripted->Command == Command))
+    {
+      CopyMem (Response, Scripted->Response, Scripted->ResponseSize);
+      mBmcSimulator.Statistics.ScriptedResponses++;
+      return Scripted->ResponseSize;
+    }
+  }
+
+  return 0;
+}
+
+/**
+  This function scripts the response of a command, which then overrides
+  the response of the BMC model.
+
+  @param[in]  Kind          Kind of the message.
+  @param[in]  Group         IPMI NetFn or PLDM type of the command, see
+                            BMC_SIMULATOR_MESSAGE_KIND.
+  @param[in]  Command       Command code.
+  @param[in]  Response      Response starting with the completion code, without
+                            the IPMI, MCTP control or PLDM message header.
+                            NULL removes the scripted response of the command.
+  @param[in]  ResponseSize  Size of Response in byte.
+
+  @retval  EFI_SUCCESS            The response is scripted or removed.
+  @retval  EFI_INVALID_PARAMETER  Kind is invalid, or ResponseSize is 0 or larger
+                                  than BMC_SIMULATOR_RESPONSE_MAX.
+  @retval  EFI_OUT_OF_RESOURCES   Too many responses are scripted.
+  @retval  EFI_NOT_FOUND          Response is NULL and the command has no
+                                  scripted response.
+**/
+EFI_STATUS
+BmcSimulatorSetResponse (
+  IN BMC_SIMULATOR_MESSAGE_KIND  Kind,
+  IN UINT8                       Group,
+  IN UINT8                       Command,
+  IN CONST UINT8                 *Response OPTIONAL,
+  IN UINT32                      ResponseSize
+  )
+{
+  UINTN                            Index;
+  BMC_SIMULATOR_SCRIPTED_RESPONSE  *Scripted;
+  BMC_SIMULATOR_SCRIPTED_RESPONSE  *Free;
+
+  if ((Kind >= BmcSimulatorMessageKindMax) ||
+      ((Response != NULL) && ((ResponseSize == 0) || (ResponseSize > BMC_SIMULATOR_RESPONSE_MAX))))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  BmcSimulatorInitialize ();
+  if (Kind == BmcSimulatorMctpControl) {
+    Group = 0;
+  }
+
+  Free = NULL;
+  for (Index = 0; Index < BMC_SIMULATOR_SCRIPTED_ENTRIES; Index++) {
+    Scripted = &mBmcSimulator.Scripted[Index];
+    if (!Scripted->InUse) {
+      if (Free == NULL) {
+        Free = Scripted;
+      }
+
+      continue;
+    }
+
+    if ((Scripted->Kind == Kind) && (Scripted->Group == Group) && (Scripted->Command == Command)) {
+      break;
+    }
+  }
+
+  if (Index == BMC_SIMULATOR_SCRIPTED_ENTRIES) {
+    if (Response == NULL) {
+      return EFI_NOT_FOUND;
+    }
+
+    if (Free == NULL) {
+      DEBUG ((DEBUG_ERROR, "%a: No room for more scripted responses.\n", __func__));
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    Scripted = Free;
+  }
+
+  if (Response == NULL) {
+    Scripted->InUse = FALSE;
+    return EFI_SUCCESS;
+  }
+
+  Scripted->InUse        = TRUE;
+  Scripted->Kind         = Kind;
+  Scripted->Group        = Group;
+  Scripted->Command      = Command;
+  Scripted->ResponseSize = ResponseSize;
+  CopyMem (Scripted->Response, Response, ResponseSize);
+  return EFI_SUCCESS;
+}
+
+/**
+  This function sets the time the BMC model takes to answer a request.
+
+  @param[in]  LatencyInMicrosecond  Latency of each request in microseconds.
+**/
+VOID
+BmcSimulatorSetLatency (
+  IN UINT32  LatencyInMicrosecond
+  )
+{
+  BmcSimulatorInitialize ();
+  mBmcSimulator.LatencyInMicrosecond = LatencyInMicrosecond;
+}
+
+/**
+  This function returns the statistics of the requests the BMC model
+  answered since it was reset.
+
+  @param[out]  Statistics  Pointer to receive the statistics.
+**/
+VOID
+BmcSimulatorGetStatistics (
+  OUT BMC_SIMULATOR_STATISTICS  *Statistics
+  )
+{
+  BmcSimulatorInitialize ();
+  CopyMem (Statistics, &mBmcSimulator.Statistics, sizeof (BMC_SIMULATOR_STATISTICS));
+}
+
+/**
+  This function resets the BMC model to its power on state. The scripted
+  responses, the statistics and the MCTP packets not read yet are
+  discarded and the latency is set back to PcdBmcSimulatorLatency.
+**/
+VOID
+BmcSimulatorReset (
+  VOID
+  )
+{
+  if (mBmcSimulator.Initialized) {
+    BmcSimulatorMctpReset ();
+  }
+
+  ZeroMem (&mBmcSimulator, sizeof (BMC_SIMULATOR));
+  mBmcSimulator.Initialized          = TRUE;
+  mBmcSimulator.LatencyInMicrosecond = FixedPcdGet32 (PcdBmcSimulatorLatency);
+  BmcSimulatorIpmiReset ();
+  BmcSimulatorMctpReset ();
+}
+
+/**
+  This function waits for the latency of the BMC model.
+**/
+STATIC
+VOID
+BmcSimulatorDelay (
+  VOID
+  )
+{
+  if (mBmcSimulator.LatencyInMicrosecond != 0) {
+    MicroSecondDelay (mBmcSimulator.LatencyInMicrosecond);
+  }
+}
+
+/**
+  This function initializes the transport interface.
+
+  @param [in]  TransportToken           The transport token acquired through
+                                        AcquireTransportSession function.
+  @param [in]  HardwareInfo             The hardware information
+                                        assigned to the transport interface,
+                                        which is ignored.
+
+  @retval      EFI_SUCCESS              Transport interface is initialized
+                                        successfully.
+  @retval      EFI_INVALID_PARAMETER    The invalid transport token.
+
+**/
+EFI_STATUS
+EFIAPI
+BmcSimulatorTransportInit (
+  IN  MANAGEABILITY_TRANSPORT_TOKEN                 *TransportToken,
+  IN  MANAGEABILITY_TRANSPORT_HARDWARE_INFORMATION  HardwareInfo OPTIONAL
+  )
+{
+  if (TransportToken == NULL) {
+    DEBUG ((DEBUG_ERROR, "%a: Invalid transport token.\n", __func__));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  BmcSimulatorInitialize ();
+  DEBUG ((
+    DEBUG_MANAGEABILITY_INFO,
+    "%a: BMC simulator for %s, latency %d us.\n",
+    __func__,
+    HelperManageabilitySpecName (TransportToken->ManageabilityProtocolSpecification),
+    mBmcSimulator.LatencyInMicrosecond
+    ));
+  return EFI_SUCCESS;
+}
+
+/**
+  This function returns the transport interface status.
+  The BMC model is always idle.
+
+  @param [in]   TransportToken             The transport token acquired through
+                                           AcquireTransportSession function.
+  @param [out]  TransportAdditionalStatus  The additional status of transport
+                                           interface.
+                                           NULL means no additional status of this
+                                           transport interface.
+
+  @retval      EFI_SUCCESS              Transport interface status is returned.
+  @retval      EFI_INVALID_PARAMETER    The invalid transport token.
+
+**/
+EFI_STATUS
+EFIAPI
+BmcSimulatorTransportStatus (
+  IN  MANAGEABILITY_TRANSPORT_TOKEN              *TransportToken,
+  OUT MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS  *TransportAdditionalStatus OPTIONAL
+  )
+{
+  if (TransportToken == NULL) {
+    DEBUG ((DEBUG_ERROR, "%a: Invalid transport token.\n", __func__));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (TransportAdditionalStatus != NULL) {
+    *TransportAdditionalStatus = MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS_NO_ERRORS;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  This function resets the transport interface, which discards
+  the MCTP packets not read yet.
+
+  @param [in]   TransportToken             The transport token acquired through
+                                           AcquireTransportSession function.
+  @param [out]  TransportAdditionalStatus  The additional status of specific transport
+                                           interface after the reset.
+                                           NULL means no additional status of this
+                                           transport interface.
+
+  @retval      EFI_SUCCESS              Transport interface is reset.
+  @retval      EFI_INVALID_PARAMETER    The invalid transport token.
+
+**/
+EFI_STATUS
+EFIAPI
+BmcSimulatorTransportReset (
+  IN  MANAGEABILITY_TRANSPORT_TOKEN              *TransportToken,
+  OUT MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS  *TransportAdditionalStatus OPTIONAL
+  )
+{
+  if (TransportToken == NULL) {
+    DEBUG ((DEBUG_ERROR, "%a: Invalid transport token.\n", __func__));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  BmcSimulatorInitialize ();
+  mBmcSimulator.MctpResponseHead  = 0;
+  mBmcSimulator.MctpResponseCount = 0;
+  if (TransportAdditionalStatus != NULL) {
+    *TransportAdditionalStatus = MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS_NO_ERRORS;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  This function transmits an IPMI request to the BMC model and
+  returns the response.
+
+  @param [in]  TransferToken            The transfer token.
+**/
+STATIC
+VOID
+BmcSimulatorTransmitReceiveIpmi (
+  IN  MANAGEABILITY_TRANSFER_TOKEN  *TransferToken
+  )
+{
+  MANAGEABILITY_IPMI_TRANSPORT_HEADER  *IpmiHeader;
+  UINT8                                Response[BMC_SIMULATOR_RESPONSE_MAX];
+  UINT32                               ResponseSize;
+
+  if ((TransferToken->TransmitHeader == NULL) ||
+      (TransferToken->TransmitHeaderSize < sizeof (MANAGEABILITY_IPMI_TRANSPORT_HEADER)))
+  {
+    TransferToken->ReceivePackage.ReceiveSizeInByte = 0;
+    TransferToken->TransferStatus                   = EFI_TIMEOUT;
+    return;
+  }
+
+  IpmiHeader   = (MANAGEABILITY_IPMI_TRANSPORT_HEADER *)TransferToken->TransmitHeader;
+  ResponseSize = BmcSimulatorIpmiRequest (
+                   IpmiHeader->NetFn,
+                   IpmiHeader->Command,
+                   TransferToken->TransmitPackage.TransmitPayload,
+                   TransferToken->TransmitPackage.TransmitSizeInByte,
+                   Response
+                   );
+  BmcSimulatorDelay ();
+
+  if (TransferToken->ReceivePackage.ReceiveBuffer == NULL) {
+    TransferToken->ReceivePackage.ReceiveSizeInByte = 0;
+  } else {
+    //
+    // Like the KCS transport, the response is cut to the size the caller
+    // expects, which is checked by the caller.
+    //
+    if (ResponseSize < TransferToken->ReceivePackage.ReceiveSizeInByte) {
+      TransferToken->ReceivePackage.ReceiveSizeInByte = ResponseSize;
+    }
+
+    CopyMem (
+      TransferToken->ReceivePackage.ReceiveBuffer,
+      Response,
+      TransferToken->ReceivePackage.ReceiveSizeInByte
+      );
+  }
+
+  TransferToken->TransferStatus = EFI_SUCCESS;
+}
+
+/**
+  This function transmits an MCTP over KCS packet to the BMC model,
+  or receives the next packet of its responses if there is nothing
+  to transmit.
+
+  @param [in]  TransferToken            The transfer token.
+**/
+STATIC
+VOID
+BmcSimulatorTransmitReceiveMctp (
+  IN  MANAGEABILITY_TRANSFER_TOKEN  *TransferToken
+  )
+{
+  UINT8   Packet[BMC_SIMULATOR_MCTP_PACKET_MAX];
+  UINT32  PacketSize;
+  UINT8   ResponsesBefore;
+
+  if ((TransferToken->TransmitHeader == NULL) && (TransferToken->TransmitPackage.TransmitPayload == NULL)) {
+    if (TransferToken->ReceivePackage.ReceiveBuffer == NULL) {
+      TransferToken->ReceivePackage.ReceiveSizeInByte = 0;
+      TransferToken->TransferStatus                   = EFI_INVALID_PARAMETER;
+      return;
+    }
+
+    TransferToken->TransferStatus = BmcSimulatorMctpReadPacket (
+                                      TransferToken->ReceivePackage.ReceiveBuffer,
+                                      &TransferToken->ReceivePackage.ReceiveSizeInByte
+                                      );
+    if (EFI_ERROR (TransferToken->TransferStatus)) {
+      TransferToken->ReceivePackage.ReceiveSizeInByte = 0;
+    }
+
+    return;
+  }
+
+  PacketSize = (UINT32)TransferToken->TransmitHeaderSize +
+               TransferToken->TransmitPackage.TransmitSizeInByte +
+               TransferToken->TransmitTrailerSize;
+  if (PacketSize > sizeof (Packet)) {
+    DEBUG ((DEBUG_ERROR, "%a: MCTP packet of size 0x%x is too large.\n", __func__, PacketSize));
+    TransferToken->ReceivePackage.ReceiveSizeInByte = 0;
+    TransferToken->TransferStatus                   = EFI_INVALID_PARAMETER;
+    return;
+  }
+
+  PacketSize = 0;
+  if (TransferToken->TransmitHeader != NULL) {
+    CopyMem (Packet, TransferToken->TransmitHeader, TransferToken->TransmitHeaderSize);
+    PacketSize += TransferToken->TransmitHeaderSize;
+  }
+
+  if (TransferToken->TransmitPackage.TransmitPayload != NULL) {
+    CopyMem (
+      Packet + PacketSize,
+      TransferToken->TransmitPackage.TransmitPayload,
+      TransferToken->TransmitPackage.TransmitSizeInByte
+      );
+    PacketSize += TransferToken->TransmitPackage.TransmitSizeInByte;
+  }
+
+  if (TransferToken->TransmitTrailer != NULL) {
+    CopyMem (Packet + PacketSize, TransferToken->TransmitTrailer, TransferToken->TransmitTrailerSize);
+    PacketSize += TransferToken->TransmitTrailerSize;
+  }
+
+  ResponsesBefore = mBmcSimulator.MctpResponseCount;
+  BmcSimulatorMctpWritePacket (Packet, PacketSize);
+  if (mBmcSimulator.MctpResponseCount != ResponsesBefore) {
+    BmcSimulatorDelay ();
+  }
+
+  //
+  // The responses are read by the following receive only transfers.
+  //
+  TransferToken->ReceivePackage.ReceiveSizeInByte = 0;
+  TransferToken->TransferStatus                   = EFI_SUCCESS;
+}
+
+/**
+  This function transmits a PLDM request to the BMC model and
+  returns the response.
+
+  @param [in]  TransferToken            The transfer token.
+**/
+STATIC
+VOID
+BmcSimulatorTransmitReceivePldm (
+  IN  MANAGEABILITY_TRANSFER_TOKEN  *TransferToken
+  )
+{
+  UINT8   Response[BMC_SIMULATOR_RESPONSE_MAX];
+  UINT32  ResponseSize;
+
+  ResponseSize = 0;
+  if (TransferToken->TransmitPackage.TransmitPayload != NULL) {
+    ResponseSize = BmcSimulatorPldmRequest (
+                     TransferToken->TransmitPackage.TransmitPayload,
+                     TransferToken->TransmitPackage.TransmitSizeInByte,
+                     Response
+                     );
+  }
+
+  if (ResponseSize == 0) {
+    TransferToken->ReceivePackage.ReceiveSizeInByte = 0;
+    TransferToken->TransferStatus                   = EFI_TIMEOUT;
+    return;
+  }
+
+  BmcSimulatorDelay ();
+  if ((TransferToken->ReceivePackage.ReceiveBuffer == NULL) ||
+      (ResponseSize > TransferToken->ReceivePackage.ReceiveSizeInByte))
+  {
+    TransferToken->ReceivePackage.ReceiveSizeInByte = 0;
+    TransferToken->TransferStatus                   = EFI_BUFFER_TOO_SMALL;
+    return;
+  }
+
+  CopyMem (TransferToken->ReceivePackage.ReceiveBuffer, Response, ResponseSize);
+  TransferToken->ReceivePackage.ReceiveSizeInByte = ResponseSize;
+  TransferToken->TransferStatus                   = EFI_SUCCESS;
+}
+
+/**
+  This function transmit the request over target transport interface.
+  The generic EFI_STATUS is returned to caller directly after reseting transport
+  interface. The additional information of transport interface could be optionally
+  returned in TransportAdditionalStatus to describes the status that can't be
+  described obviously through EFI_STATUS.
+  See the definition of MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS.
+
+  @param [in]  TransportToken           The transport token acquired through
+                                        AcquireTransportSession function.
+  @param [in]  TransferToken            The transfer token, see the definition of
+                                        MANAGEABILITY_TRANSFER_TOKEN.
+
+  @retval      The EFI status is returned in MANAGEABILITY_TRANSFER_TOKEN.
+
+**/
+VOID
+EFIAPI
+BmcSimulatorTransportTransmitReceive (
+  IN  MANAGEABILITY_TRANSPORT_TOKEN  *TransportToken,
+  IN  MANAGEABILITY_TRANSFER_TOKEN   *TransferToken
+  )
+{
+  if ((TransportToken == NULL) || (TransferToken == NULL)) {
+    DEBUG ((DEBUG_ERROR, "%a: Invalid transport token or transfer token.\n", __func__));
+    return;
+  }
+
+  BmcSimulatorInitialize ();
+  if (CompareGuid (TransportToken->ManageabilityProtocolSpecification, &gManageabilityProtocolIpmiGuid)) {
+    BmcSimulatorTransmitReceiveIpmi (TransferToken);
+  } else if (CompareGuid (TransportToken->ManageabilityProtocolSpecification, &gManageabilityProtocolMctpGuid)) {
+    BmcSimulatorTransmitReceiveMctp (TransferToken);
+  } else {
+    BmcSimulatorTransmitReceivePldm (TransferToken);
+  }
+
+  TransferToken->TransportAdditionalStatus = MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS_NO_ERRORS;
+}
+
+/**
+  This function acquires to create a transport session to transmit manageability
+  packet. A transport token is returned to caller for the follow up operations.
+
+  @param [in]   ManageabilityProtocolSpec  The protocol spec the transport interface is acquired.
+  @param [out]  TransportToken             The pointer to receive the transport token created by
+                                           the target transport interface library.
+  @retval       EFI_SUCCESS                Token is created successfully.
+  @retval       EFI_OUT_OF_RESOURCES       Out of resource to create a new transport session.
+  @retval       EFI_UNSUPPORTED            Protocol is not supported on this transport interface.
+  @retval       Otherwise                  Other errors.
+
+**/
+EFI_STATUS
+AcquireTransportSession (
+  IN  EFI_GUID                       *ManageabilityProtocolSpec,
+  OUT MANAGEABILITY_TRANSPORT_TOKEN  **TransportToken
+  )
+{
+  EFI_STATUS                             Status;
+  EFI_GUID                               *TransportSpec;
+  CHAR16                                 *TransportName;
+  MANAGEABILITY_TRANSPORT_BMC_SIMULATOR  *SimulatorToken;
+
+  if (ManageabilityProtocolSpec == NULL) {
+    DEBUG ((DEBUG_ERROR, "%a: No Manageability protocol specification specified.\n", __func__));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (TransportToken == NULL) {
+    DEBUG ((DEBUG_ERROR, "%a: TransportToken is NULL.\n", __func__));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // The IPMI and MCTP stacks build their packets for KCS, and the PLDM
+  // stack for MCTP, so the simulator presents itself as that transport.
+  //
+  if (CompareGuid (ManageabilityProtocolSpec, &gManageabilityProtocolPldmGuid)) {
+    TransportSpec = &gManageabilityTransportMctpGuid;
+    TransportName = L"MCTP simulator";
+  } else {
+    TransportSpec = &gManageabilityTransportKcsGuid;
+    TransportName = L"KCS simulator";
+  }
+
+  Status = HelperManageabilityCheckSupportedSpec (
+             TransportSpec,
+             SupportedManageabilityProtocol,
+             NumberOfSupportedProtocol,
+             ManageabilityProtocolSpec
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: Protocol is not supported on this transport interface.\n", __func__));
+    return EFI_UNSUPPORTED;
+  }
+
+  SimulatorToken = AllocateZeroPool (sizeof (MANAGEABILITY_TRANSPORT_BMC_SIMULATOR));
+  if (SimulatorToken == NULL) {
+    DEBUG ((DEBUG_ERROR, "%a: Fail to allocate memory for MANAGEABILITY_TRANSPORT_BMC_SIMULATOR\n", __func__));
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  SimulatorToken->Token.Transport = AllocateZeroPool (sizeof (MANAGEABILITY_TRANSPORT));
+  if (SimulatorToken->Token.Transport == NULL) {
+    FreePool (SimulatorToken);
+    DEBUG ((DEBUG_ERROR, "%a: Fail to allocate memory for MANAGEABILITY_TRANSPORT\n", __func__));
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  SimulatorToken->Token.Transport->Function.Version1_0 = AllocateZeroPool (sizeof (MANAGEABILITY_TRANSPORT_FUNCTION_V1_0));
+  if (SimulatorToken->Token.Transport->Function.Version1_0 == NULL) {
+    DEBUG ((DEBUG_ERROR, "%a: Fail to allocate memory for MANAGEABILITY_TRANSPORT_FUNCTION_V1_0\n", __func__));
+    FreePool (SimulatorToken->Token.Transport);
+    FreePool (SimulatorToken);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  SimulatorToken->Signature                                            = MANAGEABILITY_TRANSPORT_BMC_SIMULATOR_SIGNATURE;
+  SimulatorToken->Token.ManageabilityProtocolSpecification             = ManageabilityProtocolSpec;
+  SimulatorToken->Token.Transport->TransportVersion                    = MANAGEABILITY_TRANSPORT_TOKEN_VERSION;
+  SimulatorToken->Token.Transport->ManageabilityTransportSpecification = TransportSpec;
+  SimulatorToken->Token.Transport->TransportName                       = TransportName;
+
+  SimulatorToken->Token.Transport->Function.Version1_0->TransportInit            = BmcSimulatorTransportInit;
+  SimulatorToken->Token.Transport->Function.Version1_0->TransportReset           = BmcSimulatorTransportReset;
+  SimulatorToken->Token.Transport->Function.Version1_0->TransportStatus          = BmcSimulatorTransportStatus;
+  SimulatorToken->Token.Transport->Function.Version1_0->TransportTransmitReceive = BmcSimulatorTransportTransmitReceive;
+
+  BmcSimulatorInitialize ();
+  *TransportToken = &SimulatorToken->Token;
+  return EFI_SUCCESS;
+}
+
+/**
+  This function returns the transport capabilities according to
+  the manageability protocol.
+
+  @param [in]   TransportToken             Transport token acquired from manageability
+                                           transport library.
+  @param [out]  TransportFeature           Pointer to receive transport capabilities.
+                                           See the definitions of
+                                           MANAGEABILITY_TRANSPORT_CAPABILITY.
+  @retval       EFI_SUCCESS                TransportCapability is returned successfully.
+  @retval       EFI_INVALID_PARAMETER      TransportToken is not a valid token.
+**/
+EFI_STATUS
+GetTransportCapability (
+  IN MANAGEABILITY_TRANSPORT_TOKEN        *TransportToken,
+  OUT MANAGEABILITY_TRANSPORT_CAPABILITY  *TransportCapability
+  )
+{
+  if ((TransportToken == NULL) || (TransportCapability == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  *TransportCapability = 0;
+  if (CompareGuid (
+        TransportToken->ManageabilityProtocolSpecification,
+        &gManageabilityProtocolMctpGuid
+        ))
+  {
+    *TransportCapability |=
+      (MCTP_KCS_MTU_IN_POWER_OF_2 << MANAGEABILITY_TRANSPORT_CAPABILITY_MAXIMUM_PAYLOAD_BIT_POSITION);
+  } else {
+    *TransportCapability |=
+      (MANAGEABILITY_TRANSPORT_CAPABILITY_MAXIMUM_PAYLOAD_NOT_AVAILABLE << MANAGEABILITY_TRANSPORT_CAPABILITY_MAXIMUM_PAYLOAD_BIT_POSITION);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  This function releases the manageability session.
+
+  @param [in]  TransportToken         The transport token acquired through
+                                      AcquireTransportSession.
+  @retval      EFI_SUCCESS            Token is released successfully.
+  @retval      EFI_INVALID_PARAMETER  Invalid TransportToken.
+
+**/
+EFI_STATUS
+ReleaseTransportSession (
+  IN MANAGEABILITY_TRANSPORT_TOKEN  *TransportToken
+  )
+{
+  MANAGEABILITY_TRANSPORT_BMC_SIMULATOR  *SimulatorToken;
+
+  if (TransportToken == NULL) {
+    DEBUG ((DEBUG_ERROR, "%a: Invalid transport token.\n", __func__));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  SimulatorToken = MANAGEABILITY_TRANSPORT_BMC_SIMULATOR_FROM_LINK (TransportToken);
+  FreePool (SimulatorToken->Token.Transport->Function.Version1_0);
+  FreePool (SimulatorToken->Token.Transport);
+  FreePool (SimulatorToken);
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,333 @@
+/** @file
+
+  Manageability transport BMC simulator internal used definitions.
+
+  Copyright (C) 2023 Advanced Micro Devices, Inc. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef MANAGEABILITY_TRANSPORT_BMC_SIMULATOR_H_
+#define MANAGEABILITY_TRANSPORT_BMC_SIMULATOR_H_
+
+#include <IndustryStandard/Mctp.h>
+#include <IndustryStandard/PldmSmbiosTransfer.h>
+#include <Library/ManageabilityTransportLib.h>
+#include <Library/ManageabilityTransportBmcSimulatorLib.h>
+#include <Library/ManageabilityTransportMctpLib.h>
+
+#define MANAGEABILITY_TRANSPORT_BMC_SIMULATOR_SIGNATURE  SIGNATURE_32 ('M', 'T', 'B', 'S')
+
+///
+/// Manageability transport BMC simulator internal data structure.
+///
+typedef struct {
+  UINTN                            Signature;
+  MANAGEABILITY_TRANSPORT_TOKEN    Token;
+} MANAGEABILITY_TRANSPORT_BMC_SIMULATOR;
+
+#define MANAGEABILITY_TRANSPORT_BMC_SIMULATOR_FROM_LINK(a)  CR (a, MANAGEABILITY_TRANSPORT_BMC_SIMULATOR, Token, MANAGEABILITY_TRANSPORT_BMC_SIMULATOR_SIGNATURE)
+
+///
+/// Same MTU as the KCS transport, so the MCTP packets are the same size.
+///
+#define MCTP_KCS_MTU_IN_POWER_OF_2  8
+
+///
+/// Sizes of the IPMI storage of the BMC model.
+///
+#define BMC_SIMULATOR_SEL_ENTRIES       64
+#define BMC_SIMULATOR_SEL_ENTRY_SIZE    16
+#define BMC_SIMULATOR_FRU_SIZE          256
+#define BMC_SIMULATOR_SCRIPTED_ENTRIES  16
+
+///
+/// Largest MCTP packet over KCS: KCS header, up to MAX_UINT8 bytes and PEC.
+///
+#define BMC_SIMULATOR_MCTP_PACKET_MAX  (sizeof (MANAGEABILITY_MCTP_KCS_HEADER) + MAX_UINT8 + 1)
+
+///
+/// Payload of each MCTP response packet, the MCTP baseline transmission unit.
+///
+#define BMC_SIMULATOR_MCTP_PACKET_PAYLOAD  64
+
+///
+/// MCTP message tags, and the MCTP responses the BMC model can hold
+/// before they are read.
+///
+#define BMC_SIMULATOR_MCTP_MESSAGE_TAGS  8
+
+///
+/// NetFn/LUN of the MCTP over KCS responses.
+///
+#define BMC_SIMULATOR_MCTP_KCS_NETFN_LUN_RESPONSE  (MCTP_KCS_NETFN_LUN | BIT2)
+
+///
+/// Message type and control commands of the MCTP base specification DSP0236.
+///
+#define BMC_SIMULATOR_MCTP_TYPE_CONTROL           0x00
+#define BMC_SIMULATOR_MCTP_SET_ENDPOINT_ID        0x01
+#define BMC_SIMULATOR_MCTP_GET_ENDPOINT_ID        0x02
+#define BMC_SIMULATOR_MCTP_GET_ENDPOINT_UUID      0x03
+#define BMC_SIMULATOR_MCTP_GET_VERSION_SUPPORT    0x04
+#define BMC_SIMULATOR_MCTP_GET_MESSAGE_TYPE       0x05
+#define BMC_SIMULATOR_MCTP_CONTROL_REQUEST        BIT7
+#define BMC_SIMULATOR_MCTP_CONTROL_INSTANCE_MASK  0x1F
+#define BMC_SIMULATOR_MCTP_NULL_ENDPOINT_ID       0x00
+#define BMC_SIMULATOR_MCTP_BROADCAST_ENDPOINT_ID  0xFF
+
+#define BMC_SIMULATOR_MCTP_CC_SUCCESS               0x00
+#define BMC_SIMULATOR_MCTP_CC_ERROR_INVALID_DATA    0x02
+#define BMC_SIMULATOR_MCTP_CC_ERROR_INVALID_LENGTH  0x03
+#define BMC_SIMULATOR_MCTP_CC_ERROR_UNSUPPORTED     0x05
+#define BMC_SIMULATOR_MCTP_CC_TYPE_NOT_SUPPORTED    0x80
+
+///
+/// PLDM messaging control and discovery commands of DSP0240.
+///
+#define BMC_SIMULATOR_PLDM_TYPE_CONTROL  0x00
+#define BMC_SIMULATOR_PLDM_SET_TID       0x01
+#define BMC_SIMULATOR_PLDM_GET_TID       0x02
+#define BMC_SIMULATOR_PLDM_GET_VERSION   0x03
+#define BMC_SIMULATOR_PLDM_GET_TYPES     0x04
+#define BMC_SIMULATOR_PLDM_GET_COMMANDS  0x05
+
+#define BMC_SIMULATOR_PLDM_CC_SUCCESS                0x00
+#define BMC_SIMULATOR_PLDM_CC_ERROR                  0x01
+#define BMC_SIMULATOR_PLDM_CC_ERROR_INVALID_DATA     0x02
+#define BMC_SIMULATOR_PLDM_CC_ERROR_INVALID_LENGTH   0x03
+#define BMC_SIMULATOR_PLDM_CC_ERROR_UNSUPPORTED_CMD  0x05
+#define BMC_SIMULATOR_PLDM_CC_ERROR_INVALID_TYPE     0x20
+#define BMC_SIMULATOR_PLDM_CC_INVALID_TYPE_IN_DATA   0x83
+
+///
+/// Completion codes of the SMBIOS transfer commands of DSP0246.
+///
+#define BMC_SIMULATOR_PLDM_CC_INVALID_TRANSFER_HANDLE  0x80
+#define BMC_SIMULATOR_PLDM_CC_INVALID_TRANSFER_FLAG    0x82
+
+#pragma pack(1)
+
+///
+/// Headers of an MCTP over KCS packet. MessageHeader is only
+/// present in the first packet of a message.
+///
+typedef struct {
+  MANAGEABILITY_MCTP_KCS_HEADER    KcsHeader;
+  MCTP_TRANSPORT_HEADER            TransportHeader;
+  MCTP_MESSAGE_HEADER              MessageHeader;
+} BMC_SIMULATOR_MCTP_PACKET_HEADER;
+
+#pragma pack()
+
+///
+/// A scripted response.
+///
+typedef struct {
+  BOOLEAN                       InUse;
+  BMC_SIMULATOR_MESSAGE_KIND    Kind;
+  UINT8                         Group;
+  UINT8                         Command;
+  UINT32                        ResponseSize;
+  UINT8                         Response[BMC_SIMULATOR_RESPONSE_MAX];
+} BMC_SIMULATOR_SCRIPTED_RESPONSE;
+
+///
+/// An MCTP request message being reassembled, by its message tag.
+///
+typedef struct {
+  BOOLEAN    InUse;
+  UINT8      SourceEndpointId;
+  UINT8      DestinationEndpointId;
+  UINT8      MessageType;
+  UINT8      NextPacketSequence;
+  UINT8      *Message;            ///< Message body, without the message header.
+  UINT32     MessageSize;
+  UINT32     MessageBufferSize;
+} BMC_SIMULATOR_MCTP_REQUEST;
+
+///
+/// An MCTP response message waiting to be read by the host,
+/// one packet at a time.
+///
+typedef struct {
+  UINT8     SourceEndpointId;
+  UINT8     DestinationEndpointId;
+  UINT8     MessageTag;
+  UINT8     MessageType;
+  UINT8     PacketSequence;
+  UINT32    Offset;               ///< Bytes of Message already sent.
+  UINT32    MessageSize;
+  UINT8     Message[BMC_SIMULATOR_RESPONSE_MAX];
+} BMC_SIMULATOR_MCTP_RESPONSE;
+
+///
+/// State of the BMC model.
+///
+typedef struct {
+  BOOLEAN                                 Initialized;
+  UINT32                                  LatencyInMicrosecond;
+  BMC_SIMULATOR_STATISTICS                Statistics;
+  BMC_SIMULATOR_SCRIPTED_RESPONSE         Scripted[BMC_SIMULATOR_SCRIPTED_ENTRIES];
+
+  //
+  // IPMI watchdog timer.
+  //
+  BOOLEAN                                 WatchdogInitialized;
+  UINT8                                   WatchdogTimerUse;
+  UINT8                                   WatchdogTimerActions;
+  UINT8                                   WatchdogPreTimeoutInterval;
+  UINT8                                   WatchdogExpirationFlags;
+  UINT16                                  WatchdogInitialCountdown;
+  UINT16                                  WatchdogPresentCountdown;
+
+  //
+  // IPMI SEL and FRU. The BMC model has no clock, the SEL time
+  // stamps count the SEL operations instead.
+  //
+  UINT16                                  SelReservationId;
+  UINT16                                  SelEntryCount;
+  UINT32                                  SelTimestamp;
+  UINT32                                  SelAddTimestamp;
+  UINT32                                  SelEraseTimestamp;
+  UINT8                                   Sel[BMC_SIMULATOR_SEL_ENTRIES][BMC_SIMULATOR_SEL_ENTRY_SIZE];
+  UINT8                                   Fru[BMC_SIMULATOR_FRU_SIZE];
+
+  //
+  // MCTP endpoint.
+  //
+  UINT8                                   EndpointId;
+  BMC_SIMULATOR_MCTP_REQUEST              MctpRequests[BMC_SIMULATOR_MCTP_MESSAGE_TAGS];
+  BMC_SIMULATOR_MCTP_RESPONSE             MctpResponses[BMC_SIMULATOR_MCTP_MESSAGE_TAGS];
+  UINT8                                   MctpResponseHead;
+  UINT8                                   MctpResponseCount;
+
+  //
+  // PLDM terminus and SMBIOS table.
+  //
+  UINT8                                   Tid;
+  PLDM_SMBIOS_STRUCTURE_TABLE_METADATA    SmbiosMetadata;
+  UINT8                                   *SmbiosTable;
+  UINT32                                  SmbiosTableSize;
+  UINT32                                  SmbiosTableBufferSize;
+  BOOLEAN                                 SmbiosTransferInProgress;
+  UINT32                                  SmbiosNextTransferHandle;
+} BMC_SIMULATOR;
+
+extern BMC_SIMULATOR  mBmcSimulator;
+
+/**
+  This function makes sure the BMC model is initialized.
+**/
+VOID
+BmcSimulatorInitialize (
+  VOID
+  );
+
+/**
+  This function looks up the scripted response of a command.
+
+  @param[in]   Kind          Kind of the message.
+  @param[in]   Group         IPMI NetFn or PLDM type of the command.
+  @param[in]   Command       Command code.
+  @param[out]  Response      Buffer of BMC_SIMULATOR_RESPONSE_MAX bytes to receive
+                             the response.
+
+  @retval  0       The command has no scripted response.
+  @retval  Others  Size of the response.
+**/
+UINT32
+BmcSimulatorScriptedResponse (
+  IN  BMC_SIMULATOR_MESSAGE_KIND  Kind,
+  IN  UINT8                       Group,
+  IN  UINT8                       Command,
+  OUT UINT8                       *Response
+  );
+
+/**
+  This function resets the IPMI state of the BMC model.
+**/
+VOID
+BmcSimulatorIpmiReset (
+  VOID
+  );
+
+/**
+  This function answers an IPMI request.
+
+  @param[in]   NetFn        NetFn of the request.
+  @param[in]   Command      Command of the request.
+  @param[in]   Request      Request data.
+  @param[in]   RequestSize  Size of request data in byte.
+  @param[out]  Response     Buffer of BMC_SIMULATOR_RESPONSE_MAX bytes to receive
+                            the completion code and the response data.
+
+  @retval  Size of the response.
+**/
+UINT32
+BmcSimulatorIpmiRequest (
+  IN  UINT8   NetFn,
+  IN  UINT8   Command,
+  IN  UINT8   *Request OPTIONAL,
+  IN  UINT32  RequestSize,
+  OUT UINT8   *Response
+  );
+
+/**
+  This function resets the MCTP and PLDM state of the BMC model.
+**/
+VOID
+BmcSimulatorMctpReset (
+  VOID
+  );
+
+/**
+  This function answers a PLDM request.
+
+  @param[in]   Request       PLDM message with its PLDM header.
+  @param[in]   RequestSize   Size of the message in byte.
+  @param[out]  Response      Buffer of BMC_SIMULATOR_RESPONSE_MAX bytes to receive
+                             the PLDM response with its PLDM header.
+
+  @retval  0       The message is not a PLDM request, and isn't answered.
+  @retval  Others  Size of the response.
+**/
+UINT32
+BmcSimulatorPldmRequest (
+  IN  UINT8   *Request,
+  IN  UINT32  RequestSize,
+  OUT UINT8   *Response
+  );
+
+/**
+  This function receives an MCTP over KCS packet from the host.
+  The responses of complete request messages are queued to be
+  read by BmcSimulatorMctpReadPacket.
+
+  @param[in]  Packet      The packet, with its KCS header and PEC.
+  @param[in]  PacketSize  Size of the packet in byte.
+**/
+VOID
+BmcSimulatorMctpWritePacket (
+  IN UINT8   *Packet,
+  IN UINT32  PacketSize
+  );
+
+/**
+  This function returns the next MCTP over KCS packet of the
+  queued responses.
+
+  @param[out]     Packet      Buffer to receive the packet.
+  @param[in,out]  PacketSize  Size of the buffer in byte, and the size of
+                              the packet on return.
+
+  @retval  EFI_SUCCESS           The packet is returned.
+  @retval  EFI_TIMEOUT           There is no response to read.
+  @retval  EFI_BUFFER_TOO_SMALL  The packet doesn't fit in the buffer.
+**/
+EFI_STATUS
+BmcSimulatorMctpReadPacket (
+  OUT    UINT8   *Packet,
+  IN OUT UINT32  *PacketSize
+  );
+
+#endif // MANAGEABILITY_TRANSPORT_BMC_SIMULATOR_H_
@@ -0,0 +1,247 @@
+/** @file
+  CRC8 of Manageability Transport Helper Library
+
+  The CRC8 of the SMBus/MCTP PEC polynomial is computed four bytes at a time
+  with slicing tables, which the compiler generates from the polynomial.
+  Other polynomials are computed bit by bit.
+
+  Copyright (C) 2023 Advanced Micro Devices, Inc. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <Uefi.h>
+#include <Library/ManageabilityTransportHelperLib.h>
+#include <Library/ManageabilityTransportMctpLib.h>
+
+//
+// Polynomial of the CRC8 tables, without bit 8.
+//
+#define CRC8_TABLE_POLYNOMIAL  MCTP_KCS_PACKET_ERROR_CODE_POLY
+
+//
+// One step of the bitwise CRC8, as a constant expression.
+//
+#define CRC8_STEP(Crc)  ((((Crc) << 1) ^ ((((Crc) >> 7) & 1) * CRC8_TABLE_POLYNOMIAL)) & 0xff)
+
+//
+// CRC8 is linear, so the CRC of a byte is the XOR of the CRCs of its set bits.
+// CRC8_BIT_n is the CRC of bit (n % 8) of a byte followed by (n / 8) zero bytes,
+// that is x^(n + 8) modulo the polynomial. Each is one step from the previous.
+//
+enum {
+  CRC8_BIT_0  = CRC8_TABLE_POLYNOMIAL,
+  CRC8_BIT_1  = CRC8_STEP (CRC8_BIT_0),
+  CRC8_BIT_2  = CRC8_STEP (CRC8_BIT_1),
+  CRC8_BIT_3  = CRC8_STEP (CRC8_BIT_2),
+  CRC8_BIT_4  = CRC8_STEP (CRC8_BIT_3),
+  CRC8_BIT_5  = CRC8_STEP (CRC8_BIT_4),
+  CRC8_BIT_6  = CRC8_STEP (CRC8_BIT_5),
+  CRC8_BIT_7  = CRC8_STEP (CRC8_BIT_6),
+  CRC8_BIT_8  = CRC8_STEP (CRC8_BIT_7),
+  CRC8_BIT_9  = CRC8_STEP (CRC8_BIT_8),
+  CRC8_BIT_10 = CRC8_STEP (CRC8_BIT_9),
+  CRC8_BIT_11 = CRC8_STEP (CRC8_BIT_10),
+  CRC8_BIT_12 = CRC8_STEP (CRC8_BIT_11),
+  CRC8_BIT_13 = CRC8_STEP (CRC8_BIT_12),
+  CRC8_BIT_14 = CRC8_STEP (CRC8_BIT_13),
+  CRC8_BIT_15 = CRC8_STEP (CRC8_BIT_14),
+  CRC8_BIT_16 = CRC8_STEP (CRC8_BIT_15),
+  CRC8_BIT_17 = CRC8_STEP (CRC8_BIT_16),
+  CRC8_BIT_18 = CRC8_STEP (CRC8_BIT_17),
+  CRC8_BIT_19 = CRC8_STEP (CRC8_BIT_18),
+  CRC8_BIT_20 = CRC8_STEP (CRC8_BIT_19),
+  CRC8_BIT_21 = CRC8_STEP (CRC8_BIT_20),
+  CRC8_BIT_22 = CRC8_STEP (CRC8_BIT_21),
+  CRC8_BIT_23 = CRC8_STEP (CRC8_BIT_22),
+  CRC8_BIT_24 = CRC8_STEP (CRC8_BIT_23),
+  CRC8_BIT_25 = CRC8_STEP (CRC8_BIT_24),
+  CRC8_BIT_26 = CRC8_STEP (CRC8_BIT_25),
+  CRC8_BIT_27 = CRC8_STEP (CRC8_BIT_26),
+  CRC8_BIT_28 = CRC8_STEP (CRC8_BIT_27),
+  CRC8_BIT_29 = CRC8_STEP (CRC8_BIT_28),
+  CRC8_BIT_30 = CRC8_STEP (CRC8_BIT_29),
+  CRC8_BIT_31 = CRC8_STEP (CRC8_BIT_30)
+};
+
+//
+// Entry Index of slicing table Slice, which is the CRC of byte Index
+// followed by Slice zero bytes.
+//
+#define CRC8_BIT(Index, Bit, Crc)  ((((Index) >> (Bit)) & 1) * (Crc))
+#define CRC8_ENTRY(Slice, Index)                                  \
+  (UINT8)(CRC8_BIT (Index, 0, CRC8_BIT_ ## Slice ## _0) ^         \
+          CRC8_BIT (Index, 1, CRC8_BIT_ ## Slice ## _1) ^         \
+          CRC8_BIT (Index, 2, CRC8_BIT_ ## Slice ## _2) ^         \
+          CRC8_BIT (Index, 3, CRC8_BIT_ ## Slice ## _3) ^         \
+          CRC8_BIT (Index, 4, CRC8_BIT_ ## Slice ## _4) ^         \
+          CRC8_BIT (Index, 5, CRC8_BIT_ ## Slice ## _5) ^         \
+          CRC8_BIT (Index, 6, CRC8_BIT_ ## Slice ## _6) ^         \
+          CRC8_BIT (Index, 7, CRC8_BIT_ ## Slice ## _7))
+
+//
+// The bits of each slice, so they can be pasted with the slice number.
+//
+#define CRC8_BIT_0_0  CRC8_BIT_0
+#define CRC8_BIT_0_1  CRC8_BIT_1
+#define CRC8_BIT_0_2  CRC8_BIT_2
+#define CRC8_BIT_0_3  CRC8_BIT_3
+#define CRC8_BIT_0_4  CRC8_BIT_4
+#define CRC8_BIT_0_5  CRC8_BIT_5
+#define CRC8_BIT_0_6  CRC8_BIT_6
+#define CRC8_BIT_0_7  CRC8_BIT_7
+#define CRC8_BIT_1_0  CRC8_BIT_8
+#define CRC8_BIT_1_1  CRC8_BIT_9
+#define CRC8_BIT_1_2  CRC8_BIT_10
+#define CRC8_BIT_1_3  CRC8_BIT_11
+#define CRC8_BIT_1_4  CRC8_BIT_12
+#define CRC8_BIT_1_5  CRC8_BIT_13
+#define CRC8_BIT_1_6  CRC8_BIT_14
+#define CRC8_BIT_1_7  CRC8_BIT_15
+#define CRC8_BIT_2_0  CRC8_BIT_16
+#define CRC8_BIT_2_1  CRC8_BIT_17
+#define CRC8_BIT_2_2  CRC8_BIT_18
+#define CRC8_BIT_2_3  CRC8_BIT_19
+#define CRC8_BIT_2_4  CRC8_BIT_20
+#define CRC8_BIT_2_5  CRC8_BIT_21
+#define CRC8_BIT_2_6  CRC8_BIT_22
+#define CRC8_BIT_2_7  CRC8_BIT_23
+#define CRC8_BIT_3_0  CRC8_BIT_24
+#define CRC8_BIT_3_1  CRC8_BIT_25
+#define CRC8_BIT_3_2  CRC8_BIT_26
+#define CRC8_BIT_3_3  CRC8_BIT_27
+#define CRC8_BIT_3_4  CRC8_BIT_28
+#define CRC8_BIT_3_5  CRC8_BIT_29
+#define CRC8_BIT_3_6  CRC8_BIT_30
+#define CRC8_BIT_3_7  CRC8_BIT_31
+
+#define CRC8_ENTRIES_4(Slice, Index)                              \
+  CRC8_ENTRY (Slice, (Index)), CRC8_ENTRY (Slice, (Index) + 1),   \
+  CRC8_ENTRY (Slice, (Index) + 2), CRC8_ENTRY (Slice, (Index) + 3)
+#define CRC8_ENTRIES_16(Slice, Index)                                   \
+  CRC8_ENTRIES_4 (Slice, (Index)), CRC8_ENTRIES_4 (Slice, (Index) + 4), \
+  CRC8_ENTRIES_4 (Slice, (Index) + 8), CRC8_ENTRIES_4 (Slice, (Index) + 12)
+#define CRC8_ENTRIES_64(Slice, Index)                                      \
+  CRC8_ENTRIES_16 (Slice, (Index)), CRC8_ENTRIES_16 (Slice, (Index) + 16), \
+  CRC8_ENTRIES_16 (Slice, (Index) + 32), CRC8_ENTRIES_16 (Slice, (Index) + 48)
+#define CRC8_TABLE(Slice)                                     \
+  {                                                           \
+    CRC8_ENTRIES_64 (Slice, 0), CRC8_ENTRIES_64 (Slice, 64),    \
+    CRC8_ENTRIES_64 (Slice, 128), CRC8_ENTRIES_64 (Slice, 192)  \
+  }
+
+//
+// mCrc8Table[0] is the byte-at-a-time table; mCrc8Table[Slice] with
+// Slice > 0 is the CRC of the byte followed by Slice zero bytes.
+//
+GLOBAL_REMOVE_IF_UNREFERENCED CONST UINT8  mCrc8Table[4][256] = {
+  CRC8_TABLE (0),
+  CRC8_TABLE (1),
+  CRC8_TABLE (2),
+  CRC8_TABLE (3)
+};
+
+/**
+  This function generates CRC8 with given polynomial bit by bit.
+
+  @param[in]  Polynomial       Polynomial in 8-bit.
+  @param[in]  CrcInitialValue  CRC initial value.
+  @param[in]  BufferStart      Pointer to buffer starts the CRC calculation.
+  @param[in]  BufferSize       Size of buffer.
+
+  @retval  UINT8 CRC value.
+**/
+STATIC
+UINT8
+Crc8Bitwise (
+  IN UINT8   Polynomial,
+  IN UINT8   CrcInitialValue,
+  IN UINT8   *BufferStart,
+  IN UINT32  BufferSize
+  )
+{
+  UINT8   BitIndex;
+  UINT32  BufferIndex;
+
+  BufferIndex = 0;
+  while (BufferIndex < BufferSize) {
+    CrcInitialValue = CrcInitialValue ^ *(BufferStart + BufferIndex);
+    BufferIndex++;
+
+    for (BitIndex = 0; BitIndex < 8; BitIndex++) {
+      if ((CrcInitialValue & 0x80) != 0) {
+        CrcInitialValue = (CrcInitialValue << 1) ^ Polynomial;
+      } else {
+        CrcInitialValue <<= 1;
+      }
+    }
+  }
+
+  return CrcInitialValue;
+}
+
+/**
+  This function generates CRC8 of CRC8_TABLE_POLYNOMIAL with the slicing
+  tables, four bytes at a time.
+
+  Only the first byte of each four depends on the CRC so far, so the four
+  lookups can be done in parallel.
+
+  @param[in]  CrcInitialValue  CRC initial value.
+  @param[in]  BufferStart      Pointer to buffer starts the CRC calculation.
+  @param[in]  BufferSize       Size of buffer.
+
+  @retval  UINT8 CRC value.
+**/
+STATIC
+UINT8
+Crc8Sliced (
+  IN UINT8   CrcInitialValue,
+  IN UINT8   *BufferStart,
+  IN UINT32  BufferSize
+  )
+{
+  UINT8  Crc;
+
+  Crc = CrcInitialValue;
+  while (BufferSize >= 4) {
+    Crc = mCrc8Table[3][Crc ^ BufferStart[0]] ^
+          mCrc8Table[2][BufferStart[1]] ^
+          mCrc8Table[1][BufferStart[2]] ^
+          mCrc8Table[0][BufferStart[3]];
+    BufferStart += 4;
+    BufferSize  -= 4;
+  }
+
+  while (BufferSize > 0) {
+    Crc = mCrc8Table[0][Crc ^ *BufferStart];
+    BufferStart++;
+    BufferSize--;
+  }
+
+  return Crc;
+}
+
+/**
+  This function generates CRC8 with given polynomial.
+
+  @param[in]  Polynomial       Polynomial in 8-bit.
+  @param[in]  CrcInitialValue  CRC initial value.
+  @param[in]  BufferStart      Pointer to buffer starts the CRC calculation.
+  @param[in]  BufferSize       Size of buffer.
+
+  @retval  UINT8 CRC value.
+**/
+UINT8
+HelperManageabilityGenerateCrc8 (
+  IN UINT8   Polynomial,
+  IN UINT8   CrcInitialValue,
+  IN UINT8   *BufferStart,
+  IN UINT32  BufferSize
+  )
+{
+  if (Polynomial == CRC8_TABLE_POLYNOMIAL) {
+    return Crc8Sliced (CrcInitialValue, BufferStart, BufferSize);
+  }
+
+  return Crc8Bitwise (Polynomial, CrcInitialValue, BufferStart, BufferSize);
+}
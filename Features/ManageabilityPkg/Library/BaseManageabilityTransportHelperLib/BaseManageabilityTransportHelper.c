@@ -262,44 +262,6 @@ HelperInitManageabilityTransport (
   return Status;
 }
 
-/**
-  This function generates CRC8 with given polynomial.
-
-  @param[in]  Polynomial       Polynomial in 8-bit.
-  @param[in]  CrcInitialValue  CRC initial value.
-  @param[in]  BufferStart      Pointer to buffer starts the CRC calculation.
-  @param[in]  BufferSize       Size of buffer.
-
-  @retval  UINT8 CRC value.
-**/
-UINT8
-HelperManageabilityGenerateCrc8 (
-  IN UINT8   Polynomial,
-  IN UINT8   CrcInitialValue,
-  IN UINT8   *BufferStart,
-  IN UINT32  BufferSize
-  )
-{
-  UINT8   BitIndex;
-  UINT32  BufferIndex;
-
-  BufferIndex = 0;
-  while (BufferIndex < BufferSize) {
-    CrcInitialValue = CrcInitialValue ^ *(BufferStart + BufferIndex);
-    BufferIndex++;
-
-    for (BitIndex = 0; BitIndex < 8; BitIndex++) {
-      if ((CrcInitialValue & 0x80) != 0) {
-        CrcInitialValue = (CrcInitialValue << 1) ^ Polynomial;
-      } else {
-        CrcInitialValue <<= 1;
-      }
-    }
-  }
-
-  return CrcInitialValue;
-}
-
 /**
   This function splits payload into multiple packages according to
   the given transport interface Maximum Transfer Unit (MTU).
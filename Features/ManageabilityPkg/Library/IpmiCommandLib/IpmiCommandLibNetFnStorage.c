@@ -232,6 +232,36 @@ IpmiPartialAddSelEntry (
   return Status;
 }
 
+/**
+  This function reserves the SEL for the operations that require
+  a reservation ID, like clearing the SEL.
+
+  @param [out] ReserveSelResponse    Pointer to receive IPMI_RESERVE_SEL_RESPONSE.
+
+  @retval EFI_STATUS   See the return values of IpmiSubmitCommand () function.
+
+**/
+EFI_STATUS
+EFIAPI
+IpmiReserveSel (
+  OUT IPMI_RESERVE_SEL_RESPONSE  *ReserveSelResponse
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      DataSize;
+
+  DataSize = sizeof (*ReserveSelResponse);
+  Status   = IpmiSubmitCommand (
+               IPMI_NETFN_STORAGE,
+               IPMI_STORAGE_RESERVE_SEL,
+               NULL,
+               0,
+               (VOID *)ReserveSelResponse,
+               &DataSize
+               );
+  return Status;
+}
+
 /**
   This function erases all contents of the System Event Log.
 
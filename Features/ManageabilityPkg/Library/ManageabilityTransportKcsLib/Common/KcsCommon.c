@@ -8,6 +8,7 @@
 **/
 #include <Uefi.h>
 #include <IndustryStandard/IpmiKcs.h>
+#include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/IoLib.h>
 #include <Library/DebugLib.h>
@@ -19,35 +20,147 @@
 
 extern MANAGEABILITY_TRANSPORT_KCS_HARDWARE_INFO  mKcsHardwareInfo;
 
+MANAGEABILITY_TRANSPORT_KCS_STATISTICS  mKcsStatistics;
+
+///
+/// Status register reads polled back to back before backing off,
+/// calibrated on the first wait.
+///
+STATIC UINT32  mKcsFastPollCount = 0;
+
 /**
-  This function waits for parameter Flag to set.
-  Checks status flag in every 1ms internal till 5 seconds elapses.
+  This function returns the time elapsed since a performance counter value.
+
+  @param[in]  StartTicks  Performance counter value to measure from.
+
+  @retval     UINT64      Elapsed time in nanoseconds, 0 if the
+                          performance counter isn't running.
+**/
+STATIC
+UINT64
+KcsElapsedTimeInNs (
+  IN UINT64  StartTicks
+  )
+{
+  UINT64  CurrentTicks;
+  UINT64  StartValue;
+  UINT64  EndValue;
+
+  CurrentTicks = GetPerformanceCounter ();
+  GetPerformanceCounterProperties (&StartValue, &EndValue);
+
+  // The counter may count down
+  if (StartValue > EndValue) {
+    return GetTimeInNanoSecond (StartTicks - CurrentTicks);
+  }
+
+  return GetTimeInNanoSecond (CurrentTicks - StartTicks);
+}
+
+/**
+  This function calibrates how many status register reads
+  fit in IPMI_KCS_FAST_POLL_WINDOW_US.
+**/
+STATIC
+VOID
+KcsCalibrateFastPoll (
+  VOID
+  )
+{
+  UINT64  StartTicks;
+  UINT64  ElapsedNs;
+  UINT64  Count;
+  UINT32  Index;
+
+  StartTicks = GetPerformanceCounter ();
+  for (Index = 0; Index < IPMI_KCS_FAST_POLL_DEFAULT_COUNT; Index++) {
+    KcsRegisterRead8 (KCS_REG_STATUS);
+  }
+
+  ElapsedNs = KcsElapsedTimeInNs (StartTicks);
+  if (ElapsedNs == 0) {
+    mKcsFastPollCount = IPMI_KCS_FAST_POLL_DEFAULT_COUNT;
+  } else {
+    Count = DivU64x64Remainder (
+              MultU64x32 (IPMI_KCS_FAST_POLL_WINDOW_US * 1000, IPMI_KCS_FAST_POLL_DEFAULT_COUNT),
+              ElapsedNs,
+              NULL
+              );
+    mKcsFastPollCount = (UINT32)MAX (1, MIN (Count, MAX_UINT16));
+  }
+
+  DEBUG ((DEBUG_MANAGEABILITY_INFO, "%a: %d status reads in %dus.\n", __func__, mKcsFastPollCount, IPMI_KCS_FAST_POLL_WINDOW_US));
+}
+
+/**
+  This function waits for parameter Flag to be set or cleared.
+  Polls the status register back to back for IPMI_KCS_FAST_POLL_WINDOW_US,
+  then with a delay that doubles from IPMI_KCS_BACKOFF_MIN_US up to 1ms,
+  till 5 seconds elapses.
 
   @param[in]  Flag        KCS Flag to test.
-  @retval     EFI_SUCCESS The KCS flag under test is set.
-  @retval     EFI_TIMEOUT The KCS flag didn't set in 5 second windows.
+  @param[in]  Set         TRUE to wait for Flag to set, FALSE to wait for
+                          it to clear.
+
+  @retval     EFI_SUCCESS The KCS flag under test reached the state.
+  @retval     EFI_TIMEOUT The KCS flag didn't reach the state in 5 second windows.
 **/
+STATIC
 EFI_STATUS
-WaitStatusSet (
-  IN  UINT8  Flag
+KcsWaitStatus (
+  IN  UINT8    Flag,
+  IN  BOOLEAN  Set
   )
 {
-  UINT64  Timeout = 0;
+  UINT32  Index;
+  UINT64  Timeout;
+  UINTN   Delay;
+
+  if (mKcsFastPollCount == 0) {
+    KcsCalibrateFastPoll ();
+  }
+
+  for (Index = 0; Index < mKcsFastPollCount; Index++) {
+    mKcsStatistics.StatusPolls++;
+    if (((KcsRegisterRead8 (KCS_REG_STATUS) & Flag) != 0) == Set) {
+      return EFI_SUCCESS;
+    }
+  }
 
-  while (!(KcsRegisterRead8 (KCS_REG_STATUS) & Flag)) {
-    MicroSecondDelay (IPMI_KCS_TIMEOUT_1MS);
-    Timeout = Timeout + IPMI_KCS_TIMEOUT_1MS;
+  mKcsStatistics.BackoffDelays++;
+  Timeout = 0;
+  Delay   = IPMI_KCS_BACKOFF_MIN_US;
+  do {
     if (Timeout >= IPMI_KCS_TIMEOUT_5_SEC) {
       return EFI_TIMEOUT;
     }
-  }
+
+    MicroSecondDelay (Delay);
+    Timeout = Timeout + Delay;
+    Delay   = MIN (Delay * 2, IPMI_KCS_TIMEOUT_1MS);
+    mKcsStatistics.StatusPolls++;
+  } while (((KcsRegisterRead8 (KCS_REG_STATUS) & Flag) != 0) != Set);
 
   return EFI_SUCCESS;
 }
 
+/**
+  This function waits for parameter Flag to set.
+
+  @param[in]  Flag        KCS Flag to test.
+  @retval     EFI_SUCCESS The KCS flag under test is set.
+  @retval     EFI_TIMEOUT The KCS flag didn't set in 5 second windows.
+**/
+EFI_STATUS
+WaitStatusSet (
+  IN  UINT8  Flag
+  )
+{
+  return KcsWaitStatus (Flag, TRUE);
+}
+
 /**
   This function waits for parameter Flag to get cleared.
-  Checks status flag in every 1ms internal till 5 seconds elapses.
 
   @param[in]  Flag        KCS Flag to test.
 
@@ -59,17 +172,70 @@ WaitStatusClear (
   IN  UINT8  Flag
   )
 {
-  UINT64  Timeout = 0;
+  return KcsWaitStatus (Flag, FALSE);
+}
 
-  while (KcsRegisterRead8 (KCS_REG_STATUS) & Flag) {
-    MicroSecondDelay (IPMI_KCS_TIMEOUT_1MS);
-    Timeout = Timeout + IPMI_KCS_TIMEOUT_1MS;
-    if (Timeout >= IPMI_KCS_TIMEOUT_5_SEC) {
-      return EFI_TIMEOUT;
-    }
+/**
+  This function starts timing a KCS transaction.
+
+  @param[out]     Transaction           The transaction to time.
+**/
+VOID
+KcsTransactionStart (
+  OUT MANAGEABILITY_TRANSPORT_KCS_TRANSACTION  *Transaction
+  )
+{
+  Transaction->StartTicks    = GetPerformanceCounter ();
+  Transaction->StatusPolls   = mKcsStatistics.StatusPolls;
+  Transaction->BackoffDelays = mKcsStatistics.BackoffDelays;
+}
+
+/**
+  This function accounts a finished KCS transaction in mKcsStatistics
+  and reports how long the BMC took to handle it.
+
+  @param[in]      Transaction           The transaction started by
+                                        KcsTransactionStart.
+  @param[in]      Status                Status of the transaction.
+**/
+VOID
+KcsTransactionEnd (
+  IN MANAGEABILITY_TRANSPORT_KCS_TRANSACTION  *Transaction,
+  IN EFI_STATUS                               Status
+  )
+{
+  UINT64  ElapsedNs;
+
+  ElapsedNs = KcsElapsedTimeInNs (Transaction->StartTicks);
+
+  if ((mKcsStatistics.Transactions == 0) || (ElapsedNs < mKcsStatistics.MinTimeInNs)) {
+    mKcsStatistics.MinTimeInNs = ElapsedNs;
   }
 
-  return EFI_SUCCESS;
+  if (ElapsedNs > mKcsStatistics.MaxTimeInNs) {
+    mKcsStatistics.MaxTimeInNs = ElapsedNs;
+  }
+
+  mKcsStatistics.Transactions++;
+  mKcsStatistics.TotalTimeInNs += ElapsedNs;
+  if (EFI_ERROR (Status)) {
+    mKcsStatistics.Failures++;
+  }
+
+  DEBUG ((
+    DEBUG_MANAGEABILITY_INFO,
+    "KCS transaction %r in %ldus, %ld status polls, %ld backoffs " \
+    "(%ld transactions, %ld failed, min/avg/max %ld/%ld/%ldus).\n",
+    Status,
+    DivU64x32 (ElapsedNs, 1000),
+    mKcsStatistics.StatusPolls - Transaction->StatusPolls,
+    mKcsStatistics.BackoffDelays - Transaction->BackoffDelays,
+    mKcsStatistics.Transactions,
+    mKcsStatistics.Failures,
+    DivU64x32 (mKcsStatistics.MinTimeInNs, 1000),
+    DivU64x32 (DivU64x64Remainder (mKcsStatistics.TotalTimeInNs, mKcsStatistics.Transactions, NULL), 1000),
+    DivU64x32 (mKcsStatistics.MaxTimeInNs, 1000)
+    ));
 }
 
 /**
@@ -38,6 +38,45 @@ typedef struct {
 #define IPMI_KCS_TIMEOUT_5_SEC  5000*1000
 #define IPMI_KCS_TIMEOUT_1MS    1000
 
+///
+/// The status register is first polled back to back for this long, since
+/// BMCs usually handle a KCS byte in a few microseconds. Polling then backs
+/// off from IPMI_KCS_BACKOFF_MIN_US, doubling each time up to
+/// IPMI_KCS_TIMEOUT_1MS, until IPMI_KCS_TIMEOUT_5_SEC elapses.
+///
+#define IPMI_KCS_FAST_POLL_WINDOW_US  100
+#define IPMI_KCS_BACKOFF_MIN_US       1
+
+///
+/// Status register reads polled back to back when the performance
+/// counter can't be used to calibrate IPMI_KCS_FAST_POLL_WINDOW_US.
+///
+#define IPMI_KCS_FAST_POLL_DEFAULT_COUNT  100
+
+///
+/// Timing statistics of the KCS transactions.
+///
+typedef struct {
+  UINT64    Transactions;       ///< Transactions sent.
+  UINT64    Failures;           ///< Transactions that failed.
+  UINT64    TotalTimeInNs;      ///< Time spent in all transactions.
+  UINT64    MinTimeInNs;        ///< Fastest transaction.
+  UINT64    MaxTimeInNs;        ///< Slowest transaction.
+  UINT64    StatusPolls;        ///< Status register reads while waiting on the BMC.
+  UINT64    BackoffDelays;      ///< Waits that had to leave the fast polling window.
+} MANAGEABILITY_TRANSPORT_KCS_STATISTICS;
+
+///
+/// A KCS transaction being timed.
+///
+typedef struct {
+  UINT64    StartTicks;         ///< Performance counter at the start.
+  UINT64    StatusPolls;        ///< mKcsStatistics.StatusPolls at the start.
+  UINT64    BackoffDelays;      ///< mKcsStatistics.BackoffDelays at the start.
+} MANAGEABILITY_TRANSPORT_KCS_TRANSACTION;
+
+extern MANAGEABILITY_TRANSPORT_KCS_STATISTICS  mKcsStatistics;
+
 /**
   This service communicates with BMC using KCS protocol.
 
@@ -83,6 +122,30 @@ KcsTransportSendCommand (
   OUT  MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS  *AdditionalStatus
   );
 
+/**
+  This function starts timing a KCS transaction.
+
+  @param[out]     Transaction           The transaction to time.
+**/
+VOID
+KcsTransactionStart (
+  OUT MANAGEABILITY_TRANSPORT_KCS_TRANSACTION  *Transaction
+  );
+
+/**
+  This function accounts a finished KCS transaction in mKcsStatistics
+  and reports how long the BMC took to handle it.
+
+  @param[in]      Transaction           The transaction started by
+                                        KcsTransactionStart.
+  @param[in]      Status                Status of the transaction.
+**/
+VOID
+KcsTransactionEnd (
+  IN MANAGEABILITY_TRANSPORT_KCS_TRANSACTION  *Transaction,
+  IN EFI_STATUS                               Status
+  );
+
 /**
   This function reads 8-bit value from register address.
 
@@ -221,12 +221,14 @@ KcsTransportTransmitReceive (
 {
   EFI_STATUS                                 Status;
   MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS  AdditionalStatus;
+  MANAGEABILITY_TRANSPORT_KCS_TRANSACTION    Transaction;
 
   if ((TransportToken == NULL) || (TransferToken == NULL)) {
     DEBUG ((DEBUG_ERROR, "%a: Invalid transport token or transfer token.\n", __func__));
     return;
   }
 
+  KcsTransactionStart (&Transaction);
   Status = KcsTransportSendCommand (
              TransferToken->TransmitHeader,
              TransferToken->TransmitHeaderSize,
@@ -238,6 +240,7 @@ KcsTransportTransmitReceive (
              &TransferToken->ReceivePackage.ReceiveSizeInByte,
              &AdditionalStatus
              );
+  KcsTransactionEnd (&Transaction, Status);
 
   TransferToken->TransferStatus = Status;
   KcsTransportStatus (TransportToken, &TransferToken->TransportAdditionalStatus);
@@ -0,0 +1,327 @@
+/** @file
+  Host based unit tests of HelperManageabilityGenerateCrc8.
+
+  The CRC8 of the SMBus/MCTP PEC polynomial is computed with slicing
+  tables, any other polynomial bit by bit. The tests check both against
+  known check values and against the bitwise reference below, then log
+  the throughput of each.
+
+  Copyright (C) 2023 Advanced Micro Devices, Inc. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <time.h>
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UnitTestLib.h>
+#include <Library/ManageabilityTransportHelperLib.h>
+#include <Library/ManageabilityTransportMctpLib.h>
+
+#define UNIT_TEST_APP_NAME     "ManageabilityPkg CRC8 Unit Test"
+#define UNIT_TEST_APP_VERSION  "1.0"
+
+///
+/// Size of the buffer whose CRC8 is measured, and number of times.
+///
+#define CRC8_THROUGHPUT_BUFFER_SIZE  SIZE_1MB
+#define CRC8_THROUGHPUT_ITERATIONS   16
+
+///
+/// CRC-8 check value: CRC of the ASCII string "123456789".
+///
+typedef struct {
+  CONST CHAR8    *Name;
+  UINT8          Polynomial;
+  UINT8          CrcInitialValue;
+  UINT8          Check;
+} CRC8_CHECK_VALUE;
+
+CONST CRC8_CHECK_VALUE  mCrc8CheckValues[] = {
+  { "CRC-8/SMBUS",    MCTP_KCS_PACKET_ERROR_CODE_POLY, 0x00, 0xF4 },
+  { "CRC-8/CDMA2000", 0x9B,                            0xFF, 0xDA },
+  { "CRC-8/LTE",      0x9B,                            0x00, 0xEA },
+  { "CRC-8/DVB-S2",   0xD5,                            0x00, 0xBC }
+};
+
+/**
+  Reference CRC8 with given polynomial, computed bit by bit.
+
+  @param[in]  Polynomial       Polynomial in 8-bit.
+  @param[in]  CrcInitialValue  CRC initial value.
+  @param[in]  BufferStart      Pointer to buffer starts the CRC calculation.
+  @param[in]  BufferSize       Size of buffer.
+
+  @retval  UINT8 CRC value.
+**/
+UINT8
+ReferenceCrc8 (
+  IN UINT8        Polynomial,
+  IN UINT8        CrcInitialValue,
+  IN CONST UINT8  *BufferStart,
+  IN UINT32       BufferSize
+  )
+{
+  UINT8   BitIndex;
+  UINT32  BufferIndex;
+
+  for (BufferIndex = 0; BufferIndex < BufferSize; BufferIndex++) {
+    CrcInitialValue ^= BufferStart[BufferIndex];
+    for (BitIndex = 0; BitIndex < 8; BitIndex++) {
+      if ((CrcInitialValue & 0x80) != 0) {
+        CrcInitialValue = (UINT8)((CrcInitialValue << 1) ^ Polynomial);
+      } else {
+        CrcInitialValue <<= 1;
+      }
+    }
+  }
+
+  return CrcInitialValue;
+}
+
+/**
+  Fill a buffer with pseudo random bytes.
+
+  @param[out]  Buffer      Buffer to fill.
+  @param[in]   BufferSize  Size of Buffer.
+**/
+VOID
+FillBuffer (
+  OUT UINT8  *Buffer,
+  IN  UINTN  BufferSize
+  )
+{
+  UINT32  Seed;
+  UINTN   Index;
+
+  Seed = 0x12345678;
+  for (Index = 0; Index < BufferSize; Index++) {
+    Seed          = Seed * 1103515245 + 12345;
+    Buffer[Index] = (UINT8)(Seed >> 16);
+  }
+}
+
+/**
+  HelperManageabilityGenerateCrc8 returns the check value of the
+  standard CRC-8 variants without reflection or final XOR, and the
+  initial value of an empty buffer.
+
+  @param[in]  Context  Unused.
+
+  @retval  UNIT_TEST_PASSED             The test passed.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+Crc8CheckValueTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINT8  Check[] = "123456789";
+  UINTN  Index;
+
+  for (Index = 0; Index < ARRAY_SIZE (mCrc8CheckValues); Index++) {
+    UT_LOG_INFO ("%a\n", mCrc8CheckValues[Index].Name);
+    UT_ASSERT_EQUAL (
+      HelperManageabilityGenerateCrc8 (
+        mCrc8CheckValues[Index].Polynomial,
+        mCrc8CheckValues[Index].CrcInitialValue,
+        Check,
+        sizeof (Check) - 1
+        ),
+      mCrc8CheckValues[Index].Check
+      );
+    UT_ASSERT_EQUAL (
+      ReferenceCrc8 (
+        mCrc8CheckValues[Index].Polynomial,
+        mCrc8CheckValues[Index].CrcInitialValue,
+        Check,
+        sizeof (Check) - 1
+        ),
+      mCrc8CheckValues[Index].Check
+      );
+    UT_ASSERT_EQUAL (
+      HelperManageabilityGenerateCrc8 (
+        mCrc8CheckValues[Index].Polynomial,
+        mCrc8CheckValues[Index].CrcInitialValue,
+        Check,
+        0
+        ),
+      mCrc8CheckValues[Index].CrcInitialValue
+      );
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  HelperManageabilityGenerateCrc8 matches the bitwise reference for every
+  length up to 300 bytes, several initial values and buffer alignments.
+
+  @param[in]  Context  Unused.
+
+  @retval  UNIT_TEST_PASSED             The test passed.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+Crc8ReferenceTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  CONST UINT8  Polynomials[]   = { MCTP_KCS_PACKET_ERROR_CODE_POLY, 0x9B };
+  CONST UINT8  InitialValues[] = { 0x00, 0x5A, 0xFF };
+  UINT8        Buffer[300 + sizeof (UINT64)];
+  UINTN        PolynomialIndex;
+  UINTN        InitialValueIndex;
+  UINTN        Offset;
+  UINT32       Length;
+
+  FillBuffer (Buffer, sizeof (Buffer));
+  for (PolynomialIndex = 0; PolynomialIndex < ARRAY_SIZE (Polynomials); PolynomialIndex++) {
+    for (InitialValueIndex = 0; InitialValueIndex < ARRAY_SIZE (InitialValues); InitialValueIndex++) {
+      for (Offset = 0; Offset < sizeof (UINT64); Offset++) {
+        for (Length = 0; Length <= 300; Length++) {
+          UT_ASSERT_EQUAL (
+            HelperManageabilityGenerateCrc8 (
+              Polynomials[PolynomialIndex],
+              InitialValues[InitialValueIndex],
+              Buffer + Offset,
+              Length
+              ),
+            ReferenceCrc8 (
+              Polynomials[PolynomialIndex],
+              InitialValues[InitialValueIndex],
+              Buffer + Offset,
+              Length
+              )
+            );
+        }
+      }
+    }
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Log the throughput of HelperManageabilityGenerateCrc8 and of the bitwise
+  reference for the SMBus/MCTP PEC polynomial.
+
+  @param[in]  Context  Unused.
+
+  @retval  UNIT_TEST_PASSED             The test passed.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+Crc8ThroughputTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINT8    *Buffer;
+  UINTN    Index;
+  UINT8    Crc;
+  UINT8    ReferenceCrc;
+  clock_t  Start;
+  clock_t  Sliced;
+  clock_t  Bitwise;
+
+  Buffer = AllocatePool (CRC8_THROUGHPUT_BUFFER_SIZE);
+  UT_ASSERT_NOT_NULL (Buffer);
+  FillBuffer (Buffer, CRC8_THROUGHPUT_BUFFER_SIZE);
+
+  Crc   = 0;
+  Start = clock ();
+  for (Index = 0; Index < CRC8_THROUGHPUT_ITERATIONS; Index++) {
+    Crc = HelperManageabilityGenerateCrc8 (MCTP_KCS_PACKET_ERROR_CODE_POLY, Crc, Buffer, CRC8_THROUGHPUT_BUFFER_SIZE);
+  }
+
+  Sliced = clock () - Start;
+
+  ReferenceCrc = 0;
+  Start        = clock ();
+  for (Index = 0; Index < CRC8_THROUGHPUT_ITERATIONS; Index++) {
+    ReferenceCrc = ReferenceCrc8 (MCTP_KCS_PACKET_ERROR_CODE_POLY, ReferenceCrc, Buffer, CRC8_THROUGHPUT_BUFFER_SIZE);
+  }
+
+  Bitwise = clock () - Start;
+  FreePool (Buffer);
+
+  UT_ASSERT_EQUAL (Crc, ReferenceCrc);
+  UT_ASSERT_TRUE (Sliced > 0 && Bitwise > 0);
+
+  UT_LOG_INFO (
+    "HelperManageabilityGenerateCrc8: %lu MB/s\n",
+    DivU64x64Remainder (MultU64x32 ((UINT64)CLOCKS_PER_SEC, CRC8_THROUGHPUT_ITERATIONS), (UINT64)Sliced, NULL)
+    );
+  UT_LOG_INFO (
+    "Bitwise reference: %lu MB/s\n",
+    DivU64x64Remainder (MultU64x32 ((UINT64)CLOCKS_PER_SEC, CRC8_THROUGHPUT_ITERATIONS), (UINT64)Bitwise, NULL)
+    );
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the
+  CRC8 of the helper library and run the unit tests.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+EFI_STATUS
+EFIAPI
+UnitTestingEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      Crc8Tests;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_APP_NAME, UNIT_TEST_APP_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_APP_NAME, gEfiCallerBaseName, UNIT_TEST_APP_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (&Crc8Tests, Framework, "HelperManageabilityGenerateCrc8", "Crc8", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for the CRC8 tests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (Crc8Tests, "Check values of CRC-8 variants", "CheckValue", Crc8CheckValueTest, NULL, NULL, NULL);
+  AddTestCase (Crc8Tests, "Matches the bitwise reference", "Reference", Crc8ReferenceTest, NULL, NULL, NULL);
+  AddTestCase (Crc8Tests, "Throughput against the bitwise reference", "Throughput", Crc8ThroughputTest, NULL, NULL, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return UnitTestingEntry ();
+}
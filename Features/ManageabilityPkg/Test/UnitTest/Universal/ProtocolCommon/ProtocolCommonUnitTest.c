@@ -0,0 +1,702 @@
+/** @file
+  Host based unit tests of the common code of the IPMI, MCTP and PLDM
+  protocols, run against the BMC simulator transport library.
+
+  Each test checks the response of a command submitted through
+  CommonIpmiSubmitCommand, CommonMctpSubmitMessage or
+  CommonPldmSubmitCommand, then submits it PROTOCOL_COMMON_ITERATIONS
+  times and logs the average time each command takes. The BMC model
+  answers at once, so this is the overhead of the protocol stack itself.
+
+  Copyright (C) 2023 Advanced Micro Devices, Inc. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <time.h>
+
+#include <Uefi.h>
+#include <IndustryStandard/Ipmi.h>
+#include <IndustryStandard/PldmSmbiosTransfer.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UnitTestLib.h>
+#include <Library/ManageabilityTransportBmcSimulatorLib.h>
+#include <Library/ManageabilityTransportHelperLib.h>
+#include <Library/ManageabilityTransportLib.h>
+
+#include "IpmiProtocolCommon.h"
+#include "MctpProtocolCommon.h"
+#include "PldmProtocolCommon.h"
+
+#define UNIT_TEST_APP_NAME     "ManageabilityPkg Protocol Common Unit Test"
+#define UNIT_TEST_APP_VERSION  "1.0"
+
+///
+/// Number of commands submitted to measure the time each takes.
+///
+#define PROTOCOL_COMMON_ITERATIONS  10000
+
+///
+/// MCTP control message Get Endpoint ID, and the size of its response:
+/// instance ID, command code, completion code, EID, EID type and
+/// medium specific information.
+///
+#define MCTP_CONTROL_GET_ENDPOINT_ID                0x02
+#define MCTP_CONTROL_REQUEST                        BIT7
+#define MCTP_CONTROL_GET_ENDPOINT_ID_RESPONSE_SIZE  6
+
+///
+/// Globals the protocol drivers define for the common code.
+///
+CHAR16  *mTransportName;
+UINT32  mTransportMaximumPayload;
+UINT8   mPldmRequestInstanceId;
+
+///
+/// Transport of the protocol under test.
+///
+typedef struct {
+  EFI_GUID                                        *ProtocolSpec;
+  MANAGEABILITY_TRANSPORT_TOKEN                   *TransportToken;
+  MANAGEABILITY_TRANSPORT_HARDWARE_INFORMATION    HardwareInformation;
+} PROTOCOL_COMMON_TEST_CONTEXT;
+
+PROTOCOL_COMMON_TEST_CONTEXT  mIpmiContext = { &gManageabilityProtocolIpmiGuid };
+PROTOCOL_COMMON_TEST_CONTEXT  mMctpContext = { &gManageabilityProtocolMctpGuid };
+PROTOCOL_COMMON_TEST_CONTEXT  mPldmContext = { &gManageabilityProtocolPldmGuid };
+
+///
+/// Command submitted by MeasureCommand.
+///
+typedef
+EFI_STATUS
+(*PROTOCOL_COMMON_SUBMIT) (
+  IN PROTOCOL_COMMON_TEST_CONTEXT  *TestContext
+  );
+
+/**
+  Acquire and initialize the transport of the protocol under test, the way
+  its protocol driver does, on a BMC model in its power on state.
+
+  @param[in]  Context  The PROTOCOL_COMMON_TEST_CONTEXT.
+
+  @retval  UNIT_TEST_PASSED                      The transport is initialized.
+  @retval  UNIT_TEST_ERROR_PREREQUISITE_NOT_MET  The transport is not initialized.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+OpenTransport (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  PROTOCOL_COMMON_TEST_CONTEXT               *TestContext;
+  EFI_STATUS                                 Status;
+  MANAGEABILITY_TRANSPORT_CAPABILITY         TransportCapability;
+  MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS  TransportAdditionalStatus;
+
+  TestContext = (PROTOCOL_COMMON_TEST_CONTEXT *)Context;
+  BmcSimulatorReset ();
+
+  Status = HelperAcquireManageabilityTransport (TestContext->ProtocolSpec, &TestContext->TransportToken);
+  if (EFI_ERROR (Status)) {
+    UT_LOG_ERROR ("Failed to acquire the transport - %r\n", Status);
+    return UNIT_TEST_ERROR_PREREQUISITE_NOT_MET;
+  }
+
+  Status = GetTransportCapability (TestContext->TransportToken, &TransportCapability);
+  if (EFI_ERROR (Status)) {
+    UT_LOG_ERROR ("Failed to get the transport capability - %r\n", Status);
+    return UNIT_TEST_ERROR_PREREQUISITE_NOT_MET;
+  }
+
+  mTransportMaximumPayload = MANAGEABILITY_TRANSPORT_PAYLOAD_SIZE_FROM_CAPABILITY (TransportCapability);
+  if (mTransportMaximumPayload != (1 << MANAGEABILITY_TRANSPORT_CAPABILITY_MAXIMUM_PAYLOAD_NOT_AVAILABLE)) {
+    mTransportMaximumPayload -= 1;
+  }
+
+  mTransportName         = HelperManageabilitySpecName (TestContext->TransportToken->Transport->ManageabilityTransportSpecification);
+  mPldmRequestInstanceId = 0;
+
+  TestContext->HardwareInformation.Pointer = NULL;
+  if (TestContext->ProtocolSpec == &gManageabilityProtocolIpmiGuid) {
+    Status = SetupIpmiTransportHardwareInformation (TestContext->TransportToken, &TestContext->HardwareInformation);
+  } else if (TestContext->ProtocolSpec == &gManageabilityProtocolMctpGuid) {
+    Status = SetupMctpTransportHardwareInformation (TestContext->TransportToken, &TestContext->HardwareInformation);
+  }
+
+  if (EFI_ERROR (Status)) {
+    UT_LOG_ERROR ("Failed to set up the hardware information - %r\n", Status);
+    return UNIT_TEST_ERROR_PREREQUISITE_NOT_MET;
+  }
+
+  Status = HelperInitManageabilityTransport (
+             TestContext->TransportToken,
+             TestContext->HardwareInformation,
+             &TransportAdditionalStatus
+             );
+  if (EFI_ERROR (Status)) {
+    UT_LOG_ERROR ("Failed to initialize the transport - %r\n", Status);
+    return UNIT_TEST_ERROR_PREREQUISITE_NOT_MET;
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Release the transport of the protocol under test.
+
+  @param[in]  Context  The PROTOCOL_COMMON_TEST_CONTEXT.
+**/
+VOID
+EFIAPI
+CloseTransport (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  PROTOCOL_COMMON_TEST_CONTEXT  *TestContext;
+
+  TestContext = (PROTOCOL_COMMON_TEST_CONTEXT *)Context;
+  if (TestContext->HardwareInformation.Pointer != NULL) {
+    FreePool (TestContext->HardwareInformation.Pointer);
+    TestContext->HardwareInformation.Pointer = NULL;
+  }
+
+  if (TestContext->TransportToken != NULL) {
+    ReleaseTransportSession (TestContext->TransportToken);
+    TestContext->TransportToken = NULL;
+  }
+}
+
+/**
+  Submit a command PROTOCOL_COMMON_ITERATIONS times and log the
+  average time it takes.
+
+  @param[in]  TestContext  The transport of the protocol under test.
+  @param[in]  Name         Name of the command in the log.
+  @param[in]  Submit       Function submitting the command once.
+
+  @retval  EFI_SUCCESS  Every command succeeded.
+  @retval  Others       The status of the first command that failed.
+**/
+EFI_STATUS
+MeasureCommand (
+  IN PROTOCOL_COMMON_TEST_CONTEXT  *TestContext,
+  IN CONST CHAR8                   *Name,
+  IN PROTOCOL_COMMON_SUBMIT        Submit
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Index;
+  clock_t     Start;
+  clock_t     End;
+  UINT64      Nanoseconds;
+
+  Start = clock ();
+  for (Index = 0; Index < PROTOCOL_COMMON_ITERATIONS; Index++) {
+    Status = Submit (TestContext);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  End = clock ();
+
+  Nanoseconds = DivU64x64Remainder (
+                  MultU64x32 ((UINT64)(End - Start), 1000000000),
+                  MultU64x32 ((UINT64)CLOCKS_PER_SEC, PROTOCOL_COMMON_ITERATIONS),
+                  NULL
+                  );
+  UT_LOG_INFO ("%a: %lu ns per command, %d commands\n", Name, Nanoseconds, PROTOCOL_COMMON_ITERATIONS);
+  return EFI_SUCCESS;
+}
+
+/**
+  Submit IPMI Get Device ID without the response cache.
+
+  @param[in]  TestContext  The IPMI transport.
+
+  @retval  The status of CommonIpmiSubmitCommand.
+**/
+EFI_STATUS
+SubmitIpmiGetDeviceId (
+  IN PROTOCOL_COMMON_TEST_CONTEXT  *TestContext
+  )
+{
+  UINT8   Response[16];
+  UINT32  ResponseSize;
+
+  ResponseSize = sizeof (Response);
+  return CommonIpmiSubmitCommand (
+           TestContext->TransportToken,
+           NULL,
+           IPMI_NETFN_APP,
+           IPMI_APP_GET_DEVICE_ID,
+           NULL,
+           0,
+           Response,
+           &ResponseSize
+           );
+}
+
+/**
+  Submit IPMI Get Device ID through the response cache.
+
+  @param[in]  TestContext  The IPMI transport.
+
+  @retval  The status of CommonIpmiSubmitCommand.
+**/
+EFI_STATUS
+SubmitIpmiGetDeviceIdCached (
+  IN PROTOCOL_COMMON_TEST_CONTEXT  *TestContext
+  )
+{
+  STATIC IPMI_RESPONSE_CACHE  ResponseCache;
+  UINT8                       Response[16];
+  UINT32                      ResponseSize;
+
+  ResponseSize = sizeof (Response);
+  return CommonIpmiSubmitCommand (
+           TestContext->TransportToken,
+           &ResponseCache,
+           IPMI_NETFN_APP,
+           IPMI_APP_GET_DEVICE_ID,
+           NULL,
+           0,
+           Response,
+           &ResponseSize
+           );
+}
+
+/**
+  Submit MCTP control Get Endpoint ID.
+
+  @param[in]  TestContext  The MCTP transport.
+
+  @retval  The status of CommonMctpSubmitMessage.
+**/
+EFI_STATUS
+SubmitMctpGetEndpointId (
+  IN PROTOCOL_COMMON_TEST_CONTEXT  *TestContext
+  )
+{
+  UINT8                                      Request[2];
+  UINT8                                      Response[MCTP_CONTROL_GET_ENDPOINT_ID_RESPONSE_SIZE];
+  UINT32                                     ResponseSize;
+  MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS  AdditionalTransferError;
+
+  Request[0]   = MCTP_CONTROL_REQUEST;
+  Request[1]   = MCTP_CONTROL_GET_ENDPOINT_ID;
+  ResponseSize = sizeof (Response);
+  return CommonMctpSubmitMessage (
+           TestContext->TransportToken,
+           MCTP_MESSAGE_TYPE_MCTP_CONTROL,
+           FixedPcdGet8 (PcdMctpSourceEndpointId),
+           FixedPcdGet8 (PcdMctpDestinationEndpointId),
+           FALSE,
+           Request,
+           sizeof (Request),
+           MANAGEABILITY_TRANSPORT_NO_TIMEOUT,
+           Response,
+           &ResponseSize,
+           MANAGEABILITY_TRANSPORT_NO_TIMEOUT,
+           &AdditionalTransferError
+           );
+}
+
+/**
+  Submit PLDM GetSMBIOSStructureTableMetadata.
+
+  @param[in]  TestContext  The PLDM transport.
+
+  @retval  The status of CommonPldmSubmitCommand.
+**/
+EFI_STATUS
+SubmitPldmGetSmbiosMetadata (
+  IN PROTOCOL_COMMON_TEST_CONTEXT  *TestContext
+  )
+{
+  PLDM_SMBIOS_STRUCTURE_TABLE_METADATA  Metadata;
+  UINT32                                ResponseSize;
+
+  ResponseSize = sizeof (Metadata);
+  return CommonPldmSubmitCommand (
+           TestContext->TransportToken,
+           PLDM_TYPE_SMBIOS,
+           PLDM_GET_SMBIOS_STRUCTURE_TABLE_METADATA_COMMAND_CODE,
+           NULL,
+           0,
+           (UINT8 *)&Metadata,
+           &ResponseSize
+           );
+}
+
+/**
+  IPMI Get Device ID returns the device ID of the BMC model, and is
+  answered from the response cache once it is cached.
+
+  @param[in]  Context  The IPMI PROTOCOL_COMMON_TEST_CONTEXT.
+
+  @retval  UNIT_TEST_PASSED             The test passed.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+IpmiGetDeviceIdTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  PROTOCOL_COMMON_TEST_CONTEXT  *TestContext;
+  IPMI_RESPONSE_CACHE           *ResponseCache;
+  UINT8                         Response[16];
+  UINT32                        ResponseSize;
+  BMC_SIMULATOR_STATISTICS      Statistics;
+  EFI_STATUS                    Status;
+  UINTN                         Index;
+
+  TestContext   = (PROTOCOL_COMMON_TEST_CONTEXT *)Context;
+  ResponseCache = AllocateZeroPool (sizeof (IPMI_RESPONSE_CACHE));
+  UT_ASSERT_NOT_NULL (ResponseCache);
+
+  for (Index = 0; Index < 2; Index++) {
+    ResponseSize = sizeof (Response);
+    Status       = CommonIpmiSubmitCommand (
+                     TestContext->TransportToken,
+                     ResponseCache,
+                     IPMI_NETFN_APP,
+                     IPMI_APP_GET_DEVICE_ID,
+                     NULL,
+                     0,
+                     Response,
+                     &ResponseSize
+                     );
+    UT_ASSERT_NOT_EFI_ERROR (Status);
+    UT_ASSERT_EQUAL (ResponseSize, sizeof (Response));
+    UT_ASSERT_EQUAL (Response[0], IPMI_COMP_CODE_NORMAL);
+    UT_ASSERT_EQUAL (Response[5], 0x02);
+  }
+
+  BmcSimulatorGetStatistics (&Statistics);
+  UT_ASSERT_EQUAL (Statistics.IpmiRequests, 1);
+  FreePool (ResponseCache);
+
+  UT_ASSERT_NOT_EFI_ERROR (MeasureCommand (TestContext, "IPMI Get Device ID", SubmitIpmiGetDeviceId));
+  UT_ASSERT_NOT_EFI_ERROR (MeasureCommand (TestContext, "IPMI Get Device ID, cached", SubmitIpmiGetDeviceIdCached));
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  IPMI commands the BMC model doesn't implement complete with
+  IPMI_COMP_CODE_INVALID_COMMAND, and scripted responses override
+  the BMC model.
+
+  @param[in]  Context  The IPMI PROTOCOL_COMMON_TEST_CONTEXT.
+
+  @retval  UNIT_TEST_PASSED             The test passed.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+IpmiScriptedResponseTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  PROTOCOL_COMMON_TEST_CONTEXT  *TestContext;
+  CONST UINT8                   Scripted[] = { IPMI_COMP_CODE_NODE_BUSY };
+  UINT8                         Response[16];
+  UINT32                        ResponseSize;
+  EFI_STATUS                    Status;
+
+  TestContext  = (PROTOCOL_COMMON_TEST_CONTEXT *)Context;
+  ResponseSize = sizeof (Response);
+  Status       = CommonIpmiSubmitCommand (
+                   TestContext->TransportToken,
+                   NULL,
+                   IPMI_NETFN_APP,
+                   0x7F,
+                   NULL,
+                   0,
+                   Response,
+                   &ResponseSize
+                   );
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Response[0], IPMI_COMP_CODE_INVALID_COMMAND);
+
+  Status = BmcSimulatorSetResponse (BmcSimulatorIpmi, IPMI_NETFN_APP, IPMI_APP_GET_DEVICE_ID, Scripted, sizeof (Scripted));
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  ResponseSize = sizeof (Response);
+  Status       = CommonIpmiSubmitCommand (
+                   TestContext->TransportToken,
+                   NULL,
+                   IPMI_NETFN_APP,
+                   IPMI_APP_GET_DEVICE_ID,
+                   NULL,
+                   0,
+                   Response,
+                   &ResponseSize
+                   );
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (Response[0], IPMI_COMP_CODE_NODE_BUSY);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  MCTP control Get Endpoint ID returns the EID of the BMC model.
+
+  @param[in]  Context  The MCTP PROTOCOL_COMMON_TEST_CONTEXT.
+
+  @retval  UNIT_TEST_PASSED             The test passed.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+MctpGetEndpointIdTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  PROTOCOL_COMMON_TEST_CONTEXT               *TestContext;
+  UINT8                                      Request[2];
+  UINT8                                      Response[MCTP_CONTROL_GET_ENDPOINT_ID_RESPONSE_SIZE];
+  UINT32                                     ResponseSize;
+  MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS  AdditionalTransferError;
+  EFI_STATUS                                 Status;
+
+  TestContext  = (PROTOCOL_COMMON_TEST_CONTEXT *)Context;
+  Request[0]   = MCTP_CONTROL_REQUEST;
+  Request[1]   = MCTP_CONTROL_GET_ENDPOINT_ID;
+  ResponseSize = sizeof (Response);
+  Status       = CommonMctpSubmitMessage (
+                   TestContext->TransportToken,
+                   MCTP_MESSAGE_TYPE_MCTP_CONTROL,
+                   FixedPcdGet8 (PcdMctpSourceEndpointId),
+                   FixedPcdGet8 (PcdMctpDestinationEndpointId),
+                   FALSE,
+                   Request,
+                   sizeof (Request),
+                   MANAGEABILITY_TRANSPORT_NO_TIMEOUT,
+                   Response,
+                   &ResponseSize,
+                   MANAGEABILITY_TRANSPORT_NO_TIMEOUT,
+                   &AdditionalTransferError
+                   );
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (ResponseSize, sizeof (Response));
+  UT_ASSERT_EQUAL (Response[1], MCTP_CONTROL_GET_ENDPOINT_ID);
+  UT_ASSERT_EQUAL (Response[2], 0);
+  UT_ASSERT_EQUAL (Response[3], FixedPcdGet8 (PcdMctpDestinationEndpointId));
+
+  UT_ASSERT_NOT_EFI_ERROR (MeasureCommand (TestContext, "MCTP Get Endpoint ID", SubmitMctpGetEndpointId));
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A PLDM message larger than the MCTP transmission unit is sent in
+  several packets, and the BMC model receives it whole.
+
+  @param[in]  Context  The MCTP PROTOCOL_COMMON_TEST_CONTEXT.
+
+  @retval  UNIT_TEST_PASSED             The test passed.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+MctpFragmentedMessageTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  PROTOCOL_COMMON_TEST_CONTEXT               *TestContext;
+  UINT8                                      *Request;
+  UINT32                                     RequestSize;
+  PLDM_REQUEST_HEADER                        *Header;
+  UINT8                                      Response[sizeof (PLDM_RESPONSE_HEADER) + sizeof (UINT32)];
+  UINT32                                     ResponseSize;
+  MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS  AdditionalTransferError;
+  BMC_SIMULATOR_STATISTICS                   Statistics;
+  EFI_STATUS                                 Status;
+  UINTN                                      Index;
+
+  TestContext = (PROTOCOL_COMMON_TEST_CONTEXT *)Context;
+  RequestSize = sizeof (PLDM_REQUEST_HEADER) + sizeof (UINT32) + 1 + 1000;
+  Request     = AllocateZeroPool (RequestSize);
+  UT_ASSERT_NOT_NULL (Request);
+
+  //
+  // SetSMBIOSStructureTable of a 1000 byte table in a single part.
+  //
+  Header                      = (PLDM_REQUEST_HEADER *)Request;
+  Header->RequestBit          = PLDM_MESSAGE_HEADER_IS_REQUEST;
+  Header->PldmType            = PLDM_TYPE_SMBIOS;
+  Header->PldmTypeCommandCode = PLDM_SET_SMBIOS_STRUCTURE_TABLE_COMMAND_CODE;
+  Request[sizeof (PLDM_REQUEST_HEADER) + sizeof (UINT32)] = PLDM_TRANSFER_FLAG_START_AND_END;
+  for (Index = 0; Index < 1000; Index++) {
+    Request[sizeof (PLDM_REQUEST_HEADER) + sizeof (UINT32) + 1 + Index] = (UINT8)Index;
+  }
+
+  ResponseSize = sizeof (Response);
+  Status       = CommonMctpSubmitMessage (
+                   TestContext->TransportToken,
+                   MCTP_MESSAGE_TYPE_PLDM,
+                   FixedPcdGet8 (PcdMctpSourceEndpointId),
+                   FixedPcdGet8 (PcdMctpDestinationEndpointId),
+                   FALSE,
+                   Request,
+                   RequestSize,
+                   MANAGEABILITY_TRANSPORT_NO_TIMEOUT,
+                   Response,
+                   &ResponseSize,
+                   MANAGEABILITY_TRANSPORT_NO_TIMEOUT,
+                   &AdditionalTransferError
+                   );
+  FreePool (Request);
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (ResponseSize, sizeof (Response));
+  UT_ASSERT_EQUAL (((PLDM_RESPONSE_HEADER *)Response)->PldmCompletionCode, 0);
+
+  BmcSimulatorGetStatistics (&Statistics);
+  UT_ASSERT_EQUAL (Statistics.PldmRequests, 1);
+  UT_ASSERT_TRUE (Statistics.MctpPackets > 1);
+  UT_ASSERT_EQUAL (Statistics.DroppedPackets, 0);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  PLDM GetSMBIOSStructureTableMetadata returns the metadata set by
+  SetSMBIOSStructureTableMetadata.
+
+  @param[in]  Context  The PLDM PROTOCOL_COMMON_TEST_CONTEXT.
+
+  @retval  UNIT_TEST_PASSED             The test passed.
+  @retval  UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+UNIT_TEST_STATUS
+EFIAPI
+PldmSmbiosMetadataTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  PROTOCOL_COMMON_TEST_CONTEXT          *TestContext;
+  PLDM_SMBIOS_STRUCTURE_TABLE_METADATA  Metadata;
+  PLDM_SMBIOS_STRUCTURE_TABLE_METADATA  ReadBack;
+  UINT32                                ResponseSize;
+  EFI_STATUS                            Status;
+
+  TestContext = (PROTOCOL_COMMON_TEST_CONTEXT *)Context;
+  ZeroMem (&Metadata, sizeof (Metadata));
+  Metadata.SmbiosMajorVersion                    = 3;
+  Metadata.SmbiosMinorVersion                    = 6;
+  Metadata.MaximumStructureSize                  = 0x100;
+  Metadata.SmbiosStructureTableLength            = 0x1234;
+  Metadata.NumberOfSmbiosStructures              = 42;
+  Metadata.SmbiosStructureTableIntegrityChecksum = 0xA5A55A5A;
+
+  ResponseSize = 0;
+  Status       = CommonPldmSubmitCommand (
+                   TestContext->TransportToken,
+                   PLDM_TYPE_SMBIOS,
+                   PLDM_SET_SMBIOS_STRUCTURE_TABLE_METADATA_COMMAND_CODE,
+                   (UINT8 *)&Metadata,
+                   sizeof (Metadata),
+                   NULL,
+                   &ResponseSize
+                   );
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+
+  ResponseSize = sizeof (ReadBack);
+  Status       = CommonPldmSubmitCommand (
+                   TestContext->TransportToken,
+                   PLDM_TYPE_SMBIOS,
+                   PLDM_GET_SMBIOS_STRUCTURE_TABLE_METADATA_COMMAND_CODE,
+                   NULL,
+                   0,
+                   (UINT8 *)&ReadBack,
+                   &ResponseSize
+                   );
+  UT_ASSERT_NOT_EFI_ERROR (Status);
+  UT_ASSERT_EQUAL (ResponseSize, sizeof (ReadBack));
+  UT_ASSERT_MEM_EQUAL (&ReadBack, &Metadata, sizeof (Metadata));
+
+  UT_ASSERT_NOT_EFI_ERROR (MeasureCommand (TestContext, "PLDM GetSMBIOSStructureTableMetadata", SubmitPldmGetSmbiosMetadata));
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initialize the unit test framework, suite, and unit tests for the
+  protocol common code and run the unit tests.
+
+  @retval  EFI_SUCCESS           All test cases were dispatched.
+  @retval  EFI_OUT_OF_RESOURCES  There are not enough resources available to
+                                 initialize the unit tests.
+**/
+EFI_STATUS
+EFIAPI
+UnitTestingEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      IpmiTests;
+  UNIT_TEST_SUITE_HANDLE      MctpTests;
+  UNIT_TEST_SUITE_HANDLE      PldmTests;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_APP_NAME, UNIT_TEST_APP_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_APP_NAME, gEfiCallerBaseName, UNIT_TEST_APP_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (&IpmiTests, Framework, "IPMI over the BMC simulator", "Ipmi", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for the IPMI tests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (IpmiTests, "Get Device ID is answered and cached", "GetDeviceId", IpmiGetDeviceIdTest, OpenTransport, CloseTransport, &mIpmiContext);
+  AddTestCase (IpmiTests, "Scripted responses override the BMC model", "ScriptedResponse", IpmiScriptedResponseTest, OpenTransport, CloseTransport, &mIpmiContext);
+
+  Status = CreateUnitTestSuite (&MctpTests, Framework, "MCTP over the BMC simulator", "Mctp", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for the MCTP tests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (MctpTests, "Get Endpoint ID is answered", "GetEndpointId", MctpGetEndpointIdTest, OpenTransport, CloseTransport, &mMctpContext);
+  AddTestCase (MctpTests, "Messages are fragmented and reassembled", "FragmentedMessage", MctpFragmentedMessageTest, OpenTransport, CloseTransport, &mMctpContext);
+
+  Status = CreateUnitTestSuite (&PldmTests, Framework, "PLDM over the BMC simulator", "Pldm", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for the PLDM tests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (PldmTests, "SMBIOS table metadata is stored", "SmbiosMetadata", PldmSmbiosMetadataTest, OpenTransport, CloseTransport, &mPldmContext);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return UnitTestingEntry ();
+}
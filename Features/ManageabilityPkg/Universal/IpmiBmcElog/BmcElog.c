@@ -17,59 +17,292 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 #include <Library/ManageabilityTransportHelperLib.h>
 
+#include <Guid/EventGroup.h>
+
+///
+/// Period of polling the progress of the SEL erase, in 100ns units.
+///
+#define BMC_ELOG_ERASE_POLL_PERIOD  (10 * 1000 * 10)
+
+///
+/// Number of polls the SEL erase is given to complete.
+///
+#define BMC_ELOG_ERASE_POLL_COUNT  0x200
+
+#define BMC_ELOG_CLEAR_SEL_INITIATE_ERASE    0xAA
+#define BMC_ELOG_CLEAR_SEL_GET_ERASE_STATUS  0x00
+#define BMC_ELOG_CLEAR_SEL_ERASE_COMPLETED   0x01
+
+///
+/// SEL information queried once per boot, see BmcElogGetSelInfo.
+///
+IPMI_GET_SEL_INFO_RESPONSE  mSelInfo;
+BOOLEAN                     mSelInfoValid = FALSE;
+
+///
+/// Events, reservation ID and remaining polls of the SEL erase in progress.
+///
+EFI_EVENT  mSelEraseEvent         = NULL;
+EFI_EVENT  mSelEraseExitBootEvent = NULL;
+UINT8      mSelEraseReservationId[2];
+UINTN      mSelErasePollCount;
+
+/**
+  This function returns the SEL information. The SEL Info command is sent
+  to BMC at the first call only, the following calls return the cached
+  information until the SEL is changed by this driver.
+
+  @param [out]  SelInfo   Pointer to receive the SEL information.
+
+  @retval  EFI_SUCCESS        SelInfo is returned.
+  @retval  EFI_DEVICE_ERROR   BMC fails to return the SEL information.
+
+**/
 EFI_STATUS
-EFIAPI
-CheckIfSelIsFull (
-  VOID
-  );
+BmcElogGetSelInfo (
+  OUT IPMI_GET_SEL_INFO_RESPONSE  *SelInfo
+  )
+{
+  EFI_STATUS  Status;
+
+  if (!mSelInfoValid) {
+    Status = IpmiGetSelInfo (&mSelInfo);
+    if (EFI_ERROR (Status) || (mSelInfo.CompletionCode != IPMI_COMP_CODE_NORMAL)) {
+      DEBUG ((DEBUG_ERROR, "%a: Fail to get SEL info - %r, 0x%x\n", __func__, Status, mSelInfo.CompletionCode));
+      return EFI_DEVICE_ERROR;
+    }
+
+    mSelInfoValid = TRUE;
+  }
+
+  CopyMem (SelInfo, &mSelInfo, sizeof (IPMI_GET_SEL_INFO_RESPONSE));
+  return EFI_SUCCESS;
+}
 
 /**
-  This function erases event logs and waits until complete.
+  This function sends the Clear SEL command with the reservation ID
+  of the SEL erase in progress.
 
-  @param [in]  ResvId              - Reserved ID
+  @param [in]   Erase           BMC_ELOG_CLEAR_SEL_INITIATE_ERASE to initiate the
+                                erase, BMC_ELOG_CLEAR_SEL_GET_ERASE_STATUS to get
+                                the progress of the erase.
+  @param [out]  EraseCompleted  TRUE if the SEL erase is completed.
 
-  @retval  EFI_STATUS               EFI_SUCCESS
-                                    EFI_NO_RESPONSE
+  @retval  EFI_SUCCESS        The Clear SEL command is completed.
+  @retval  EFI_NOT_READY      Another IPMI command is in progress.
+  @retval  EFI_DEVICE_ERROR   BMC fails the Clear SEL command.
 
 **/
 EFI_STATUS
-WaitTillErased (
-  IN  UINT8  *ResvId
+BmcElogClearSel (
+  IN  UINT8    Erase,
+  OUT BOOLEAN  *EraseCompleted
   )
 {
-  INTN                     Counter;
+  EFI_STATUS               Status;
   IPMI_CLEAR_SEL_REQUEST   ClearSel;
   IPMI_CLEAR_SEL_RESPONSE  ClearSelResponse;
 
-  Counter = 0x200;
+  ZeroMem (&ClearSel, sizeof (ClearSel));
   ZeroMem (&ClearSelResponse, sizeof (ClearSelResponse));
+  ClearSel.Reserve[0] = mSelEraseReservationId[0];
+  ClearSel.Reserve[1] = mSelEraseReservationId[1];
+  ClearSel.AscC       = 0x43;
+  ClearSel.AscL       = 0x4C;
+  ClearSel.AscR       = 0x52;
+  ClearSel.Erase      = Erase;
+
+  Status = IpmiClearSel (&ClearSel, &ClearSelResponse);
+  if (Status == EFI_NOT_READY) {
+    return Status;
+  }
 
-  while (TRUE) {
-    ZeroMem (&ClearSel, sizeof (ClearSel));
-    ClearSel.Reserve[0] = ResvId[0];
-    ClearSel.Reserve[1] = ResvId[1];
-    ClearSel.AscC       = 0x43;
-    ClearSel.AscL       = 0x4C;
-    ClearSel.AscR       = 0x52;
-    ClearSel.Erase      = 0x00;
-
-    IpmiClearSel (
-      &ClearSel,
-      &ClearSelResponse
-      );
-
-    if ((ClearSelResponse.ErasureProgress & 0xf) == 1) {
-      return EFI_SUCCESS;
-    }
+  if (EFI_ERROR (Status) || (ClearSelResponse.CompletionCode != IPMI_COMP_CODE_NORMAL)) {
+    return EFI_DEVICE_ERROR;
+  }
 
-    //
-    //  If there is not a response from the BMC controller we need to return and not hang.
-    //
-    --Counter;
-    if (Counter == 0x0) {
-      return EFI_NO_RESPONSE;
-    }
+  *EraseCompleted = (BOOLEAN)((ClearSelResponse.ErasureProgress & 0xf) == BMC_ELOG_CLEAR_SEL_ERASE_COMPLETED);
+  return EFI_SUCCESS;
+}
+
+/**
+  This function stops polling the SEL erase.
+
+  @param [in]  Status   The result of the SEL erase.
+
+**/
+VOID
+BmcElogEraseDone (
+  IN EFI_STATUS  Status
+  )
+{
+  if (mSelEraseEvent != NULL) {
+    gBS->SetTimer (mSelEraseEvent, TimerCancel, 0);
+    gBS->CloseEvent (mSelEraseEvent);
+    mSelEraseEvent = NULL;
+  }
+
+  if (mSelEraseExitBootEvent != NULL) {
+    gBS->CloseEvent (mSelEraseExitBootEvent);
+    mSelEraseExitBootEvent = NULL;
+  }
+
+  //
+  // The SEL information cached before the erase is stale.
+  //
+  mSelInfoValid = FALSE;
+  DEBUG ((DEBUG_MANAGEABILITY_INFO, "%a: SEL erase - %r\n", __func__, Status));
+}
+
+/**
+  Timer notification function polling the progress of the SEL erase,
+  until the erase is completed or BMC stops responding.
+
+  @param [in]  Event    The timer event.
+  @param [in]  Context  Not used.
+
+**/
+VOID
+EFIAPI
+BmcElogErasePollHandler (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  EFI_STATUS  Status;
+  BOOLEAN     EraseCompleted;
+
+  EraseCompleted = FALSE;
+  Status         = BmcElogClearSel (BMC_ELOG_CLEAR_SEL_GET_ERASE_STATUS, &EraseCompleted);
+  if (EraseCompleted) {
+    BmcElogEraseDone (EFI_SUCCESS);
+    return;
+  }
+
+  //
+  // This preempted an IPMI command in progress, poll again next time.
+  //
+  if (Status == EFI_NOT_READY) {
+    return;
+  }
+
+  //
+  //  If there is not a response from the BMC controller we need to give up and not poll forever.
+  //
+  --mSelErasePollCount;
+  if (mSelErasePollCount == 0) {
+    BmcElogEraseDone (EFI_ERROR (Status) ? Status : EFI_NO_RESPONSE);
+  }
+}
+
+/**
+  Notification function of the BeforeExitBootServices event group, which
+  stops polling the SEL erase before OS takes over the BMC. The BMC goes
+  on erasing the SEL on its own.
+
+  @param [in]  Event    The BeforeExitBootServices event.
+  @param [in]  Context  Not used.
+
+**/
+VOID
+EFIAPI
+BmcElogEraseBeforeExitBootServices (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  BmcElogEraseDone (EFI_ABORTED);
+}
+
+/**
+  This function initiates the SEL erase and returns without waiting for
+  the erase to complete. The progress of the erase is polled by a timer
+  event in the background.
+
+  The IPMI commands are sent at TPL_CALLBACK, so that the poll timer and
+  other TPL_CALLBACK users of the IPMI transport can't interleave with them.
+
+  @retval  EFI_SUCCESS          The SEL is erased, or the erase is in progress.
+  @retval  EFI_ALREADY_STARTED  The SEL erase is in progress already.
+  @retval  Otherwise            Fail to initiate the SEL erase.
+
+**/
+EFI_STATUS
+BmcElogStartErase (
+  VOID
+  )
+{
+  EFI_STATUS                 Status;
+  IPMI_RESERVE_SEL_RESPONSE  ReserveSel;
+  BOOLEAN                    EraseCompleted;
+  EFI_TPL                    OldTpl;
+
+  if (mSelEraseEvent != NULL) {
+    return EFI_ALREADY_STARTED;
   }
+
+  ZeroMem (&ReserveSel, sizeof (ReserveSel));
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  Status = IpmiReserveSel (&ReserveSel);
+  gBS->RestoreTPL (OldTpl);
+  if (EFI_ERROR (Status) || (ReserveSel.CompletionCode != IPMI_COMP_CODE_NORMAL)) {
+    DEBUG ((DEBUG_ERROR, "%a: Fail to reserve SEL - %r, 0x%x\n", __func__, Status, ReserveSel.CompletionCode));
+    return EFI_DEVICE_ERROR;
+  }
+
+  mSelEraseReservationId[0] = ReserveSel.ReservationId[0];
+  mSelEraseReservationId[1] = ReserveSel.ReservationId[1];
+
+  EraseCompleted = FALSE;
+  OldTpl         = gBS->RaiseTPL (TPL_CALLBACK);
+  Status         = BmcElogClearSel (BMC_ELOG_CLEAR_SEL_INITIATE_ERASE, &EraseCompleted);
+  gBS->RestoreTPL (OldTpl);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: Fail to initiate SEL erase - %r\n", __func__, Status));
+    return Status;
+  }
+
+  if (EraseCompleted) {
+    BmcElogEraseDone (EFI_SUCCESS);
+    return EFI_SUCCESS;
+  }
+
+  Status = gBS->CreateEvent (
+                  EVT_TIMER | EVT_NOTIFY_SIGNAL,
+                  TPL_CALLBACK,
+                  BmcElogErasePollHandler,
+                  NULL,
+                  &mSelEraseEvent
+                  );
+  if (EFI_ERROR (Status)) {
+    mSelEraseEvent = NULL;
+    return Status;
+  }
+
+  //
+  // Stop polling when OS takes over, should the erase still be in progress.
+  //
+  Status = gBS->CreateEventEx (
+                  EVT_NOTIFY_SIGNAL,
+                  TPL_CALLBACK,
+                  BmcElogEraseBeforeExitBootServices,
+                  NULL,
+                  &gEfiEventBeforeExitBootServicesGuid,
+                  &mSelEraseExitBootEvent
+                  );
+  if (EFI_ERROR (Status)) {
+    mSelEraseExitBootEvent = NULL;
+    BmcElogEraseDone (Status);
+    return Status;
+  }
+
+  mSelErasePollCount = BMC_ELOG_ERASE_POLL_COUNT;
+  Status             = gBS->SetTimer (mSelEraseEvent, TimerPeriodic, BMC_ELOG_ERASE_POLL_PERIOD);
+  if (EFI_ERROR (Status)) {
+    BmcElogEraseDone (Status);
+  }
+
+  return Status;
 }
 
 /**
@@ -140,55 +373,64 @@ SetElogRedirInstall (
 }
 
 /**
-  Entry point of BmcElog DXE driver
+  This function verifies the BMC SEL is full and When it is
+  reports the error to the Error Manager.
 
-  @param [in]  ImageHandle  ImageHandle of the loaded driver
-  @param [in]  SystemTable  Pointer to the System Table
+  @param [out]  SelIsFull   TRUE if the SEL is full.
 
   @retval  EFI_STATUS
 
 **/
 EFI_STATUS
-EFIAPI
-InitializeBmcElogLayer (
-  IN EFI_HANDLE        ImageHandle,
-  IN EFI_SYSTEM_TABLE  *SystemTable
+CheckIfSelIsFull (
+  OUT BOOLEAN  *SelIsFull
   )
 {
-  SetElogRedirInstall ();
+  EFI_STATUS                  Status;
+  IPMI_GET_SEL_INFO_RESPONSE  SelInfo;
 
-  CheckIfSelIsFull ();
+  Status = BmcElogGetSelInfo (&SelInfo);
+  if (EFI_ERROR (Status)) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  //
+  // Check the Bit7 of the OperationByte if SEL is OverFlow.
+  //
+  *SelIsFull = (BOOLEAN)((SelInfo.OperationSupport & 0x80) != 0);
+  DEBUG ((DEBUG_MANAGEABILITY_INFO, "SelIsFull - 0x%x\n", *SelIsFull));
 
   return EFI_SUCCESS;
 }
 
 /**
-  This function verifies the BMC SEL is full and When it is
-  reports the error to the Error Manager.
+  Entry point of BmcElog DXE driver
+
+  @param [in]  ImageHandle  ImageHandle of the loaded driver
+  @param [in]  SystemTable  Pointer to the System Table
 
   @retval  EFI_STATUS
 
 **/
 EFI_STATUS
 EFIAPI
-CheckIfSelIsFull (
-  VOID
+InitializeBmcElogLayer (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
   )
 {
-  EFI_STATUS                  Status;
-  UINT8                       SelIsFull;
-  IPMI_GET_SEL_INFO_RESPONSE  SelInfo;
+  EFI_STATUS  Status;
+  BOOLEAN     SelIsFull;
 
-  Status = IpmiGetSelInfo (&SelInfo);
-  if (EFI_ERROR (Status)) {
-    return EFI_DEVICE_ERROR;
-  }
+  SetElogRedirInstall ();
 
-  //
-  // Check the Bit7 of the OperationByte if SEL is OverFlow.
-  //
-  SelIsFull = (SelInfo.OperationSupport & 0x80);
-  DEBUG ((DEBUG_MANAGEABILITY_INFO, "SelIsFull - 0x%x\n", SelIsFull));
+  Status = CheckIfSelIsFull (&SelIsFull);
+  if (!EFI_ERROR (Status) && SelIsFull && FixedPcdGetBool (PcdBmcElogClearSelWhenFull)) {
+    //
+    // The erase is polled in the background, the dispatch goes on.
+    //
+    BmcElogStartErase ();
+  }
 
   return EFI_SUCCESS;
 }
@@ -7,14 +7,34 @@
 
 **/
 #include <Uefi.h>
+#include <IndustryStandard/Ipmi.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/MemoryAllocationLib.h>
+#include <Library/ManageabilityTransportHelperLib.h>
 #include <Library/ManageabilityTransportIpmiLib.h>
 #include <Library/ManageabilityTransportLib.h>
 
 #include "IpmiProtocolCommon.h"
 
+///
+/// The IPMI commands whose responses are cached. They are idempotent and
+/// their responses don't change in a boot unless BMC is reset. SEL info
+/// is not, as it changes with each SEL entry added.
+///
+typedef struct {
+  UINT8    NetFunction;
+  UINT8    Command;
+} IPMI_CACHEABLE_COMMAND;
+
+GLOBAL_REMOVE_IF_UNREFERENCED CONST IPMI_CACHEABLE_COMMAND  mIpmiCacheableCommands[] = {
+  { IPMI_NETFN_APP, IPMI_APP_GET_DEVICE_ID        },
+  { IPMI_NETFN_APP, IPMI_APP_GET_SELFTEST_RESULTS },
+  { IPMI_NETFN_APP, IPMI_APP_GET_DEVICE_GUID      },
+  { IPMI_NETFN_APP, IPMI_APP_GET_SYSTEM_GUID      },
+  { IPMI_NETFN_APP, IPMI_APP_GET_CHANNEL_INFO     }
+};
+
 /**
   This functions setup the IPMI transport hardware information according
   to the specification of transport token acquired from transport library.
@@ -138,10 +158,129 @@ SetupIpmiRequestTransportPacket (
   return EFI_SUCCESS;
 }
 
+/**
+  This function finds the cached response of an IPMI command.
+
+  @param[in]         ResponseCache     The cached responses.
+  @param[in]         NetFunction       Net function of the command.
+  @param[in]         Command           IPMI Command.
+  @param[in]         RequestData       Command Request Data.
+  @param[in]         RequestDataSize   Size of Command Request Data.
+
+  @retval The cached response, or NULL if the response is not cached.
+**/
+IPMI_RESPONSE_CACHE_ENTRY *
+IpmiResponseCacheFind (
+  IN  IPMI_RESPONSE_CACHE  *ResponseCache,
+  IN  UINT8                NetFunction,
+  IN  UINT8                Command,
+  IN  UINT8                *RequestData OPTIONAL,
+  IN  UINT32               RequestDataSize
+  )
+{
+  UINT32                     Index;
+  IPMI_RESPONSE_CACHE_ENTRY  *Entry;
+
+  if ((RequestDataSize > IPMI_RESPONSE_CACHE_MAX_REQUEST_SIZE) ||
+      ((RequestData == NULL) && (RequestDataSize != 0)))
+  {
+    return NULL;
+  }
+
+  for (Index = 0; Index < ResponseCache->Count; Index++) {
+    Entry = &ResponseCache->Entry[Index];
+    if ((Entry->NetFunction == NetFunction) && (Entry->Command == Command) &&
+        (Entry->RequestDataSize == RequestDataSize) &&
+        (CompareMem (Entry->RequestData, RequestData, RequestDataSize) == 0))
+    {
+      return Entry;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  This function updates the cached responses with the result of an IPMI
+  command. The successful response of a cacheable command is cached. All
+  responses are dropped if BMC is reset, or it fails to respond.
+
+  @param[in, out]    ResponseCache     The cached responses.
+  @param[in]         NetFunction       Net function of the command.
+  @param[in]         Command           IPMI Command.
+  @param[in]         RequestData       Command Request Data.
+  @param[in]         RequestDataSize   Size of Command Request Data.
+  @param[in]         Status            Status of the command.
+  @param[in]         ResponseData      Command Response Data.
+  @param[in]         ResponseDataSize  Size of Command Response Data.
+**/
+VOID
+IpmiResponseCacheUpdate (
+  IN OUT IPMI_RESPONSE_CACHE  *ResponseCache,
+  IN     UINT8                NetFunction,
+  IN     UINT8                Command,
+  IN     UINT8                *RequestData OPTIONAL,
+  IN     UINT32               RequestDataSize,
+  IN     EFI_STATUS           Status,
+  IN     UINT8                *ResponseData OPTIONAL,
+  IN     UINT32               ResponseDataSize
+  )
+{
+  UINTN                      Index;
+  IPMI_RESPONSE_CACHE_ENTRY  *Entry;
+
+  if (EFI_ERROR (Status) ||
+      ((NetFunction == IPMI_NETFN_APP) && ((Command == IPMI_APP_COLD_RESET) || (Command == IPMI_APP_WARM_RESET))))
+  {
+    if (ResponseCache->Count != 0) {
+      DEBUG ((DEBUG_MANAGEABILITY_INFO, "%a: Invalidate cached IPMI responses.\n", __func__));
+      ResponseCache->Count = 0;
+    }
+
+    return;
+  }
+
+  for (Index = 0; Index < ARRAY_SIZE (mIpmiCacheableCommands); Index++) {
+    if ((mIpmiCacheableCommands[Index].NetFunction == NetFunction) &&
+        (mIpmiCacheableCommands[Index].Command == Command))
+    {
+      break;
+    }
+  }
+
+  if ((Index == ARRAY_SIZE (mIpmiCacheableCommands)) ||
+      (ResponseCache->Count == IPMI_RESPONSE_CACHE_ENTRIES) ||
+      (RequestDataSize > IPMI_RESPONSE_CACHE_MAX_REQUEST_SIZE) ||
+      ((RequestData == NULL) && (RequestDataSize != 0)) ||
+      (ResponseData == NULL) || (ResponseDataSize == 0) ||
+      (ResponseDataSize > IPMI_RESPONSE_CACHE_MAX_RESPONSE_SIZE) ||
+      (ResponseData[0] != IPMI_COMP_CODE_NORMAL))
+  {
+    return;
+  }
+
+  if (IpmiResponseCacheFind (ResponseCache, NetFunction, Command, RequestData, RequestDataSize) != NULL) {
+    return;
+  }
+
+  Entry                   = &ResponseCache->Entry[ResponseCache->Count];
+  Entry->NetFunction      = NetFunction;
+  Entry->Command          = Command;
+  Entry->RequestDataSize  = (UINT8)RequestDataSize;
+  Entry->ResponseDataSize = (UINT8)ResponseDataSize;
+  CopyMem (Entry->RequestData, RequestData, RequestDataSize);
+  CopyMem (Entry->ResponseData, ResponseData, ResponseDataSize);
+  ResponseCache->Count++;
+}
+
 /**
   Common code to submit IPMI commands
 
+  The responses of the idempotent commands that don't change in a boot
+  are returned from ResponseCache once they are received.
+
   @param[in]         TransportToken    TRansport token.
+  @param[in, out]    ResponseCache     The cached responses, NULL to not cache responses.
   @param[in]         NetFunction       Net function of the command.
   @param[in]         Command           IPMI Command.
   @param[in]         RequestData       Command Request Data.
@@ -160,6 +299,7 @@ SetupIpmiRequestTransportPacket (
 EFI_STATUS
 CommonIpmiSubmitCommand (
   IN     MANAGEABILITY_TRANSPORT_TOKEN  *TransportToken,
+  IN OUT IPMI_RESPONSE_CACHE            *ResponseCache OPTIONAL,
   IN     UINT8                          NetFunction,
   IN     UINT8                          Command,
   IN     UINT8                          *RequestData OPTIONAL,
@@ -177,18 +317,33 @@ CommonIpmiSubmitCommand (
   MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS  TransportAdditionalStatus;
   UINT16                                     HeaderSize;
   UINT16                                     TrailerSize;
+  IPMI_RESPONSE_CACHE_ENTRY                  *CachedResponse;
 
   if (TransportToken == NULL) {
     DEBUG ((DEBUG_ERROR, "%a: No transport toke for IPMI\n", __func__));
     return EFI_UNSUPPORTED;
   }
 
+  if ((ResponseCache != NULL) && (ResponseData != NULL) && (ResponseDataSize != NULL)) {
+    CachedResponse = IpmiResponseCacheFind (ResponseCache, NetFunction, Command, RequestData, RequestDataSize);
+    if ((CachedResponse != NULL) && (CachedResponse->ResponseDataSize <= *ResponseDataSize)) {
+      DEBUG ((DEBUG_MANAGEABILITY_INFO, "%a: Cached response of NetFn 0x%x Command 0x%x.\n", __func__, NetFunction, Command));
+      CopyMem (ResponseData, CachedResponse->ResponseData, CachedResponse->ResponseDataSize);
+      *ResponseDataSize = CachedResponse->ResponseDataSize;
+      return EFI_SUCCESS;
+    }
+  }
+
   Status = TransportToken->Transport->Function.Version1_0->TransportStatus (
                                                              TransportToken,
                                                              &TransportAdditionalStatus
                                                              );
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "%a: Transport for IPMI has problem - (%r)\n", __func__, Status));
+    if (ResponseCache != NULL) {
+      IpmiResponseCacheUpdate (ResponseCache, NetFunction, Command, RequestData, RequestDataSize, Status, NULL, 0);
+    }
+
     return Status;
   }
 
@@ -255,14 +410,27 @@ CommonIpmiSubmitCommand (
   //
   Status                    = TransferToken.TransferStatus;
   TransportAdditionalStatus = TransferToken.TransportAdditionalStatus;
+  if (!EFI_ERROR (Status) && (ResponseDataSize != NULL)) {
+    *ResponseDataSize = TransferToken.ReceivePackage.ReceiveSizeInByte;
+  }
+
+  if (ResponseCache != NULL) {
+    IpmiResponseCacheUpdate (
+      ResponseCache,
+      NetFunction,
+      Command,
+      RequestData,
+      RequestDataSize,
+      Status,
+      ResponseData,
+      (ResponseDataSize != NULL) ? *ResponseDataSize : 0
+      );
+  }
+
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "%a: Failed to send IPMI command.\n", __func__));
     return Status;
   }
 
-  if (ResponseDataSize != NULL) {
-    *ResponseDataSize = TransferToken.ReceivePackage.ReceiveSizeInByte;
-  }
-
   return Status;
 }
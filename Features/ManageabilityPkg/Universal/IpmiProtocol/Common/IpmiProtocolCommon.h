@@ -10,6 +10,7 @@
 #define MANAGEABILITY_IPMI_COMMON_H_
 
 #include <IndustryStandard/IpmiKcs.h>
+#include <Guid/IpmiResponseCacheHob.h>
 #include <Library/ManageabilityTransportLib.h>
 
 ///
@@ -82,7 +83,11 @@ SetupIpmiRequestTransportPacket (
 /**
   Common code to submit IPMI commands
 
+  The responses of the idempotent commands that don't change in a boot
+  are returned from ResponseCache once they are received.
+
   @param[in]         TransportToken    TRansport token.
+  @param[in, out]    ResponseCache     The cached responses, NULL to not cache responses.
   @param[in]         NetFunction       Net function of the command.
   @param[in]         Command           IPMI Command.
   @param[in]         RequestData       Command Request Data.
@@ -101,6 +106,7 @@ SetupIpmiRequestTransportPacket (
 EFI_STATUS
 CommonIpmiSubmitCommand (
   IN     MANAGEABILITY_TRANSPORT_TOKEN  *TransportToken,
+  IN OUT IPMI_RESPONSE_CACHE            *ResponseCache OPTIONAL,
   IN     UINT8                          NetFunction,
   IN     UINT8                          Command,
   IN     UINT8                          *RequestData OPTIONAL,
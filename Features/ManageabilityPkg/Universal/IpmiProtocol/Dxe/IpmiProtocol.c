@@ -12,15 +12,56 @@
 #include <Library/ManageabilityTransportLib.h>
 #include <Library/ManageabilityTransportIpmiLib.h>
 #include <Library/ManageabilityTransportHelperLib.h>
+#include <Library/HobLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Protocol/IpmiProtocol.h>
 
 #include "IpmiProtocolCommon.h"
+#include "IpmiProtocolDxe.h"
 
 MANAGEABILITY_TRANSPORT_TOKEN                 *mTransportToken = NULL;
 CHAR16                                        *mTransportName;
 UINT32                                        TransportMaximumPayload;
 MANAGEABILITY_TRANSPORT_HARDWARE_INFORMATION  mHardwareInformation;
+IPMI_RESPONSE_CACHE                           mIpmiResponseCache;
+BOOLEAN                                       mIpmiTransportBusy = FALSE;
+
+/**
+  This function claims the transport interface for a command, so that a
+  command submitted at a higher TPL doesn't interleave with the one in
+  progress.
+
+  @retval TRUE   The transport interface is claimed.
+  @retval FALSE  A command is in progress on the transport interface.
+**/
+BOOLEAN
+IpmiClaimTransport (
+  VOID
+  )
+{
+  EFI_TPL  OldTpl;
+  BOOLEAN  Claimed;
+
+  OldTpl  = gBS->RaiseTPL (TPL_NOTIFY);
+  Claimed = !mIpmiTransportBusy;
+  if (Claimed) {
+    mIpmiTransportBusy = TRUE;
+  }
+
+  gBS->RestoreTPL (OldTpl);
+  return Claimed;
+}
+
+/**
+  This function releases the transport interface claimed by IpmiClaimTransport.
+**/
+VOID
+IpmiReleaseTransport (
+  VOID
+  )
+{
+  mIpmiTransportBusy = FALSE;
+}
 
 /**
   This service enables submitting commands via Ipmi.
@@ -55,8 +96,17 @@ DxeIpmiSubmitCommand (
 {
   EFI_STATUS  Status;
 
+  //
+  // Only possible when this is called at a higher TPL than the command
+  // in progress, which must not be interleaved with.
+  //
+  if (!IpmiClaimTransport ()) {
+    return EFI_NOT_READY;
+  }
+
   Status = CommonIpmiSubmitCommand (
              mTransportToken,
+             &mIpmiResponseCache,
              NetFunction,
              Command,
              RequestData,
@@ -64,6 +114,7 @@ DxeIpmiSubmitCommand (
              ResponseData,
              ResponseDataSize
              );
+  IpmiReleaseTransport ();
   return Status;
 }
 
@@ -91,6 +142,16 @@ DxeIpmiEntry (
   EFI_HANDLE                                 Handle;
   MANAGEABILITY_TRANSPORT_CAPABILITY         TransportCapability;
   MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS  TransportAdditionalStatus;
+  EFI_HOB_GUID_TYPE                          *GuidHob;
+
+  //
+  // Continue with the responses cached in PEI.
+  //
+  GuidHob = GetFirstGuidHob (&gManageabilityIpmiResponseCacheHobGuid);
+  if ((GuidHob != NULL) && (GET_GUID_HOB_DATA_SIZE (GuidHob) == sizeof (IPMI_RESPONSE_CACHE))) {
+    CopyMem (&mIpmiResponseCache, GET_GUID_HOB_DATA (GuidHob), sizeof (IPMI_RESPONSE_CACHE));
+    DEBUG ((DEBUG_MANAGEABILITY_INFO, "%a: %d IPMI responses cached in PEI.\n", __func__, mIpmiResponseCache.Count));
+  }
 
   Status = HelperAcquireManageabilityTransport (
              &gManageabilityProtocolIpmiGuid,
@@ -152,9 +213,14 @@ DxeIpmiEntry (
                   );
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "%a: Failed to install IPMI protocol - %r\n", __func__, Status));
+    return Status;
   }
 
-  return Status;
+  //
+  // The asynchronous submission is optional, IPMI protocol works without it.
+  //
+  IpmiAsyncInstall (Handle);
+  return EFI_SUCCESS;
 }
 
 /**
@@ -176,6 +242,8 @@ IpmiUnloadImage (
 {
   EFI_STATUS  Status;
 
+  IpmiAsyncUnload ();
+
   Status = EFI_SUCCESS;
   if (mTransportToken != NULL) {
     Status = ReleaseTransportSession (mTransportToken);
@@ -0,0 +1,549 @@
+/** @file
+  This file provides EDKII IPMI Asynchronous Protocol implementation.
+
+  The commands are queued in a bounded queue and submitted one per
+  IPMI_ASYNC_POLL_PERIOD by a timer event, so the callers sending
+  notifications to BMC don't wait for the transport interface.
+
+  Copyright (C) 2023 Advanced Micro Devices, Inc. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#include <PiDxe.h>
+#include <Guid/EventGroup.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/ManageabilityTransportHelperLib.h>
+
+#include "IpmiProtocolCommon.h"
+#include "IpmiProtocolDxe.h"
+
+IPMI_ASYNC_COMMAND  *mIpmiAsyncQueue = NULL;
+UINT32              mIpmiAsyncQueueDepth;
+UINT32              mIpmiAsyncQueueHead;
+UINT32              mIpmiAsyncQueueCount;
+BOOLEAN             mIpmiAsyncTimerArmed = FALSE;
+EFI_EVENT           mIpmiAsyncTimerEvent = NULL;
+EFI_EVENT           mIpmiAsyncBeforeExitBootServicesEvent = NULL;
+
+/**
+  This function returns the time elapsed since a performance counter value.
+
+  @param[in]  StartTicks  Performance counter value to measure from.
+
+  @retval     UINT64      Elapsed time in milliseconds.
+**/
+STATIC
+UINT64
+IpmiAsyncElapsedTimeInMs (
+  IN UINT64  StartTicks
+  )
+{
+  UINT64  CurrentTicks;
+  UINT64  StartValue;
+  UINT64  EndValue;
+
+  CurrentTicks = GetPerformanceCounter ();
+  GetPerformanceCounterProperties (&StartValue, &EndValue);
+
+  // The counter may count down
+  if (StartValue > EndValue) {
+    return DivU64x32 (GetTimeInNanoSecond (StartTicks - CurrentTicks), 1000 * 1000);
+  }
+
+  return DivU64x32 (GetTimeInNanoSecond (CurrentTicks - StartTicks), 1000 * 1000);
+}
+
+/**
+  This function completes a command removed from the queue.
+
+  @param[in]  AsyncCommand      The command.
+  @param[in]  Status            Status of the command.
+  @param[in]  ResponseDataSize  Size of the response received.
+**/
+STATIC
+VOID
+IpmiAsyncComplete (
+  IN IPMI_ASYNC_COMMAND  *AsyncCommand,
+  IN EFI_STATUS          Status,
+  IN UINT32              ResponseDataSize
+  )
+{
+  if (AsyncCommand->RequestData != NULL) {
+    FreePool (AsyncCommand->RequestData);
+  }
+
+  if (AsyncCommand->Token != NULL) {
+    AsyncCommand->Token->ResponseDataSize = ResponseDataSize;
+    AsyncCommand->Token->Status           = Status;
+    if (AsyncCommand->Token->Event != NULL) {
+      gBS->SignalEvent (AsyncCommand->Token->Event);
+    }
+  } else if (EFI_ERROR (Status)) {
+    DEBUG ((
+      DEBUG_MANAGEABILITY_INFO,
+      "%a: IPMI command NetFn 0x%x Cmd 0x%x - %r\n",
+      __func__,
+      AsyncCommand->NetFunction,
+      AsyncCommand->Command,
+      Status
+      ));
+  }
+}
+
+/**
+  This function arms or cancels the timer submitting the queued commands
+  according to whether the queue is empty. Called at TPL_NOTIFY.
+**/
+STATIC
+VOID
+IpmiAsyncUpdateTimer (
+  VOID
+  )
+{
+  if ((mIpmiAsyncQueueCount != 0) && !mIpmiAsyncTimerArmed) {
+    if (!EFI_ERROR (gBS->SetTimer (mIpmiAsyncTimerEvent, TimerPeriodic, IPMI_ASYNC_POLL_PERIOD))) {
+      mIpmiAsyncTimerArmed = TRUE;
+    }
+  } else if ((mIpmiAsyncQueueCount == 0) && mIpmiAsyncTimerArmed) {
+    gBS->SetTimer (mIpmiAsyncTimerEvent, TimerCancel, 0);
+    mIpmiAsyncTimerArmed = FALSE;
+  }
+}
+
+/**
+  This function submits the command at the head of the queue and
+  waits for it.
+
+  @retval EFI_SUCCESS     A command is completed.
+  @retval EFI_NOT_FOUND   The queue is empty.
+  @retval EFI_NOT_READY   A command is in progress on the transport interface.
+**/
+STATIC
+EFI_STATUS
+IpmiAsyncRunNext (
+  VOID
+  )
+{
+  EFI_TPL             OldTpl;
+  IPMI_ASYNC_COMMAND  AsyncCommand;
+  EFI_STATUS          Status;
+  UINT8               DiscardResponse[IPMI_ASYNC_DISCARD_RESPONSE_SIZE];
+  UINT8               *ResponseData;
+  UINT32              ResponseDataSize;
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  if (mIpmiAsyncQueueCount == 0) {
+    gBS->RestoreTPL (OldTpl);
+    return EFI_NOT_FOUND;
+  }
+
+  if (!IpmiClaimTransport ()) {
+    gBS->RestoreTPL (OldTpl);
+    return EFI_NOT_READY;
+  }
+
+  CopyMem (&AsyncCommand, &mIpmiAsyncQueue[mIpmiAsyncQueueHead], sizeof (IPMI_ASYNC_COMMAND));
+  mIpmiAsyncQueueHead = (mIpmiAsyncQueueHead + 1) % mIpmiAsyncQueueDepth;
+  mIpmiAsyncQueueCount--;
+  IpmiAsyncUpdateTimer ();
+  gBS->RestoreTPL (OldTpl);
+
+  //
+  // A command that waited too long is stale, e.g. a watchdog kick,
+  // drop it without holding up the ones behind it.
+  //
+  if ((AsyncCommand.TimeoutInMillisecond != MANAGEABILITY_TRANSPORT_NO_TIMEOUT) &&
+      (IpmiAsyncElapsedTimeInMs (AsyncCommand.QueuedTicks) > AsyncCommand.TimeoutInMillisecond))
+  {
+    IpmiReleaseTransport ();
+    IpmiAsyncComplete (&AsyncCommand, EFI_TIMEOUT, 0);
+    return EFI_SUCCESS;
+  }
+
+  if ((AsyncCommand.Token != NULL) && (AsyncCommand.Token->ResponseData != NULL)) {
+    ResponseData     = AsyncCommand.Token->ResponseData;
+    ResponseDataSize = AsyncCommand.Token->ResponseDataSize;
+  } else {
+    ResponseData     = DiscardResponse;
+    ResponseDataSize = sizeof (DiscardResponse);
+  }
+
+  Status = CommonIpmiSubmitCommand (
+             mTransportToken,
+             &mIpmiResponseCache,
+             AsyncCommand.NetFunction,
+             AsyncCommand.Command,
+             AsyncCommand.RequestData,
+             AsyncCommand.RequestDataSize,
+             ResponseData,
+             &ResponseDataSize
+             );
+  IpmiReleaseTransport ();
+  if (ResponseData == DiscardResponse) {
+    ResponseDataSize = 0;
+  }
+
+  IpmiAsyncComplete (&AsyncCommand, Status, ResponseDataSize);
+  return EFI_SUCCESS;
+}
+
+/**
+  Timer notification function submitting a queued command.
+
+  @param[in]  Event    The timer event.
+  @param[in]  Context  Not used.
+**/
+STATIC
+VOID
+EFIAPI
+IpmiAsyncTimerHandler (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  IpmiAsyncRunNext ();
+}
+
+/**
+  This service queues an IPMI command and returns without waiting for it.
+  The queued commands are submitted to BMC in order in the background.
+  The request data is copied, so the caller may free it on return.
+
+  @param[in]  This                  EDKII_IPMI_ASYNC_PROTOCOL instance.
+  @param[in]  NetFunction           Net function of the command.
+  @param[in]  Command               IPMI Command.
+  @param[in]  RequestData           Command Request Data.
+  @param[in]  RequestDataSize       Size of Command Request Data.
+  @param[in]  TimeoutInMillisecond  The time the command can wait in the queue,
+                                    after which it is dropped without being sent.
+                                    MANAGEABILITY_TRANSPORT_NO_TIMEOUT means no timeout value.
+  @param[in]  Token                 Token to receive the result of the command.
+                                    NULL to discard the result.
+
+  @retval EFI_SUCCESS            The command is queued.
+  @retval EFI_OUT_OF_RESOURCES   The queue is full or the request data can't be copied.
+  @retval EFI_INVALID_PARAMETER  RequestData is NULL but RequestDataSize is not 0.
+**/
+EFI_STATUS
+EFIAPI
+DxeIpmiAsyncSubmitCommand (
+  IN     EDKII_IPMI_ASYNC_PROTOCOL  *This,
+  IN     UINT8                      NetFunction,
+  IN     UINT8                      Command,
+  IN     UINT8                      *RequestData OPTIONAL,
+  IN     UINT32                     RequestDataSize,
+  IN     UINT32                     TimeoutInMillisecond,
+  IN     EDKII_IPMI_ASYNC_TOKEN     *Token OPTIONAL
+  )
+{
+  EFI_TPL             OldTpl;
+  UINT8               *RequestDataCopy;
+  IPMI_ASYNC_COMMAND  *AsyncCommand;
+
+  if ((RequestData == NULL) && (RequestDataSize != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  RequestDataCopy = NULL;
+  if (RequestDataSize != 0) {
+    RequestDataCopy = AllocateCopyPool (RequestDataSize, RequestData);
+    if (RequestDataCopy == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  if (mIpmiAsyncQueueCount == mIpmiAsyncQueueDepth) {
+    gBS->RestoreTPL (OldTpl);
+    if (RequestDataCopy != NULL) {
+      FreePool (RequestDataCopy);
+    }
+
+    DEBUG ((DEBUG_ERROR, "%a: IPMI command queue is full.\n", __func__));
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (Token != NULL) {
+    Token->Status = EFI_NOT_READY;
+  }
+
+  AsyncCommand                       = &mIpmiAsyncQueue[(mIpmiAsyncQueueHead + mIpmiAsyncQueueCount) % mIpmiAsyncQueueDepth];
+  AsyncCommand->NetFunction          = NetFunction;
+  AsyncCommand->Command              = Command;
+  AsyncCommand->RequestData          = RequestDataCopy;
+  AsyncCommand->RequestDataSize      = RequestDataSize;
+  AsyncCommand->TimeoutInMillisecond = TimeoutInMillisecond;
+  AsyncCommand->QueuedTicks          = GetPerformanceCounter ();
+  AsyncCommand->Token                = Token;
+  mIpmiAsyncQueueCount++;
+  IpmiAsyncUpdateTimer ();
+  gBS->RestoreTPL (OldTpl);
+
+  return EFI_SUCCESS;
+}
+
+/**
+  This service removes a command from the queue before it is submitted.
+  The Status of the token is set to EFI_ABORTED and its Event is signaled.
+
+  @param[in]  This    EDKII_IPMI_ASYNC_PROTOCOL instance.
+  @param[in]  Token   Token of the command.
+
+  @retval EFI_SUCCESS     The command is cancelled.
+  @retval EFI_NOT_FOUND   The command is not in the queue, it is completed
+                          already or in progress.
+**/
+EFI_STATUS
+EFIAPI
+DxeIpmiAsyncCancel (
+  IN     EDKII_IPMI_ASYNC_PROTOCOL  *This,
+  IN     EDKII_IPMI_ASYNC_TOKEN     *Token
+  )
+{
+  EFI_TPL             OldTpl;
+  UINT32              Index;
+  UINT32              Slot;
+  IPMI_ASYNC_COMMAND  AsyncCommand;
+
+  if (Token == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  for (Index = 0; Index < mIpmiAsyncQueueCount; Index++) {
+    if (mIpmiAsyncQueue[(mIpmiAsyncQueueHead + Index) % mIpmiAsyncQueueDepth].Token == Token) {
+      break;
+    }
+  }
+
+  if (Index == mIpmiAsyncQueueCount) {
+    gBS->RestoreTPL (OldTpl);
+    return EFI_NOT_FOUND;
+  }
+
+  //
+  // Close the gap to keep the order of the commands behind it.
+  //
+  Slot = (mIpmiAsyncQueueHead + Index) % mIpmiAsyncQueueDepth;
+  CopyMem (&AsyncCommand, &mIpmiAsyncQueue[Slot], sizeof (IPMI_ASYNC_COMMAND));
+  for ( ; Index + 1 < mIpmiAsyncQueueCount; Index++) {
+    Slot = (mIpmiAsyncQueueHead + Index) % mIpmiAsyncQueueDepth;
+    CopyMem (
+      &mIpmiAsyncQueue[Slot],
+      &mIpmiAsyncQueue[(Slot + 1) % mIpmiAsyncQueueDepth],
+      sizeof (IPMI_ASYNC_COMMAND)
+      );
+  }
+
+  mIpmiAsyncQueueCount--;
+  IpmiAsyncUpdateTimer ();
+  gBS->RestoreTPL (OldTpl);
+
+  IpmiAsyncComplete (&AsyncCommand, EFI_ABORTED, 0);
+  return EFI_SUCCESS;
+}
+
+/**
+  This service submits all the queued commands and waits for them,
+  for the callers that need the queue drained, e.g. before handing
+  the BMC over to OS.
+
+  @param[in]  This    EDKII_IPMI_ASYNC_PROTOCOL instance.
+
+  @retval EFI_SUCCESS     The queue is empty.
+  @retval EFI_NOT_READY   The queue is being drained by an interrupted caller.
+**/
+EFI_STATUS
+EFIAPI
+DxeIpmiAsyncFlush (
+  IN     EDKII_IPMI_ASYNC_PROTOCOL  *This
+  )
+{
+  EFI_STATUS  Status;
+
+  do {
+    Status = IpmiAsyncRunNext ();
+  } while (Status == EFI_SUCCESS);
+
+  if (Status == EFI_NOT_FOUND) {
+    return EFI_SUCCESS;
+  }
+
+  return Status;
+}
+
+/**
+  This function completes every command still in the queue with an error,
+  for when the queue can't be drained because the transport interface is
+  claimed by an interrupted caller.
+
+  @param[in]  Status  Status to complete the commands with.
+**/
+STATIC
+VOID
+IpmiAsyncAbortAll (
+  IN EFI_STATUS  Status
+  )
+{
+  EFI_TPL             OldTpl;
+  IPMI_ASYNC_COMMAND  AsyncCommand;
+
+  while (TRUE) {
+    OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+    if (mIpmiAsyncQueueCount == 0) {
+      IpmiAsyncUpdateTimer ();
+      gBS->RestoreTPL (OldTpl);
+      break;
+    }
+
+    CopyMem (&AsyncCommand, &mIpmiAsyncQueue[mIpmiAsyncQueueHead], sizeof (IPMI_ASYNC_COMMAND));
+    mIpmiAsyncQueueHead = (mIpmiAsyncQueueHead + 1) % mIpmiAsyncQueueDepth;
+    mIpmiAsyncQueueCount--;
+    gBS->RestoreTPL (OldTpl);
+
+    DEBUG ((
+      DEBUG_ERROR,
+      "%a: IPMI command NetFn 0x%x Cmd 0x%x dropped - %r\n",
+      __func__,
+      AsyncCommand.NetFunction,
+      AsyncCommand.Command,
+      Status
+      ));
+    IpmiAsyncComplete (&AsyncCommand, Status, 0);
+  }
+}
+
+EDKII_IPMI_ASYNC_PROTOCOL_V1_0  mIpmiAsyncProtocolV10 = {
+  DxeIpmiAsyncSubmitCommand,
+  DxeIpmiAsyncCancel,
+  DxeIpmiAsyncFlush
+};
+
+EDKII_IPMI_ASYNC_PROTOCOL  mIpmiAsyncProtocol;
+
+/**
+  Notification function of the BeforeExitBootServices event group, which
+  sends the notifications still queued before OS takes over the BMC.
+  This runs before the memory map is finalized, so the commands may still
+  be completed, which frees memory and signals the token events.
+
+  @param[in]  Event    The BeforeExitBootServices event.
+  @param[in]  Context  Not used.
+**/
+STATIC
+VOID
+EFIAPI
+IpmiAsyncBeforeExitBootServices (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  if (EFI_ERROR (DxeIpmiAsyncFlush (&mIpmiAsyncProtocol))) {
+    IpmiAsyncAbortAll (EFI_NOT_READY);
+  }
+}
+
+/**
+  This function sets up the command queue and installs
+  EDKII_IPMI_ASYNC_PROTOCOL.
+
+  @param[in]  Handle   Handle to install the protocol on.
+
+  @retval EFI_SUCCESS  EDKII_IPMI_ASYNC_PROTOCOL is installed.
+  @retval Otherwise    Other errors.
+**/
+EFI_STATUS
+IpmiAsyncInstall (
+  IN EFI_HANDLE  Handle
+  )
+{
+  EFI_STATUS  Status;
+
+  mIpmiAsyncQueueDepth = MAX (FixedPcdGet8 (PcdIpmiAsyncQueueDepth), 1);
+  mIpmiAsyncQueue      = AllocateZeroPool (mIpmiAsyncQueueDepth * sizeof (IPMI_ASYNC_COMMAND));
+  if (mIpmiAsyncQueue == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = gBS->CreateEvent (
+                  EVT_TIMER | EVT_NOTIFY_SIGNAL,
+                  TPL_CALLBACK,
+                  IpmiAsyncTimerHandler,
+                  NULL,
+                  &mIpmiAsyncTimerEvent
+                  );
+  if (EFI_ERROR (Status)) {
+    IpmiAsyncUnload ();
+    return Status;
+  }
+
+  Status = gBS->CreateEventEx (
+                  EVT_NOTIFY_SIGNAL,
+                  TPL_CALLBACK,
+                  IpmiAsyncBeforeExitBootServices,
+                  NULL,
+                  &gEfiEventBeforeExitBootServicesGuid,
+                  &mIpmiAsyncBeforeExitBootServicesEvent
+                  );
+  if (EFI_ERROR (Status)) {
+    IpmiAsyncUnload ();
+    return Status;
+  }
+
+  mIpmiAsyncProtocol.ProtocolVersion      = EDKII_IPMI_ASYNC_PROTOCOL_VERSION;
+  mIpmiAsyncProtocol.Functions.Version1_0 = &mIpmiAsyncProtocolV10;
+  Status                                  = gBS->InstallProtocolInterface (
+                                                   &Handle,
+                                                   &gEdkiiIpmiAsyncProtocolGuid,
+                                                   EFI_NATIVE_INTERFACE,
+                                                   (VOID **)&mIpmiAsyncProtocol
+                                                   );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: Failed to install IPMI async protocol - %r\n", __func__, Status));
+    IpmiAsyncUnload ();
+  }
+
+  return Status;
+}
+
+/**
+  This function completes the queued commands and releases the
+  resources of EDKII_IPMI_ASYNC_PROTOCOL.
+**/
+VOID
+IpmiAsyncUnload (
+  VOID
+  )
+{
+  if ((mIpmiAsyncQueue != NULL) && EFI_ERROR (DxeIpmiAsyncFlush (&mIpmiAsyncProtocol))) {
+    IpmiAsyncAbortAll (EFI_ABORTED);
+  }
+
+  if (mIpmiAsyncTimerEvent != NULL) {
+    gBS->CloseEvent (mIpmiAsyncTimerEvent);
+    mIpmiAsyncTimerEvent = NULL;
+    mIpmiAsyncTimerArmed = FALSE;
+  }
+
+  if (mIpmiAsyncBeforeExitBootServicesEvent != NULL) {
+    gBS->CloseEvent (mIpmiAsyncBeforeExitBootServicesEvent);
+    mIpmiAsyncBeforeExitBootServicesEvent = NULL;
+  }
+
+  if (mIpmiAsyncQueue != NULL) {
+    FreePool (mIpmiAsyncQueue);
+    mIpmiAsyncQueue = NULL;
+  }
+
+  //
+  // Reject the commands submitted after unload as the queue is full.
+  //
+  mIpmiAsyncQueueDepth = 0;
+  mIpmiAsyncQueueCount = 0;
+}
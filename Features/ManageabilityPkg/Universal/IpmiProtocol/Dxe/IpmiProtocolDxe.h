@@ -0,0 +1,86 @@
+/** @file
+  IPMI Protocol DXE driver internal header file.
+
+  Copyright (C) 2023 Advanced Micro Devices, Inc. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef IPMI_PROTOCOL_DXE_H_
+#define IPMI_PROTOCOL_DXE_H_
+
+#include <Guid/IpmiResponseCacheHob.h>
+#include <Library/ManageabilityTransportLib.h>
+#include <Protocol/IpmiAsyncProtocol.h>
+
+///
+/// Period of submitting the commands queued by EDKII_IPMI_ASYNC_PROTOCOL,
+/// in 100ns units. One command is submitted in each period.
+///
+#define IPMI_ASYNC_POLL_PERIOD  (10 * 1000 * 10)
+
+///
+/// Size of the buffer receiving the responses nobody waits for.
+///
+#define IPMI_ASYNC_DISCARD_RESPONSE_SIZE  0x100
+
+///
+/// An IPMI command queued by EDKII_IPMI_ASYNC_PROTOCOL.
+///
+typedef struct {
+  UINT8                     NetFunction;
+  UINT8                     Command;
+  UINT8                     *RequestData;         ///< Copy of the request data.
+  UINT32                    RequestDataSize;
+  UINT32                    TimeoutInMillisecond; ///< Time the command can wait in the queue.
+  UINT64                    QueuedTicks;          ///< Performance counter when queued.
+  EDKII_IPMI_ASYNC_TOKEN    *Token;
+} IPMI_ASYNC_COMMAND;
+
+extern MANAGEABILITY_TRANSPORT_TOKEN  *mTransportToken;
+extern IPMI_RESPONSE_CACHE            mIpmiResponseCache;
+
+/**
+  This function claims the transport interface for a command, so that a
+  command submitted at a higher TPL doesn't interleave with the one in
+  progress.
+
+  @retval TRUE   The transport interface is claimed.
+  @retval FALSE  A command is in progress on the transport interface.
+**/
+BOOLEAN
+IpmiClaimTransport (
+  VOID
+  );
+
+/**
+  This function releases the transport interface claimed by IpmiClaimTransport.
+**/
+VOID
+IpmiReleaseTransport (
+  VOID
+  );
+
+/**
+  This function sets up the command queue and installs
+  EDKII_IPMI_ASYNC_PROTOCOL.
+
+  @param[in]  Handle   Handle to install the protocol on.
+
+  @retval EFI_SUCCESS  EDKII_IPMI_ASYNC_PROTOCOL is installed.
+  @retval Otherwise    Other errors.
+**/
+EFI_STATUS
+IpmiAsyncInstall (
+  IN EFI_HANDLE  Handle
+  );
+
+/**
+  This function completes the queued commands and releases the
+  resources of EDKII_IPMI_ASYNC_PROTOCOL.
+**/
+VOID
+IpmiAsyncUnload (
+  VOID
+  );
+
+#endif
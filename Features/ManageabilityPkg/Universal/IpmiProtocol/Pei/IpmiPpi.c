@@ -13,6 +13,7 @@
 #include <Library/ManageabilityTransportLib.h>
 #include <Library/ManageabilityTransportIpmiLib.h>
 #include <Library/ManageabilityTransportHelperLib.h>
+#include <Library/HobLib.h>
 #include <Library/PeiServicesLib.h>
 
 #include <Ppi/IpmiPpi.h>
@@ -20,6 +21,34 @@
 #include "IpmiProtocolCommon.h"
 #include "IpmiPpiInternal.h"
 
+/**
+  This function returns the cached IPMI responses, which are kept in
+  a GUID HOB to be continued with by IPMI DXE driver. The HOB is looked
+  up each time, as it is moved when PEI memory is installed.
+
+  @retval The cached responses, or NULL if the HOB can't be built.
+**/
+IPMI_RESPONSE_CACHE *
+PeiGetIpmiResponseCache (
+  VOID
+  )
+{
+  EFI_HOB_GUID_TYPE    *GuidHob;
+  IPMI_RESPONSE_CACHE  *ResponseCache;
+
+  GuidHob = GetFirstGuidHob (&gManageabilityIpmiResponseCacheHobGuid);
+  if (GuidHob != NULL) {
+    return (IPMI_RESPONSE_CACHE *)GET_GUID_HOB_DATA (GuidHob);
+  }
+
+  ResponseCache = BuildGuidHob (&gManageabilityIpmiResponseCacheHobGuid, sizeof (IPMI_RESPONSE_CACHE));
+  if (ResponseCache != NULL) {
+    ZeroMem (ResponseCache, sizeof (IPMI_RESPONSE_CACHE));
+  }
+
+  return ResponseCache;
+}
+
 /**
   This service enables submitting commands via Ipmi.
 
@@ -57,6 +86,7 @@ PeiIpmiSubmitCommand (
   PeiIpmiPpiinternal = MANAGEABILITY_IPMI_PPI_INTERNAL_FROM_LINK (This);
   Status             = CommonIpmiSubmitCommand (
                          PeiIpmiPpiinternal->TransportToken,
+                         PeiGetIpmiResponseCache (),
                          NetFunction,
                          Command,
                          RequestData,
@@ -56,8 +56,13 @@ SmmIpmiSubmitCommand (
 {
   EFI_STATUS  Status;
 
+  //
+  // Responses are not cached in SMM, as BMC can be reset by OS
+  // without going through SMM.
+  //
   Status = CommonIpmiSubmitCommand (
              mTransportToken,
+             NULL,
              NetFunction,
              Command,
              RequestData,
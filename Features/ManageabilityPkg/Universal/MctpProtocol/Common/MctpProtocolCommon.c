@@ -22,9 +22,8 @@ extern CHAR16  *mTransportName;
 extern UINT32  mTransportMaximumPayload;
 
 MANAGEABILITY_TRANSPORT_HARDWARE_INFORMATION  mHardwareInformation;
-UINT8                                         mMctpPacketSequence;
-BOOLEAN                                       mStartOfMessage;
-BOOLEAN                                       mEndOfMessage;
+MCTP_OUTSTANDING_REQUEST                      mMctpRequests[MCTP_MESSAGE_TAGS];
+UINT8                                         mMctpNextMessageTag;
 
 /**
   This functions setup the MCTP transport hardware information according
@@ -84,8 +83,76 @@ SetupMctpTransportHardwareInformation (
 }
 
 /**
-  This functions setup the final header/body/trailer packets for
-  the acquired transport interface.
+  This function initializes an iterator over the fragments of a message.
+
+  @param[out]        Iterator             The iterator.
+  @param[in]         Message              The message, which may be NULL if MessageSize is 0.
+  @param[in]         MessageSize          Size of the message in byte.
+  @param[in]         MaximumTransferUnit  Maximum size of an MCTP packet, with its
+                                          transport and message header.
+**/
+VOID
+MctpInitFragmentIterator (
+  OUT  MCTP_FRAGMENT_ITERATOR  *Iterator,
+  IN   UINT8                   *Message,
+  IN   UINT32                  MessageSize,
+  IN   UINT32                  MaximumTransferUnit
+  )
+{
+  ASSERT (MaximumTransferUnit > sizeof (MCTP_TRANSPORT_HEADER) + sizeof (MCTP_MESSAGE_HEADER));
+
+  Iterator->Message             = Message;
+  Iterator->MessageSize         = MessageSize;
+  Iterator->Offset              = 0;
+  Iterator->MaximumTransferUnit = MaximumTransferUnit;
+  Iterator->PacketSequence      = 0;
+  Iterator->Done                = FALSE;
+}
+
+/**
+  This function returns the next fragment of a message. The fragment
+  points into the message, nothing is allocated or copied.
+
+  @param[in, out]    Iterator             The iterator.
+  @param[out]        Fragment             The pointer to receive the fragment.
+
+  @retval TRUE       The fragment is returned.
+  @retval FALSE      All the fragments of the message have been returned.
+**/
+BOOLEAN
+MctpGetNextFragment (
+  IN OUT  MCTP_FRAGMENT_ITERATOR  *Iterator,
+  OUT     MCTP_FRAGMENT           *Fragment
+  )
+{
+  UINT32  Capacity;
+
+  if (Iterator->Done) {
+    return FALSE;
+  }
+
+  // Only the first packet carries the message header.
+  Capacity = Iterator->MaximumTransferUnit - sizeof (MCTP_TRANSPORT_HEADER);
+  if (Iterator->Offset == 0) {
+    Capacity -= sizeof (MCTP_MESSAGE_HEADER);
+  }
+
+  Fragment->StartOfMessage = (BOOLEAN)(Iterator->Offset == 0);
+  Fragment->PayloadSize    = MIN (Capacity, Iterator->MessageSize - Iterator->Offset);
+  Fragment->Payload        = (Fragment->PayloadSize != 0) ? Iterator->Message + Iterator->Offset : NULL;
+  Fragment->PacketSequence = Iterator->PacketSequence;
+
+  Iterator->Offset        += Fragment->PayloadSize;
+  Iterator->PacketSequence = (Iterator->PacketSequence + 1) & MCTP_PACKET_SEQUENCE_MASK;
+  Iterator->Done           = (BOOLEAN)(Iterator->Offset == Iterator->MessageSize);
+  Fragment->EndOfMessage   = Iterator->Done;
+  return TRUE;
+}
+
+/**
+  This functions setup the header and trailer of a request packet for
+  the acquired transport interface. The fragment itself is sent as the
+  packet body.
 
   @param[in]         TransportToken             The transport interface.
   @param[in]         MctpType                   MCTP message type.
@@ -93,50 +160,37 @@ SetupMctpTransportHardwareInformation (
   @param[in]         MctpDestinationEndpointId  MCTP source endpoint ID.
   @param[in]         RequestDataIntegrityCheck  Indicates whether MCTP message has
                                                 integrity check byte.
-  @param[out]        PacketHeader               The pointer to receive header of request.
+  @param[in]         MessageTag                 Message tag of the request.
+  @param[in]         Fragment                   The fragment sent in the packet.
+  @param[out]        PacketHeader               The buffer to receive the packet header.
   @param[out]        PacketHeaderSize           Packet header size.
-  @param[in, out]    PacketBody                 The request body.
-                                                When IN, it is the caller's request body.
-                                                When OUT and NULL, the request body is not
-                                                changed.
-                                                Whee out and non-NULL, the request body is
-                                                changed to comfort the transport interface.
-  @param[in, out]    PacketBodySize             The request body size.
-                                                When IN and non-zero, it is the new data
-                                                length of request body.
-                                                When IN and zero, the request body is unchanged.
-  @param[out]        PacketTrailer              The pointer to receive trailer of request.
+  @param[out]        PacketTrailer              The buffer to receive the packet trailer.
   @param[out]        PacketTrailerSize          Packet trailer size.
 
   @retval EFI_SUCCESS            Request packet is returned.
-  @retval EFI_OUT_OF_RESOURCE    Not enough resource to create the request
-                                 transport packets.
+  @retval EFI_INVALID_PARAMETER  The fragment doesn't fit in an MCTP packet.
   @retval EFI_UNSUPPORTED        Request packet is not returned because
                                  the unsupported transport interface.
 **/
 EFI_STATUS
 SetupMctpRequestTransportPacket (
-  IN   MANAGEABILITY_TRANSPORT_TOKEN    *TransportToken,
-  IN   UINT8                            MctpType,
-  IN   UINT8                            MctpSourceEndpointId,
-  IN   UINT8                            MctpDestinationEndpointId,
-  IN   BOOLEAN                          RequestDataIntegrityCheck,
-  OUT  MANAGEABILITY_TRANSPORT_HEADER   *PacketHeader,
-  OUT  UINT16                           *PacketHeaderSize,
-  IN   OUT UINT8                        **PacketBody,
-  IN   OUT UINT32                       *PacketBodySize,
-  OUT  MANAGEABILITY_TRANSPORT_TRAILER  *PacketTrailer,
-  OUT  UINT16                           *PacketTrailerSize
+  IN   MANAGEABILITY_TRANSPORT_TOKEN  *TransportToken,
+  IN   UINT8                          MctpType,
+  IN   UINT8                          MctpSourceEndpointId,
+  IN   UINT8                          MctpDestinationEndpointId,
+  IN   BOOLEAN                        RequestDataIntegrityCheck,
+  IN   UINT8                          MessageTag,
+  IN   MCTP_FRAGMENT                  *Fragment,
+  OUT  MCTP_KCS_PACKET_HEADER         *PacketHeader,
+  OUT  UINT16                         *PacketHeaderSize,
+  OUT  UINT8                          *PacketTrailer,
+  OUT  UINT16                         *PacketTrailerSize
   )
 {
-  MANAGEABILITY_MCTP_KCS_HEADER  *MctpKcsHeader;
-  MCTP_TRANSPORT_HEADER          *MctpTransportHeader;
-  MCTP_MESSAGE_HEADER            *MctpMessageHeader;
-  UINT8                          *Pec;
-  UINT8                          *ThisPackage;
-
-  if ((PacketHeader == NULL) || (PacketHeaderSize == NULL) ||
-      (PacketBody == NULL) || (PacketBodySize == NULL) ||
+  UINT32  MctpHeaderSize;
+  UINT8   Pec;
+
+  if ((Fragment == NULL) || (PacketHeader == NULL) || (PacketHeaderSize == NULL) ||
       (PacketTrailer == NULL) || (PacketTrailerSize == NULL)
       )
   {
@@ -145,61 +199,48 @@ SetupMctpRequestTransportPacket (
   }
 
   if (CompareGuid (&gManageabilityTransportKcsGuid, TransportToken->Transport->ManageabilityTransportSpecification)) {
-    MctpKcsHeader = (MANAGEABILITY_MCTP_KCS_HEADER *)AllocateZeroPool (sizeof (MANAGEABILITY_MCTP_KCS_HEADER));
-    if (MctpKcsHeader == NULL) {
-      DEBUG ((DEBUG_ERROR, "%a: Not enough resource for MANAGEABILITY_MCTP_KCS_HEADER.\n", __func__));
-      return EFI_OUT_OF_RESOURCES;
+    MctpHeaderSize = sizeof (MCTP_TRANSPORT_HEADER);
+    if (Fragment->StartOfMessage) {
+      MctpHeaderSize += sizeof (MCTP_MESSAGE_HEADER);
     }
 
-    Pec = (UINT8 *)AllocateZeroPool (sizeof (UINT8));
-    if (Pec == NULL) {
-      DEBUG ((DEBUG_ERROR, "%a: Not enough resource for PEC.\n", __func__));
-      FreePool (MctpKcsHeader);
-      return EFI_OUT_OF_RESOURCES;
+    if (MctpHeaderSize + Fragment->PayloadSize > MAX_UINT8) {
+      DEBUG ((DEBUG_ERROR, "%a: Fragment size 0x%x doesn't fit in a packet.\n", __func__, Fragment->PayloadSize));
+      return EFI_INVALID_PARAMETER;
     }
 
     // Generate MCTP KCS transport header
-    MctpKcsHeader->DefiningBody = DEFINING_BODY_DMTF_PRE_OS_WORKING_GROUP;
-    MctpKcsHeader->NetFunc      = MCTP_KCS_NETFN_LUN;
-    MctpKcsHeader->ByteCount    = (UINT8)(MIN (mTransportMaximumPayload, *PacketBodySize + (UINT8)sizeof (MCTP_MESSAGE_HEADER) + (UINT8)sizeof (MCTP_TRANSPORT_HEADER)));
-
-    ThisPackage = (UINT8 *)AllocateZeroPool (MctpKcsHeader->ByteCount);
-    if (ThisPackage == NULL) {
-      DEBUG ((DEBUG_ERROR, "%a: Not enough resource for package.\n", __func__));
-      FreePool (MctpKcsHeader);
-      FreePool (Pec);
-      return EFI_OUT_OF_RESOURCES;
-    }
+    ZeroMem (PacketHeader, sizeof (MCTP_KCS_PACKET_HEADER));
+    PacketHeader->KcsHeader.DefiningBody = DEFINING_BODY_DMTF_PRE_OS_WORKING_GROUP;
+    PacketHeader->KcsHeader.NetFunc      = MCTP_KCS_NETFN_LUN;
+    PacketHeader->KcsHeader.ByteCount    = (UINT8)(MctpHeaderSize + Fragment->PayloadSize);
 
     // Setup MCTP transport header
-    MctpTransportHeader                             = (MCTP_TRANSPORT_HEADER *)ThisPackage;
-    MctpTransportHeader->Bits.Reserved              = 0;
-    MctpTransportHeader->Bits.HeaderVersion         = MCTP_KCS_HEADER_VERSION;
-    MctpTransportHeader->Bits.DestinationEndpointId = PcdGet8 (PcdMctpDestinationEndpointId);
-    MctpTransportHeader->Bits.SourceEndpointIdId    = PcdGet8 (PcdMctpSourceEndpointId);
-    MctpTransportHeader->Bits.MessageTag            = MCTP_MESSAGE_TAG;
-    MctpTransportHeader->Bits.TagOwner              = MCTP_MESSAGE_TAG_OWNER_REQUEST;
-    MctpTransportHeader->Bits.PacketSequence        = mMctpPacketSequence & MCTP_PACKET_SEQUENCE_MASK;
-    MctpTransportHeader->Bits.StartOfMessage        = mStartOfMessage ? 1 : 0;
-    MctpTransportHeader->Bits.EndOfMessage          = mEndOfMessage ? 1 : 0;
+    PacketHeader->TransportHeader.Bits.HeaderVersion         = MCTP_KCS_HEADER_VERSION;
+    PacketHeader->TransportHeader.Bits.DestinationEndpointId = PcdGet8 (PcdMctpDestinationEndpointId);
+    PacketHeader->TransportHeader.Bits.SourceEndpointIdId    = PcdGet8 (PcdMctpSourceEndpointId);
+    PacketHeader->TransportHeader.Bits.MessageTag            = MessageTag;
+    PacketHeader->TransportHeader.Bits.TagOwner              = MCTP_MESSAGE_TAG_OWNER_REQUEST;
+    PacketHeader->TransportHeader.Bits.PacketSequence        = Fragment->PacketSequence;
+    PacketHeader->TransportHeader.Bits.StartOfMessage        = Fragment->StartOfMessage ? 1 : 0;
+    PacketHeader->TransportHeader.Bits.EndOfMessage          = Fragment->EndOfMessage ? 1 : 0;
 
     // Setup MCTP message header
-    MctpMessageHeader                      = (MCTP_MESSAGE_HEADER *)(MctpTransportHeader + 1);
-    MctpMessageHeader->Bits.MessageType    = MctpType;
-    MctpMessageHeader->Bits.IntegrityCheck = RequestDataIntegrityCheck ? 1 : 0;
-
-    // Copy payload
-    CopyMem ((VOID *)(MctpMessageHeader + 1), (VOID *)*PacketBody, *PacketBodySize);
+    if (Fragment->StartOfMessage) {
+      PacketHeader->MessageHeader.Bits.MessageType    = MctpType;
+      PacketHeader->MessageHeader.Bits.IntegrityCheck = RequestDataIntegrityCheck ? 1 : 0;
+    }
 
     //
-    // Generate PEC follow SMBUS 2.0 specification.
-    *Pec = HelperManageabilityGenerateCrc8 (MCTP_KCS_PACKET_ERROR_CODE_POLY, 0, ThisPackage, MctpKcsHeader->ByteCount);
-
-    *PacketBody        = (UINT8 *)ThisPackage;
-    *PacketBodySize    = MctpKcsHeader->ByteCount;
-    *PacketTrailer     = (MANAGEABILITY_TRANSPORT_TRAILER)Pec;
-    *PacketHeader      = (MANAGEABILITY_TRANSPORT_HEADER)MctpKcsHeader;
-    *PacketHeaderSize  = sizeof (MANAGEABILITY_MCTP_KCS_HEADER);
+    // Generate PEC follow SMBUS 2.0 specification, over the MCTP
+    // headers and then the fragment, which isn't copied.
+    Pec = HelperManageabilityGenerateCrc8 (MCTP_KCS_PACKET_ERROR_CODE_POLY, 0, (UINT8 *)&PacketHeader->TransportHeader, MctpHeaderSize);
+    if (Fragment->Payload != NULL) {
+      Pec = HelperManageabilityGenerateCrc8 (MCTP_KCS_PACKET_ERROR_CODE_POLY, Pec, Fragment->Payload, Fragment->PayloadSize);
+    }
+
+    *PacketHeaderSize  = (UINT16)(sizeof (MANAGEABILITY_MCTP_KCS_HEADER) + MctpHeaderSize);
+    *PacketTrailer     = Pec;
     *PacketTrailerSize = 1;
     return EFI_SUCCESS;
   } else {
@@ -207,11 +248,161 @@ SetupMctpRequestTransportPacket (
     ASSERT (FALSE);
   }
 
-  return EFI_SUCCESS;
+  return EFI_UNSUPPORTED;
 }
 
 /**
-  Common code to submit MCTP message
+  This function releases the message tag of a request.
+
+  @param[in]         MessageTag     The message tag.
+**/
+STATIC
+VOID
+MctpReleaseMessageTag (
+  IN UINT8  MessageTag
+  )
+{
+  if (mMctpRequests[MessageTag].Response != NULL) {
+    FreePool (mMctpRequests[MessageTag].Response);
+  }
+
+  ZeroMem (&mMctpRequests[MessageTag], sizeof (MCTP_OUTSTANDING_REQUEST));
+}
+
+/**
+  This function appends a fragment to the response being reassembled.
+
+  @param[in]         Request        The request of the response.
+  @param[in]         Payload        The fragment.
+  @param[in]         PayloadSize    Size of the fragment in byte.
+**/
+STATIC
+VOID
+MctpAppendResponse (
+  IN MCTP_OUTSTANDING_REQUEST  *Request,
+  IN UINT8                     *Payload,
+  IN UINT32                    PayloadSize
+  )
+{
+  UINT32  NewBufferSize;
+  UINT8   *NewBuffer;
+
+  if (Request->ResponseSize + PayloadSize > Request->ResponseBufferSize) {
+    NewBufferSize = MAX (Request->ResponseBufferSize * 2, Request->ResponseSize + PayloadSize);
+    NewBuffer     = ReallocatePool (Request->ResponseBufferSize, NewBufferSize, Request->Response);
+    if (NewBuffer == NULL) {
+      DEBUG ((DEBUG_ERROR, "%a: Not enough resource to reassemble the response.\n", __func__));
+      Request->ResponseStatus   = EFI_OUT_OF_RESOURCES;
+      Request->ResponseComplete = TRUE;
+      return;
+    }
+
+    Request->Response           = NewBuffer;
+    Request->ResponseBufferSize = NewBufferSize;
+  }
+
+  CopyMem (Request->Response + Request->ResponseSize, Payload, PayloadSize);
+  Request->ResponseSize += PayloadSize;
+}
+
+/**
+  This function reassembles a received packet into the response
+  of the outstanding request with its message tag. Invalid packets
+  and packets of no outstanding request are dropped.
+
+  @param[in]         Packet         The packet, with its KCS header and PEC.
+  @param[in]         PacketSize     Size of the packet in byte.
+**/
+STATIC
+VOID
+MctpReassemblePacket (
+  IN UINT8   *Packet,
+  IN UINT32  PacketSize
+  )
+{
+  MCTP_KCS_PACKET_HEADER    *Header;
+  MCTP_OUTSTANDING_REQUEST  *Request;
+  UINT8                     *Payload;
+  UINT32                    PayloadSize;
+  UINT8                     PacketSequence;
+
+  Header = (MCTP_KCS_PACKET_HEADER *)Packet;
+  if ((PacketSize < sizeof (MANAGEABILITY_MCTP_KCS_HEADER) + sizeof (MCTP_TRANSPORT_HEADER) + 1) ||
+      (Header->KcsHeader.DefiningBody != DEFINING_BODY_DMTF_PRE_OS_WORKING_GROUP) ||
+      (Header->KcsHeader.ByteCount != PacketSize - sizeof (MANAGEABILITY_MCTP_KCS_HEADER) - 1))
+  {
+    DEBUG ((DEBUG_ERROR, "%a: Drop malformed packet of size 0x%x.\n", __func__, PacketSize));
+    return;
+  }
+
+  if (HelperManageabilityGenerateCrc8 (
+        MCTP_KCS_PACKET_ERROR_CODE_POLY,
+        0,
+        (UINT8 *)&Header->TransportHeader,
+        Header->KcsHeader.ByteCount
+        ) != Packet[PacketSize - 1])
+  {
+    DEBUG ((DEBUG_ERROR, "%a: Drop packet with incorrect PEC.\n", __func__));
+    return;
+  }
+
+  Request = &mMctpRequests[Header->TransportHeader.Bits.MessageTag];
+  if ((Header->TransportHeader.Bits.TagOwner != MCTP_MESSAGE_TAG_OWNER_RESPONSE) ||
+      !Request->InUse || Request->ResponseComplete ||
+      (Header->TransportHeader.Bits.SourceEndpointIdId != Request->ResponderEndpointId))
+  {
+    DEBUG ((DEBUG_ERROR, "%a: Drop packet of no outstanding request, tag %d.\n", __func__, Header->TransportHeader.Bits.MessageTag));
+    return;
+  }
+
+  Payload        = (UINT8 *)(&Header->TransportHeader + 1);
+  PayloadSize    = Header->KcsHeader.ByteCount - sizeof (MCTP_TRANSPORT_HEADER);
+  PacketSequence = (UINT8)Header->TransportHeader.Bits.PacketSequence;
+
+  if (Header->TransportHeader.Bits.StartOfMessage != 0) {
+    if ((PayloadSize < sizeof (MCTP_MESSAGE_HEADER)) ||
+        (Header->MessageHeader.Bits.MessageType != Request->MctpType))
+    {
+      DEBUG ((DEBUG_ERROR, "%a: Drop response of unexpected message type.\n", __func__));
+      return;
+    }
+
+    // Restart the reassembly if the previous response was cut short.
+    Request->ResponseStarted    = TRUE;
+    Request->ResponseSize       = 0;
+    Request->NextPacketSequence = PacketSequence;
+    Payload                    += sizeof (MCTP_MESSAGE_HEADER);
+    PayloadSize                -= sizeof (MCTP_MESSAGE_HEADER);
+  } else if (!Request->ResponseStarted) {
+    DEBUG ((DEBUG_ERROR, "%a: Drop packet before the start of message, tag %d.\n", __func__, Header->TransportHeader.Bits.MessageTag));
+    return;
+  }
+
+  if (PacketSequence != Request->NextPacketSequence) {
+    DEBUG ((
+      DEBUG_ERROR,
+      "%a: Lost packets of response, tag %d: sequence %d (Expected %d).\n",
+      __func__,
+      Header->TransportHeader.Bits.MessageTag,
+      PacketSequence,
+      Request->NextPacketSequence
+      ));
+    Request->ResponseStatus   = EFI_PROTOCOL_ERROR;
+    Request->ResponseComplete = TRUE;
+    return;
+  }
+
+  Request->NextPacketSequence = (PacketSequence + 1) & MCTP_PACKET_SEQUENCE_MASK;
+  MctpAppendResponse (Request, Payload, PayloadSize);
+
+  if (Header->TransportHeader.Bits.EndOfMessage != 0) {
+    Request->ResponseComplete = TRUE;
+  }
+}
+
+/**
+  Common code to send an MCTP request, which stays outstanding
+  until its response is received by CommonMctpReceiveResponse.
 
   @param[in]         TransportToken             Transport token.
   @param[in]         MctpType                   MCTP message type.
@@ -223,25 +414,15 @@ SetupMctpRequestTransportPacket (
   @param[in]         RequestDataSize            Size of message Data.
   @param[in]         RequestTimeout             Timeout value in milliseconds.
                                                 MANAGEABILITY_TRANSPORT_NO_TIMEOUT means no timeout value.
-  @param[out]        ResponseData               Message Response Data. The completion code is the first byte of response data.
-  @param[in, out]    ResponseDataSize           Size of Message Response Data.
-  @param[in]         ResponseTimeout            Timeout value in milliseconds.
-                                                MANAGEABILITY_TRANSPORT_NO_TIMEOUT means no timeout value.
+  @param[out]        MessageTag                 Message tag to receive the response with.
   @param[out]        AdditionalTransferError    MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS.
 
-  @retval EFI_SUCCESS            The message was successfully send to transport interface and a
-                                 response was successfully received.
-  @retval EFI_NOT_FOUND          The message was not successfully sent to transport interface or a response
-                                 was not successfully received from transport interface.
-  @retval EFI_NOT_READY          MCTP transport interface is not ready for MCTP message.
-  @retval EFI_DEVICE_ERROR       MCTP transport interface Device hardware error.
-  @retval EFI_TIMEOUT            The message time out.
-  @retval EFI_UNSUPPORTED        The message was not successfully sent to the transport interface.
-  @retval EFI_OUT_OF_RESOURCES   The resource allocation is out of resource or data size error.
-  @retval EFI_INVALID_PARAMETER  Both RequestData and ResponseData are NULL
+  @retval EFI_SUCCESS            The message was successfully sent to transport interface.
+  @retval EFI_OUT_OF_RESOURCES   All the message tags are used by outstanding requests.
+  @retval Others                 The message was not sent.
 **/
 EFI_STATUS
-CommonMctpSubmitMessage (
+CommonMctpSendRequest (
   IN     MANAGEABILITY_TRANSPORT_TOKEN              *TransportToken,
   IN     UINT8                                      MctpType,
   IN     UINT8                                      MctpSourceEndpointId,
@@ -250,23 +431,21 @@ CommonMctpSubmitMessage (
   IN     UINT8                                      *RequestData,
   IN     UINT32                                     RequestDataSize,
   IN     UINT32                                     RequestTimeout,
-  OUT    UINT8                                      *ResponseData,
-  IN OUT UINT32                                     *ResponseDataSize,
-  IN     UINT32                                     ResponseTimeout,
+  OUT    UINT8                                      *MessageTag,
   OUT    MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS  *AdditionalTransferError
   )
 {
-  EFI_STATUS                                 Status;
-  UINT16                                     IndexOfPackage;
-  UINT8                                      *ThisRequestData;
-  UINT32                                     ThisRequestDataSize;
-  UINT16                                     MctpTransportHeaderSize;
-  UINT16                                     MctpTransportTrailerSize;
-  MANAGEABILITY_TRANSFER_TOKEN               TransferToken;
-  MANAGEABILITY_TRANSPORT_HEADER             MctpTransportHeader;
-  MANAGEABILITY_TRANSPORT_TRAILER            MctpTransportTrailer;
-  MANAGEABILITY_TRANSMISSION_MULTI_PACKAGES  *MultiPackages;
-  MANAGEABILITY_TRANSMISSION_PACKAGE_ATTR    *ThisPackage;
+  EFI_STATUS                    Status;
+  UINT8                         Index;
+  UINT8                         Tag;
+  UINT32                        MaximumTransferUnit;
+  MCTP_FRAGMENT_ITERATOR        Iterator;
+  MCTP_FRAGMENT                 Fragment;
+  MCTP_KCS_PACKET_HEADER        PacketHeader;
+  UINT16                        PacketHeaderSize;
+  UINT8                         PacketTrailer;
+  UINT16                        PacketTrailerSize;
+  MANAGEABILITY_TRANSFER_TOKEN  TransferToken;
 
   if (TransportToken == NULL) {
     DEBUG ((DEBUG_ERROR, "%a: No transport toke for MCTP\n", __func__));
@@ -282,87 +461,61 @@ CommonMctpSubmitMessage (
     return Status;
   }
 
-  MultiPackages = NULL;
-  Status        = HelperManageabilitySplitPayload (
-                    sizeof (MCTP_TRANSPORT_HEADER) + sizeof (MCTP_MESSAGE_HEADER),
-                    0,
-                    RequestData,
-                    RequestDataSize,
-                    mTransportMaximumPayload,
-                    &MultiPackages
-                    );
-  if (EFI_ERROR (Status) || (MultiPackages == NULL)) {
-    DEBUG ((DEBUG_ERROR, "%a: Fails to split payload into multiple packages - (%r)\n", __func__, mTransportName, Status));
-    return Status;
+  // Allocate the message tag the response is tracked with.
+  for (Index = 0; Index < MCTP_MESSAGE_TAGS; Index++) {
+    Tag = (mMctpNextMessageTag + Index) % MCTP_MESSAGE_TAGS;
+    if (!mMctpRequests[Tag].InUse) {
+      break;
+    }
   }
 
-  // Print transmission packages info.
-  DEBUG ((DEBUG_MANAGEABILITY_INFO, "Manageability Transmission packages:\n"));
-  ThisPackage = (MANAGEABILITY_TRANSMISSION_PACKAGE_ATTR *)(MultiPackages + 1);
-  for (IndexOfPackage = 0; IndexOfPackage < MultiPackages->NumberOfPackages; IndexOfPackage++) {
-    DEBUG ((DEBUG_MANAGEABILITY_INFO, "#%d: \n", IndexOfPackage));
-    DEBUG ((DEBUG_MANAGEABILITY_INFO, "    Packet pointer: 0x%08x\n", ThisPackage->PayloadPointer));
-    DEBUG ((DEBUG_MANAGEABILITY_INFO, "    Packet size   : 0x%08x\n", ThisPackage->PayloadSize));
+  if (Index == MCTP_MESSAGE_TAGS) {
+    DEBUG ((DEBUG_ERROR, "%a: All %d message tags are used by outstanding requests.\n", __func__, MCTP_MESSAGE_TAGS));
+    return EFI_OUT_OF_RESOURCES;
   }
 
-  ThisPackage         = (MANAGEABILITY_TRANSMISSION_PACKAGE_ATTR *)(MultiPackages + 1);
-  mMctpPacketSequence = 0;
-  for (IndexOfPackage = 0; IndexOfPackage < MultiPackages->NumberOfPackages; IndexOfPackage++) {
-    MctpTransportHeader  = NULL;
-    MctpTransportTrailer = NULL;
-    ThisRequestData      = ThisPackage->PayloadPointer;
-    ThisRequestDataSize  = ThisPackage->PayloadSize;
-
-    // Setup Start of Message bit and End of Message bit.
-    if (MultiPackages->NumberOfPackages == 1) {
-      mStartOfMessage = TRUE;
-      mEndOfMessage   = TRUE;
-    } else if (IndexOfPackage == 0) {
-      mStartOfMessage = TRUE;
-      mEndOfMessage   = FALSE;
-    } else if (IndexOfPackage == MultiPackages->NumberOfPackages - 1) {
-      mStartOfMessage = FALSE;
-      mEndOfMessage   = TRUE;
-    } else {
-      mStartOfMessage = FALSE;
-      mEndOfMessage   = FALSE;
-    }
+  mMctpNextMessageTag                    = (Tag + 1) % MCTP_MESSAGE_TAGS;
+  mMctpRequests[Tag].InUse               = TRUE;
+  mMctpRequests[Tag].MctpType            = MctpType;
+  mMctpRequests[Tag].ResponderEndpointId = PcdGet8 (PcdMctpDestinationEndpointId);
+
+  // The packet size is carried in the one-byte KCS byte count.
+  MaximumTransferUnit = MIN (mTransportMaximumPayload, MAX_UINT8);
+  if (MaximumTransferUnit <= sizeof (MCTP_TRANSPORT_HEADER) + sizeof (MCTP_MESSAGE_HEADER)) {
+    MaximumTransferUnit = MAX_UINT8;
+  }
 
+  MctpInitFragmentIterator (&Iterator, RequestData, RequestDataSize, MaximumTransferUnit);
+  while (MctpGetNextFragment (&Iterator, &Fragment)) {
     Status = SetupMctpRequestTransportPacket (
                TransportToken,
                MctpType,
                MctpSourceEndpointId,
                MctpDestinationEndpointId,
                RequestDataIntegrityCheck,
-               &MctpTransportHeader,
-               &MctpTransportHeaderSize,
-               &ThisRequestData,
-               &ThisRequestDataSize,
-               &MctpTransportTrailer,
-               &MctpTransportTrailerSize
+               Tag,
+               &Fragment,
+               &PacketHeader,
+               &PacketHeaderSize,
+               &PacketTrailer,
+               &PacketTrailerSize
                );
     if (EFI_ERROR (Status)) {
       DEBUG ((DEBUG_ERROR, "%a: Fail to build packets - (%r)\n", __func__, Status));
+      MctpReleaseMessageTag (Tag);
       return Status;
     }
 
     ZeroMem (&TransferToken, sizeof (MANAGEABILITY_TRANSFER_TOKEN));
-    TransferToken.TransmitHeader      = MctpTransportHeader;
-    TransferToken.TransmitHeaderSize  = MctpTransportHeaderSize;
-    TransferToken.TransmitTrailer     = MctpTransportTrailer;
-    TransferToken.TransmitTrailerSize = MctpTransportTrailerSize;
-
-    // Transmit packet.
-    if ((ThisRequestData == NULL) || (ThisRequestDataSize == 0)) {
-      // Transmit parameter were not changed by SetupMctpRequestTransportPacket().
-      TransferToken.TransmitPackage.TransmitPayload    = ThisPackage->PayloadPointer;
-      TransferToken.TransmitPackage.TransmitSizeInByte = ThisPackage->PayloadSize;
-    } else {
-      TransferToken.TransmitPackage.TransmitPayload    = ThisRequestData;
-      TransferToken.TransmitPackage.TransmitSizeInByte = ThisRequestDataSize;
-    }
+    TransferToken.TransmitHeader      = (MANAGEABILITY_TRANSPORT_HEADER)&PacketHeader;
+    TransferToken.TransmitHeaderSize  = PacketHeaderSize;
+    TransferToken.TransmitTrailer     = (MANAGEABILITY_TRANSPORT_TRAILER)&PacketTrailer;
+    TransferToken.TransmitTrailerSize = PacketTrailerSize;
 
-    TransferToken.TransmitPackage.TransmitTimeoutInMillisecond = MANAGEABILITY_TRANSPORT_NO_TIMEOUT;
+    // Transmit the fragment in place.
+    TransferToken.TransmitPackage.TransmitPayload              = Fragment.Payload;
+    TransferToken.TransmitPackage.TransmitSizeInByte           = Fragment.PayloadSize;
+    TransferToken.TransmitPackage.TransmitTimeoutInMillisecond = RequestTimeout;
 
     // Receive packet.
     TransferToken.ReceivePackage.ReceiveBuffer                = NULL;
@@ -372,53 +525,40 @@ CommonMctpSubmitMessage (
     // Print out MCTP packet.
     DEBUG ((
       DEBUG_MANAGEABILITY_INFO,
-      "%a: Send MCTP message type: 0x%x, from source endpoint ID: 0x%x to destination ID 0x%x: Request size: 0x%x, Response size: 0x%x\n",
+      "%a: Send MCTP message type: 0x%x, from source endpoint ID: 0x%x to destination ID 0x%x: Tag %d, Sequence %d, Request size: 0x%x\n",
       __func__,
       MctpType,
       MctpSourceEndpointId,
       MctpDestinationEndpointId,
-      TransferToken.TransmitPackage.TransmitSizeInByte,
-      TransferToken.ReceivePackage.ReceiveSizeInByte
+      Tag,
+      Fragment.PacketSequence,
+      TransferToken.TransmitPackage.TransmitSizeInByte
       ));
 
-    if ((MctpTransportHeader != NULL) && (MctpTransportHeaderSize != 0)) {
-      HelperManageabilityDebugPrint (
-        (VOID *)TransferToken.TransmitHeader,
-        (UINT32)TransferToken.TransmitHeaderSize,
-        "MCTP transport header.\n"
-        );
-    }
-
     HelperManageabilityDebugPrint (
-      (VOID *)TransferToken.TransmitPackage.TransmitPayload,
-      TransferToken.TransmitPackage.TransmitSizeInByte,
-      "MCTP full request payload.\n"
+      (VOID *)TransferToken.TransmitHeader,
+      (UINT32)TransferToken.TransmitHeaderSize,
+      "MCTP transport header.\n"
       );
 
-    if ((MctpTransportTrailer != NULL) && (MctpTransportTrailerSize != 0)) {
+    if (Fragment.Payload != NULL) {
       HelperManageabilityDebugPrint (
-        (VOID *)TransferToken.TransmitTrailer,
-        (UINT32)TransferToken.TransmitTrailerSize,
-        "MCTP transport trailer.\n"
+        (VOID *)TransferToken.TransmitPackage.TransmitPayload,
+        TransferToken.TransmitPackage.TransmitSizeInByte,
+        "MCTP full request payload.\n"
         );
     }
 
+    HelperManageabilityDebugPrint (
+      (VOID *)TransferToken.TransmitTrailer,
+      (UINT32)TransferToken.TransmitTrailerSize,
+      "MCTP transport trailer.\n"
+      );
+
     TransportToken->Transport->Function.Version1_0->TransportTransmitReceive (
                                                       TransportToken,
                                                       &TransferToken
                                                       );
-    if (MctpTransportHeader != NULL) {
-      FreePool ((VOID *)MctpTransportHeader);
-    }
-
-    if (MctpTransportTrailer != NULL) {
-      FreePool ((VOID *)MctpTransportTrailer);
-    }
-
-    if (ThisRequestData != NULL) {
-      FreePool ((VOID *)ThisRequestData);
-      ThisRequestData = NULL;
-    }
 
     //
     // Return transfer status.
@@ -427,46 +567,188 @@ CommonMctpSubmitMessage (
     *AdditionalTransferError = TransferToken.TransportAdditionalStatus;
     if (EFI_ERROR (Status)) {
       DEBUG ((DEBUG_ERROR, "%a: Failed to send MCTP command over %s\n", __func__, mTransportName));
-      FreePool (MultiPackages);
+      MctpReleaseMessageTag (Tag);
       return Status;
     }
+  }
+
+  *MessageTag = Tag;
+  return EFI_SUCCESS;
+}
+
+/**
+  Common code to receive the response of an outstanding MCTP request.
+  Packets of the other outstanding requests received meanwhile are
+  reassembled for them. The message tag is released once this returns.
+
+  @param[in]         TransportToken             Transport token.
+  @param[in]         MessageTag                 Message tag returned by CommonMctpSendRequest.
+  @param[out]        ResponseData               Message Response Data.
+  @param[in, out]    ResponseDataSize           Size of Message Response Data.
+  @param[in]         ResponseTimeout            Timeout value in milliseconds.
+                                                MANAGEABILITY_TRANSPORT_NO_TIMEOUT means no timeout value.
+  @param[out]        AdditionalTransferError    MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS.
+
+  @retval EFI_SUCCESS            The response was received.
+  @retval EFI_INVALID_PARAMETER  No request is outstanding with MessageTag.
+  @retval EFI_BUFFER_TOO_SMALL   The response is larger than ResponseData, which
+                                 received its first ResponseDataSize bytes.
+  @retval EFI_PROTOCOL_ERROR     Packets of the response were lost.
+  @retval Others                 The response was not received.
+**/
+EFI_STATUS
+CommonMctpReceiveResponse (
+  IN     MANAGEABILITY_TRANSPORT_TOKEN              *TransportToken,
+  IN     UINT8                                      MessageTag,
+  OUT    UINT8                                      *ResponseData,
+  IN OUT UINT32                                     *ResponseDataSize,
+  IN     UINT32                                     ResponseTimeout,
+  OUT    MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS  *AdditionalTransferError
+  )
+{
+  EFI_STATUS                    Status;
+  MCTP_OUTSTANDING_REQUEST      *Request;
+  MANAGEABILITY_TRANSFER_TOKEN  TransferToken;
+  UINT8                         Packet[sizeof (MANAGEABILITY_MCTP_KCS_HEADER) + MAX_UINT8 + 1];
+
+  if ((TransportToken == NULL) || (ResponseDataSize == NULL) ||
+      ((ResponseData == NULL) && (*ResponseDataSize != 0)))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if ((MessageTag >= MCTP_MESSAGE_TAGS) || !mMctpRequests[MessageTag].InUse) {
+    DEBUG ((DEBUG_ERROR, "%a: No outstanding request with tag %d.\n", __func__, MessageTag));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Request = &mMctpRequests[MessageTag];
+  Status  = EFI_SUCCESS;
+  while (!Request->ResponseComplete) {
+    ZeroMem (&TransferToken, sizeof (MANAGEABILITY_TRANSFER_TOKEN));
+    TransferToken.ReceivePackage.ReceiveBuffer                = Packet;
+    TransferToken.ReceivePackage.ReceiveSizeInByte            = sizeof (Packet);
+    TransferToken.ReceivePackage.TransmitTimeoutInMillisecond = ResponseTimeout;
+
+    DEBUG ((DEBUG_MANAGEABILITY_INFO, "%a: Retrieve MCTP packet for tag %d\n", __func__, MessageTag));
+    TransportToken->Transport->Function.Version1_0->TransportTransmitReceive (
+                                                      TransportToken,
+                                                      &TransferToken
+                                                      );
+    *AdditionalTransferError = TransferToken.TransportAdditionalStatus;
+
+    //
+    // A packet can be shorter than the buffer, and the transport may fail
+    // the transfer for that. The packet is checked by its PEC instead.
+    //
+    if (TransferToken.ReceivePackage.ReceiveSizeInByte == 0) {
+      Status = EFI_ERROR (TransferToken.TransferStatus) ? TransferToken.TransferStatus : EFI_DEVICE_ERROR;
+      DEBUG ((DEBUG_ERROR, "%a: Failed to receive MCTP packet over %s: %r\n", __func__, mTransportName, Status));
+      break;
+    }
+
+    MctpReassemblePacket (Packet, TransferToken.ReceivePackage.ReceiveSizeInByte);
+  }
+
+  if (Request->ResponseComplete) {
+    Status = Request->ResponseStatus;
+  }
+
+  if (!EFI_ERROR (Status)) {
+    if (Request->ResponseSize > *ResponseDataSize) {
+      DEBUG ((DEBUG_ERROR, "%a: Response size 0x%x is larger than the buffer 0x%x.\n", __func__, Request->ResponseSize, *ResponseDataSize));
+      Status = EFI_BUFFER_TOO_SMALL;
+    } else {
+      *ResponseDataSize = Request->ResponseSize;
+    }
 
-    mMctpPacketSequence++;
-    ThisPackage++;
+    if (*ResponseDataSize != 0) {
+      CopyMem (ResponseData, Request->Response, *ResponseDataSize);
+      HelperManageabilityDebugPrint ((VOID *)ResponseData, *ResponseDataSize, "MCTP response payload.\n");
+    }
   }
 
-  // Receive packet.
-  TransferToken.TransmitPackage.TransmitPayload             = NULL;
-  TransferToken.TransmitPackage.TransmitSizeInByte          = 0;
-  TransferToken.ReceivePackage.ReceiveBuffer                = ResponseData;
-  TransferToken.ReceivePackage.ReceiveSizeInByte            = *ResponseDataSize;
-  TransferToken.TransmitHeader                              = NULL;
-  TransferToken.TransmitHeaderSize                          = 0;
-  TransferToken.TransmitTrailer                             = NULL;
-  TransferToken.TransmitTrailerSize                         = 0;
-  TransferToken.ReceivePackage.TransmitTimeoutInMillisecond = MANAGEABILITY_TRANSPORT_NO_TIMEOUT;
-
-  DEBUG ((
-    DEBUG_MANAGEABILITY_INFO,
-    "%a: Retrieve MCTP message Response size: 0x%x\n",
-    __func__,
-    TransferToken.ReceivePackage.ReceiveSizeInByte
-    ));
-  TransportToken->Transport->Function.Version1_0->TransportTransmitReceive (
-                                                    TransportToken,
-                                                    &TransferToken
-                                                    );
-
-  //
-  // Return transfer status.
-  //
-  *AdditionalTransferError = TransferToken.TransportAdditionalStatus;
-  *ResponseDataSize        = TransferToken.ReceivePackage.ReceiveSizeInByte;
-  Status                   = TransferToken.TransferStatus;
+  MctpReleaseMessageTag (MessageTag);
+  return Status;
+}
+
+/**
+  Common code to submit MCTP message
+
+  @param[in]         TransportToken             Transport token.
+  @param[in]         MctpType                   MCTP message type.
+  @param[in]         MctpSourceEndpointId       MCTP source endpoint ID.
+  @param[in]         MctpDestinationEndpointId  MCTP source endpoint ID.
+  @param[in]         RequestDataIntegrityCheck  Indicates whether MCTP message has
+                                                integrity check byte.
+  @param[in]         RequestData                Message Data.
+  @param[in]         RequestDataSize            Size of message Data.
+  @param[in]         RequestTimeout             Timeout value in milliseconds.
+                                                MANAGEABILITY_TRANSPORT_NO_TIMEOUT means no timeout value.
+  @param[out]        ResponseData               Message Response Data. The completion code is the first byte of response data.
+  @param[in, out]    ResponseDataSize           Size of Message Response Data.
+  @param[in]         ResponseTimeout            Timeout value in milliseconds.
+                                                MANAGEABILITY_TRANSPORT_NO_TIMEOUT means no timeout value.
+  @param[out]        AdditionalTransferError    MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS.
+
+  @retval EFI_SUCCESS            The message was successfully send to transport interface and a
+                                 response was successfully received.
+  @retval EFI_NOT_FOUND          The message was not successfully sent to transport interface or a response
+                                 was not successfully received from transport interface.
+  @retval EFI_NOT_READY          MCTP transport interface is not ready for MCTP message.
+  @retval EFI_DEVICE_ERROR       MCTP transport interface Device hardware error.
+  @retval EFI_TIMEOUT            The message time out.
+  @retval EFI_UNSUPPORTED        The message was not successfully sent to the transport interface.
+  @retval EFI_OUT_OF_RESOURCES   The resource allocation is out of resource or data size error.
+  @retval EFI_INVALID_PARAMETER  Both RequestData and ResponseData are NULL
+**/
+EFI_STATUS
+CommonMctpSubmitMessage (
+  IN     MANAGEABILITY_TRANSPORT_TOKEN              *TransportToken,
+  IN     UINT8                                      MctpType,
+  IN     UINT8                                      MctpSourceEndpointId,
+  IN     UINT8                                      MctpDestinationEndpointId,
+  IN     BOOLEAN                                    RequestDataIntegrityCheck,
+  IN     UINT8                                      *RequestData,
+  IN     UINT32                                     RequestDataSize,
+  IN     UINT32                                     RequestTimeout,
+  OUT    UINT8                                      *ResponseData,
+  IN OUT UINT32                                     *ResponseDataSize,
+  IN     UINT32                                     ResponseTimeout,
+  OUT    MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS  *AdditionalTransferError
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       MessageTag;
+
+  Status = CommonMctpSendRequest (
+             TransportToken,
+             MctpType,
+             MctpSourceEndpointId,
+             MctpDestinationEndpointId,
+             RequestDataIntegrityCheck,
+             RequestData,
+             RequestDataSize,
+             RequestTimeout,
+             &MessageTag,
+             AdditionalTransferError
+             );
   if (EFI_ERROR (Status)) {
-    DEBUG ((DEBUG_ERROR, "%a: Failed to send MCTP command over %s: %r\n", __func__, mTransportName, Status));
     return Status;
   }
 
-  return Status;
+  if (ResponseData == NULL) {
+    // No response is expected.
+    MctpReleaseMessageTag (MessageTag);
+    return EFI_SUCCESS;
+  }
+
+  return CommonMctpReceiveResponse (
+           TransportToken,
+           MessageTag,
+           ResponseData,
+           ResponseDataSize,
+           ResponseTimeout,
+           AdditionalTransferError
+           );
 }
@@ -9,7 +9,9 @@
 #define MANAGEABILITY_MCTP_COMMON_H_
 
 #include <IndustryStandard/IpmiKcs.h>
+#include <IndustryStandard/Mctp.h>
 #include <Library/ManageabilityTransportLib.h>
+#include <Library/ManageabilityTransportMctpLib.h>
 
 #define MCTP_KCS_BASE_ADDRESS  PcdGet32(PcdMctpKcsBaseAddress)
 
@@ -25,6 +27,68 @@
 #define MCTP_KCS_REG_COMMAND_MEMMAP   MCTP_KCS_BASE_ADDRESS + (IPMI_KCS_COMMAND_REGISTER_OFFSET * 4)
 #define MCTP_KCS_REG_STATUS_MEMMAP    MCTP_KCS_BASE_ADDRESS + (IPMI_KCS_STATUS_REGISTER_OFFSET * 4)
 
+///
+/// Number of MCTP message tags, which is the number of requests
+/// that can be outstanding at once.
+///
+#define MCTP_MESSAGE_TAGS  8
+
+#pragma pack(1)
+
+///
+/// Headers of an MCTP over KCS packet. MessageHeader is only
+/// present in the first packet of a message.
+///
+typedef struct {
+  MANAGEABILITY_MCTP_KCS_HEADER    KcsHeader;
+  MCTP_TRANSPORT_HEADER            TransportHeader;
+  MCTP_MESSAGE_HEADER              MessageHeader;
+} MCTP_KCS_PACKET_HEADER;
+
+#pragma pack()
+
+///
+/// Fragment of an MCTP message, which is sent in one packet.
+///
+typedef struct {
+  UINT8      *Payload;            ///< Points into the message, NULL if the fragment is empty.
+  UINT32     PayloadSize;         ///< Size of the fragment in byte.
+  BOOLEAN    StartOfMessage;
+  BOOLEAN    EndOfMessage;
+  UINT8      PacketSequence;
+} MCTP_FRAGMENT;
+
+///
+/// Iterator over the fragments of an MCTP message.
+///
+typedef struct {
+  UINT8      *Message;
+  UINT32     MessageSize;
+  UINT32     Offset;              ///< Offset of the next fragment.
+  UINT32     MaximumTransferUnit; ///< Maximum size of an MCTP packet, with its
+                                  ///< transport and message header.
+  UINT8      PacketSequence;      ///< Sequence number of the next fragment.
+  BOOLEAN    Done;
+} MCTP_FRAGMENT_ITERATOR;
+
+///
+/// Request waiting for its response, indexed by its message tag.
+///
+typedef struct {
+  BOOLEAN       InUse;
+  UINT8         MctpType;
+  UINT8         ResponderEndpointId;  ///< Source endpoint ID of the response.
+  BOOLEAN       ResponseStarted;      ///< The first packet of the response is received.
+  BOOLEAN       ResponseComplete;     ///< The last packet of the response is received,
+                                      ///< or the response is dropped.
+  EFI_STATUS    ResponseStatus;
+  UINT8         NextPacketSequence;
+  UINT8         *Response;            ///< Response being reassembled, without
+                                      ///< the MCTP message header.
+  UINT32        ResponseSize;
+  UINT32        ResponseBufferSize;
+} MCTP_OUTSTANDING_REQUEST;
+
 /**
   This functions setup the PLDM transport hardware information according
   to the specification of transport token acquired from transport library.
@@ -45,8 +109,42 @@ SetupMctpTransportHardwareInformation (
   );
 
 /**
-  This functions setup the final header/body/trailer packets for
-  the acquired transport interface.
+  This function initializes an iterator over the fragments of a message.
+
+  @param[out]        Iterator             The iterator.
+  @param[in]         Message              The message, which may be NULL if MessageSize is 0.
+  @param[in]         MessageSize          Size of the message in byte.
+  @param[in]         MaximumTransferUnit  Maximum size of an MCTP packet, with its
+                                          transport and message header.
+**/
+VOID
+MctpInitFragmentIterator (
+  OUT  MCTP_FRAGMENT_ITERATOR  *Iterator,
+  IN   UINT8                   *Message,
+  IN   UINT32                  MessageSize,
+  IN   UINT32                  MaximumTransferUnit
+  );
+
+/**
+  This function returns the next fragment of a message. The fragment
+  points into the message, nothing is allocated or copied.
+
+  @param[in, out]    Iterator             The iterator.
+  @param[out]        Fragment             The pointer to receive the fragment.
+
+  @retval TRUE       The fragment is returned.
+  @retval FALSE      All the fragments of the message have been returned.
+**/
+BOOLEAN
+MctpGetNextFragment (
+  IN OUT  MCTP_FRAGMENT_ITERATOR  *Iterator,
+  OUT     MCTP_FRAGMENT           *Fragment
+  );
+
+/**
+  This functions setup the header and trailer of a request packet for
+  the acquired transport interface. The fragment itself is sent as the
+  packet body.
 
   @param[in]         TransportToken             The transport interface.
   @param[in]         MctpType                   MCTP message type.
@@ -54,40 +152,96 @@ SetupMctpTransportHardwareInformation (
   @param[in]         MctpDestinationEndpointId  MCTP source endpoint ID.
   @param[in]         RequestDataIntegrityCheck  Indicates whether MCTP message has
                                                 integrity check byte.
-  @param[out]        PacketHeader               The pointer to receive header of request.
+  @param[in]         MessageTag                 Message tag of the request.
+  @param[in]         Fragment                   The fragment sent in the packet.
+  @param[out]        PacketHeader               The buffer to receive the packet header.
   @param[out]        PacketHeaderSize           Packet header size.
-  @param[in, out]    PacketBody                 The request body.
-                                                When IN, it is the caller's request body.
-                                                When OUT and NULL, the request body is not
-                                                changed.
-                                                Whee out and non-NULL, the request body is
-                                                changed to comfort the transport interface.
-  @param[in, out]    PacketBodySize             The request body size.
-                                                When IN and non-zero, it is the new data
-                                                length of request body.
-                                                When IN and zero, the request body is unchanged.
-  @param[out]        PacketTrailer              The pointer to receive trailer of request.
+  @param[out]        PacketTrailer              The buffer to receive the packet trailer.
   @param[out]        PacketTrailerSize          Packet trailer size.
 
   @retval EFI_SUCCESS            Request packet is returned.
-  @retval EFI_OUT_OF_RESOURCE    Not enough resource to create the request
-                                 transport packets.
+  @retval EFI_INVALID_PARAMETER  The fragment doesn't fit in an MCTP packet.
   @retval EFI_UNSUPPORTED        Request packet is not returned because
                                  the unsupported transport interface.
 **/
 EFI_STATUS
 SetupMctpRequestTransportPacket (
-  IN   MANAGEABILITY_TRANSPORT_TOKEN    *TransportToken,
-  IN   UINT8                            MctpType,
-  IN   UINT8                            MctpSourceEndpointId,
-  IN   UINT8                            MctpDestinationEndpointId,
-  IN   BOOLEAN                          RequestDataIntegrityCheck,
-  OUT  MANAGEABILITY_TRANSPORT_HEADER   *PacketHeader,
-  OUT  UINT16                           *PacketHeaderSize,
-  IN OUT UINT8                          **PacketBody,
-  IN OUT UINT32                         *PacketBodySize,
-  OUT  MANAGEABILITY_TRANSPORT_TRAILER  *PacketTrailer,
-  OUT  UINT16                           *PacketTrailerSize
+  IN   MANAGEABILITY_TRANSPORT_TOKEN  *TransportToken,
+  IN   UINT8                          MctpType,
+  IN   UINT8                          MctpSourceEndpointId,
+  IN   UINT8                          MctpDestinationEndpointId,
+  IN   BOOLEAN                        RequestDataIntegrityCheck,
+  IN   UINT8                          MessageTag,
+  IN   MCTP_FRAGMENT                  *Fragment,
+  OUT  MCTP_KCS_PACKET_HEADER         *PacketHeader,
+  OUT  UINT16                         *PacketHeaderSize,
+  OUT  UINT8                          *PacketTrailer,
+  OUT  UINT16                         *PacketTrailerSize
+  );
+
+/**
+  Common code to send an MCTP request, which stays outstanding
+  until its response is received by CommonMctpReceiveResponse.
+
+  @param[in]         TransportToken             Transport token.
+  @param[in]         MctpType                   MCTP message type.
+  @param[in]         MctpSourceEndpointId       MCTP source endpoint ID.
+  @param[in]         MctpDestinationEndpointId  MCTP source endpoint ID.
+  @param[in]         RequestDataIntegrityCheck  Indicates whether MCTP message has
+                                                integrity check byte.
+  @param[in]         RequestData                Message Data.
+  @param[in]         RequestDataSize            Size of message Data.
+  @param[in]         RequestTimeout             Timeout value in milliseconds.
+                                                MANAGEABILITY_TRANSPORT_NO_TIMEOUT means no timeout value.
+  @param[out]        MessageTag                 Message tag to receive the response with.
+  @param[out]        AdditionalTransferError    MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS.
+
+  @retval EFI_SUCCESS            The message was successfully sent to transport interface.
+  @retval EFI_OUT_OF_RESOURCES   All the message tags are used by outstanding requests.
+  @retval Others                 The message was not sent.
+**/
+EFI_STATUS
+CommonMctpSendRequest (
+  IN     MANAGEABILITY_TRANSPORT_TOKEN              *TransportToken,
+  IN     UINT8                                      MctpType,
+  IN     UINT8                                      MctpSourceEndpointId,
+  IN     UINT8                                      MctpDestinationEndpointId,
+  IN     BOOLEAN                                    RequestDataIntegrityCheck,
+  IN     UINT8                                      *RequestData,
+  IN     UINT32                                     RequestDataSize,
+  IN     UINT32                                     RequestTimeout,
+  OUT    UINT8                                      *MessageTag,
+  OUT    MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS  *AdditionalTransferError
+  );
+
+/**
+  Common code to receive the response of an outstanding MCTP request.
+  Packets of the other outstanding requests received meanwhile are
+  reassembled for them. The message tag is released once this returns.
+
+  @param[in]         TransportToken             Transport token.
+  @param[in]         MessageTag                 Message tag returned by CommonMctpSendRequest.
+  @param[out]        ResponseData               Message Response Data.
+  @param[in, out]    ResponseDataSize           Size of Message Response Data.
+  @param[in]         ResponseTimeout            Timeout value in milliseconds.
+                                                MANAGEABILITY_TRANSPORT_NO_TIMEOUT means no timeout value.
+  @param[out]        AdditionalTransferError    MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS.
+
+  @retval EFI_SUCCESS            The response was received.
+  @retval EFI_INVALID_PARAMETER  No request is outstanding with MessageTag.
+  @retval EFI_BUFFER_TOO_SMALL   The response is larger than ResponseData, which
+                                 received its first ResponseDataSize bytes.
+  @retval EFI_PROTOCOL_ERROR     Packets of the response were lost.
+  @retval Others                 The response was not received.
+**/
+EFI_STATUS
+CommonMctpReceiveResponse (
+  IN     MANAGEABILITY_TRANSPORT_TOKEN              *TransportToken,
+  IN     UINT8                                      MessageTag,
+  OUT    UINT8                                      *ResponseData,
+  IN OUT UINT32                                     *ResponseDataSize,
+  IN     UINT32                                     ResponseTimeout,
+  OUT    MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS  *AdditionalTransferError
   );
 
 /**
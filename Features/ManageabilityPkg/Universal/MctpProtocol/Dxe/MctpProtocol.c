@@ -95,8 +95,104 @@ MctpSubmitMessage (
   return Status;
 }
 
-EDKII_MCTP_PROTOCOL_V1_0  mMctpProtocolV10 = {
-  MctpSubmitMessage
+/**
+  This service sends a request via EDKII MCTP protocol without waiting
+  for its response.
+
+  @param[in]         This                       EDKII_MCTP_PROTOCOL instance.
+  @param[in]         MctpType                   MCTP message type.
+  @param[in]         MctpSourceEndpointId       MCTP source endpoint ID.
+  @param[in]         MctpDestinationEndpointId  MCTP source endpoint ID.
+  @param[in]         RequestDataIntegrityCheck  Indicates whether MCTP message has
+                                                integrity check byte.
+  @param[in]         RequestData                Message Data.
+  @param[in]         RequestDataSize            Size of message Data.
+  @param[in]         RequestTimeout             Timeout value in milliseconds.
+                                                MANAGEABILITY_TRANSPORT_NO_TIMEOUT means no timeout value.
+  @param[out]        MessageTag                 Message tag to receive the response with.
+  @param[out]        AdditionalTransferError    MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS.
+
+  @retval EFI_SUCCESS            The message was successfully sent to transport interface.
+  @retval EFI_OUT_OF_RESOURCES   All the message tags are used by outstanding requests.
+  @retval EFI_INVALID_PARAMETER  MessageTag is NULL.
+  @retval Others                 The message was not sent.
+**/
+EFI_STATUS
+EFIAPI
+MctpSendRequest (
+  IN     EDKII_MCTP_PROTOCOL                        *This,
+  IN     UINT8                                      MctpType,
+  IN     UINT8                                      MctpSourceEndpointId,
+  IN     UINT8                                      MctpDestinationEndpointId,
+  IN     BOOLEAN                                    RequestDataIntegrityCheck,
+  IN     UINT8                                      *RequestData,
+  IN     UINT32                                     RequestDataSize,
+  IN     UINT32                                     RequestTimeout,
+  OUT    UINT8                                      *MessageTag,
+  OUT    MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS  *AdditionalTransferError
+  )
+{
+  if (MessageTag == NULL) {
+    DEBUG ((DEBUG_ERROR, "%a: MessageTag is NULL\n", __func__));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  return CommonMctpSendRequest (
+           mTransportToken,
+           MctpType,
+           MctpSourceEndpointId,
+           MctpDestinationEndpointId,
+           RequestDataIntegrityCheck,
+           RequestData,
+           RequestDataSize,
+           RequestTimeout,
+           MessageTag,
+           AdditionalTransferError
+           );
+}
+
+/**
+  This service receives the response of a request sent by MctpSendRequest.
+
+  @param[in]         This                       EDKII_MCTP_PROTOCOL instance.
+  @param[in]         MessageTag                 Message tag returned by MctpSendRequest.
+  @param[out]        ResponseData               Message Response Data. The completion code is the first byte of response data.
+  @param[in, out]    ResponseDataSize           Size of Message Response Data.
+  @param[in]         ResponseTimeout            Timeout value in milliseconds.
+                                                MANAGEABILITY_TRANSPORT_NO_TIMEOUT means no timeout value.
+  @param[out]        AdditionalTransferError    MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS.
+
+  @retval EFI_SUCCESS            The response was received.
+  @retval EFI_INVALID_PARAMETER  No request is outstanding with MessageTag.
+  @retval EFI_BUFFER_TOO_SMALL   The response is larger than ResponseData.
+  @retval EFI_PROTOCOL_ERROR     Packets of the response were lost.
+  @retval Others                 The response was not received.
+**/
+EFI_STATUS
+EFIAPI
+MctpReceiveResponse (
+  IN     EDKII_MCTP_PROTOCOL                        *This,
+  IN     UINT8                                      MessageTag,
+  OUT    UINT8                                      *ResponseData,
+  IN OUT UINT32                                     *ResponseDataSize,
+  IN     UINT32                                     ResponseTimeout,
+  OUT    MANAGEABILITY_TRANSPORT_ADDITIONAL_STATUS  *AdditionalTransferError
+  )
+{
+  return CommonMctpReceiveResponse (
+           mTransportToken,
+           MessageTag,
+           ResponseData,
+           ResponseDataSize,
+           ResponseTimeout,
+           AdditionalTransferError
+           );
+}
+
+EDKII_MCTP_PROTOCOL_V1_1  mMctpProtocolV11 = {
+  MctpSubmitMessage,
+  MctpSendRequest,
+  MctpReceiveResponse
 };
 
 EDKII_MCTP_PROTOCOL  mMctpProtocol;
@@ -175,7 +271,7 @@ DxeMctpEntry (
   }
 
   mMctpProtocol.ProtocolVersion      = EDKII_MCTP_PROTOCOL_VERSION;
-  mMctpProtocol.Functions.Version1_0 = &mMctpProtocolV10;
+  mMctpProtocol.Functions.Version1_1 = &mMctpProtocolV11;
   Handle                             = NULL;
   Status                             = gBS->InstallProtocolInterface (
                                               &Handle,
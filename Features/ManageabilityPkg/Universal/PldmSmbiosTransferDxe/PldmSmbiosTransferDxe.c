@@ -14,8 +14,10 @@
 #include <Library/DebugLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
 #include <Library/BasePldmProtocolLib.h>
 #include <Library/ManageabilityTransportHelperLib.h>
 #include <IndustryStandard/PldmSmbiosTransfer.h>
@@ -23,6 +25,19 @@
 #include <Protocol/PldmSmbiosTransferProtocol.h>
 #include <Protocol/Smbios.h>
 
+//
+// The hash of the SMBIOS table last pushed to BMC, which is saved in
+// variable PLDM_SMBIOS_TABLE_HASH_VARIABLE_NAME. The table is not pushed
+// again while it is unchanged. Deleting the variable forces the push,
+// e.g. when BMC is replaced.
+//
+#define PLDM_SMBIOS_TABLE_HASH_VARIABLE_NAME  L"PldmSmbiosTableHash"
+
+typedef struct {
+  UINT32    TableLength; ///< Length of SMBIOS table with its padding.
+  UINT32    Crc32;       ///< SMBIOS table integrity checksum sent to BMC.
+} PLDM_SMBIOS_TABLE_HASH;
+
 UINT32  SetSmbiosStructureTableHandle;
 
 /**
@@ -242,7 +257,132 @@ GetSmbiosStructureTable (
 }
 
 /**
-  This function sets SMBIOS structure table.
+  This function checks if the SMBIOS table was pushed to BMC unchanged.
+
+  @param [in]   TableHash   The hash of SMBIOS table to push.
+
+  @retval       TRUE        The SMBIOS table of TableHash was pushed.
+  @retval       FALSE       The SMBIOS table was not pushed, or it is changed.
+**/
+BOOLEAN
+IsSmbiosTablePushed (
+  IN PLDM_SMBIOS_TABLE_HASH  *TableHash
+  )
+{
+  EFI_STATUS              Status;
+  PLDM_SMBIOS_TABLE_HASH  PushedTableHash;
+  UINTN                   Size;
+
+  Size   = sizeof (PLDM_SMBIOS_TABLE_HASH);
+  Status = gRT->GetVariable (
+                  PLDM_SMBIOS_TABLE_HASH_VARIABLE_NAME,
+                  &gManageabilityPldmSmbiosTransferVariableGuid,
+                  NULL,
+                  &Size,
+                  &PushedTableHash
+                  );
+  if (EFI_ERROR (Status) || (Size != sizeof (PLDM_SMBIOS_TABLE_HASH))) {
+    return FALSE;
+  }
+
+  return (BOOLEAN)(CompareMem (&PushedTableHash, TableHash, sizeof (PLDM_SMBIOS_TABLE_HASH)) == 0);
+}
+
+/**
+  This function pushes SMBIOS structure table to BMC by multipart
+  SetSMBIOSStructureTable transfer, in parts of PcdPldmSmbiosTransferChunkSize.
+
+  @param [in]   Table       SMBIOS structure table with its padding and checksum.
+  @param [in]   TableSize   Size of Table.
+
+  @retval       EFI_SUCCESS            The table is pushed.
+  @retval       EFI_OUT_OF_RESOURCES   No memory resource for the request.
+  @retval       Other values           Fail to push the table.
+**/
+EFI_STATUS
+PushSmbiosStructureTable (
+  IN UINT8   *Table,
+  IN UINT32  TableSize
+  )
+{
+  EFI_STATUS                               Status;
+  UINT32                                   ChunkSize;
+  UINT32                                   PartSize;
+  UINT32                                   Offset;
+  UINT32                                   ResponseSize;
+  PLDM_SET_SMBIOS_STRUCTURE_TABLE_REQUEST  *PldmSetSmbiosStructureTable;
+
+  ChunkSize = FixedPcdGet32 (PcdPldmSmbiosTransferChunkSize);
+  if ((ChunkSize == 0) || (ChunkSize > TableSize)) {
+    ChunkSize = TableSize;
+  }
+
+  PldmSetSmbiosStructureTable = AllocatePool (sizeof (PLDM_SET_SMBIOS_STRUCTURE_TABLE_REQUEST) + ChunkSize);
+  if (PldmSetSmbiosStructureTable == NULL) {
+    DEBUG ((DEBUG_ERROR, "%a: No memory resource for sending SetSmbiosStructureTable.\n", __func__));
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // The first part is sent with the handle got from BMC previously, each
+  // of the following parts with the handle BMC responds to its previous part.
+  //
+  Status = EFI_SUCCESS;
+  for (Offset = 0; Offset < TableSize; Offset += PartSize) {
+    PartSize = MIN (ChunkSize, TableSize - Offset);
+    if (Offset == 0) {
+      PldmSetSmbiosStructureTable->TransferFlag = (PartSize == TableSize) ? PLDM_TRANSFER_FLAG_START_AND_END : PLDM_TRANSFER_FLAG_START;
+    } else {
+      PldmSetSmbiosStructureTable->TransferFlag = (Offset + PartSize == TableSize) ? PLDM_TRANSFER_FLAG_END : PLDM_TRANSFER_FLAG_MIDDLE;
+    }
+
+    PldmSetSmbiosStructureTable->DataTransferHandle = SetSmbiosStructureTableHandle;
+    CopyMem (
+      (VOID *)((UINT8 *)PldmSetSmbiosStructureTable + sizeof (PLDM_SET_SMBIOS_STRUCTURE_TABLE_REQUEST)),
+      (VOID *)(Table + Offset),
+      PartSize
+      );
+
+    DEBUG ((
+      DEBUG_MANAGEABILITY_INFO,
+      "%a: Part at offset 0x%x, size 0x%x, transfer flag 0x%x, handle 0x%x.\n",
+      __func__,
+      Offset,
+      PartSize,
+      PldmSetSmbiosStructureTable->TransferFlag,
+      SetSmbiosStructureTableHandle
+      ));
+
+    ResponseSize = sizeof (SetSmbiosStructureTableHandle);
+    Status       = PldmSubmitCommand (
+                     PLDM_TYPE_SMBIOS,
+                     PLDM_SET_SMBIOS_STRUCTURE_TABLE_COMMAND_CODE,
+                     (UINT8 *)PldmSetSmbiosStructureTable,
+                     (UINT32)(sizeof (PLDM_SET_SMBIOS_STRUCTURE_TABLE_REQUEST) + PartSize),
+                     (UINT8 *)&SetSmbiosStructureTableHandle,
+                     &ResponseSize
+                     );
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_ERROR, "%a: Fails to set SMBIOS structure table part at offset 0x%x - %r.\n", __func__, Offset, Status));
+      break;
+    }
+
+    if ((ResponseSize != 0) && (ResponseSize <= sizeof (SetSmbiosStructureTableHandle))) {
+      HelperManageabilityDebugPrint (
+        (VOID *)&SetSmbiosStructureTableHandle,
+        ResponseSize,
+        "Set SMBIOS structure table response got from BMC.\n"
+        );
+    }
+  }
+
+  FreePool (PldmSetSmbiosStructureTable);
+  return Status;
+}
+
+/**
+  This function sets SMBIOS structure table. The table is not pushed
+  to BMC again if it is unchanged since it was last pushed.
 
   @param [in]   This        EDKII_PLDM_SMBIOS_TRANSFER_PROTOCOL instance.
 
@@ -258,19 +398,18 @@ SetSmbiosStructureTable (
   IN  EDKII_PLDM_SMBIOS_TRANSFER_PROTOCOL  *This
   )
 {
-  EFI_STATUS                               Status;
-  SMBIOS_TABLE_3_0_ENTRY_POINT             *SmbiosEntry;
-  EFI_SMBIOS_HANDLE                        SmbiosHandle;
-  EFI_SMBIOS_PROTOCOL                      *Smbios;
-  UINT32                                   PaddingSize;
-  UINT32                                   ResponseSize;
-  UINT32                                   RequestSize;
-  UINT8                                    *RequestBuffer;
-  UINT8                                    *DataPointer;
-  UINT32                                   Crc32;
-  UINT16                                   TableLength;
-  EFI_SMBIOS_TABLE_HEADER                  *Record;
-  PLDM_SET_SMBIOS_STRUCTURE_TABLE_REQUEST  *PldmSetSmbiosStructureTable;
+  EFI_STATUS                    Status;
+  SMBIOS_TABLE_3_0_ENTRY_POINT  *SmbiosEntry;
+  EFI_SMBIOS_HANDLE             SmbiosHandle;
+  EFI_SMBIOS_PROTOCOL           *Smbios;
+  UINT32                        PaddingSize;
+  UINT32                        TableSize;
+  UINT8                         *Table;
+  UINT8                         *DataPointer;
+  UINT32                        Crc32;
+  UINT16                        TableLength;
+  EFI_SMBIOS_TABLE_HEADER       *Record;
+  PLDM_SMBIOS_TABLE_HASH        TableHash;
 
   DEBUG ((DEBUG_MANAGEABILITY_INFO, "%a: Set SMBIOS structure table.\n", __func__));
 
@@ -336,64 +475,57 @@ SetSmbiosStructureTable (
   // Padding requirement (0 ~ 3 bytes)
   PaddingSize = (4 - (TableLength % 4)) % 4;
 
-  // Total request buffer size = PLDM_SET_SMBIOS_STRUCTURE_TABLE_REQUEST + SMBIOS tables + padding + checksum
-  RequestSize   = (UINT32)(sizeof (PLDM_SET_SMBIOS_STRUCTURE_TABLE_REQUEST) + TableLength + PaddingSize + sizeof (Crc32));
-  RequestBuffer = (UINT8 *)AllocatePool (RequestSize);
-  if (RequestBuffer == NULL) {
-    DEBUG ((DEBUG_ERROR, "%a: No memory resource for sending SetSmbiosStructureTable.\n"));
+  // Table size = SMBIOS tables + padding + checksum
+  TableSize = (UINT32)(TableLength + PaddingSize + sizeof (Crc32));
+  Table     = (UINT8 *)AllocatePool (TableSize);
+  if (Table == NULL) {
+    DEBUG ((DEBUG_ERROR, "%a: No memory resource for sending SetSmbiosStructureTable.\n", __func__));
     return EFI_OUT_OF_RESOURCES;
   }
 
   // Fill in smbios tables
-  CopyMem (
-    (VOID *)((UINT8 *)RequestBuffer + sizeof (PLDM_SET_SMBIOS_STRUCTURE_TABLE_REQUEST)),
-    (VOID *)(UINTN)SmbiosEntry->TableAddress,
-    TableLength
-    );
+  CopyMem ((VOID *)Table, (VOID *)(UINTN)SmbiosEntry->TableAddress, TableLength);
 
   // Fill in padding
-  DataPointer = RequestBuffer + sizeof (PLDM_SET_SMBIOS_STRUCTURE_TABLE_REQUEST) + TableLength;
+  DataPointer = Table + TableLength;
   ZeroMem ((VOID *)DataPointer, PaddingSize);
 
   // Fill in checksum
-  gBS->CalculateCrc32 (
-         (VOID *)(RequestBuffer + sizeof (PLDM_SET_SMBIOS_STRUCTURE_TABLE_REQUEST)),
-         TableLength + PaddingSize,
-         &Crc32
-         );
+  gBS->CalculateCrc32 ((VOID *)Table, TableLength + PaddingSize, &Crc32);
   DataPointer += PaddingSize;
   CopyMem ((VOID *)DataPointer, (VOID *)&Crc32, 4);
 
-  PldmSetSmbiosStructureTable                     = (PLDM_SET_SMBIOS_STRUCTURE_TABLE_REQUEST *)RequestBuffer;
-  PldmSetSmbiosStructureTable->DataTransferHandle = SetSmbiosStructureTableHandle;
-  PldmSetSmbiosStructureTable->TransferFlag       = PLDM_TRANSFER_FLAG_START_AND_END;
-  ResponseSize                                    = sizeof (SetSmbiosStructureTableHandle);
-
-  Status = PldmSubmitCommand (
-             PLDM_TYPE_SMBIOS,
-             PLDM_SET_SMBIOS_STRUCTURE_TABLE_COMMAND_CODE,
-             RequestBuffer,
-             RequestSize,
-             (UINT8 *)&SetSmbiosStructureTableHandle,
-             &ResponseSize
-             );
-  if (RequestBuffer != NULL) {
-    FreePool (RequestBuffer);
+  //
+  // Skip the transfer if BMC already has this table.
+  //
+  TableHash.TableLength = TableLength + PaddingSize;
+  TableHash.Crc32       = Crc32;
+  if (IsSmbiosTablePushed (&TableHash)) {
+    DEBUG ((DEBUG_MANAGEABILITY_INFO, "%a: SMBIOS structure table is unchanged, skip the transfer.\n", __func__));
+    FreePool (Table);
+    return EFI_SUCCESS;
   }
 
+  Status = PushSmbiosStructureTable (Table, TableSize);
+  FreePool (Table);
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "%a: Set SMBIOS structure table.\n", __func__));
+    return Status;
   }
 
-  if ((ResponseSize != 0) && (ResponseSize <= sizeof (SetSmbiosStructureTableHandle))) {
-    HelperManageabilityDebugPrint (
-      (VOID *)&SetSmbiosStructureTableHandle,
-      ResponseSize,
-      "Set SMBIOS structure table response got from BMC.\n"
-      );
+  Status = gRT->SetVariable (
+                  PLDM_SMBIOS_TABLE_HASH_VARIABLE_NAME,
+                  &gManageabilityPldmSmbiosTransferVariableGuid,
+                  EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS,
+                  sizeof (PLDM_SMBIOS_TABLE_HASH),
+                  &TableHash
+                  );
+  if (EFI_ERROR (Status)) {
+    // The table is pushed, it is just pushed again on next boot.
+    DEBUG ((DEBUG_ERROR, "%a: Fails to save SMBIOS structure table hash - %r.\n", __func__, Status));
   }
 
-  return Status;
+  return EFI_SUCCESS;
 }
 
 /**
@@ -0,0 +1,713 @@
+/** @file
+  RISC-V SBI performance self-test.
+
+  Measures the latency of the SBI calls made through RiscVEdk2SbiLib: the base
+  extension ecall round trip, SbiSetTimer, remote fences, HSM start/stop and
+  IPI round trips to every hart, and prints percentiles for each of them.
+
+  Usage: SbiPerfTest [-n Iterations]
+
+  Copyright (c) 2024, SOPHGO Inc. All rights reserved.<BR>
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "SbiPerfTest.h"
+
+STATIC UINTN                  mIterations = SBI_PERF_DEFAULT_ITERATIONS;
+STATIC UINTN                  mBootHartId;
+STATIC UINTN                  mHartCount;
+STATIC UINTN                  mHartIds[RISC_V_MAX_HART_SUPPORTED];
+STATIC SBI_PERF_HART_MAILBOX  *mMailbox;
+STATIC UINT64                 *mSamples;
+STATIC UINT64                 mTimeoutTicks;
+STATIC BOOLEAN                mHartFailure;
+
+/**
+  Compare two UINT64 samples for QuickSort ().
+
+  @param[in]  Buffer1   The first sample.
+  @param[in]  Buffer2   The second sample.
+
+  @retval <0  Buffer1 is smaller than Buffer2.
+  @retval 0   Buffer1 is equal to Buffer2.
+  @retval >0  Buffer1 is larger than Buffer2.
+**/
+STATIC
+INTN
+EFIAPI
+CompareSample (
+  IN CONST VOID  *Buffer1,
+  IN CONST VOID  *Buffer2
+  )
+{
+  UINT64  Sample1;
+  UINT64  Sample2;
+
+  Sample1 = *(CONST UINT64 *)Buffer1;
+  Sample2 = *(CONST UINT64 *)Buffer2;
+
+  if (Sample1 < Sample2) {
+    return -1;
+  }
+
+  return (Sample1 > Sample2) ? 1 : 0;
+}
+
+/**
+  Convert a series of tick samples into nanosecond statistics.
+
+  @param[in, out]  Samples  Samples in ticks, sorted on return.
+  @param[in]       Count    Number of samples.
+  @param[out]      Stats    The computed statistics.
+**/
+STATIC
+VOID
+ComputeStats (
+  IN OUT UINT64          *Samples,
+  IN     UINTN           Count,
+  OUT    SBI_PERF_STATS  *Stats
+  )
+{
+  UINT64  Sum;
+  UINT64  Swap;
+  UINTN   Index;
+
+  ZeroMem (Stats, sizeof (*Stats));
+  if (Count == 0) {
+    return;
+  }
+
+  QuickSort (Samples, Count, sizeof (UINT64), CompareSample, &Swap);
+
+  Sum = 0;
+  for (Index = 0; Index < Count; Index++) {
+    Sum += Samples[Index];
+  }
+
+  Stats->Count   = Count;
+  Stats->Min     = GetTimeInNanoSecond (Samples[0]);
+  Stats->P50     = GetTimeInNanoSecond (Samples[(Count - 1) * 50 / 100]);
+  Stats->P90     = GetTimeInNanoSecond (Samples[(Count - 1) * 90 / 100]);
+  Stats->P99     = GetTimeInNanoSecond (Samples[(Count - 1) * 99 / 100]);
+  Stats->Max     = GetTimeInNanoSecond (Samples[Count - 1]);
+  Stats->Average = GetTimeInNanoSecond (DivU64x64Remainder (Sum, Count, NULL));
+}
+
+/**
+  Print one result line.
+
+  @param[in]  Name      Name of the measurement.
+  @param[in]  Samples   Samples in ticks, sorted on return.
+  @param[in]  Count     Number of samples.
+**/
+STATIC
+VOID
+ReportSamples (
+  IN     CONST CHAR16  *Name,
+  IN OUT UINT64        *Samples,
+  IN     UINTN         Count
+  )
+{
+  SBI_PERF_STATS  Stats;
+
+  if (Count == 0) {
+    Print (L"%-26s %8s\n", Name, L"skipped");
+    return;
+  }
+
+  ComputeStats (Samples, Count, &Stats);
+  Print (
+    L"%-26s %8u %9lu %9lu %9lu %9lu %9lu %9lu\n",
+    Name,
+    Stats.Count,
+    Stats.Min,
+    Stats.P50,
+    Stats.P90,
+    Stats.P99,
+    Stats.Max,
+    Stats.Average
+    );
+}
+
+/**
+  Wait until a mailbox word differs from a given value.
+
+  @param[in]  Word      The mailbox word to watch.
+  @param[in]  OldValue  The value the word holds before the event.
+
+  @retval TRUE   The word changed.
+  @retval FALSE  The hart did not respond in time.
+**/
+STATIC
+BOOLEAN
+WaitForChange (
+  IN volatile UINT64  *Word,
+  IN UINT64           OldValue
+  )
+{
+  UINT64  Start;
+
+  Start = GetPerformanceCounter ();
+  while (*Word == OldValue) {
+    if ((GetPerformanceCounter () - Start) > mTimeoutTicks) {
+      return FALSE;
+    }
+
+    CpuPause ();
+  }
+
+  return TRUE;
+}
+
+/**
+  Wait until a hart reports a given HSM state.
+
+  @param[in]  HartId    The hart to poll.
+  @param[in]  State     The expected HSM state.
+
+  @retval TRUE   The hart reached the state.
+  @retval FALSE  The hart did not reach the state in time.
+**/
+STATIC
+BOOLEAN
+WaitForHsmState (
+  IN UINTN  HartId,
+  IN UINTN  State
+  )
+{
+  UINT64  Start;
+  UINTN   HartStatus;
+
+  Start = GetPerformanceCounter ();
+  do {
+    if (!EFI_ERROR (SbiHartGetStatus (HartId, &HartStatus)) &&
+        (HartStatus == State))
+    {
+      return TRUE;
+    }
+  } while ((GetPerformanceCounter () - Start) <= mTimeoutTicks);
+
+  return FALSE;
+}
+
+/**
+  Start a secondary hart in the mailbox stub.
+
+  @param[in]  Index       Index of the hart in mHartIds.
+  @param[out] CallTicks   Optional, ticks spent in SbiHartStart ().
+  @param[out] EntryTicks  Optional, ticks until the hart reached the stub.
+
+  @retval TRUE   The hart is running the stub.
+  @retval FALSE  The hart could not be started.
+**/
+STATIC
+BOOLEAN
+StartHart (
+  IN  UINTN   Index,
+  OUT UINT64  *CallTicks   OPTIONAL,
+  OUT UINT64  *EntryTicks  OPTIONAL
+  )
+{
+  SBI_PERF_HART_MAILBOX  *Mailbox;
+  EFI_STATUS             Status;
+  UINT64                 Start;
+  UINT64                 End;
+
+  Mailbox              = &mMailbox[Index];
+  Mailbox->State       = SBI_PERF_HART_STATE_IDLE;
+  Mailbox->Command     = SBI_PERF_HART_COMMAND_NONE;
+  Mailbox->IpiAck      = 0;
+  Mailbox->ArrivalTime = 0;
+  MemoryFence ();
+
+  Start  = GetPerformanceCounter ();
+  Status = SbiHartStart (
+             mHartIds[Index],
+             (UINTN)SbiPerfSecondaryEntry,
+             (UINTN)Mailbox
+             );
+  End = GetPerformanceCounter ();
+  if (EFI_ERROR (Status)) {
+    Print (L"Hart %u: HSM start failed: %r\n", mHartIds[Index], Status);
+    mHartFailure = TRUE;
+    return FALSE;
+  }
+
+  if (!WaitForChange (&Mailbox->State, SBI_PERF_HART_STATE_IDLE)) {
+    Print (L"Hart %u: did not reach the entry point\n", mHartIds[Index]);
+    mHartFailure = TRUE;
+    return FALSE;
+  }
+
+  if (CallTicks != NULL) {
+    *CallTicks = End - Start;
+  }
+
+  if (EntryTicks != NULL) {
+    *EntryTicks = Mailbox->ArrivalTime - Start;
+  }
+
+  return TRUE;
+}
+
+/**
+  Ask a secondary hart running the stub to stop and wait until it is stopped.
+
+  @param[in]  Index       Index of the hart in mHartIds.
+  @param[out] StopTicks   Optional, ticks until HSM reported the hart stopped.
+
+  @retval TRUE   The hart is stopped.
+  @retval FALSE  The hart did not stop in time.
+**/
+STATIC
+BOOLEAN
+StopHart (
+  IN  UINTN   Index,
+  OUT UINT64  *StopTicks  OPTIONAL
+  )
+{
+  UINT64  Start;
+
+  Start = GetPerformanceCounter ();
+  MemoryFence ();
+  mMailbox[Index].Command = SBI_PERF_HART_COMMAND_STOP;
+
+  if (!WaitForHsmState (mHartIds[Index], SBI_PERF_HSM_STOPPED)) {
+    Print (L"Hart %u: did not stop\n", mHartIds[Index]);
+    mHartFailure = TRUE;
+    return FALSE;
+  }
+
+  if (StopTicks != NULL) {
+    *StopTicks = GetPerformanceCounter () - Start;
+  }
+
+  return TRUE;
+}
+
+/**
+  Find the boot hart and all stopped harts that can be used for the test.
+
+  @retval EFI_SUCCESS       The hart list was built.
+  @retval EFI_NOT_FOUND     The boot hart could not be identified.
+**/
+STATIC
+EFI_STATUS
+DiscoverHarts (
+  VOID
+  )
+{
+  EFI_STATUS               Status;
+  RISCV_EFI_BOOT_PROTOCOL  *RiscVBoot;
+  UINTN                    HartId;
+  UINTN                    HartStatus;
+  UINTN                    StartedHarts;
+  BOOLEAN                  BootHartKnown;
+
+  BootHartKnown = FALSE;
+  Status        = gBS->LocateProtocol (&gRiscVEfiBootProtocolGuid, NULL, (VOID **)&RiscVBoot);
+  if (!EFI_ERROR (Status)) {
+    Status        = RiscVBoot->GetBootHartId (RiscVBoot, &mBootHartId);
+    BootHartKnown = !EFI_ERROR (Status);
+  }
+
+  StartedHarts = 0;
+  mHartCount   = 0;
+  for (HartId = 0; HartId < RISC_V_MAX_HART_SUPPORTED; HartId++) {
+    if (EFI_ERROR (SbiHartGetStatus (HartId, &HartStatus))) {
+      continue;
+    }
+
+    if (HartStatus == SBI_PERF_HSM_STARTED) {
+      //
+      // Without the RISC-V boot protocol the boot hart is the only one
+      // running while UEFI owns the machine.
+      //
+      StartedHarts++;
+      if (!BootHartKnown) {
+        mBootHartId = HartId;
+      }
+    } else if (HartStatus == SBI_PERF_HSM_STOPPED) {
+      mHartIds[mHartCount++] = HartId;
+    }
+  }
+
+  if (!BootHartKnown && (StartedHarts != 1)) {
+    return EFI_NOT_FOUND;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Measure the base extension ecall round trip and SbiSetTimer ().
+
+  Runs at TPL_HIGH_LEVEL so the timer driver does not observe the
+  reprogrammed comparator, and re-arms the timer to fire immediately on
+  return so the timer driver reprograms its next tick.
+**/
+STATIC
+VOID
+MeasureLocalCalls (
+  VOID
+  )
+{
+  EFI_TPL  OldTpl;
+  UINTN    Index;
+  UINTN    SpecVersion;
+  UINT64   Start;
+
+  OldTpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+
+  for (Index = 0; Index < mIterations; Index++) {
+    Start = GetPerformanceCounter ();
+    SbiGetSpecVersion (&SpecVersion);
+    mSamples[Index] = GetPerformanceCounter () - Start;
+  }
+
+  ReportSamples (L"ecall (base spec version)", mSamples, mIterations);
+
+  for (Index = 0; Index < mIterations; Index++) {
+    Start = GetPerformanceCounter ();
+    SbiSetTimer (MAX_UINT64);
+    mSamples[Index] = GetPerformanceCounter () - Start;
+  }
+
+  SbiSetTimer (GetPerformanceCounter ());
+  gBS->RestoreTPL (OldTpl);
+
+  ReportSamples (L"SbiSetTimer", mSamples, mIterations);
+}
+
+/**
+  Measure HSM start and stop latency of every stopped hart.
+**/
+STATIC
+VOID
+MeasureHsm (
+  VOID
+  )
+{
+  UINTN   Index;
+  UINTN   Round;
+  UINTN   Count;
+  UINT64  *Call;
+  UINT64  *Entry;
+  UINT64  *Stop;
+
+  Call  = mSamples;
+  Entry = mSamples + mIterations * mHartCount;
+  Stop  = Entry + mIterations * mHartCount;
+  Count = 0;
+
+  for (Index = 0; Index < mHartCount; Index++) {
+    for (Round = 0; Round < mIterations; Round++) {
+      if (!StartHart (Index, &Call[Count], &Entry[Count])) {
+        break;
+      }
+
+      if (!StopHart (Index, &Stop[Count])) {
+        break;
+      }
+
+      Count++;
+    }
+  }
+
+  ReportSamples (L"SbiHartStart (call)", Call, Count);
+  ReportSamples (L"SbiHartStart (to entry)", Entry, Count);
+  ReportSamples (L"SbiHartStop (to stopped)", Stop, Count);
+}
+
+/**
+  Send one IPI to each of the first Count harts in mHartIds.
+
+  Harts are grouped into as few SbiSendIpi () calls as the hart mask width
+  allows, the way an OS would signal a set of harts.
+
+  @param[in]  Count   Number of harts to signal.
+**/
+STATIC
+VOID
+SendIpiToParkedHarts (
+  IN UINTN  Count
+  )
+{
+  UINTN  Index;
+  UINTN  HartMaskBase;
+  UINTN  HartMask;
+
+  Index = 0;
+  while (Index < Count) {
+    HartMaskBase = mHartIds[Index];
+    HartMask     = 0;
+    while ((Index < Count) && ((mHartIds[Index] - HartMaskBase) < (sizeof (UINTN) * 8))) {
+      HartMask |= (UINTN)1 << (mHartIds[Index] - HartMaskBase);
+      Index++;
+    }
+
+    SbiSendIpi (&HartMask, HartMaskBase);
+  }
+}
+
+/**
+  Measure IPI round trips and remote fences with all secondary harts parked
+  in the mailbox stub.
+**/
+STATIC
+VOID
+MeasureIpiAndFences (
+  VOID
+  )
+{
+  UINTN    Index;
+  UINTN    Round;
+  UINTN    Count;
+  UINTN    Started;
+  UINTN    HartMask;
+  UINT64   Ack;
+  UINT64   Start;
+  UINT64   *AckBefore;
+  BOOLEAN  Answered;
+
+  AckBefore = AllocatePool (mHartCount * sizeof (UINT64));
+  if (AckBefore == NULL) {
+    Print (L"IPI/fence measurements skipped: out of resources\n");
+    return;
+  }
+
+  for (Started = 0; Started < mHartCount; Started++) {
+    if (!StartHart (Started, NULL, NULL)) {
+      break;
+    }
+  }
+
+  //
+  // Unicast IPI round trip to each parked hart.
+  //
+  Count = 0;
+  for (Index = 0; Index < Started; Index++) {
+    HartMask = 1;
+    for (Round = 0; Round < mIterations; Round++) {
+      Ack   = mMailbox[Index].IpiAck;
+      Start = GetPerformanceCounter ();
+      SbiSendIpi (&HartMask, mHartIds[Index]);
+      if (!WaitForChange (&mMailbox[Index].IpiAck, Ack)) {
+        Print (L"Hart %u: IPI not acknowledged\n", mHartIds[Index]);
+        mHartFailure = TRUE;
+        break;
+      }
+
+      mSamples[Count++] = GetPerformanceCounter () - Start;
+    }
+  }
+
+  ReportSamples (L"SbiSendIpi (round trip)", mSamples, Count);
+
+  //
+  // IPI to all parked harts, completed once every one has acknowledged it.
+  // The boot hart is not running the stub, so it is excluded by mask.
+  //
+  Count = 0;
+  for (Round = 0; (Started > 0) && (Round < mIterations); Round++) {
+    for (Index = 0; Index < Started; Index++) {
+      AckBefore[Index] = mMailbox[Index].IpiAck;
+    }
+
+    Start = GetPerformanceCounter ();
+    SendIpiToParkedHarts (Started);
+
+    Answered = TRUE;
+    for (Index = 0; Index < Started; Index++) {
+      Answered &= WaitForChange (&mMailbox[Index].IpiAck, AckBefore[Index]);
+    }
+
+    if (!Answered) {
+      Print (L"Broadcast IPI not acknowledged by every hart\n");
+      mHartFailure = TRUE;
+      break;
+    }
+
+    mSamples[Count++] = GetPerformanceCounter () - Start;
+  }
+
+  ReportSamples (L"SbiSendIpi (parked harts)", mSamples, Count);
+
+  //
+  // Remote fences to every started hart, including the caller.
+  //
+  for (Round = 0; Round < mIterations; Round++) {
+    Start = GetPerformanceCounter ();
+    SbiRemoteFenceI (NULL, (UINTN)-1);
+    mSamples[Round] = GetPerformanceCounter () - Start;
+  }
+
+  ReportSamples (L"SbiRemoteFenceI (all)", mSamples, mIterations);
+
+  for (Round = 0; Round < mIterations; Round++) {
+    Start = GetPerformanceCounter ();
+    SbiRemoteSfenceVma (NULL, (UINTN)-1, 0, 0);
+    mSamples[Round] = GetPerformanceCounter () - Start;
+  }
+
+  ReportSamples (L"SbiRemoteSfenceVma (all)", mSamples, mIterations);
+
+  HartMask = 1;
+  for (Round = 0; Round < mIterations; Round++) {
+    Start = GetPerformanceCounter ();
+    SbiRemoteSfenceVma (&HartMask, mBootHartId, 0, 0);
+    mSamples[Round] = GetPerformanceCounter () - Start;
+  }
+
+  ReportSamples (L"SbiRemoteSfenceVma (self)", mSamples, mIterations);
+
+  for (Index = 0; Index < Started; Index++) {
+    StopHart (Index, NULL);
+  }
+
+  FreePool (AckBefore);
+}
+
+/**
+  Parse the command line.
+
+  @param[in]  ImageHandle   The image handle of this application.
+
+  @retval EFI_SUCCESS             The command line was parsed.
+  @retval EFI_INVALID_PARAMETER   The command line is malformed.
+**/
+STATIC
+EFI_STATUS
+ParseCommandLine (
+  IN EFI_HANDLE  ImageHandle
+  )
+{
+  EFI_STATUS                     Status;
+  EFI_SHELL_PARAMETERS_PROTOCOL  *ShellParameters;
+
+  Status = gBS->HandleProtocol (
+                  ImageHandle,
+                  &gEfiShellParametersProtocolGuid,
+                  (VOID **)&ShellParameters
+                  );
+  if (EFI_ERROR (Status) || (ShellParameters->Argc == 1)) {
+    return EFI_SUCCESS;
+  }
+
+  if ((ShellParameters->Argc == 3) &&
+      (StrCmp (ShellParameters->Argv[1], L"-n") == 0))
+  {
+    mIterations = StrDecimalToUintn (ShellParameters->Argv[2]);
+    if ((mIterations > 0) && (mIterations <= MAX_UINT32)) {
+      return EFI_SUCCESS;
+    }
+  }
+
+  Print (L"Usage: SbiPerfTest [-n Iterations]\n");
+  return EFI_INVALID_PARAMETER;
+}
+
+/**
+  The entry point of the SBI performance self-test.
+
+  @param[in] ImageHandle    The firmware allocated handle for the EFI image.
+  @param[in] SystemTable    A pointer to the EFI System Table.
+
+  @retval EFI_SUCCESS       All measurements completed.
+  @retval EFI_DEVICE_ERROR  At least one hart did not respond.
+  @retval other             The test could not be run.
+**/
+EFI_STATUS
+EFIAPI
+SbiPerfTestMain (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       SpecVersion;
+  UINTN       ImplId;
+  UINTN       ImplVersion;
+  UINTN       SampleCount;
+
+  Status = ParseCommandLine (ImageHandle);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = DiscoverHarts ();
+  if (EFI_ERROR (Status)) {
+    Print (L"Unable to identify the boot hart\n");
+    return Status;
+  }
+
+  SpecVersion = 0;
+  SbiGetSpecVersion (&SpecVersion);
+  SbiGetImplId (&ImplId);
+  SbiGetImplVersion (&ImplVersion);
+  Print (
+    L"SBI spec %u.%u, implementation %u version 0x%lx\n",
+    (SpecVersion >> 24) & 0x7F,
+    SpecVersion & 0xFFFFFF,
+    ImplId,
+    ImplVersion
+    );
+  Print (
+    L"Boot hart %u, %u stopped harts, %u iterations, timer %lu Hz\n",
+    mBootHartId,
+    mHartCount,
+    mIterations,
+    GetPerformanceCounterProperties (NULL, NULL)
+    );
+
+  //
+  // HSM needs three samples per hart and iteration, everything else at most
+  // one per hart and iteration.
+  //
+  SampleCount = mIterations * MAX (mHartCount * 3, 1);
+  mSamples    = AllocatePool (SampleCount * sizeof (UINT64));
+  mMailbox    = AllocateZeroPool (MAX (mHartCount, 1) * sizeof (SBI_PERF_HART_MAILBOX));
+  if ((mSamples == NULL) || (mMailbox == NULL)) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Exit;
+  }
+
+  mTimeoutTicks = DivU64x32 (
+                    MultU64x32 (GetPerformanceCounterProperties (NULL, NULL), SBI_PERF_HART_TIMEOUT_US),
+                    1000000
+                    );
+
+  Print (
+    L"\n%-26s %8s %9s %9s %9s %9s %9s %9s\n",
+    L"Call (ns)",
+    L"Samples",
+    L"Min",
+    L"P50",
+    L"P90",
+    L"P99",
+    L"Max",
+    L"Avg"
+    );
+
+  MeasureLocalCalls ();
+  MeasureHsm ();
+  MeasureIpiAndFences ();
+
+  Status = mHartFailure ? EFI_DEVICE_ERROR : EFI_SUCCESS;
+
+Exit:
+  //
+  // Keep the mailboxes allocated if a hart could still be running the stub.
+  //
+  if ((mMailbox != NULL) && !mHartFailure) {
+    FreePool (mMailbox);
+  }
+
+  if (mSamples != NULL) {
+    FreePool (mSamples);
+  }
+
+  return Status;
+}
@@ -0,0 +1,92 @@
+/** @file
+  RISC-V SBI performance self-test application definitions.
+
+  Copyright (c) 2024, SOPHGO Inc. All rights reserved.<BR>
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef SBI_PERF_TEST_H_
+#define SBI_PERF_TEST_H_
+
+#include <Uefi.h>
+
+#include <Protocol/RiscVBootProtocol.h>
+#include <Protocol/ShellParameters.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/RiscVEdk2SbiLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+//
+// Default number of samples taken for every measurement.
+//
+#define SBI_PERF_DEFAULT_ITERATIONS  256
+
+//
+// Time a secondary hart is given to answer a request before it is reported
+// as unresponsive.
+//
+#define SBI_PERF_HART_TIMEOUT_US  100000
+
+//
+// HSM hart states returned by SbiHartGetStatus ().
+//
+#define SBI_PERF_HSM_STARTED  0
+#define SBI_PERF_HSM_STOPPED  1
+
+//
+// Mailbox states and commands. They are shared with SecondaryHart.S.
+//
+#define SBI_PERF_HART_STATE_IDLE     0
+#define SBI_PERF_HART_STATE_RUNNING  1
+#define SBI_PERF_HART_COMMAND_NONE   0
+#define SBI_PERF_HART_COMMAND_STOP   1
+
+///
+/// Per-hart mailbox used to talk to the secondary hart entry stub.
+/// The layout is mirrored by the offsets in SecondaryHart.S and the
+/// structure is padded to a cache line to avoid false sharing.
+///
+typedef struct {
+  volatile UINT64    State;       ///< SBI_PERF_HART_STATE_*, written by the hart.
+  volatile UINT64    Command;     ///< SBI_PERF_HART_COMMAND_*, written by the boot hart.
+  volatile UINT64    IpiAck;      ///< Incremented for every software interrupt seen.
+  volatile UINT64    ArrivalTime; ///< time CSR when the hart entered the stub.
+  UINT64             Reserved[4];
+} SBI_PERF_HART_MAILBOX;
+
+///
+/// Summary of one series of samples, in nanoseconds.
+///
+typedef struct {
+  UINTN     Count;
+  UINT64    Min;
+  UINT64    P50;
+  UINT64    P90;
+  UINT64    P99;
+  UINT64    Max;
+  UINT64    Average;
+} SBI_PERF_STATS;
+
+/**
+  Entry point of a secondary hart started through SBI HSM.
+
+  Publishes the arrival time and spins on the mailbox, acknowledging every
+  supervisor software interrupt, until it is asked to stop.
+
+  @param[in]  HartId    The hart id, set by the SBI implementation.
+  @param[in]  Mailbox   The SBI_PERF_HART_MAILBOX of this hart.
+**/
+VOID
+EFIAPI
+SbiPerfSecondaryEntry (
+  IN  UINTN                  HartId,
+  IN  SBI_PERF_HART_MAILBOX  *Mailbox
+  );
+
+#endif
@@ -0,0 +1,98 @@
+/** @file
+  RISC-V Advanced Interrupt Architecture (AIA) definitions.
+
+  Supervisor-level CSRs, IMSIC interrupt file registers and APLIC domain
+  registers as described in "The RISC-V Advanced Interrupt Architecture",
+  version 1.0.
+
+  Copyright (c) 2024, SOPHGO Inc. All rights reserved.<BR>
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef RISCV_AIA_INDUSTRY_STANDARD_H_
+#define RISCV_AIA_INDUSTRY_STANDARD_H_
+
+//
+// Supervisor-level AIA CSRs.
+//
+#define RISCV_CSR_SUPERVISOR_SISELECT  0x150
+#define RISCV_CSR_SUPERVISOR_SIREG     0x151
+#define RISCV_CSR_SUPERVISOR_STOPEI    0x15C
+#define RISCV_CSR_SUPERVISOR_STOPI     0xDB0
+
+//
+// IMSIC interrupt file registers, accessed through siselect/sireg.
+//
+#define IMSIC_EIDELIVERY          0x70
+#define IMSIC_EIDELIVERY_DISABLE  0
+#define IMSIC_EIDELIVERY_ENABLE   1
+#define IMSIC_EITHRESHOLD         0x72
+#define IMSIC_EIP0                0x80
+#define IMSIC_EIE0                0xC0
+
+//
+// Every eipX/eieX register holds XLEN bits. On RV64 only the even numbered
+// registers exist.
+//
+#define IMSIC_EIX_BITS             64
+#define IMSIC_EIX_REG(Id)          (((Id) / IMSIC_EIX_BITS) * 2)
+#define IMSIC_EIX_BIT(Id)          (1ULL << ((Id) % IMSIC_EIX_BITS))
+
+#define IMSIC_TOPEI_ID_SHIFT       16
+#define IMSIC_TOPEI_ID_MASK        0x7FF
+
+#define IMSIC_MIN_ID               63
+#define IMSIC_MAX_ID               2047
+
+//
+// Interrupt file MMIO layout. An MSI is a 32-bit little-endian write of the
+// interrupt identity to SETEIPNUM_LE.
+//
+#define IMSIC_MMIO_PAGE_SHIFT      12
+#define IMSIC_MMIO_PAGE_SIZE       (1 << IMSIC_MMIO_PAGE_SHIFT)
+#define IMSIC_MMIO_SETEIPNUM_LE    0x00
+
+//
+// APLIC domain registers.
+//
+#define APLIC_DOMAINCFG                0x0000
+#define APLIC_DOMAINCFG_IE             BIT8
+#define APLIC_DOMAINCFG_DM             BIT2
+#define APLIC_DOMAINCFG_BE             BIT0
+
+#define APLIC_SOURCECFG(Source)        (0x0004 + ((Source) - 1) * 4)
+#define APLIC_SOURCECFG_D              BIT10
+#define APLIC_SOURCECFG_SM_INACTIVE    0x0
+#define APLIC_SOURCECFG_SM_DETACHED    0x1
+#define APLIC_SOURCECFG_SM_EDGE_RISE   0x4
+#define APLIC_SOURCECFG_SM_EDGE_FALL   0x5
+#define APLIC_SOURCECFG_SM_LEVEL_HIGH  0x6
+#define APLIC_SOURCECFG_SM_LEVEL_LOW   0x7
+#define APLIC_SOURCECFG_SM_MASK        0x7
+
+#define APLIC_SETIE(Index)             (0x1E00 + (Index) * 4)
+#define APLIC_SETIENUM                 0x1EDC
+#define APLIC_CLRIENUM                 0x1FDC
+#define APLIC_SETIPNUM_LE              0x2000
+
+#define APLIC_TARGET(Source)           (0x3004 + ((Source) - 1) * 4)
+#define APLIC_TARGET_HART_SHIFT        18
+#define APLIC_TARGET_HART_MASK         0x3FFF
+#define APLIC_TARGET_IPRIO_MASK        0xFF
+#define APLIC_TARGET_EIID_MASK         0x7FF
+
+#define APLIC_MAX_SOURCES              1023
+
+//
+// APLIC interrupt delivery control (IDC) structures, direct delivery mode only.
+//
+#define APLIC_IDC(Hart)                (0x4000 + (Hart) * 32)
+#define APLIC_IDC_IDELIVERY            0x00
+#define APLIC_IDC_ITHRESHOLD           0x08
+#define APLIC_IDC_CLAIMI               0x1C
+#define APLIC_IDC_ID_SHIFT             16
+#define APLIC_IDC_ID_MASK              0x3FF
+
+#endif
@@ -0,0 +1,101 @@
+/** @file
+  RISC-V supervisor timer deadline library definitions.
+
+  Helpers for the Timer Architectural Protocol drivers that program the
+  supervisor timer comparator: conversion between 100 ns units and timer
+  ticks, coalescing of deadlines, and programming through Sstc or SBI.
+
+  Copyright (c) 2024, SOPHGO Inc. All rights reserved.<BR>
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef RISCV_TIMER_DEADLINE_LIB_H_
+#define RISCV_TIMER_DEADLINE_LIB_H_
+
+/**
+  Convert a time in 100 ns units into timer ticks.
+
+  @param Period     The time in 100 ns units.
+
+  @return The number of timer ticks, at least one.
+**/
+UINT64
+EFIAPI
+RiscVTimerPeriodToTicks (
+  IN UINT64  Period
+  );
+
+/**
+  Convert timer ticks into a time in 100 ns units.
+
+  @param Ticks      The number of timer ticks.
+
+  @return The time in 100 ns units.
+**/
+UINT64
+EFIAPI
+RiscVTimerTicksToPeriod (
+  IN UINT64  Ticks
+  );
+
+/**
+  Compute the next timer deadline after a timer interrupt.
+
+  Deadlines stay on the grid of the timer period, so the tick does not
+  drift with interrupt latency. Deadlines that are already due, or due
+  within the coalescing window, are folded into the current interrupt
+  instead of raising back-to-back interrupts.
+
+  @param Deadline             The deadline of the current interrupt.
+  @param Now                  The current timer value.
+  @param PeriodTicks          The timer period in ticks, 0 if the timer is
+                              disabled.
+  @param CoalesceWindowTicks  The coalescing window in ticks.
+
+  @return The absolute timer value of the next interrupt, or MAX_UINT64 if
+          the timer is disabled.
+**/
+UINT64
+EFIAPI
+RiscVTimerNextDeadline (
+  IN UINT64  Deadline,
+  IN UINT64  Now,
+  IN UINT64  PeriodTicks,
+  IN UINT64  CoalesceWindowTicks
+  );
+
+/**
+  Check whether every enabled hart in the device tree reports the Sstc
+  extension, so the comparator can be written through stimecmp.
+
+  The M-mode firmware must also set menvcfg.STCE, which the device tree
+  does not tell, so the caller decides whether Sstc may be used at all.
+
+  @retval TRUE      Every enabled hart implements Sstc.
+  @retval FALSE     The device tree is missing, or a hart lacks Sstc.
+**/
+BOOLEAN
+EFIAPI
+RiscVTimerSstcSupported (
+  VOID
+  );
+
+/**
+  Program the supervisor timer comparator.
+
+  Both ways clear a pending timer interrupt if the deadline is in the
+  future.
+
+  @param Deadline   The absolute timer value of the next interrupt.
+  @param UseSstc    TRUE to write stimecmp directly, FALSE to ask the SBI
+                    implementation through an ecall.
+**/
+VOID
+EFIAPI
+RiscVTimerProgramDeadline (
+  IN UINT64   Deadline,
+  IN BOOLEAN  UseSstc
+  );
+
+#endif
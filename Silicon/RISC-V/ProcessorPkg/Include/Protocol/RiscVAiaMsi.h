@@ -0,0 +1,157 @@
+/** @file
+  RISC-V AIA MSI protocol.
+
+  Produced by the AIA interrupt controller driver next to the hardware
+  interrupt protocol. It hands out IMSIC interrupt identities that can be
+  used as message signalled interrupts and programs them into the MSI or
+  MSI-X capability of a PCI function. The interrupt sources returned by this
+  protocol are registered, enabled and acknowledged through
+  EFI_HARDWARE_INTERRUPT_PROTOCOL like any other source.
+
+  Copyright (c) 2024, SOPHGO Inc. All rights reserved.<BR>
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef RISCV_AIA_MSI_PROTOCOL_H_
+#define RISCV_AIA_MSI_PROTOCOL_H_
+
+#include <Protocol/HardwareInterrupt.h>
+#include <Protocol/PciIo.h>
+
+#define RISCV_AIA_MSI_PROTOCOL_GUID \
+  { 0x4ab136c4, 0x4dde, 0x413f, { 0xa8, 0x13, 0x3d, 0x20, 0x8b, 0xc4, 0xac, 0x78 } }
+
+typedef struct _RISCV_AIA_MSI_PROTOCOL RISCV_AIA_MSI_PROTOCOL;
+
+/**
+  Allocate a block of MSI interrupt sources.
+
+  The block is naturally aligned to Count so it can be used with multiple
+  message MSI, where the function modifies the low bits of the message data.
+
+  @param[in]  This          Instance pointer for this protocol.
+  @param[in]  Count         Number of interrupt sources, a power of two.
+  @param[out] FirstSource   First interrupt source of the block.
+
+  @retval EFI_SUCCESS            The block was allocated.
+  @retval EFI_INVALID_PARAMETER  Count is zero or not a power of two, or
+                                 FirstSource is NULL.
+  @retval EFI_OUT_OF_RESOURCES   No free block of Count sources is left.
+  @retval EFI_UNSUPPORTED        The platform has no IMSIC.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *RISCV_AIA_MSI_ALLOCATE)(
+  IN  RISCV_AIA_MSI_PROTOCOL     *This,
+  IN  UINTN                      Count,
+  OUT HARDWARE_INTERRUPT_SOURCE  *FirstSource
+  );
+
+/**
+  Free a block of MSI interrupt sources.
+
+  The sources must have been disabled and their handlers unregistered.
+
+  @param[in]  This          Instance pointer for this protocol.
+  @param[in]  FirstSource   First interrupt source of the block.
+  @param[in]  Count         Number of interrupt sources passed to Allocate().
+
+  @retval EFI_SUCCESS            The block was freed.
+  @retval EFI_INVALID_PARAMETER  The block was not allocated by Allocate().
+**/
+typedef
+EFI_STATUS
+(EFIAPI *RISCV_AIA_MSI_FREE)(
+  IN  RISCV_AIA_MSI_PROTOCOL     *This,
+  IN  HARDWARE_INTERRUPT_SOURCE  FirstSource,
+  IN  UINTN                      Count
+  );
+
+/**
+  Return the message address and data that raise an interrupt source.
+
+  @param[in]  This          Instance pointer for this protocol.
+  @param[in]  Source        Interrupt source returned by Allocate().
+  @param[out] Address       Address the device must write to.
+  @param[out] Data          32-bit value the device must write.
+
+  @retval EFI_SUCCESS            Address and Data are valid.
+  @retval EFI_INVALID_PARAMETER  Source is not an allocated MSI source.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *RISCV_AIA_MSI_GET_TARGET)(
+  IN  RISCV_AIA_MSI_PROTOCOL     *This,
+  IN  HARDWARE_INTERRUPT_SOURCE  Source,
+  OUT UINT64                     *Address,
+  OUT UINT32                     *Data
+  );
+
+/**
+  Allocate MSI interrupt sources for a PCI function and program its MSI-X or
+  MSI capability with their targets.
+
+  MSI-X is preferred over MSI when the function implements both. On return
+  the capability is enabled and every vector is unmasked, the caller still
+  has to register and enable the returned sources and to enable bus
+  mastering on the function.
+
+  @param[in]      This          Instance pointer for this protocol.
+  @param[in]      PciIo         The PCI function to program.
+  @param[in, out] Count         On input, the number of vectors requested.
+                                On output, the number of vectors programmed,
+                                which may be lower if the function supports
+                                fewer vectors.
+  @param[out]     FirstSource   Interrupt source of vector 0. Vector N uses
+                                FirstSource + N.
+
+  @retval EFI_SUCCESS            The function now signals MSIs.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL or Count is zero.
+  @retval EFI_UNSUPPORTED        The function has no MSI or MSI-X capability.
+  @retval EFI_OUT_OF_RESOURCES   Not enough MSI sources are left.
+  @retval Others                 Accessing the function failed.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *RISCV_AIA_MSI_ENABLE_PCI)(
+  IN     RISCV_AIA_MSI_PROTOCOL     *This,
+  IN     EFI_PCI_IO_PROTOCOL        *PciIo,
+  IN OUT UINTN                      *Count,
+  OUT    HARDWARE_INTERRUPT_SOURCE  *FirstSource
+  );
+
+/**
+  Disable MSI-X or MSI on a PCI function and free its interrupt sources.
+
+  @param[in]  This          Instance pointer for this protocol.
+  @param[in]  PciIo         The PCI function programmed by EnablePci().
+  @param[in]  FirstSource   The FirstSource returned by EnablePci().
+  @param[in]  Count         The Count returned by EnablePci().
+
+  @retval EFI_SUCCESS            MSIs are disabled and the sources freed.
+  @retval EFI_INVALID_PARAMETER  PciIo is NULL or the sources were not
+                                 allocated.
+  @retval Others                 Accessing the function failed.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *RISCV_AIA_MSI_DISABLE_PCI)(
+  IN  RISCV_AIA_MSI_PROTOCOL     *This,
+  IN  EFI_PCI_IO_PROTOCOL        *PciIo,
+  IN  HARDWARE_INTERRUPT_SOURCE  FirstSource,
+  IN  UINTN                      Count
+  );
+
+struct _RISCV_AIA_MSI_PROTOCOL {
+  RISCV_AIA_MSI_ALLOCATE       Allocate;
+  RISCV_AIA_MSI_FREE           Free;
+  RISCV_AIA_MSI_GET_TARGET     GetTarget;
+  RISCV_AIA_MSI_ENABLE_PCI     EnablePci;
+  RISCV_AIA_MSI_DISABLE_PCI    DisablePci;
+};
+
+extern EFI_GUID  gRiscVAiaMsiProtocolGuid;
+
+#endif
@@ -22,6 +22,17 @@
 
 #define ASM_FUNC(Name)  _ASM_FUNC(ASM_PFX(Name), .text. ## Name)
 
+//
+// Interrupt type of the supervisor external interrupt, for
+// EFI_CPU_ARCH_PROTOCOL.RegisterInterruptHandler (). The software and timer
+// interrupt types come from DebugSupport.h.
+//
+#if defined (EXCEPT_RISCV_IRQ_EXT_FROM_SMODE)
+#define EXCEPT_RISCV_EXTERNAL_INT  EXCEPT_RISCV_IRQ_EXT_FROM_SMODE
+#elif !defined (EXCEPT_RISCV_EXTERNAL_INT)
+#define EXCEPT_RISCV_EXTERNAL_INT  2
+#endif
+
 #if defined (MDE_CPU_RISCV64)
 typedef UINT64 RISC_V_REGS_PROTOTYPE;
 #else
@@ -144,6 +144,29 @@ TranslateError (
   }
 }
 
+/**
+  Get the hart mask value passed to the IPI and RFENCE extensions.
+
+  Since SBI v0.2 the hart mask is passed by value and not by reference. It is
+  ignored when the hart mask base is -1, so HartMask may be NULL in that case.
+
+  @param[in] HartMask   Pointer to the scalar hart mask bit-vector, or NULL.
+
+  @retval The hart mask bit-vector.
+**/
+STATIC
+UINTN
+SbiHartMaskValue (
+  IN  UINTN  *HartMask
+  )
+{
+  if (HartMask == NULL) {
+    return 0;
+  }
+
+  return *HartMask;
+}
+
 //
 // OpenSBI library interface function for the base extension
 //
@@ -232,7 +255,7 @@ SbiProbeExtension (
 {
   SBI_RET  Ret;
 
-  Ret = SbiCall (SBI_EXT_BASE, SBI_EXT_BASE_PROBE_EXT, 0);
+  Ret = SbiCall (SBI_EXT_BASE, SBI_EXT_BASE_PROBE_EXT, 1, ExtensionId);
 
   *ProbeResult = (UINTN)Ret.Value;
 }
@@ -432,7 +455,7 @@ SbiSendIpi (
           SBI_EXT_IPI,
           SBI_EXT_IPI_SEND_IPI,
           2,
-          (UINTN)HartMask,
+          SbiHartMaskValue (HartMask),
           HartMaskBase
           );
 
@@ -465,7 +488,7 @@ SbiRemoteFenceI (
           SBI_EXT_RFENCE,
           SBI_EXT_RFENCE_REMOTE_FENCE_I,
           2,
-          (UINTN)HartMask,
+          SbiHartMaskValue (HartMask),
           HartMaskBase
           );
 
@@ -508,7 +531,7 @@ SbiRemoteSfenceVma (
           SBI_EXT_RFENCE,
           SBI_EXT_RFENCE_REMOTE_SFENCE_VMA,
           4,
-          (UINTN)HartMask,
+          SbiHartMaskValue (HartMask),
           HartMaskBase,
           StartAddr,
           Size
@@ -555,7 +578,7 @@ SbiRemoteSfenceVmaAsid (
           SBI_EXT_RFENCE,
           SBI_EXT_RFENCE_REMOTE_SFENCE_VMA_ASID,
           5,
-          (UINTN)HartMask,
+          SbiHartMaskValue (HartMask),
           HartMaskBase,
           StartAddr,
           Size,
@@ -607,7 +630,7 @@ SbiRemoteHFenceGvmaVmid (
           SBI_EXT_RFENCE,
           SBI_EXT_RFENCE_REMOTE_HFENCE_GVMA,
           5,
-          (UINTN)HartMask,
+          SbiHartMaskValue (HartMask),
           HartMaskBase,
           StartAddr,
           Size,
@@ -657,7 +680,7 @@ SbiRemoteHFenceGvma (
           SBI_EXT_RFENCE,
           SBI_EXT_RFENCE_REMOTE_HFENCE_GVMA_VMID,
           4,
-          (UINTN)HartMask,
+          SbiHartMaskValue (HartMask),
           HartMaskBase,
           StartAddr,
           Size
@@ -708,7 +731,7 @@ SbiRemoteHFenceVvmaAsid (
           SBI_EXT_RFENCE,
           SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA,
           5,
-          (UINTN)HartMask,
+          SbiHartMaskValue (HartMask),
           HartMaskBase,
           StartAddr,
           Size,
@@ -758,7 +781,7 @@ SbiRemoteHFenceVvma (
           SBI_EXT_RFENCE,
           SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA_ASID,
           4,
-          (UINTN)HartMask,
+          SbiHartMaskValue (HartMask),
           HartMaskBase,
           StartAddr,
           Size
@@ -17,7 +17,11 @@
 
 #include "CpuExceptionHandlerLib.h"
 
-STATIC EFI_CPU_INTERRUPT_HANDLER  mInterruptHandlers[2];
+//
+// Handlers indexed by EXCEPT_RISCV_SOFTWARE_INT, EXCEPT_RISCV_TIMER_INT and
+// EXCEPT_RISCV_EXTERNAL_INT.
+//
+STATIC EFI_CPU_INTERRUPT_HANDLER  mInterruptHandlers[3];
 
 /**
   Initializes all CPU exceptions entries and provides the default exception handlers.
@@ -75,6 +79,10 @@ RegisterCpuInterruptHandler (
   )
 {
   DEBUG ((DEBUG_INFO, "%a: Type:%x Handler: %x\n", __FUNCTION__, InterruptType, InterruptHandler));
+  if ((UINTN)InterruptType >= ARRAY_SIZE (mInterruptHandlers)) {
+    return EFI_UNSUPPORTED;
+  }
+
   mInterruptHandlers[InterruptType] = InterruptHandler;
   return EFI_SUCCESS;
 }
@@ -105,6 +113,8 @@ RiscVSupervisorModeTrapHandler (
     SCause &= ~(1UL << (sizeof (UINTN) * 8- 1));
     if ((SCause == SCAUSE_SUPERVISOR_TIMER_INT) && (mInterruptHandlers[EXCEPT_RISCV_TIMER_INT] != NULL)) {
       mInterruptHandlers[EXCEPT_RISCV_TIMER_INT](EXCEPT_RISCV_TIMER_INT, RiscVSystemContext);
+    } else if ((SCause == SCAUSE_SUPERVISOR_EXTERNAL_INT) && (mInterruptHandlers[EXCEPT_RISCV_EXTERNAL_INT] != NULL)) {
+      mInterruptHandlers[EXCEPT_RISCV_EXTERNAL_INT](EXCEPT_RISCV_EXTERNAL_INT, RiscVSystemContext);
     }
   }
 }
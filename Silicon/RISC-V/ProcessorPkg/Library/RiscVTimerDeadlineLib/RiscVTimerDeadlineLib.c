@@ -0,0 +1,230 @@
+/** @file
+  RISC-V supervisor timer deadline library.
+
+  Copyright (c) 2024, SOPHGO Inc. All rights reserved.<BR>
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <libfdt.h>
+#include <Guid/FdtHob.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseRiscVSbiLib.h>
+#include <Library/HobLib.h>
+#include <Library/PcdLib.h>
+#include <Library/RiscVTimerDeadlineLib.h>
+
+//
+// Timer periods are expressed in 100 ns units.
+//
+#define TIMER_PERIOD_UNITS_PER_SECOND  10000000
+
+/**
+  Write the supervisor timer compare CSR of the Sstc extension.
+
+  @param Value      The absolute timer value of the next interrupt.
+**/
+VOID
+EFIAPI
+RiscVTimerWriteStimecmp (
+  IN UINT64  Value
+  );
+
+/**
+  Convert a time in 100 ns units into timer ticks.
+
+  @param Period     The time in 100 ns units.
+
+  @return The number of timer ticks, at least one.
+**/
+UINT64
+EFIAPI
+RiscVTimerPeriodToTicks (
+  IN UINT64  Period
+  )
+{
+  UINT64  Ticks;
+
+  Ticks = DivU64x32 (
+            MultU64x64 (Period, PcdGet64 (PcdCpuCoreCrystalClockFrequency)),
+            TIMER_PERIOD_UNITS_PER_SECOND
+            );
+
+  return MAX (Ticks, 1);
+}
+
+/**
+  Convert timer ticks into a time in 100 ns units.
+
+  @param Ticks      The number of timer ticks.
+
+  @return The time in 100 ns units.
+**/
+UINT64
+EFIAPI
+RiscVTimerTicksToPeriod (
+  IN UINT64  Ticks
+  )
+{
+  return DivU64x64Remainder (
+           MultU64x32 (Ticks, TIMER_PERIOD_UNITS_PER_SECOND),
+           PcdGet64 (PcdCpuCoreCrystalClockFrequency),
+           NULL
+           );
+}
+
+/**
+  Compute the next timer deadline after a timer interrupt.
+
+  @param Deadline             The deadline of the current interrupt.
+  @param Now                  The current timer value.
+  @param PeriodTicks          The timer period in ticks, 0 if the timer is
+                              disabled.
+  @param CoalesceWindowTicks  The coalescing window in ticks.
+
+  @return The absolute timer value of the next interrupt, or MAX_UINT64 if
+          the timer is disabled.
+**/
+UINT64
+EFIAPI
+RiscVTimerNextDeadline (
+  IN UINT64  Deadline,
+  IN UINT64  Now,
+  IN UINT64  PeriodTicks,
+  IN UINT64  CoalesceWindowTicks
+  )
+{
+  UINT64  Skipped;
+
+  if (PeriodTicks == 0) {
+    return MAX_UINT64;
+  }
+
+  Deadline += PeriodTicks;
+  if (Deadline <= Now + CoalesceWindowTicks) {
+    Skipped   = DivU64x64Remainder (Now + CoalesceWindowTicks - Deadline, PeriodTicks, NULL);
+    Deadline += MultU64x64 (Skipped + 1, PeriodTicks);
+  }
+
+  return Deadline;
+}
+
+/**
+  Check whether an FDT cpu node advertises the Sstc extension.
+
+  Both the "riscv,isa-extensions" string list and the multi-letter
+  extensions of the "riscv,isa" string are looked at.
+
+  @param Fdt        The flattened device tree.
+  @param Node       Offset of the cpu node.
+
+  @retval TRUE      The hart implements Sstc.
+  @retval FALSE     The hart does not implement Sstc.
+**/
+STATIC
+BOOLEAN
+CpuNodeHasSstc (
+  IN CONST VOID  *Fdt,
+  IN INT32       Node
+  )
+{
+  CONST CHAR8  *Isa;
+  CONST CHAR8  *Match;
+
+  if (fdt_stringlist_search (Fdt, Node, "riscv,isa-extensions", "sstc") >= 0) {
+    return TRUE;
+  }
+
+  Isa = fdt_getprop (Fdt, Node, "riscv,isa", NULL);
+  if (Isa == NULL) {
+    return FALSE;
+  }
+
+  for (Match = AsciiStrStr (Isa, "_sstc"); Match != NULL; Match = AsciiStrStr (Match + 1, "_sstc")) {
+    if ((Match[5] == '\0') || (Match[5] == '_')) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+  Check whether every enabled hart in the device tree reports the Sstc
+  extension, so the comparator can be written through stimecmp.
+
+  @retval TRUE      Every enabled hart implements Sstc.
+  @retval FALSE     The device tree is missing, or a hart lacks Sstc.
+**/
+BOOLEAN
+EFIAPI
+RiscVTimerSstcSupported (
+  VOID
+  )
+{
+  EFI_HOB_GUID_TYPE  *GuidHob;
+  CONST VOID         *Fdt;
+  CONST CHAR8        *Property;
+  INT32              CpusNode;
+  INT32              Node;
+  BOOLEAN            Found;
+
+  GuidHob = GetFirstGuidHob (&gFdtHobGuid);
+  if (GuidHob == NULL) {
+    return FALSE;
+  }
+
+  Fdt = (CONST VOID *)(UINTN)*((UINT64 *)GET_GUID_HOB_DATA (GuidHob));
+  if ((Fdt == NULL) || (fdt_check_header (Fdt) != 0)) {
+    return FALSE;
+  }
+
+  CpusNode = fdt_path_offset (Fdt, "/cpus");
+  if (CpusNode < 0) {
+    return FALSE;
+  }
+
+  Found = FALSE;
+  for (Node = fdt_first_subnode (Fdt, CpusNode); Node >= 0; Node = fdt_next_subnode (Fdt, Node)) {
+    Property = fdt_getprop (Fdt, Node, "device_type", NULL);
+    if ((Property == NULL) || (AsciiStrCmp (Property, "cpu") != 0)) {
+      continue;
+    }
+
+    Property = fdt_getprop (Fdt, Node, "status", NULL);
+    if ((Property != NULL) && (AsciiStrCmp (Property, "okay") != 0)) {
+      continue;
+    }
+
+    if (!CpuNodeHasSstc (Fdt, Node)) {
+      return FALSE;
+    }
+
+    Found = TRUE;
+  }
+
+  return Found;
+}
+
+/**
+  Program the supervisor timer comparator.
+
+  @param Deadline   The absolute timer value of the next interrupt.
+  @param UseSstc    TRUE to write stimecmp directly, FALSE to ask the SBI
+                    implementation through an ecall.
+**/
+VOID
+EFIAPI
+RiscVTimerProgramDeadline (
+  IN UINT64   Deadline,
+  IN BOOLEAN  UseSstc
+  )
+{
+  if (UseSstc) {
+    RiscVTimerWriteStimecmp (Deadline);
+  } else {
+    SbiSetTimer (Deadline);
+  }
+}
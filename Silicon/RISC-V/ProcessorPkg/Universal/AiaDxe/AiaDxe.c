@@ -0,0 +1,702 @@
+/** @file
+  RISC-V AIA interrupt controller DXE driver.
+
+  Routes supervisor external interrupts of the boot hart to device drivers
+  through the hardware interrupt protocols. With an S-level IMSIC, wired
+  APLIC sources are forwarded as MSIs and the remaining interrupt identities
+  are handed out to PCI functions through the RISC-V AIA MSI protocol.
+  Without an IMSIC, the APLIC is driven in direct delivery mode.
+
+  Copyright (c) 2024, SOPHGO Inc. All rights reserved.<BR>
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "AiaDxe.h"
+
+AIA_CONTROLLER  mAia;
+
+STATIC HARDWARE_INTERRUPT_HANDLER            mHandlers[AIA_MAX_SOURCES];
+STATIC EFI_HARDWARE_INTERRUPT2_TRIGGER_TYPE  mTriggerTypes[APLIC_MAX_SOURCES + 1];
+STATIC EFI_EVENT                             mExitBootServicesEvent;
+STATIC VOID                                  *mCpuArchRegistration;
+
+/**
+  Write an IMSIC interrupt file register of the current hart.
+
+  @param[in]  Register      The register number.
+  @param[in]  Value         The value to write.
+**/
+STATIC
+VOID
+ImsicWrite (
+  IN UINTN  Register,
+  IN UINTN  Value
+  )
+{
+  csr_write (RISCV_CSR_SUPERVISOR_SISELECT, Register);
+  csr_write (RISCV_CSR_SUPERVISOR_SIREG, Value);
+}
+
+/**
+  Read an IMSIC interrupt file register of the current hart.
+
+  @param[in]  Register      The register number.
+
+  @return The register value.
+**/
+STATIC
+UINTN
+ImsicRead (
+  IN UINTN  Register
+  )
+{
+  csr_write (RISCV_CSR_SUPERVISOR_SISELECT, Register);
+  return csr_read (RISCV_CSR_SUPERVISOR_SIREG);
+}
+
+/**
+  Set or clear the enable bit of an IMSIC interrupt identity.
+
+  @param[in]  Id            The interrupt identity.
+  @param[in]  Enable        TRUE to enable the identity.
+**/
+STATIC
+VOID
+ImsicSetEnable (
+  IN UINTN    Id,
+  IN BOOLEAN  Enable
+  )
+{
+  csr_write (RISCV_CSR_SUPERVISOR_SISELECT, IMSIC_EIE0 + IMSIC_EIX_REG (Id));
+  if (Enable) {
+    csr_set (RISCV_CSR_SUPERVISOR_SIREG, IMSIC_EIX_BIT (Id));
+  } else {
+    csr_clear (RISCV_CSR_SUPERVISOR_SIREG, IMSIC_EIX_BIT (Id));
+  }
+}
+
+/**
+  Check whether a source is a wired APLIC source.
+
+  @param[in]  Source        The interrupt source.
+
+  @retval TRUE              Source is an APLIC source.
+  @retval FALSE             Source is an MSI only source.
+**/
+STATIC
+BOOLEAN
+AiaIsWired (
+  IN HARDWARE_INTERRUPT_SOURCE  Source
+  )
+{
+  return mAia.HasAplic && (Source >= 1) && (Source <= mAia.AplicNumSources);
+}
+
+/**
+  Check that a source can be used with this controller.
+
+  @param[in]  Source        The interrupt source.
+
+  @retval TRUE              Source is valid.
+  @retval FALSE             Source is out of range.
+**/
+STATIC
+BOOLEAN
+AiaIsValidSource (
+  IN HARDWARE_INTERRUPT_SOURCE  Source
+  )
+{
+  if (Source == 0) {
+    return FALSE;
+  }
+
+  if (mAia.Mode == AiaModeImsic) {
+    return Source < mAia.ImsicNumIds;
+  }
+
+  return Source <= mAia.AplicNumSources;
+}
+
+/**
+  Program the source mode and target of a wired APLIC source.
+
+  @param[in]  Source        The wired source.
+**/
+STATIC
+VOID
+AplicConfigureSource (
+  IN HARDWARE_INTERRUPT_SOURCE  Source
+  )
+{
+  UINT32  SourceMode;
+  UINT32  Target;
+
+  switch (mTriggerTypes[Source]) {
+    case EFI_HARDWARE_INTERRUPT2_TRIGGER_LEVEL_LOW:
+      SourceMode = APLIC_SOURCECFG_SM_LEVEL_LOW;
+      break;
+    case EFI_HARDWARE_INTERRUPT2_TRIGGER_EDGE_FALLING:
+      SourceMode = APLIC_SOURCECFG_SM_EDGE_FALL;
+      break;
+    case EFI_HARDWARE_INTERRUPT2_TRIGGER_EDGE_RISING:
+      SourceMode = APLIC_SOURCECFG_SM_EDGE_RISE;
+      break;
+    default:
+      SourceMode = APLIC_SOURCECFG_SM_LEVEL_HIGH;
+      break;
+  }
+
+  Target = (mAia.AplicHartIndex & APLIC_TARGET_HART_MASK) << APLIC_TARGET_HART_SHIFT;
+  if (mAia.Mode == AiaModeImsic) {
+    Target |= (UINT32)Source & APLIC_TARGET_EIID_MASK;
+  } else {
+    //
+    // All sources share the lowest priority, ties are broken by number.
+    //
+    Target |= 1;
+  }
+
+  MmioWrite32 (mAia.AplicBase + APLIC_SOURCECFG (Source), SourceMode);
+  MmioWrite32 (mAia.AplicBase + APLIC_TARGET (Source), Target);
+}
+
+/**
+  Enable interrupt source Source.
+
+  @param This     Instance pointer for this protocol
+  @param Source   Hardware source of the interrupt
+
+  @retval EFI_SUCCESS       Source interrupt enabled.
+  @retval EFI_UNSUPPORTED   Source is out of range.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+AiaEnableInterruptSource (
+  IN EFI_HARDWARE_INTERRUPT_PROTOCOL  *This,
+  IN HARDWARE_INTERRUPT_SOURCE        Source
+  )
+{
+  if (!AiaIsValidSource (Source)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (mAia.Mode == AiaModeImsic) {
+    ImsicSetEnable (Source, TRUE);
+  }
+
+  if (AiaIsWired (Source)) {
+    AplicConfigureSource (Source);
+    MmioWrite32 (mAia.AplicBase + APLIC_SETIENUM, (UINT32)Source);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Disable interrupt source Source.
+
+  @param This     Instance pointer for this protocol
+  @param Source   Hardware source of the interrupt
+
+  @retval EFI_SUCCESS       Source interrupt disabled.
+  @retval EFI_UNSUPPORTED   Source is out of range.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+AiaDisableInterruptSource (
+  IN EFI_HARDWARE_INTERRUPT_PROTOCOL  *This,
+  IN HARDWARE_INTERRUPT_SOURCE        Source
+  )
+{
+  if (!AiaIsValidSource (Source)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (AiaIsWired (Source)) {
+    MmioWrite32 (mAia.AplicBase + APLIC_CLRIENUM, (UINT32)Source);
+  }
+
+  if (mAia.Mode == AiaModeImsic) {
+    ImsicSetEnable (Source, FALSE);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Register Handler for the specified interrupt source.
+
+  @param This     Instance pointer for this protocol
+  @param Source   Hardware source of the interrupt
+  @param Handler  Callback for interrupt. NULL to unregister
+
+  @retval EFI_SUCCESS           Source was updated to support Handler.
+  @retval EFI_INVALID_PARAMETER Handler is NULL and no handler was registered.
+  @retval EFI_ALREADY_STARTED   A handler is already registered for Source.
+  @retval EFI_UNSUPPORTED       Source is out of range.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+AiaRegisterInterruptSource (
+  IN EFI_HARDWARE_INTERRUPT_PROTOCOL  *This,
+  IN HARDWARE_INTERRUPT_SOURCE        Source,
+  IN HARDWARE_INTERRUPT_HANDLER       Handler
+  )
+{
+  if (!AiaIsValidSource (Source)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if ((Handler == NULL) && (mHandlers[Source] == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if ((Handler != NULL) && (mHandlers[Source] != NULL)) {
+    return EFI_ALREADY_STARTED;
+  }
+
+  mHandlers[Source] = Handler;
+  if (Handler == NULL) {
+    return AiaDisableInterruptSource (This, Source);
+  }
+
+  return AiaEnableInterruptSource (This, Source);
+}
+
+/**
+  Return current state of interrupt source Source.
+
+  @param This     Instance pointer for this protocol
+  @param Source   Hardware source of the interrupt
+  @param InterruptState  TRUE: source enabled, FALSE: source disabled.
+
+  @retval EFI_SUCCESS           InterruptState is valid
+  @retval EFI_INVALID_PARAMETER InterruptState is NULL.
+  @retval EFI_UNSUPPORTED       Source is out of range.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+AiaGetInterruptSourceState (
+  IN EFI_HARDWARE_INTERRUPT_PROTOCOL  *This,
+  IN HARDWARE_INTERRUPT_SOURCE        Source,
+  IN BOOLEAN                          *InterruptState
+  )
+{
+  UINT32  Enabled;
+
+  if (InterruptState == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (!AiaIsValidSource (Source)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (mAia.Mode == AiaModeImsic) {
+    *InterruptState = (ImsicRead (IMSIC_EIE0 + IMSIC_EIX_REG (Source)) & IMSIC_EIX_BIT (Source)) != 0;
+  } else {
+    Enabled         = MmioRead32 (mAia.AplicBase + APLIC_SETIE (Source / 32));
+    *InterruptState = (Enabled & (1U << (Source % 32))) != 0;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Signal to the hardware that the End Of Interrupt state
+  has been reached.
+
+  The interrupt is claimed before its handler is called, so only
+  level-sensitive wired sources forwarded as MSIs need attention: writing
+  their number to setipnum makes the APLIC send a new MSI if the source is
+  still asserted, as recommended by the AIA specification.
+
+  @param This     Instance pointer for this protocol
+  @param Source   Hardware source of the interrupt
+
+  @retval EFI_SUCCESS       Source interrupt EOI'ed.
+  @retval EFI_UNSUPPORTED   Source is out of range.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+AiaEndOfInterrupt (
+  IN EFI_HARDWARE_INTERRUPT_PROTOCOL  *This,
+  IN HARDWARE_INTERRUPT_SOURCE        Source
+  )
+{
+  if (!AiaIsValidSource (Source)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if ((mAia.Mode == AiaModeImsic) && AiaIsWired (Source) &&
+      ((mTriggerTypes[Source] == EFI_HARDWARE_INTERRUPT2_TRIGGER_LEVEL_LOW) ||
+       (mTriggerTypes[Source] == EFI_HARDWARE_INTERRUPT2_TRIGGER_LEVEL_HIGH)))
+  {
+    MmioWrite32 (mAia.AplicBase + APLIC_SETIPNUM_LE, (UINT32)Source);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Return the trigger type of an interrupt source.
+
+  MSI only sources are always reported as rising edge.
+
+  @param This          Instance pointer for this protocol
+  @param Source        Hardware source of the interrupt
+  @param TriggerType   Returns the trigger type.
+
+  @retval EFI_SUCCESS       TriggerType is valid.
+  @retval EFI_UNSUPPORTED   Source is out of range.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+AiaGetTriggerType (
+  IN  EFI_HARDWARE_INTERRUPT2_PROTOCOL      *This,
+  IN  HARDWARE_INTERRUPT_SOURCE             Source,
+  OUT EFI_HARDWARE_INTERRUPT2_TRIGGER_TYPE  *TriggerType
+  )
+{
+  if (!AiaIsValidSource (Source)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (AiaIsWired (Source)) {
+    *TriggerType = mTriggerTypes[Source];
+  } else {
+    *TriggerType = EFI_HARDWARE_INTERRUPT2_TRIGGER_EDGE_RISING;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Set the trigger type of a wired interrupt source.
+
+  @param This          Instance pointer for this protocol
+  @param Source        Hardware source of the interrupt
+  @param TriggerType   The new trigger type.
+
+  @retval EFI_SUCCESS       The trigger type was updated.
+  @retval EFI_UNSUPPORTED   Source is out of range, or is an MSI source and
+                            TriggerType is not rising edge.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+AiaSetTriggerType (
+  IN EFI_HARDWARE_INTERRUPT2_PROTOCOL      *This,
+  IN HARDWARE_INTERRUPT_SOURCE             Source,
+  IN EFI_HARDWARE_INTERRUPT2_TRIGGER_TYPE  TriggerType
+  )
+{
+  BOOLEAN  Enabled;
+
+  if (!AiaIsValidSource (Source)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (!AiaIsWired (Source)) {
+    return (TriggerType == EFI_HARDWARE_INTERRUPT2_TRIGGER_EDGE_RISING) ?
+           EFI_SUCCESS : EFI_UNSUPPORTED;
+  }
+
+  mTriggerTypes[Source] = TriggerType;
+
+  AiaGetInterruptSourceState ((EFI_HARDWARE_INTERRUPT_PROTOCOL *)This, Source, &Enabled);
+  if (Enabled) {
+    AplicConfigureSource (Source);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Call the handler of a claimed interrupt source.
+
+  A source without handler is disabled so it cannot storm.
+
+  @param Source         The claimed source.
+  @param SystemContext  The processor context.
+**/
+STATIC
+VOID
+AiaDispatch (
+  IN HARDWARE_INTERRUPT_SOURCE  Source,
+  IN EFI_SYSTEM_CONTEXT         SystemContext
+  )
+{
+  if ((Source < AIA_MAX_SOURCES) && (mHandlers[Source] != NULL)) {
+    mHandlers[Source](Source, SystemContext);
+  } else {
+    DEBUG ((DEBUG_ERROR, "%a: spurious interrupt %lu\n", __FUNCTION__, (UINT64)Source));
+    AiaDisableInterruptSource (NULL, Source);
+  }
+}
+
+/**
+  EFI_CPU_INTERRUPT_HANDLER for the supervisor external interrupt.
+
+  Claims and dispatches every pending source before returning.
+
+  @param  InterruptType    Defines the type of interrupt or exception that
+                           occurred on the processor.
+  @param  SystemContext    A pointer to the processor context when
+                           the interrupt occurred on the processor.
+
+**/
+STATIC
+VOID
+EFIAPI
+AiaInterruptHandler (
+  IN EFI_EXCEPTION_TYPE  InterruptType,
+  IN EFI_SYSTEM_CONTEXT  SystemContext
+  )
+{
+  UINTN   TopEi;
+  UINT32  Claim;
+
+  if (mAia.Mode == AiaModeImsic) {
+    //
+    // Swapping stopei with zero claims the highest priority identity.
+    //
+    while ((TopEi = csr_swap (RISCV_CSR_SUPERVISOR_STOPEI, 0)) != 0) {
+      AiaDispatch ((TopEi >> IMSIC_TOPEI_ID_SHIFT) & IMSIC_TOPEI_ID_MASK, SystemContext);
+    }
+  } else {
+    while ((Claim = MmioRead32 (mAia.AplicBase + APLIC_IDC (mAia.AplicHartIndex) + APLIC_IDC_CLAIMI)) != 0) {
+      AiaDispatch ((Claim >> APLIC_IDC_ID_SHIFT) & APLIC_IDC_ID_MASK, SystemContext);
+    }
+  }
+}
+
+//
+// The protocol instances produced by this driver
+//
+STATIC EFI_HARDWARE_INTERRUPT_PROTOCOL  mHardwareInterruptProtocol = {
+  AiaRegisterInterruptSource,
+  AiaEnableInterruptSource,
+  AiaDisableInterruptSource,
+  AiaGetInterruptSourceState,
+  AiaEndOfInterrupt
+};
+
+STATIC EFI_HARDWARE_INTERRUPT2_PROTOCOL  mHardwareInterrupt2Protocol = {
+  (HARDWARE_INTERRUPT2_REGISTER)AiaRegisterInterruptSource,
+  (HARDWARE_INTERRUPT2_ENABLE)AiaEnableInterruptSource,
+  (HARDWARE_INTERRUPT2_DISABLE)AiaDisableInterruptSource,
+  (HARDWARE_INTERRUPT2_INTERRUPT_STATE)AiaGetInterruptSourceState,
+  (HARDWARE_INTERRUPT2_END_OF_INTERRUPT)AiaEndOfInterrupt,
+  AiaGetTriggerType,
+  AiaSetTriggerType
+};
+
+/**
+  Put the interrupt controllers in a known state, with every source masked
+  and delivery to the boot hart enabled.
+**/
+STATIC
+VOID
+AiaHardwareInitialize (
+  VOID
+  )
+{
+  UINT32  Source;
+  UINTN   Register;
+
+  if (mAia.HasAplic) {
+    MmioWrite32 (mAia.AplicBase + APLIC_DOMAINCFG, 0);
+    for (Source = 1; Source <= mAia.AplicNumSources; Source++) {
+      mTriggerTypes[Source] = EFI_HARDWARE_INTERRUPT2_TRIGGER_LEVEL_HIGH;
+      MmioWrite32 (mAia.AplicBase + APLIC_CLRIENUM, Source);
+    }
+  }
+
+  if (mAia.Mode == AiaModeImsic) {
+    ImsicWrite (IMSIC_EIDELIVERY, IMSIC_EIDELIVERY_DISABLE);
+    for (Register = 0; Register <= IMSIC_EIX_REG (mAia.ImsicNumIds - 1); Register += 2) {
+      ImsicWrite (IMSIC_EIE0 + Register, 0);
+      ImsicWrite (IMSIC_EIP0 + Register, 0);
+    }
+
+    ImsicWrite (IMSIC_EITHRESHOLD, 0);
+    ImsicWrite (IMSIC_EIDELIVERY, IMSIC_EIDELIVERY_ENABLE);
+    if (mAia.HasAplic) {
+      MmioWrite32 (mAia.AplicBase + APLIC_DOMAINCFG, APLIC_DOMAINCFG_IE | APLIC_DOMAINCFG_DM);
+    }
+  } else {
+    MmioWrite32 (mAia.AplicBase + APLIC_IDC (mAia.AplicHartIndex) + APLIC_IDC_ITHRESHOLD, 0);
+    MmioWrite32 (mAia.AplicBase + APLIC_IDC (mAia.AplicHartIndex) + APLIC_IDC_IDELIVERY, 1);
+    MmioWrite32 (mAia.AplicBase + APLIC_DOMAINCFG, APLIC_DOMAINCFG_IE);
+  }
+}
+
+/**
+  Shutdown our hardware
+
+  DXE Core will disable interrupts and turn off the timer and disable interrupts
+  after all the event handlers have run. The OS must find the controllers
+  quiescent, so every source is masked and delivery is turned off.
+
+  @param[in]  Event   The Event that is being processed
+  @param[in]  Context Event Context
+**/
+STATIC
+VOID
+EFIAPI
+ExitBootServicesEvent (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  UINT32  Source;
+  UINTN   Register;
+
+  csr_clear (CSR_SIE, MIP_SEIP);
+
+  if (mAia.HasAplic) {
+    MmioWrite32 (mAia.AplicBase + APLIC_DOMAINCFG, 0);
+    for (Source = 1; Source <= mAia.AplicNumSources; Source++) {
+      MmioWrite32 (mAia.AplicBase + APLIC_CLRIENUM, Source);
+      MmioWrite32 (mAia.AplicBase + APLIC_SOURCECFG (Source), APLIC_SOURCECFG_SM_INACTIVE);
+    }
+  }
+
+  if (mAia.Mode == AiaModeImsic) {
+    for (Register = 0; Register <= IMSIC_EIX_REG (mAia.ImsicNumIds - 1); Register += 2) {
+      ImsicWrite (IMSIC_EIE0 + Register, 0);
+    }
+
+    ImsicWrite (IMSIC_EIDELIVERY, IMSIC_EIDELIVERY_DISABLE);
+  } else {
+    MmioWrite32 (mAia.AplicBase + APLIC_IDC (mAia.AplicHartIndex) + APLIC_IDC_IDELIVERY, 0);
+  }
+}
+
+/**
+  Discover the controllers, hook the supervisor external interrupt and
+  install the protocols once the CPU architectural protocol is available.
+
+  @param[in]  Event   The Event that is being processed
+  @param[in]  Context Event Context
+**/
+STATIC
+VOID
+EFIAPI
+CpuArchEventProtocolNotify (
+  IN  EFI_EVENT  Event,
+  IN  VOID       *Context
+  )
+{
+  EFI_CPU_ARCH_PROTOCOL  *Cpu;
+  EFI_HANDLE             Handle;
+  EFI_STATUS             Status;
+
+  Status = gBS->LocateProtocol (&gEfiCpuArchProtocolGuid, NULL, (VOID **)&Cpu);
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+
+  gBS->CloseEvent (Event);
+
+  Status = AiaDiscover (&mAia);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "%a: no S-mode AIA interrupt controller\n", __FUNCTION__));
+    return;
+  }
+
+  AiaHardwareInitialize ();
+  AiaMsiInitialize (&mAia);
+
+  Status = Cpu->RegisterInterruptHandler (Cpu, EXCEPT_RISCV_EXTERNAL_INT, AiaInterruptHandler);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: Cpu->RegisterInterruptHandler() - %r\n", __FUNCTION__, Status));
+    ASSERT_EFI_ERROR (Status);
+    return;
+  }
+
+  Status = gBS->CreateEvent (
+                  EVT_SIGNAL_EXIT_BOOT_SERVICES,
+                  TPL_NOTIFY,
+                  ExitBootServicesEvent,
+                  NULL,
+                  &mExitBootServicesEvent
+                  );
+  ASSERT_EFI_ERROR (Status);
+
+  Handle = NULL;
+  Status = gBS->InstallMultipleProtocolInterfaces (
+                  &Handle,
+                  &gHardwareInterruptProtocolGuid,
+                  &mHardwareInterruptProtocol,
+                  &gHardwareInterrupt2ProtocolGuid,
+                  &mHardwareInterrupt2Protocol,
+                  NULL
+                  );
+  ASSERT_EFI_ERROR (Status);
+
+  if (mAia.HasImsic) {
+    Status = gBS->InstallMultipleProtocolInterfaces (
+                    &Handle,
+                    &gRiscVAiaMsiProtocolGuid,
+                    &mAiaMsiProtocol,
+                    NULL
+                    );
+    ASSERT_EFI_ERROR (Status);
+  }
+
+  csr_set (CSR_SIE, MIP_SEIP);
+}
+
+/**
+  Initialize the AIA interrupt controller driver.
+
+  @param  ImageHandle   of the loaded driver
+  @param  SystemTable   Pointer to the System Table
+
+  @retval EFI_SUCCESS   The driver waits for the CPU architectural protocol.
+
+**/
+EFI_STATUS
+EFIAPI
+AiaDxeInitialize (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  EFI_EVENT  CpuArchEvent;
+
+  // Make sure the Interrupt Controller Protocol is not already installed in the system.
+  ASSERT_PROTOCOL_ALREADY_INSTALLED (NULL, &gHardwareInterruptProtocolGuid);
+
+  //
+  // The boot hart id and the interrupt handler both come from the CPU
+  // driver, so the controllers are set up when its protocol appears.
+  //
+  CpuArchEvent = EfiCreateProtocolNotifyEvent (
+                   &gEfiCpuArchProtocolGuid,
+                   TPL_CALLBACK,
+                   CpuArchEventProtocolNotify,
+                   NULL,
+                   &mCpuArchRegistration
+                   );
+  ASSERT (CpuArchEvent != NULL);
+
+  return EFI_SUCCESS;
+}
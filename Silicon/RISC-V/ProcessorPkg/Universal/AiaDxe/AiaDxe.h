@@ -0,0 +1,131 @@
+/** @file
+  RISC-V AIA interrupt controller DXE driver definitions.
+
+  Copyright (c) 2024, SOPHGO Inc. All rights reserved.<BR>
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef AIA_DXE_H_
+#define AIA_DXE_H_
+
+#include <PiDxe.h>
+
+#include <IndustryStandard/Pci.h>
+#include <IndustryStandard/RiscV.h>
+#include <IndustryStandard/RiscVAia.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/HobLib.h>
+#include <Library/IoLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+#include <Protocol/Cpu.h>
+#include <Protocol/HardwareInterrupt.h>
+#include <Protocol/HardwareInterrupt2.h>
+#include <Protocol/RiscVAiaMsi.h>
+#include <Protocol/RiscVBootProtocol.h>
+#include <RiscVImpl.h>
+#include <libfdt.h>
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+
+//
+// Interrupt controller the supervisor external interrupt comes from.
+//
+typedef enum {
+  AiaModeImsic,        ///< IMSIC, optionally fed by an APLIC in MSI mode.
+  AiaModeAplicDirect   ///< APLIC in direct delivery mode, no IMSIC.
+} AIA_MODE;
+
+///
+/// Interrupt controller state discovered from the device tree.
+///
+typedef struct {
+  AIA_MODE                Mode;
+  UINTN                   BootHartId;
+
+  //
+  // S-level IMSIC. Interrupt identities 1 .. ImsicNumIds - 1 are usable.
+  //
+  BOOLEAN                 HasImsic;
+  EFI_PHYSICAL_ADDRESS    ImsicFileAddress;   ///< Interrupt file of the boot hart.
+  UINT32                  ImsicNumIds;
+
+  //
+  // S-level APLIC domain. Wired sources 1 .. AplicNumSources.
+  //
+  BOOLEAN                 HasAplic;
+  EFI_PHYSICAL_ADDRESS    AplicBase;
+  UINT32                  AplicNumSources;
+  UINT32                  AplicHartIndex;     ///< Boot hart index in the domain.
+} AIA_CONTROLLER;
+
+//
+// Sources are numbered with the IMSIC interrupt identities when an IMSIC is
+// present, wired APLIC source N being delivered as identity N. Without an
+// IMSIC they are the APLIC source numbers.
+//
+#define AIA_MAX_SOURCES  (IMSIC_MAX_ID + 1)
+
+//
+// PCI MSI and MSI-X capability layout.
+//
+#define PCI_MSI_CONTROL_OFFSET         0x02
+#define PCI_MSI_CONTROL_ENABLE         BIT0
+#define PCI_MSI_CONTROL_MMC_SHIFT      1
+#define PCI_MSI_CONTROL_MME_SHIFT      4
+#define PCI_MSI_CONTROL_MME_MASK       (0x7 << PCI_MSI_CONTROL_MME_SHIFT)
+#define PCI_MSI_CONTROL_64BIT          BIT7
+#define PCI_MSI_ADDRESS_LO_OFFSET      0x04
+#define PCI_MSI_ADDRESS_HI_OFFSET      0x08
+#define PCI_MSI_DATA_32_OFFSET         0x08
+#define PCI_MSI_DATA_64_OFFSET         0x0C
+#define PCI_MSI_MAX_VECTORS            32
+
+#define PCI_MSIX_CONTROL_OFFSET        0x02
+#define PCI_MSIX_CONTROL_TABLE_SIZE    0x7FF
+#define PCI_MSIX_CONTROL_MASK_ALL      BIT14
+#define PCI_MSIX_CONTROL_ENABLE        BIT15
+#define PCI_MSIX_TABLE_OFFSET          0x04
+#define PCI_MSIX_TABLE_BIR_MASK        0x7
+#define PCI_MSIX_ENTRY_SIZE            16
+#define PCI_MSIX_ENTRY_ADDRESS_LO      0x00
+#define PCI_MSIX_ENTRY_ADDRESS_HI      0x04
+#define PCI_MSIX_ENTRY_DATA            0x08
+#define PCI_MSIX_ENTRY_VECTOR_CONTROL  0x0C
+#define PCI_MSIX_ENTRY_MASKED          BIT0
+
+#define PCI_CAPABILITY_ID_MSI   0x05
+#define PCI_CAPABILITY_ID_MSIX  0x11
+
+extern AIA_CONTROLLER          mAia;
+extern RISCV_AIA_MSI_PROTOCOL  mAiaMsiProtocol;
+
+/**
+  Discover the S-level IMSIC and APLIC of the boot hart from the device tree.
+
+  @param[out] Aia           The discovered controller configuration.
+
+  @retval EFI_SUCCESS       An IMSIC or an APLIC in direct mode was found.
+  @retval EFI_NOT_FOUND     The platform has no AIA interrupt controller.
+**/
+EFI_STATUS
+AiaDiscover (
+  OUT AIA_CONTROLLER  *Aia
+  );
+
+/**
+  Reserve the interrupt sources that must never be handed out as MSIs.
+
+  @param[in]  Aia           The controller configuration.
+**/
+VOID
+AiaMsiInitialize (
+  IN AIA_CONTROLLER  *Aia
+  );
+
+#endif
@@ -0,0 +1,432 @@
+/** @file
+  Discovery of the RISC-V AIA interrupt controllers from the device tree.
+
+  Copyright (c) 2024, SOPHGO Inc. All rights reserved.<BR>
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "AiaDxe.h"
+
+/**
+  Check the status property of a node.
+
+  @param[in]  Fdt           The device tree.
+  @param[in]  Node          The node offset.
+
+  @retval TRUE              The node is enabled.
+  @retval FALSE             The node is disabled.
+**/
+STATIC
+BOOLEAN
+AiaNodeIsEnabled (
+  IN CONST VOID  *Fdt,
+  IN INT32       Node
+  )
+{
+  CONST CHAR8  *Status;
+
+  Status = fdt_getprop (Fdt, Node, "status", NULL);
+  return (Status == NULL) ||
+         (AsciiStrCmp (Status, "okay") == 0) ||
+         (AsciiStrCmp (Status, "ok") == 0);
+}
+
+/**
+  Read a single cell property.
+
+  @param[in]  Fdt           The device tree.
+  @param[in]  Node          The node offset.
+  @param[in]  Name          The property name.
+  @param[in]  Default       Value returned if the property is absent.
+
+  @return The property value, or Default.
+**/
+STATIC
+UINT32
+AiaGetU32 (
+  IN CONST VOID   *Fdt,
+  IN INT32        Node,
+  IN CONST CHAR8  *Name,
+  IN UINT32       Default
+  )
+{
+  CONST fdt32_t  *Prop;
+  INT32          Len;
+
+  Prop = fdt_getprop (Fdt, Node, Name, &Len);
+  if ((Prop == NULL) || (Len != sizeof (fdt32_t))) {
+    return Default;
+  }
+
+  return fdt32_to_cpu (*Prop);
+}
+
+/**
+  Read the address of the first reg entry of a node.
+
+  @param[in]  Fdt           The device tree.
+  @param[in]  Node          The node offset.
+  @param[out] Address       The address.
+
+  @retval EFI_SUCCESS       Address is valid.
+  @retval EFI_NOT_FOUND     The node has no usable reg property.
+**/
+STATIC
+EFI_STATUS
+AiaGetRegAddress (
+  IN  CONST VOID            *Fdt,
+  IN  INT32                 Node,
+  OUT EFI_PHYSICAL_ADDRESS  *Address
+  )
+{
+  CONST fdt32_t  *Prop;
+  INT32          Len;
+  INT32          AddressCells;
+
+  AddressCells = fdt_address_cells (Fdt, fdt_parent_offset (Fdt, Node));
+  Prop         = fdt_getprop (Fdt, Node, "reg", &Len);
+  if ((Prop == NULL) || (AddressCells < 1) || (AddressCells > 2) ||
+      (Len < AddressCells * (INT32)sizeof (fdt32_t)))
+  {
+    return EFI_NOT_FOUND;
+  }
+
+  *Address = fdt32_to_cpu (Prop[0]);
+  if (AddressCells == 2) {
+    *Address = LShiftU64 (*Address, 32) | fdt32_to_cpu (Prop[1]);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Find the position of a hart in the interrupts-extended list of an
+  interrupt controller whose outputs are supervisor external interrupts.
+
+  Each entry points to the interrupt controller node of a cpu node, its
+  position is the hart index used by the IMSIC and APLIC.
+
+  @param[in]  Fdt           The device tree.
+  @param[in]  Node          The IMSIC or APLIC node offset.
+  @param[in]  HartId        The hart to look for.
+  @param[out] HartIndex     Position of HartId in the list.
+  @param[out] HartCount     Number of entries in the list, optional.
+
+  @retval EFI_SUCCESS       HartIndex is valid.
+  @retval EFI_NOT_FOUND     The controller does not target HartId in S-mode.
+**/
+STATIC
+EFI_STATUS
+AiaFindHartIndex (
+  IN  CONST VOID  *Fdt,
+  IN  INT32       Node,
+  IN  UINTN       HartId,
+  OUT UINT32      *HartIndex,
+  OUT UINT32      *HartCount OPTIONAL
+  )
+{
+  CONST fdt32_t  *Prop;
+  CONST fdt32_t  *Reg;
+  INT32          Len;
+  INT32          RegLen;
+  INT32          Entries;
+  INT32          Index;
+  INT32          CpuNode;
+  UINT64         EntryHartId;
+  EFI_STATUS     Status;
+
+  Prop = fdt_getprop (Fdt, Node, "interrupts-extended", &Len);
+  if ((Prop == NULL) || (Len <= 0) || ((Len % (2 * sizeof (fdt32_t))) != 0)) {
+    return EFI_NOT_FOUND;
+  }
+
+  Status  = EFI_NOT_FOUND;
+  Entries = Len / (2 * sizeof (fdt32_t));
+  for (Index = 0; Index < Entries; Index++) {
+    if (fdt32_to_cpu (Prop[Index * 2 + 1]) != IRQ_S_EXT) {
+      return EFI_NOT_FOUND;
+    }
+
+    CpuNode = fdt_node_offset_by_phandle (Fdt, fdt32_to_cpu (Prop[Index * 2]));
+    if (CpuNode >= 0) {
+      CpuNode = fdt_parent_offset (Fdt, CpuNode);
+    }
+
+    if (CpuNode < 0) {
+      continue;
+    }
+
+    Reg = fdt_getprop (Fdt, CpuNode, "reg", &RegLen);
+    if (Reg == NULL) {
+      continue;
+    }
+
+    if (RegLen == sizeof (UINT64)) {
+      EntryHartId = fdt64_to_cpu (*(CONST fdt64_t *)Reg);
+    } else {
+      EntryHartId = fdt32_to_cpu (*Reg);
+    }
+
+    if (EntryHartId == HartId) {
+      *HartIndex = (UINT32)Index;
+      Status     = EFI_SUCCESS;
+    }
+  }
+
+  if (HartCount != NULL) {
+    *HartCount = (UINT32)Entries;
+  }
+
+  return Status;
+}
+
+/**
+  Get the id of the hart running UEFI.
+
+  @param[in]  Fdt           The device tree.
+  @param[out] HartId        The boot hart id.
+
+  @retval EFI_SUCCESS       HartId is valid.
+  @retval EFI_NOT_FOUND     The boot hart id is not known.
+**/
+STATIC
+EFI_STATUS
+AiaGetBootHartId (
+  IN  CONST VOID  *Fdt,
+  OUT UINTN       *HartId
+  )
+{
+  RISCV_EFI_BOOT_PROTOCOL  *RiscVBoot;
+  CONST fdt32_t            *Prop;
+  INT32                    Chosen;
+  INT32                    Len;
+  EFI_STATUS               Status;
+
+  Status = gBS->LocateProtocol (&gRiscVEfiBootProtocolGuid, NULL, (VOID **)&RiscVBoot);
+  if (!EFI_ERROR (Status)) {
+    Status = RiscVBoot->GetBootHartId (RiscVBoot, HartId);
+    if (!EFI_ERROR (Status)) {
+      return EFI_SUCCESS;
+    }
+  }
+
+  //
+  // FdtDxe records the boot hart in /chosen for the OS loader.
+  //
+  Chosen = fdt_path_offset (Fdt, "/chosen");
+  if (Chosen < 0) {
+    return EFI_NOT_FOUND;
+  }
+
+  Prop = fdt_getprop (Fdt, Chosen, "boot-hartid", &Len);
+  if (Prop == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  if (Len == sizeof (UINT64)) {
+    *HartId = (UINTN)fdt64_to_cpu (*(CONST fdt64_t *)Prop);
+  } else {
+    *HartId = fdt32_to_cpu (*Prop);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Look for the S-level IMSIC of the boot hart and compute the address of
+  its interrupt file.
+
+  @param[in]      Fdt           The device tree.
+  @param[in, out] Aia           The controller configuration.
+  @param[out]     ImsicPhandle  Phandle of the IMSIC node.
+  @param[out]     HartIndex     IMSIC hart index of the boot hart.
+
+  @retval EFI_SUCCESS       The IMSIC was found.
+  @retval EFI_NOT_FOUND     There is no usable S-level IMSIC.
+**/
+STATIC
+EFI_STATUS
+AiaDiscoverImsic (
+  IN     CONST VOID      *Fdt,
+  IN OUT AIA_CONTROLLER  *Aia,
+  OUT    UINT32          *ImsicPhandle,
+  OUT    UINT32          *HartIndex
+  )
+{
+  EFI_PHYSICAL_ADDRESS  Base;
+  UINT32                HartCount;
+  UINT32                GuestBits;
+  UINT32                HartBits;
+  UINT32                GroupShift;
+  UINT32                Group;
+  INT32                 Node;
+
+  for (Node = fdt_node_offset_by_compatible (Fdt, -1, "riscv,imsics");
+       Node >= 0;
+       Node = fdt_node_offset_by_compatible (Fdt, Node, "riscv,imsics"))
+  {
+    if (!AiaNodeIsEnabled (Fdt, Node) ||
+        EFI_ERROR (AiaFindHartIndex (Fdt, Node, Aia->BootHartId, HartIndex, &HartCount)) ||
+        EFI_ERROR (AiaGetRegAddress (Fdt, Node, &Base)))
+    {
+      continue;
+    }
+
+    Aia->ImsicNumIds = AiaGetU32 (Fdt, Node, "riscv,num-ids", 0) + 1;
+    if ((Aia->ImsicNumIds <= IMSIC_MIN_ID) || (Aia->ImsicNumIds > IMSIC_MAX_ID + 1)) {
+      DEBUG ((DEBUG_ERROR, "%a: invalid riscv,num-ids\n", __FUNCTION__));
+      continue;
+    }
+
+    //
+    // Interrupt file address of hart index H, see the AIA specification,
+    // "Interrupt files and the device tree":
+    //   Base + (Group << GroupShift) + (Hart << (GuestBits + 12))
+    //
+    GuestBits  = AiaGetU32 (Fdt, Node, "riscv,guest-index-bits", 0);
+    HartBits   = AiaGetU32 (Fdt, Node, "riscv,hart-index-bits", HighBitSet32 (HartCount * 2 - 1));
+    GroupShift = AiaGetU32 (Fdt, Node, "riscv,group-index-shift", 24);
+    Group      = *HartIndex >> HartBits;
+
+    Aia->ImsicFileAddress = Base +
+                            LShiftU64 (Group, GroupShift) +
+                            LShiftU64 (*HartIndex & ((1U << HartBits) - 1), GuestBits + IMSIC_MMIO_PAGE_SHIFT);
+    Aia->HasImsic = TRUE;
+    *ImsicPhandle = fdt_get_phandle (Fdt, Node);
+    return EFI_SUCCESS;
+  }
+
+  return EFI_NOT_FOUND;
+}
+
+/**
+  Look for the S-level APLIC domain of the boot hart.
+
+  With an IMSIC the domain must deliver MSIs to it, otherwise it must deliver
+  supervisor external interrupts to the boot hart directly.
+
+  @param[in]      Fdt           The device tree.
+  @param[in, out] Aia           The controller configuration.
+  @param[in]      ImsicPhandle  Phandle of the IMSIC node, if any.
+  @param[in]      HartIndex     IMSIC hart index of the boot hart, if any.
+**/
+STATIC
+VOID
+AiaDiscoverAplic (
+  IN     CONST VOID      *Fdt,
+  IN OUT AIA_CONTROLLER  *Aia,
+  IN     UINT32          ImsicPhandle,
+  IN     UINT32          HartIndex
+  )
+{
+  EFI_PHYSICAL_ADDRESS  Base;
+  UINT32                MsiParent;
+  INT32                 Node;
+
+  for (Node = fdt_node_offset_by_compatible (Fdt, -1, "riscv,aplic");
+       Node >= 0;
+       Node = fdt_node_offset_by_compatible (Fdt, Node, "riscv,aplic"))
+  {
+    if (!AiaNodeIsEnabled (Fdt, Node) ||
+        EFI_ERROR (AiaGetRegAddress (Fdt, Node, &Base)))
+    {
+      continue;
+    }
+
+    MsiParent = AiaGetU32 (Fdt, Node, "msi-parent", 0);
+    if (Aia->HasImsic) {
+      if ((MsiParent == 0) || (MsiParent != ImsicPhandle)) {
+        continue;
+      }
+
+      Aia->AplicHartIndex = HartIndex;
+    } else if ((MsiParent != 0) ||
+               EFI_ERROR (AiaFindHartIndex (Fdt, Node, Aia->BootHartId, &Aia->AplicHartIndex, NULL)))
+    {
+      continue;
+    }
+
+    Aia->AplicNumSources = AiaGetU32 (Fdt, Node, "riscv,num-sources", 0);
+    if ((Aia->AplicNumSources == 0) || (Aia->AplicNumSources > APLIC_MAX_SOURCES)) {
+      continue;
+    }
+
+    if (Aia->HasImsic && (Aia->AplicNumSources >= Aia->ImsicNumIds)) {
+      //
+      // Wired sources are delivered with their own number as identity.
+      //
+      Aia->AplicNumSources = Aia->ImsicNumIds - 1;
+    }
+
+    Aia->AplicBase = Base;
+    Aia->HasAplic  = TRUE;
+    return;
+  }
+}
+
+/**
+  Discover the S-level IMSIC and APLIC of the boot hart from the device tree.
+
+  @param[out] Aia           The discovered controller configuration.
+
+  @retval EFI_SUCCESS       An IMSIC or an APLIC in direct mode was found.
+  @retval EFI_NOT_FOUND     The platform has no AIA interrupt controller.
+**/
+EFI_STATUS
+AiaDiscover (
+  OUT AIA_CONTROLLER  *Aia
+  )
+{
+  EFI_HOB_GUID_TYPE  *GuidHob;
+  CONST VOID         *Fdt;
+  UINT32             ImsicPhandle;
+  UINT32             HartIndex;
+  EFI_STATUS         Status;
+
+  ZeroMem (Aia, sizeof (*Aia));
+
+  GuidHob = GetFirstGuidHob (&gFdtHobGuid);
+  if (GuidHob == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  Fdt = (CONST VOID *)*((UINTN *)GET_GUID_HOB_DATA (GuidHob));
+  if ((Fdt == NULL) || (fdt_check_header (Fdt) != 0)) {
+    return EFI_NOT_FOUND;
+  }
+
+  Status = AiaGetBootHartId (Fdt, &Aia->BootHartId);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: boot hart id unknown\n", __FUNCTION__));
+    return Status;
+  }
+
+  ImsicPhandle = 0;
+  HartIndex    = 0;
+  AiaDiscoverImsic (Fdt, Aia, &ImsicPhandle, &HartIndex);
+  AiaDiscoverAplic (Fdt, Aia, ImsicPhandle, HartIndex);
+
+  if (Aia->HasImsic) {
+    Aia->Mode = AiaModeImsic;
+  } else if (Aia->HasAplic) {
+    Aia->Mode = AiaModeAplicDirect;
+  } else {
+    return EFI_NOT_FOUND;
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: hart %lu, IMSIC %lx (%u ids), APLIC %lx (%u sources, %a mode)\n",
+    __FUNCTION__,
+    (UINT64)Aia->BootHartId,
+    Aia->ImsicFileAddress,
+    Aia->ImsicNumIds,
+    Aia->AplicBase,
+    Aia->AplicNumSources,
+    Aia->HasImsic ? "MSI" : "direct"
+    ));
+
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,550 @@
+/** @file
+  MSI source allocation and PCI MSI/MSI-X programming for the RISC-V AIA
+  interrupt controller driver.
+
+  Every MSI targets the S-level interrupt file of the boot hart, the message
+  data being the IMSIC interrupt identity, which is also the interrupt
+  source number used with the hardware interrupt protocol.
+
+  Copyright (c) 2024, SOPHGO Inc. All rights reserved.<BR>
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "AiaDxe.h"
+
+//
+// One bit per interrupt identity, set when the identity is not free.
+//
+STATIC UINT8  mMsiAllocated[AIA_MAX_SOURCES / 8];
+
+/**
+  Check whether an interrupt identity is in use.
+
+  @param[in]  Id            The interrupt identity.
+
+  @retval TRUE              Id is allocated or reserved.
+  @retval FALSE             Id is free.
+**/
+STATIC
+BOOLEAN
+AiaMsiIsAllocated (
+  IN UINTN  Id
+  )
+{
+  return (mMsiAllocated[Id / 8] & (1 << (Id % 8))) != 0;
+}
+
+/**
+  Mark a range of interrupt identities used or free.
+
+  @param[in]  First         The first interrupt identity.
+  @param[in]  Count         Number of identities.
+  @param[in]  Allocated     TRUE to mark the identities used.
+**/
+STATIC
+VOID
+AiaMsiMark (
+  IN UINTN    First,
+  IN UINTN    Count,
+  IN BOOLEAN  Allocated
+  )
+{
+  UINTN  Id;
+
+  for (Id = First; Id < First + Count; Id++) {
+    if (Allocated) {
+      mMsiAllocated[Id / 8] |= (UINT8)(1 << (Id % 8));
+    } else {
+      mMsiAllocated[Id / 8] &= (UINT8) ~(1 << (Id % 8));
+    }
+  }
+}
+
+/**
+  Reserve the interrupt sources that must never be handed out as MSIs.
+
+  @param[in]  Aia           The controller configuration.
+**/
+VOID
+AiaMsiInitialize (
+  IN AIA_CONTROLLER  *Aia
+  )
+{
+  SetMem (mMsiAllocated, sizeof (mMsiAllocated), 0xFF);
+  if (!Aia->HasImsic) {
+    return;
+  }
+
+  //
+  // Identity 0 does not exist and wired APLIC sources own the identities
+  // matching their numbers.
+  //
+  AiaMsiMark (0, Aia->ImsicNumIds, FALSE);
+  AiaMsiMark (0, Aia->HasAplic ? Aia->AplicNumSources + 1 : 1, TRUE);
+}
+
+/**
+  Allocate a block of MSI interrupt sources.
+
+  @param[in]  This          Instance pointer for this protocol.
+  @param[in]  Count         Number of interrupt sources, a power of two.
+  @param[out] FirstSource   First interrupt source of the block.
+
+  @retval EFI_SUCCESS            The block was allocated.
+  @retval EFI_INVALID_PARAMETER  Count is zero or not a power of two, or
+                                 FirstSource is NULL.
+  @retval EFI_OUT_OF_RESOURCES   No free block of Count sources is left.
+  @retval EFI_UNSUPPORTED        The platform has no IMSIC.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+AiaMsiAllocate (
+  IN  RISCV_AIA_MSI_PROTOCOL     *This,
+  IN  UINTN                      Count,
+  OUT HARDWARE_INTERRUPT_SOURCE  *FirstSource
+  )
+{
+  UINTN  First;
+  UINTN  Id;
+
+  if ((FirstSource == NULL) || (Count == 0) || ((Count & (Count - 1)) != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (!mAia.HasImsic) {
+    return EFI_UNSUPPORTED;
+  }
+
+  for (First = Count; First + Count <= mAia.ImsicNumIds; First += Count) {
+    for (Id = First; Id < First + Count; Id++) {
+      if (AiaMsiIsAllocated (Id)) {
+        break;
+      }
+    }
+
+    if (Id == First + Count) {
+      AiaMsiMark (First, Count, TRUE);
+      *FirstSource = First;
+      return EFI_SUCCESS;
+    }
+  }
+
+  return EFI_OUT_OF_RESOURCES;
+}
+
+/**
+  Free a block of MSI interrupt sources.
+
+  @param[in]  This          Instance pointer for this protocol.
+  @param[in]  FirstSource   First interrupt source of the block.
+  @param[in]  Count         Number of interrupt sources passed to Allocate().
+
+  @retval EFI_SUCCESS            The block was freed.
+  @retval EFI_INVALID_PARAMETER  The block was not allocated by Allocate().
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+AiaMsiFree (
+  IN  RISCV_AIA_MSI_PROTOCOL     *This,
+  IN  HARDWARE_INTERRUPT_SOURCE  FirstSource,
+  IN  UINTN                      Count
+  )
+{
+  UINTN  Id;
+
+  if ((Count == 0) ||
+      (FirstSource <= (mAia.HasAplic ? mAia.AplicNumSources : 0)) ||
+      (FirstSource + Count > mAia.ImsicNumIds))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  for (Id = FirstSource; Id < FirstSource + Count; Id++) {
+    if (!AiaMsiIsAllocated (Id)) {
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+
+  AiaMsiMark (FirstSource, Count, FALSE);
+  return EFI_SUCCESS;
+}
+
+/**
+  Return the message address and data that raise an interrupt source.
+
+  @param[in]  This          Instance pointer for this protocol.
+  @param[in]  Source        Interrupt source returned by Allocate().
+  @param[out] Address       Address the device must write to.
+  @param[out] Data          32-bit value the device must write.
+
+  @retval EFI_SUCCESS            Address and Data are valid.
+  @retval EFI_INVALID_PARAMETER  Source is not an allocated MSI source.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+AiaMsiGetTarget (
+  IN  RISCV_AIA_MSI_PROTOCOL     *This,
+  IN  HARDWARE_INTERRUPT_SOURCE  Source,
+  OUT UINT64                     *Address,
+  OUT UINT32                     *Data
+  )
+{
+  if ((Address == NULL) || (Data == NULL) ||
+      (Source == 0) || (Source >= mAia.ImsicNumIds) ||
+      !AiaMsiIsAllocated (Source))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  *Address = mAia.ImsicFileAddress + IMSIC_MMIO_SETEIPNUM_LE;
+  *Data    = (UINT32)Source;
+  return EFI_SUCCESS;
+}
+
+/**
+  Find a capability in the configuration space of a PCI function.
+
+  @param[in]  PciIo         The PCI function.
+  @param[in]  CapabilityId  The capability to look for.
+  @param[out] Offset        Offset of the capability header.
+
+  @retval EFI_SUCCESS       Offset is valid.
+  @retval EFI_NOT_FOUND     The function does not implement the capability.
+**/
+STATIC
+EFI_STATUS
+AiaPciFindCapability (
+  IN  EFI_PCI_IO_PROTOCOL  *PciIo,
+  IN  UINT8                CapabilityId,
+  OUT UINT8                *Offset
+  )
+{
+  EFI_STATUS  Status;
+  UINT16      PciStatus;
+  UINT8       Pointer;
+  UINT8       Header[2];
+  UINTN       Walked;
+
+  Status = PciIo->Pci.Read (PciIo, EfiPciIoWidthUint16, PCI_PRIMARY_STATUS_OFFSET, 1, &PciStatus);
+  if (EFI_ERROR (Status) || ((PciStatus & EFI_PCI_STATUS_CAPABILITY) == 0)) {
+    return EFI_NOT_FOUND;
+  }
+
+  Status = PciIo->Pci.Read (PciIo, EfiPciIoWidthUint8, PCI_CAPBILITY_POINTER_OFFSET, 1, &Pointer);
+  if (EFI_ERROR (Status)) {
+    return EFI_NOT_FOUND;
+  }
+
+  //
+  // 48 entries is the most that fit in the device specific area.
+  //
+  for (Walked = 0; (Pointer >= 0x40) && (Walked < 48); Walked++) {
+    Pointer &= ~0x3;
+    Status   = PciIo->Pci.Read (PciIo, EfiPciIoWidthUint8, Pointer, 2, Header);
+    if (EFI_ERROR (Status)) {
+      return EFI_NOT_FOUND;
+    }
+
+    if (Header[0] == CapabilityId) {
+      *Offset = Pointer;
+      return EFI_SUCCESS;
+    }
+
+    Pointer = Header[1];
+  }
+
+  return EFI_NOT_FOUND;
+}
+
+/**
+  Program the MSI-X table of a PCI function.
+
+  @param[in]      PciIo         The PCI function.
+  @param[in]      Capability    Offset of the MSI-X capability.
+  @param[in, out] Count         Vectors requested, then programmed.
+  @param[out]     FirstSource   Interrupt source of vector 0.
+
+  @retval EFI_SUCCESS       MSI-X is enabled.
+  @retval Others            The table could not be programmed.
+**/
+STATIC
+EFI_STATUS
+AiaPciEnableMsix (
+  IN     EFI_PCI_IO_PROTOCOL        *PciIo,
+  IN     UINT8                      Capability,
+  IN OUT UINTN                      *Count,
+  OUT    HARDWARE_INTERRUPT_SOURCE  *FirstSource
+  )
+{
+  EFI_STATUS  Status;
+  UINT16      Control;
+  UINT32      Table;
+  UINT32      Entry[4];
+  UINT64      Address;
+  UINT32      Data;
+  UINTN       Vectors;
+  UINTN       Index;
+
+  Status = PciIo->Pci.Read (PciIo, EfiPciIoWidthUint16, Capability + PCI_MSIX_CONTROL_OFFSET, 1, &Control);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = PciIo->Pci.Read (PciIo, EfiPciIoWidthUint32, Capability + PCI_MSIX_TABLE_OFFSET, 1, &Table);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Vectors = MIN (*Count, (UINTN)(Control & PCI_MSIX_CONTROL_TABLE_SIZE) + 1);
+
+  //
+  // MSI-X vectors are independent, the block only needs to be a power of
+  // two for the allocator.
+  //
+  Status = AiaMsiAllocate (&mAiaMsiProtocol, GetPowerOfTwo64 (Vectors * 2 - 1), FirstSource);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Keep every vector masked while the table is written.
+  //
+  Control |= PCI_MSIX_CONTROL_ENABLE | PCI_MSIX_CONTROL_MASK_ALL;
+  Status   = PciIo->Pci.Write (PciIo, EfiPciIoWidthUint16, Capability + PCI_MSIX_CONTROL_OFFSET, 1, &Control);
+  if (EFI_ERROR (Status)) {
+    goto Error;
+  }
+
+  for (Index = 0; Index < Vectors; Index++) {
+    AiaMsiGetTarget (&mAiaMsiProtocol, *FirstSource + Index, &Address, &Data);
+    Entry[PCI_MSIX_ENTRY_ADDRESS_LO / 4]     = (UINT32)Address;
+    Entry[PCI_MSIX_ENTRY_ADDRESS_HI / 4]     = (UINT32)RShiftU64 (Address, 32);
+    Entry[PCI_MSIX_ENTRY_DATA / 4]           = Data;
+    Entry[PCI_MSIX_ENTRY_VECTOR_CONTROL / 4] = 0;
+
+    Status = PciIo->Mem.Write (
+                          PciIo,
+                          EfiPciIoWidthUint32,
+                          (UINT8)(Table & PCI_MSIX_TABLE_BIR_MASK),
+                          (Table & ~PCI_MSIX_TABLE_BIR_MASK) + Index * PCI_MSIX_ENTRY_SIZE,
+                          ARRAY_SIZE (Entry),
+                          Entry
+                          );
+    if (EFI_ERROR (Status)) {
+      goto Error;
+    }
+  }
+
+  Control &= ~PCI_MSIX_CONTROL_MASK_ALL;
+  Status   = PciIo->Pci.Write (PciIo, EfiPciIoWidthUint16, Capability + PCI_MSIX_CONTROL_OFFSET, 1, &Control);
+  if (EFI_ERROR (Status)) {
+    goto Error;
+  }
+
+  *Count = Vectors;
+  return EFI_SUCCESS;
+
+Error:
+  Control &= ~(PCI_MSIX_CONTROL_ENABLE | PCI_MSIX_CONTROL_MASK_ALL);
+  PciIo->Pci.Write (PciIo, EfiPciIoWidthUint16, Capability + PCI_MSIX_CONTROL_OFFSET, 1, &Control);
+  AiaMsiFree (&mAiaMsiProtocol, *FirstSource, GetPowerOfTwo64 (Vectors * 2 - 1));
+  return Status;
+}
+
+/**
+  Program the MSI capability of a PCI function.
+
+  @param[in]      PciIo         The PCI function.
+  @param[in]      Capability    Offset of the MSI capability.
+  @param[in, out] Count         Vectors requested, then programmed.
+  @param[out]     FirstSource   Interrupt source of vector 0.
+
+  @retval EFI_SUCCESS       MSI is enabled.
+  @retval Others            The capability could not be programmed.
+**/
+STATIC
+EFI_STATUS
+AiaPciEnableMsi (
+  IN     EFI_PCI_IO_PROTOCOL        *PciIo,
+  IN     UINT8                      Capability,
+  IN OUT UINTN                      *Count,
+  OUT    HARDWARE_INTERRUPT_SOURCE  *FirstSource
+  )
+{
+  EFI_STATUS  Status;
+  UINT16      Control;
+  UINT64      Address;
+  UINT32      AddressLo;
+  UINT32      AddressHi;
+  UINT32      Data;
+  UINT16      Data16;
+  UINTN       Vectors;
+  UINTN       Log2Vectors;
+
+  Status = PciIo->Pci.Read (PciIo, EfiPciIoWidthUint16, Capability + PCI_MSI_CONTROL_OFFSET, 1, &Control);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Multiple message MSI uses a power of two block, the function ORs the
+  // vector number into the low bits of the data.
+  //
+  Vectors     = MIN (*Count, PCI_MSI_MAX_VECTORS);
+  Vectors     = MIN (Vectors, (UINTN)1 << ((Control >> PCI_MSI_CONTROL_MMC_SHIFT) & 0x7));
+  Vectors     = GetPowerOfTwo64 (Vectors);
+  Log2Vectors = HighBitSet64 (Vectors);
+
+  Status = AiaMsiAllocate (&mAiaMsiProtocol, Vectors, FirstSource);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  AiaMsiGetTarget (&mAiaMsiProtocol, *FirstSource, &Address, &Data);
+  AddressLo = (UINT32)Address;
+  AddressHi = (UINT32)RShiftU64 (Address, 32);
+  Data16    = (UINT16)Data;
+
+  if ((AddressHi != 0) && ((Control & PCI_MSI_CONTROL_64BIT) == 0)) {
+    Status = EFI_UNSUPPORTED;
+    goto Error;
+  }
+
+  Status = PciIo->Pci.Write (PciIo, EfiPciIoWidthUint32, Capability + PCI_MSI_ADDRESS_LO_OFFSET, 1, &AddressLo);
+  if (!EFI_ERROR (Status) && ((Control & PCI_MSI_CONTROL_64BIT) != 0)) {
+    Status = PciIo->Pci.Write (PciIo, EfiPciIoWidthUint32, Capability + PCI_MSI_ADDRESS_HI_OFFSET, 1, &AddressHi);
+    if (!EFI_ERROR (Status)) {
+      Status = PciIo->Pci.Write (PciIo, EfiPciIoWidthUint16, Capability + PCI_MSI_DATA_64_OFFSET, 1, &Data16);
+    }
+  } else if (!EFI_ERROR (Status)) {
+    Status = PciIo->Pci.Write (PciIo, EfiPciIoWidthUint16, Capability + PCI_MSI_DATA_32_OFFSET, 1, &Data16);
+  }
+
+  if (EFI_ERROR (Status)) {
+    goto Error;
+  }
+
+  Control &= ~PCI_MSI_CONTROL_MME_MASK;
+  Control |= (UINT16)(Log2Vectors << PCI_MSI_CONTROL_MME_SHIFT) | PCI_MSI_CONTROL_ENABLE;
+  Status   = PciIo->Pci.Write (PciIo, EfiPciIoWidthUint16, Capability + PCI_MSI_CONTROL_OFFSET, 1, &Control);
+  if (EFI_ERROR (Status)) {
+    goto Error;
+  }
+
+  *Count = Vectors;
+  return EFI_SUCCESS;
+
+Error:
+  AiaMsiFree (&mAiaMsiProtocol, *FirstSource, Vectors);
+  return Status;
+}
+
+/**
+  Allocate MSI interrupt sources for a PCI function and program its MSI-X or
+  MSI capability with their targets.
+
+  @param[in]      This          Instance pointer for this protocol.
+  @param[in]      PciIo         The PCI function to program.
+  @param[in, out] Count         Vectors requested, then programmed.
+  @param[out]     FirstSource   Interrupt source of vector 0.
+
+  @retval EFI_SUCCESS            The function now signals MSIs.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL or Count is zero.
+  @retval EFI_UNSUPPORTED        The function has no MSI or MSI-X capability.
+  @retval EFI_OUT_OF_RESOURCES   Not enough MSI sources are left.
+  @retval Others                 Accessing the function failed.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+AiaMsiEnablePci (
+  IN     RISCV_AIA_MSI_PROTOCOL     *This,
+  IN     EFI_PCI_IO_PROTOCOL        *PciIo,
+  IN OUT UINTN                      *Count,
+  OUT    HARDWARE_INTERRUPT_SOURCE  *FirstSource
+  )
+{
+  UINT8  Capability;
+
+  if ((PciIo == NULL) || (Count == NULL) || (*Count == 0) || (FirstSource == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (!EFI_ERROR (AiaPciFindCapability (PciIo, PCI_CAPABILITY_ID_MSIX, &Capability))) {
+    return AiaPciEnableMsix (PciIo, Capability, Count, FirstSource);
+  }
+
+  if (!EFI_ERROR (AiaPciFindCapability (PciIo, PCI_CAPABILITY_ID_MSI, &Capability))) {
+    return AiaPciEnableMsi (PciIo, Capability, Count, FirstSource);
+  }
+
+  return EFI_UNSUPPORTED;
+}
+
+/**
+  Disable MSI-X or MSI on a PCI function and free its interrupt sources.
+
+  @param[in]  This          Instance pointer for this protocol.
+  @param[in]  PciIo         The PCI function programmed by EnablePci().
+  @param[in]  FirstSource   The FirstSource returned by EnablePci().
+  @param[in]  Count         The Count returned by EnablePci().
+
+  @retval EFI_SUCCESS            MSIs are disabled and the sources freed.
+  @retval EFI_INVALID_PARAMETER  PciIo is NULL or the sources were not
+                                 allocated.
+  @retval Others                 Accessing the function failed.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+AiaMsiDisablePci (
+  IN  RISCV_AIA_MSI_PROTOCOL     *This,
+  IN  EFI_PCI_IO_PROTOCOL        *PciIo,
+  IN  HARDWARE_INTERRUPT_SOURCE  FirstSource,
+  IN  UINTN                      Count
+  )
+{
+  EFI_STATUS  Status;
+  UINT16      Control;
+  UINT8       Capability;
+
+  if (PciIo == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (!EFI_ERROR (AiaPciFindCapability (PciIo, PCI_CAPABILITY_ID_MSIX, &Capability))) {
+    Count  = GetPowerOfTwo64 (Count * 2 - 1);
+    Status = PciIo->Pci.Read (PciIo, EfiPciIoWidthUint16, Capability + PCI_MSIX_CONTROL_OFFSET, 1, &Control);
+    if (!EFI_ERROR (Status)) {
+      Control &= ~PCI_MSIX_CONTROL_ENABLE;
+      Status   = PciIo->Pci.Write (PciIo, EfiPciIoWidthUint16, Capability + PCI_MSIX_CONTROL_OFFSET, 1, &Control);
+    }
+  } else if (!EFI_ERROR (AiaPciFindCapability (PciIo, PCI_CAPABILITY_ID_MSI, &Capability))) {
+    Status = PciIo->Pci.Read (PciIo, EfiPciIoWidthUint16, Capability + PCI_MSI_CONTROL_OFFSET, 1, &Control);
+    if (!EFI_ERROR (Status)) {
+      Control &= ~(PCI_MSI_CONTROL_ENABLE | PCI_MSI_CONTROL_MME_MASK);
+      Status   = PciIo->Pci.Write (PciIo, EfiPciIoWidthUint16, Capability + PCI_MSI_CONTROL_OFFSET, 1, &Control);
+    }
+  } else {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return AiaMsiFree (This, FirstSource, Count);
+}
+
+RISCV_AIA_MSI_PROTOCOL  mAiaMsiProtocol = {
+  AiaMsiAllocate,
+  AiaMsiFree,
+  AiaMsiGetTarget,
+  AiaMsiEnablePci,
+  AiaMsiDisablePci
+};
@@ -0,0 +1,40 @@
+/** @file
+  Parallel system memory scrubbing for the SOPHGO SEC phase.
+
+  Copyright (c) 2024, SOPHGO Inc. All rights reserved.<BR>
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef SEC_MEMORY_SCRUB_LIB_H_
+#define SEC_MEMORY_SCRUB_LIB_H_
+
+/**
+  Scrub the system memory described by the device tree.
+
+  The memory nodes are split in chunks that are zeroed by the boot hart and
+  by the secondary harts, which are released from the SBI HSM stopped state
+  for the duration of the scrub. Every hart starts with the chunks of its
+  own NUMA node. The secondary harts are stopped again through SBI HSM
+  before this function returns.
+
+  Reserved memory, the device tree, the firmware volumes and the SEC
+  temporary and UEFI memory are never touched. Nothing is done unless
+  PcdSecMemoryScrubEnable is TRUE.
+
+  @param[in]  DeviceTreeAddress  Pointer to the device tree.
+  @param[in]  BootHartId         Hart id of the boot hart.
+
+  @retval EFI_SUCCESS            Memory was scrubbed, or scrubbing is disabled.
+  @retval EFI_INVALID_PARAMETER  The device tree is not valid.
+  @retval EFI_OUT_OF_RESOURCES   Not enough memory for the work lists.
+**/
+EFI_STATUS
+EFIAPI
+SecScrubSystemMemory (
+  IN  CONST VOID  *DeviceTreeAddress,
+  IN  UINTN       BootHartId
+  );
+
+#endif
@@ -0,0 +1,807 @@
+/** @file
+  Parallel system memory scrubbing for the SOPHGO SEC phase.
+
+  On boards with ECC memory every location has to be written once before it
+  is read, and doing that for hundreds of GiB on the boot hart alone takes a
+  long time. The secondary harts are idle in the SBI HSM stopped state while
+  SEC runs, so they are started on a small entry stub, pull chunks of memory
+  from per NUMA node work queues, and stop themselves once the queues are
+  empty.
+
+  Copyright (c) 2024, SOPHGO Inc. All rights reserved.<BR>
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiPei.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/BaseRiscVSbiLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
+#include <Library/SecMemoryScrubLib.h>
+#include <Library/SynchronizationLib.h>
+#include <Library/TimerLib.h>
+#include <libfdt.h>
+
+#ifndef SBI_EXT_HSM
+#define SBI_EXT_HSM  0x48534D
+#endif
+
+#define SBI_HSM_HART_START       0
+#define SBI_HSM_HART_STOP        1
+#define SBI_HSM_HART_GET_STATUS  2
+#define SBI_HSM_STATE_STOPPED    1
+
+#define SCRUB_MAX_NODES        16
+#define SCRUB_MAX_EXCLUSIONS   64
+#define SCRUB_HART_STACK_SIZE  SIZE_4KB
+#define SCRUB_STOP_POLLS       1000000
+
+//
+// How long the boot hart waits for the secondary harts to finish their last
+// chunk before it reports them, in milliseconds per GiB of the largest chunk,
+// and at least.
+//
+#define SCRUB_DONE_TIMEOUT_MS_PER_GB  2000
+#define SCRUB_DONE_TIMEOUT_MIN_MS     1000
+
+///
+/// A physical memory range.
+///
+typedef struct {
+  EFI_PHYSICAL_ADDRESS    Base;
+  UINT64                  Size;
+} SCRUB_RANGE;
+
+///
+/// Chunks of one NUMA node, Chunks[First] to Chunks[First + Count - 1].
+/// Harts claim chunks by incrementing Next.
+///
+typedef struct {
+  UINT32             NodeId;
+  UINT32             First;
+  UINT32             Count;
+  volatile UINT32    Next;
+} SCRUB_QUEUE;
+
+typedef struct {
+  SCRUB_RANGE        *Chunks;
+  SCRUB_QUEUE        Queues[SCRUB_MAX_NODES];
+  UINT32             QueueCount;
+  volatile UINT32    HartsDone;
+} SCRUB_CONTEXT;
+
+///
+/// Per secondary hart data, passed as the HSM opaque argument.
+///
+typedef struct {
+  UINT64           StackTop;     ///< Must stay first, see SecondaryEntry.S.
+  SCRUB_CONTEXT    *Context;
+  UINTN            HartId;
+  UINT32           Queue;
+  BOOLEAN          Started;
+  volatile BOOLEAN Done;
+} SCRUB_HART;
+
+STATIC SCRUB_CONTEXT  mScrubContext;
+STATIC SCRUB_RANGE    mExclusions[SCRUB_MAX_EXCLUSIONS];
+STATIC UINTN          mExclusionCount;
+STATIC BOOLEAN        mExclusionOverflow;
+
+/**
+  Entry point of the secondary harts, implemented in SecondaryEntry.S.
+  Loads the stack from the SCRUB_HART and calls SecScrubSecondaryMain ().
+**/
+VOID
+EFIAPI
+SecScrubSecondaryEntry (
+  VOID
+  );
+
+/**
+  Zero every chunk left in the queues, starting with the preferred one.
+
+  @param[in]  Context     The scrub context.
+  @param[in]  Preferred   Queue of the NUMA node of the calling hart.
+**/
+STATIC
+VOID
+ScrubWork (
+  IN SCRUB_CONTEXT  *Context,
+  IN UINT32         Preferred
+  )
+{
+  SCRUB_QUEUE  *Queue;
+  SCRUB_RANGE  *Chunk;
+  UINT32       Pass;
+  UINT32       Index;
+
+  for (Pass = 0; Pass < Context->QueueCount; Pass++) {
+    Queue = &Context->Queues[(Preferred + Pass) % Context->QueueCount];
+    while (Queue->Next < Queue->Count) {
+      Index = InterlockedIncrement (&Queue->Next) - 1;
+      if (Index >= Queue->Count) {
+        break;
+      }
+
+      Chunk = &Context->Chunks[Queue->First + Index];
+      ZeroMem ((VOID *)(UINTN)Chunk->Base, (UINTN)Chunk->Size);
+    }
+  }
+}
+
+/**
+  C entry point of the secondary harts.
+
+  Runs with the MMU off and interrupts disabled. It must not use the
+  serial port, which belongs to the boot hart.
+
+  @param[in]  Hart        The SCRUB_HART of this hart.
+**/
+VOID
+EFIAPI
+SecScrubSecondaryMain (
+  IN SCRUB_HART  *Hart
+  )
+{
+  ScrubWork (Hart->Context, Hart->Queue);
+
+  MemoryFence ();
+  Hart->Done = TRUE;
+  InterlockedIncrement (&Hart->Context->HartsDone);
+
+  SbiCall (SBI_EXT_HSM, SBI_HSM_HART_STOP, 0);
+  CpuDeadLoop ();
+}
+
+/**
+  Read a value made of one or two cells.
+
+  @param[in]  Cells       Pointer to the first cell.
+  @param[in]  CellCount   Number of cells.
+
+  @return The value.
+**/
+STATIC
+UINT64
+ScrubReadCells (
+  IN CONST fdt32_t  *Cells,
+  IN INT32          CellCount
+  )
+{
+  UINT64  Value;
+
+  Value = fdt32_to_cpu (Cells[0]);
+  if (CellCount > 1) {
+    Value = LShiftU64 (Value, 32) | fdt32_to_cpu (Cells[1]);
+  }
+
+  return Value;
+}
+
+/**
+  Return the numa-node-id of a node, or 0 if it has none.
+
+  @param[in]  Fdt         The device tree.
+  @param[in]  Node        The node offset.
+
+  @return The NUMA node id.
+**/
+STATIC
+UINT32
+ScrubNumaNodeId (
+  IN CONST VOID  *Fdt,
+  IN INT32       Node
+  )
+{
+  CONST fdt32_t  *Prop;
+  INT32          Len;
+
+  Prop = fdt_getprop (Fdt, Node, "numa-node-id", &Len);
+  if ((Prop == NULL) || (Len != sizeof (fdt32_t))) {
+    return 0;
+  }
+
+  return fdt32_to_cpu (*Prop);
+}
+
+/**
+  Return the queue of a NUMA node.
+
+  @param[in]  Context     The scrub context.
+  @param[in]  NodeId      The NUMA node id.
+  @param[in]  Create      Add a queue if the node has none yet.
+
+  @return The queue index, or Context->QueueCount if there is none.
+**/
+STATIC
+UINT32
+ScrubQueueIndex (
+  IN SCRUB_CONTEXT  *Context,
+  IN UINT32         NodeId,
+  IN BOOLEAN        Create
+  )
+{
+  UINT32  Index;
+
+  for (Index = 0; Index < Context->QueueCount; Index++) {
+    if (Context->Queues[Index].NodeId == NodeId) {
+      return Index;
+    }
+  }
+
+  if (Create && (Context->QueueCount < SCRUB_MAX_NODES)) {
+    Context->Queues[Context->QueueCount].NodeId = NodeId;
+    return Context->QueueCount++;
+  }
+
+  return Context->QueueCount;
+}
+
+/**
+  Add a range that must not be scrubbed, keeping the list sorted by base.
+
+  @param[in]  Base        Base of the range.
+  @param[in]  Size        Size of the range.
+**/
+STATIC
+VOID
+ScrubExclude (
+  IN EFI_PHYSICAL_ADDRESS  Base,
+  IN UINT64                Size
+  )
+{
+  UINTN  Index;
+
+  if (Size == 0) {
+    return;
+  }
+
+  if (mExclusionCount == SCRUB_MAX_EXCLUSIONS) {
+    //
+    // Losing track of a reserved range is not an option, the caller gives
+    // up on scrubbing.
+    //
+    mExclusionOverflow = TRUE;
+    return;
+  }
+
+  for (Index = mExclusionCount; (Index > 0) && (mExclusions[Index - 1].Base > Base); Index--) {
+    mExclusions[Index] = mExclusions[Index - 1];
+  }
+
+  mExclusions[Index].Base = Base;
+  mExclusions[Index].Size = Size;
+  mExclusionCount++;
+}
+
+/**
+  Collect the ranges that hold firmware or reserved data.
+
+  @param[in]  Fdt         The device tree.
+**/
+STATIC
+VOID
+ScrubCollectExclusions (
+  IN CONST VOID  *Fdt
+  )
+{
+  CONST fdt32_t         *Reg;
+  EFI_PHYSICAL_ADDRESS  Base;
+  UINT64                Size;
+  UINT64                TempRamTop;
+  INT32                 Node;
+  INT32                 SubNode;
+  INT32                 Len;
+  INT32                 AddressCells;
+  INT32                 SizeCells;
+  INT32                 Index;
+
+  mExclusionCount    = 0;
+  mExclusionOverflow = FALSE;
+
+  //
+  // The SEC stack and the UEFI memory handed to DXE, see SecStartup ().
+  //
+  TempRamTop = (UINT64)FixedPcdGet32 (PcdTemporaryRamBase) + FixedPcdGet32 (PcdTemporaryRamSize);
+  ScrubExclude (TempRamTop - SIZE_32MB, SIZE_32MB);
+  ScrubExclude (FixedPcdGet32 (PcdRiscVDxeFvBase), FixedPcdGet32 (PcdRiscVDxeFvSize));
+  ScrubExclude (
+    FixedPcdGet32 (PcdVariableFirmwareRegionBaseAddress),
+    FixedPcdGet32 (PcdVariableFirmwareRegionSize)
+    );
+  ScrubExclude ((UINTN)Fdt, fdt_totalsize (Fdt));
+
+  for (Index = 0; Index < fdt_num_mem_rsv (Fdt); Index++) {
+    if (fdt_get_mem_rsv (Fdt, Index, &Base, &Size) == 0) {
+      ScrubExclude (Base, Size);
+    }
+  }
+
+  Node = fdt_subnode_offset (Fdt, 0, "reserved-memory");
+  if (Node < 0) {
+    return;
+  }
+
+  AddressCells = fdt_address_cells (Fdt, Node);
+  SizeCells    = fdt_size_cells (Fdt, Node);
+  if ((AddressCells < 1) || (AddressCells > 2) || (SizeCells < 1) || (SizeCells > 2)) {
+    return;
+  }
+
+  fdt_for_each_subnode (SubNode, Fdt, Node) {
+    Reg = fdt_getprop (Fdt, SubNode, "reg", &Len);
+    for ( ; (Reg != NULL) && (Len >= (AddressCells + SizeCells) * (INT32)sizeof (fdt32_t));
+          Len -= (AddressCells + SizeCells) * sizeof (fdt32_t), Reg += AddressCells + SizeCells)
+    {
+      ScrubExclude (ScrubReadCells (Reg, AddressCells), ScrubReadCells (Reg + AddressCells, SizeCells));
+    }
+  }
+}
+
+/**
+  Split a memory range in chunks, skipping the excluded ranges.
+
+  @param[in]      Base        Base of the range.
+  @param[in]      Size        Size of the range.
+  @param[in]      Chunks      Chunk array to fill, NULL to only count.
+  @param[in, out] ChunkCount  Number of chunks in the array.
+**/
+STATIC
+VOID
+ScrubSplitRange (
+  IN     EFI_PHYSICAL_ADDRESS  Base,
+  IN     UINT64                Size,
+  IN     SCRUB_RANGE           *Chunks OPTIONAL,
+  IN OUT UINT32                *ChunkCount
+  )
+{
+  EFI_PHYSICAL_ADDRESS  End;
+  EFI_PHYSICAL_ADDRESS  SegmentEnd;
+  UINT64                ChunkSize;
+  UINTN                 Index;
+
+  ChunkSize = FixedPcdGet64 (PcdSecMemoryScrubChunkSize);
+  End       = Base + Size;
+  Index     = 0;
+
+  while (Base < End) {
+    //
+    // Skip exclusions that end before Base, then the one covering Base.
+    //
+    while ((Index < mExclusionCount) &&
+           (mExclusions[Index].Base + mExclusions[Index].Size <= Base))
+    {
+      Index++;
+    }
+
+    if ((Index < mExclusionCount) && (mExclusions[Index].Base <= Base)) {
+      Base = mExclusions[Index].Base + mExclusions[Index].Size;
+      continue;
+    }
+
+    SegmentEnd = End;
+    if ((Index < mExclusionCount) && (mExclusions[Index].Base < End)) {
+      SegmentEnd = mExclusions[Index].Base;
+    }
+
+    if ((ChunkSize != 0) && (SegmentEnd - Base > ChunkSize)) {
+      SegmentEnd = Base + ChunkSize;
+    }
+
+    if (Chunks != NULL) {
+      Chunks[*ChunkCount].Base = Base;
+      Chunks[*ChunkCount].Size = SegmentEnd - Base;
+    }
+
+    (*ChunkCount)++;
+    Base = SegmentEnd;
+  }
+}
+
+/**
+  Walk the memory nodes of the device tree and split them in chunks.
+
+  @param[in]      Fdt         The device tree.
+  @param[in]      NodeId      Only split the nodes of this NUMA node.
+  @param[in]      AllNodes    Ignore NodeId and split every memory node.
+  @param[in]      Chunks      Chunk array to fill, NULL to only count.
+  @param[in, out] ChunkCount  Number of chunks in the array.
+**/
+STATIC
+VOID
+ScrubSplitMemoryNodes (
+  IN     CONST VOID   *Fdt,
+  IN     UINT32       NodeId,
+  IN     BOOLEAN      AllNodes,
+  IN     SCRUB_RANGE  *Chunks OPTIONAL,
+  IN OUT UINT32       *ChunkCount
+  )
+{
+  CONST fdt32_t  *Reg;
+  CONST CHAR8    *Type;
+  INT32          Node;
+  INT32          Len;
+  INT32          AddressCells;
+  INT32          SizeCells;
+
+  AddressCells = fdt_address_cells (Fdt, 0);
+  SizeCells    = fdt_size_cells (Fdt, 0);
+  if ((AddressCells < 1) || (AddressCells > 2) || (SizeCells < 1) || (SizeCells > 2)) {
+    return;
+  }
+
+  fdt_for_each_subnode (Node, Fdt, 0) {
+    Type = fdt_getprop (Fdt, Node, "device_type", NULL);
+    if ((Type == NULL) || (AsciiStrCmp (Type, "memory") != 0)) {
+      continue;
+    }
+
+    if (!AllNodes && (ScrubNumaNodeId (Fdt, Node) != NodeId)) {
+      continue;
+    }
+
+    Reg = fdt_getprop (Fdt, Node, "reg", &Len);
+    for ( ; (Reg != NULL) && (Len >= (AddressCells + SizeCells) * (INT32)sizeof (fdt32_t));
+          Len -= (AddressCells + SizeCells) * sizeof (fdt32_t), Reg += AddressCells + SizeCells)
+    {
+      ScrubSplitRange (
+        ScrubReadCells (Reg, AddressCells),
+        ScrubReadCells (Reg + AddressCells, SizeCells),
+        Chunks,
+        ChunkCount
+        );
+    }
+  }
+}
+
+/**
+  Create one queue per NUMA node that has memory.
+
+  Memory of the NUMA nodes beyond SCRUB_MAX_NODES is not scrubbed.
+
+  @param[in]      Fdt         The device tree.
+  @param[in, out] Context     The scrub context.
+**/
+STATIC
+VOID
+ScrubCreateQueues (
+  IN     CONST VOID     *Fdt,
+  IN OUT SCRUB_CONTEXT  *Context
+  )
+{
+  CONST CHAR8  *Type;
+  INT32        Node;
+
+  fdt_for_each_subnode (Node, Fdt, 0) {
+    Type = fdt_getprop (Fdt, Node, "device_type", NULL);
+    if ((Type != NULL) && (AsciiStrCmp (Type, "memory") == 0)) {
+      ScrubQueueIndex (Context, ScrubNumaNodeId (Fdt, Node), TRUE);
+    }
+  }
+}
+
+/**
+  Query the HSM state of a hart.
+
+  @param[in]  HartId      The hart.
+
+  @return The SBI HSM state, or MAX_UINTN on error.
+**/
+STATIC
+UINTN
+ScrubHartState (
+  IN UINTN  HartId
+  )
+{
+  SBI_RET  Ret;
+
+  Ret = SbiCall (SBI_EXT_HSM, SBI_HSM_HART_GET_STATUS, 1, HartId);
+  return (Ret.Error == SBI_SUCCESS) ? Ret.Value : MAX_UINTN;
+}
+
+/**
+  Start every secondary hart that is stopped on SecScrubSecondaryEntry ().
+
+  @param[in]  Fdt         The device tree.
+  @param[in]  Context     The scrub context.
+  @param[in]  BootHartId  Hart id of the boot hart.
+  @param[out] Harts       The hart array, NULL if no hart was found.
+  @param[out] HartCount   Number of entries in Harts.
+  @param[out] BootQueue   Queue of the NUMA node of the boot hart.
+
+  @return The number of harts started.
+**/
+STATIC
+UINT32
+ScrubStartHarts (
+  IN  CONST VOID     *Fdt,
+  IN  SCRUB_CONTEXT  *Context,
+  IN  UINTN          BootHartId,
+  OUT SCRUB_HART     **Harts,
+  OUT UINTN          *HartCount,
+  OUT UINT32         *BootQueue
+  )
+{
+  CONST fdt32_t  *Reg;
+  CONST CHAR8    *Property;
+  SCRUB_HART     *Hart;
+  UINT8          *Stacks;
+  UINTN          HartId;
+  UINT32         Queue;
+  UINT32         Started;
+  INT32          CpusNode;
+  INT32          Node;
+  INT32          Len;
+  SBI_RET        Ret;
+
+  *Harts     = NULL;
+  *HartCount = 0;
+  *BootQueue = 0;
+
+  CpusNode = fdt_path_offset (Fdt, "/cpus");
+  if (CpusNode < 0) {
+    return 0;
+  }
+
+  fdt_for_each_subnode (Node, Fdt, CpusNode) {
+    (*HartCount)++;
+  }
+
+  *Harts = AllocateZeroPool (*HartCount * sizeof (SCRUB_HART));
+  Stacks = AllocatePages (EFI_SIZE_TO_PAGES (*HartCount * SCRUB_HART_STACK_SIZE));
+  if ((*Harts == NULL) || (Stacks == NULL)) {
+    *HartCount = 0;
+    return 0;
+  }
+
+  Hart    = *Harts;
+  Started = 0;
+  fdt_for_each_subnode (Node, Fdt, CpusNode) {
+    Property = fdt_getprop (Fdt, Node, "device_type", NULL);
+    if ((Property == NULL) || (AsciiStrCmp (Property, "cpu") != 0)) {
+      continue;
+    }
+
+    Property = fdt_getprop (Fdt, Node, "status", NULL);
+    if ((Property != NULL) && (AsciiStrCmp (Property, "okay") != 0)) {
+      continue;
+    }
+
+    Reg = fdt_getprop (Fdt, Node, "reg", &Len);
+    if ((Reg == NULL) || (Len < (INT32)sizeof (fdt32_t))) {
+      continue;
+    }
+
+    HartId = (UINTN)ScrubReadCells (Reg, MIN (Len / (INT32)sizeof (fdt32_t), 2));
+    Queue  = ScrubQueueIndex (Context, ScrubNumaNodeId (Fdt, Node), FALSE);
+    if (Queue == Context->QueueCount) {
+      Queue = 0;
+    }
+
+    if (HartId == BootHartId) {
+      *BootQueue = Queue;
+      continue;
+    }
+
+    if (ScrubHartState (HartId) != SBI_HSM_STATE_STOPPED) {
+      continue;
+    }
+
+    Hart->StackTop = (UINT64)(UINTN)(Stacks + (Hart - *Harts + 1) * SCRUB_HART_STACK_SIZE);
+    Hart->Context  = Context;
+    Hart->HartId   = HartId;
+    Hart->Queue    = Queue;
+
+    MemoryFence ();
+    Ret = SbiCall (
+            SBI_EXT_HSM,
+            SBI_HSM_HART_START,
+            3,
+            HartId,
+            (UINTN)SecScrubSecondaryEntry,
+            (UINTN)Hart
+            );
+    if (Ret.Error == SBI_SUCCESS) {
+      Hart->Started = TRUE;
+      Started++;
+    } else {
+      DEBUG ((DEBUG_WARN, "%a: hart %lu failed to start: %ld\n", __func__, (UINT64)HartId, (INT64)Ret.Error));
+    }
+
+    Hart++;
+  }
+
+  *HartCount = Hart - *Harts;
+  return Started;
+}
+
+/**
+  Return how long to wait for the secondary harts once the queues are empty,
+  before reporting the ones that are not done.
+
+  By then every hart is at most one chunk away from done, so the time is
+  scaled by the size of the largest chunk.
+
+  @param[in]  Context     The scrub context.
+  @param[in]  ChunkCount  Number of chunks.
+
+  @return The timeout in milliseconds.
+**/
+STATIC
+UINT64
+ScrubDoneTimeout (
+  IN SCRUB_CONTEXT  *Context,
+  IN UINT32         ChunkCount
+  )
+{
+  UINT64  Largest;
+  UINT32  Index;
+
+  Largest = 0;
+  for (Index = 0; Index < ChunkCount; Index++) {
+    Largest = MAX (Largest, Context->Chunks[Index].Size);
+  }
+
+  return MAX (
+           MultU64x32 (DivU64x32 (Largest + SIZE_1GB - 1, SIZE_1GB), SCRUB_DONE_TIMEOUT_MS_PER_GB),
+           SCRUB_DONE_TIMEOUT_MIN_MS
+           );
+}
+
+/**
+  Report the secondary harts that have not finished scrubbing.
+
+  @param[in]  Harts       The hart array.
+  @param[in]  HartCount   Number of entries in Harts.
+  @param[in]  Waited      Time waited so far, in milliseconds.
+**/
+STATIC
+VOID
+ScrubReportLateHarts (
+  IN SCRUB_HART  *Harts,
+  IN UINTN       HartCount,
+  IN UINT64      Waited
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < HartCount; Index++) {
+    if (Harts[Index].Started && !Harts[Index].Done) {
+      DEBUG ((
+        DEBUG_ERROR,
+        "%a: hart %lu has not finished scrubbing after %lu ms, still waiting\n",
+        __func__,
+        (UINT64)Harts[Index].HartId,
+        Waited
+        ));
+    }
+  }
+}
+
+/**
+  Scrub the system memory described by the device tree.
+
+  @param[in]  DeviceTreeAddress  Pointer to the device tree.
+  @param[in]  BootHartId         Hart id of the boot hart.
+
+  @retval EFI_SUCCESS            Memory was scrubbed, or scrubbing is disabled.
+  @retval EFI_INVALID_PARAMETER  The device tree is not valid.
+  @retval EFI_OUT_OF_RESOURCES   Not enough memory for the work lists.
+**/
+EFI_STATUS
+EFIAPI
+SecScrubSystemMemory (
+  IN  CONST VOID  *DeviceTreeAddress,
+  IN  UINTN       BootHartId
+  )
+{
+  SCRUB_CONTEXT  *Context;
+  SCRUB_QUEUE    *Queue;
+  SCRUB_HART     *Harts;
+  UINTN          HartCount;
+  UINTN          Index;
+  UINTN          Polls;
+  UINT64         StartTicks;
+  UINT64         Timeout;
+  UINT64         Waited;
+  UINT64         NextReport;
+  UINT32         ChunkCount;
+  UINT32         Started;
+  UINT32         BootQueue;
+
+  if (!FixedPcdGetBool (PcdSecMemoryScrubEnable)) {
+    return EFI_SUCCESS;
+  }
+
+  if ((DeviceTreeAddress == NULL) || (fdt_check_header (DeviceTreeAddress) != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Context = &mScrubContext;
+  ZeroMem (Context, sizeof (*Context));
+
+  ScrubCollectExclusions (DeviceTreeAddress);
+  if (mExclusionOverflow) {
+    DEBUG ((DEBUG_ERROR, "%a: too many reserved ranges, not scrubbing\n", __func__));
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // Count the chunks, then fill the chunk array queue by queue so the chunks
+  // of each NUMA node are contiguous.
+  //
+  ScrubCreateQueues (DeviceTreeAddress, Context);
+  ChunkCount = 0;
+  ScrubSplitMemoryNodes (DeviceTreeAddress, 0, TRUE, NULL, &ChunkCount);
+  if ((ChunkCount == 0) || (Context->QueueCount == 0)) {
+    return EFI_SUCCESS;
+  }
+
+  Context->Chunks = AllocatePool (ChunkCount * sizeof (SCRUB_RANGE));
+  if (Context->Chunks == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  ChunkCount = 0;
+  for (Index = 0; Index < Context->QueueCount; Index++) {
+    Queue        = &Context->Queues[Index];
+    Queue->First = ChunkCount;
+    ScrubSplitMemoryNodes (DeviceTreeAddress, Queue->NodeId, FALSE, Context->Chunks, &ChunkCount);
+    Queue->Count = ChunkCount - Queue->First;
+  }
+
+  Started = ScrubStartHarts (DeviceTreeAddress, Context, BootHartId, &Harts, &HartCount, &BootQueue);
+
+  DEBUG ((
+    DEBUG_INFO,
+    "%a: %u chunks in %u NUMA nodes, %u secondary harts\n",
+    __func__,
+    ChunkCount,
+    Context->QueueCount,
+    Started
+    ));
+
+  ScrubWork (Context, BootQueue);
+
+  //
+  // The queues are empty, so every hart is on its last chunk. Memory must
+  // not be handed to later phases before every hart is done: a hart that is
+  // only slow would zero data written after SEC returns. A hart that takes
+  // longer than the timeout is reported, again every timeout, and waited for.
+  //
+  StartTicks = GetPerformanceCounter ();
+  Timeout    = ScrubDoneTimeout (Context, ChunkCount);
+  NextReport = Timeout;
+  while (Context->HartsDone < Started) {
+    Waited = DivU64x32 (GetTimeInNanoSecond (GetPerformanceCounter () - StartTicks), 1000 * 1000);
+    if (Waited > NextReport) {
+      ScrubReportLateHarts (Harts, HartCount, Waited);
+      NextReport += Timeout;
+    }
+
+    CpuPause ();
+  }
+
+  //
+  // Wait for every hart to be parked again before DXE may start them.
+  //
+  for (Index = 0; Index < HartCount; Index++) {
+    if (!Harts[Index].Started) {
+      continue;
+    }
+
+    for (Polls = 0; ScrubHartState (Harts[Index].HartId) != SBI_HSM_STATE_STOPPED; Polls++) {
+      if (Polls == SCRUB_STOP_POLLS) {
+        DEBUG ((DEBUG_ERROR, "%a: hart %lu has not stopped yet, still waiting\n", __func__, (UINT64)Harts[Index].HartId));
+      }
+
+      CpuPause ();
+    }
+  }
+
+  return EFI_SUCCESS;
+}
@@ -94,6 +94,14 @@ SecStartup (
 
   SecInitializePlatform (DeviceTreeAddress);
 
+  //
+  // Initialize ECC memory before DXE can use it.
+  //
+  Status = SecScrubSystemMemory (DeviceTreeAddress, BootHartId);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: memory scrub failed: %r\n", __func__, Status));
+  }
+
   BuildStackHob (StackBase, StackSize);
 
   //
@@ -31,6 +31,7 @@
 #include <Library/BaseRiscVSbiLib.h>
 #include <Library/PrePiLib.h>
 #include <Library/PrePiHobListPointerLib.h>
+#include <Library/SecMemoryScrubLib.h>
 #include <Library/SerialPortLib.h>
 #include <Register/RiscV64/RiscVImpl.h>
 